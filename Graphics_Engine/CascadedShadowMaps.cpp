@@ -0,0 +1,350 @@
+/*
+ * CascadedShadowMaps.cpp
+ *
+ */
+
+#include "CascadedShadowMaps.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Keeps the tight depth range from clipping casters that touch it.
+const float DEPTH_PADDING = 0.01f;
+
+} // namespace
+
+CascadedShadowMaps::CascadedShadowMaps() {
+	memset(&m_desc, 0, sizeof(m_desc));
+	memset(&m_stats, 0, sizeof(m_stats));
+	XMStoreFloat4x4(&m_lightView, XMMatrixIdentity());
+	m_lightDirection = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; ++i) {
+		m_cascades[i].Cascade = ShadowCascade();
+		m_cascades[i].OriginX = 0;
+		m_cascades[i].OriginY = 0;
+		m_cascades[i].CacheValid = false;
+		m_cascades[i].CacheOriginX = 0;
+		m_cascades[i].CacheOriginY = 0;
+		m_cascades[i].CacheTexelSize = 0.0f;
+	}
+}
+
+bool CascadedShadowMaps::Initialize(const ShadowMapDesc& desc) {
+	if (desc.CascadeCount == 0 || desc.CascadeCount > MAX_SHADOW_CASCADES)
+		return false;
+	if (desc.Resolution < 16 || desc.MaxDistance <= 0.0f)
+		return false;
+	m_desc = desc;
+	for (uint32_t i = 0; i < desc.CascadeCount; ++i) {
+		CascadeState& state = m_cascades[i];
+		if (!state.Depth.Initialize(desc.Resolution, desc.Resolution) ||
+				!state.StaticDepth.Initialize(desc.Resolution, desc.Resolution))
+			return false;
+		state.Depth.Clear(FLT_MAX);
+		state.StaticDepth.Clear(FLT_MAX);
+		state.CacheValid = false;
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+	return true;
+}
+
+void CascadedShadowMaps::InvalidateStaticCasters() {
+	for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; ++i)
+		m_cascades[i].CacheValid = false;
+}
+
+bool CascadedShadowMaps::Render(const ShadowView& view, const ShadowCaster* casters,
+		uint32_t count, JobSystem* jobs) {
+	if (m_desc.CascadeCount == 0 || view.NearZ <= 0.0f || view.FarZ <= view.NearZ)
+		return false;
+
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&view.LightDirection));
+	if (XMVector3Equal(direction, XMVectorZero()))
+		return false;
+	XMFLOAT3 normalized;
+	XMStoreFloat3(&normalized, direction);
+	if (normalized.x != m_lightDirection.x || normalized.y != m_lightDirection.y ||
+			normalized.z != m_lightDirection.z) {
+		InvalidateStaticCasters();
+		m_lightDirection = normalized;
+	}
+	// The light view sits at the world origin so texel snapping happens on
+	// a grid that never moves.
+	XMVECTOR up = fabsf(normalized.y) > 0.99f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) :
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), direction, up);
+	XMStoreFloat4x4(&m_lightView, lightView);
+
+	m_casterBounds.resize(count);
+	ParallelFor(jobs, count, 1024, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&casters[i].Center),
+					lightView);
+			XMStoreFloat4(&m_casterBounds[i], XMVectorSetW(center, casters[i].Radius));
+		}
+	});
+
+	XMMATRIX cameraView = XMLoadFloat4x4(&view.View);
+	XMVECTOR determinant;
+	XMMATRIX cameraToWorld = XMMatrixInverse(&determinant, cameraView);
+
+	// Practical split scheme: blend logarithmic and uniform distances.
+	const float nearZ = view.NearZ;
+	const float farZ = std::min(view.FarZ, m_desc.MaxDistance);
+	if (farZ <= nearZ)
+		return false;
+	for (uint32_t i = 0; i < m_desc.CascadeCount; ++i) {
+		float t0 = (float)i / m_desc.CascadeCount;
+		float t1 = (float)(i + 1) / m_desc.CascadeCount;
+		ShadowCascade& cascade = m_cascades[i].Cascade;
+		cascade.SplitNear = m_desc.SplitLambda * nearZ * powf(farZ / nearZ, t0) +
+				(1.0f - m_desc.SplitLambda) * (nearZ + (farZ - nearZ) * t0);
+		cascade.SplitFar = m_desc.SplitLambda * nearZ * powf(farZ / nearZ, t1) +
+				(1.0f - m_desc.SplitLambda) * (nearZ + (farZ - nearZ) * t1);
+	}
+	m_cascades[0].Cascade.SplitNear = nearZ;
+	m_cascades[m_desc.CascadeCount - 1].Cascade.SplitFar = farZ;
+
+	ParallelFor(jobs, m_desc.CascadeCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			FitCascade(i, view, cameraToWorld);
+			CullCasters(i, casters, count);
+			RenderCascade(i, casters);
+		}
+	});
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.CasterCount = count;
+	for (uint32_t i = 0; i < m_desc.CascadeCount; ++i) {
+		const ShadowCascade& cascade = m_cascades[i].Cascade;
+		m_stats.CulledCasters += count - cascade.StaticCasters - cascade.DynamicCasters;
+		m_stats.StaticCastersDrawn += cascade.StaticCastersDrawn;
+		m_stats.DynamicCastersDrawn += cascade.DynamicCasters;
+		if (cascade.StaticCasters && cascade.StaticCastersDrawn == 0)
+			++m_stats.StaticCacheHits;
+	}
+	return true;
+}
+
+// Fits the cascade to the bounding sphere of its frustum slice. The sphere
+// only depends on the projection, so the cascade size is constant and
+// only its snapped origin moves.
+void CascadedShadowMaps::FitCascade(uint32_t index, const ShadowView& view,
+		CXMMATRIX cameraToWorld) {
+	CascadeState& state = m_cascades[index];
+	ShadowCascade& cascade = state.Cascade;
+	const float zn = cascade.SplitNear;
+	const float zf = cascade.SplitFar;
+	const float tanY = tanf(view.FovY * 0.5f);
+	const float slope2 = tanY * tanY * (1.0f + view.AspectRatio * view.AspectRatio);
+
+	// Center on the view axis, equidistant from the near and far corners.
+	float centerZ = std::min(zf, (zn + zf) * (1.0f + slope2) * 0.5f);
+	float radius = sqrtf((zf - centerZ) * (zf - centerZ) + zf * zf * slope2);
+	// One spare texel so that snapping never uncovers the sphere.
+	const uint32_t resolution = m_desc.Resolution;
+	const float texel = 2.0f * radius / (resolution - 1);
+
+	XMMATRIX lightView = XMLoadFloat4x4(&m_lightView);
+	XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f),
+			cameraToWorld);
+	XMFLOAT3 lightCenter;
+	XMStoreFloat3(&lightCenter, XMVector3TransformCoord(center, lightView));
+	state.OriginX = (int64_t)floor((lightCenter.x - radius) / texel);
+	state.OriginY = (int64_t)floor((lightCenter.y - radius) / texel);
+	cascade.TexelSize = texel;
+	// Receivers lie within the sphere; culling narrows this further.
+	cascade.DepthNear = lightCenter.z - radius;
+	cascade.DepthFar = lightCenter.z + radius;
+}
+
+void CascadedShadowMaps::CullCasters(uint32_t index, const ShadowCaster* casters,
+		uint32_t count) {
+	CascadeState& state = m_cascades[index];
+	ShadowCascade& cascade = state.Cascade;
+	const float texel = cascade.TexelSize;
+	const float left = state.OriginX * texel;
+	const float bottom = state.OriginY * texel;
+	const float right = left + m_desc.Resolution * texel;
+	const float top = bottom + m_desc.Resolution * texel;
+	const float receiverNear = cascade.DepthNear;
+	const float receiverFar = cascade.DepthFar;
+
+	// Casters anywhere between the light and the far end of the receivers
+	// can shadow them. Static casters skip the depth test so the cached
+	// layer does not depend on where the camera is.
+	state.StaticList.clear();
+	state.DynamicList.clear();
+	float casterNear = FLT_MAX;
+	float casterFar = -FLT_MAX;
+	for (uint32_t i = 0; i < count; ++i) {
+		const XMFLOAT4& b = m_casterBounds[i];
+		if (!casters[i].Mesh || b.x + b.w < left || b.x - b.w > right || b.y + b.w < bottom ||
+				b.y - b.w > top)
+			continue;
+		bool inRange = b.z - b.w <= receiverFar;
+		if (casters[i].Static)
+			state.StaticList.push_back(i);
+		else if (inRange)
+			state.DynamicList.push_back(i);
+		if (inRange) {
+			casterNear = std::min(casterNear, b.z - b.w);
+			casterFar = std::max(casterFar, b.z + b.w);
+		}
+	}
+	cascade.StaticCasters = (uint32_t)state.StaticList.size();
+	cascade.DynamicCasters = (uint32_t)state.DynamicList.size();
+
+	// Nothing past the last caster can be shadowed, and nothing in front
+	// of the first one needs depth.
+	if (casterNear <= casterFar) {
+		cascade.DepthNear = casterNear - DEPTH_PADDING;
+		cascade.DepthFar = std::min(receiverFar, casterFar) + DEPTH_PADDING;
+	} else {
+		cascade.DepthNear = receiverNear;
+		cascade.DepthFar = receiverFar;
+	}
+	XMMATRIX projection = XMMatrixOrthographicOffCenterLH(left, right, bottom, top,
+			cascade.DepthNear, cascade.DepthFar);
+	XMStoreFloat4x4(&cascade.ViewProjection,
+			XMMatrixMultiply(XMLoadFloat4x4(&m_lightView), projection));
+}
+
+void CascadedShadowMaps::RenderCascade(uint32_t index, const ShadowCaster* casters) {
+	CascadeState& state = m_cascades[index];
+	UpdateStaticLayer(state, casters);
+	state.Depth = state.StaticDepth;
+	DrawCasters(state, state.Depth, state.Depth.GetRect(), state.DynamicList, casters);
+}
+
+// Brings the static layer to the current origin: reused as is, scrolled
+// with the exposed strips redrawn, or redrawn from scratch.
+void CascadedShadowMaps::UpdateStaticLayer(CascadeState& state, const ShadowCaster* casters) {
+	const int64_t resolution = m_desc.Resolution;
+	const int64_t dx = state.OriginX - state.CacheOriginX;
+	// Rows run top down while light space y runs up.
+	const int64_t dy = state.CacheOriginY - state.OriginY;
+	bool valid = state.CacheValid && state.CacheTexelSize == state.Cascade.TexelSize &&
+			dx > -resolution && dx < resolution && dy > -resolution && dy < resolution;
+
+	state.CacheValid = true;
+	state.CacheOriginX = state.OriginX;
+	state.CacheOriginY = state.OriginY;
+	state.CacheTexelSize = state.Cascade.TexelSize;
+	if (!valid) {
+		state.StaticDepth.Clear(FLT_MAX);
+		state.Cascade.StaticCastersDrawn = DrawCasters(state, state.StaticDepth,
+				state.StaticDepth.GetRect(), state.StaticList, casters);
+		return;
+	}
+	state.Cascade.StaticCastersDrawn = 0;
+	if (dx == 0 && dy == 0)
+		return;
+
+	// Scroll into the cascade's depth buffer, which is rebuilt from the
+	// static layer afterwards anyway, then swap the two.
+	const int32_t res = (int32_t)resolution;
+	const int32_t shiftX = (int32_t)dx;
+	const int32_t shiftY = (int32_t)dy;
+	const int32_t first = std::max(0, -shiftX);
+	const int32_t last = std::min(res, res - shiftX);
+	state.Depth.Clear(FLT_MAX);
+	for (int32_t y = 0; y < res; ++y) {
+		int32_t source = y + shiftY;
+		if (source < 0 || source >= res)
+			continue;
+		memcpy(state.Depth.GetRow(y) + first, state.StaticDepth.GetRow(source) + first + shiftX,
+				(last - first) * sizeof(float));
+	}
+	state.StaticDepth.Swap(state.Depth);
+
+	if (shiftX != 0) {
+		ScissorRect strip = { shiftX > 0 ? res - shiftX : 0, 0, shiftX > 0 ? res : -shiftX, res };
+		state.Cascade.StaticCastersDrawn += DrawCasters(state, state.StaticDepth, strip,
+				state.StaticList, casters);
+	}
+	if (shiftY != 0) {
+		ScissorRect strip = { 0, shiftY > 0 ? res - shiftY : 0, res, shiftY > 0 ? res : -shiftY };
+		state.Cascade.StaticCastersDrawn += DrawCasters(state, state.StaticDepth, strip,
+				state.StaticList, casters);
+	}
+}
+
+uint32_t CascadedShadowMaps::DrawCasters(CascadeState& state, DepthBuffer& target,
+		const ScissorRect& scissor, const std::vector<uint32_t>& list,
+		const ShadowCaster* casters) {
+	const float inverseTexel = 1.0f / state.Cascade.TexelSize;
+	const float top = (float)(state.OriginY + m_desc.Resolution);
+	XMMATRIX lightToRaster = XMMatrixMultiply(XMLoadFloat4x4(&m_lightView),
+			GetRasterTransform(state));
+	uint32_t drawn = 0;
+	for (size_t i = 0; i < list.size(); ++i) {
+		const ShadowCaster& caster = casters[list[i]];
+		const XMFLOAT4& b = m_casterBounds[list[i]];
+		float x0 = (b.x - b.w) * inverseTexel - state.OriginX;
+		float x1 = (b.x + b.w) * inverseTexel - state.OriginX;
+		float y0 = top - (b.y + b.w) * inverseTexel;
+		float y1 = top - (b.y - b.w) * inverseTexel;
+		if (x1 < scissor.Left || x0 > scissor.Right || y1 < scissor.Top || y0 > scissor.Bottom)
+			continue;
+		XMMATRIX toRaster = XMMatrixMultiply(XMLoadFloat4x4(&caster.World), lightToRaster);
+		RasterizeDepth(target, scissor, *caster.Mesh, toRaster, state.Scratch);
+		++drawn;
+	}
+	return drawn;
+}
+
+// Light view space to raster space: texels from the cascade origin, rows
+// top down, depth left in light view units.
+XMMATRIX CascadedShadowMaps::GetRasterTransform(const CascadeState& state) const {
+	const float inverseTexel = 1.0f / state.Cascade.TexelSize;
+	return XMMatrixSet(
+			inverseTexel, 0.0f, 0.0f, 0.0f,
+			0.0f, -inverseTexel, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			(float)-state.OriginX, (float)(state.OriginY + m_desc.Resolution), 0.0f, 1.0f);
+}
+
+float CascadedShadowMaps::SampleShadow(FXMVECTOR worldPosition, float viewDepth) const {
+	uint32_t index = 0;
+	while (index < m_desc.CascadeCount && viewDepth > m_cascades[index].Cascade.SplitFar)
+		++index;
+	if (index == m_desc.CascadeCount)
+		return 1.0f;
+
+	const CascadeState& state = m_cascades[index];
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, XMVector3TransformCoord(worldPosition, XMLoadFloat4x4(&m_lightView)));
+	XMFLOAT3 raster;
+	XMStoreFloat3(&raster, XMVector3TransformCoord(XMLoadFloat3(&p), GetRasterTransform(state)));
+
+	// Bilinear weights between the four nearest texel centers.
+	float fx = raster.x - 0.5f;
+	float fy = raster.y - 0.5f;
+	int32_t x0 = (int32_t)floorf(fx);
+	int32_t y0 = (int32_t)floorf(fy);
+	float wx = fx - x0;
+	float wy = fy - y0;
+	const float depth = p.z - m_desc.DepthBias - m_desc.SlopeBias * state.Cascade.TexelSize;
+	const int32_t res = (int32_t)m_desc.Resolution;
+	float lit[4];
+	for (int32_t i = 0; i < 4; ++i) {
+		int32_t x = x0 + (i & 1);
+		int32_t y = y0 + (i >> 1);
+		if (x < 0 || y < 0 || x >= res || y >= res)
+			lit[i] = 1.0f;
+		else
+			lit[i] = depth <= state.Depth.GetRow(y)[x] ? 1.0f : 0.0f;
+	}
+	return (lit[0] * (1.0f - wx) + lit[1] * wx) * (1.0f - wy) +
+			(lit[2] * (1.0f - wx) + lit[3] * wx) * wy;
+}
+
+} // namespace Zeus
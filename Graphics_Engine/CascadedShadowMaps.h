@@ -0,0 +1,155 @@
+/*
+ * CascadedShadowMaps.h
+ *
+ * Directional light shadows split over up to four cascades.
+ *
+ * Each cascade is fitted to the bounding sphere of its slice of the view
+ * frustum, which only depends on the projection, and its origin is snapped
+ * to whole texels in a fixed light space, so the shadow edges do not
+ * shimmer as the camera moves or turns.
+ *
+ * Casters are culled per cascade in light space, and the cascade depth
+ * range is shrunk to the casters that survive. On the CPU backend every
+ * cascade rasterizes on its own job. Static casters are drawn into a
+ * separate layer that is reused while the cascade stays put and scrolled
+ * when it moves, so only the newly exposed strips are redrawn.
+ *
+ * The CPU depth buffers hold light view space depth, which keeps the
+ * static layer valid whatever the per-frame depth range is.
+ */
+
+#ifndef CASCADEDSHADOWMAPS_H_
+#define CASCADEDSHADOWMAPS_H_
+
+#include "SoftwareRasterizer.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+struct ShadowMapDesc {
+	uint32_t CascadeCount;
+	uint32_t Resolution;
+	// Shadows end here even if the camera sees further.
+	float MaxDistance;
+	// Blend between uniform (0) and logarithmic (1) split distances.
+	float SplitLambda;
+	// Depth bias of SampleShadow(): a constant in world units plus a
+	// number of texels, which covers the depth slope of receivers that are
+	// tilted away from the light.
+	float DepthBias;
+	float SlopeBias;
+};
+
+struct ShadowView {
+	// World to camera view transform of the camera.
+	XMFLOAT4X4 View;
+	float FovY;
+	float AspectRatio;
+	float NearZ;
+	float FarZ;
+	// Direction the light travels in.
+	XMFLOAT3 LightDirection;
+};
+
+struct ShadowCaster {
+	const RasterMesh* Mesh;
+	XMFLOAT4X4 World;
+	// World space bounding sphere.
+	XMFLOAT3 Center;
+	float Radius;
+	bool Static;
+};
+
+struct ShadowCascade {
+	// Light view followed by an orthographic projection over the tight
+	// depth range, for GPU rendering and sampling.
+	XMFLOAT4X4 ViewProjection;
+	float SplitNear;
+	float SplitFar;
+	float DepthNear;
+	float DepthFar;
+	float TexelSize;
+	uint32_t StaticCasters;
+	uint32_t DynamicCasters;
+	// Static casters rasterized this frame; zero when the cache was reused.
+	uint32_t StaticCastersDrawn;
+};
+
+struct ShadowStats {
+	uint32_t CasterCount;
+	uint32_t CulledCasters;
+	uint32_t StaticCacheHits;
+	uint32_t StaticCastersDrawn;
+	uint32_t DynamicCastersDrawn;
+};
+
+class CascadedShadowMaps {
+public:
+	CascadedShadowMaps();
+
+	bool Initialize(const ShadowMapDesc& desc);
+	// Call whenever static casters move, appear or disappear.
+	void InvalidateStaticCasters();
+
+	bool Render(const ShadowView& view, const ShadowCaster* casters, uint32_t count,
+			JobSystem* jobs);
+
+	uint32_t GetCascadeCount() const { return m_desc.CascadeCount; }
+	const ShadowCascade& GetCascade(uint32_t index) const { return m_cascades[index].Cascade; }
+	const DepthBuffer& GetDepth(uint32_t index) const { return m_cascades[index].Depth; }
+	const ShadowStats& GetStats() const { return m_stats; }
+
+	// 1 lit to 0 shadowed, with a bilinear 2x2 comparison filter. viewDepth
+	// is the camera view space depth of the point and picks the cascade.
+	float SampleShadow(FXMVECTOR worldPosition, float viewDepth) const;
+
+private:
+	CascadedShadowMaps(const CascadedShadowMaps&);
+	CascadedShadowMaps& operator=(const CascadedShadowMaps&);
+
+	struct CascadeState {
+		ShadowCascade Cascade;
+		DepthBuffer Depth;
+		DepthBuffer StaticDepth;
+		std::vector<uint32_t> StaticList;
+		std::vector<uint32_t> DynamicList;
+		std::vector<XMFLOAT4> Scratch;
+		// Light space texel coordinates of the left and bottom edges.
+		int64_t OriginX;
+		int64_t OriginY;
+		// What the static layer was drawn with.
+		bool CacheValid;
+		int64_t CacheOriginX;
+		int64_t CacheOriginY;
+		float CacheTexelSize;
+	};
+
+	void FitCascade(uint32_t index, const ShadowView& view, CXMMATRIX cameraToWorld);
+	void CullCasters(uint32_t index, const ShadowCaster* casters, uint32_t count);
+	void RenderCascade(uint32_t index, const ShadowCaster* casters);
+	void UpdateStaticLayer(CascadeState& state, const ShadowCaster* casters);
+	uint32_t DrawCasters(CascadeState& state, DepthBuffer& target, const ScissorRect& scissor,
+			const std::vector<uint32_t>& list, const ShadowCaster* casters);
+	XMMATRIX GetRasterTransform(const CascadeState& state) const;
+
+	ShadowMapDesc m_desc;
+	CascadeState m_cascades[MAX_SHADOW_CASCADES];
+	XMFLOAT4X4 m_lightView;
+	XMFLOAT3 m_lightDirection;
+	// Light space bounding spheres of this frame's casters.
+	std::vector<XMFLOAT4> m_casterBounds;
+	ShadowStats m_stats;
+};
+
+} // namespace Zeus
+
+#endif /* CASCADEDSHADOWMAPS_H_ */
@@ -0,0 +1,330 @@
+/*
+ * ClusteredLighting.cpp
+ *
+ */
+
+#include "ClusteredLighting.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Padding lanes get an interval no sphere can reach.
+const float EMPTY_INTERVAL = 1e30f;
+
+int Clamp(float value, int last) {
+	if (value < 0.0f)
+		return 0;
+	return value >= (float)last ? last : (int)value;
+}
+
+float Distance(float minimum, float maximum, float value) {
+	return std::max(minimum - value, 0.0f) + std::max(value - maximum, 0.0f);
+}
+
+} // namespace
+
+ClusteredLighting::ClusteredLighting()
+		: m_columnGroups(0), m_tanX(0.0f), m_tanY(0.0f), m_sliceScale(0.0f),
+		m_sliceBias(0.0f) {
+	memset(&m_desc, 0, sizeof(m_desc));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool ClusteredLighting::Initialize(const ClusterGridDesc& desc) {
+	if (desc.TilesX == 0 || desc.TilesY == 0 || desc.Slices == 0)
+		return false;
+	// Froxel numbers within a slice share 16 bits with the light index.
+	if (desc.TilesX * desc.TilesY > 65536)
+		return false;
+	if (desc.NearZ <= 0.0f || desc.FarZ <= desc.NearZ || desc.FovY <= 0.0f ||
+			desc.FovY >= XM_PI || desc.AspectRatio <= 0.0f)
+		return false;
+
+	m_desc = desc;
+	m_tanY = tanf(desc.FovY * 0.5f);
+	m_tanX = m_tanY * desc.AspectRatio;
+	m_sliceScale = desc.Slices / log2f(desc.FarZ / desc.NearZ);
+	m_sliceBias = -log2f(desc.NearZ) * m_sliceScale;
+	m_columnGroups = (desc.TilesX + 3) / 4;
+
+	m_sliceNear.resize(desc.Slices);
+	m_sliceFar.resize(desc.Slices);
+	for (uint32_t k = 0; k < desc.Slices; ++k) {
+		m_sliceNear[k] = desc.NearZ * powf(desc.FarZ / desc.NearZ, (float)k / desc.Slices);
+		m_sliceFar[k] = desc.NearZ * powf(desc.FarZ / desc.NearZ, (float)(k + 1) / desc.Slices);
+	}
+	m_sliceFar[desc.Slices - 1] = desc.FarZ;
+
+	// A froxel's x extent is widest at whichever slice plane is further
+	// from the axis, so take the bounds over both.
+	m_columnMin.resize(desc.Slices * m_columnGroups);
+	m_columnMax.resize(desc.Slices * m_columnGroups);
+	for (uint32_t k = 0; k < desc.Slices; ++k) {
+		float zn = m_sliceNear[k];
+		float zf = m_sliceFar[k];
+		for (uint32_t g = 0; g < m_columnGroups; ++g) {
+			float minimum[4];
+			float maximum[4];
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+				uint32_t i = g * 4 + lane;
+				if (i >= desc.TilesX) {
+					minimum[lane] = EMPTY_INTERVAL;
+					maximum[lane] = -EMPTY_INTERVAL;
+					continue;
+				}
+				float left = (-1.0f + 2.0f * i / desc.TilesX) * m_tanX;
+				float right = (-1.0f + 2.0f * (i + 1) / desc.TilesX) * m_tanX;
+				minimum[lane] = std::min(left * zn, left * zf);
+				maximum[lane] = std::max(right * zn, right * zf);
+			}
+			m_columnMin[k * m_columnGroups + g] = XMFLOAT4(minimum);
+			m_columnMax[k * m_columnGroups + g] = XMFLOAT4(maximum);
+		}
+	}
+
+	m_rowMin.resize(desc.Slices * desc.TilesY);
+	m_rowMax.resize(desc.Slices * desc.TilesY);
+	for (uint32_t k = 0; k < desc.Slices; ++k) {
+		float zn = m_sliceNear[k];
+		float zf = m_sliceFar[k];
+		for (uint32_t j = 0; j < desc.TilesY; ++j) {
+			float top = (1.0f - 2.0f * j / desc.TilesY) * m_tanY;
+			float bottom = (1.0f - 2.0f * (j + 1) / desc.TilesY) * m_tanY;
+			m_rowMin[k * desc.TilesY + j] = std::min(bottom * zn, bottom * zf);
+			m_rowMax[k * desc.TilesY + j] = std::max(top * zn, top * zf);
+		}
+	}
+
+	m_sliceItems.resize(desc.Slices);
+	m_sliceIndices.resize(desc.Slices);
+	m_ranges.assign(desc.TilesX * desc.TilesY * desc.Slices, ClusterRange());
+	m_indices.clear();
+	memset(&m_stats, 0, sizeof(m_stats));
+	return true;
+}
+
+bool ClusteredLighting::Build(const ClusterLight* lights, uint32_t count, CXMMATRIX view,
+		JobSystem* jobs) {
+	if (m_ranges.empty() || count > MAX_LIGHTS)
+		return false;
+
+	m_lights.resize(count);
+	m_sinAngles.resize(count);
+	XMMATRIX transform = view;
+	ParallelFor(jobs, count, 1024, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const ClusterLight& light = lights[i];
+			PackedLight& packed = m_lights[i];
+			XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&light.Position), transform);
+			XMStoreFloat4(&packed.PositionRange, XMVectorSetW(position, light.Range));
+			if (light.Type == LIGHT_SPOT) {
+				XMVECTOR direction = XMVector3Normalize(
+						XMVector3TransformNormal(XMLoadFloat3(&light.Direction), transform));
+				XMStoreFloat4(&packed.DirectionCosAngle,
+						XMVectorSetW(direction, cosf(light.SpotAngle)));
+				m_sinAngles[i] = sinf(light.SpotAngle);
+			} else {
+				packed.DirectionCosAngle = XMFLOAT4(0.0f, 0.0f, 1.0f, -1.0f);
+				m_sinAngles[i] = 0.0f;
+			}
+			packed.ColorType = XMFLOAT4(light.Color.x, light.Color.y, light.Color.z,
+					(float)light.Type);
+		}
+	});
+
+	ParallelFor(jobs, m_desc.Slices, 1, [this](uint32_t begin, uint32_t end) {
+		for (uint32_t k = begin; k < end; ++k)
+			BinSlice(k);
+	});
+
+	// Slices were compacted independently; place them one after another.
+	const uint32_t froxelsPerSlice = m_desc.TilesX * m_desc.TilesY;
+	std::vector<uint32_t> sliceOffsets(m_desc.Slices + 1, 0);
+	for (uint32_t k = 0; k < m_desc.Slices; ++k)
+		sliceOffsets[k + 1] = sliceOffsets[k] + (uint32_t)m_sliceIndices[k].size();
+	m_indices.resize(sliceOffsets.back());
+	ParallelFor(jobs, m_desc.Slices, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t k = begin; k < end; ++k) {
+			ClusterRange* ranges = &m_ranges[k * froxelsPerSlice];
+			for (uint32_t f = 0; f < froxelsPerSlice; ++f)
+				ranges[f].Offset += sliceOffsets[k];
+			if (!m_sliceIndices[k].empty())
+				memcpy(&m_indices[sliceOffsets[k]], &m_sliceIndices[k][0],
+						m_sliceIndices[k].size() * sizeof(uint16_t));
+		}
+	});
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.LightCount = count;
+	m_stats.ClusterCount = (uint32_t)m_ranges.size();
+	m_stats.LightReferences = (uint32_t)m_indices.size();
+	for (size_t i = 0; i < m_ranges.size(); ++i) {
+		if (m_ranges[i].Count)
+			++m_stats.OccupiedClusters;
+		m_stats.MaxLightsPerCluster = std::max(m_stats.MaxLightsPerCluster, m_ranges[i].Count);
+	}
+	return true;
+}
+
+void ClusteredLighting::BinSlice(uint32_t slice) {
+	const uint32_t tilesX = m_desc.TilesX;
+	const uint32_t tilesY = m_desc.TilesY;
+	const float zn = m_sliceNear[slice];
+	const float zf = m_sliceFar[slice];
+	const float sliceCenter = (zn + zf) * 0.5f;
+	const float sliceHalf = (zf - zn) * 0.5f;
+	const XMFLOAT4* columnMin = &m_columnMin[slice * m_columnGroups];
+	const XMFLOAT4* columnMax = &m_columnMax[slice * m_columnGroups];
+	const float* rowMin = &m_rowMin[slice * tilesY];
+	const float* rowMax = &m_rowMax[slice * tilesY];
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+
+	std::vector<uint32_t>& items = m_sliceItems[slice];
+	items.clear();
+	for (uint32_t l = 0; l < (uint32_t)m_lights.size(); ++l) {
+		const PackedLight& light = m_lights[l];
+		const float cx = light.PositionRange.x;
+		const float cy = light.PositionRange.y;
+		const float cz = light.PositionRange.z;
+		const float r = light.PositionRange.w;
+		const float r2 = r * r;
+		float dz = Distance(zn, zf, cz);
+		if (dz * dz > r2)
+			continue;
+
+		// Screen extent of the sphere's bounding box within the slice.
+		float z0 = std::max(zn, cz - r);
+		float z1 = std::min(zf, cz + r);
+		float yMax = std::max((cy + r) / z0, (cy + r) / z1);
+		float yMin = std::min((cy - r) / z0, (cy - r) / z1);
+		float xMax = std::max((cx + r) / z1, (cx + r) / z0);
+		float xMin = std::min((cx - r) / z0, (cx - r) / z1);
+		float rowFirst = (1.0f - yMax / m_tanY) * tilesY * 0.5f;
+		float rowLast = (1.0f - yMin / m_tanY) * tilesY * 0.5f;
+		float columnFirst = (xMin / m_tanX + 1.0f) * tilesX * 0.5f;
+		float columnLast = (xMax / m_tanX + 1.0f) * tilesX * 0.5f;
+		if (rowFirst >= (float)tilesY || rowLast < 0.0f || columnFirst >= (float)tilesX ||
+				columnLast < 0.0f)
+			continue;
+		const uint32_t j0 = Clamp(rowFirst, tilesY - 1);
+		const uint32_t j1 = Clamp(rowLast, tilesY - 1);
+		const uint32_t i0 = Clamp(columnFirst, tilesX - 1);
+		const uint32_t i1 = Clamp(columnLast, tilesX - 1);
+
+		const bool spot = light.ColorType.w == (float)LIGHT_SPOT;
+		const XMVECTOR centerX = XMVectorReplicate(cx);
+		const XMVECTOR radius2 = XMVectorReplicate(r2);
+		// Cone test of Wronski, "Cull that cone", against froxel spheres.
+		const XMVECTOR dirX = XMVectorReplicate(light.DirectionCosAngle.x);
+		const XMVECTOR cosAngle = XMVectorReplicate(light.DirectionCosAngle.w);
+		const XMVECTOR sinAngle = XMVectorReplicate(m_sinAngles[l]);
+		const XMVECTOR range = XMVectorReplicate(r);
+		const float vz = sliceCenter - cz;
+
+		for (uint32_t j = j0; j <= j1; ++j) {
+			float dy = Distance(rowMin[j], rowMax[j], cy);
+			float base = dy * dy + dz * dz;
+			if (base > r2)
+				continue;
+			const XMVECTOR baseDistance = XMVectorReplicate(base);
+			float rowCenter = (rowMin[j] + rowMax[j]) * 0.5f;
+			float rowHalf = (rowMax[j] - rowMin[j]) * 0.5f;
+			float vy = rowCenter - cy;
+
+			for (uint32_t g = i0 / 4; g <= i1 / 4; ++g) {
+				XMVECTOR minX = XMLoadFloat4(&columnMin[g]);
+				XMVECTOR maxX = XMLoadFloat4(&columnMax[g]);
+				XMVECTOR dx = XMVectorAdd(XMVectorMax(XMVectorSubtract(minX, centerX), zero),
+						XMVectorMax(XMVectorSubtract(centerX, maxX), zero));
+				XMVECTOR distance2 = XMVectorMultiplyAdd(dx, dx, baseDistance);
+				XMVECTOR hit = XMVectorLessOrEqual(distance2, radius2);
+
+				if (spot) {
+					XMVECTOR froxelX = XMVectorMultiply(XMVectorAdd(minX, maxX), half);
+					XMVECTOR halfX = XMVectorMultiply(XMVectorSubtract(maxX, minX), half);
+					XMVECTOR froxelRadius = XMVectorSqrt(XMVectorMultiplyAdd(halfX, halfX,
+							XMVectorReplicate(rowHalf * rowHalf + sliceHalf * sliceHalf)));
+					XMVECTOR vx = XMVectorSubtract(froxelX, centerX);
+					XMVECTOR lengthSq = XMVectorMultiplyAdd(vx, vx,
+							XMVectorReplicate(vy * vy + vz * vz));
+					XMVECTOR along = XMVectorMultiplyAdd(vx, dirX, XMVectorReplicate(
+							vy * light.DirectionCosAngle.y + vz * light.DirectionCosAngle.z));
+					XMVECTOR across = XMVectorSqrt(XMVectorMax(
+							XMVectorNegativeMultiplySubtract(along, along, lengthSq), zero));
+					XMVECTOR closest = XMVectorSubtract(XMVectorMultiply(cosAngle, across),
+							XMVectorMultiply(along, sinAngle));
+					XMVECTOR inside = XMVectorAndInt(
+							XMVectorLessOrEqual(closest, froxelRadius),
+							XMVectorLessOrEqual(along, XMVectorAdd(froxelRadius, range)));
+					inside = XMVectorAndInt(inside,
+							XMVectorGreaterOrEqual(along, XMVectorNegate(froxelRadius)));
+					hit = XMVectorAndInt(hit, inside);
+				}
+
+				uint32_t mask[4];
+				XMStoreInt4(mask, hit);
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					uint32_t i = g * 4 + lane;
+					if (mask[lane] && i >= i0 && i <= i1)
+						items.push_back((j * tilesX + i) << 16 | l);
+				}
+			}
+		}
+	}
+
+	// Counting sort by froxel; lights stay in ascending order.
+	const uint32_t froxels = tilesX * tilesY;
+	ClusterRange* ranges = &m_ranges[slice * froxels];
+	for (uint32_t f = 0; f < froxels; ++f)
+		ranges[f].Count = 0;
+	for (size_t i = 0; i < items.size(); ++i)
+		++ranges[items[i] >> 16].Count;
+	uint32_t offset = 0;
+	for (uint32_t f = 0; f < froxels; ++f) {
+		ranges[f].Offset = offset;
+		offset += ranges[f].Count;
+	}
+	std::vector<uint16_t>& indices = m_sliceIndices[slice];
+	indices.resize(items.size());
+	std::vector<uint32_t> cursor(froxels);
+	for (uint32_t f = 0; f < froxels; ++f)
+		cursor[f] = ranges[f].Offset;
+	for (size_t i = 0; i < items.size(); ++i)
+		indices[cursor[items[i] >> 16]++] = (uint16_t)(items[i] & 0xFFFF);
+}
+
+uint32_t ClusteredLighting::GetClusterIndex(float u, float v, float viewZ) const {
+	uint32_t i = Clamp(u * m_desc.TilesX, m_desc.TilesX - 1);
+	uint32_t j = Clamp(v * m_desc.TilesY, m_desc.TilesY - 1);
+	uint32_t k = 0;
+	if (viewZ > m_desc.NearZ)
+		k = Clamp(log2f(viewZ) * m_sliceScale + m_sliceBias, m_desc.Slices - 1);
+	return (k * m_desc.TilesY + j) * m_desc.TilesX + i;
+}
+
+bool ClusteredLighting::Upload(RingAllocator& ring, ClusterUpload* upload) const {
+	// Empty buffers still get one element so the views stay valid.
+	uint32_t lightCount = std::max(1u, (uint32_t)m_lights.size());
+	uint32_t indexCount = std::max(1u, (uint32_t)m_indices.size());
+	upload->Lights = ring.AllocateVertices(lightCount, sizeof(PackedLight));
+	upload->Ranges = ring.AllocateVertices((uint32_t)m_ranges.size(), sizeof(ClusterRange));
+	upload->Indices = ring.AllocateIndices(indexCount, FORMAT_R16_UINT);
+	if (!upload->Lights.IsValid() || !upload->Ranges.IsValid() || !upload->Indices.IsValid())
+		return false;
+
+	if (!m_lights.empty())
+		memcpy(upload->Lights.CpuAddress, &m_lights[0], m_lights.size() * sizeof(PackedLight));
+	memcpy(upload->Ranges.CpuAddress, &m_ranges[0], m_ranges.size() * sizeof(ClusterRange));
+	if (!m_indices.empty())
+		memcpy(upload->Indices.CpuAddress, &m_indices[0], m_indices.size() * sizeof(uint16_t));
+	return true;
+}
+
+} // namespace Zeus
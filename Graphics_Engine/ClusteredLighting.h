@@ -0,0 +1,151 @@
+/*
+ * ClusteredLighting.h
+ *
+ * Assigns point and spot lights to a froxel grid: screen tiles split into
+ * exponential depth slices of a left-handed perspective view. Each cluster
+ * gets a compact list of light indices, so shading only loops over the
+ * lights that can reach it.
+ *
+ * Slices are binned in parallel, one job per slice. The froxel bounds are
+ * separable (column, row and slice intervals), so sphere tests run four
+ * columns at a time on xnamath vectors. Spot lights are also tested as
+ * cones against each froxel's bounding sphere.
+ *
+ * The results are read directly by CPU shading and can be copied to a
+ * RingAllocator for the GPU in the same layout.
+ */
+
+#ifndef CLUSTEREDLIGHTING_H_
+#define CLUSTEREDLIGHTING_H_
+
+#include "RingAllocator.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum LightType {
+	LIGHT_POINT,
+	LIGHT_SPOT,
+};
+
+// World space light as submitted by the scene.
+struct ClusterLight {
+	XMFLOAT3 Position;
+	float Range;
+	// Spot lights only: unit direction and half angle of the cone.
+	XMFLOAT3 Direction;
+	float SpotAngle;
+	XMFLOAT3 Color;
+	LightType Type;
+};
+
+// View space light, the element of the GPU light buffer.
+struct PackedLight {
+	// xyz position, w range.
+	XMFLOAT4 PositionRange;
+	// xyz direction, w cosine of the spot angle (-1 for point lights).
+	XMFLOAT4 DirectionCosAngle;
+	// xyz color, w LightType.
+	XMFLOAT4 ColorType;
+};
+
+struct ClusterRange {
+	uint32_t Offset;
+	uint32_t Count;
+};
+
+struct ClusterGridDesc {
+	uint32_t TilesX;
+	uint32_t TilesY;
+	uint32_t Slices;
+	float FovY;
+	float AspectRatio;
+	float NearZ;
+	float FarZ;
+};
+
+struct ClusterStats {
+	uint32_t LightCount;
+	uint32_t ClusterCount;
+	uint32_t OccupiedClusters;
+	uint32_t LightReferences;
+	uint32_t MaxLightsPerCluster;
+};
+
+// GPU copies of the three arrays: PackedLight structured buffer,
+// ClusterRange structured buffer and an R16_UINT index buffer.
+struct ClusterUpload {
+	RingAllocation Lights;
+	RingAllocation Ranges;
+	RingAllocation Indices;
+};
+
+class ClusteredLighting {
+public:
+	// Indices are 16-bit.
+	enum { MAX_LIGHTS = 65535 };
+
+	ClusteredLighting();
+
+	bool Initialize(const ClusterGridDesc& desc);
+
+	// view transforms world to view space. lights beyond MAX_LIGHTS fail.
+	bool Build(const ClusterLight* lights, uint32_t count, CXMMATRIX view, JobSystem* jobs);
+
+	// u and v are normalized screen coordinates with the origin at the top
+	// left; viewZ is clamped to the grid's depth range.
+	uint32_t GetClusterIndex(float u, float v, float viewZ) const;
+	const ClusterRange& GetCluster(uint32_t index) const { return m_ranges[index]; }
+	const uint16_t* GetLightIndices() const { return m_indices.empty() ? nullptr : &m_indices[0]; }
+	const PackedLight* GetLights() const { return m_lights.empty() ? nullptr : &m_lights[0]; }
+	uint32_t GetClusterCount() const { return (uint32_t)m_ranges.size(); }
+	const ClusterGridDesc& GetDesc() const { return m_desc; }
+	const ClusterStats& GetStats() const { return m_stats; }
+
+	// Copies the last Build() into ring. Returns false if the ring is full.
+	bool Upload(RingAllocator& ring, ClusterUpload* upload) const;
+
+private:
+	ClusteredLighting(const ClusteredLighting&);
+	ClusteredLighting& operator=(const ClusteredLighting&);
+
+	void BinSlice(uint32_t slice);
+
+	ClusterGridDesc m_desc;
+	uint32_t m_columnGroups;
+	float m_tanX;
+	float m_tanY;
+	float m_sliceScale;
+	float m_sliceBias;
+
+	// Froxel intervals. Column bounds are grouped four to an XMFLOAT4 per
+	// slice; padding lanes hold empty intervals.
+	std::vector<XMFLOAT4> m_columnMin;
+	std::vector<XMFLOAT4> m_columnMax;
+	std::vector<float> m_rowMin;
+	std::vector<float> m_rowMax;
+	std::vector<float> m_sliceNear;
+	std::vector<float> m_sliceFar;
+
+	std::vector<PackedLight> m_lights;
+	// Per light sine of the spot angle, kept out of the GPU layout.
+	std::vector<float> m_sinAngles;
+	// Per slice (froxel << 16 | light) entries and sorted light indices.
+	std::vector<std::vector<uint32_t> > m_sliceItems;
+	std::vector<std::vector<uint16_t> > m_sliceIndices;
+
+	std::vector<ClusterRange> m_ranges;
+	std::vector<uint16_t> m_indices;
+	ClusterStats m_stats;
+};
+
+} // namespace Zeus
+
+#endif /* CLUSTEREDLIGHTING_H_ */
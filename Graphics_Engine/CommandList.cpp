@@ -0,0 +1,615 @@
+/*
+ * CommandList.cpp
+ *
+ */
+
+#include "CommandList.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Every command starts with this header and is padded to a multiple of
+// eight bytes so the next header stays aligned.
+struct CommandHeader {
+	uint16_t Type;
+	uint16_t Reserved;
+	uint32_t Size;
+};
+
+// Links to the next block, or ends the list when Next is null.
+struct CmdJump {
+	CommandHeader Header;
+	uint8_t* Next;
+};
+
+struct CmdSetRenderTargets {
+	CommandHeader Header;
+	uint32_t Count;
+	ResourceHandle DepthStencil;
+	ResourceHandle Targets[MAX_RENDER_TARGETS];
+};
+
+struct CmdClearRenderTarget {
+	CommandHeader Header;
+	ResourceHandle Target;
+	float Color[4];
+};
+
+struct CmdClearDepthStencil {
+	CommandHeader Header;
+	ResourceHandle DepthStencil;
+	uint32_t Flags;
+	float Depth;
+	uint32_t Stencil;
+};
+
+struct CmdSetViewport {
+	CommandHeader Header;
+	Viewport Value;
+};
+
+struct CmdSetScissor {
+	CommandHeader Header;
+	ScissorRect Value;
+};
+
+struct CmdSetShaders {
+	CommandHeader Header;
+	ResourceHandle VertexShader;
+	ResourceHandle PixelShader;
+};
+
+struct CmdSetBlendState {
+	CommandHeader Header;
+	uint32_t State;
+	float BlendFactor[4];
+};
+
+struct CmdSetState {
+	CommandHeader Header;
+	uint32_t State;
+	uint32_t Reference;
+};
+
+// Followed by Count handles.
+struct CmdSetSlots {
+	CommandHeader Header;
+	uint32_t Stage;
+	uint32_t Slot;
+	uint32_t Count;
+};
+
+// Followed by Count buffers, Count strides and Count offsets.
+struct CmdSetVertexBuffers {
+	CommandHeader Header;
+	uint32_t Slot;
+	uint32_t Count;
+};
+
+struct CmdSetIndexBuffer {
+	CommandHeader Header;
+	ResourceHandle Buffer;
+	uint32_t Format;
+	uint32_t Offset;
+};
+
+struct CmdSetConstantBuffer {
+	CommandHeader Header;
+	uint32_t Stage;
+	uint32_t Slot;
+	ResourceHandle Buffer;
+	uint32_t Offset;
+	uint32_t Size;
+};
+
+// Followed by Size bytes of data.
+struct CmdUpdateBuffer {
+	CommandHeader Header;
+	ResourceHandle Buffer;
+	uint32_t Offset;
+	uint32_t Size;
+};
+
+struct CmdDraw {
+	CommandHeader Header;
+	uint32_t VertexCount;
+	uint32_t StartVertex;
+	uint32_t InstanceCount;
+	uint32_t StartInstance;
+};
+
+struct CmdDrawIndexed {
+	CommandHeader Header;
+	uint32_t IndexCount;
+	uint32_t StartIndex;
+	int32_t BaseVertex;
+	uint32_t InstanceCount;
+	uint32_t StartInstance;
+};
+
+struct CmdDispatch {
+	CommandHeader Header;
+	uint32_t X;
+	uint32_t Y;
+	uint32_t Z;
+};
+
+// Followed by the null-terminated name.
+struct CmdMarker {
+	CommandHeader Header;
+};
+
+inline uint32_t AlignCommand(size_t size) {
+	return (uint32_t)((size + 7) & ~(size_t)7);
+}
+
+const uint32_t JUMP_SIZE = AlignCommand(sizeof(CmdJump));
+
+template <typename T>
+inline const T* As(const uint8_t* command) {
+	return reinterpret_cast<const T*>(command);
+}
+
+} // namespace
+
+CommandAllocator::CommandAllocator()
+		: m_memory(nullptr), m_blockSize(0), m_blockCount(0), m_nextBlock(0) {
+}
+
+CommandAllocator::~CommandAllocator() {
+	Shutdown();
+}
+
+bool CommandAllocator::Initialize(size_t totalBytes, uint32_t blockSize) {
+	Shutdown();
+	blockSize = AlignCommand(blockSize);
+	if (blockSize < 4 * JUMP_SIZE || totalBytes < blockSize)
+		return false;
+
+	m_blockSize = blockSize;
+	m_blockCount = (uint32_t)(totalBytes / blockSize);
+	m_memory = new uint8_t[(size_t)m_blockSize * m_blockCount];
+	m_nextBlock.store(0);
+	return true;
+}
+
+void CommandAllocator::Shutdown() {
+	Reset();
+	delete[] m_memory;
+	m_memory = nullptr;
+	m_blockSize = 0;
+	m_blockCount = 0;
+	for (size_t i = 0; i < m_heapBlocks.size(); ++i)
+		delete[] m_heapBlocks[i];
+	m_heapBlocks.clear();
+}
+
+void CommandAllocator::Reset() {
+	m_nextBlock.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < m_largeBlocks.size(); ++i)
+		delete[] m_largeBlocks[i];
+	m_largeBlocks.clear();
+}
+
+uint8_t* CommandAllocator::AllocateBlock() {
+	uint32_t block = m_nextBlock.fetch_add(1, std::memory_order_relaxed);
+	if (block < m_blockCount)
+		return m_memory + (size_t)block * m_blockSize;
+	// Racing threads may skip past the end of the list, so fill the gap.
+	std::lock_guard<std::mutex> lock(m_heapMutex);
+	while (m_heapBlocks.size() <= block - m_blockCount)
+		m_heapBlocks.push_back(new uint8_t[m_blockSize]);
+	return m_heapBlocks[block - m_blockCount];
+}
+
+uint8_t* CommandAllocator::AllocateLargeBlock(size_t size) {
+	std::lock_guard<std::mutex> lock(m_heapMutex);
+	m_largeBlocks.push_back(new uint8_t[size]);
+	return m_largeBlocks.back();
+}
+
+uint32_t CommandAllocator::GetBlocksUsed() const {
+	return m_nextBlock.load(std::memory_order_relaxed);
+}
+
+uint32_t CommandAllocator::GetHeapBlockCount() const {
+	std::lock_guard<std::mutex> lock(m_heapMutex);
+	return (uint32_t)(m_heapBlocks.size() + m_largeBlocks.size());
+}
+
+CommandList::CommandList()
+		: m_allocator(nullptr), m_first(nullptr), m_block(nullptr), m_blockSize(0), m_used(0),
+		m_order(0), m_commandCount(0), m_bytes(0), m_recording(false) {
+}
+
+void CommandList::Begin(CommandAllocator* allocator, uint32_t order) {
+	assert(allocator && !m_recording);
+	m_allocator = allocator;
+	m_first = nullptr;
+	m_block = nullptr;
+	m_blockSize = 0;
+	m_used = 0;
+	m_order = order;
+	m_commandCount = 0;
+	m_bytes = 0;
+	m_recording = true;
+}
+
+void CommandList::End() {
+	assert(m_recording);
+	if (m_block) {
+		CmdJump* end = reinterpret_cast<CmdJump*>(m_block + m_used);
+		end->Header.Type = CMD_JUMP;
+		end->Header.Reserved = 0;
+		end->Header.Size = JUMP_SIZE;
+		end->Next = nullptr;
+		m_bytes += JUMP_SIZE;
+	}
+	m_recording = false;
+}
+
+// Every block keeps JUMP_SIZE bytes spare so it can always be linked to the
+// next block or terminated by End().
+void* CommandList::Allocate(CommandType type, uint32_t size) {
+	assert(m_recording);
+	size = AlignCommand(size);
+	if (!m_block || m_used + size + JUMP_SIZE > m_blockSize) {
+		uint32_t blockSize = m_allocator->GetBlockSize();
+		uint8_t* next;
+		if (size + JUMP_SIZE <= blockSize) {
+			next = m_allocator->AllocateBlock();
+		} else {
+			blockSize = size + JUMP_SIZE;
+			next = m_allocator->AllocateLargeBlock(blockSize);
+		}
+		if (m_block) {
+			CmdJump* jump = reinterpret_cast<CmdJump*>(m_block + m_used);
+			jump->Header.Type = CMD_JUMP;
+			jump->Header.Reserved = 0;
+			jump->Header.Size = JUMP_SIZE;
+			jump->Next = next;
+			m_bytes += JUMP_SIZE;
+		} else {
+			m_first = next;
+		}
+		m_block = next;
+		m_blockSize = blockSize;
+		m_used = 0;
+	}
+
+	CommandHeader* header = reinterpret_cast<CommandHeader*>(m_block + m_used);
+	header->Type = (uint16_t)type;
+	header->Reserved = 0;
+	header->Size = size;
+	m_used += size;
+	m_bytes += size;
+	++m_commandCount;
+	return header;
+}
+
+void CommandList::SetRenderTargets(uint32_t count, const ResourceHandle* targets,
+		ResourceHandle depthStencil) {
+	assert(count <= MAX_RENDER_TARGETS);
+	CmdSetRenderTargets* cmd = static_cast<CmdSetRenderTargets*>(
+			Allocate(CMD_SET_RENDER_TARGETS, sizeof(CmdSetRenderTargets)));
+	cmd->Count = count;
+	cmd->DepthStencil = depthStencil;
+	for (uint32_t i = 0; i < MAX_RENDER_TARGETS; ++i)
+		cmd->Targets[i] = i < count ? targets[i] : NULL_RESOURCE;
+}
+
+void CommandList::ClearRenderTarget(ResourceHandle target, const float color[4]) {
+	CmdClearRenderTarget* cmd = static_cast<CmdClearRenderTarget*>(
+			Allocate(CMD_CLEAR_RENDER_TARGET, sizeof(CmdClearRenderTarget)));
+	cmd->Target = target;
+	memcpy(cmd->Color, color, sizeof(cmd->Color));
+}
+
+void CommandList::ClearDepthStencil(ResourceHandle depthStencil, uint32_t flags, float depth,
+		uint8_t stencil) {
+	CmdClearDepthStencil* cmd = static_cast<CmdClearDepthStencil*>(
+			Allocate(CMD_CLEAR_DEPTH_STENCIL, sizeof(CmdClearDepthStencil)));
+	cmd->DepthStencil = depthStencil;
+	cmd->Flags = flags;
+	cmd->Depth = depth;
+	cmd->Stencil = stencil;
+}
+
+void CommandList::SetViewport(const Viewport& viewport) {
+	CmdSetViewport* cmd = static_cast<CmdSetViewport*>(
+			Allocate(CMD_SET_VIEWPORT, sizeof(CmdSetViewport)));
+	cmd->Value = viewport;
+}
+
+void CommandList::SetScissor(const ScissorRect& rect) {
+	CmdSetScissor* cmd = static_cast<CmdSetScissor*>(
+			Allocate(CMD_SET_SCISSOR, sizeof(CmdSetScissor)));
+	cmd->Value = rect;
+}
+
+void CommandList::SetShaders(ResourceHandle vertexShader, ResourceHandle pixelShader) {
+	CmdSetShaders* cmd = static_cast<CmdSetShaders*>(
+			Allocate(CMD_SET_SHADERS, sizeof(CmdSetShaders)));
+	cmd->VertexShader = vertexShader;
+	cmd->PixelShader = pixelShader;
+}
+
+void CommandList::SetBlendState(uint32_t state, const float blendFactor[4]) {
+	CmdSetBlendState* cmd = static_cast<CmdSetBlendState*>(
+			Allocate(CMD_SET_BLEND_STATE, sizeof(CmdSetBlendState)));
+	cmd->State = state;
+	for (int i = 0; i < 4; ++i)
+		cmd->BlendFactor[i] = blendFactor ? blendFactor[i] : 1.0f;
+}
+
+void CommandList::SetRasterizerState(uint32_t state) {
+	CmdSetState* cmd = static_cast<CmdSetState*>(
+			Allocate(CMD_SET_RASTERIZER_STATE, sizeof(CmdSetState)));
+	cmd->State = state;
+	cmd->Reference = 0;
+}
+
+void CommandList::SetDepthStencilState(uint32_t state, uint32_t stencilRef) {
+	CmdSetState* cmd = static_cast<CmdSetState*>(
+			Allocate(CMD_SET_DEPTH_STENCIL_STATE, sizeof(CmdSetState)));
+	cmd->State = state;
+	cmd->Reference = stencilRef;
+}
+
+void CommandList::SetSamplers(ShaderStage stage, uint32_t slot, uint32_t count,
+		const uint32_t* samplers) {
+	assert(count <= MAX_SHADER_RESOURCES);
+	CmdSetSlots* cmd = static_cast<CmdSetSlots*>(Allocate(CMD_SET_SAMPLERS,
+			sizeof(CmdSetSlots) + count * sizeof(uint32_t)));
+	cmd->Stage = stage;
+	cmd->Slot = slot;
+	cmd->Count = count;
+	memcpy(cmd + 1, samplers, count * sizeof(uint32_t));
+}
+
+void CommandList::SetVertexBuffers(uint32_t slot, uint32_t count,
+		const ResourceHandle* buffers, const uint32_t* strides, const uint32_t* offsets) {
+	assert(count <= MAX_VERTEX_STREAMS);
+	CmdSetVertexBuffers* cmd = static_cast<CmdSetVertexBuffers*>(Allocate(
+			CMD_SET_VERTEX_BUFFERS, sizeof(CmdSetVertexBuffers) + 3 * count * sizeof(uint32_t)));
+	cmd->Slot = slot;
+	cmd->Count = count;
+	uint32_t* data = reinterpret_cast<uint32_t*>(cmd + 1);
+	memcpy(data, buffers, count * sizeof(uint32_t));
+	memcpy(data + count, strides, count * sizeof(uint32_t));
+	if (offsets)
+		memcpy(data + 2 * count, offsets, count * sizeof(uint32_t));
+	else
+		memset(data + 2 * count, 0, count * sizeof(uint32_t));
+}
+
+void CommandList::SetIndexBuffer(ResourceHandle buffer, Format format, uint32_t offset) {
+	CmdSetIndexBuffer* cmd = static_cast<CmdSetIndexBuffer*>(
+			Allocate(CMD_SET_INDEX_BUFFER, sizeof(CmdSetIndexBuffer)));
+	cmd->Buffer = buffer;
+	cmd->Format = format;
+	cmd->Offset = offset;
+}
+
+void CommandList::SetPrimitiveTopology(PrimitiveTopology topology) {
+	CmdSetState* cmd = static_cast<CmdSetState*>(
+			Allocate(CMD_SET_TOPOLOGY, sizeof(CmdSetState)));
+	cmd->State = topology;
+	cmd->Reference = 0;
+}
+
+void CommandList::SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceHandle buffer,
+		uint32_t offset, uint32_t size) {
+	CmdSetConstantBuffer* cmd = static_cast<CmdSetConstantBuffer*>(
+			Allocate(CMD_SET_CONSTANT_BUFFER, sizeof(CmdSetConstantBuffer)));
+	cmd->Stage = stage;
+	cmd->Slot = slot;
+	cmd->Buffer = buffer;
+	cmd->Offset = offset;
+	cmd->Size = size;
+}
+
+void CommandList::SetShaderResources(ShaderStage stage, uint32_t slot, uint32_t count,
+		const ResourceHandle* views) {
+	assert(count <= MAX_SHADER_RESOURCES);
+	CmdSetSlots* cmd = static_cast<CmdSetSlots*>(Allocate(CMD_SET_SHADER_RESOURCES,
+			sizeof(CmdSetSlots) + count * sizeof(ResourceHandle)));
+	cmd->Stage = stage;
+	cmd->Slot = slot;
+	cmd->Count = count;
+	memcpy(cmd + 1, views, count * sizeof(ResourceHandle));
+}
+
+void CommandList::UpdateBuffer(ResourceHandle buffer, uint32_t offset, const void* data,
+		uint32_t size) {
+	CmdUpdateBuffer* cmd = static_cast<CmdUpdateBuffer*>(
+			Allocate(CMD_UPDATE_BUFFER, sizeof(CmdUpdateBuffer) + size));
+	cmd->Buffer = buffer;
+	cmd->Offset = offset;
+	cmd->Size = size;
+	memcpy(cmd + 1, data, size);
+}
+
+void CommandList::Draw(uint32_t vertexCount, uint32_t startVertex, uint32_t instanceCount,
+		uint32_t startInstance) {
+	CmdDraw* cmd = static_cast<CmdDraw*>(Allocate(CMD_DRAW, sizeof(CmdDraw)));
+	cmd->VertexCount = vertexCount;
+	cmd->StartVertex = startVertex;
+	cmd->InstanceCount = instanceCount;
+	cmd->StartInstance = startInstance;
+}
+
+void CommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex,
+		uint32_t instanceCount, uint32_t startInstance) {
+	CmdDrawIndexed* cmd = static_cast<CmdDrawIndexed*>(
+			Allocate(CMD_DRAW_INDEXED, sizeof(CmdDrawIndexed)));
+	cmd->IndexCount = indexCount;
+	cmd->StartIndex = startIndex;
+	cmd->BaseVertex = baseVertex;
+	cmd->InstanceCount = instanceCount;
+	cmd->StartInstance = startInstance;
+}
+
+void CommandList::Dispatch(uint32_t x, uint32_t y, uint32_t z) {
+	CmdDispatch* cmd = static_cast<CmdDispatch*>(Allocate(CMD_DISPATCH, sizeof(CmdDispatch)));
+	cmd->X = x;
+	cmd->Y = y;
+	cmd->Z = z;
+}
+
+void CommandList::BeginMarker(const char* name) {
+	size_t length = strlen(name);
+	CmdMarker* cmd = static_cast<CmdMarker*>(
+			Allocate(CMD_BEGIN_MARKER, (uint32_t)(sizeof(CmdMarker) + length + 1)));
+	memcpy(cmd + 1, name, length + 1);
+}
+
+void CommandList::EndMarker() {
+	Allocate(CMD_END_MARKER, sizeof(CmdMarker));
+}
+
+void CommandList::Replay(CommandBackend& backend) const {
+	assert(!m_recording);
+	backend.BeginCommandList(m_order);
+
+	const uint8_t* command = m_first;
+	while (command) {
+		const CommandHeader* header = As<CommandHeader>(command);
+		switch (header->Type) {
+		case CMD_JUMP:
+			command = As<CmdJump>(command)->Next;
+			continue;
+		case CMD_SET_RENDER_TARGETS: {
+			const CmdSetRenderTargets* cmd = As<CmdSetRenderTargets>(command);
+			backend.SetRenderTargets(cmd->Count, cmd->Targets, cmd->DepthStencil);
+			break;
+		}
+		case CMD_CLEAR_RENDER_TARGET: {
+			const CmdClearRenderTarget* cmd = As<CmdClearRenderTarget>(command);
+			backend.ClearRenderTarget(cmd->Target, cmd->Color);
+			break;
+		}
+		case CMD_CLEAR_DEPTH_STENCIL: {
+			const CmdClearDepthStencil* cmd = As<CmdClearDepthStencil>(command);
+			backend.ClearDepthStencil(cmd->DepthStencil, cmd->Flags, cmd->Depth,
+					(uint8_t)cmd->Stencil);
+			break;
+		}
+		case CMD_SET_VIEWPORT:
+			backend.SetViewport(As<CmdSetViewport>(command)->Value);
+			break;
+		case CMD_SET_SCISSOR:
+			backend.SetScissor(As<CmdSetScissor>(command)->Value);
+			break;
+		case CMD_SET_SHADERS: {
+			const CmdSetShaders* cmd = As<CmdSetShaders>(command);
+			backend.SetShaders(cmd->VertexShader, cmd->PixelShader);
+			break;
+		}
+		case CMD_SET_BLEND_STATE: {
+			const CmdSetBlendState* cmd = As<CmdSetBlendState>(command);
+			backend.SetBlendState(cmd->State, cmd->BlendFactor);
+			break;
+		}
+		case CMD_SET_RASTERIZER_STATE:
+			backend.SetRasterizerState(As<CmdSetState>(command)->State);
+			break;
+		case CMD_SET_DEPTH_STENCIL_STATE: {
+			const CmdSetState* cmd = As<CmdSetState>(command);
+			backend.SetDepthStencilState(cmd->State, cmd->Reference);
+			break;
+		}
+		case CMD_SET_SAMPLERS: {
+			const CmdSetSlots* cmd = As<CmdSetSlots>(command);
+			backend.SetSamplers((ShaderStage)cmd->Stage, cmd->Slot, cmd->Count,
+					reinterpret_cast<const uint32_t*>(cmd + 1));
+			break;
+		}
+		case CMD_SET_VERTEX_BUFFERS: {
+			const CmdSetVertexBuffers* cmd = As<CmdSetVertexBuffers>(command);
+			const uint32_t* data = reinterpret_cast<const uint32_t*>(cmd + 1);
+			backend.SetVertexBuffers(cmd->Slot, cmd->Count, data, data + cmd->Count,
+					data + 2 * cmd->Count);
+			break;
+		}
+		case CMD_SET_INDEX_BUFFER: {
+			const CmdSetIndexBuffer* cmd = As<CmdSetIndexBuffer>(command);
+			backend.SetIndexBuffer(cmd->Buffer, (Format)cmd->Format, cmd->Offset);
+			break;
+		}
+		case CMD_SET_TOPOLOGY:
+			backend.SetPrimitiveTopology((PrimitiveTopology)As<CmdSetState>(command)->State);
+			break;
+		case CMD_SET_CONSTANT_BUFFER: {
+			const CmdSetConstantBuffer* cmd = As<CmdSetConstantBuffer>(command);
+			backend.SetConstantBuffer((ShaderStage)cmd->Stage, cmd->Slot, cmd->Buffer,
+					cmd->Offset, cmd->Size);
+			break;
+		}
+		case CMD_SET_SHADER_RESOURCES: {
+			const CmdSetSlots* cmd = As<CmdSetSlots>(command);
+			backend.SetShaderResources((ShaderStage)cmd->Stage, cmd->Slot, cmd->Count,
+					reinterpret_cast<const ResourceHandle*>(cmd + 1));
+			break;
+		}
+		case CMD_UPDATE_BUFFER: {
+			const CmdUpdateBuffer* cmd = As<CmdUpdateBuffer>(command);
+			backend.UpdateBuffer(cmd->Buffer, cmd->Offset, cmd + 1, cmd->Size);
+			break;
+		}
+		case CMD_DRAW: {
+			const CmdDraw* cmd = As<CmdDraw>(command);
+			backend.Draw(cmd->VertexCount, cmd->StartVertex, cmd->InstanceCount,
+					cmd->StartInstance);
+			break;
+		}
+		case CMD_DRAW_INDEXED: {
+			const CmdDrawIndexed* cmd = As<CmdDrawIndexed>(command);
+			backend.DrawIndexed(cmd->IndexCount, cmd->StartIndex, cmd->BaseVertex,
+					cmd->InstanceCount, cmd->StartInstance);
+			break;
+		}
+		case CMD_DISPATCH: {
+			const CmdDispatch* cmd = As<CmdDispatch>(command);
+			backend.Dispatch(cmd->X, cmd->Y, cmd->Z);
+			break;
+		}
+		case CMD_BEGIN_MARKER:
+			backend.BeginMarker(reinterpret_cast<const char*>(As<CmdMarker>(command) + 1));
+			break;
+		case CMD_END_MARKER:
+			backend.EndMarker();
+			break;
+		default:
+			assert(!"corrupt command list");
+			command = nullptr;
+			continue;
+		}
+		command += header->Size;
+	}
+
+	backend.EndCommandList();
+}
+
+void ExecuteCommandLists(CommandList** lists, uint32_t count, CommandBackend& backend) {
+	// Insertion sort: stable, allocation-free, and the number of lists per
+	// frame is small.
+	for (uint32_t i = 1; i < count; ++i) {
+		CommandList* list = lists[i];
+		uint32_t j = i;
+		while (j > 0 && lists[j - 1]->GetOrder() > list->GetOrder()) {
+			lists[j] = lists[j - 1];
+			--j;
+		}
+		lists[j] = list;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+		lists[i]->Replay(backend);
+}
+
+} // namespace Zeus
@@ -0,0 +1,259 @@
+/*
+ * CommandList.h
+ *
+ * Engine command buffers, modeled on D3D11 deferred contexts. Each worker
+ * thread records into its own CommandList; the lists are then merged in
+ * order of their sort key and replayed against a CommandBackend, in the
+ * way ExecuteCommandList plays deferred work on the immediate context.
+ *
+ * Commands are written into fixed-size blocks handed out by a
+ * CommandAllocator whose memory is reserved once up front, so recording
+ * normally never touches the heap. A dropped command could leave state set
+ * without its draw or a marker open, so nothing is ever dropped instead:
+ * when the reservation runs dry the allocator grows by heap blocks, which
+ * it keeps for later frames, and a command larger than a block gets a heap
+ * block of its own until Reset. GetHeapBlockCount() tells when to reserve
+ * more.
+ */
+
+#ifndef COMMANDLIST_H_
+#define COMMANDLIST_H_
+
+#include "Format.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Zeus {
+
+typedef uint32_t ResourceHandle;
+const ResourceHandle NULL_RESOURCE = 0;
+
+enum ShaderStage {
+	STAGE_VERTEX = 0,
+	STAGE_PIXEL,
+	STAGE_COMPUTE,
+	STAGE_COUNT
+};
+
+// Values match D3D11_PRIMITIVE_TOPOLOGY.
+enum PrimitiveTopology {
+	TOPOLOGY_UNDEFINED = 0,
+	TOPOLOGY_POINTLIST = 1,
+	TOPOLOGY_LINELIST = 2,
+	TOPOLOGY_LINESTRIP = 3,
+	TOPOLOGY_TRIANGLELIST = 4,
+	TOPOLOGY_TRIANGLESTRIP = 5
+};
+
+enum ClearFlags {
+	CLEAR_DEPTH = 0x1,
+	CLEAR_STENCIL = 0x2
+};
+
+// Same layout as D3D11_VIEWPORT.
+struct Viewport {
+	float TopLeftX;
+	float TopLeftY;
+	float Width;
+	float Height;
+	float MinDepth;
+	float MaxDepth;
+};
+
+// Same layout as D3D11_RECT.
+struct ScissorRect {
+	int32_t Left;
+	int32_t Top;
+	int32_t Right;
+	int32_t Bottom;
+};
+
+enum {
+	MAX_RENDER_TARGETS = 8,
+	MAX_VERTEX_STREAMS = 16,
+	MAX_SHADER_RESOURCES = 16
+};
+
+enum CommandType {
+	CMD_JUMP = 0,
+	CMD_SET_RENDER_TARGETS,
+	CMD_CLEAR_RENDER_TARGET,
+	CMD_CLEAR_DEPTH_STENCIL,
+	CMD_SET_VIEWPORT,
+	CMD_SET_SCISSOR,
+	CMD_SET_SHADERS,
+	CMD_SET_BLEND_STATE,
+	CMD_SET_RASTERIZER_STATE,
+	CMD_SET_DEPTH_STENCIL_STATE,
+	CMD_SET_SAMPLERS,
+	CMD_SET_VERTEX_BUFFERS,
+	CMD_SET_INDEX_BUFFER,
+	CMD_SET_TOPOLOGY,
+	CMD_SET_CONSTANT_BUFFER,
+	CMD_SET_SHADER_RESOURCES,
+	CMD_UPDATE_BUFFER,
+	CMD_DRAW,
+	CMD_DRAW_INDEXED,
+	CMD_DISPATCH,
+	CMD_BEGIN_MARKER,
+	CMD_END_MARKER,
+	CMD_COUNT
+};
+
+// Receives decoded commands during replay. The CPU rasterizer and the GPU
+// backends implement this; lists never inherit state from one another, so
+// a backend should restore its defaults in BeginCommandList.
+class CommandBackend {
+public:
+	virtual ~CommandBackend() {}
+
+	virtual void BeginCommandList(uint32_t order) { (void)order; }
+	virtual void EndCommandList() {}
+
+	virtual void SetRenderTargets(uint32_t count, const ResourceHandle* targets,
+			ResourceHandle depthStencil) = 0;
+	virtual void ClearRenderTarget(ResourceHandle target, const float color[4]) = 0;
+	virtual void ClearDepthStencil(ResourceHandle depthStencil, uint32_t flags,
+			float depth, uint8_t stencil) = 0;
+	virtual void SetViewport(const Viewport& viewport) = 0;
+	virtual void SetScissor(const ScissorRect& rect) = 0;
+	virtual void SetShaders(ResourceHandle vertexShader, ResourceHandle pixelShader) = 0;
+	virtual void SetBlendState(uint32_t state, const float blendFactor[4]) = 0;
+	virtual void SetRasterizerState(uint32_t state) = 0;
+	virtual void SetDepthStencilState(uint32_t state, uint32_t stencilRef) = 0;
+	virtual void SetSamplers(ShaderStage stage, uint32_t slot, uint32_t count,
+			const uint32_t* samplers) = 0;
+	virtual void SetVertexBuffers(uint32_t slot, uint32_t count, const ResourceHandle* buffers,
+			const uint32_t* strides, const uint32_t* offsets) = 0;
+	virtual void SetIndexBuffer(ResourceHandle buffer, Format format, uint32_t offset) = 0;
+	virtual void SetPrimitiveTopology(PrimitiveTopology topology) = 0;
+	virtual void SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceHandle buffer,
+			uint32_t offset, uint32_t size) = 0;
+	virtual void SetShaderResources(ShaderStage stage, uint32_t slot, uint32_t count,
+			const ResourceHandle* views) = 0;
+	virtual void UpdateBuffer(ResourceHandle buffer, uint32_t offset, const void* data,
+			uint32_t size) = 0;
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex, uint32_t instanceCount,
+			uint32_t startInstance) = 0;
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex,
+			uint32_t instanceCount, uint32_t startInstance) = 0;
+	virtual void Dispatch(uint32_t x, uint32_t y, uint32_t z) = 0;
+	virtual void BeginMarker(const char* name) { (void)name; }
+	virtual void EndMarker() {}
+};
+
+// Hands out fixed-size blocks of one up-front reservation, then of the
+// heap once it runs dry. Any number of threads may allocate concurrently;
+// Reset must only be called once every list recorded from the allocator
+// has been replayed.
+class CommandAllocator {
+public:
+	enum { DEFAULT_BLOCK_SIZE = 64 * 1024 };
+
+	CommandAllocator();
+	~CommandAllocator();
+
+	bool Initialize(size_t totalBytes, uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+	void Shutdown();
+	// Keeps the heap blocks of the fixed size for the next frame and frees
+	// the larger ones.
+	void Reset();
+
+	uint8_t* AllocateBlock();
+	// For a single command larger than a block.
+	uint8_t* AllocateLargeBlock(size_t size);
+
+	uint32_t GetBlockSize() const { return m_blockSize; }
+	uint32_t GetBlockCount() const { return m_blockCount; }
+	// Blocks of the fixed size used since Reset, from the heap or not.
+	uint32_t GetBlocksUsed() const;
+	// Blocks ever taken from the heap and still held; above zero the
+	// reservation is too small.
+	uint32_t GetHeapBlockCount() const;
+
+private:
+	CommandAllocator(const CommandAllocator&);
+	CommandAllocator& operator=(const CommandAllocator&);
+
+	uint8_t* m_memory;
+	uint32_t m_blockSize;
+	uint32_t m_blockCount;
+	std::atomic<uint32_t> m_nextBlock;
+	// Guards the heap blocks, which only a frame that outgrows the
+	// reservation touches.
+	mutable std::mutex m_heapMutex;
+	std::vector<uint8_t*> m_heapBlocks;
+	std::vector<uint8_t*> m_largeBlocks;
+};
+
+class CommandList {
+public:
+	CommandList();
+
+	// Lists are merged in ascending order; equal orders keep the order in
+	// which they were passed to ExecuteCommandLists.
+	void Begin(CommandAllocator* allocator, uint32_t order);
+	void End();
+
+	uint32_t GetOrder() const { return m_order; }
+	uint32_t GetCommandCount() const { return m_commandCount; }
+	size_t GetSizeInBytes() const { return m_bytes; }
+
+	void SetRenderTargets(uint32_t count, const ResourceHandle* targets,
+			ResourceHandle depthStencil);
+	void ClearRenderTarget(ResourceHandle target, const float color[4]);
+	void ClearDepthStencil(ResourceHandle depthStencil, uint32_t flags, float depth,
+			uint8_t stencil);
+	void SetViewport(const Viewport& viewport);
+	void SetScissor(const ScissorRect& rect);
+	void SetShaders(ResourceHandle vertexShader, ResourceHandle pixelShader);
+	void SetBlendState(uint32_t state, const float blendFactor[4]);
+	void SetRasterizerState(uint32_t state);
+	void SetDepthStencilState(uint32_t state, uint32_t stencilRef);
+	void SetSamplers(ShaderStage stage, uint32_t slot, uint32_t count, const uint32_t* samplers);
+	void SetVertexBuffers(uint32_t slot, uint32_t count, const ResourceHandle* buffers,
+			const uint32_t* strides, const uint32_t* offsets);
+	void SetIndexBuffer(ResourceHandle buffer, Format format, uint32_t offset);
+	void SetPrimitiveTopology(PrimitiveTopology topology);
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceHandle buffer,
+			uint32_t offset, uint32_t size);
+	void SetShaderResources(ShaderStage stage, uint32_t slot, uint32_t count,
+			const ResourceHandle* views);
+	// The data is copied into the list.
+	void UpdateBuffer(ResourceHandle buffer, uint32_t offset, const void* data, uint32_t size);
+	void Draw(uint32_t vertexCount, uint32_t startVertex, uint32_t instanceCount = 1,
+			uint32_t startInstance = 0);
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex,
+			uint32_t instanceCount = 1, uint32_t startInstance = 0);
+	void Dispatch(uint32_t x, uint32_t y, uint32_t z);
+	void BeginMarker(const char* name);
+	void EndMarker();
+
+	void Replay(CommandBackend& backend) const;
+
+private:
+	void* Allocate(CommandType type, uint32_t size);
+
+	CommandAllocator* m_allocator;
+	uint8_t* m_first;
+	uint8_t* m_block;
+	// Size of the current block; larger for a large command's own block.
+	uint32_t m_blockSize;
+	uint32_t m_used;
+	uint32_t m_order;
+	uint32_t m_commandCount;
+	size_t m_bytes;
+	bool m_recording;
+};
+
+// Replays the lists in a deterministic order regardless of which thread
+// finished recording first. Sorts the caller's array in place.
+void ExecuteCommandLists(CommandList** lists, uint32_t count, CommandBackend& backend);
+
+} // namespace Zeus
+
+#endif /* COMMANDLIST_H_ */
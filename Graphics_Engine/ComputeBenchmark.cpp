@@ -0,0 +1,143 @@
+/*
+ * ComputeBenchmark.cpp
+ *
+ */
+
+#include "ComputeBenchmark.h"
+#include "ComputeFFT.h"
+#include "ComputeScan.h"
+#include "Timer.h"
+
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t SCAN_SIZE = 1024 * 1024;
+const uint32_t MULTISCAN_SIZE = 1024;
+const uint32_t MULTISCAN_COUNT = 1024;
+const uint32_t SEGMENT_LENGTH = 1000;
+const uint32_t FFT_1D_SIZE = 64 * 1024;
+const uint32_t FFT_2D_SIZE = 512;
+
+// Deterministic input so CPU runs are comparable between machines.
+uint32_t NextRandom(uint32_t& state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+template <typename Kernel>
+double Time(uint32_t iterations, bool& ok, const Kernel& kernel) {
+	// One untimed run warms caches and the job system.
+	ok = kernel() && ok;
+	Timer timer;
+	for (uint32_t i = 0; i < iterations; ++i)
+		ok = kernel() && ok;
+	return timer.ElapsedMilliseconds() / iterations;
+}
+
+bool TimeFFT(ComputeFFT& fft, const FFTBufferInfo& info, uint32_t iterations,
+		double& milliseconds) {
+	std::vector<float> temp0(info.TempBufferFloatSizes[0]);
+	std::vector<float> temp1(info.TempBufferFloatSizes[1]);
+	std::vector<float> input(info.SpatialFloatSize);
+	std::vector<float> output(info.SpatialFloatSize);
+	uint32_t state = 1;
+	for (size_t i = 0; i < input.size(); ++i)
+		input[i] = (float)(NextRandom(state) & 0xFFFF) / 65536.0f;
+
+	float* temps[2] = { &temp0[0], &temp1[0] };
+	if (!fft.AttachBuffers(2, temps))
+		return false;
+	bool ok = true;
+	milliseconds = Time(iterations, ok, [&]() {
+		float* spectrum = nullptr;
+		float* result = &output[0];
+		return fft.ForwardTransform(&input[0], &spectrum) &&
+				fft.InverseTransform(spectrum, &result);
+	});
+	return ok;
+}
+
+} // namespace
+
+bool RunComputeBenchmarks(JobSystem* jobs, const double* gpuMilliseconds, uint32_t iterations,
+		ComputeBenchmarkResult results[BENCHMARK_KERNEL_COUNT]) {
+	static const char* const names[BENCHMARK_KERNEL_COUNT] = {
+		"Scan", "Multiscan", "SegmentedScan", "FFT1DComplex", "FFT2DReal"
+	};
+	if (iterations == 0)
+		iterations = 1;
+	for (int i = 0; i < BENCHMARK_KERNEL_COUNT; ++i) {
+		results[i].Name = names[i];
+		results[i].Elements = 0;
+		results[i].CpuMilliseconds = 0.0;
+		results[i].GpuMilliseconds = gpuMilliseconds ? gpuMilliseconds[i] : 0.0;
+	}
+
+	bool ok = true;
+	uint32_t state = 1;
+	std::vector<uint32_t> data(SCAN_SIZE);
+	std::vector<uint32_t> out(SCAN_SIZE);
+	for (uint32_t i = 0; i < SCAN_SIZE; ++i)
+		data[i] = NextRandom(state) & 0xFF;
+
+	ComputeScan scan;
+	ok = scan.Initialize(jobs, SCAN_SIZE, MULTISCAN_COUNT) && ok;
+	results[BENCHMARK_SCAN].Elements = SCAN_SIZE;
+	results[BENCHMARK_SCAN].CpuMilliseconds = Time(iterations, ok, [&]() {
+		return scan.Scan(SCAN_DATA_TYPE_UINT, SCAN_OPCODE_ADD, SCAN_SIZE, &data[0], &out[0]);
+	});
+
+	std::vector<float> floats(SCAN_SIZE);
+	std::vector<float> floatOut(SCAN_SIZE);
+	for (uint32_t i = 0; i < SCAN_SIZE; ++i)
+		floats[i] = (float)data[i] / 256.0f;
+	results[BENCHMARK_MULTISCAN].Elements = MULTISCAN_SIZE * MULTISCAN_COUNT;
+	results[BENCHMARK_MULTISCAN].CpuMilliseconds = Time(iterations, ok, [&]() {
+		return scan.Multiscan(SCAN_DATA_TYPE_FLOAT, SCAN_OPCODE_ADD, MULTISCAN_SIZE,
+				MULTISCAN_SIZE, MULTISCAN_COUNT, &floats[0], &floatOut[0]);
+	});
+
+	ComputeSegmentedScan segScan;
+	ok = segScan.Initialize(jobs, SCAN_SIZE) && ok;
+	std::vector<uint32_t> flags((SCAN_SIZE + 31) / 32, 0);
+	for (uint32_t i = 0; i < SCAN_SIZE; i += SEGMENT_LENGTH)
+		flags[i >> 5] |= 1u << (i & 31);
+	results[BENCHMARK_SEGMENTED_SCAN].Elements = SCAN_SIZE;
+	results[BENCHMARK_SEGMENTED_SCAN].CpuMilliseconds = Time(iterations, ok, [&]() {
+		return segScan.SegScan(SCAN_DATA_TYPE_FLOAT, SCAN_OPCODE_ADD, SCAN_SIZE, &floats[0],
+				&flags[0], &floatOut[0]);
+	});
+
+	ComputeFFT fft;
+	FFTBufferInfo info;
+	results[BENCHMARK_FFT_1D_COMPLEX].Elements = FFT_1D_SIZE;
+	ok = fft.Initialize1DComplex(jobs, FFT_1D_SIZE, &info) &&
+			TimeFFT(fft, info, iterations, results[BENCHMARK_FFT_1D_COMPLEX].CpuMilliseconds) &&
+			ok;
+
+	results[BENCHMARK_FFT_2D_REAL].Elements = FFT_2D_SIZE * FFT_2D_SIZE;
+	ok = fft.Initialize2DReal(jobs, FFT_2D_SIZE, FFT_2D_SIZE, &info) &&
+			TimeFFT(fft, info, iterations, results[BENCHMARK_FFT_2D_REAL].CpuMilliseconds) && ok;
+	return ok;
+}
+
+void PrintComputeBenchmarks(FILE* file,
+		const ComputeBenchmarkResult results[BENCHMARK_KERNEL_COUNT]) {
+	fprintf(file, "%-16s %10s %10s %10s %8s\n", "Kernel", "Elements", "CPU ms", "GPU ms",
+			"GPU x");
+	for (int i = 0; i < BENCHMARK_KERNEL_COUNT; ++i) {
+		const ComputeBenchmarkResult& r = results[i];
+		if (r.GpuMilliseconds > 0.0) {
+			fprintf(file, "%-16s %10u %10.3f %10.3f %8.2f\n", r.Name, r.Elements,
+					r.CpuMilliseconds, r.GpuMilliseconds, r.GpuSpeedup());
+		} else {
+			fprintf(file, "%-16s %10u %10.3f %10s %8s\n", r.Name, r.Elements,
+					r.CpuMilliseconds, "-", "-");
+		}
+	}
+}
+
+} // namespace Zeus
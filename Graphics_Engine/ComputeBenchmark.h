@@ -0,0 +1,56 @@
+/*
+ * ComputeBenchmark.h
+ *
+ * Times the CPU scan and FFT emulation on the same problem sizes as the
+ * D3DCSX GPU runs, so the two can be compared side by side. GPU timings
+ * are measured elsewhere and passed in.
+ */
+
+#ifndef COMPUTEBENCHMARK_H_
+#define COMPUTEBENCHMARK_H_
+
+#include <cstdint>
+#include <cstdio>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum ComputeBenchmarkKernel {
+	// 1M uint add scan.
+	BENCHMARK_SCAN,
+	// 1024 float add scans of 1024 elements.
+	BENCHMARK_MULTISCAN,
+	// 1M float add scan in segments of 1000.
+	BENCHMARK_SEGMENTED_SCAN,
+	// 64K point complex forward + inverse.
+	BENCHMARK_FFT_1D_COMPLEX,
+	// 512 x 512 real forward + inverse.
+	BENCHMARK_FFT_2D_REAL,
+	BENCHMARK_KERNEL_COUNT
+};
+
+struct ComputeBenchmarkResult {
+	const char* Name;
+	uint32_t Elements;
+	// Average over the timed iterations.
+	double CpuMilliseconds;
+	// Zero when no GPU timing was supplied.
+	double GpuMilliseconds;
+
+	// How many times faster the GPU ran, zero without a GPU timing.
+	double GpuSpeedup() const {
+		return GpuMilliseconds > 0.0 ? CpuMilliseconds / GpuMilliseconds : 0.0;
+	}
+};
+
+// gpuMilliseconds may be nullptr, otherwise it holds one timing per
+// ComputeBenchmarkKernel. Returns false if any kernel failed to run.
+bool RunComputeBenchmarks(JobSystem* jobs, const double* gpuMilliseconds, uint32_t iterations,
+		ComputeBenchmarkResult results[BENCHMARK_KERNEL_COUNT]);
+void PrintComputeBenchmarks(FILE* file,
+		const ComputeBenchmarkResult results[BENCHMARK_KERNEL_COUNT]);
+
+} // namespace Zeus
+
+#endif /* COMPUTEBENCHMARK_H_ */
@@ -0,0 +1,352 @@
+/*
+ * ComputeFFT.cpp
+ *
+ */
+
+#include "ComputeFFT.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Roughly this many complex values per job.
+const uint32_t LINE_BATCH = 4096;
+
+bool IsPowerOfTwo(uint32_t n) {
+	return n && (n & (n - 1)) == 0;
+}
+
+uint32_t LineGrain(uint32_t length) {
+	return std::max(1u, LINE_BATCH / length);
+}
+
+} // namespace
+
+ComputeFFT::ComputeFFT()
+		: m_jobs(nullptr), m_scratchFloats(0), m_rowCount(0), m_transformSize(0), m_tempCount(0),
+		m_forwardScale(0.0f), m_inverseScale(0.0f) {
+	memset(&m_desc, 0, sizeof(m_desc));
+	memset(&m_info, 0, sizeof(m_info));
+	memset(m_temp, 0, sizeof(m_temp));
+}
+
+bool ComputeFFT::Initialize(JobSystem* jobs, const FFTDesc& desc, FFTBufferInfo* info) {
+	if (desc.NumDimensions == 0 || desc.NumDimensions > FFT_MAX_DIMENSIONS)
+		return false;
+	uint32_t allDimensions = desc.NumDimensions == 32 ? ~0u : (1u << desc.NumDimensions) - 1;
+	if (desc.DimensionMask == 0 || (desc.DimensionMask & ~allDimensions) != 0)
+		return false;
+	bool real = desc.Type == FFT_DATA_TYPE_REAL;
+	// The half spectrum is taken along X, so X has to be transformed.
+	if (real && ((desc.DimensionMask & 1) == 0 || desc.ElementLengths[0] < 2))
+		return false;
+
+	uint64_t spatial = 1;
+	uint64_t frequency = 1;
+	uint32_t transformSize = 1;
+	uint32_t maxLength = 1;
+	for (uint32_t d = 0; d < desc.NumDimensions; ++d) {
+		uint32_t length = desc.ElementLengths[d];
+		if (length == 0)
+			return false;
+		if (desc.DimensionMask & (1u << d)) {
+			if (!IsPowerOfTwo(length))
+				return false;
+			transformSize *= length;
+			maxLength = std::max(maxLength, length);
+		}
+		spatial *= length;
+		frequency *= (real && d == 0) ? length / 2 + 1 : length;
+	}
+	uint64_t spatialFloats = real ? spatial : spatial * 2;
+	uint64_t frequencyFloats = frequency * 2;
+	if (std::max(spatialFloats, frequencyFloats) > 0xFFFFFFFFull)
+		return false;
+
+	m_jobs = jobs;
+	m_desc = desc;
+	m_transformSize = transformSize;
+	m_rowCount = (uint32_t)(spatial / desc.ElementLengths[0]);
+	m_tempCount = 0;
+	memset(m_temp, 0, sizeof(m_temp));
+
+	// Passes in frequency layout order; a real transform's X pass is
+	// handled separately by RunRealPass().
+	m_passes.clear();
+	uint32_t stride = 1;
+	for (uint32_t d = 0; d < desc.NumDimensions; ++d) {
+		uint32_t length = desc.ElementLengths[d];
+		uint32_t frequencyLength = (real && d == 0) ? length / 2 + 1 : length;
+		if ((desc.DimensionMask & (1u << d)) && !(real && d == 0)) {
+			Pass pass;
+			pass.Length = length;
+			pass.Stride = stride;
+			pass.LineCount = (uint32_t)(frequency / length);
+			m_passes.push_back(pass);
+		}
+		stride *= frequencyLength;
+	}
+
+	m_twiddles.clear();
+	for (uint32_t d = 0; d < desc.NumDimensions; ++d) {
+		uint32_t length = desc.ElementLengths[d];
+		if (!(desc.DimensionMask & (1u << d)))
+			continue;
+		bool known = false;
+		for (size_t i = 0; i < m_twiddles.size(); ++i)
+			known = known || m_twiddles[i].Length == length;
+		if (known)
+			continue;
+
+		Twiddles twiddles;
+		twiddles.Length = length;
+		twiddles.Cos.resize(std::max(1u, length / 2));
+		twiddles.Sin.resize(std::max(1u, length / 2));
+		const double step = 6.283185307179586 / length;
+		for (uint32_t k = 0; k < length / 2; ++k) {
+			twiddles.Cos[k] = (float)cos(step * k);
+			twiddles.Sin[k] = (float)sin(step * k);
+		}
+		uint32_t bits = 0;
+		while ((1u << bits) < length)
+			++bits;
+		twiddles.BitReverse.resize(length);
+		for (uint32_t i = 0; i < length; ++i) {
+			uint32_t reversed = 0;
+			for (uint32_t b = 0; b < bits; ++b)
+				reversed |= ((i >> b) & 1) << (bits - 1 - b);
+			twiddles.BitReverse[i] = reversed;
+		}
+		m_twiddles.push_back(twiddles);
+	}
+
+	uint32_t threads = jobs ? jobs->GetThreadCount() : 1;
+	m_scratchFloats = maxLength * 2;
+	m_scratch.assign((size_t)threads * m_scratchFloats, 0.0f);
+
+	memset(&m_info, 0, sizeof(m_info));
+	m_info.NumTempBufferSizes = 2;
+	m_info.TempBufferFloatSizes[0] = (uint32_t)std::max(spatialFloats, frequencyFloats);
+	m_info.TempBufferFloatSizes[1] = m_info.TempBufferFloatSizes[0];
+	m_info.SpatialFloatSize = (uint32_t)spatialFloats;
+	m_info.FrequencyFloatSize = (uint32_t)frequencyFloats;
+	if (info)
+		*info = m_info;
+	return true;
+}
+
+bool ComputeFFT::Initialize1DReal(JobSystem* jobs, uint32_t x, FFTBufferInfo* info) {
+	return Initialize3DReal(jobs, x, 1, 1, info);
+}
+
+bool ComputeFFT::Initialize1DComplex(JobSystem* jobs, uint32_t x, FFTBufferInfo* info) {
+	return Initialize3DComplex(jobs, x, 1, 1, info);
+}
+
+bool ComputeFFT::Initialize2DReal(JobSystem* jobs, uint32_t x, uint32_t y, FFTBufferInfo* info) {
+	return Initialize3DReal(jobs, x, y, 1, info);
+}
+
+bool ComputeFFT::Initialize2DComplex(JobSystem* jobs, uint32_t x, uint32_t y,
+		FFTBufferInfo* info) {
+	return Initialize3DComplex(jobs, x, y, 1, info);
+}
+
+bool ComputeFFT::Initialize3DReal(JobSystem* jobs, uint32_t x, uint32_t y, uint32_t z,
+		FFTBufferInfo* info) {
+	FFTDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.NumDimensions = z > 1 ? 3 : (y > 1 ? 2 : 1);
+	desc.ElementLengths[0] = x;
+	desc.ElementLengths[1] = y;
+	desc.ElementLengths[2] = z;
+	desc.DimensionMask = (1u << desc.NumDimensions) - 1;
+	desc.Type = FFT_DATA_TYPE_REAL;
+	return Initialize(jobs, desc, info);
+}
+
+bool ComputeFFT::Initialize3DComplex(JobSystem* jobs, uint32_t x, uint32_t y, uint32_t z,
+		FFTBufferInfo* info) {
+	FFTDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.NumDimensions = z > 1 ? 3 : (y > 1 ? 2 : 1);
+	desc.ElementLengths[0] = x;
+	desc.ElementLengths[1] = y;
+	desc.ElementLengths[2] = z;
+	desc.DimensionMask = (1u << desc.NumDimensions) - 1;
+	desc.Type = FFT_DATA_TYPE_COMPLEX;
+	return Initialize(jobs, desc, info);
+}
+
+bool ComputeFFT::AttachBuffers(uint32_t numTempBuffers, float* const* tempBuffers) {
+	if (m_transformSize == 0 || numTempBuffers < m_info.NumTempBufferSizes ||
+			numTempBuffers > FFT_MAX_TEMP_BUFFERS)
+		return false;
+	for (uint32_t i = 0; i < numTempBuffers; ++i) {
+		if (!tempBuffers[i])
+			return false;
+		m_temp[i] = tempBuffers[i];
+	}
+	m_tempCount = numTempBuffers;
+	return true;
+}
+
+bool ComputeFFT::ForwardTransform(const float* input, float** output) {
+	return Transform(input, output, false);
+}
+
+bool ComputeFFT::InverseTransform(const float* input, float** output) {
+	return Transform(input, output, true);
+}
+
+bool ComputeFFT::Transform(const float* input, float** output, bool inverse) {
+	if (!input || !output || m_tempCount < 2)
+		return false;
+
+	bool real = m_desc.Type == FFT_DATA_TYPE_REAL;
+	uint32_t passCount = (uint32_t)m_passes.size() + (real ? 1 : 0);
+	float scale = inverse ? m_inverseScale : m_forwardScale;
+	if (scale == 0.0f)
+		scale = inverse ? 1.0f / (float)m_transformSize : 1.0f;
+
+	const float* src = input;
+	float* dst = nullptr;
+	for (uint32_t p = 0; p < passCount; ++p) {
+		bool last = p + 1 == passCount;
+		if (last && *output)
+			dst = *output;
+		else
+			dst = m_temp[0] != src ? m_temp[0] : m_temp[1];
+		float passScale = last ? scale : 1.0f;
+
+		// Forward real transforms start with the X pass, inverse ones end
+		// with it.
+		bool realPass = real && (inverse ? last : p == 0);
+		if (realPass) {
+			if (dst == src)
+				return false;
+			RunRealPass(src, dst, inverse, passScale);
+		} else {
+			uint32_t index = real && !inverse ? p - 1 : p;
+			RunPass(m_passes[index], src, dst, inverse, passScale);
+		}
+		src = dst;
+	}
+	*output = dst;
+	return true;
+}
+
+void ComputeFFT::RunPass(const Pass& pass, const float* src, float* dst, bool inverse,
+		float scale) {
+	const Twiddles& twiddles = GetTwiddles(pass.Length);
+	ParallelFor(m_jobs, pass.LineCount, LineGrain(pass.Length),
+			[&](uint32_t begin, uint32_t end) {
+		float* line = GetScratch();
+		for (uint32_t j = begin; j < end; ++j) {
+			size_t inner = j % pass.Stride;
+			size_t outer = j / pass.Stride;
+			size_t base = outer * pass.Length * pass.Stride + inner;
+			for (uint32_t k = 0; k < pass.Length; ++k) {
+				size_t i = (base + (size_t)k * pass.Stride) * 2;
+				line[k * 2] = src[i];
+				line[k * 2 + 1] = src[i + 1];
+			}
+			FFT(line, twiddles, inverse);
+			for (uint32_t k = 0; k < pass.Length; ++k) {
+				size_t i = (base + (size_t)k * pass.Stride) * 2;
+				dst[i] = line[k * 2] * scale;
+				dst[i + 1] = line[k * 2 + 1] * scale;
+			}
+		}
+	});
+}
+
+// Real rows of X values to and from X / 2 + 1 complex values. The upper
+// half of the spectrum is the conjugate mirror of the lower one.
+void ComputeFFT::RunRealPass(const float* src, float* dst, bool inverse, float scale) {
+	const uint32_t x = m_desc.ElementLengths[0];
+	const uint32_t half = x / 2 + 1;
+	const Twiddles& twiddles = GetTwiddles(x);
+	ParallelFor(m_jobs, m_rowCount, LineGrain(x), [&](uint32_t begin, uint32_t end) {
+		float* line = GetScratch();
+		for (uint32_t r = begin; r < end; ++r) {
+			if (!inverse) {
+				const float* in = src + (size_t)r * x;
+				for (uint32_t k = 0; k < x; ++k) {
+					line[k * 2] = in[k];
+					line[k * 2 + 1] = 0.0f;
+				}
+				FFT(line, twiddles, false);
+				float* out = dst + (size_t)r * half * 2;
+				for (uint32_t k = 0; k < half * 2; ++k)
+					out[k] = line[k] * scale;
+			} else {
+				const float* in = src + (size_t)r * half * 2;
+				memcpy(line, in, half * 2 * sizeof(float));
+				for (uint32_t k = half; k < x; ++k) {
+					line[k * 2] = in[(x - k) * 2];
+					line[k * 2 + 1] = -in[(x - k) * 2 + 1];
+				}
+				FFT(line, twiddles, true);
+				float* out = dst + (size_t)r * x;
+				for (uint32_t k = 0; k < x; ++k)
+					out[k] = line[k * 2] * scale;
+			}
+		}
+	});
+}
+
+// In-place iterative radix-2 transform of interleaved complex values.
+void ComputeFFT::FFT(float* line, const Twiddles& twiddles, bool inverse) const {
+	const uint32_t n = twiddles.Length;
+	for (uint32_t i = 0; i < n; ++i) {
+		uint32_t j = twiddles.BitReverse[i];
+		if (i < j) {
+			std::swap(line[i * 2], line[j * 2]);
+			std::swap(line[i * 2 + 1], line[j * 2 + 1]);
+		}
+	}
+
+	const float sign = inverse ? 1.0f : -1.0f;
+	for (uint32_t size = 2; size <= n; size <<= 1) {
+		const uint32_t half = size / 2;
+		const uint32_t step = n / size;
+		for (uint32_t start = 0; start < n; start += size) {
+			for (uint32_t k = 0; k < half; ++k) {
+				float wr = twiddles.Cos[k * step];
+				float wi = sign * twiddles.Sin[k * step];
+				float* a = line + (start + k) * 2;
+				float* b = line + (start + k + half) * 2;
+				float tr = b[0] * wr - b[1] * wi;
+				float ti = b[0] * wi + b[1] * wr;
+				b[0] = a[0] - tr;
+				b[1] = a[1] - ti;
+				a[0] += tr;
+				a[1] += ti;
+			}
+		}
+	}
+}
+
+const ComputeFFT::Twiddles& ComputeFFT::GetTwiddles(uint32_t length) const {
+	for (size_t i = 0; i < m_twiddles.size(); ++i) {
+		if (m_twiddles[i].Length == length)
+			return m_twiddles[i];
+	}
+	assert(false);
+	return m_twiddles[0];
+}
+
+float* ComputeFFT::GetScratch() {
+	uint32_t thread = m_jobs ? JobSystem::GetThreadIndex() : 0;
+	assert((size_t)(thread + 1) * m_scratchFloats <= m_scratch.size());
+	return &m_scratch[(size_t)thread * m_scratchFloats];
+}
+
+} // namespace Zeus
@@ -0,0 +1,134 @@
+/*
+ * ComputeFFT.h
+ *
+ * CPU implementation of ID3DX11FFT from D3DCSX.h. Buffers are float arrays
+ * in place of UAVs and keep the D3DX layout: complex values interleaved
+ * (real, imaginary), row major with ElementLengths[0] varying fastest.
+ * Dimensions outside DimensionMask are batched, not transformed.
+ *
+ * Real transforms store the non-redundant half of the spectrum, so a real
+ * X by Y by ... input becomes (X / 2 + 1) by Y by ... complex values.
+ *
+ * Transformed lengths must be powers of two. Each pass gathers one line at
+ * a time into per-thread scratch, so lines are spread over the job system.
+ */
+
+#ifndef COMPUTEFFT_H_
+#define COMPUTEFFT_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+const uint32_t FFT_MAX_TEMP_BUFFERS = 4;
+const uint32_t FFT_MAX_DIMENSIONS = 32;
+
+enum FFTDataType {
+	FFT_DATA_TYPE_REAL,
+	FFT_DATA_TYPE_COMPLEX,
+};
+
+enum FFTDimMask {
+	FFT_DIM_MASK_1D = 0x1,
+	FFT_DIM_MASK_2D = 0x3,
+	FFT_DIM_MASK_3D = 0x7,
+};
+
+struct FFTDesc {
+	uint32_t NumDimensions;
+	uint32_t ElementLengths[FFT_MAX_DIMENSIONS];
+	uint32_t DimensionMask;
+	FFTDataType Type;
+};
+
+// Twiddle tables live in the FFT object, so unlike D3DX no precompute
+// buffers are requested.
+struct FFTBufferInfo {
+	uint32_t NumTempBufferSizes;
+	uint32_t TempBufferFloatSizes[FFT_MAX_TEMP_BUFFERS];
+	// Floats in the spatial and frequency domain buffers.
+	uint32_t SpatialFloatSize;
+	uint32_t FrequencyFloatSize;
+};
+
+class ComputeFFT {
+public:
+	ComputeFFT();
+
+	// Mirrors D3DX11CreateFFT and fills info with the buffer sizes. jobs may
+	// be nullptr.
+	bool Initialize(JobSystem* jobs, const FFTDesc& desc, FFTBufferInfo* info);
+	bool Initialize1DReal(JobSystem* jobs, uint32_t x, FFTBufferInfo* info);
+	bool Initialize1DComplex(JobSystem* jobs, uint32_t x, FFTBufferInfo* info);
+	bool Initialize2DReal(JobSystem* jobs, uint32_t x, uint32_t y, FFTBufferInfo* info);
+	bool Initialize2DComplex(JobSystem* jobs, uint32_t x, uint32_t y, FFTBufferInfo* info);
+	bool Initialize3DReal(JobSystem* jobs, uint32_t x, uint32_t y, uint32_t z,
+			FFTBufferInfo* info);
+	bool Initialize3DComplex(JobSystem* jobs, uint32_t x, uint32_t y, uint32_t z,
+			FFTBufferInfo* info);
+
+	// A scale of 0 selects the default: 1 forward, 1 / N inverse where N is
+	// the product of the transformed lengths.
+	void SetForwardScale(float scale) { m_forwardScale = scale; }
+	float GetForwardScale() const { return m_forwardScale; }
+	void SetInverseScale(float scale) { m_inverseScale = scale; }
+	float GetInverseScale() const { return m_inverseScale; }
+
+	// Temp buffers must hold at least TempBufferFloatSizes floats.
+	bool AttachBuffers(uint32_t numTempBuffers, float* const* tempBuffers);
+
+	// As in D3DX: if *output is null the passes ping-pong between the temp
+	// buffers and *output receives the last one written. Otherwise the
+	// final pass writes to *output. input and *output may be temp buffers;
+	// a real transform's output must not alias its input.
+	bool ForwardTransform(const float* input, float** output);
+	bool InverseTransform(const float* input, float** output);
+
+private:
+	ComputeFFT(const ComputeFFT&);
+	ComputeFFT& operator=(const ComputeFFT&);
+
+	struct Pass {
+		// Line length and the distance between its elements, in complex
+		// values of the frequency domain layout.
+		uint32_t Length;
+		uint32_t Stride;
+		uint32_t LineCount;
+	};
+
+	struct Twiddles {
+		uint32_t Length;
+		std::vector<float> Cos;
+		std::vector<float> Sin;
+		std::vector<uint32_t> BitReverse;
+	};
+
+	bool Transform(const float* input, float** output, bool inverse);
+	void RunPass(const Pass& pass, const float* src, float* dst, bool inverse, float scale);
+	void RunRealPass(const float* src, float* dst, bool inverse, float scale);
+	void FFT(float* line, const Twiddles& twiddles, bool inverse) const;
+	const Twiddles& GetTwiddles(uint32_t length) const;
+	float* GetScratch();
+
+	JobSystem* m_jobs;
+	FFTDesc m_desc;
+	FFTBufferInfo m_info;
+	std::vector<Pass> m_passes;
+	std::vector<Twiddles> m_twiddles;
+	// Per-thread line scratch, indexed by JobSystem::GetThreadIndex().
+	std::vector<float> m_scratch;
+	uint32_t m_scratchFloats;
+	uint32_t m_rowCount;
+	uint32_t m_transformSize;
+	float* m_temp[FFT_MAX_TEMP_BUFFERS];
+	uint32_t m_tempCount;
+	float m_forwardScale;
+	float m_inverseScale;
+};
+
+} // namespace Zeus
+
+#endif /* COMPUTEFFT_H_ */
@@ -0,0 +1,330 @@
+/*
+ * ComputeScan.cpp
+ *
+ */
+
+#include "ComputeScan.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Zeus {
+
+namespace {
+
+// Elements per chunk. Fixed, so results never depend on the thread count.
+const uint32_t SCAN_CHUNK = 64 * 1024;
+
+template <typename T> T Largest() { return std::numeric_limits<T>::max(); }
+template <typename T> T Smallest() { return std::numeric_limits<T>::min(); }
+template <> float Largest<float>() { return std::numeric_limits<float>::infinity(); }
+template <> float Smallest<float>() { return -std::numeric_limits<float>::infinity(); }
+
+template <typename T> struct OpAdd {
+	static T Identity() { return T(0); }
+	static T Apply(T a, T b) { return a + b; }
+};
+template <typename T> struct OpMin {
+	static T Identity() { return Largest<T>(); }
+	static T Apply(T a, T b) { return b < a ? b : a; }
+};
+template <typename T> struct OpMax {
+	static T Identity() { return Smallest<T>(); }
+	static T Apply(T a, T b) { return a < b ? b : a; }
+};
+template <typename T> struct OpMul {
+	static T Identity() { return T(1); }
+	static T Apply(T a, T b) { return a * b; }
+};
+template <typename T> struct OpAnd {
+	static T Identity() { return T(~0u); }
+	static T Apply(T a, T b) { return a & b; }
+};
+template <typename T> struct OpOr {
+	static T Identity() { return T(0); }
+	static T Apply(T a, T b) { return a | b; }
+};
+template <typename T> struct OpXor {
+	static T Identity() { return T(0); }
+	static T Apply(T a, T b) { return a ^ b; }
+};
+
+// One scan call: scanCount lines of size elements, each cut into
+// chunksPerLine chunks. Totals, carries and resets hold one entry per
+// chunk of every line.
+struct ScanArgs {
+	const void* Src;
+	void* Dst;
+	const uint32_t* Flags;
+	uint32_t Size;
+	uint32_t Pitch;
+	uint32_t ScanCount;
+	uint32_t ChunksPerLine;
+	bool Backward;
+	bool Exclusive;
+	void* Totals;
+	void* Carries;
+	uint8_t* Resets;
+};
+
+template <typename T, typename Op>
+class ScanKernel {
+public:
+	explicit ScanKernel(const ScanArgs& args)
+			: m_args(args), m_src(static_cast<const T*>(args.Src)),
+			m_dst(static_cast<T*>(args.Dst)), m_totals(static_cast<T*>(args.Totals)),
+			m_carries(static_cast<T*>(args.Carries)) {
+	}
+
+	void Run(JobSystem* jobs) {
+		uint32_t chunks = m_args.ScanCount * m_args.ChunksPerLine;
+		if (m_args.ChunksPerLine > 1) {
+			ParallelFor(jobs, chunks, 1, [this](uint32_t begin, uint32_t end) {
+				for (uint32_t c = begin; c < end; ++c)
+					Reduce(c);
+			});
+			for (uint32_t line = 0; line < m_args.ScanCount; ++line)
+				Carry(line);
+		} else {
+			for (uint32_t c = 0; c < chunks; ++c)
+				m_carries[c] = Op::Identity();
+		}
+
+		// Lines that fit in one chunk are batched several to a job.
+		uint32_t grain = 1;
+		if (m_args.ChunksPerLine == 1)
+			grain = std::max(1u, SCAN_CHUNK / std::max(1u, m_args.Size));
+		ParallelFor(jobs, chunks, grain, [this](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; ++c)
+				Apply(c);
+		});
+	}
+
+private:
+	uint32_t Index(uint32_t t) const {
+		return m_args.Backward ? m_args.Size - 1 - t : t;
+	}
+
+	bool Flag(uint32_t i) const {
+		return (m_args.Flags[i >> 5] >> (i & 31)) & 1;
+	}
+
+	// True if the element at traversal position t starts a segment. A
+	// backward walk enters a new segment right after a flagged element.
+	bool Reset(uint32_t t) const {
+		if (!m_args.Flags)
+			return false;
+		if (m_args.Backward)
+			return t > 0 && Flag(m_args.Size - t);
+		return Flag(t);
+	}
+
+	void Range(uint32_t chunk, uint32_t& line, uint32_t& begin, uint32_t& end) const {
+		line = chunk / m_args.ChunksPerLine;
+		begin = (chunk % m_args.ChunksPerLine) * SCAN_CHUNK;
+		end = std::min(m_args.Size, begin + SCAN_CHUNK);
+	}
+
+	void Reduce(uint32_t chunk) {
+		uint32_t line, begin, end;
+		Range(chunk, line, begin, end);
+		const T* src = m_src + (size_t)line * m_args.Pitch;
+		T total = Op::Identity();
+		bool reset = false;
+		for (uint32_t t = begin; t < end; ++t) {
+			if (Reset(t)) {
+				total = Op::Identity();
+				reset = true;
+			}
+			total = Op::Apply(total, src[Index(t)]);
+		}
+		m_totals[chunk] = total;
+		m_args.Resets[chunk] = reset;
+	}
+
+	void Carry(uint32_t line) {
+		uint32_t first = line * m_args.ChunksPerLine;
+		T carry = Op::Identity();
+		for (uint32_t c = first; c < first + m_args.ChunksPerLine; ++c) {
+			m_carries[c] = carry;
+			carry = m_args.Resets[c] ? m_totals[c] : Op::Apply(carry, m_totals[c]);
+		}
+	}
+
+	void Apply(uint32_t chunk) {
+		uint32_t line, begin, end;
+		Range(chunk, line, begin, end);
+		const T* src = m_src + (size_t)line * m_args.Pitch;
+		T* dst = m_dst + (size_t)line * m_args.Pitch;
+		T value = m_carries[chunk];
+		for (uint32_t t = begin; t < end; ++t) {
+			if (Reset(t))
+				value = Op::Identity();
+			uint32_t i = Index(t);
+			T x = src[i];
+			if (m_args.Exclusive) {
+				dst[i] = value;
+				value = Op::Apply(value, x);
+			} else {
+				value = Op::Apply(value, x);
+				dst[i] = value;
+			}
+		}
+	}
+
+	const ScanArgs& m_args;
+	const T* m_src;
+	T* m_dst;
+	T* m_totals;
+	T* m_carries;
+};
+
+template <typename T, typename Op>
+void RunKernel(const ScanArgs& args, JobSystem* jobs) {
+	ScanKernel<T, Op> kernel(args);
+	kernel.Run(jobs);
+}
+
+template <template <typename> class Op>
+bool RunTyped(ScanDataType type, const ScanArgs& args, JobSystem* jobs) {
+	switch (type) {
+	case SCAN_DATA_TYPE_FLOAT:
+		RunKernel<float, Op<float> >(args, jobs);
+		return true;
+	case SCAN_DATA_TYPE_INT:
+		RunKernel<int32_t, Op<int32_t> >(args, jobs);
+		return true;
+	case SCAN_DATA_TYPE_UINT:
+		RunKernel<uint32_t, Op<uint32_t> >(args, jobs);
+		return true;
+	}
+	return false;
+}
+
+template <template <typename> class Op>
+bool RunIntegral(ScanDataType type, const ScanArgs& args, JobSystem* jobs) {
+	switch (type) {
+	case SCAN_DATA_TYPE_INT:
+		RunKernel<int32_t, Op<int32_t> >(args, jobs);
+		return true;
+	case SCAN_DATA_TYPE_UINT:
+		RunKernel<uint32_t, Op<uint32_t> >(args, jobs);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool RunScan(ScanDataType type, ScanOpcode op, const ScanArgs& args, JobSystem* jobs) {
+	switch (op) {
+	case SCAN_OPCODE_ADD: return RunTyped<OpAdd>(type, args, jobs);
+	case SCAN_OPCODE_MIN: return RunTyped<OpMin>(type, args, jobs);
+	case SCAN_OPCODE_MAX: return RunTyped<OpMax>(type, args, jobs);
+	case SCAN_OPCODE_MUL: return RunTyped<OpMul>(type, args, jobs);
+	case SCAN_OPCODE_AND: return RunIntegral<OpAnd>(type, args, jobs);
+	case SCAN_OPCODE_OR: return RunIntegral<OpOr>(type, args, jobs);
+	case SCAN_OPCODE_XOR: return RunIntegral<OpXor>(type, args, jobs);
+	}
+	return false;
+}
+
+uint32_t ChunkCount(uint32_t size) {
+	return size ? (size + SCAN_CHUNK - 1) / SCAN_CHUNK : 1;
+}
+
+} // namespace
+
+ComputeScan::ComputeScan()
+		: m_jobs(nullptr), m_maxElementScanSize(0), m_maxScanCount(0),
+		m_direction(SCAN_DIRECTION_FORWARD), m_exclusive(false) {
+}
+
+bool ComputeScan::Initialize(JobSystem* jobs, uint32_t maxElementScanSize,
+		uint32_t maxScanCount) {
+	if (maxElementScanSize == 0 || maxScanCount == 0)
+		return false;
+	m_jobs = jobs;
+	m_maxElementScanSize = maxElementScanSize;
+	m_maxScanCount = maxScanCount;
+	size_t chunks = (size_t)ChunkCount(maxElementScanSize) * maxScanCount;
+	m_totals.resize(chunks);
+	m_carries.resize(chunks);
+	m_resets.resize(chunks);
+	return true;
+}
+
+bool ComputeScan::Scan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize,
+		const void* src, void* dst) {
+	return Multiscan(type, op, elementScanSize, elementScanSize, 1, src, dst);
+}
+
+bool ComputeScan::Multiscan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize,
+		uint32_t elementScanPitch, uint32_t scanCount, const void* src, void* dst) {
+	if (!src || !dst || elementScanSize > m_maxElementScanSize || scanCount > m_maxScanCount)
+		return false;
+	if (elementScanPitch < elementScanSize && scanCount > 1)
+		return false;
+	if (elementScanSize == 0 || scanCount == 0)
+		return true;
+
+	ScanArgs args;
+	args.Src = src;
+	args.Dst = dst;
+	args.Flags = nullptr;
+	args.Size = elementScanSize;
+	args.Pitch = elementScanPitch;
+	args.ScanCount = scanCount;
+	args.ChunksPerLine = ChunkCount(elementScanSize);
+	args.Backward = m_direction == SCAN_DIRECTION_BACKWARD;
+	args.Exclusive = m_exclusive;
+	args.Totals = &m_totals[0];
+	args.Carries = &m_carries[0];
+	args.Resets = &m_resets[0];
+	return RunScan(type, op, args, m_jobs);
+}
+
+ComputeSegmentedScan::ComputeSegmentedScan()
+		: m_jobs(nullptr), m_maxElementScanSize(0), m_direction(SCAN_DIRECTION_FORWARD),
+		m_exclusive(false) {
+}
+
+bool ComputeSegmentedScan::Initialize(JobSystem* jobs, uint32_t maxElementScanSize) {
+	if (maxElementScanSize == 0)
+		return false;
+	m_jobs = jobs;
+	m_maxElementScanSize = maxElementScanSize;
+	uint32_t chunks = ChunkCount(maxElementScanSize);
+	m_totals.resize(chunks);
+	m_carries.resize(chunks);
+	m_resets.resize(chunks);
+	return true;
+}
+
+bool ComputeSegmentedScan::SegScan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize,
+		const void* src, const uint32_t* elementFlags, void* dst) {
+	// As with D3DCSX, a null source scans dst in place.
+	if (!src)
+		src = dst;
+	if (!dst || !elementFlags || elementScanSize > m_maxElementScanSize)
+		return false;
+	if (elementScanSize == 0)
+		return true;
+
+	ScanArgs args;
+	args.Src = src;
+	args.Dst = dst;
+	args.Flags = elementFlags;
+	args.Size = elementScanSize;
+	args.Pitch = elementScanSize;
+	args.ScanCount = 1;
+	args.ChunksPerLine = ChunkCount(elementScanSize);
+	args.Backward = m_direction == SCAN_DIRECTION_BACKWARD;
+	args.Exclusive = m_exclusive;
+	args.Totals = &m_totals[0];
+	args.Carries = &m_carries[0];
+	args.Resets = &m_resets[0];
+	return RunScan(type, op, args, m_jobs);
+}
+
+} // namespace Zeus
@@ -0,0 +1,112 @@
+/*
+ * ComputeScan.h
+ *
+ * CPU implementations of ID3DX11Scan and ID3DX11SegmentedScan from
+ * D3DCSX.h, for tools and headless nodes without a D3D11 device. Buffers
+ * are plain arrays of 32-bit elements in place of UAVs; src == dst scans
+ * in place, as it does on the GPU.
+ *
+ * Every scan is cut into fixed-size chunks: chunk totals are reduced in
+ * parallel, carried serially and then applied in parallel. The chunking
+ * does not depend on the thread count, so float results are the same with
+ * or without a job system.
+ */
+
+#ifndef COMPUTESCAN_H_
+#define COMPUTESCAN_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum ScanDataType {
+	SCAN_DATA_TYPE_FLOAT = 1,
+	SCAN_DATA_TYPE_INT,
+	SCAN_DATA_TYPE_UINT,
+};
+
+enum ScanOpcode {
+	SCAN_OPCODE_ADD = 1,
+	SCAN_OPCODE_MIN,
+	SCAN_OPCODE_MAX,
+	SCAN_OPCODE_MUL,
+	// Bitwise opcodes are only valid for INT and UINT.
+	SCAN_OPCODE_AND,
+	SCAN_OPCODE_OR,
+	SCAN_OPCODE_XOR,
+};
+
+enum ScanDirection {
+	SCAN_DIRECTION_FORWARD = 1,
+	SCAN_DIRECTION_BACKWARD,
+};
+
+class ComputeScan {
+public:
+	ComputeScan();
+
+	// Mirrors D3DX11CreateScan. jobs may be nullptr.
+	bool Initialize(JobSystem* jobs, uint32_t maxElementScanSize, uint32_t maxScanCount);
+
+	void SetScanDirection(ScanDirection direction) { m_direction = direction; }
+	// Scans are inclusive by default; exclusive scans start every
+	// sequence with the identity of the opcode.
+	void SetExclusive(bool exclusive) { m_exclusive = exclusive; }
+
+	bool Scan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize, const void* src,
+			void* dst);
+	// ScanCount independent scans, each starting elementScanPitch
+	// elements after the previous one.
+	bool Multiscan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize,
+			uint32_t elementScanPitch, uint32_t scanCount, const void* src, void* dst);
+
+private:
+	ComputeScan(const ComputeScan&);
+	ComputeScan& operator=(const ComputeScan&);
+
+	JobSystem* m_jobs;
+	uint32_t m_maxElementScanSize;
+	uint32_t m_maxScanCount;
+	ScanDirection m_direction;
+	bool m_exclusive;
+	// Per-chunk totals, carries and segment resets.
+	std::vector<uint32_t> m_totals;
+	std::vector<uint32_t> m_carries;
+	std::vector<uint8_t> m_resets;
+};
+
+class ComputeSegmentedScan {
+public:
+	ComputeSegmentedScan();
+
+	// Mirrors D3DX11CreateSegmentedScan. jobs may be nullptr.
+	bool Initialize(JobSystem* jobs, uint32_t maxElementScanSize);
+
+	void SetScanDirection(ScanDirection direction) { m_direction = direction; }
+	void SetExclusive(bool exclusive) { m_exclusive = exclusive; }
+
+	// elementFlags is a compact bit array, bit (i % 32) of word i / 32 for
+	// element i; a set bit starts a new segment at that element. Backward
+	// scans walk each segment from its last element to the flagged one.
+	bool SegScan(ScanDataType type, ScanOpcode op, uint32_t elementScanSize, const void* src,
+			const uint32_t* elementFlags, void* dst);
+
+private:
+	ComputeSegmentedScan(const ComputeSegmentedScan&);
+	ComputeSegmentedScan& operator=(const ComputeSegmentedScan&);
+
+	JobSystem* m_jobs;
+	uint32_t m_maxElementScanSize;
+	ScanDirection m_direction;
+	bool m_exclusive;
+	std::vector<uint32_t> m_totals;
+	std::vector<uint32_t> m_carries;
+	std::vector<uint8_t> m_resets;
+};
+
+} // namespace Zeus
+
+#endif /* COMPUTESCAN_H_ */
@@ -0,0 +1,122 @@
+/*
+ * DrawQueue.cpp
+ *
+ */
+
+#include "DrawQueue.h"
+#include "JobSystem.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace Zeus {
+
+SortKeyLayout OpaqueSortKeyLayout() {
+	SortKeyLayout layout;
+	layout.Order[0] = SORT_FIELD_PASS;
+	layout.Order[1] = SORT_FIELD_STATE;
+	layout.Order[2] = SORT_FIELD_MATERIAL;
+	layout.Order[3] = SORT_FIELD_DEPTH;
+	layout.Bits[SORT_FIELD_PASS] = 6;
+	layout.Bits[SORT_FIELD_STATE] = 14;
+	layout.Bits[SORT_FIELD_MATERIAL] = 20;
+	layout.Bits[SORT_FIELD_DEPTH] = 24;
+	layout.BackToFront = false;
+	return layout;
+}
+
+SortKeyLayout TransparentSortKeyLayout() {
+	SortKeyLayout layout;
+	layout.Order[0] = SORT_FIELD_PASS;
+	layout.Order[1] = SORT_FIELD_DEPTH;
+	layout.Order[2] = SORT_FIELD_MATERIAL;
+	layout.Order[3] = SORT_FIELD_STATE;
+	layout.Bits[SORT_FIELD_PASS] = 6;
+	layout.Bits[SORT_FIELD_DEPTH] = 24;
+	layout.Bits[SORT_FIELD_MATERIAL] = 20;
+	layout.Bits[SORT_FIELD_STATE] = 14;
+	layout.BackToFront = true;
+	return layout;
+}
+
+SortKeyEncoder::SortKeyEncoder(const SortKeyLayout& layout) : m_layout(layout) {
+	uint32_t shift = 64;
+	for (int i = 0; i < SORT_FIELD_COUNT; ++i) {
+		SortKeyField field = layout.Order[i];
+		uint32_t bits = layout.Bits[field];
+		assert(bits <= shift && bits <= 32);
+		shift -= bits;
+		m_shift[field] = shift;
+		m_mask[field] = bits ? (~0ull >> (64 - bits)) : 0;
+	}
+}
+
+uint64_t SortKeyEncoder::Encode(uint32_t pass, float depth, uint32_t material,
+		uint32_t state) const {
+	uint32_t depthBits = m_layout.Bits[SORT_FIELD_DEPTH];
+	uint64_t quantized = 0;
+	if (depthBits) {
+		// Positive floats order the same as their bit patterns; negative
+		// values and NaN clamp to zero.
+		uint32_t bits = 0;
+		if (depth > 0.0f)
+			memcpy(&bits, &depth, sizeof(bits));
+		quantized = depthBits >= 31 ? bits : bits >> (31 - depthBits);
+		if (m_layout.BackToFront)
+			quantized = m_mask[SORT_FIELD_DEPTH] - quantized;
+	}
+
+	uint64_t key = 0;
+	key |= ((uint64_t)pass & m_mask[SORT_FIELD_PASS]) << m_shift[SORT_FIELD_PASS];
+	key |= (quantized & m_mask[SORT_FIELD_DEPTH]) << m_shift[SORT_FIELD_DEPTH];
+	key |= ((uint64_t)material & m_mask[SORT_FIELD_MATERIAL]) << m_shift[SORT_FIELD_MATERIAL];
+	key |= ((uint64_t)state & m_mask[SORT_FIELD_STATE]) << m_shift[SORT_FIELD_STATE];
+	return key;
+}
+
+uint32_t SortKeyEncoder::Decode(uint64_t key, SortKeyField field) const {
+	return (uint32_t)((key >> m_shift[field]) & m_mask[field]);
+}
+
+DrawQueue::DrawQueue() : m_count(0) {
+}
+
+void DrawQueue::Initialize(uint32_t queueCount, uint32_t reservePerQueue) {
+	m_queues.clear();
+	m_queues.resize(queueCount);
+	for (uint32_t i = 0; i < queueCount; ++i)
+		m_queues[i].Items.reserve(reservePerQueue);
+	m_items.clear();
+	m_scratch.clear();
+	m_count = 0;
+}
+
+void DrawQueue::Reset() {
+	for (size_t i = 0; i < m_queues.size(); ++i)
+		m_queues[i].Items.clear();
+	m_count = 0;
+}
+
+void DrawQueue::Sort(JobSystem* jobs) {
+	std::vector<const SortItem*> sources(m_queues.size());
+	std::vector<uint32_t> counts(m_queues.size());
+	uint32_t count = 0;
+	for (size_t i = 0; i < m_queues.size(); ++i) {
+		counts[i] = (uint32_t)m_queues[i].Items.size();
+		sources[i] = counts[i] ? &m_queues[i].Items[0] : nullptr;
+		count += counts[i];
+	}
+
+	// The output keeps its size between frames, so only growth clears it.
+	if (m_items.size() < count) {
+		m_items.resize(count);
+		m_scratch.resize(count);
+	}
+	m_count = count;
+	// The queues feed the first pass directly; there is no merged copy.
+	if (count)
+		RadixSort(&sources[0], &counts[0], (uint32_t)sources.size(), &m_items[0], &m_scratch[0],
+				jobs);
+}
+
+} // namespace Zeus
@@ -0,0 +1,105 @@
+/*
+ * DrawQueue.h
+ *
+ * Sorted draw submission. Every draw carries a packed 64-bit key built from
+ * its pass, view depth, material and pipeline state; sorting the keys puts
+ * the draws in submission order. Producers fill separate queues without
+ * locking, and Sort() radix sorts them together into one list.
+ */
+
+#ifndef DRAWQUEUE_H_
+#define DRAWQUEUE_H_
+
+#include "RadixSort.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum SortKeyField {
+	SORT_FIELD_PASS = 0,
+	SORT_FIELD_DEPTH,
+	SORT_FIELD_MATERIAL,
+	SORT_FIELD_STATE,
+	SORT_FIELD_COUNT
+};
+
+// Describes how the fields are packed. Order lists the fields from most to
+// least significant; Bits is indexed by field and may be 0 to leave a field
+// out. The widths must add up to at most 64.
+struct SortKeyLayout {
+	SortKeyField Order[SORT_FIELD_COUNT];
+	uint8_t Bits[SORT_FIELD_COUNT];
+	// Inverts the depth field so the farthest draws sort first.
+	bool BackToFront;
+};
+
+// Pass, state, material, then depth: opaque draws are grouped by state and
+// drawn front to back inside each group.
+SortKeyLayout OpaqueSortKeyLayout();
+// Pass, then depth back to front; material and state only break ties.
+SortKeyLayout TransparentSortKeyLayout();
+
+class SortKeyEncoder {
+public:
+	explicit SortKeyEncoder(const SortKeyLayout& layout);
+
+	// depth is the non-negative view-space distance. It is quantized by
+	// keeping the top bits of its IEEE representation, which preserves
+	// ordering without needing a near/far range. Other fields are
+	// truncated to their width.
+	uint64_t Encode(uint32_t pass, float depth, uint32_t material, uint32_t state) const;
+	uint32_t Decode(uint64_t key, SortKeyField field) const;
+
+	const SortKeyLayout& GetLayout() const { return m_layout; }
+
+private:
+	SortKeyLayout m_layout;
+	uint32_t m_shift[SORT_FIELD_COUNT];
+	uint64_t m_mask[SORT_FIELD_COUNT];
+};
+
+class DrawQueue {
+public:
+	DrawQueue();
+
+	// One queue per producer. reservePerQueue avoids reallocation while
+	// recording.
+	void Initialize(uint32_t queueCount, uint32_t reservePerQueue = 0);
+	void Reset();
+
+	uint32_t GetQueueCount() const { return (uint32_t)m_queues.size(); }
+
+	// Only one thread may push to a given queue at a time.
+	void Push(uint32_t queue, uint64_t key, uint32_t draw) {
+		SortItem item = { key, draw, 0 };
+		m_queues[queue].Items.push_back(item);
+	}
+
+	// Concatenates the queues in index order and sorts by key. The sort is
+	// stable, so equal keys keep that order and the result is deterministic
+	// as long as each queue is filled deterministically.
+	void Sort(JobSystem* jobs = nullptr);
+
+	const SortItem* GetItems() const { return m_count ? &m_items[0] : nullptr; }
+	uint32_t GetCount() const { return m_count; }
+
+private:
+	struct Queue {
+		std::vector<SortItem> Items;
+		// Keeps neighbouring producers off each other's cache lines.
+		char Padding[64];
+	};
+
+	std::vector<Queue> m_queues;
+	std::vector<SortItem> m_items;
+	std::vector<SortItem> m_scratch;
+	uint32_t m_count;
+};
+
+} // namespace Zeus
+
+#endif /* DRAWQUEUE_H_ */
@@ -0,0 +1,111 @@
+/*
+ * Format.h
+ *
+ * Engine pixel formats. The values match DXGI_FORMAT so descriptors can be
+ * handed to a D3D backend without translation.
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <cstdint>
+
+namespace Zeus {
+
+enum Format {
+	FORMAT_UNKNOWN = 0,
+	FORMAT_R32G32B32A32_FLOAT = 2,
+	FORMAT_R32G32B32A32_UINT = 3,
+	FORMAT_R32G32B32_FLOAT = 6,
+	FORMAT_R16G16B16A16_FLOAT = 10,
+	FORMAT_R16G16B16A16_UNORM = 11,
+	FORMAT_R32G32_FLOAT = 16,
+	FORMAT_R32G32_UINT = 17,
+	FORMAT_R10G10B10A2_UNORM = 24,
+	FORMAT_R11G11B10_FLOAT = 26,
+	FORMAT_R8G8B8A8_UNORM = 28,
+	FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	FORMAT_R8G8B8A8_UINT = 30,
+	FORMAT_R16G16_FLOAT = 34,
+	FORMAT_R16G16_UNORM = 35,
+	FORMAT_D32_FLOAT = 40,
+	FORMAT_R32_FLOAT = 41,
+	FORMAT_R32_UINT = 42,
+	FORMAT_D24_UNORM_S8_UINT = 45,
+	FORMAT_R8G8_UNORM = 49,
+	FORMAT_R16_FLOAT = 54,
+	FORMAT_D16_UNORM = 55,
+	FORMAT_R16_UNORM = 56,
+	FORMAT_R16_UINT = 57,
+	FORMAT_R8_UNORM = 61,
+	FORMAT_R8_UINT = 62,
+	FORMAT_R9G9B9E5_SHAREDEXP = 67,
+	FORMAT_BC1_UNORM = 71,
+	FORMAT_BC3_UNORM = 77,
+	FORMAT_BC4_UNORM = 80,
+	FORMAT_BC5_UNORM = 83,
+	FORMAT_B8G8R8A8_UNORM = 87,
+	FORMAT_BC6H_UF16 = 95,
+	FORMAT_BC7_UNORM = 98
+};
+
+// Bits per texel, or per 4x4 block divided by 16 for block-compressed formats.
+inline uint32_t BitsPerPixel(Format format) {
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT:
+	case FORMAT_R32G32B32A32_UINT:
+		return 128;
+	case FORMAT_R32G32B32_FLOAT:
+		return 96;
+	case FORMAT_R16G16B16A16_FLOAT:
+	case FORMAT_R16G16B16A16_UNORM:
+	case FORMAT_R32G32_FLOAT:
+	case FORMAT_R32G32_UINT:
+		return 64;
+	case FORMAT_R10G10B10A2_UNORM:
+	case FORMAT_R11G11B10_FLOAT:
+	case FORMAT_R8G8B8A8_UNORM:
+	case FORMAT_R8G8B8A8_UNORM_SRGB:
+	case FORMAT_R8G8B8A8_UINT:
+	case FORMAT_R16G16_FLOAT:
+	case FORMAT_R16G16_UNORM:
+	case FORMAT_D32_FLOAT:
+	case FORMAT_R32_FLOAT:
+	case FORMAT_R32_UINT:
+	case FORMAT_D24_UNORM_S8_UINT:
+	case FORMAT_R9G9B9E5_SHAREDEXP:
+	case FORMAT_B8G8R8A8_UNORM:
+		return 32;
+	case FORMAT_R8G8_UNORM:
+	case FORMAT_R16_FLOAT:
+	case FORMAT_D16_UNORM:
+	case FORMAT_R16_UNORM:
+	case FORMAT_R16_UINT:
+		return 16;
+	case FORMAT_R8_UNORM:
+	case FORMAT_R8_UINT:
+	case FORMAT_BC3_UNORM:
+	case FORMAT_BC5_UNORM:
+	case FORMAT_BC6H_UF16:
+	case FORMAT_BC7_UNORM:
+		return 8;
+	case FORMAT_BC1_UNORM:
+	case FORMAT_BC4_UNORM:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+inline bool IsBlockCompressed(Format format) {
+	return format >= FORMAT_BC1_UNORM && format != FORMAT_B8G8R8A8_UNORM;
+}
+
+inline bool IsDepthFormat(Format format) {
+	return format == FORMAT_D32_FLOAT || format == FORMAT_D24_UNORM_S8_UINT ||
+			format == FORMAT_D16_UNORM;
+}
+
+} // namespace Zeus
+
+#endif /* FORMAT_H_ */
@@ -0,0 +1,787 @@
+/*
+ * GlyphCache.cpp
+ *
+ */
+
+#include "GlyphCache.h"
+#include "Hash.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Edge colors are channel masks; any two of cyan, magenta and yellow share
+// exactly one channel.
+enum EdgeColor {
+	EDGE_RED = 1,
+	EDGE_GREEN = 2,
+	EDGE_BLUE = 4,
+	EDGE_YELLOW = EDGE_RED | EDGE_GREEN,
+	EDGE_MAGENTA = EDGE_RED | EDGE_BLUE,
+	EDGE_CYAN = EDGE_GREEN | EDGE_BLUE,
+	EDGE_WHITE = EDGE_RED | EDGE_GREEN | EDGE_BLUE
+};
+
+// Flattened pieces remember whether they start or end an original edge;
+// only those ends extend into pseudo-distances.
+const uint32_t PIECE_EDGE_START = 1;
+const uint32_t PIECE_EDGE_END = 2;
+
+// sin(3 rad): joins turning more than this are corners.
+const float CORNER_CROSS = 0.1411f;
+// Atlas cells are rounded up to multiples of this many texels.
+const uint32_t CELL_GRANULARITY = 8;
+const uint32_t GLYPH_GRAIN = 4;
+const uint32_t RUN_GRAIN = 16;
+// Key of free entries; no glyph key ends in GLYPH_LINE_BREAK.
+const uint64_t FREE_KEY = 0xffffffffffffffffull;
+
+struct Piece {
+	XMFLOAT2 A;
+	XMFLOAT2 B;
+	uint32_t Color;
+	uint32_t Flags;
+};
+
+XMFLOAT2 Lerp(const XMFLOAT2& a, const XMFLOAT2& b, float t) {
+	return XMFLOAT2(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+}
+
+XMFLOAT2 Subtract(const XMFLOAT2& a, const XMFLOAT2& b) {
+	return XMFLOAT2(a.x - b.x, a.y - b.y);
+}
+
+bool IsZero(const XMFLOAT2& v) {
+	return v.x == 0.0f && v.y == 0.0f;
+}
+
+XMFLOAT2 Normalize(const XMFLOAT2& v) {
+	float length = sqrtf(v.x * v.x + v.y * v.y);
+	return length > 0.0f ? XMFLOAT2(v.x / length, v.y / length) : XMFLOAT2(0.0f, 0.0f);
+}
+
+const XMFLOAT2& GetEnd(const GlyphEdge& edge) {
+	return edge.Points[edge.Type + 1];
+}
+
+// Direction leaving the start, skipping control points on top of it.
+XMFLOAT2 GetStartTangent(const GlyphEdge& edge) {
+	for (uint32_t i = 1; i <= (uint32_t)edge.Type + 1; ++i) {
+		XMFLOAT2 tangent = Subtract(edge.Points[i], edge.Points[0]);
+		if (!IsZero(tangent))
+			return Normalize(tangent);
+	}
+	return XMFLOAT2(0.0f, 0.0f);
+}
+
+XMFLOAT2 GetEndTangent(const GlyphEdge& edge) {
+	const uint32_t last = edge.Type + 1;
+	for (uint32_t i = last; i-- > 0;) {
+		XMFLOAT2 tangent = Subtract(edge.Points[last], edge.Points[i]);
+		if (!IsZero(tangent))
+			return Normalize(tangent);
+	}
+	return XMFLOAT2(0.0f, 0.0f);
+}
+
+XMFLOAT2 Evaluate(const GlyphEdge& edge, float t) {
+	XMFLOAT2 points[4];
+	const uint32_t count = edge.Type + 2;
+	memcpy(points, edge.Points, sizeof(points));
+	for (uint32_t level = count - 1; level > 0; --level)
+		for (uint32_t i = 0; i < level; ++i)
+			points[i] = Lerp(points[i], points[i + 1], t);
+	return points[0];
+}
+
+// de Casteljau split at t.
+void Split(const GlyphEdge& edge, float t, GlyphEdge& first, GlyphEdge& second) {
+	const uint32_t count = edge.Type + 2;
+	XMFLOAT2 points[4];
+	memcpy(points, edge.Points, sizeof(points));
+	first.Type = second.Type = edge.Type;
+	for (uint32_t level = 0; level < count; ++level) {
+		first.Points[level] = points[0];
+		second.Points[count - 1 - level] = points[count - 1 - level];
+		for (uint32_t i = 0; i + 1 < count - level; ++i)
+			points[i] = Lerp(points[i], points[i + 1], t);
+	}
+}
+
+bool IsCorner(const XMFLOAT2& incoming, const XMFLOAT2& outgoing) {
+	float dot = incoming.x * outgoing.x + incoming.y * outgoing.y;
+	float cross = incoming.x * outgoing.y - incoming.y * outgoing.x;
+	return dot <= 0.0f || fabsf(cross) > CORNER_CROSS;
+}
+
+// Simple edge coloring: edges between two corners share a color and the
+// color changes at every corner, so each corner sees two colors that
+// have one channel in common. Smooth contours stay white. A teardrop
+// (one corner) is split into thirds around its corner.
+void ColorContour(std::vector<GlyphEdge>& edges, std::vector<uint32_t>& colors) {
+	const uint32_t count = (uint32_t)edges.size();
+	colors.assign(count, EDGE_WHITE);
+	std::vector<uint32_t> corners;
+	for (uint32_t i = 0; i < count; ++i) {
+		const GlyphEdge& previous = edges[(i + count - 1) % count];
+		if (IsCorner(GetEndTangent(previous), GetStartTangent(edges[i])))
+			corners.push_back(i);
+	}
+	if (corners.empty())
+		return;
+
+	static const uint32_t CYCLE[3] = { EDGE_CYAN, EDGE_MAGENTA, EDGE_YELLOW };
+	if (corners.size() == 1) {
+		// Rotate the corner to the front and make sure there are at least
+		// three edges to color.
+		std::rotate(edges.begin(), edges.begin() + corners[0], edges.end());
+		while (edges.size() < 3) {
+			std::vector<GlyphEdge> split;
+			for (size_t i = 0; i < edges.size(); ++i) {
+				GlyphEdge first, second;
+				Split(edges[i], 0.5f, first, second);
+				split.push_back(first);
+				split.push_back(second);
+			}
+			edges.swap(split);
+		}
+		const uint32_t total = (uint32_t)edges.size();
+		colors.resize(total);
+		static const uint32_t TEARDROP[3] = { EDGE_MAGENTA, EDGE_WHITE, EDGE_YELLOW };
+		for (uint32_t i = 0; i < total; ++i)
+			colors[i] = TEARDROP[i * 3 / total];
+		return;
+	}
+
+	const uint32_t splines = (uint32_t)corners.size();
+	for (uint32_t s = 0; s < splines; ++s) {
+		uint32_t color = CYCLE[s % 3];
+		// The last spline also meets the first; pick the color neither uses.
+		if (s + 1 == splines && s % 3 == 0)
+			color = CYCLE[1];
+		for (uint32_t i = corners[s]; i != corners[(s + 1) % splines]; i = (i + 1) % count)
+			colors[i] = color;
+	}
+}
+
+// Curves become lines about two texels long.
+void Flatten(const GlyphEdge& edge, uint32_t color, float pixelsPerEm,
+		std::vector<Piece>& pieces) {
+	uint32_t steps = 1;
+	if (edge.Type != GLYPH_EDGE_LINE) {
+		float length = 0.0f;
+		for (uint32_t i = 0; i <= (uint32_t)edge.Type; ++i) {
+			XMFLOAT2 d = Subtract(edge.Points[i + 1], edge.Points[i]);
+			length += sqrtf(d.x * d.x + d.y * d.y);
+		}
+		steps = std::min(64u, std::max(2u, (uint32_t)ceilf(length * pixelsPerEm * 0.5f)));
+	}
+	XMFLOAT2 previous = edge.Points[0];
+	for (uint32_t i = 1; i <= steps; ++i) {
+		XMFLOAT2 next = i == steps ? GetEnd(edge) : Evaluate(edge, (float)i / steps);
+		Piece piece = { previous, next, color, 0 };
+		if (i == 1)
+			piece.Flags |= PIECE_EDGE_START;
+		if (i == steps)
+			piece.Flags |= PIECE_EDGE_END;
+		pieces.push_back(piece);
+		previous = next;
+	}
+}
+
+struct Candidate {
+	float Distance;
+	// |cos| between the piece and the direction to the point; breaks ties
+	// between pieces that share the nearest end point.
+	float Skew;
+	uint32_t Piece;
+	float T;
+};
+
+bool IsCloser(const Candidate& a, const Candidate& b) {
+	const float epsilon = 1e-6f;
+	if (a.Distance < b.Distance - epsilon)
+		return true;
+	return a.Distance <= b.Distance + epsilon && a.Skew < b.Skew;
+}
+
+uint8_t Encode(float distance, float range) {
+	float value = 0.5f + distance / range;
+	value = std::min(1.0f, std::max(0.0f, value));
+	return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+float Median(float a, float b, float c) {
+	return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+uint32_t CountCodePoints(const char* text) {
+	uint32_t count = 0;
+	while (*text)
+		DecodeUtf8(text), ++count;
+	return count;
+}
+
+} // namespace
+
+uint32_t DecodeUtf8(const char*& text) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(text);
+	uint32_t lead = bytes[0];
+	uint32_t length = lead < 0x80 ? 1 : lead < 0xc2 ? 0 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3
+			: lead < 0xf5 ? 4 : 0;
+	if (length == 0) {
+		++text;
+		return 0xfffd;
+	}
+	// The second byte rules out overlong forms, surrogates and code points
+	// past U+10FFFF.
+	uint32_t low = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+	uint32_t high = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+	if (length > 1 && (bytes[1] < low || bytes[1] > high)) {
+		++text;
+		return 0xfffd;
+	}
+	uint32_t codePoint = length == 1 ? lead : lead & (0x7f >> length);
+	for (uint32_t i = 1; i < length; ++i) {
+		if ((bytes[i] & 0xc0) != 0x80) {
+			text += i;
+			return 0xfffd;
+		}
+		codePoint = (codePoint << 6) | (bytes[i] & 0x3f);
+	}
+	text += length;
+	return codePoint;
+}
+
+bool GenerateMsdf(const GlyphOutline& outline, const MsdfSettings& settings,
+		GlyphBitmap& bitmap) {
+	const float ppem = settings.PixelsPerEm;
+	bitmap.Width = bitmap.Height = 0;
+	bitmap.Plane = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	bitmap.Pixels.clear();
+
+	std::vector<Piece> pieces;
+	std::vector<GlyphEdge> contour;
+	std::vector<uint32_t> colors;
+	uint32_t first = 0;
+	for (size_t c = 0; c < outline.ContourEnds.size(); ++c) {
+		const uint32_t end = outline.ContourEnds[c];
+		if (end <= first)
+			continue;
+		contour.assign(outline.Edges.begin() + first, outline.Edges.begin() + end);
+		for (size_t i = 0; i < contour.size(); ++i) {
+			const XMFLOAT2& next = contour[(i + 1) % contour.size()].Points[0];
+			const XMFLOAT2& last = GetEnd(contour[i]);
+			if (fabsf(next.x - last.x) > 1e-4f || fabsf(next.y - last.y) > 1e-4f)
+				return false;
+		}
+		ColorContour(contour, colors);
+		for (size_t i = 0; i < contour.size(); ++i)
+			Flatten(contour[i], colors[i], ppem, pieces);
+		first = end;
+	}
+	if (pieces.empty())
+		return true;
+
+	// Positive area means counter-clockwise fill; flip the per-piece signs
+	// of clockwise (TrueType) outlines so inside is positive.
+	float area = 0.0f;
+	XMFLOAT2 minimum = pieces[0].A, maximum = pieces[0].A;
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		const Piece& piece = pieces[i];
+		area += piece.A.x * piece.B.y - piece.B.x * piece.A.y;
+		minimum = XMFLOAT2(std::min(minimum.x, piece.B.x), std::min(minimum.y, piece.B.y));
+		maximum = XMFLOAT2(std::max(maximum.x, piece.B.x), std::max(maximum.y, piece.B.y));
+	}
+	const float orientation = area < 0.0f ? -1.0f : 1.0f;
+
+	const float padding = settings.Range * 0.5f + 1.0f;
+	const int32_t left = (int32_t)floorf(minimum.x * ppem - padding);
+	const int32_t right = (int32_t)ceilf(maximum.x * ppem + padding);
+	const int32_t bottom = (int32_t)floorf(minimum.y * ppem - padding);
+	const int32_t top = (int32_t)ceilf(maximum.y * ppem + padding);
+	bitmap.Width = right - left;
+	bitmap.Height = top - bottom;
+	bitmap.Plane = XMFLOAT4(left / ppem, top / ppem, right / ppem, bottom / ppem);
+	bitmap.Pixels.resize(bitmap.Width * bitmap.Height);
+
+	const uint32_t pieceCount = (uint32_t)pieces.size();
+	for (uint32_t row = 0; row < bitmap.Height; ++row) {
+		const float py = (top - (float)row - 0.5f) / ppem;
+		for (uint32_t column = 0; column < bitmap.Width; ++column) {
+			const float px = (left + (float)column + 0.5f) / ppem;
+			Candidate best[3], nearest;
+			best[0].Distance = best[1].Distance = best[2].Distance = FLT_MAX;
+			best[0].Skew = best[1].Skew = best[2].Skew = 1.0f;
+			nearest = best[0];
+			int32_t winding = 0;
+			for (uint32_t i = 0; i < pieceCount; ++i) {
+				const Piece& piece = pieces[i];
+				const float dx = piece.B.x - piece.A.x;
+				const float dy = piece.B.y - piece.A.y;
+				const float lengthSquared = dx * dx + dy * dy;
+				const float ax = px - piece.A.x;
+				const float ay = py - piece.A.y;
+				if ((piece.A.y <= py) != (piece.B.y <= py)) {
+					float x = piece.A.x + (py - piece.A.y) / dy * dx;
+					if (x > px)
+						winding += piece.B.y > piece.A.y ? 1 : -1;
+				}
+				if (lengthSquared <= 0.0f)
+					continue;
+				Candidate candidate;
+				candidate.T = (ax * dx + ay * dy) / lengthSquared;
+				const float t = std::min(1.0f, std::max(0.0f, candidate.T));
+				const float ox = ax - dx * t;
+				const float oy = ay - dy * t;
+				candidate.Distance = sqrtf(ox * ox + oy * oy);
+				candidate.Skew = 0.0f;
+				if (t != candidate.T && candidate.Distance > 0.0f)
+					candidate.Skew = fabsf(ox * dx + oy * dy)
+							/ (candidate.Distance * sqrtf(lengthSquared));
+				candidate.Piece = i;
+				if (IsCloser(candidate, nearest))
+					nearest = candidate;
+				for (uint32_t channel = 0; channel < 3; ++channel)
+					if ((piece.Color & (1u << channel)) && IsCloser(candidate, best[channel]))
+						best[channel] = candidate;
+			}
+
+			float trueDistance = nearest.Distance * (winding != 0 ? 1.0f : -1.0f);
+			float distances[3];
+			for (uint32_t channel = 0; channel < 3; ++channel) {
+				const Candidate& candidate = best[channel];
+				if (candidate.Distance == FLT_MAX) {
+					distances[channel] = trueDistance;
+					continue;
+				}
+				const Piece& piece = pieces[candidate.Piece];
+				const float dx = piece.B.x - piece.A.x;
+				const float dy = piece.B.y - piece.A.y;
+				const float cross = (dx * (py - piece.A.y) - dy * (px - piece.A.x))
+						/ sqrtf(dx * dx + dy * dy);
+				float distance = cross < 0.0f ? -candidate.Distance : candidate.Distance;
+				// Past the end of an edge the perpendicular distance to its
+				// extension keeps the corner sharp.
+				bool extend = (candidate.T < 0.0f && (piece.Flags & PIECE_EDGE_START))
+						|| (candidate.T > 1.0f && (piece.Flags & PIECE_EDGE_END));
+				if (extend && fabsf(cross) <= candidate.Distance)
+					distance = cross;
+				distances[channel] = distance * orientation;
+			}
+			if ((Median(distances[0], distances[1], distances[2]) > 0.0f)
+					!= (trueDistance > 0.0f))
+				distances[0] = distances[1] = distances[2] = trueDistance;
+
+			const float range = settings.Range;
+			bitmap.Pixels[row * bitmap.Width + column] =
+					(uint32_t)Encode(distances[0] * ppem, range)
+					| ((uint32_t)Encode(distances[1] * ppem, range) << 8)
+					| ((uint32_t)Encode(distances[2] * ppem, range) << 16)
+					| ((uint32_t)Encode(trueDistance * ppem, range) << 24);
+		}
+	}
+	return true;
+}
+
+GlyphCache::GlyphCache()
+		: m_slots(64, NONE), m_shelfTop(0), m_width(0), m_height(0), m_generation(0),
+		m_texture(NULL_RESOURCE), m_frame(1) {
+	memset(&m_dirty, 0, sizeof(m_dirty));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void GlyphCache::Initialize(const GlyphCacheSettings& settings) {
+	Shutdown();
+	m_settings = settings;
+	m_width = m_height = settings.InitialSize;
+	m_pixels.assign(m_width * m_height, 0);
+	++m_generation;
+}
+
+void GlyphCache::Shutdown() {
+	m_fonts.clear();
+	m_entries.clear();
+	m_freeEntries.clear();
+	m_failedEntries.clear();
+	m_slots.assign(64, NONE);
+	m_classes.clear();
+	m_shelves.clear();
+	m_shelfTop = 0;
+	m_pixels.clear();
+	m_width = m_height = 0;
+	memset(&m_dirty, 0, sizeof(m_dirty));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+uint32_t GlyphCache::AddFont(const GlyphSource* source, const MsdfSettings& settings) {
+	Font font;
+	font.Source = source;
+	font.Settings = settings;
+	font.Metrics = source->GetMetrics();
+	m_fonts.push_back(font);
+	return (uint32_t)m_fonts.size() - 1;
+}
+
+void GlyphCache::BeginFrame() {
+	++m_frame;
+	for (size_t i = 0; i < m_failedEntries.size(); ++i)
+		RemoveEntry(m_failedEntries[i]);
+	m_failedEntries.clear();
+	m_stats.Generated = 0;
+	m_stats.Evicted = 0;
+	m_stats.Failed = 0;
+}
+
+uint32_t GlyphCache::FindEntry(uint64_t key) const {
+	const size_t mask = m_slots.size() - 1;
+	for (size_t slot = (size_t)HashMix(key) & mask;; slot = (slot + 1) & mask) {
+		uint32_t entry = m_slots[slot];
+		if (entry == NONE || m_entries[entry].Key == key)
+			return entry;
+	}
+}
+
+uint32_t GlyphCache::InsertEntry(uint64_t key) {
+	if ((m_stats.EntryCount + 1) * 2 > m_slots.size()) {
+		m_slots.assign(m_slots.size() * 2, NONE);
+		for (uint32_t i = 0; i < (uint32_t)m_entries.size(); ++i) {
+			if (m_entries[i].Key == FREE_KEY)
+				continue;
+			size_t mask = m_slots.size() - 1;
+			size_t slot = (size_t)HashMix(m_entries[i].Key) & mask;
+			while (m_slots[slot] != NONE)
+				slot = (slot + 1) & mask;
+			m_slots[slot] = i;
+		}
+	}
+	Entry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.Key = key;
+	entry.Class = entry.Previous = entry.Next = NONE;
+	uint32_t index;
+	if (m_freeEntries.empty()) {
+		index = (uint32_t)m_entries.size();
+		m_entries.push_back(entry);
+	} else {
+		index = m_freeEntries.back();
+		m_freeEntries.pop_back();
+		m_entries[index] = entry;
+	}
+	++m_stats.EntryCount;
+	const size_t mask = m_slots.size() - 1;
+	size_t slot = (size_t)HashMix(key) & mask;
+	while (m_slots[slot] != NONE)
+		slot = (slot + 1) & mask;
+	m_slots[slot] = index;
+	return index;
+}
+
+// Deletes without tombstones by shifting the rest of the probe run back.
+void GlyphCache::RemoveEntry(uint32_t index) {
+	const size_t mask = m_slots.size() - 1;
+	size_t hole = (size_t)HashMix(m_entries[index].Key) & mask;
+	while (m_slots[hole] != index)
+		hole = (hole + 1) & mask;
+	for (size_t slot = (hole + 1) & mask; m_slots[slot] != NONE; slot = (slot + 1) & mask) {
+		// An entry may move back unless its home lies after the hole.
+		size_t home = (size_t)HashMix(m_entries[m_slots[slot]].Key) & mask;
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			m_slots[hole] = m_slots[slot];
+			hole = slot;
+		}
+	}
+	m_slots[hole] = NONE;
+	m_entries[index].Key = FREE_KEY;
+	m_freeEntries.push_back(index);
+	--m_stats.EntryCount;
+}
+
+const GlyphInfo* GlyphCache::Find(uint64_t key) const {
+	uint32_t entry = FindEntry(key);
+	return entry != NONE && m_entries[entry].Resident ? &m_entries[entry].Info : nullptr;
+}
+
+uint32_t GlyphCache::GetClass(uint32_t width, uint32_t height) {
+	width = (width + CELL_GRANULARITY - 1) / CELL_GRANULARITY * CELL_GRANULARITY;
+	height = (height + CELL_GRANULARITY - 1) / CELL_GRANULARITY * CELL_GRANULARITY;
+	for (uint32_t i = 0; i < (uint32_t)m_classes.size(); ++i)
+		if (m_classes[i].Width == width && m_classes[i].Height == height)
+			return i;
+	CellClass cellClass;
+	cellClass.Width = width;
+	cellClass.Height = height;
+	cellClass.Oldest = cellClass.Newest = NONE;
+	m_classes.push_back(cellClass);
+	return (uint32_t)m_classes.size() - 1;
+}
+
+void GlyphCache::Unlink(uint32_t index) {
+	Entry& entry = m_entries[index];
+	CellClass& cellClass = m_classes[entry.Class];
+	if (entry.Previous != NONE)
+		m_entries[entry.Previous].Next = entry.Next;
+	else
+		cellClass.Oldest = entry.Next;
+	if (entry.Next != NONE)
+		m_entries[entry.Next].Previous = entry.Previous;
+	else
+		cellClass.Newest = entry.Previous;
+	entry.Previous = entry.Next = NONE;
+}
+
+void GlyphCache::Touch(uint32_t index) {
+	Entry& entry = m_entries[index];
+	entry.LastUsed = m_frame;
+	if (entry.Class == NONE)
+		return;
+	CellClass& cellClass = m_classes[entry.Class];
+	// Freshly stored glyphs are not linked yet.
+	if (entry.Previous != NONE || cellClass.Oldest == index)
+		Unlink(index);
+	entry.Previous = cellClass.Newest;
+	if (cellClass.Newest != NONE)
+		m_entries[cellClass.Newest].Next = index;
+	else
+		cellClass.Oldest = index;
+	cellClass.Newest = index;
+}
+
+bool GlyphCache::Grow() {
+	uint32_t width = m_width, height = m_height;
+	if (width <= height && width * 2 <= m_settings.MaxSize)
+		width *= 2;
+	else if (height * 2 <= m_settings.MaxSize)
+		height *= 2;
+	else if (width * 2 <= m_settings.MaxSize)
+		width *= 2;
+	else
+		return false;
+	std::vector<uint32_t> pixels(width * height, 0);
+	for (uint32_t y = 0; y < m_height; ++y)
+		memcpy(&pixels[y * width], &m_pixels[y * m_width], m_width * sizeof(uint32_t));
+	m_pixels.swap(pixels);
+	m_width = width;
+	m_height = height;
+	++m_generation;
+	// The new texture needs everything.
+	m_dirty.Left = m_dirty.Top = 0;
+	m_dirty.Right = (int32_t)width;
+	m_dirty.Bottom = (int32_t)height;
+	return true;
+}
+
+bool GlyphCache::AllocateCell(uint32_t index, uint32_t& x, uint32_t& y) {
+	CellClass& cellClass = m_classes[index];
+	do {
+		for (size_t i = 0; i < m_shelves.size(); ++i) {
+			Shelf& shelf = m_shelves[i];
+			if (shelf.Class == index && shelf.NextX + cellClass.Width <= m_width) {
+				x = shelf.NextX;
+				y = shelf.Y;
+				shelf.NextX += cellClass.Width;
+				return true;
+			}
+		}
+		if (m_shelfTop + cellClass.Height <= m_height && cellClass.Width <= m_width) {
+			Shelf shelf = { m_shelfTop, index, cellClass.Width };
+			m_shelves.push_back(shelf);
+			m_shelfTop += cellClass.Height;
+			x = 0;
+			y = shelf.Y;
+			return true;
+		}
+	} while (Grow());
+
+	// Full at the largest size: take the cell of the oldest glyph of this
+	// class unless it is in use this frame.
+	uint32_t oldest = cellClass.Oldest;
+	if (oldest == NONE || m_entries[oldest].LastUsed == m_frame)
+		return false;
+	Unlink(oldest);
+	x = m_entries[oldest].Info.X;
+	y = m_entries[oldest].Info.Y;
+	RemoveEntry(oldest);
+	--m_stats.ResidentGlyphs;
+	++m_stats.Evicted;
+	return true;
+}
+
+void GlyphCache::Store(uint32_t index, const GlyphBitmap& bitmap) {
+	Entry& entry = m_entries[index];
+	entry.Info.Plane = bitmap.Plane;
+	entry.Info.Width = (uint16_t)bitmap.Width;
+	entry.Info.Height = (uint16_t)bitmap.Height;
+	entry.Info.X = entry.Info.Y = 0;
+	if (bitmap.Width > 0) {
+		uint32_t cellClass = GetClass(bitmap.Width, bitmap.Height);
+		uint32_t x, y;
+		if (!AllocateCell(cellClass, x, y)) {
+			m_failedEntries.push_back(index);
+			++m_stats.Failed;
+			return;
+		}
+		for (uint32_t row = 0; row < bitmap.Height; ++row)
+			memcpy(&m_pixels[(y + row) * m_width + x], &bitmap.Pixels[row * bitmap.Width],
+					bitmap.Width * sizeof(uint32_t));
+		ScissorRect rect = { (int32_t)x, (int32_t)y, (int32_t)(x + bitmap.Width),
+				(int32_t)(y + bitmap.Height) };
+		if (m_dirty.Left >= m_dirty.Right || m_dirty.Top >= m_dirty.Bottom) {
+			m_dirty = rect;
+		} else {
+			m_dirty.Left = std::min(m_dirty.Left, rect.Left);
+			m_dirty.Top = std::min(m_dirty.Top, rect.Top);
+			m_dirty.Right = std::max(m_dirty.Right, rect.Right);
+			m_dirty.Bottom = std::max(m_dirty.Bottom, rect.Bottom);
+		}
+		entry.Info.X = (uint16_t)x;
+		entry.Info.Y = (uint16_t)y;
+		entry.Class = cellClass;
+	}
+	entry.Resident = true;
+	++m_stats.ResidentGlyphs;
+	Touch(index);
+}
+
+bool GlyphCache::Request(const uint64_t* keys, uint32_t count, JobSystem* jobs) {
+	m_missing.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		if ((uint32_t)keys[i] == GLYPH_LINE_BREAK)
+			continue;
+		uint32_t entry = FindEntry(keys[i]);
+		if (entry == NONE)
+			entry = InsertEntry(keys[i]);
+		else if (m_entries[entry].Resident) {
+			Touch(entry);
+			continue;
+		} else if (m_entries[entry].LastUsed == m_frame) {
+			// Already missing earlier in this batch.
+			continue;
+		}
+		m_entries[entry].LastUsed = m_frame;
+		m_missing.push_back(entry);
+	}
+	if (m_missing.empty())
+		return true;
+
+	m_bitmaps.resize(m_missing.size());
+	ParallelFor(jobs, (uint32_t)m_missing.size(), GLYPH_GRAIN, [&](uint32_t begin, uint32_t end) {
+		GlyphOutline outline;
+		for (uint32_t i = begin; i < end; ++i) {
+			Entry& entry = m_entries[m_missing[i]];
+			const Font& font = m_fonts[(uint32_t)(entry.Key >> 32)];
+			outline.Clear();
+			GlyphBitmap& bitmap = m_bitmaps[i];
+			if (!font.Source->GetOutline((uint32_t)entry.Key, outline)
+					|| !GenerateMsdf(outline, font.Settings, bitmap)) {
+				bitmap.Width = bitmap.Height = 0;
+				bitmap.Plane = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				bitmap.Pixels.clear();
+			}
+			entry.Info.Advance = font.Source->GetAdvance((uint32_t)entry.Key);
+		}
+	});
+
+	const uint32_t failed = m_stats.Failed;
+	for (size_t i = 0; i < m_missing.size(); ++i)
+		Store(m_missing[i], m_bitmaps[i]);
+	m_stats.Generated += (uint32_t)m_missing.size();
+	return m_stats.Failed == failed;
+}
+
+bool GlyphCache::MakeSprite(const GlyphInfo& glyph, const XMFLOAT2& pen, float size,
+		uint32_t color, float depth, Sprite& sprite) const {
+	if (glyph.Width == 0)
+		return false;
+	const float inverseWidth = 1.0f / m_width;
+	const float inverseHeight = 1.0f / m_height;
+	sprite.Texture = m_texture;
+	sprite.Color = color;
+	sprite.Position = XMFLOAT2(pen.x + glyph.Plane.x * size, pen.y - glyph.Plane.y * size);
+	sprite.Size = XMFLOAT2((glyph.Plane.z - glyph.Plane.x) * size,
+			(glyph.Plane.y - glyph.Plane.w) * size);
+	sprite.Pivot = XMFLOAT2(0.0f, 0.0f);
+	sprite.Rotation = 0.0f;
+	sprite.Depth = depth;
+	sprite.TexCoords = XMFLOAT4(glyph.X * inverseWidth, glyph.Y * inverseHeight,
+			(glyph.X + glyph.Width) * inverseWidth, (glyph.Y + glyph.Height) * inverseHeight);
+	return true;
+}
+
+void GlyphCache::Layout(const TextRun* runs, uint32_t count, std::vector<Sprite>& sprites,
+		JobSystem* jobs) {
+	m_runOffsets.resize(count + 1);
+	m_runOffsets[0] = 0;
+	for (uint32_t i = 0; i < count; ++i)
+		m_runOffsets[i + 1] = m_runOffsets[i] + CountCodePoints(runs[i].Text);
+	const uint32_t total = m_runOffsets[count];
+	m_keys.resize(total);
+	ParallelFor(jobs, count, RUN_GRAIN, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const GlyphSource* source = m_fonts[runs[i].Font].Source;
+			const char* text = runs[i].Text;
+			for (uint32_t k = m_runOffsets[i]; k < m_runOffsets[i + 1]; ++k) {
+				uint32_t codePoint = DecodeUtf8(text);
+				uint32_t glyph = codePoint == '\n' ? GLYPH_LINE_BREAK
+						: source->GetGlyphIndex(codePoint);
+				m_keys[k] = MakeKey(runs[i].Font, glyph);
+			}
+		}
+	});
+
+	if (total > 0)
+		Request(&m_keys[0], total, jobs);
+
+	m_runCounts.resize(count);
+	m_runSprites.resize(total);
+	ParallelFor(jobs, count, RUN_GRAIN, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const TextRun& run = runs[i];
+			const Font& font = m_fonts[run.Font];
+			const float lineHeight = (font.Metrics.Ascent + font.Metrics.Descent
+					+ font.Metrics.LineGap) * run.Size;
+			XMFLOAT2 pen = run.Position;
+			uint32_t previous = GLYPH_LINE_BREAK;
+			uint32_t written = 0;
+			for (uint32_t k = m_runOffsets[i]; k < m_runOffsets[i + 1]; ++k) {
+				const uint32_t glyph = (uint32_t)m_keys[k];
+				if (glyph == GLYPH_LINE_BREAK) {
+					pen.x = run.Position.x;
+					pen.y += lineHeight;
+					previous = GLYPH_LINE_BREAK;
+					continue;
+				}
+				if (previous != GLYPH_LINE_BREAK)
+					pen.x += font.Source->GetKerning(previous, glyph) * run.Size;
+				previous = glyph;
+				const Entry& entry = m_entries[FindEntry(m_keys[k])];
+				if (entry.Resident && MakeSprite(entry.Info, pen, run.Size, run.Color, run.Depth,
+						m_runSprites[m_runOffsets[i] + written]))
+					++written;
+				pen.x += entry.Info.Advance * run.Size;
+			}
+			m_runCounts[i] = written;
+		}
+	});
+
+	for (uint32_t i = 0; i < count; ++i)
+		sprites.insert(sprites.end(), m_runSprites.begin() + m_runOffsets[i],
+				m_runSprites.begin() + m_runOffsets[i] + m_runCounts[i]);
+}
+
+bool GlyphCache::GetDirtyRect(ScissorRect& rect) const {
+	rect = m_dirty;
+	return m_dirty.Left < m_dirty.Right && m_dirty.Top < m_dirty.Bottom;
+}
+
+void GlyphCache::ClearDirty() {
+	memset(&m_dirty, 0, sizeof(m_dirty));
+}
+
+} // namespace Zeus
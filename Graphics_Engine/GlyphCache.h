@@ -0,0 +1,306 @@
+/*
+ * GlyphCache.h
+ *
+ * Multi-channel signed distance field glyphs in a shared atlas, replacing
+ * the per-size glyph textures of ID3DXFont and IDWriteGlyphRunAnalysis.
+ *
+ * Every glyph is generated once per font at MsdfSettings::PixelsPerEm and
+ * drawn at any size from the same texels. The red, green and blue
+ * channels hold distances to differently colored edge sets, so corners
+ * stay sharp when magnified; alpha holds the true signed distance for
+ * outlines and shadows. Values are 0.5 + distance / Range, inside above
+ * one half. The pixel shader reconstructs coverage from the median of
+ * red, green and blue with
+ *
+ *     screenRange = Range * glyphPixels / PixelsPerEm
+ *     alpha = saturate(screenRange * (median - 0.5) + 0.5)
+ *
+ * Outlines come from a GlyphSource, so the cache works the same over
+ * GetGlyphOutline, DirectWrite's GetGlyphRunOutline or a font file
+ * parser. Missing glyphs of a batch are generated in parallel.
+ *
+ * The atlas grows by doubling up to its maximum size and then evicts the
+ * least recently used glyphs of the same cell size, so memory stays
+ * bounded however many glyphs pass through. Glyphs used since the last
+ * BeginFrame() are never evicted.
+ */
+
+#ifndef GLYPHCACHE_H_
+#define GLYPHCACHE_H_
+
+#include "CommandList.h"
+#include "SpriteBatcher.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum GlyphEdgeType {
+	GLYPH_EDGE_LINE,
+	GLYPH_EDGE_QUADRATIC,
+	GLYPH_EDGE_CUBIC
+};
+
+// Points[0] is the start and Points[Type + 1] the end.
+struct GlyphEdge {
+	GlyphEdgeType Type;
+	XMFLOAT2 Points[4];
+};
+
+// Em units with y up. Contours are closed and may be wound either way;
+// the outline is filled with the nonzero rule.
+struct GlyphOutline {
+	std::vector<GlyphEdge> Edges;
+	// One past the last edge of every contour.
+	std::vector<uint32_t> ContourEnds;
+
+	void Clear() {
+		Edges.clear();
+		ContourEnds.clear();
+	}
+};
+
+// Em units; ascent above and descent below the baseline, both positive.
+struct FontMetrics {
+	float Ascent;
+	float Descent;
+	float LineGap;
+};
+
+// Called from job threads; implementations must be safe to call
+// concurrently.
+class GlyphSource {
+public:
+	virtual ~GlyphSource() {}
+	virtual FontMetrics GetMetrics() const = 0;
+	// Glyph 0 is the missing glyph.
+	virtual uint32_t GetGlyphIndex(uint32_t codePoint) const = 0;
+	// Em units. Layout asks for advances without generating glyphs.
+	virtual float GetAdvance(uint32_t glyph) const = 0;
+	virtual bool GetOutline(uint32_t glyph, GlyphOutline& outline) const = 0;
+	// Em units added to the advance of left when followed by right.
+	virtual float GetKerning(uint32_t left, uint32_t right) const {
+		(void)left;
+		(void)right;
+		return 0.0f;
+	}
+};
+
+struct MsdfSettings {
+	float PixelsPerEm;
+	// Distance in texels between the 0 and 1 encodings.
+	float Range;
+
+	MsdfSettings() : PixelsPerEm(32.0f), Range(4.0f) {}
+};
+
+struct GlyphBitmap {
+	uint32_t Width;
+	uint32_t Height;
+	// Left, top, right and bottom of the bitmap relative to the pen, in em
+	// units with y up.
+	XMFLOAT4 Plane;
+	// R8G8B8A8, top row first.
+	std::vector<uint32_t> Pixels;
+};
+
+// Decodes one UTF-8 sequence and advances text past it. Malformed bytes
+// decode to U+FFFD one at a time.
+uint32_t DecodeUtf8(const char*& text);
+
+// Colors the edges at corners, flattens the curves and evaluates the
+// field. Texels whose median disagrees with the true inside test fall back
+// to the true distance in all channels. Returns false for outlines that
+// are not closed.
+bool GenerateMsdf(const GlyphOutline& outline, const MsdfSettings& settings,
+		GlyphBitmap& bitmap);
+
+// Not a glyph; marks line breaks in streams of glyph keys.
+const uint32_t GLYPH_LINE_BREAK = 0xffffffff;
+
+struct GlyphInfo {
+	// Atlas texels; zero sized for blank glyphs.
+	uint16_t X;
+	uint16_t Y;
+	uint16_t Width;
+	uint16_t Height;
+	XMFLOAT4 Plane;
+	float Advance;
+};
+
+struct GlyphCacheSettings {
+	uint32_t InitialSize;
+	uint32_t MaxSize;
+
+	GlyphCacheSettings() : InitialSize(512), MaxSize(4096) {}
+};
+
+struct TextRun {
+	uint32_t Font;
+	// UTF-8, null terminated. '\n' starts a new line.
+	const char* Text;
+	// Pen position of the first baseline, in pixels with y down.
+	XMFLOAT2 Position;
+	// Pixels per em.
+	float Size;
+	uint32_t Color;
+	float Depth;
+};
+
+struct GlyphCacheStats {
+	// Glyphs known to the cache; evicted glyphs are forgotten.
+	uint32_t EntryCount;
+	uint32_t ResidentGlyphs;
+	// Since the last BeginFrame().
+	uint32_t Generated;
+	uint32_t Evicted;
+	// Glyphs that did not fit even after eviction and were skipped.
+	uint32_t Failed;
+};
+
+class GlyphCache {
+public:
+	GlyphCache();
+
+	void Initialize(const GlyphCacheSettings& settings);
+	// Drops every glyph and font.
+	void Shutdown();
+
+	// source must outlive the cache. Returns the font index.
+	uint32_t AddFont(const GlyphSource* source, const MsdfSettings& settings);
+	const FontMetrics& GetMetrics(uint32_t font) const { return m_fonts[font].Metrics; }
+	const MsdfSettings& GetMsdfSettings(uint32_t font) const { return m_fonts[font].Settings; }
+	uint32_t GetGlyphIndex(uint32_t font, uint32_t codePoint) const {
+		return m_fonts[font].Source->GetGlyphIndex(codePoint);
+	}
+	float GetAdvance(uint32_t font, uint32_t glyph) const {
+		return m_fonts[font].Source->GetAdvance(glyph);
+	}
+	float GetKerning(uint32_t font, uint32_t left, uint32_t right) const {
+		return m_fonts[font].Source->GetKerning(left, right);
+	}
+
+	// Sprites reference this texture. Recreate it whenever
+	// GetGeneration() changes.
+	void SetTexture(ResourceHandle texture) { m_texture = texture; }
+	ResourceHandle GetTexture() const { return m_texture; }
+
+	void BeginFrame();
+
+	// Makes glyphs resident and marks them used this frame, generating
+	// missing ones in parallel. Keys come from MakeKey(); keys of
+	// GLYPH_LINE_BREAK are skipped. Returns false if some did not fit.
+	static uint64_t MakeKey(uint32_t font, uint32_t glyph) {
+		return ((uint64_t)font << 32) | glyph;
+	}
+	bool Request(const uint64_t* keys, uint32_t count, JobSystem* jobs);
+	// Null unless resident.
+	const GlyphInfo* Find(uint64_t key) const;
+
+	// Sprite for a resident glyph with its pen at pen (pixels, y down).
+	// Returns false for blank glyphs.
+	bool MakeSprite(const GlyphInfo& glyph, const XMFLOAT2& pen, float size, uint32_t color,
+			float depth, Sprite& sprite) const;
+
+	// Shapes and lays out runs in one batch and appends their sprites.
+	void Layout(const TextRun* runs, uint32_t count, std::vector<Sprite>& sprites,
+			JobSystem* jobs);
+
+	// CPU copy of the atlas (R8G8B8A8) and the texels changed since the
+	// last ClearDirty(). GetGeneration() changes when the atlas grows.
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	const uint32_t* GetPixels() const { return m_pixels.empty() ? nullptr : &m_pixels[0]; }
+	uint32_t GetGeneration() const { return m_generation; }
+	bool GetDirtyRect(ScissorRect& rect) const;
+	void ClearDirty();
+
+	const GlyphCacheStats& GetStats() const { return m_stats; }
+
+private:
+	GlyphCache(const GlyphCache&);
+	GlyphCache& operator=(const GlyphCache&);
+
+	enum { NONE = 0xffffffff };
+
+	struct Font {
+		const GlyphSource* Source;
+		MsdfSettings Settings;
+		FontMetrics Metrics;
+	};
+
+	struct Entry {
+		uint64_t Key;
+		GlyphInfo Info;
+		bool Resident;
+		uint32_t LastUsed;
+		// Cell size class and its LRU list, oldest first.
+		uint32_t Class;
+		uint32_t Previous;
+		uint32_t Next;
+	};
+
+	// A row of equally sized cells.
+	struct Shelf {
+		uint32_t Y;
+		uint32_t Class;
+		uint32_t NextX;
+	};
+
+	struct CellClass {
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Oldest;
+		uint32_t Newest;
+	};
+
+	uint32_t FindEntry(uint64_t key) const;
+	uint32_t InsertEntry(uint64_t key);
+	void RemoveEntry(uint32_t index);
+	uint32_t GetClass(uint32_t width, uint32_t height);
+	void Touch(uint32_t index);
+	void Unlink(uint32_t index);
+	// Grows the atlas or evicts to make room. index is the cell class.
+	bool AllocateCell(uint32_t index, uint32_t& x, uint32_t& y);
+	bool Grow();
+	void Store(uint32_t index, const GlyphBitmap& bitmap);
+
+	GlyphCacheSettings m_settings;
+	std::vector<Font> m_fonts;
+	std::vector<Entry> m_entries;
+	// Entries of evicted glyphs, reused before m_entries grows.
+	std::vector<uint32_t> m_freeEntries;
+	// Glyphs that did not fit; Layout() still reads them this frame.
+	std::vector<uint32_t> m_failedEntries;
+	// Open-addressed index into m_entries.
+	std::vector<uint32_t> m_slots;
+	std::vector<CellClass> m_classes;
+	std::vector<Shelf> m_shelves;
+	uint32_t m_shelfTop;
+	std::vector<uint32_t> m_pixels;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_generation;
+	ScissorRect m_dirty;
+	ResourceHandle m_texture;
+	uint32_t m_frame;
+	GlyphCacheStats m_stats;
+
+	// Per batch scratch.
+	std::vector<uint32_t> m_missing;
+	std::vector<GlyphBitmap> m_bitmaps;
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_runOffsets;
+	std::vector<uint32_t> m_runCounts;
+	std::vector<Sprite> m_runSprites;
+};
+
+} // namespace Zeus
+
+#endif /* GLYPHCACHE_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Hash.h
+ *
+ * Non-cryptographic hashing for cache keys.
+ */
+
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Zeus {
+
+const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+// 64-bit FNV-1a.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+inline uint64_t HashCombine(uint64_t hash, uint64_t value) {
+	hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+// Finalizer from MurmurHash3; spreads integer keys over all 64 bits.
+inline uint64_t HashMix(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+} // namespace Zeus
+
+#endif /* HASH_H_ */
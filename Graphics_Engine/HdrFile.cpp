@@ -0,0 +1,646 @@
+/*
+ * HdrFile.cpp
+ *
+ */
+
+#include "HdrFile.h"
+#include "HdrImage.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const size_t FILE_BUFFER_SIZE = 64 * 1024;
+
+// Buffered sequential reads. Scanlines are decoded straight out of the
+// buffer, so memory use does not grow with the file.
+class FileReader {
+public:
+	explicit FileReader(const char* path)
+			: m_file(nullptr), m_buffer(FILE_BUFFER_SIZE), m_position(0), m_size(0) {
+		if (fopen_s(&m_file, path, "rb") != 0)
+			m_file = nullptr;
+	}
+	~FileReader() {
+		if (m_file)
+			fclose(m_file);
+	}
+
+	bool IsOpen() const { return m_file != nullptr; }
+
+	// -1 at the end of the file.
+	int ReadByte() {
+		if (m_position == m_size && !Fill())
+			return -1;
+		return m_buffer[m_position++];
+	}
+
+	bool Read(void* data, size_t size) {
+		uint8_t* out = static_cast<uint8_t*>(data);
+		while (size) {
+			if (m_position == m_size && !Fill())
+				return false;
+			size_t chunk = std::min(size, m_size - m_position);
+			memcpy(out, &m_buffer[m_position], chunk);
+			m_position += chunk;
+			out += chunk;
+			size -= chunk;
+		}
+		return true;
+	}
+
+	bool Skip(size_t size) {
+		while (size) {
+			if (m_position == m_size && !Fill())
+				return false;
+			size_t chunk = std::min(size, m_size - m_position);
+			m_position += chunk;
+			size -= chunk;
+		}
+		return true;
+	}
+
+	// Reads up to and drops a '\n', or a NUL when terminator is 0.
+	bool ReadString(std::string& text, char terminator, size_t maxLength) {
+		text.clear();
+		for (;;) {
+			int c = ReadByte();
+			if (c < 0)
+				return false;
+			if (c == terminator)
+				return true;
+			if (text.size() == maxLength)
+				return false;
+			text += (char)c;
+		}
+	}
+
+	template <typename T>
+	bool ReadValue(T& value) { return Read(&value, sizeof(value)); }
+
+private:
+	FileReader(const FileReader&);
+	FileReader& operator=(const FileReader&);
+
+	bool Fill() {
+		if (!m_file)
+			return false;
+		m_size = fread(&m_buffer[0], 1, m_buffer.size(), m_file);
+		m_position = 0;
+		return m_size != 0;
+	}
+
+	FILE* m_file;
+	std::vector<uint8_t> m_buffer;
+	size_t m_position;
+	size_t m_size;
+};
+
+class FileWriter {
+public:
+	explicit FileWriter(const char* path) : m_file(nullptr), m_failed(false), m_written(0) {
+		if (fopen_s(&m_file, path, "wb") != 0)
+			m_file = nullptr;
+		m_failed = m_file == nullptr;
+		m_buffer.reserve(FILE_BUFFER_SIZE);
+	}
+	~FileWriter() { Close(); }
+
+	bool IsOpen() const { return m_file != nullptr; }
+	uint64_t GetWritten() const { return m_written; }
+
+	void Write(const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_written += size;
+		if (m_buffer.size() + size > FILE_BUFFER_SIZE)
+			Flush();
+		if (size >= FILE_BUFFER_SIZE) {
+			if (m_file && fwrite(bytes, 1, size, m_file) != size)
+				m_failed = true;
+			return;
+		}
+		m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	}
+
+	void WriteByte(uint8_t value) { Write(&value, 1); }
+	void WriteString(const char* text) { Write(text, strlen(text)); }
+
+	template <typename T>
+	void WriteValue(const T& value) { Write(&value, sizeof(value)); }
+
+	// Returns false if anything failed to reach the disk.
+	bool Close() {
+		if (m_file) {
+			Flush();
+			if (fclose(m_file) != 0)
+				m_failed = true;
+			m_file = nullptr;
+		}
+		return !m_failed;
+	}
+
+private:
+	FileWriter(const FileWriter&);
+	FileWriter& operator=(const FileWriter&);
+
+	void Flush() {
+		if (m_file && !m_buffer.empty() &&
+				fwrite(&m_buffer[0], 1, m_buffer.size(), m_file) != m_buffer.size())
+			m_failed = true;
+		m_buffer.clear();
+	}
+
+	FILE* m_file;
+	bool m_failed;
+	uint64_t m_written;
+	std::vector<uint8_t> m_buffer;
+};
+
+// Radiance
+
+const uint32_t RLE_MIN_WIDTH = 8;
+const uint32_t RLE_MAX_WIDTH = 0x7fff;
+const uint32_t RLE_MIN_RUN = 4;
+
+void DecodeRgbe(const uint8_t* rgbe, uint32_t count, XMFLOAT4* row) {
+	for (uint32_t i = 0; i < count; ++i, rgbe += 4) {
+		if (rgbe[3] == 0) {
+			row[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			continue;
+		}
+		float scale = ldexpf(1.0f, (int)rgbe[3] - (128 + 8));
+		row[i] = XMFLOAT4((rgbe[0] + 0.5f) * scale, (rgbe[1] + 0.5f) * scale,
+				(rgbe[2] + 0.5f) * scale, 1.0f);
+	}
+}
+
+void EncodeRgbe(const XMFLOAT4* row, uint32_t count, uint8_t* rgbe) {
+	for (uint32_t i = 0; i < count; ++i, rgbe += 4) {
+		float r = std::max(row[i].x, 0.0f);
+		float g = std::max(row[i].y, 0.0f);
+		float b = std::max(row[i].z, 0.0f);
+		float largest = std::max(r, std::max(g, b));
+		if (largest < 1e-32f) {
+			rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+			continue;
+		}
+		int exponent;
+		float scale = frexpf(largest, &exponent) * 256.0f / largest;
+		rgbe[0] = (uint8_t)(r * scale);
+		rgbe[1] = (uint8_t)(g * scale);
+		rgbe[2] = (uint8_t)(b * scale);
+		rgbe[3] = (uint8_t)(exponent + 128);
+	}
+}
+
+// Decodes one scanline into width RGBE quadruplets.
+bool ReadRadianceScanline(FileReader& reader, uint32_t width, uint8_t* rgbe) {
+	uint8_t first[4];
+	if (!reader.Read(first, 4))
+		return false;
+	bool encoded = width >= RLE_MIN_WIDTH && width <= RLE_MAX_WIDTH && first[0] == 2 &&
+			first[1] == 2 && (first[2] & 0x80) == 0;
+	if (encoded) {
+		if (((uint32_t)first[2] << 8 | first[3]) != width)
+			return false;
+		// Each channel is run-length encoded separately.
+		for (uint32_t channel = 0; channel < 4; ++channel) {
+			uint32_t x = 0;
+			while (x < width) {
+				int count = reader.ReadByte();
+				if (count <= 0)
+					return false;
+				if (count > 128) {
+					count -= 128;
+					int value = reader.ReadByte();
+					if (value < 0 || x + count > width)
+						return false;
+					for (int i = 0; i < count; ++i)
+						rgbe[(x++) * 4 + channel] = (uint8_t)value;
+				} else {
+					if (x + count > width)
+						return false;
+					for (int i = 0; i < count; ++i) {
+						int value = reader.ReadByte();
+						if (value < 0)
+							return false;
+						rgbe[(x++) * 4 + channel] = (uint8_t)value;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Flat pixels, where (1, 1, 1, n) repeats the previous pixel and
+	// consecutive repeats count in ever higher bytes.
+	uint32_t x = 0;
+	uint32_t shift = 0;
+	uint8_t pixel[4] = { first[0], first[1], first[2], first[3] };
+	for (;;) {
+		if (pixel[0] == 1 && pixel[1] == 1 && pixel[2] == 1) {
+			if (x == 0 || shift > 24)
+				return false;
+			uint32_t repeat = (uint32_t)pixel[3] << shift;
+			if (repeat > width - x)
+				return false;
+			for (uint32_t i = 0; i < repeat; ++i, ++x)
+				memcpy(&rgbe[x * 4], &rgbe[(x - 1) * 4], 4);
+			shift += 8;
+		} else {
+			memcpy(&rgbe[(x++) * 4], pixel, 4);
+			shift = 0;
+		}
+		if (x == width)
+			return true;
+		if (!reader.Read(pixel, 4))
+			return false;
+	}
+}
+
+// Length of the run of equal bytes at x, stopping at limit.
+uint32_t RunLength(const uint8_t* channel, uint32_t x, uint32_t width, uint32_t limit) {
+	uint32_t length = 1;
+	while (length < limit && x + length < width &&
+			channel[(x + length) * 4] == channel[x * 4])
+		++length;
+	return length;
+}
+
+void WriteRadianceScanline(FileWriter& writer, uint32_t width, const uint8_t* rgbe) {
+	if (width < RLE_MIN_WIDTH || width > RLE_MAX_WIDTH) {
+		writer.Write(rgbe, (size_t)width * 4);
+		return;
+	}
+	uint8_t marker[4] = { 2, 2, (uint8_t)(width >> 8), (uint8_t)(width & 0xff) };
+	writer.Write(marker, 4);
+	for (uint32_t c = 0; c < 4; ++c) {
+		const uint8_t* channel = rgbe + c;
+		uint32_t x = 0;
+		while (x < width) {
+			uint32_t run = RunLength(channel, x, width, 127);
+			if (run >= RLE_MIN_RUN) {
+				writer.WriteByte((uint8_t)(128 + run));
+				writer.WriteByte(channel[x * 4]);
+				x += run;
+				continue;
+			}
+			// Literals up to the next run worth encoding.
+			uint32_t start = x;
+			while (x < width && x - start < 128 &&
+					RunLength(channel, x, width, RLE_MIN_RUN) < RLE_MIN_RUN)
+				++x;
+			writer.WriteByte((uint8_t)(x - start));
+			for (uint32_t i = start; i < x; ++i)
+				writer.WriteByte(channel[i * 4]);
+		}
+	}
+}
+
+// OpenEXR
+
+const uint8_t EXR_MAGIC[4] = { 0x76, 0x2f, 0x31, 0x01 };
+const uint32_t EXR_VERSION = 2;
+const uint32_t EXR_TILED = 0x200;
+const uint32_t EXR_NON_IMAGE = 0x800;
+const uint32_t EXR_MULTIPART = 0x1000;
+const size_t EXR_MAX_NAME = 255;
+
+enum ExrPixelType {
+	EXR_UINT = 0,
+	EXR_HALF = 1,
+	EXR_FLOAT = 2
+};
+
+enum ExrCompression {
+	EXR_NO_COMPRESSION = 0,
+	EXR_RLE_COMPRESSION = 1
+};
+
+struct ExrChannel {
+	std::string Name;
+	int32_t PixelType;
+	// Byte offset of the channel within a decoded scanline.
+	uint32_t Offset;
+};
+
+uint32_t GetExrPixelSize(int32_t pixelType) {
+	return pixelType == EXR_HALF ? 2 : 4;
+}
+
+bool ReadExrChannels(FileReader& reader, uint32_t size, std::vector<ExrChannel>& channels) {
+	std::string name;
+	uint32_t used = 0;
+	for (;;) {
+		if (!reader.ReadString(name, 0, EXR_MAX_NAME))
+			return false;
+		used += (uint32_t)name.size() + 1;
+		if (name.empty())
+			return used == size;
+		ExrChannel channel;
+		channel.Name = name;
+		channel.Offset = 0;
+		uint8_t linear[4];
+		int32_t xSampling, ySampling;
+		if (!reader.ReadValue(channel.PixelType) || !reader.Read(linear, 4) ||
+				!reader.ReadValue(xSampling) || !reader.ReadValue(ySampling))
+			return false;
+		used += 16;
+		if (used > size || channel.PixelType < EXR_UINT || channel.PixelType > EXR_FLOAT)
+			return false;
+		// Subsampled channels would need reconstruction.
+		if (xSampling != 1 || ySampling != 1)
+			return false;
+		channels.push_back(channel);
+	}
+}
+
+const ExrChannel* FindExrChannel(const std::vector<ExrChannel>& channels, const char* name) {
+	for (size_t i = 0; i < channels.size(); ++i) {
+		if (channels[i].Name == name)
+			return channels[i].PixelType == EXR_UINT ? nullptr : &channels[i];
+	}
+	return nullptr;
+}
+
+// Undoes RLE, then the predictor and the byte split shared with ZIP.
+bool DecompressExrRle(const uint8_t* source, size_t sourceSize, uint8_t* temp, uint8_t* target,
+		size_t targetSize) {
+	size_t written = 0;
+	while (sourceSize) {
+		int count = (int8_t)source[0];
+		if (count < 0) {
+			size_t length = (size_t)-count;
+			if (sourceSize < length + 1 || written + length > targetSize)
+				return false;
+			memcpy(temp + written, source + 1, length);
+			written += length;
+			source += length + 1;
+			sourceSize -= length + 1;
+		} else {
+			size_t length = (size_t)count + 1;
+			if (sourceSize < 2 || written + length > targetSize)
+				return false;
+			memset(temp + written, source[1], length);
+			written += length;
+			source += 2;
+			sourceSize -= 2;
+		}
+	}
+	if (written != targetSize)
+		return false;
+	for (size_t i = 1; i < targetSize; ++i)
+		temp[i] = (uint8_t)(temp[i - 1] + temp[i] - 128);
+	const uint8_t* first = temp;
+	const uint8_t* second = temp + (targetSize + 1) / 2;
+	for (size_t i = 0; i < targetSize; ++i)
+		target[i] = i & 1 ? *second++ : *first++;
+	return true;
+}
+
+void DecodeExrChannel(const uint8_t* line, const ExrChannel& channel, uint32_t width,
+		XMFLOAT4* row, uint32_t component) {
+	const uint8_t* data = line + channel.Offset;
+	for (uint32_t x = 0; x < width; ++x) {
+		float value;
+		if (channel.PixelType == EXR_HALF) {
+			HALF half;
+			memcpy(&half, data + x * 2, 2);
+			value = XMConvertHalfToFloat(half);
+		} else {
+			memcpy(&value, data + x * 4, 4);
+		}
+		(&row[x].x)[component] = value;
+	}
+}
+
+void WriteExrAttribute(FileWriter& writer, const char* name, const char* type, uint32_t size,
+		const void* data) {
+	writer.Write(name, strlen(name) + 1);
+	writer.Write(type, strlen(type) + 1);
+	writer.WriteValue(size);
+	writer.Write(data, size);
+}
+
+} // namespace
+
+bool LoadRadianceHdr(const char* path, Format format, HdrImage& image) {
+	FileReader reader(path);
+	if (!reader.IsOpen() || !IsPackedHdrFormat(format))
+		return false;
+
+	std::string line;
+	if (!reader.ReadString(line, '\n', 1024) || line.compare(0, 2, "#?") != 0)
+		return false;
+	for (;;) {
+		if (!reader.ReadString(line, '\n', 1024))
+			return false;
+		if (line.empty())
+			break;
+		// XYZE files hold CIE XYZ rather than RGB.
+		if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+			return false;
+	}
+	int width = 0;
+	int height = 0;
+	char check;
+	if (!reader.ReadString(line, '\n', 1024) ||
+			sscanf_s(line.c_str(), "-Y %d +X %d %c", &height, &width, &check, 1) != 2 ||
+			width <= 0 || height <= 0 || !image.Initialize(width, height, format))
+		return false;
+
+	std::vector<uint8_t> rgbe((size_t)width * 4);
+	std::vector<XMFLOAT4> row(width);
+	for (int y = 0; y < height; ++y) {
+		if (!ReadRadianceScanline(reader, width, &rgbe[0]))
+			return false;
+		DecodeRgbe(&rgbe[0], width, &row[0]);
+		PackHdrPixels(format, &row[0], width, image.GetRow(y));
+	}
+	return true;
+}
+
+bool SaveRadianceHdr(const char* path, const HdrImage& image) {
+	const uint32_t width = image.GetWidth();
+	const uint32_t height = image.GetHeight();
+	if (width == 0)
+		return false;
+	FileWriter writer(path);
+	if (!writer.IsOpen())
+		return false;
+
+	char resolution[64];
+	sprintf_s(resolution, sizeof(resolution), "-Y %u +X %u\n", height, width);
+	writer.WriteString("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n");
+	writer.WriteString(resolution);
+
+	std::vector<uint8_t> rgbe((size_t)width * 4);
+	std::vector<XMFLOAT4> row(width);
+	for (uint32_t y = 0; y < height; ++y) {
+		UnpackHdrPixels(image.GetFormat(), image.GetRow(y), width, &row[0]);
+		EncodeRgbe(&row[0], width, &rgbe[0]);
+		WriteRadianceScanline(writer, width, &rgbe[0]);
+	}
+	return writer.Close();
+}
+
+bool LoadOpenExr(const char* path, Format format, HdrImage& image) {
+	FileReader reader(path);
+	if (!reader.IsOpen() || !IsPackedHdrFormat(format))
+		return false;
+
+	uint8_t magic[4];
+	uint32_t version;
+	if (!reader.Read(magic, 4) || memcmp(magic, EXR_MAGIC, 4) != 0 || !reader.ReadValue(version))
+		return false;
+	if ((version & 0xff) != EXR_VERSION || (version & (EXR_TILED | EXR_NON_IMAGE | EXR_MULTIPART)))
+		return false;
+
+	std::vector<ExrChannel> channels;
+	int32_t window[4] = { 0, 0, -1, -1 };
+	uint8_t compression = EXR_NO_COMPRESSION;
+	std::string name, type;
+	for (;;) {
+		if (!reader.ReadString(name, 0, EXR_MAX_NAME))
+			return false;
+		if (name.empty())
+			break;
+		uint32_t size;
+		if (!reader.ReadString(type, 0, EXR_MAX_NAME) || !reader.ReadValue(size))
+			return false;
+		bool read;
+		if (name == "channels" && type == "chlist")
+			read = ReadExrChannels(reader, size, channels);
+		else if (name == "compression" && size == 1)
+			read = reader.ReadValue(compression);
+		else if (name == "dataWindow" && size == sizeof(window))
+			read = reader.Read(window, sizeof(window));
+		else
+			read = reader.Skip(size);
+		if (!read)
+			return false;
+	}
+	if (compression != EXR_NO_COMPRESSION && compression != EXR_RLE_COMPRESSION)
+		return false;
+
+	int64_t width = (int64_t)window[2] - window[0] + 1;
+	int64_t height = (int64_t)window[3] - window[1] + 1;
+	if (width <= 0 || height <= 0 || width > 0x10000 || height > 0x10000 ||
+			!image.Initialize((uint32_t)width, (uint32_t)height, format))
+		return false;
+
+	uint32_t lineSize = 0;
+	for (size_t i = 0; i < channels.size(); ++i) {
+		channels[i].Offset = lineSize;
+		lineSize += (uint32_t)width * GetExrPixelSize(channels[i].PixelType);
+	}
+	// Greyscale images only have luminance.
+	const ExrChannel* rgb[3] = { FindExrChannel(channels, "R"), FindExrChannel(channels, "G"),
+			FindExrChannel(channels, "B") };
+	const ExrChannel* luminance = FindExrChannel(channels, "Y");
+	for (uint32_t c = 0; c < 3; ++c) {
+		if (!rgb[c])
+			rgb[c] = luminance;
+		if (!rgb[c])
+			return false;
+	}
+
+	// One scanline per chunk for both compressions. Chunks are read in
+	// file order and placed by the y they carry, so the offset table is
+	// not needed.
+	if (!reader.Skip((size_t)height * sizeof(uint64_t)))
+		return false;
+	std::vector<uint8_t> chunk(lineSize);
+	std::vector<uint8_t> temp(lineSize);
+	std::vector<uint8_t> line(lineSize);
+	std::vector<XMFLOAT4> row((size_t)width, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	for (int64_t i = 0; i < height; ++i) {
+		int32_t y;
+		uint32_t size;
+		if (!reader.ReadValue(y) || !reader.ReadValue(size))
+			return false;
+		if (y < window[1] || y > window[3] || size == 0 || size > lineSize ||
+				!reader.Read(&chunk[0], size))
+			return false;
+		// Chunks that would not shrink are stored as they are.
+		if (size == lineSize)
+			line.swap(chunk);
+		else if (compression != EXR_RLE_COMPRESSION ||
+				!DecompressExrRle(&chunk[0], size, &temp[0], &line[0], lineSize))
+			return false;
+		for (uint32_t c = 0; c < 3; ++c)
+			DecodeExrChannel(&line[0], *rgb[c], (uint32_t)width, &row[0], c);
+		PackHdrPixels(format, &row[0], (uint32_t)width, image.GetRow(y - window[1]));
+	}
+	return true;
+}
+
+bool SaveOpenExr(const char* path, const HdrImage& image) {
+	const uint32_t width = image.GetWidth();
+	const uint32_t height = image.GetHeight();
+	if (width == 0)
+		return false;
+	FileWriter writer(path);
+	if (!writer.IsOpen())
+		return false;
+
+	writer.Write(EXR_MAGIC, 4);
+	writer.WriteValue(EXR_VERSION);
+
+	// Channels are listed, and stored, in alphabetical order.
+	const char* names[3] = { "B", "G", "R" };
+	std::vector<uint8_t> list;
+	for (uint32_t c = 0; c < 3; ++c) {
+		int32_t fields[4] = { EXR_HALF, 0, 1, 1 };
+		list.push_back((uint8_t)names[c][0]);
+		list.push_back(0);
+		list.insert(list.end(), (const uint8_t*)fields, (const uint8_t*)(fields + 4));
+	}
+	list.push_back(0);
+	WriteExrAttribute(writer, "channels", "chlist", (uint32_t)list.size(), &list[0]);
+	uint8_t compression = EXR_NO_COMPRESSION;
+	WriteExrAttribute(writer, "compression", "compression", 1, &compression);
+	int32_t window[4] = { 0, 0, (int32_t)width - 1, (int32_t)height - 1 };
+	WriteExrAttribute(writer, "dataWindow", "box2i", sizeof(window), window);
+	WriteExrAttribute(writer, "displayWindow", "box2i", sizeof(window), window);
+	uint8_t lineOrder = 0;
+	WriteExrAttribute(writer, "lineOrder", "lineOrder", 1, &lineOrder);
+	float aspect = 1.0f;
+	WriteExrAttribute(writer, "pixelAspectRatio", "float", sizeof(aspect), &aspect);
+	float center[2] = { 0.0f, 0.0f };
+	WriteExrAttribute(writer, "screenWindowCenter", "v2f", sizeof(center), center);
+	float windowWidth = 1.0f;
+	WriteExrAttribute(writer, "screenWindowWidth", "float", sizeof(windowWidth), &windowWidth);
+	writer.WriteByte(0);
+
+	const uint32_t lineSize = width * 3 * sizeof(HALF);
+	const uint64_t first = writer.GetWritten() + (uint64_t)height * sizeof(uint64_t);
+	for (uint32_t y = 0; y < height; ++y)
+		writer.WriteValue(first + (uint64_t)y * (lineSize + 2 * sizeof(uint32_t)));
+
+	std::vector<XMFLOAT4> row(width);
+	std::vector<HALF> line((size_t)width * 3);
+	for (uint32_t y = 0; y < height; ++y) {
+		UnpackHdrPixels(image.GetFormat(), image.GetRow(y), width, &row[0]);
+		XMConvertFloatToHalfStream(&line[0], sizeof(HALF), &row[0].z, sizeof(XMFLOAT4), width);
+		XMConvertFloatToHalfStream(&line[width], sizeof(HALF), &row[0].y, sizeof(XMFLOAT4), width);
+		XMConvertFloatToHalfStream(&line[2 * width], sizeof(HALF), &row[0].x, sizeof(XMFLOAT4),
+				width);
+		writer.WriteValue((int32_t)y);
+		writer.WriteValue(lineSize);
+		writer.Write(&line[0], lineSize);
+	}
+	return writer.Close();
+}
+
+} // namespace Zeus
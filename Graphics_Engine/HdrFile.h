@@ -0,0 +1,38 @@
+/*
+ * HdrFile.h
+ *
+ * Radiance RGBE (.hdr) and OpenEXR (.exr) files for HdrImage.
+ *
+ * Files are decoded and encoded one scanline at a time through a small
+ * buffer, so the only full-size allocation is the packed image itself.
+ *
+ * Radiance: flat and run-length encoded scanlines are read, with the
+ * usual -Y height +X width orientation. Files are written run-length
+ * encoded.
+ *
+ * OpenEXR: single part scanline files with no or RLE compression and
+ * half or float R, G and B channels are read; other channels are
+ * skipped. ZIP, PIZ and the lossy compressions need libraries the engine
+ * does not ship and are rejected. Files are written as uncompressed half
+ * float B, G, R.
+ */
+
+#ifndef HDRFILE_H_
+#define HDRFILE_H_
+
+#include "Format.h"
+
+namespace Zeus {
+
+class HdrImage;
+
+// format is the packed HDR format to decode into.
+bool LoadRadianceHdr(const char* path, Format format, HdrImage& image);
+bool SaveRadianceHdr(const char* path, const HdrImage& image);
+
+bool LoadOpenExr(const char* path, Format format, HdrImage& image);
+bool SaveOpenExr(const char* path, const HdrImage& image);
+
+} // namespace Zeus
+
+#endif /* HDRFILE_H_ */
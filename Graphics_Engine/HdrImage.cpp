@@ -0,0 +1,202 @@
+/*
+ * HdrImage.cpp
+ *
+ */
+
+#include "HdrImage.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Largest shared exponent value: 511/512 * 2^16.
+const float SHARED_EXPONENT_MAX = 65408.0f;
+const uint32_t HISTOGRAM_ROWS_PER_JOB = 16;
+
+const XMVECTORF32 LUMA_WEIGHTS = { 0.2126f, 0.7152f, 0.0722f, 0.0f };
+
+// 2^exponent for exponents in the normal float range.
+inline float Exp2(int32_t exponent) {
+	uint32_t bits = (uint32_t)(exponent + 127) << 23;
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t PackSharedExponent(const XMFLOAT4& color) {
+	// Negative values and NaNs go to zero.
+	float r = std::min(color.x > 0.0f ? color.x : 0.0f, SHARED_EXPONENT_MAX);
+	float g = std::min(color.y > 0.0f ? color.y : 0.0f, SHARED_EXPONENT_MAX);
+	float b = std::min(color.z > 0.0f ? color.z : 0.0f, SHARED_EXPONENT_MAX);
+	float largest = std::max(r, std::max(g, b));
+
+	// floor(log2(largest)) from the float exponent, limited to -16.
+	uint32_t bits;
+	memcpy(&bits, &largest, sizeof(bits));
+	int32_t exponent = std::max(-16, (int32_t)((bits >> 23) & 0xff) - 127) + 16;
+	float scale = Exp2(24 - exponent);
+	if ((uint32_t)(largest * scale + 0.5f) == 512) {
+		scale *= 0.5f;
+		++exponent;
+	}
+
+	XMFLOAT3SE packed;
+	packed.xm = (uint32_t)(r * scale + 0.5f);
+	packed.ym = (uint32_t)(g * scale + 0.5f);
+	packed.zm = (uint32_t)(b * scale + 0.5f);
+	packed.e = exponent;
+	return packed.v;
+}
+
+XMVECTOR UnpackSharedExponent(uint32_t value) {
+	XMFLOAT3SE packed(value);
+	XMVECTOR mantissas = XMVectorSet((float)packed.xm, (float)packed.ym, (float)packed.zm, 0.0f);
+	return XMVectorSetW(XMVectorScale(mantissas, Exp2((int32_t)packed.e - 24)), 1.0f);
+}
+
+inline XMVECTOR UnpackPixel(Format format, uint32_t value) {
+	if (format == FORMAT_R9G9B9E5_SHAREDEXP)
+		return UnpackSharedExponent(value);
+	XMFLOAT3PK packed(value);
+	return XMVectorSetW(XMLoadFloat3PK(&packed), 1.0f);
+}
+
+} // namespace
+
+bool IsPackedHdrFormat(Format format) {
+	return format == FORMAT_R9G9B9E5_SHAREDEXP || format == FORMAT_R11G11B10_FLOAT;
+}
+
+void PackHdrPixels(Format format, const XMFLOAT4* source, uint32_t count, uint32_t* target) {
+	if (format == FORMAT_R9G9B9E5_SHAREDEXP) {
+		for (uint32_t i = 0; i < count; ++i)
+			target[i] = PackSharedExponent(source[i]);
+	} else {
+		for (uint32_t i = 0; i < count; ++i) {
+			XMFLOAT3PK packed;
+			XMStoreFloat3PK(&packed, XMLoadFloat4(&source[i]));
+			target[i] = packed.v;
+		}
+	}
+}
+
+void UnpackHdrPixels(Format format, const uint32_t* source, uint32_t count, XMFLOAT4* target) {
+	for (uint32_t i = 0; i < count; ++i)
+		XMStoreFloat4(&target[i], UnpackPixel(format, source[i]));
+}
+
+HdrImage::HdrImage() : m_width(0), m_height(0), m_format(FORMAT_UNKNOWN) {
+}
+
+bool HdrImage::Initialize(uint32_t width, uint32_t height, Format format) {
+	if (width == 0 || height == 0 || !IsPackedHdrFormat(format))
+		return false;
+	if (width == m_width && height == m_height && format == m_format)
+		return true;
+	m_width = width;
+	m_height = height;
+	m_format = format;
+	m_pixels.assign((size_t)width * height, 0);
+	return true;
+}
+
+bool HdrImage::Pack(const ColorBuffer& source, JobSystem* jobs) {
+	if (m_width == 0 || source.GetWidth() != m_width || source.GetHeight() != m_height)
+		return false;
+	ParallelFor(jobs, m_height, 16, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y)
+			PackHdrPixels(m_format, source.GetRow(y), m_width, GetRow(y));
+	});
+	return true;
+}
+
+bool HdrImage::Unpack(ColorBuffer& target, JobSystem* jobs) const {
+	if (m_width == 0 || !target.Initialize(m_width, m_height))
+		return false;
+	ParallelFor(jobs, m_height, 16, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y)
+			UnpackHdrPixels(m_format, GetRow(y), m_width, target.GetRow(y));
+	});
+	return true;
+}
+
+bool ComputeExposureHistogram(const HdrImage& image, float minLog2, float maxLog2,
+		JobSystem* jobs, ExposureHistogram& histogram) {
+	if (image.GetWidth() == 0 || maxLog2 <= minLog2)
+		return false;
+	const uint32_t width = image.GetWidth();
+	const uint32_t height = image.GetHeight();
+	const Format format = image.GetFormat();
+	const float scale = EXPOSURE_HISTOGRAM_BINS / (maxLog2 - minLog2);
+	const float smallest = powf(2.0f, minLog2);
+
+	// Every band of rows counts into its own histogram; adding them up in
+	// order afterwards keeps the result independent of scheduling.
+	const uint32_t bands = (height + HISTOGRAM_ROWS_PER_JOB - 1) / HISTOGRAM_ROWS_PER_JOB;
+	std::vector<uint32_t> partial((size_t)bands * EXPOSURE_HISTOGRAM_BINS, 0);
+	ParallelFor(jobs, bands, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t band = begin; band < end; ++band) {
+			uint32_t* bins = &partial[(size_t)band * EXPOSURE_HISTOGRAM_BINS];
+			uint32_t last = std::min(height, (band + 1) * HISTOGRAM_ROWS_PER_JOB);
+			for (uint32_t y = band * HISTOGRAM_ROWS_PER_JOB; y < last; ++y) {
+				const uint32_t* row = image.GetRow(y);
+				for (uint32_t x = 0; x < width; ++x) {
+					float luma = XMVectorGetX(XMVector3Dot(UnpackPixel(format, row[x]),
+							LUMA_WEIGHTS));
+					uint32_t bin = 0;
+					if (luma > smallest) {
+						float position = (log2f(luma) - minLog2) * scale;
+						bin = std::min((uint32_t)position, EXPOSURE_HISTOGRAM_BINS - 1);
+					}
+					++bins[bin];
+				}
+			}
+		}
+	});
+
+	histogram.MinLog2 = minLog2;
+	histogram.MaxLog2 = maxLog2;
+	histogram.PixelCount = width * height;
+	memset(histogram.Bins, 0, sizeof(histogram.Bins));
+	for (uint32_t band = 0; band < bands; ++band) {
+		const uint32_t* bins = &partial[(size_t)band * EXPOSURE_HISTOGRAM_BINS];
+		for (uint32_t i = 0; i < EXPOSURE_HISTOGRAM_BINS; ++i)
+			histogram.Bins[i] += bins[i];
+	}
+	return true;
+}
+
+float ComputeAutoExposure(const ExposureHistogram& histogram, float lowPercent, float highPercent,
+		float key) {
+	if (histogram.PixelCount == 0 || key <= 0.0f)
+		return 0.0f;
+	// Pixels are ranked by brightness and only the ones between the two
+	// cut-offs contribute to the average.
+	float low = histogram.PixelCount * std::max(0.0f, std::min(lowPercent, 100.0f)) * 0.01f;
+	float high = histogram.PixelCount *
+			(1.0f - std::max(0.0f, std::min(highPercent, 100.0f)) * 0.01f);
+	const float binWidth = (histogram.MaxLog2 - histogram.MinLog2) / EXPOSURE_HISTOGRAM_BINS;
+
+	double sum = 0.0;
+	double weight = 0.0;
+	float below = 0.0f;
+	for (uint32_t i = 0; i < EXPOSURE_HISTOGRAM_BINS; ++i) {
+		float count = (float)histogram.Bins[i];
+		float kept = std::min(below + count, high) - std::max(below, low);
+		below += count;
+		if (kept <= 0.0f)
+			continue;
+		sum += kept * (histogram.MinLog2 + (i + 0.5f) * binWidth);
+		weight += kept;
+	}
+	if (weight <= 0.0)
+		return 0.0f;
+	return log2f(key) - (float)(sum / weight);
+}
+
+} // namespace Zeus
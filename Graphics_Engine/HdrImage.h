@@ -0,0 +1,88 @@
+/*
+ * HdrImage.h
+ *
+ * HDR images stored in 32 bits per pixel, half the size of the RGB half
+ * float formats and a quarter of ColorBuffer:
+ *
+ * - FORMAT_R9G9B9E5_SHAREDEXP: 9 bit mantissas with a shared 5 bit
+ *   exponent, held in XMFLOAT3SE.
+ * - FORMAT_R11G11B10_FLOAT: small unsigned floats, held in XMFLOAT3PK.
+ *
+ * Both are positive only and have no alpha. The xnamath shared exponent
+ * load and store treat the mantissas as having an implicit leading one,
+ * which does not match DXGI and loses the smaller channels, so the shared
+ * exponent conversion is done here following the D3D11 specification.
+ *
+ * Exposure histograms are built straight from the packed pixels.
+ */
+
+#ifndef HDRIMAGE_H_
+#define HDRIMAGE_H_
+
+#include "Format.h"
+#include "SoftwareRasterizer.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+bool IsPackedHdrFormat(Format format);
+// Converts count pixels between float RGBA and a packed HDR format. Alpha
+// is dropped when packing and set to one when unpacking.
+void PackHdrPixels(Format format, const XMFLOAT4* source, uint32_t count, uint32_t* target);
+void UnpackHdrPixels(Format format, const uint32_t* source, uint32_t count, XMFLOAT4* target);
+
+class HdrImage {
+public:
+	HdrImage();
+
+	// Keeps the contents when nothing changes.
+	bool Initialize(uint32_t width, uint32_t height, Format format);
+
+	// source must match the image size.
+	bool Pack(const ColorBuffer& source, JobSystem* jobs);
+	// Resizes target to the image size.
+	bool Unpack(ColorBuffer& target, JobSystem* jobs) const;
+
+	Format GetFormat() const { return m_format; }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t* GetRow(uint32_t y) { return &m_pixels[(size_t)y * m_width]; }
+	const uint32_t* GetRow(uint32_t y) const { return &m_pixels[(size_t)y * m_width]; }
+
+private:
+	std::vector<uint32_t> m_pixels;
+	uint32_t m_width;
+	uint32_t m_height;
+	Format m_format;
+};
+
+const uint32_t EXPOSURE_HISTOGRAM_BINS = 128;
+
+// Pixel counts over log2 luminance. Pixels darker than MinLog2, black
+// included, go in the first bin and brighter than MaxLog2 in the last.
+struct ExposureHistogram {
+	float MinLog2;
+	float MaxLog2;
+	uint32_t PixelCount;
+	uint32_t Bins[EXPOSURE_HISTOGRAM_BINS];
+};
+
+bool ComputeExposureHistogram(const HdrImage& image, float minLog2, float maxLog2,
+		JobSystem* jobs, ExposureHistogram& histogram);
+
+// Exposure in stops, as taken by TonemapStage, that brings the average
+// log2 luminance to key. The darkest lowPercent and brightest highPercent
+// of the pixels (0 to 100) are left out of the average.
+float ComputeAutoExposure(const ExposureHistogram& histogram, float lowPercent, float highPercent,
+		float key);
+
+} // namespace Zeus
+
+#endif /* HDRIMAGE_H_ */
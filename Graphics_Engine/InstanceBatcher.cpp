@@ -0,0 +1,163 @@
+/*
+ * InstanceBatcher.cpp
+ *
+ */
+
+#include "InstanceBatcher.h"
+#include "Hash.h"
+
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+bool SameRun(const InstanceSource& a, const InstanceSource& b) {
+	return a.Pass == b.Pass && a.Material == b.Material && a.State == b.State;
+}
+
+} // namespace
+
+InstanceBatcher::InstanceBatcher()
+		: m_instanceBuffer(NULL_RESOURCE), m_maxInstances(DEFAULT_MAX_INSTANCES),
+		m_preserveOrder(false) {
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void InstanceBatcher::SetMaxInstancesPerBatch(uint32_t maxInstances) {
+	m_maxInstances = maxInstances ? maxInstances : 1;
+}
+
+bool InstanceBatcher::Build(const SortItem* sorted, uint32_t count,
+		const InstanceSource* draws, RingAllocator& instanceRing) {
+	m_batches.clear();
+	m_order.clear();
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_instanceBuffer = instanceRing.GetBuffer();
+	m_stats.InputDraws = count;
+	if (count == 0)
+		return true;
+
+	uint32_t begin = 0;
+	while (begin < count) {
+		const InstanceSource& first = draws[sorted[begin].Value];
+		uint32_t end = begin + 1;
+		while (end < count && SameRun(first, draws[sorted[end].Value]))
+			++end;
+		BuildRun(sorted, begin, end, draws);
+		begin = end;
+	}
+
+	RingAllocation instances = instanceRing.AllocateVertices(count, sizeof(InstanceTransform));
+	if (!instances.IsValid()) {
+		m_batches.clear();
+		return false;
+	}
+	InstanceTransform* out = static_cast<InstanceTransform*>(instances.CpuAddress);
+	for (uint32_t i = 0; i < count; ++i)
+		out[i] = draws[m_order[i]].Transform;
+
+	uint32_t base = instances.Offset / sizeof(InstanceTransform);
+	for (size_t b = 0; b < m_batches.size(); ++b) {
+		InstanceBatch& batch = m_batches[b];
+		batch.StartInstance += base;
+		if (batch.InstanceCount > 1)
+			++m_stats.InstancedBatches;
+		if (batch.InstanceCount > m_stats.LargestBatch)
+			m_stats.LargestBatch = batch.InstanceCount;
+	}
+	m_stats.OutputDraws = (uint32_t)m_batches.size();
+	m_stats.InstanceBytes = count * sizeof(InstanceTransform);
+	return true;
+}
+
+// Splits the count entries of m_order starting at start into batches of at
+// most m_maxInstances.
+void InstanceBatcher::EmitBatch(const InstanceSource& first, uint32_t firstSortedDraw,
+		uint32_t start, uint32_t count) {
+	for (uint32_t offset = 0; offset < count; offset += m_maxInstances) {
+		InstanceBatch batch;
+		batch.Mesh = first.Mesh;
+		batch.Material = first.Material;
+		batch.Pass = first.Pass;
+		batch.State = first.State;
+		batch.FirstSortedDraw = firstSortedDraw;
+		batch.StartInstance = start + offset;
+		batch.InstanceCount = count - offset < m_maxInstances ? count - offset : m_maxInstances;
+		m_batches.push_back(batch);
+	}
+}
+
+void InstanceBatcher::BuildRun(const SortItem* sorted, uint32_t begin, uint32_t end,
+		const InstanceSource* draws) {
+	if (m_preserveOrder) {
+		uint32_t i = begin;
+		while (i < end) {
+			uint32_t mesh = draws[sorted[i].Value].Mesh;
+			uint32_t start = (uint32_t)m_order.size();
+			uint32_t j = i;
+			while (j < end && draws[sorted[j].Value].Mesh == mesh)
+				m_order.push_back(sorted[j++].Value);
+			EmitBatch(draws[sorted[i].Value], i, start, j - i);
+			i = j;
+		}
+		return;
+	}
+
+	// Number the distinct meshes of the run in order of first appearance,
+	// using an open-addressed table sized to the run so the whole pass
+	// stays linear.
+	uint32_t length = end - begin;
+	uint32_t tableSize = 16;
+	while (tableSize < length * 2)
+		tableSize <<= 1;
+	m_table.assign(tableSize, ~0u);
+	m_runMeshes.clear();
+	m_runFirst.clear();
+	m_runOffsets.clear();
+	m_drawBatch.resize(length);
+
+	for (uint32_t i = 0; i < length; ++i) {
+		uint32_t mesh = draws[sorted[begin + i].Value].Mesh;
+		uint32_t slot = (uint32_t)HashMix(mesh) & (tableSize - 1);
+		while (m_table[slot] != ~0u && m_runMeshes[m_table[slot]] != mesh)
+			slot = (slot + 1) & (tableSize - 1);
+		if (m_table[slot] == ~0u) {
+			m_table[slot] = (uint32_t)m_runMeshes.size();
+			m_runMeshes.push_back(mesh);
+			m_runFirst.push_back(begin + i);
+			m_runOffsets.push_back(0);
+		}
+		m_drawBatch[i] = m_table[slot];
+		++m_runOffsets[m_table[slot]];
+	}
+
+	// Counting sort by batch keeps each batch's draws in sorted order.
+	uint32_t batchCount = (uint32_t)m_runMeshes.size();
+	uint32_t offset = (uint32_t)m_order.size();
+	for (uint32_t b = 0; b < batchCount; ++b) {
+		uint32_t n = m_runOffsets[b];
+		m_runOffsets[b] = offset;
+		offset += n;
+	}
+	m_order.resize(offset);
+	for (uint32_t b = 0; b < batchCount; ++b) {
+		uint32_t start = m_runOffsets[b];
+		uint32_t next = b + 1 < batchCount ? m_runOffsets[b + 1] : offset;
+		EmitBatch(draws[sorted[m_runFirst[b]].Value], m_runFirst[b], start, next - start);
+	}
+	for (uint32_t i = 0; i < length; ++i)
+		m_order[m_runOffsets[m_drawBatch[i]]++] = sorted[begin + i].Value;
+}
+
+void InstanceBatcher::Record(CommandList& list, const InstanceBatch& batch,
+		const BatchMesh& mesh) const {
+	ResourceHandle buffers[2] = { mesh.VertexBuffer, m_instanceBuffer };
+	uint32_t strides[2] = { mesh.VertexStride, sizeof(InstanceTransform) };
+	list.SetVertexBuffers(0, 2, buffers, strides, nullptr);
+	list.SetIndexBuffer(mesh.IndexBuffer, mesh.IndexFormat, 0);
+	list.DrawIndexed(mesh.IndexCount, mesh.StartIndex, mesh.BaseVertex, batch.InstanceCount,
+			batch.StartInstance);
+}
+
+} // namespace Zeus
@@ -0,0 +1,125 @@
+/*
+ * InstanceBatcher.h
+ *
+ * Collapses sorted draws of the same mesh into instanced draws. Scenes
+ * built from repeated primitives (D3DXCreateBox, D3DXCreateSphere, shared
+ * ID3DXMesh objects) otherwise issue one draw call per object.
+ *
+ * The batcher walks the output of DrawQueue::Sort(). Draws are only merged
+ * inside a run that shares pass, material and pipeline state, so the order
+ * between runs is exactly the sorted order. Inside a run, batches appear in
+ * the order of their first draw and keep their instances in sorted order.
+ */
+
+#ifndef INSTANCEBATCHER_H_
+#define INSTANCEBATCHER_H_
+
+#include "CommandList.h"
+#include "RadixSort.h"
+#include "RingAllocator.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+// World matrix stored as three float4 rows of its transpose, the usual
+// per-instance vertex stream layout.
+struct InstanceTransform {
+	float Rows[3][4];
+};
+
+struct InstanceSource {
+	uint32_t Mesh;
+	uint32_t Material;
+	uint32_t Pass;
+	uint64_t State;
+	InstanceTransform Transform;
+};
+
+// Geometry of one mesh, indexed by InstanceSource::Mesh.
+struct BatchMesh {
+	ResourceHandle VertexBuffer;
+	uint32_t VertexStride;
+	ResourceHandle IndexBuffer;
+	Format IndexFormat;
+	uint32_t IndexCount;
+	uint32_t StartIndex;
+	int32_t BaseVertex;
+};
+
+struct InstanceBatch {
+	uint32_t Mesh;
+	uint32_t Material;
+	uint32_t Pass;
+	uint64_t State;
+	// Position of the batch's first draw in the sorted list.
+	uint32_t FirstSortedDraw;
+	// StartInstanceLocation into the instance buffer.
+	uint32_t StartInstance;
+	uint32_t InstanceCount;
+};
+
+struct InstancingStats {
+	uint32_t InputDraws;
+	uint32_t OutputDraws;
+	// Batches that actually merged more than one draw.
+	uint32_t InstancedBatches;
+	uint32_t LargestBatch;
+	uint32_t InstanceBytes;
+
+	float Reduction() const {
+		return InputDraws ? 1.0f - (float)OutputDraws / (float)InputDraws : 0.0f;
+	}
+};
+
+class InstanceBatcher {
+public:
+	enum { DEFAULT_MAX_INSTANCES = 1024 };
+
+	InstanceBatcher();
+
+	// Transparent passes should preserve order: only directly adjacent
+	// draws of the same mesh are merged then.
+	void SetPreserveOrder(bool preserveOrder) { m_preserveOrder = preserveOrder; }
+	void SetMaxInstancesPerBatch(uint32_t maxInstances);
+
+	// sorted[i].Value indexes draws. Transforms are written to one
+	// allocation from instanceRing. Returns false if the ring is full.
+	bool Build(const SortItem* sorted, uint32_t count, const InstanceSource* draws,
+			RingAllocator& instanceRing);
+
+	const InstanceBatch* GetBatches() const { return m_batches.empty() ? nullptr : &m_batches[0]; }
+	uint32_t GetBatchCount() const { return (uint32_t)m_batches.size(); }
+	ResourceHandle GetInstanceBuffer() const { return m_instanceBuffer; }
+	const InstancingStats& GetStats() const { return m_stats; }
+
+	// Binds the mesh in slot 0 and the instance stream in slot 1 and
+	// records the instanced draw. Material and state binding is left to
+	// the caller.
+	void Record(CommandList& list, const InstanceBatch& batch, const BatchMesh& mesh) const;
+
+private:
+	void BuildRun(const SortItem* sorted, uint32_t begin, uint32_t end,
+			const InstanceSource* draws);
+	void EmitBatch(const InstanceSource& first, uint32_t firstSortedDraw, uint32_t start,
+			uint32_t count);
+
+	std::vector<InstanceBatch> m_batches;
+	// Draw indices in batch order, parallel to the instance buffer.
+	std::vector<uint32_t> m_order;
+	// Scratch for BuildRun, kept to avoid reallocating every frame.
+	std::vector<uint32_t> m_table;
+	std::vector<uint32_t> m_runMeshes;
+	std::vector<uint32_t> m_runFirst;
+	std::vector<uint32_t> m_runOffsets;
+	std::vector<uint32_t> m_drawBatch;
+	ResourceHandle m_instanceBuffer;
+	InstancingStats m_stats;
+	uint32_t m_maxInstances;
+	bool m_preserveOrder;
+};
+
+} // namespace Zeus
+
+#endif /* INSTANCEBATCHER_H_ */
@@ -0,0 +1,157 @@
+/*
+ * JobSystem.cpp
+ *
+ */
+
+#include "JobSystem.h"
+
+#include <cassert>
+
+namespace Zeus {
+
+namespace {
+
+thread_local uint32_t t_threadIndex = 0;
+
+} // namespace
+
+JobSystem::JobSystem() : m_pending(0), m_quit(false) {
+}
+
+JobSystem::~JobSystem() {
+	Shutdown();
+}
+
+bool JobSystem::Initialize(uint32_t workerCount) {
+	Shutdown();
+	if (workerCount == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		workerCount = hardware > 1 ? hardware - 1 : 0;
+	}
+
+	m_quit.store(false);
+	m_queues.resize(workerCount + 1);
+	for (size_t i = 0; i < m_queues.size(); ++i)
+		m_queues[i] = new Queue;
+	for (uint32_t i = 0; i < workerCount; ++i)
+		m_workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i + 1));
+	return true;
+}
+
+void JobSystem::Shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_quit.store(true);
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		m_workers[i].join();
+	m_workers.clear();
+
+	for (size_t i = 0; i < m_queues.size(); ++i) {
+		assert(m_queues[i]->Jobs.empty());
+		delete m_queues[i];
+	}
+	m_queues.clear();
+	m_pending.store(0);
+}
+
+uint32_t JobSystem::GetThreadIndex() {
+	return t_threadIndex;
+}
+
+void JobSystem::Submit(JobFunc func, void* data, uint32_t begin, uint32_t end,
+		JobCounter* counter) {
+	Job job = { func, data, begin, end, counter };
+	if (counter)
+		counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_workers.empty()) {
+		Run(job);
+		return;
+	}
+
+	uint32_t thread = GetThreadIndex();
+	if (thread >= m_queues.size())
+		thread = 0;
+	m_pending.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(m_queues[thread]->Mutex);
+		m_queues[thread]->Jobs.push_back(job);
+	}
+
+	// Taking the lock orders this wakeup after any worker that is about to
+	// sleep has checked m_pending.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+bool JobSystem::PopOrSteal(uint32_t thread, Job& job) {
+	if (m_pending.load(std::memory_order_acquire) == 0)
+		return false;
+
+	uint32_t count = (uint32_t)m_queues.size();
+	if (thread >= count)
+		thread = 0;
+	{
+		Queue& own = *m_queues[thread];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		if (!own.Jobs.empty()) {
+			job = own.Jobs.back();
+			own.Jobs.pop_back();
+			m_pending.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	for (uint32_t i = 1; i < count; ++i) {
+		Queue& victim = *m_queues[(thread + i) % count];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (!victim.Jobs.empty()) {
+			job = victim.Jobs.front();
+			victim.Jobs.pop_front();
+			m_pending.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Run(const Job& job) {
+	job.Func(job.Data, job.Begin, job.End);
+	if (job.Counter)
+		job.Counter->m_value.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	uint32_t thread = GetThreadIndex();
+	Job job;
+	while (!counter.IsDone()) {
+		if (PopOrSteal(thread, job))
+			Run(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::WorkerLoop(uint32_t thread) {
+	t_threadIndex = thread;
+	Job job;
+	for (;;) {
+		if (PopOrSteal(thread, job)) {
+			Run(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if (m_quit.load())
+			break;
+		if (m_pending.load(std::memory_order_acquire) == 0)
+			m_wake.wait(lock);
+		if (m_quit.load())
+			break;
+	}
+	t_threadIndex = 0;
+}
+
+} // namespace Zeus
@@ -0,0 +1,133 @@
+/*
+ * JobSystem.h
+ *
+ * Work-stealing thread pool. Every worker owns a deque: it pushes and pops
+ * its own jobs at the back and steals from the front of the others when it
+ * runs dry. Threads that wait on a JobCounter run queued jobs instead of
+ * blocking, so jobs may spawn and wait on further jobs.
+ *
+ * Engine systems take a JobSystem pointer; passing nullptr runs the same
+ * work serially on the calling thread.
+ */
+
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Zeus {
+
+class JobCounter {
+public:
+	JobCounter() : m_value(0) {}
+
+	bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+
+	std::atomic<uint32_t> m_value;
+};
+
+class JobSystem {
+public:
+	typedef void (*JobFunc)(void* data, uint32_t begin, uint32_t end);
+
+	JobSystem();
+	~JobSystem();
+
+	// workerCount of 0 uses one worker per hardware thread, minus the
+	// calling thread.
+	bool Initialize(uint32_t workerCount = 0);
+	void Shutdown();
+
+	// Workers plus the thread that owns the system.
+	uint32_t GetThreadCount() const { return (uint32_t)m_workers.size() + 1; }
+	// 1..N on worker threads, 0 everywhere else. Handy for indexing
+	// per-thread scratch data.
+	static uint32_t GetThreadIndex();
+
+	void Submit(JobFunc func, void* data, uint32_t begin, uint32_t end, JobCounter* counter);
+	// Runs other jobs until the counter reaches zero.
+	void Wait(JobCounter& counter);
+
+	// Calls body(begin, end) over [0, count) in chunks of at most grain
+	// items and returns when every chunk has finished.
+	template <typename Body>
+	void ParallelFor(uint32_t count, uint32_t grain, const Body& body);
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct Job {
+		JobFunc Func;
+		void* Data;
+		uint32_t Begin;
+		uint32_t End;
+		JobCounter* Counter;
+	};
+
+	struct Queue {
+		std::mutex Mutex;
+		std::deque<Job> Jobs;
+	};
+
+	template <typename Body>
+	static void RunBody(void* data, uint32_t begin, uint32_t end) {
+		(*static_cast<const Body*>(data))(begin, end);
+	}
+
+	bool PopOrSteal(uint32_t thread, Job& job);
+	void Run(const Job& job);
+	void WorkerLoop(uint32_t thread);
+
+	std::vector<std::thread> m_workers;
+	std::vector<Queue*> m_queues;
+	std::atomic<uint32_t> m_pending;
+	std::atomic<bool> m_quit;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+};
+
+template <typename Body>
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain, const Body& body) {
+	if (grain == 0)
+		grain = 1;
+	if (count <= grain || m_workers.empty()) {
+		if (count)
+			body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	// The first chunk runs on this thread after the rest are queued.
+	for (uint32_t begin = grain; begin < count; begin += grain) {
+		uint32_t end = count - begin > grain ? begin + grain : count;
+		Submit(&RunBody<Body>, const_cast<Body*>(&body), begin, end, &counter);
+	}
+	body(0, grain);
+	Wait(counter);
+}
+
+// Serial fallback when no job system is available.
+template <typename Body>
+void ParallelFor(JobSystem* jobs, uint32_t count, uint32_t grain, const Body& body) {
+	if (jobs)
+		jobs->ParallelFor(count, grain, body);
+	else if (count)
+		body(0, count);
+}
+
+} // namespace Zeus
+
+#endif /* JOBSYSTEM_H_ */
@@ -0,0 +1,308 @@
+/*
+ * LineRenderer.cpp
+ *
+ */
+
+#include "LineRenderer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// Polylines handed to a job at a time.
+const uint32_t POLYLINE_GRAIN = 64;
+// Screen segments shorter than this have no usable direction.
+const float MIN_SEGMENT_LENGTH = 1e-4f;
+// Cap distance of an end that joins its neighbour; never wins the max.
+const float CAP_OFF = -1e6f;
+
+struct ScreenPoint {
+	float X;
+	float Y;
+	float Z;
+	float W;
+};
+
+ScreenPoint ToScreen(const XMFLOAT4& clip, const Viewport& viewport) {
+	const float inverseW = 1.0f / clip.w;
+	ScreenPoint point;
+	point.X = viewport.TopLeftX + (clip.x * inverseW * 0.5f + 0.5f) * viewport.Width;
+	point.Y = viewport.TopLeftY + (0.5f - clip.y * inverseW * 0.5f) * viewport.Height;
+	point.Z = clip.z;
+	point.W = clip.w;
+	return point;
+}
+
+// Point where the near plane (z = 0) cuts the segment from inside to outside.
+XMFLOAT4 ClipToNear(const XMFLOAT4& inside, const XMFLOAT4& outside) {
+	const float t = inside.z / (inside.z - outside.z);
+	return XMFLOAT4(inside.x + (outside.x - inside.x) * t, inside.y + (outside.y - inside.y) * t,
+			0.0f, inside.w + (outside.w - inside.w) * t);
+}
+
+// Unit screen direction from a to b, or false if both are not in front of
+// the near plane or too close together.
+bool GetDirection(const XMFLOAT4& a, const XMFLOAT4& b, const Viewport& viewport,
+		XMFLOAT2& direction) {
+	if (a.z < 0.0f || b.z < 0.0f)
+		return false;
+	ScreenPoint sa = ToScreen(a, viewport);
+	ScreenPoint sb = ToScreen(b, viewport);
+	float dx = sb.X - sa.X;
+	float dy = sb.Y - sa.Y;
+	float length = sqrtf(dx * dx + dy * dy);
+	if (length < MIN_SEGMENT_LENGTH)
+		return false;
+	direction = XMFLOAT2(dx / length, dy / length);
+	return true;
+}
+
+// Offset of the outer miter corner per unit of half width, along the
+// left normal. Both segments of a join call this with the same arguments
+// so they agree on the shared corner bit for bit.
+bool GetMiter(const XMFLOAT2& incoming, const XMFLOAT2& outgoing, float limit,
+		XMFLOAT2& miter) {
+	float mx = -incoming.y - outgoing.y;
+	float my = incoming.x + outgoing.x;
+	float length = sqrtf(mx * mx + my * my);
+	if (length < 1e-6f)
+		return false;
+	mx /= length;
+	my /= length;
+	// Cosine of half the turn; the miter is 1 / cosine half widths long.
+	float cosine = -incoming.y * mx + incoming.x * my;
+	if (cosine * limit < 1.0f)
+		return false;
+	miter = XMFLOAT2(mx / cosine, my / cosine);
+	return true;
+}
+
+uint32_t ScaleAlpha(uint32_t color, float scale) {
+	uint32_t alpha = (uint32_t)((color >> 24) * scale + 0.5f);
+	return (color & 0x00ffffff) | (std::min(alpha, 255u) << 24);
+}
+
+} // namespace
+
+LineRenderer::LineRenderer()
+		: m_join(LINE_JOIN_MITER), m_miterLimit(4.0f), m_vertexBuffer(NULL_RESOURCE),
+		m_indexBuffer(NULL_RESOURCE), m_vertexOffset(0), m_indexOffset(0) {
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void LineRenderer::Initialize(uint32_t queueCount, uint32_t reservePerQueue) {
+	m_queues.clear();
+	m_queues.resize(queueCount ? queueCount : 1);
+	for (size_t i = 0; i < m_queues.size(); ++i)
+		m_queues[i].Points.reserve(reservePerQueue);
+}
+
+void LineRenderer::Reset() {
+	for (size_t i = 0; i < m_queues.size(); ++i) {
+		m_queues[i].Points.clear();
+		m_queues[i].Polylines.clear();
+	}
+}
+
+void LineRenderer::AddLine(uint32_t queue, const XMFLOAT3& a, const XMFLOAT3& b,
+		uint32_t color, float width) {
+	XMFLOAT3 points[2] = { a, b };
+	AddPolyline(queue, points, 2, color, width, false);
+}
+
+void LineRenderer::AddPolyline(uint32_t queue, const XMFLOAT3* points, uint32_t count,
+		uint32_t color, float width, bool closed) {
+	if (count < 2 || !(width > 0.0f))
+		return;
+	Queue& q = m_queues[queue];
+	Polyline polyline;
+	polyline.FirstPoint = (uint32_t)q.Points.size();
+	polyline.PointCount = count;
+	polyline.Color = width < 1.0f ? ScaleAlpha(color, width) : color;
+	polyline.Width = std::max(width, 1.0f);
+	polyline.Closed = closed && count > 2;
+	q.Points.insert(q.Points.end(), points, points + count);
+	q.Polylines.push_back(polyline);
+}
+
+void LineRenderer::AddBox(uint32_t queue, const XMFLOAT3& minimum, const XMFLOAT3& maximum,
+		uint32_t color, float width) {
+	const float x[2] = { minimum.x, maximum.x };
+	const float y[2] = { minimum.y, maximum.y };
+	const float z[2] = { minimum.z, maximum.z };
+	for (uint32_t i = 0; i < 2; ++i) {
+		XMFLOAT3 loop[4] = {
+			XMFLOAT3(x[0], y[0], z[i]), XMFLOAT3(x[1], y[0], z[i]),
+			XMFLOAT3(x[1], y[1], z[i]), XMFLOAT3(x[0], y[1], z[i])
+		};
+		AddPolyline(queue, loop, 4, color, width, true);
+	}
+	for (uint32_t i = 0; i < 4; ++i) {
+		XMFLOAT3 a(x[i & 1], y[i >> 1], z[0]);
+		XMFLOAT3 b(x[i & 1], y[i >> 1], z[1]);
+		AddLine(queue, a, b, color, width);
+	}
+}
+
+void LineRenderer::Build(CXMMATRIX viewProjection, const Viewport& viewport, JobSystem* jobs) {
+	m_entries.clear();
+	uint32_t segments = 0;
+	for (uint32_t q = 0; q < (uint32_t)m_queues.size(); ++q) {
+		const std::vector<Polyline>& polylines = m_queues[q].Polylines;
+		for (uint32_t i = 0; i < (uint32_t)polylines.size(); ++i) {
+			Entry entry = { q, i, segments };
+			m_entries.push_back(entry);
+			const Polyline& polyline = polylines[i];
+			segments += polyline.Closed ? polyline.PointCount : polyline.PointCount - 1;
+		}
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.PolylineCount = (uint32_t)m_entries.size();
+	m_stats.SegmentCount = segments;
+	m_vertices.resize(segments * 4);
+	m_indices.resize(segments * 6);
+
+	std::atomic<uint32_t> culled(0);
+	std::atomic<uint32_t> miters(0);
+	ParallelFor(jobs, (uint32_t)m_entries.size(), POLYLINE_GRAIN,
+			[&](uint32_t begin, uint32_t end) {
+		std::vector<XMFLOAT4> clip;
+		LineStats stats = {};
+		for (uint32_t i = begin; i < end; ++i)
+			BuildPolyline(m_entries[i], viewProjection, viewport, clip, stats);
+		culled += stats.CulledSegments;
+		miters += stats.MiterJoins;
+	});
+	m_stats.CulledSegments = culled;
+	m_stats.MiterJoins = miters;
+}
+
+void LineRenderer::BuildPolyline(const Entry& entry, CXMMATRIX viewProjection,
+		const Viewport& viewport, std::vector<XMFLOAT4>& clip, LineStats& stats) {
+	const Queue& queue = m_queues[entry.Queue];
+	const Polyline& polyline = queue.Polylines[entry.Polyline];
+	const uint32_t count = polyline.PointCount;
+	const XMFLOAT3* points = &queue.Points[polyline.FirstPoint];
+	clip.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&points[i]), viewProjection));
+
+	const uint32_t segments = polyline.Closed ? count : count - 1;
+	const float halfWidth = polyline.Width * 0.5f;
+	// One pixel past the half width covers the whole AA ramp.
+	const float extent = halfWidth + 1.0f;
+	const bool miter = m_join == LINE_JOIN_MITER;
+	for (uint32_t s = 0; s < segments; ++s) {
+		const uint32_t first = (entry.FirstSegment + s) * 4;
+		LineVertex* vertices = &m_vertices[first];
+		uint32_t* indices = &m_indices[(entry.FirstSegment + s) * 6];
+		indices[0] = first;
+		indices[1] = first + 1;
+		indices[2] = first + 2;
+		indices[3] = first + 2;
+		indices[4] = first + 1;
+		indices[5] = first + 3;
+
+		const uint32_t a = s;
+		const uint32_t b = s + 1 < count ? s + 1 : 0;
+		XMFLOAT4 start = clip[a];
+		XMFLOAT4 end = clip[b];
+		if (start.z < 0.0f && end.z < 0.0f) {
+			memset(vertices, 0, 4 * sizeof(LineVertex));
+			++stats.CulledSegments;
+			continue;
+		}
+		if (start.z < 0.0f)
+			start = ClipToNear(end, start);
+		else if (end.z < 0.0f)
+			end = ClipToNear(start, end);
+
+		XMFLOAT2 direction;
+		const bool valid = GetDirection(start, end, viewport, direction);
+		if (!valid)
+			direction = XMFLOAT2(1.0f, 0.0f);
+		const ScreenPoint sa = ToScreen(start, viewport);
+		const ScreenPoint sb = ToScreen(end, viewport);
+		const float length = valid ? (sb.X - sa.X) * direction.x + (sb.Y - sa.Y) * direction.y
+				: 0.0f;
+		const XMFLOAT2 normal(-direction.y, direction.x);
+
+		// A join needs both segments whole and with a direction; clipped
+		// segments are capped at both ends.
+		const bool whole = clip[a].z >= 0.0f && clip[b].z >= 0.0f;
+		XMFLOAT2 startMiter, endMiter, neighbour;
+		bool joinStart = miter && whole && valid && (polyline.Closed || s > 0)
+				&& GetDirection(clip[a > 0 ? a - 1 : count - 1], clip[a], viewport, neighbour)
+				&& GetMiter(neighbour, direction, m_miterLimit, startMiter);
+		bool joinEnd = miter && whole && valid && (polyline.Closed || s + 1 < segments)
+				&& GetDirection(clip[b], clip[b + 1 < count ? b + 1 : 0], viewport, neighbour)
+				&& GetMiter(direction, neighbour, m_miterLimit, endMiter);
+		stats.MiterJoins += joinEnd ? 1 : 0;
+
+		XMFLOAT2 corners[4];
+		for (uint32_t side = 0; side < 2; ++side) {
+			const float sign = side == 0 ? extent : -extent;
+			corners[side] = joinStart
+					? XMFLOAT2(sa.X + startMiter.x * sign, sa.Y + startMiter.y * sign)
+					: XMFLOAT2(sa.X - direction.x * extent + normal.x * sign,
+							sa.Y - direction.y * extent + normal.y * sign);
+			corners[2 + side] = joinEnd
+					? XMFLOAT2(sb.X + endMiter.x * sign, sb.Y + endMiter.y * sign)
+					: XMFLOAT2(sb.X + direction.x * extent + normal.x * sign,
+							sb.Y + direction.y * extent + normal.y * sign);
+		}
+		for (uint32_t i = 0; i < 4; ++i) {
+			const ScreenPoint& origin = i < 2 ? sa : sb;
+			const float dx = corners[i].x - sa.X;
+			const float dy = corners[i].y - sa.Y;
+			const float along = dx * direction.x + dy * direction.y;
+			LineVertex& vertex = vertices[i];
+			// Back to clip space at the end point's depth, so the quad
+			// keeps its pixel width under perspective.
+			float ndcX = (corners[i].x - viewport.TopLeftX) / viewport.Width * 2.0f - 1.0f;
+			float ndcY = 1.0f - (corners[i].y - viewport.TopLeftY) / viewport.Height * 2.0f;
+			vertex.Position = XMFLOAT4(ndcX * origin.W, ndcY * origin.W, origin.Z, origin.W);
+			vertex.Edge = XMFLOAT4(joinStart ? CAP_OFF : -along,
+					joinEnd ? CAP_OFF : along - length,
+					dx * normal.x + dy * normal.y, halfWidth);
+			vertex.Color = polyline.Color;
+		}
+	}
+}
+
+bool LineRenderer::Upload(RingAllocator& ring) {
+	// Empty frames still get one primitive's worth so the streams stay valid.
+	uint32_t vertexCount = std::max(4u, (uint32_t)m_vertices.size());
+	uint32_t indexCount = std::max(6u, (uint32_t)m_indices.size());
+	RingAllocation vertices = ring.AllocateVertices(vertexCount, sizeof(LineVertex));
+	RingAllocation indices = ring.AllocateIndices(indexCount, FORMAT_R32_UINT);
+	if (!vertices.IsValid() || !indices.IsValid())
+		return false;
+	if (!m_vertices.empty()) {
+		memcpy(vertices.CpuAddress, &m_vertices[0], m_vertices.size() * sizeof(LineVertex));
+		memcpy(indices.CpuAddress, &m_indices[0], m_indices.size() * sizeof(uint32_t));
+	}
+	m_vertexBuffer = vertices.Buffer;
+	m_vertexOffset = vertices.Offset;
+	m_indexBuffer = indices.Buffer;
+	m_indexOffset = indices.Offset;
+	return true;
+}
+
+void LineRenderer::Record(CommandList& list) const {
+	if (m_indices.empty())
+		return;
+	uint32_t stride = sizeof(LineVertex);
+	list.SetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &m_vertexOffset);
+	list.SetIndexBuffer(m_indexBuffer, FORMAT_R32_UINT, m_indexOffset);
+	list.SetPrimitiveTopology(TOPOLOGY_TRIANGLELIST);
+	list.DrawIndexed((uint32_t)m_indices.size(), 0, 0);
+}
+
+} // namespace Zeus
@@ -0,0 +1,146 @@
+/*
+ * LineRenderer.h
+ *
+ * Replacement for ID3DXLine, sized for debug views that draw hundreds of
+ * thousands of lines a frame. Threads record lines and polylines into
+ * their own queues; Build() projects them, expands every segment into a
+ * screen-aligned quad of the requested pixel width and writes one vertex
+ * and index stream, drawn with a single DrawIndexed.
+ *
+ * Anti-aliasing is analytic. Each vertex carries its signed distances
+ * past the segment's start and end and across the segment, in pixels; the
+ * pixel shader computes
+ *
+ *     d = length(max(max(edge.x, edge.y), 0), edge.z)
+ *     alpha = saturate(edge.w + 0.5 - d)
+ *
+ * which gives round caps, and round joins where two capped segments
+ * overlap. Miter joins extend both quads to the bisector instead and turn
+ * the caps off there; joins sharper than the miter limit fall back to
+ * round. Segments crossing the near plane are clipped and capped.
+ *
+ * Edge is linear in screen space, so the shader must declare it
+ * noperspective. Quads are not consistently wound; draw without culling.
+ */
+
+#ifndef LINERENDERER_H_
+#define LINERENDERER_H_
+
+#include "CommandList.h"
+#include "RingAllocator.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum LineJoin {
+	LINE_JOIN_ROUND,
+	LINE_JOIN_MITER
+};
+
+struct LineVertex {
+	// Clip space.
+	XMFLOAT4 Position;
+	// Pixels past the start cap, past the end cap, across the line, and
+	// the half width.
+	XMFLOAT4 Edge;
+	// D3DCOLOR (0xAARRGGBB).
+	uint32_t Color;
+};
+
+struct LineStats {
+	uint32_t PolylineCount;
+	uint32_t SegmentCount;
+	// Segments entirely behind the near plane.
+	uint32_t CulledSegments;
+	uint32_t MiterJoins;
+};
+
+class LineRenderer {
+public:
+	LineRenderer();
+
+	// One queue per producer. reservePerQueue is in points.
+	void Initialize(uint32_t queueCount, uint32_t reservePerQueue = 0);
+	void Reset();
+
+	void SetJoin(LineJoin join) { m_join = join; }
+	// Longest miter as a multiple of the half width.
+	void SetMiterLimit(float limit) { m_miterLimit = limit; }
+
+	// Only one thread may record to a given queue at a time. Positions are
+	// in world space and widths in pixels; lines thinner than a pixel are
+	// drawn one pixel wide with their alpha scaled down instead.
+	void AddLine(uint32_t queue, const XMFLOAT3& a, const XMFLOAT3& b, uint32_t color,
+			float width);
+	void AddPolyline(uint32_t queue, const XMFLOAT3* points, uint32_t count, uint32_t color,
+			float width, bool closed);
+	// The twelve edges of an axis-aligned box.
+	void AddBox(uint32_t queue, const XMFLOAT3& minimum, const XMFLOAT3& maximum, uint32_t color,
+			float width);
+
+	// viewProjection maps world to clip space for the target viewport.
+	void Build(CXMMATRIX viewProjection, const Viewport& viewport, JobSystem* jobs);
+
+	const LineVertex* GetVertices() const { return m_vertices.empty() ? nullptr : &m_vertices[0]; }
+	const uint32_t* GetIndices() const { return m_indices.empty() ? nullptr : &m_indices[0]; }
+	uint32_t GetIndexCount() const { return (uint32_t)m_indices.size(); }
+	const LineStats& GetStats() const { return m_stats; }
+
+	// Copies the last Build() into ring. Returns false if the ring is full.
+	bool Upload(RingAllocator& ring);
+	// Binds the uploaded streams and records the one draw. Shaders, blend
+	// state and the input layout are left to the caller.
+	void Record(CommandList& list) const;
+
+private:
+	LineRenderer(const LineRenderer&);
+	LineRenderer& operator=(const LineRenderer&);
+
+	struct Polyline {
+		uint32_t FirstPoint;
+		uint32_t PointCount;
+		uint32_t Color;
+		float Width;
+		bool Closed;
+	};
+
+	struct Queue {
+		std::vector<XMFLOAT3> Points;
+		std::vector<Polyline> Polylines;
+		// Keeps neighbouring producers off each other's cache lines.
+		char Padding[64];
+	};
+
+	// A polyline of the whole frame and where its segments go.
+	struct Entry {
+		uint32_t Queue;
+		uint32_t Polyline;
+		uint32_t FirstSegment;
+	};
+
+	void BuildPolyline(const Entry& entry, CXMMATRIX viewProjection, const Viewport& viewport,
+			std::vector<XMFLOAT4>& clip, LineStats& stats);
+
+	std::vector<Queue> m_queues;
+	std::vector<Entry> m_entries;
+	std::vector<LineVertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+	LineStats m_stats;
+	LineJoin m_join;
+	float m_miterLimit;
+	ResourceHandle m_vertexBuffer;
+	ResourceHandle m_indexBuffer;
+	uint32_t m_vertexOffset;
+	uint32_t m_indexOffset;
+};
+
+} // namespace Zeus
+
+#endif /* LINERENDERER_H_ */
@@ -0,0 +1,571 @@
+/*
+ * MeshOptimizer.cpp
+ *
+ */
+
+#include "MeshOptimizer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = 0xffffffff;
+
+// Forsyth's constants: a 32 entry LRU cache, the last triangle's three
+// vertices scored flat, and a boost for vertices with few triangles left.
+const uint32_t CACHE_SIZE = 32;
+const uint32_t MAX_VALENCE = 32;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float CACHE_DECAY_POWER = 1.5f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+struct ScoreTables {
+	float Cache[CACHE_SIZE];
+	float Valence[MAX_VALENCE + 1];
+
+	ScoreTables() {
+		for (uint32_t i = 0; i < CACHE_SIZE; ++i) {
+			if (i < 3)
+				Cache[i] = LAST_TRIANGLE_SCORE;
+			else
+				Cache[i] = powf(1.0f - (float)(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		Valence[0] = 0.0f;
+		for (uint32_t i = 1; i <= MAX_VALENCE; ++i)
+			Valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+	}
+};
+
+const ScoreTables SCORES;
+
+float GetVertexScore(uint32_t position, uint32_t live) {
+	if (live == 0)
+		return -1.0f;
+	float score = position < CACHE_SIZE ? SCORES.Cache[position] : 0.0f;
+	return score + SCORES.Valence[std::min(live, MAX_VALENCE)];
+}
+
+// FIFO the overdraw pass measures cluster cuts against.
+const uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+// FIFO simulation; Flush() empties it in constant time.
+class FifoCache {
+public:
+	explicit FifoCache(uint32_t vertexCount)
+		: m_inserted(vertexCount, 0), m_timestamp(OVERDRAW_CACHE_SIZE + 1) {}
+
+	void Flush() { m_timestamp += OVERDRAW_CACHE_SIZE + 1; }
+
+	uint32_t AddTriangle(const uint32_t* corner) {
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (m_timestamp - m_inserted[corner[k]] > OVERDRAW_CACHE_SIZE) {
+				m_inserted[corner[k]] = m_timestamp++;
+				++misses;
+			}
+		}
+		return misses;
+	}
+
+private:
+	std::vector<uint32_t> m_inserted;
+	uint32_t m_timestamp;
+};
+
+struct Cluster {
+	uint32_t FirstTriangle;
+	uint32_t TriangleCount;
+	float Sort;
+};
+
+bool HasMoreOcclusion(const Cluster& a, const Cluster& b) {
+	return a.Sort > b.Sort;
+}
+
+// Vertex fetch simulation: 256 direct-mapped lines of 64 bytes.
+const uint32_t FETCH_LINE_SIZE = 64;
+const uint32_t FETCH_LINE_COUNT = 256;
+
+uint32_t GetAlignedSize(Format format) {
+	return (BitsPerPixel(format) / 8 + 3) & ~3u;
+}
+
+bool IsSameSemantic(const VertexElement& a, const VertexElement& b) {
+	return a.Usage == b.Usage && a.UsageIndex == b.UsageIndex;
+}
+
+XMVECTOR LoadPosition(const XMFLOAT3* positions, uint32_t stride, uint32_t index) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions) + (size_t)index * stride;
+	return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bytes));
+}
+
+VertexFetchStats AnalyzeFetch(const MeshBuffers& mesh, uint32_t cacheSize) {
+	VertexFetchStats total = {};
+	uint32_t stride = 0;
+	for (uint32_t i = 0; i < mesh.StreamCount; ++i) {
+		VertexFetchStats stream = AnalyzeVertexFetch(mesh.Indices, mesh.IndexCount,
+				mesh.VertexCount, mesh.Streams[i].Stride, cacheSize);
+		total.BytesFetched += stream.BytesFetched;
+		// Overfetch is bytes over referenced bytes, so weight by stride.
+		total.Overfetch += stream.Overfetch * mesh.Streams[i].Stride;
+		stride += mesh.Streams[i].Stride;
+	}
+	if (stride)
+		total.Overfetch /= stride;
+	return total;
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats stats = {};
+	stats.TriangleCount = indexCount / 3;
+	// A vertex is resident while fewer than cacheSize vertices have been
+	// inserted after it.
+	std::vector<uint32_t> inserted(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	for (uint32_t i = 0; i < stats.TriangleCount * 3; ++i) {
+		const uint32_t vertex = indices[i];
+		if (inserted[vertex] == 0)
+			++stats.VertexCount;
+		if (timestamp - inserted[vertex] > cacheSize) {
+			inserted[vertex] = timestamp++;
+			++stats.Transforms;
+		}
+	}
+	if (stats.TriangleCount)
+		stats.Acmr = (float)stats.Transforms / stats.TriangleCount;
+	if (stats.VertexCount)
+		stats.Atvr = (float)stats.Transforms / stats.VertexCount;
+	return stats;
+}
+
+void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount) {
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Work on the range of vertices the triangles use, so small subsets
+	// of large meshes stay cheap.
+	uint32_t firstVertex = vertexCount;
+	uint32_t lastVertex = 0;
+	for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+		firstVertex = std::min(firstVertex, indices[i]);
+		lastVertex = std::max(lastVertex, indices[i]);
+	}
+	const uint32_t localCount = lastVertex - firstVertex + 1;
+	std::vector<uint32_t> local(indices, indices + triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		local[i] -= firstVertex;
+
+	// Triangles of every vertex; the first Live entries are unemitted.
+	std::vector<uint32_t> live(localCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		++live[local[i]];
+	std::vector<uint32_t> offsets(localCount + 1, 0);
+	for (uint32_t v = 0; v < localCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		adjacency[fill[local[i]]++] = i / 3;
+
+	std::vector<uint32_t> position(localCount, NONE);
+	std::vector<float> vertexScores(localCount);
+	for (uint32_t v = 0; v < localCount; ++v)
+		vertexScores[v] = GetVertexScore(NONE, live[v]);
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t best = 0;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		const uint32_t* corner = &local[t * 3];
+		triangleScores[t] = vertexScores[corner[0]] + vertexScores[corner[1]]
+				+ vertexScores[corner[2]];
+		if (triangleScores[t] > triangleScores[best])
+			best = t;
+	}
+
+	uint32_t cache[CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+	uint32_t next[CACHE_SIZE + 3];
+	uint32_t cursor = 0;
+	for (uint32_t out = 0; out < triangleCount; ++out) {
+		if (best == NONE) {
+			// Dead end: nothing in the cache has triangles left.
+			while (emitted[cursor])
+				++cursor;
+			best = cursor;
+		}
+		const uint32_t* corner = &local[best * 3];
+		destination[out * 3 + 0] = corner[0] + firstVertex;
+		destination[out * 3 + 1] = corner[1] + firstVertex;
+		destination[out * 3 + 2] = corner[2] + firstVertex;
+		emitted[best] = true;
+
+		// The triangle's vertices move to the front of the cache.
+		uint32_t nextCount = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint32_t vertex = corner[k];
+			if (std::find(next, next + nextCount, vertex) == next + nextCount)
+				next[nextCount++] = vertex;
+			uint32_t* triangles = &adjacency[offsets[vertex]];
+			uint32_t* end = triangles + live[vertex];
+			uint32_t* found = std::find(triangles, end, best);
+			*found = *(end - 1);
+			--live[vertex];
+		}
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			const uint32_t vertex = cache[i];
+			if (vertex != corner[0] && vertex != corner[1] && vertex != corner[2])
+				next[nextCount++] = vertex;
+		}
+
+		// Rescore everything that moved, including vertices that fell out.
+		for (uint32_t i = 0; i < nextCount; ++i) {
+			const uint32_t vertex = next[i];
+			position[vertex] = i < CACHE_SIZE ? i : NONE;
+			const float score = GetVertexScore(position[vertex], live[vertex]);
+			const float change = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			const uint32_t* triangles = &adjacency[offsets[vertex]];
+			for (uint32_t j = 0; j < live[vertex]; ++j)
+				triangleScores[triangles[j]] += change;
+		}
+		best = NONE;
+		float bestScore = 0.0f;
+		cacheCount = std::min(nextCount, CACHE_SIZE);
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			const uint32_t vertex = next[i];
+			cache[i] = vertex;
+			const uint32_t* triangles = &adjacency[offsets[vertex]];
+			for (uint32_t j = 0; j < live[vertex]; ++j) {
+				if (triangleScores[triangles[j]] > bestScore) {
+					best = triangles[j];
+					bestScore = triangleScores[best];
+				}
+			}
+		}
+	}
+}
+
+void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		const XMFLOAT3* positions, uint32_t positionStride, uint32_t vertexCount,
+		float threshold) {
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+	const uint32_t stride = positionStride ? positionStride : sizeof(XMFLOAT3);
+	std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+	// Hard boundaries: triangles whose three vertices all miss, where
+	// the cache optimizer started over.
+	std::vector<uint32_t> hard;
+	FifoCache cache(vertexCount);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (cache.AddTriangle(&source[t * 3]) == 3 || t == 0)
+			hard.push_back(t);
+	}
+	hard.push_back(triangleCount);
+
+	// Soft boundaries: cut a cluster once its running ACMR is within the
+	// threshold of the whole cluster's. Each piece starts with a cold
+	// cache, so cutting there costs no more than threshold allows.
+	std::vector<Cluster> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); ++h) {
+		const uint32_t begin = hard[h];
+		const uint32_t end = hard[h + 1];
+		cache.Flush();
+		uint32_t misses = 0;
+		for (uint32_t t = begin; t < end; ++t)
+			misses += cache.AddTriangle(&source[t * 3]);
+		const float limit = threshold * misses / (end - begin);
+
+		cache.Flush();
+		Cluster cluster = { begin, 0, 0.0f };
+		uint32_t runningMisses = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			runningMisses += cache.AddTriangle(&source[t * 3]);
+			++cluster.TriangleCount;
+			if (t + 1 < end && (float)runningMisses / cluster.TriangleCount <= limit) {
+				clusters.push_back(cluster);
+				cluster.FirstTriangle = t + 1;
+				cluster.TriangleCount = 0;
+				runningMisses = 0;
+				cache.Flush();
+			}
+		}
+		clusters.push_back(cluster);
+	}
+
+	// Occlusion potential: distance of the cluster's centroid in front of
+	// the mesh centroid along the cluster's average normal.
+	XMVECTOR meshCenter = XMVectorZero();
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		meshCenter = XMVectorAdd(meshCenter, LoadPosition(positions, stride, source[i]));
+	meshCenter = XMVectorScale(meshCenter, 1.0f / (triangleCount * 3));
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		Cluster& cluster = clusters[c];
+		XMVECTOR center = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (uint32_t t = cluster.FirstTriangle;
+				t < cluster.FirstTriangle + cluster.TriangleCount; ++t) {
+			XMVECTOR p0 = LoadPosition(positions, stride, source[t * 3 + 0]);
+			XMVECTOR p1 = LoadPosition(positions, stride, source[t * 3 + 1]);
+			XMVECTOR p2 = LoadPosition(positions, stride, source[t * 3 + 2]);
+			// Clockwise front faces: this cross product points outwards.
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float weight = XMVectorGetX(XMVector3Length(n));
+			XMVECTOR centroid = XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+			center = XMVectorAdd(center, XMVectorScale(centroid, weight));
+			normal = XMVectorAdd(normal, n);
+			area += weight;
+		}
+		const float length = XMVectorGetX(XMVector3Length(normal));
+		if (area > 0.0f && length > 0.0f) {
+			center = XMVectorScale(center, 1.0f / area);
+			cluster.Sort = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, meshCenter),
+					normal)) / length;
+		}
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), HasMoreOcclusion);
+
+	uint32_t out = 0;
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		const uint32_t* first = &source[clusters[c].FirstTriangle * 3];
+		std::copy(first, first + clusters[c].TriangleCount * 3, destination + out);
+		out += clusters[c].TriangleCount * 3;
+	}
+}
+
+OverdrawStats AnalyzeOverdraw(const uint32_t* indices, uint32_t indexCount,
+		const XMFLOAT3* positions, uint32_t positionStride, uint32_t vertexCount,
+		uint32_t resolution, JobSystem* jobs) {
+	OverdrawStats total = {};
+	if (indexCount < 3 || vertexCount == 0 || resolution == 0)
+		return total;
+	const uint32_t stride = positionStride ? positionStride : sizeof(XMFLOAT3);
+	XMVECTOR low = LoadPosition(positions, stride, 0);
+	XMVECTOR high = low;
+	for (uint32_t i = 1; i < vertexCount; ++i) {
+		XMVECTOR p = LoadPosition(positions, stride, i);
+		low = XMVectorMin(low, p);
+		high = XMVectorMax(high, p);
+	}
+	const XMVECTOR center = XMVectorScale(XMVectorAdd(low, high), 0.5f);
+	const float radius = std::max(XMVectorGetX(XMVector3Length(XMVectorSubtract(high, center))),
+			1e-6f);
+	const float half = resolution * 0.5f;
+	const XMMATRIX toViewport = XMMatrixMultiply(XMMatrixScaling(half, -half, 1.0f),
+			XMMatrixTranslation(half, half, 0.0f));
+	const XMMATRIX projection = XMMatrixOrthographicLH(2.0f * radius, 2.0f * radius, radius,
+			3.0f * radius);
+
+	RasterMesh mesh;
+	mesh.Positions = positions;
+	mesh.PositionStride = positionStride;
+	mesh.VertexCount = vertexCount;
+	mesh.Indices = indices;
+	mesh.IndexFormat = FORMAT_R32_UINT;
+	mesh.IndexCount = indexCount;
+
+	OverdrawStats views[6] = {};
+	ParallelFor(jobs, 6, 1, [&](uint32_t begin, uint32_t end) {
+		DepthBuffer depth;
+		depth.Initialize(resolution, resolution);
+		std::vector<XMFLOAT4> scratch;
+		for (uint32_t view = begin; view < end; ++view) {
+			const float sign = view & 1 ? -1.0f : 1.0f;
+			const uint32_t axis = view / 2;
+			XMVECTOR direction = XMVectorZero();
+			direction = XMVectorSetByIndex(direction, sign, axis);
+			XMVECTOR up = axis == 1 ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)
+					: XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			XMVECTOR eye = XMVectorSubtract(center, XMVectorScale(direction, 2.0f * radius));
+			XMMATRIX toRaster = XMMatrixMultiply(XMMatrixMultiply(
+					XMMatrixLookAtLH(eye, center, up), projection), toViewport);
+			MeasureOverdraw(depth, mesh, toRaster, scratch, views[view]);
+		}
+	});
+	for (uint32_t view = 0; view < 6; ++view) {
+		total.PixelsCovered += views[view].PixelsCovered;
+		total.PixelsShaded += views[view].PixelsShaded;
+	}
+	if (total.PixelsCovered)
+		total.Overdraw = (float)total.PixelsShaded / total.PixelsCovered;
+	return total;
+}
+
+VertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount, uint32_t stride, uint32_t cacheSize) {
+	VertexFetchStats stats = {};
+	std::vector<uint32_t> inserted(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t referenced = 0;
+	// Line addresses plus one, so zero is empty.
+	uint64_t lines[FETCH_LINE_COUNT] = {};
+	for (uint32_t i = 0; i < indexCount / 3 * 3; ++i) {
+		const uint32_t vertex = indices[i];
+		if (inserted[vertex] == 0)
+			++referenced;
+		if (timestamp - inserted[vertex] <= cacheSize)
+			continue;
+		inserted[vertex] = timestamp++;
+		const uint64_t start = (uint64_t)vertex * stride;
+		for (uint64_t line = start / FETCH_LINE_SIZE;
+				line <= (start + stride - 1) / FETCH_LINE_SIZE; ++line) {
+			uint64_t& slot = lines[line % FETCH_LINE_COUNT];
+			if (slot != line + 1) {
+				slot = line + 1;
+				stats.BytesFetched += FETCH_LINE_SIZE;
+			}
+		}
+	}
+	if (referenced && stride)
+		stats.Overfetch = (float)stats.BytesFetched / ((float)referenced * stride);
+	return stats;
+}
+
+uint32_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices,
+		uint32_t indexCount, uint32_t vertexCount) {
+	std::fill(remap, remap + vertexCount, NONE);
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		if (remap[indices[i]] == NONE)
+			remap[indices[i]] = next++;
+	}
+	const uint32_t referenced = next;
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] == NONE)
+			remap[v] = next++;
+	}
+	return referenced;
+}
+
+void RemapIndices(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		const uint32_t* remap) {
+	for (uint32_t i = 0; i < indexCount; ++i)
+		destination[i] = remap[indices[i]];
+}
+
+void RemapVertices(void* destination, const void* vertices, uint32_t vertexCount,
+		uint32_t stride, const uint32_t* remap) {
+	uint8_t* out = static_cast<uint8_t*>(destination);
+	const uint8_t* in = static_cast<const uint8_t*>(vertices);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		memcpy(out + (size_t)remap[v] * stride, in + (size_t)v * stride, stride);
+}
+
+bool SplitVertexStreams(const VertexStream* streams, const VertexElement* elements,
+		uint32_t elementCount, uint32_t vertexCount, const VertexElement* used,
+		uint32_t usedCount, SplitVertexData& result) {
+	result.Elements.clear();
+	const VertexElement* position = nullptr;
+	std::vector<const VertexElement*> kept;
+	for (uint32_t i = 0; i < elementCount; ++i) {
+		const VertexElement& element = elements[i];
+		if (element.Usage == VERTEX_USAGE_POSITION && element.UsageIndex == 0) {
+			position = &element;
+			continue;
+		}
+		bool read = used == nullptr;
+		for (uint32_t j = 0; j < usedCount && !read; ++j)
+			read = IsSameSemantic(element, used[j]);
+		if (read)
+			kept.push_back(&element);
+	}
+	if (!position)
+		return false;
+
+	VertexElement packed = *position;
+	packed.Stream = 0;
+	packed.Offset = 0;
+	result.Elements.push_back(packed);
+	result.PositionStride = GetAlignedSize(position->ElementFormat);
+	result.AttributeStride = 0;
+	for (size_t i = 0; i < kept.size(); ++i) {
+		packed = *kept[i];
+		packed.Stream = 1;
+		packed.Offset = result.AttributeStride;
+		result.Elements.push_back(packed);
+		result.AttributeStride += GetAlignedSize(packed.ElementFormat);
+	}
+
+	result.Positions.assign((size_t)vertexCount * result.PositionStride, 0);
+	result.Attributes.assign((size_t)vertexCount * result.AttributeStride, 0);
+	for (size_t e = 0; e < result.Elements.size(); ++e) {
+		const VertexElement& source = e == 0 ? *position : *kept[e - 1];
+		const VertexElement& target = result.Elements[e];
+		const VertexStream& stream = streams[source.Stream];
+		const uint8_t* in = static_cast<const uint8_t*>(stream.Data) + source.Offset;
+		uint8_t* out = e == 0 ? &result.Positions[0] : &result.Attributes[target.Offset];
+		const uint32_t outStride = e == 0 ? result.PositionStride : result.AttributeStride;
+		const uint32_t size = BitsPerPixel(source.ElementFormat) / 8;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			memcpy(out + (size_t)v * outStride, in + (size_t)v * stream.Stride, size);
+	}
+	return true;
+}
+
+void CookMesh(const MeshBuffers& mesh, const MeshCookSettings& settings,
+		MeshCookReport& report, JobSystem* jobs) {
+	const bool measureOverdraw = mesh.Positions && settings.OverdrawResolution;
+	OverdrawStats noOverdraw = {};
+	report.CacheBefore = AnalyzeVertexCache(mesh.Indices, mesh.IndexCount, mesh.VertexCount,
+			settings.CacheSize);
+	report.OverdrawBefore = measureOverdraw ? AnalyzeOverdraw(mesh.Indices, mesh.IndexCount,
+			mesh.Positions, mesh.PositionStride, mesh.VertexCount, settings.OverdrawResolution,
+			jobs) : noOverdraw;
+	report.FetchBefore = AnalyzeFetch(mesh, settings.CacheSize);
+
+	MeshSubset whole = { 0, mesh.IndexCount };
+	const MeshSubset* subsets = mesh.Subsets ? mesh.Subsets : &whole;
+	const uint32_t subsetCount = mesh.Subsets ? mesh.SubsetCount : 1;
+	ParallelFor(jobs, subsetCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			uint32_t* indices = mesh.Indices + subsets[i].FirstIndex;
+			if (settings.OptimizeVertexCache)
+				OptimizeVertexCache(indices, indices, subsets[i].IndexCount, mesh.VertexCount);
+			if (settings.OptimizeOverdraw && mesh.Positions)
+				OptimizeOverdraw(indices, indices, subsets[i].IndexCount, mesh.Positions,
+						mesh.PositionStride, mesh.VertexCount, settings.OverdrawThreshold);
+		}
+	});
+
+	report.CacheAfter = AnalyzeVertexCache(mesh.Indices, mesh.IndexCount, mesh.VertexCount,
+			settings.CacheSize);
+	report.OverdrawAfter = measureOverdraw ? AnalyzeOverdraw(mesh.Indices, mesh.IndexCount,
+			mesh.Positions, mesh.PositionStride, mesh.VertexCount, settings.OverdrawResolution,
+			jobs) : noOverdraw;
+
+	// One remap over the whole index buffer drives every stream.
+	report.ReferencedVertices = mesh.VertexCount;
+	report.VertexRemap.clear();
+	if (settings.OptimizeVertexFetch && mesh.StreamCount) {
+		std::vector<uint32_t>& remap = report.VertexRemap;
+		remap.resize(mesh.VertexCount);
+		report.ReferencedVertices = OptimizeVertexFetchRemap(&remap[0], mesh.Indices,
+				mesh.IndexCount, mesh.VertexCount);
+		RemapIndices(mesh.Indices, mesh.Indices, mesh.IndexCount, &remap[0]);
+		ParallelFor(jobs, mesh.StreamCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				const VertexStream& stream = mesh.Streams[i];
+				const uint8_t* data = static_cast<const uint8_t*>(stream.Data);
+				std::vector<uint8_t> copy(data, data + (size_t)mesh.VertexCount * stream.Stride);
+				RemapVertices(stream.Data, &copy[0], mesh.VertexCount, stream.Stride, &remap[0]);
+			}
+		});
+	}
+	report.FetchAfter = AnalyzeFetch(mesh, settings.CacheSize);
+}
+
+} // namespace Zeus
@@ -0,0 +1,224 @@
+/*
+ * MeshOptimizer.h
+ *
+ * Offline index and vertex reordering run when meshes are cooked,
+ * replacing D3DXOptimizeFaces.
+ *
+ * The vertex cache pass is Forsyth's linear-speed optimizer: every vertex
+ * scores by its position in a simulated 32 entry LRU cache and by how
+ * many of its triangles are still unemitted, and the next triangle is the
+ * best scoring one touching the cache. Dead ends continue with the next
+ * unemitted triangle in input order, so the whole pass is linear and not
+ * tuned to one cache size the way D3DXOptimizeFaces' FIFO model is.
+ *
+ * Results are measured with a FIFO cache simulation: ACMR is transformed
+ * vertices per triangle (0.5 at best for large regular meshes, 3 at
+ * worst) and ATVR transformed vertices per referenced vertex (1 at best).
+ *
+ * The overdraw pass follows Sander, Nehab and Barczak's "Fast Triangle
+ * Reordering for Vertex Locality and Reduced Overdraw". The cache
+ * optimized order is cut into clusters wherever the simulated cache
+ * flushes, and further wherever the running ACMR of a cluster is within
+ * the threshold of the whole cluster's, so each cut costs at most that
+ * much cache efficiency. Clusters are then sorted by how far they face
+ * out of the mesh, a view-independent measure of how much they occlude,
+ * so outer surfaces draw first and fill the depth buffer early.
+ *
+ * Overdraw is measured with the software rasterizer from the six axis
+ * directions with back faces culled.
+ *
+ * The vertex fetch pass renumbers vertices in order of first use, so the
+ * vertex shader reads every stream front to back, and moves unreferenced
+ * vertices to the end where they can be dropped. Unlike
+ * D3DXOptimizeVertices the same remap drives every stream of the mesh.
+ * SplitVertexStreams then moves positions into their own stream for
+ * depth-only passes and drops the attributes no shader reads. Fetch cost
+ * is measured as the bytes read through a simulated 16 KB direct-mapped
+ * cache of 64 byte lines on every post-transform cache miss.
+ *
+ * Subsets (attribute ranges) are drawn separately and are optimized
+ * independently and in parallel.
+ */
+
+#ifndef MESHOPTIMIZER_H_
+#define MESHOPTIMIZER_H_
+
+#include "Format.h"
+#include "SoftwareRasterizer.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Range of a triangle list index buffer drawn with one call, like
+// D3DXATTRIBUTERANGE.
+struct MeshSubset {
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+};
+
+struct VertexCacheStats {
+	uint32_t TriangleCount;
+	// Distinct vertices referenced by the indices.
+	uint32_t VertexCount;
+	uint32_t Transforms;
+	float Acmr;
+	float Atvr;
+};
+
+// Simulates a post-transform FIFO cache of cacheSize entries.
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount, uint32_t cacheSize);
+
+// Reorders the triangles of a triangle list. destination may equal
+// indices. Triangles keep their winding.
+void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount);
+
+// Reorders the clusters of a vertex cache optimized triangle list so
+// outer surfaces draw first. threshold is the largest ACMR increase a
+// cluster cut may cost, as a factor (1.05 allows 5%). Front faces are
+// clockwise, as in D3D; destination may equal indices.
+void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		const XMFLOAT3* positions, uint32_t positionStride, uint32_t vertexCount,
+		float threshold);
+
+// Overdraw summed over six orthographic views along the axes, rendered at
+// resolution squared pixels. The views render in parallel.
+OverdrawStats AnalyzeOverdraw(const uint32_t* indices, uint32_t indexCount,
+		const XMFLOAT3* positions, uint32_t positionStride, uint32_t vertexCount,
+		uint32_t resolution, JobSystem* jobs);
+
+// Vertex attribute semantics, as D3DDECLUSAGE.
+enum VertexUsage {
+	VERTEX_USAGE_POSITION,
+	VERTEX_USAGE_BLENDWEIGHT,
+	VERTEX_USAGE_BLENDINDICES,
+	VERTEX_USAGE_NORMAL,
+	VERTEX_USAGE_TEXCOORD,
+	VERTEX_USAGE_TANGENT,
+	VERTEX_USAGE_BINORMAL,
+	VERTEX_USAGE_COLOR
+};
+
+// One attribute of an interleaved stream, as D3DVERTEXELEMENT9.
+struct VertexElement {
+	uint32_t Stream;
+	// Bytes from the start of the vertex.
+	uint32_t Offset;
+	Format ElementFormat;
+	VertexUsage Usage;
+	uint32_t UsageIndex;
+};
+
+struct VertexStream {
+	void* Data;
+	uint32_t Stride;
+};
+
+struct VertexFetchStats {
+	uint32_t BytesFetched;
+	// Bytes fetched over the bytes of the referenced vertices; 1 at best.
+	float Overfetch;
+};
+
+// Simulates the vertex fetches of a stream behind a FIFO post-transform
+// cache of cacheSize entries.
+VertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, uint32_t indexCount,
+		uint32_t vertexCount, uint32_t stride, uint32_t cacheSize);
+
+// Fetch order: referenced vertices in order of first use, then the
+// unreferenced ones in their original order. remap[old] is the new index.
+// Returns the number of referenced vertices.
+uint32_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices,
+		uint32_t indexCount, uint32_t vertexCount);
+// destination may equal indices.
+void RemapIndices(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+		const uint32_t* remap);
+// destination must not overlap vertices.
+void RemapVertices(void* destination, const void* vertices, uint32_t vertexCount,
+		uint32_t stride, const uint32_t* remap);
+
+struct SplitVertexData {
+	// Stream 0 holds POSITION0 alone, stream 1 every other kept attribute
+	// interleaved, each aligned to 4 bytes.
+	std::vector<VertexElement> Elements;
+	std::vector<uint8_t> Positions;
+	std::vector<uint8_t> Attributes;
+	uint32_t PositionStride;
+	uint32_t AttributeStride;
+};
+
+// Copies the first vertexCount vertices of streams into a position stream
+// and an attribute stream. used lists the semantics the shaders read;
+// only Usage and UsageIndex matter, and null keeps every attribute.
+// Returns false without a POSITION0 element.
+bool SplitVertexStreams(const VertexStream* streams, const VertexElement* elements,
+		uint32_t elementCount, uint32_t vertexCount, const VertexElement* used,
+		uint32_t usedCount, SplitVertexData& result);
+
+// Index data of a mesh being cooked. Indices are rewritten in place.
+struct MeshBuffers {
+	uint32_t* Indices;
+	uint32_t IndexCount;
+	uint32_t VertexCount;
+	// Null for a single subset covering every index.
+	const MeshSubset* Subsets;
+	uint32_t SubsetCount;
+	// Null skips the overdraw pass and its measurement.
+	const XMFLOAT3* Positions;
+	// Bytes between positions; 0 means tightly packed.
+	uint32_t PositionStride;
+	// Vertex streams, reordered in place by the vertex fetch pass. Without
+	// streams the pass is skipped. Positions may point into one of them;
+	// otherwise it keeps the old order, see MeshCookReport::VertexRemap.
+	const VertexStream* Streams;
+	uint32_t StreamCount;
+};
+
+struct MeshCookSettings {
+	bool OptimizeVertexCache;
+	bool OptimizeOverdraw;
+	bool OptimizeVertexFetch;
+	float OverdrawThreshold;
+	// FIFO size the report is measured with.
+	uint32_t CacheSize;
+	// Side of the overdraw measurement views in pixels; 0 skips it.
+	uint32_t OverdrawResolution;
+
+	MeshCookSettings()
+		: OptimizeVertexCache(true), OptimizeOverdraw(true), OptimizeVertexFetch(true),
+		OverdrawThreshold(1.05f), CacheSize(16), OverdrawResolution(256) {}
+};
+
+struct MeshCookReport {
+	VertexCacheStats CacheBefore;
+	VertexCacheStats CacheAfter;
+	OverdrawStats OverdrawBefore;
+	OverdrawStats OverdrawAfter;
+	// Summed over the streams.
+	VertexFetchStats FetchBefore;
+	VertexFetchStats FetchAfter;
+	// Vertices after the fetch pass; the rest are unreferenced and may be
+	// dropped from the end of every stream.
+	uint32_t ReferencedVertices;
+	// New index of every vertex, empty when the fetch pass did not run.
+	// Apply it with RemapVertices() to any per-vertex data outside the
+	// streams, Positions included.
+	std::vector<uint32_t> VertexRemap;
+};
+
+// Runs the enabled passes over every subset, in parallel with a job
+// system. The result does not depend on the thread count.
+void CookMesh(const MeshBuffers& mesh, const MeshCookSettings& settings,
+		MeshCookReport& report, JobSystem* jobs);
+
+} // namespace Zeus
+
+#endif /* MESHOPTIMIZER_H_ */
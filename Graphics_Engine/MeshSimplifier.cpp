@@ -0,0 +1,748 @@
+/*
+ * MeshSimplifier.cpp
+ *
+ */
+
+#include "MeshSimplifier.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = 0xffffffff;
+// Corners with more wedges than this never collapse.
+const uint32_t MAX_WEDGES = 16;
+// Triangles per chunk of the parallel phase.
+const uint32_t CHUNK_TRIANGLES = 1 << 16;
+// Chunks leave this share of their collapses to the final pass, which
+// orders them by cost across the whole mesh.
+const uint32_t CHUNK_SLACK_SHIFT = 3;
+// Border quadrics outweigh face quadrics so open borders keep their shape.
+const float BORDER_WEIGHT = 10.0f;
+// Collapses may turn a triangle by up to about 84 degrees.
+const float MIN_NORMAL_DOT = 0.1f;
+// Corners evaluated per job.
+const uint32_t EVALUATE_GRAIN = 4096;
+
+// Sum of squared distances to weighted planes. Weight is the summed plane
+// weight, so Evaluate() returns the weighted mean.
+struct Quadric {
+	float A00, A01, A02, A11, A12, A22;
+	float B0, B1, B2;
+	float C;
+	float Weight;
+};
+
+void AddPlane(Quadric& q, const XMFLOAT3& normal, float distance, float weight) {
+	q.A00 += weight * normal.x * normal.x;
+	q.A01 += weight * normal.x * normal.y;
+	q.A02 += weight * normal.x * normal.z;
+	q.A11 += weight * normal.y * normal.y;
+	q.A12 += weight * normal.y * normal.z;
+	q.A22 += weight * normal.z * normal.z;
+	q.B0 += weight * normal.x * distance;
+	q.B1 += weight * normal.y * distance;
+	q.B2 += weight * normal.z * distance;
+	q.C += weight * distance * distance;
+	q.Weight += weight;
+}
+
+void AddQuadric(Quadric& q, const Quadric& other) {
+	q.A00 += other.A00;
+	q.A01 += other.A01;
+	q.A02 += other.A02;
+	q.A11 += other.A11;
+	q.A12 += other.A12;
+	q.A22 += other.A22;
+	q.B0 += other.B0;
+	q.B1 += other.B1;
+	q.B2 += other.B2;
+	q.C += other.C;
+	q.Weight += other.Weight;
+}
+
+float Evaluate(const Quadric& q, const XMFLOAT3& p) {
+	if (q.Weight <= 0.0f)
+		return 0.0f;
+	float r = q.A00 * p.x * p.x + q.A11 * p.y * p.y + q.A22 * p.z * p.z
+			+ 2.0f * (q.A01 * p.x * p.y + q.A02 * p.x * p.z + q.A12 * p.y * p.z)
+			+ 2.0f * (q.B0 * p.x + q.B1 * p.y + q.B2 * p.z) + q.C;
+	return fabsf(r) / q.Weight;
+}
+
+// Plane through point with normal along direction; false when degenerate.
+bool MakePlane(XMVECTOR direction, XMVECTOR point, XMFLOAT3& normal, float& distance) {
+	float length = XMVectorGetX(XMVector3Length(direction));
+	if (length <= 0.0f)
+		return false;
+	XMVECTOR n = XMVectorScale(direction, 1.0f / length);
+	XMStoreFloat3(&normal, n);
+	distance = -XMVectorGetX(XMVector3Dot(n, point));
+	return true;
+}
+
+template <class T>
+const T& Element(const T* data, uint32_t stride, uint32_t index) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data) + (size_t)index * stride;
+	return *reinterpret_cast<const T*>(bytes);
+}
+
+// State shared by every region and level.
+struct Context {
+	// Scaled into the unit cube.
+	std::vector<XMFLOAT3> Positions;
+	// AttributeCount floats per vertex, premultiplied by their weights.
+	std::vector<float> Attributes;
+	uint32_t AttributeCount;
+	// Lowest vertex with the same position; quadrics and flags live there.
+	std::vector<uint32_t> Reps;
+	std::vector<Quadric> Quadrics;
+	// Attribute cost accumulated by the collapses into a corner.
+	std::vector<float> AttributeErrors;
+	// Corners used by several chunks, set while the chunks run.
+	std::vector<uint8_t> Shared;
+	bool LockBorder;
+	float MaxCost;
+};
+
+struct Candidate {
+	float Cost;
+	float AttributeCost;
+	uint32_t Target;
+};
+
+struct WedgePair {
+	uint32_t From;
+	uint32_t To;
+};
+
+// One pass over a region in local vertex numbering.
+struct Pass {
+	const Context* State;
+	// Global vertex of every local vertex.
+	const uint32_t* Vertices;
+	// Local corner of every local vertex.
+	const uint32_t* Reps;
+	const uint32_t* Triangles;
+	// Triangles around every corner.
+	std::vector<uint32_t> FanOffsets;
+	std::vector<uint32_t> Fans;
+
+	const XMFLOAT3& Position(uint32_t local) const {
+		return State->Positions[Vertices[local]];
+	}
+
+	uint32_t Global(uint32_t corner) const {
+		return State->Reps[Vertices[corner]];
+	}
+};
+
+// Pairs every wedge of u with the wedge of v it becomes. Fails when a wedge
+// would have no partner or two, which would tear or blend a seam.
+bool MapWedges(const Pass& pass, uint32_t u, uint32_t v, WedgePair* pairs,
+		uint32_t& pairCount) {
+	pairCount = 0;
+	for (uint32_t i = pass.FanOffsets[u]; i < pass.FanOffsets[u + 1]; ++i) {
+		const uint32_t* triangle = &pass.Triangles[pass.Fans[i] * 3];
+		uint32_t from = NONE;
+		uint32_t to = NONE;
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (pass.Reps[triangle[k]] == u)
+				from = triangle[k];
+			else if (pass.Reps[triangle[k]] == v)
+				to = triangle[k];
+		}
+		if (to == NONE)
+			continue;
+		uint32_t j = 0;
+		while (j < pairCount && pairs[j].From != from)
+			++j;
+		if (j < pairCount) {
+			if (pairs[j].To != to)
+				return false;
+		} else {
+			if (pairCount == MAX_WEDGES)
+				return false;
+			pairs[pairCount].From = from;
+			pairs[pairCount].To = to;
+			++pairCount;
+		}
+	}
+	for (uint32_t i = pass.FanOffsets[u]; i < pass.FanOffsets[u + 1]; ++i) {
+		const uint32_t* triangle = &pass.Triangles[pass.Fans[i] * 3];
+		uint32_t from = pass.Reps[triangle[0]] == u ? triangle[0]
+				: pass.Reps[triangle[1]] == u ? triangle[1] : triangle[2];
+		uint32_t j = 0;
+		while (j < pairCount && pairs[j].From != from)
+			++j;
+		if (j == pairCount)
+			return false;
+	}
+	return true;
+}
+
+// False when moving u onto v flips or folds a remaining triangle.
+bool PreservesOrientation(const Pass& pass, uint32_t u, uint32_t v) {
+	XMVECTOR target = XMLoadFloat3(&pass.Position(v));
+	for (uint32_t i = pass.FanOffsets[u]; i < pass.FanOffsets[u + 1]; ++i) {
+		const uint32_t* triangle = &pass.Triangles[pass.Fans[i] * 3];
+		XMVECTOR before[3];
+		XMVECTOR after[3];
+		bool removed = false;
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t corner = pass.Reps[triangle[k]];
+			removed = removed || corner == v;
+			before[k] = XMLoadFloat3(&pass.Position(triangle[k]));
+			after[k] = corner == u ? target : before[k];
+		}
+		if (removed)
+			continue;
+		XMVECTOR n0 = XMVector3Cross(XMVectorSubtract(before[1], before[0]),
+				XMVectorSubtract(before[2], before[0]));
+		XMVECTOR n1 = XMVector3Cross(XMVectorSubtract(after[1], after[0]),
+				XMVectorSubtract(after[2], after[0]));
+		float d = XMVectorGetX(XMVector3Dot(n0, n1));
+		float lengths = XMVectorGetX(XMVector3Length(n0)) * XMVectorGetX(XMVector3Length(n1));
+		if (d <= MIN_NORMAL_DOT * lengths)
+			return false;
+	}
+	return true;
+}
+
+float AttributeCost(const Context& context, const Pass& pass, const WedgePair* pairs,
+		uint32_t pairCount) {
+	float cost = 0.0f;
+	if (context.AttributeCount == 0)
+		return cost;
+	for (uint32_t i = 0; i < pairCount; ++i) {
+		const float* a = &context.Attributes[(size_t)pass.Vertices[pairs[i].From]
+			* context.AttributeCount];
+		const float* b = &context.Attributes[(size_t)pass.Vertices[pairs[i].To]
+			* context.AttributeCount];
+		float sum = 0.0f;
+		for (uint32_t k = 0; k < context.AttributeCount; ++k)
+			sum += (a[k] - b[k]) * (a[k] - b[k]);
+		cost = std::max(cost, sum);
+	}
+	return cost;
+}
+
+struct EvaluateScratch {
+	std::vector<uint32_t> Neighbors;
+	std::vector<uint32_t> EdgeCounts;
+	std::vector<Candidate> Options;
+};
+
+// Cheapest allowed collapse of corner u, or Target NONE.
+Candidate EvaluateCorner(const Context& context, const Pass& pass, uint32_t u,
+		EvaluateScratch& scratch) {
+	Candidate best = { 0.0f, 0.0f, NONE };
+	uint32_t global = pass.Global(u);
+	if (context.Shared[global])
+		return best;
+
+	// Wedges first: poles and other corners with many wedges bail out here
+	// instead of searching their long neighbor lists.
+	uint32_t wedges[MAX_WEDGES];
+	uint32_t wedgeCount = 0;
+	for (uint32_t i = pass.FanOffsets[u]; i < pass.FanOffsets[u + 1]; ++i) {
+		const uint32_t* triangle = &pass.Triangles[pass.Fans[i] * 3];
+		uint32_t wedge = pass.Reps[triangle[0]] == u ? triangle[0]
+				: pass.Reps[triangle[1]] == u ? triangle[1] : triangle[2];
+		if (std::find(wedges, wedges + wedgeCount, wedge) == wedges + wedgeCount) {
+			if (wedgeCount == MAX_WEDGES)
+				return best;
+			wedges[wedgeCount++] = wedge;
+		}
+	}
+
+	// Neighbor corners and how many triangles share each edge.
+	std::vector<uint32_t>& neighbors = scratch.Neighbors;
+	std::vector<uint32_t>& edgeCounts = scratch.EdgeCounts;
+	neighbors.clear();
+	edgeCounts.clear();
+	for (uint32_t i = pass.FanOffsets[u]; i < pass.FanOffsets[u + 1]; ++i) {
+		const uint32_t* triangle = &pass.Triangles[pass.Fans[i] * 3];
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t corner = pass.Reps[triangle[k]];
+			if (corner == u)
+				continue;
+			size_t j = std::find(neighbors.begin(), neighbors.end(), corner) - neighbors.begin();
+			if (j == neighbors.size()) {
+				neighbors.push_back(corner);
+				edgeCounts.push_back(0);
+			}
+			++edgeCounts[j];
+		}
+	}
+	bool border = false;
+	for (size_t j = 0; j < edgeCounts.size(); ++j) {
+		if (edgeCounts[j] > 2)
+			return best;
+		border = border || edgeCounts[j] == 1;
+	}
+	if (border && context.LockBorder)
+		return best;
+
+	// Orientation checks are the expensive part, so they run on the options
+	// cheapest first until one passes.
+	WedgePair pairs[MAX_WEDGES];
+	uint32_t pairCount;
+	const Quadric& quadric = context.Quadrics[global];
+	float accumulated = context.AttributeErrors[global];
+	scratch.Options.clear();
+	for (size_t j = 0; j < neighbors.size(); ++j) {
+		uint32_t v = neighbors[j];
+		// Border corners only slide along the border.
+		if ((border && edgeCounts[j] != 1) || context.Shared[pass.Global(v)])
+			continue;
+		float cost = Evaluate(quadric, pass.Position(v));
+		if (cost > context.MaxCost || !MapWedges(pass, u, v, pairs, pairCount))
+			continue;
+		Candidate option;
+		option.AttributeCost = accumulated + AttributeCost(context, pass, pairs, pairCount);
+		option.Cost = cost + option.AttributeCost;
+		option.Target = v;
+		if (option.Cost <= context.MaxCost)
+			scratch.Options.push_back(option);
+	}
+	while (!scratch.Options.empty()) {
+		std::vector<Candidate>::iterator cheapest = std::min_element(scratch.Options.begin(),
+				scratch.Options.end(), [](const Candidate& a, const Candidate& b) {
+					return a.Cost < b.Cost;
+				});
+		if (PreservesOrientation(pass, u, cheapest->Target))
+			return *cheapest;
+		scratch.Options.erase(cheapest);
+	}
+	return best;
+}
+
+// Collapses corners of triangles (global vertices, rewritten in place)
+// until at most targetTriangles remain or every collapse costs too much.
+// Returns the largest cost applied.
+float SimplifyRegion(Context& context, std::vector<uint32_t>& triangles,
+		uint32_t targetTriangles, JobSystem* jobs, SimplifyHistory* history) {
+	// Local numbering keeps the per-pass arrays proportional to the region.
+	std::vector<uint32_t> vertices(triangles);
+	std::sort(vertices.begin(), vertices.end());
+	vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+	uint32_t vertexCount = (uint32_t)vertices.size();
+	std::vector<uint32_t> local(triangles.size());
+	for (size_t i = 0; i < triangles.size(); ++i)
+		local[i] = (uint32_t)(std::lower_bound(vertices.begin(), vertices.end(), triangles[i])
+				- vertices.begin());
+
+	// The local corner of a wedge is its first local vertex at that position.
+	std::vector<uint32_t> reps(vertexCount);
+	{
+		std::vector<uint64_t> keys(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			keys[i] = (uint64_t)context.Reps[vertices[i]] << 32 | i;
+		std::sort(keys.begin(), keys.end());
+		uint32_t corner = NONE;
+		for (uint32_t i = 0; i < vertexCount; ++i) {
+			uint32_t vertex = (uint32_t)keys[i];
+			if (i == 0 || keys[i] >> 32 != keys[i - 1] >> 32)
+				corner = vertex;
+			reps[vertex] = corner;
+		}
+	}
+
+	Pass pass;
+	pass.State = &context;
+	pass.Vertices = vertexCount ? &vertices[0] : nullptr;
+	pass.Reps = vertexCount ? &reps[0] : nullptr;
+
+	std::vector<uint32_t> remap(vertexCount);
+	// Corners whose fan changed in the last pass; the candidates of the
+	// others still hold.
+	std::vector<uint8_t> touched(vertexCount, 1);
+	std::vector<Candidate> candidates(vertexCount);
+	std::vector<SortItem> order;
+	std::vector<SortItem> scratch;
+	float maxCost = 0.0f;
+	for (;;) {
+		// Drop triangles whose corners have merged.
+		size_t write = 0;
+		for (size_t i = 0; i < local.size(); i += 3) {
+			uint32_t a = local[i + 0];
+			uint32_t b = local[i + 1];
+			uint32_t c = local[i + 2];
+			if (reps[a] != reps[b] && reps[b] != reps[c] && reps[c] != reps[a]) {
+				local[write++] = a;
+				local[write++] = b;
+				local[write++] = c;
+			}
+		}
+		local.resize(write);
+		uint32_t triangleCount = (uint32_t)(local.size() / 3);
+		if (triangleCount <= targetTriangles)
+			break;
+		pass.Triangles = &local[0];
+
+		pass.FanOffsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < local.size(); ++i)
+			++pass.FanOffsets[reps[local[i]] + 1];
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			pass.FanOffsets[i + 1] += pass.FanOffsets[i];
+		pass.Fans.resize(local.size());
+		std::vector<uint32_t> cursor(pass.FanOffsets.begin(), pass.FanOffsets.end() - 1);
+		for (size_t i = 0; i < local.size(); ++i)
+			pass.Fans[cursor[reps[local[i]]]++] = (uint32_t)(i / 3);
+
+		ParallelFor(jobs, vertexCount, EVALUATE_GRAIN, [&](uint32_t begin, uint32_t end) {
+			EvaluateScratch scratch;
+			for (uint32_t u = begin; u < end; ++u) {
+				if (!touched[u])
+					continue;
+				if (reps[u] == u && pass.FanOffsets[u] != pass.FanOffsets[u + 1])
+					candidates[u] = EvaluateCorner(context, pass, u, scratch);
+				else
+					candidates[u].Target = NONE;
+			}
+		});
+
+		// Cheapest first; costs are non-negative, so their bits sort as floats.
+		order.clear();
+		for (uint32_t u = 0; u < vertexCount; ++u) {
+			if (candidates[u].Target != NONE) {
+				SortItem item;
+				uint32_t bits;
+				memcpy(&bits, &candidates[u].Cost, sizeof(bits));
+				item.Key = (uint64_t)bits << 32 | u;
+				item.Value = u;
+				item.Reserved = 0;
+				order.push_back(item);
+			}
+		}
+		if (order.empty())
+			break;
+		scratch.resize(order.size());
+		RadixSort(&order[0], &scratch[0], (uint32_t)order.size(), jobs);
+
+		// Collapses touching the fan of an earlier one wait for the next pass,
+		// as their orientation checks saw the fan before it changed.
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), (uint8_t)0);
+		uint32_t remaining = triangleCount;
+		uint32_t collapses = 0;
+		for (size_t i = 0; i < order.size() && remaining > targetTriangles; ++i) {
+			uint32_t u = order[i].Value;
+			const Candidate& candidate = candidates[u];
+			uint32_t v = candidate.Target;
+			if (touched[u] || touched[v])
+				continue;
+			WedgePair pairs[MAX_WEDGES];
+			uint32_t pairCount;
+			MapWedges(pass, u, v, pairs, pairCount);
+			for (uint32_t j = 0; j < pairCount; ++j)
+				remap[pairs[j].From] = pairs[j].To;
+			if (history) {
+				SimplifyCollapse collapse;
+				collapse.FirstPair = (uint32_t)history->From.size();
+				collapse.PairCount = pairCount;
+				collapse.Error = sqrtf(candidate.Cost);
+				history->Collapses.push_back(collapse);
+				for (uint32_t j = 0; j < pairCount; ++j) {
+					history->From.push_back(vertices[pairs[j].From]);
+					history->To.push_back(vertices[pairs[j].To]);
+				}
+			}
+			for (uint32_t j = pass.FanOffsets[u]; j < pass.FanOffsets[u + 1]; ++j) {
+				const uint32_t* triangle = &local[pass.Fans[j] * 3];
+				bool removed = false;
+				for (uint32_t k = 0; k < 3; ++k) {
+					touched[reps[triangle[k]]] = 1;
+					removed = removed || reps[triangle[k]] == v;
+				}
+				remaining -= removed ? 1 : 0;
+			}
+
+			uint32_t from = pass.Global(u);
+			uint32_t to = pass.Global(v);
+			AddQuadric(context.Quadrics[to], context.Quadrics[from]);
+			context.AttributeErrors[to] = std::max(context.AttributeErrors[to],
+					candidate.AttributeCost);
+			maxCost = std::max(maxCost, candidate.Cost);
+			++collapses;
+		}
+		if (collapses == 0)
+			break;
+
+		for (size_t i = 0; i < local.size(); ++i)
+			local[i] = remap[local[i]];
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			reps[i] = reps[remap[i]];
+	}
+
+	triangles.resize(local.size());
+	for (size_t i = 0; i < local.size(); ++i)
+		triangles[i] = vertices[local[i]];
+	return maxCost;
+}
+
+void InitializeContext(Context& context, const SimplifySource& source,
+		const SimplifySettings& settings, JobSystem* jobs) {
+	uint32_t vertexCount = source.VertexCount;
+	uint32_t positionStride = source.PositionStride ? source.PositionStride : sizeof(XMFLOAT3);
+
+	// Positions in units of the largest side of the bounding box.
+	XMVECTOR low = XMVectorReplicate(FLT_MAX);
+	XMVECTOR high = XMVectorReplicate(-FLT_MAX);
+	for (uint32_t i = 0; i < vertexCount; ++i) {
+		XMVECTOR p = XMLoadFloat3(&Element(source.Positions, positionStride, i));
+		low = XMVectorMin(low, p);
+		high = XMVectorMax(high, p);
+	}
+	XMFLOAT3 size;
+	XMStoreFloat3(&size, XMVectorSubtract(high, low));
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+	context.Positions.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; ++i) {
+		XMVECTOR p = XMLoadFloat3(&Element(source.Positions, positionStride, i));
+		XMStoreFloat3(&context.Positions[i], XMVectorScale(XMVectorSubtract(p, low), scale));
+	}
+
+	context.AttributeCount = (source.Normals ? 3 : 0) + (source.TexCoords ? 2 : 0)
+			+ (source.Colors ? 4 : 0);
+	context.Attributes.resize((size_t)vertexCount * context.AttributeCount);
+	for (uint32_t i = 0; i < vertexCount; ++i) {
+		float* attributes = context.AttributeCount
+				? &context.Attributes[(size_t)i * context.AttributeCount] : nullptr;
+		if (source.Normals) {
+			uint32_t stride = source.NormalStride ? source.NormalStride : sizeof(XMFLOAT3);
+			const XMFLOAT3& n = Element(source.Normals, stride, i);
+			*attributes++ = n.x * settings.NormalWeight;
+			*attributes++ = n.y * settings.NormalWeight;
+			*attributes++ = n.z * settings.NormalWeight;
+		}
+		if (source.TexCoords) {
+			uint32_t stride = source.TexCoordStride ? source.TexCoordStride : sizeof(XMFLOAT2);
+			const XMFLOAT2& t = Element(source.TexCoords, stride, i);
+			*attributes++ = t.x * settings.TexCoordWeight;
+			*attributes++ = t.y * settings.TexCoordWeight;
+		}
+		if (source.Colors) {
+			uint32_t stride = source.ColorStride ? source.ColorStride : sizeof(XMFLOAT4);
+			const XMFLOAT4& c = Element(source.Colors, stride, i);
+			*attributes++ = c.x * settings.ColorWeight;
+			*attributes++ = c.y * settings.ColorWeight;
+			*attributes++ = c.z * settings.ColorWeight;
+			*attributes++ = c.w * settings.ColorWeight;
+		}
+	}
+
+	// Corners: the lowest vertex of every source position, compared bit for
+	// bit so callers can tell wedges apart the same way.
+	context.Reps.resize(vertexCount);
+	{
+		std::vector<uint32_t> byPosition(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			byPosition[i] = i;
+		std::sort(byPosition.begin(), byPosition.end(), [&](uint32_t a, uint32_t b) {
+			int order = memcmp(&Element(source.Positions, positionStride, a),
+					&Element(source.Positions, positionStride, b), sizeof(XMFLOAT3));
+			return order != 0 ? order < 0 : a < b;
+		});
+		uint32_t corner = NONE;
+		for (uint32_t i = 0; i < vertexCount; ++i) {
+			uint32_t vertex = byPosition[i];
+			if (i == 0 || memcmp(&Element(source.Positions, positionStride, vertex),
+					&Element(source.Positions, positionStride, byPosition[i - 1]),
+					sizeof(XMFLOAT3)) != 0) {
+				corner = vertex;
+			}
+			context.Reps[vertex] = corner;
+		}
+	}
+
+	// Face quadrics weighted by area.
+	Quadric zero;
+	memset(&zero, 0, sizeof(zero));
+	context.Quadrics.assign(vertexCount, zero);
+	context.AttributeErrors.assign(vertexCount, 0.0f);
+	context.Shared.assign(vertexCount, 0);
+	uint32_t triangleCount = source.IndexCount / 3;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		const uint32_t* triangle = &source.Indices[t * 3];
+		XMVECTOR p0 = XMLoadFloat3(&context.Positions[triangle[0]]);
+		XMVECTOR p1 = XMLoadFloat3(&context.Positions[triangle[1]]);
+		XMVECTOR p2 = XMLoadFloat3(&context.Positions[triangle[2]]);
+		XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+		XMFLOAT3 normal;
+		float distance;
+		if (MakePlane(cross, p0, normal, distance)) {
+			float area = 0.5f * XMVectorGetX(XMVector3Length(cross));
+			for (uint32_t k = 0; k < 3; ++k)
+				AddPlane(context.Quadrics[context.Reps[triangle[k]]], normal, distance, area);
+		}
+	}
+
+	if (settings.LockBorder || triangleCount == 0)
+		return;
+
+	// Border edges belong to a single triangle. A plane through the edge,
+	// perpendicular to its triangle, keeps the border from drifting sideways.
+	std::vector<SortItem> edges(triangleCount * 3);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+		uint32_t a = context.Reps[source.Indices[i]];
+		uint32_t b = context.Reps[source.Indices[i - i % 3 + (i + 1) % 3]];
+		edges[i].Key = (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+		edges[i].Value = i;
+		edges[i].Reserved = 0;
+	}
+	std::vector<SortItem> scratch(edges.size());
+	RadixSort(&edges[0], &scratch[0], (uint32_t)edges.size(), jobs);
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end].Key == edges[i].Key)
+			++end;
+		uint32_t a = (uint32_t)(edges[i].Key >> 32);
+		uint32_t b = (uint32_t)edges[i].Key;
+		if (end - i == 1 && a != b) {
+			uint32_t corner = edges[i].Value;
+			const uint32_t* triangle = &source.Indices[corner - corner % 3];
+			XMVECTOR p0 = XMLoadFloat3(&context.Positions[triangle[0]]);
+			XMVECTOR p1 = XMLoadFloat3(&context.Positions[triangle[1]]);
+			XMVECTOR p2 = XMLoadFloat3(&context.Positions[triangle[2]]);
+			XMVECTOR face = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			XMVECTOR pa = XMLoadFloat3(&context.Positions[a]);
+			XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&context.Positions[b]), pa);
+			XMFLOAT3 normal;
+			float distance;
+			if (MakePlane(XMVector3Cross(edge, face), pa, normal, distance)) {
+				float weight = BORDER_WEIGHT * XMVectorGetX(XMVector3LengthSq(edge));
+				AddPlane(context.Quadrics[a], normal, distance, weight);
+				AddPlane(context.Quadrics[b], normal, distance, weight);
+			}
+		}
+		i = end;
+	}
+}
+
+uint32_t SpreadBits(uint32_t x) {
+	x &= 0x3ff;
+	x = (x | x << 16) & 0x030000ff;
+	x = (x | x << 8) & 0x0300f00f;
+	x = (x | x << 4) & 0x030c30c3;
+	x = (x | x << 2) & 0x09249249;
+	return x;
+}
+
+// Cuts the triangles into chunks along a Morton curve of their centroids
+// and simplifies every chunk with the corners it shares locked.
+float SimplifyChunks(Context& context, std::vector<uint32_t>& triangles,
+		uint32_t targetTriangles, JobSystem* jobs, SimplifyHistory* history) {
+	uint32_t triangleCount = (uint32_t)(triangles.size() / 3);
+	std::vector<SortItem> order(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		XMVECTOR centroid = XMVectorZero();
+		for (uint32_t k = 0; k < 3; ++k)
+			centroid = XMVectorAdd(centroid,
+					XMLoadFloat3(&context.Positions[triangles[t * 3 + k]]));
+		XMFLOAT3 c;
+		XMStoreFloat3(&c, XMVectorScale(centroid, 1023.0f / 3.0f));
+		order[t].Key = SpreadBits((uint32_t)c.x) | SpreadBits((uint32_t)c.y) << 1
+				| SpreadBits((uint32_t)c.z) << 2;
+		order[t].Value = t;
+		order[t].Reserved = 0;
+	}
+	std::vector<SortItem> scratch(triangleCount);
+	RadixSort(&order[0], &scratch[0], triangleCount, jobs);
+
+	uint32_t chunkCount = (triangleCount + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES;
+	std::vector<std::vector<uint32_t> > chunks(chunkCount);
+	std::vector<uint32_t> owners(context.Reps.size(), NONE);
+	for (uint32_t c = 0; c < chunkCount; ++c) {
+		uint32_t end = std::min(triangleCount, (c + 1) * CHUNK_TRIANGLES);
+		for (uint32_t i = c * CHUNK_TRIANGLES; i < end; ++i) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t vertex = triangles[order[i].Value * 3 + k];
+				uint32_t corner = context.Reps[vertex];
+				if (owners[corner] == NONE)
+					owners[corner] = c;
+				else if (owners[corner] != c)
+					context.Shared[corner] = 1;
+				chunks[c].push_back(vertex);
+			}
+		}
+	}
+
+	// Chunks stop a little short of their share of the target, so flat
+	// chunks do not have to stop early while curved ones go too far. Each
+	// writes only the quadrics of corners it owns alone.
+	std::vector<float> costs(chunkCount);
+	std::vector<SimplifyHistory> histories(history ? chunkCount : 0);
+	ParallelFor(jobs, chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t c = begin; c < end; ++c) {
+			uint32_t chunkTriangles = (uint32_t)(chunks[c].size() / 3);
+			uint32_t share = (uint32_t)((uint64_t)chunkTriangles * targetTriangles
+					/ triangleCount);
+			share += (chunkTriangles - share) >> CHUNK_SLACK_SHIFT;
+			costs[c] = SimplifyRegion(context, chunks[c], share, nullptr,
+					history ? &histories[c] : nullptr);
+		}
+	});
+
+	triangles.clear();
+	float maxCost = 0.0f;
+	for (uint32_t c = 0; c < chunkCount; ++c) {
+		triangles.insert(triangles.end(), chunks[c].begin(), chunks[c].end());
+		maxCost = std::max(maxCost, costs[c]);
+	}
+	// Chunks share no collapsing corners, so their histories replay in order.
+	for (uint32_t c = 0; c < (uint32_t)histories.size(); ++c) {
+		uint32_t base = (uint32_t)history->From.size();
+		for (size_t i = 0; i < histories[c].Collapses.size(); ++i) {
+			SimplifyCollapse collapse = histories[c].Collapses[i];
+			collapse.FirstPair += base;
+			history->Collapses.push_back(collapse);
+		}
+		history->From.insert(history->From.end(), histories[c].From.begin(),
+				histories[c].From.end());
+		history->To.insert(history->To.end(), histories[c].To.begin(), histories[c].To.end());
+	}
+	std::fill(context.Shared.begin(), context.Shared.end(), (uint8_t)0);
+	return maxCost;
+}
+
+} // namespace
+
+void BuildLodChain(const SimplifySource& source, const SimplifySettings& settings,
+		const uint32_t* targetTriangles, uint32_t levelCount, std::vector<SimplifyLod>& levels,
+		JobSystem* jobs, SimplifyHistory* history) {
+	Context context;
+	InitializeContext(context, source, settings, jobs);
+	context.LockBorder = settings.LockBorder;
+	context.MaxCost = settings.MaxError * settings.MaxError;
+
+	if (history) {
+		history->Collapses.clear();
+		history->From.clear();
+		history->To.clear();
+	}
+
+	std::vector<uint32_t> triangles(source.Indices, source.Indices + source.IndexCount / 3 * 3);
+	float maxCost = 0.0f;
+	levels.resize(levelCount);
+	for (uint32_t i = 0; i < levelCount; ++i) {
+		uint32_t target = targetTriangles[i];
+		if (triangles.size() / 3 > CHUNK_TRIANGLES && triangles.size() / 3 > target)
+			maxCost = std::max(maxCost, SimplifyChunks(context, triangles, target, jobs, history));
+		maxCost = std::max(maxCost, SimplifyRegion(context, triangles, target, jobs, history));
+		levels[i].Indices = triangles;
+		levels[i].Error = sqrtf(maxCost);
+	}
+}
+
+} // namespace Zeus
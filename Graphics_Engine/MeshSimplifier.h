@@ -0,0 +1,119 @@
+/*
+ * MeshSimplifier.h
+ *
+ * Quadric error simplification replacing D3DXSimplifyMesh. Needs no
+ * adjacency input and builds whole LOD chains in one run.
+ *
+ * Every collapse moves a vertex onto a neighbor (a half-edge collapse),
+ * so levels index the original vertex buffer and share it. The cost is
+ * Garland and Heckbert's plane quadric, area weighted and measured in
+ * units of the mesh extent, plus the weighted squared change of the
+ * normals, texture coordinates and colors the collapse causes. Open
+ * borders are held by extra quadrics along them, or locked outright.
+ *
+ * Vertices that share a position are wedges of one corner. Texture and
+ * normal seams between wedges survive: a corner collapses only when every
+ * wedge has a matching wedge on the other end, so both sides of a seam
+ * move together, and corners on a border or seam only slide along it.
+ * Exact duplicate vertices also count as wedges, so weld them first.
+ *
+ * Levels above 64K triangles are cut into spatially coherent chunks along
+ * a Morton curve and simplified in parallel. Corners used by several
+ * chunks stay locked while the chunks run, so the chunks agree on their
+ * borders; a final pass over the joined mesh then unlocks them and makes
+ * the last, cheapest collapses in cost order. Chunking depends only on
+ * the mesh, so the result is the same for any thread count.
+ *
+ * MaxError bounds the attribute error as well as the distance. On curved
+ * meshes with normals the normal change between neighbors, not the
+ * distance, is usually what ends a chain early.
+ */
+
+#ifndef MESHSIMPLIFIER_H_
+#define MESHSIMPLIFIER_H_
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Attribute streams are optional; null leaves them out of the error.
+// Strides of 0 mean tightly packed.
+struct SimplifySource {
+	const uint32_t* Indices;
+	uint32_t IndexCount;
+	const XMFLOAT3* Positions;
+	uint32_t PositionStride;
+	uint32_t VertexCount;
+	const XMFLOAT3* Normals;
+	uint32_t NormalStride;
+	const XMFLOAT2* TexCoords;
+	uint32_t TexCoordStride;
+	const XMFLOAT4* Colors;
+	uint32_t ColorStride;
+};
+
+struct SimplifySettings {
+	// Collapses stop once the error, relative to the largest side of the
+	// bounding box, would exceed this.
+	float MaxError;
+	float NormalWeight;
+	float TexCoordWeight;
+	float ColorWeight;
+	// Open borders never move.
+	bool LockBorder;
+
+	SimplifySettings()
+		: MaxError(0.01f), NormalWeight(0.5f), TexCoordWeight(1.0f), ColorWeight(0.5f),
+		LockBorder(false) {}
+};
+
+struct SimplifyLod {
+	std::vector<uint32_t> Indices;
+	// Largest error of a collapse so far, relative to the extent.
+	float Error;
+};
+
+// Collapse i moved vertex From[Collapses[i].FirstPair + k] onto
+// To[Collapses[i].FirstPair + k] for every k below PairCount, one pair per
+// wedge.
+struct SimplifyCollapse {
+	uint32_t FirstPair;
+	uint32_t PairCount;
+	// Error around the collapsed corner once the collapse is done, relative
+	// to the extent: the quadric cost, which spans every collapse merged
+	// into the corner, plus the attribute error the corner already carried.
+	float Error;
+};
+
+// Every collapse, in an order they can be replayed in.
+struct SimplifyHistory {
+	std::vector<SimplifyCollapse> Collapses;
+	std::vector<uint32_t> From;
+	std::vector<uint32_t> To;
+};
+
+// Simplifies towards targetTriangles[i] for each level in turn, every
+// level continuing from the previous one with its quadrics. Targets should
+// decrease. Levels stop early at MaxError and then repeat the last result.
+// history, when given, receives every collapse.
+void BuildLodChain(const SimplifySource& source, const SimplifySettings& settings,
+		const uint32_t* targetTriangles, uint32_t levelCount, std::vector<SimplifyLod>& levels,
+		JobSystem* jobs, SimplifyHistory* history = nullptr);
+
+inline void Simplify(const SimplifySource& source, const SimplifySettings& settings,
+		uint32_t targetTriangles, SimplifyLod& result, JobSystem* jobs,
+		SimplifyHistory* history = nullptr) {
+	std::vector<SimplifyLod> levels;
+	BuildLodChain(source, settings, &targetTriangles, 1, levels, jobs, history);
+	result = levels[0];
+}
+
+} // namespace Zeus
+
+#endif /* MESHSIMPLIFIER_H_ */
@@ -0,0 +1,185 @@
+/*
+ * MeshTopology.cpp
+ *
+ */
+
+#include "MeshTopology.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = TOPOLOGY_NONE;
+// Triangles, half-edges or points per job.
+const uint32_t TOPOLOGY_GRAIN = 4096;
+
+uint32_t NextCorner(uint32_t corner) {
+	return corner % 3 == 2 ? corner - 2 : corner + 1;
+}
+
+uint32_t PreviousCorner(uint32_t corner) {
+	return corner % 3 == 0 ? corner + 2 : corner - 1;
+}
+
+// Joins the lists the jobs gathered, in job order.
+void JoinLists(const std::vector<std::vector<uint32_t> >& lists, std::vector<uint32_t>& result) {
+	result.clear();
+	for (size_t i = 0; i < lists.size(); ++i)
+		result.insert(result.end(), lists[i].begin(), lists[i].end());
+}
+
+} // namespace
+
+void BuildMeshTopology(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount,
+		const uint32_t* pointReps, MeshTopology& result, JobSystem* jobs) {
+	const uint32_t triangleCount = indexCount / 3;
+	const uint32_t cornerCount = triangleCount * 3;
+	std::vector<uint32_t> points(cornerCount);
+	std::vector<SortItem> edges(cornerCount);
+	std::vector<uint8_t> degenerate(triangleCount);
+
+	// Degenerate half-edges sort behind every real edge.
+	const uint64_t DEGENERATE_KEY = (uint64_t)vertexCount << 32;
+	uint32_t triangleChunks = (triangleCount + TOPOLOGY_GRAIN - 1) / TOPOLOGY_GRAIN;
+	std::vector<std::vector<uint32_t> > degenerateLists(triangleChunks);
+	ParallelFor(jobs, triangleCount, TOPOLOGY_GRAIN, [&](uint32_t begin, uint32_t end) {
+		std::vector<uint32_t>& list = degenerateLists[begin / TOPOLOGY_GRAIN];
+		for (uint32_t t = begin; t < end; ++t) {
+			uint32_t* point = &points[t * 3];
+			for (uint32_t k = 0; k < 3; ++k)
+				point[k] = pointReps ? pointReps[indices[t * 3 + k]] : indices[t * 3 + k];
+			degenerate[t] = point[0] == point[1] || point[1] == point[2] || point[2] == point[0];
+			if (degenerate[t])
+				list.push_back(t);
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t a = point[k];
+				uint32_t b = point[(k + 1) % 3];
+				SortItem& edge = edges[t * 3 + k];
+				edge.Key = degenerate[t] ? DEGENERATE_KEY
+						: (uint64_t)(a < b ? a : b) << 32 | (a < b ? b : a);
+				edge.Value = t * 3 + k;
+				edge.Reserved = 0;
+			}
+		}
+	});
+	JoinLists(degenerateLists, result.DegenerateTriangles);
+	if (cornerCount) {
+		std::vector<SortItem> scratch(cornerCount);
+		RadixSort(&edges[0], &scratch[0], cornerCount, jobs);
+	}
+
+	// Every job resolves the edges whose first half-edge it holds.
+	result.Twins.assign(cornerCount, NONE);
+	uint32_t edgeChunks = (cornerCount + TOPOLOGY_GRAIN - 1) / TOPOLOGY_GRAIN;
+	std::vector<uint32_t> borderCounts(edgeChunks, 0);
+	std::vector<std::vector<uint32_t> > nonManifoldLists(edgeChunks);
+	std::vector<std::vector<uint32_t> > flippedLists(edgeChunks);
+	ParallelFor(jobs, cornerCount, TOPOLOGY_GRAIN, [&](uint32_t begin, uint32_t end) {
+		uint32_t chunk = begin / TOPOLOGY_GRAIN;
+		for (uint32_t i = begin; i < end; ++i) {
+			uint64_t key = edges[i].Key;
+			if (key == DEGENERATE_KEY)
+				break;
+			if (i > 0 && edges[i - 1].Key == key)
+				continue;
+			uint32_t last = i + 1;
+			while (last < cornerCount && edges[last].Key == key)
+				++last;
+			uint32_t h0 = edges[i].Value;
+			if (last - i == 1) {
+				++borderCounts[chunk];
+			} else if (last - i > 2) {
+				for (uint32_t j = i; j < last; ++j)
+					nonManifoldLists[chunk].push_back(edges[j].Value);
+			} else if (points[h0] == points[edges[i + 1].Value]) {
+				flippedLists[chunk].push_back(h0);
+				flippedLists[chunk].push_back(edges[i + 1].Value);
+			} else {
+				uint32_t h1 = edges[i + 1].Value;
+				result.Twins[h0] = h1;
+				result.Twins[h1] = h0;
+			}
+		}
+	});
+	result.BorderEdgeCount = 0;
+	for (uint32_t c = 0; c < edgeChunks; ++c)
+		result.BorderEdgeCount += borderCounts[c];
+	JoinLists(nonManifoldLists, result.NonManifoldEdges);
+	JoinLists(flippedLists, result.FlippedEdges);
+
+	result.Adjacency.resize(cornerCount);
+	ParallelFor(jobs, cornerCount, TOPOLOGY_GRAIN, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t h = begin; h < end; ++h) {
+			uint32_t twin = result.Twins[h];
+			result.Adjacency[h] = twin == NONE ? NONE : twin / 3;
+		}
+	});
+
+	// Corners of every point, in corner order.
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t h = 0; h < cornerCount; ++h) {
+		if (!degenerate[h / 3])
+			++offsets[points[h] + 1];
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> corners(offsets[vertexCount]);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t h = 0; h < cornerCount; ++h) {
+		if (!degenerate[h / 3])
+			corners[fill[points[h]]++] = h;
+	}
+
+	// Walks every fan back to its start and then forward over it. Twins
+	// pair up, so each walk ends on a border or back where it began.
+	result.VertexHalfEdges.assign(vertexCount, NONE);
+	std::vector<uint8_t> visited(cornerCount, 0);
+	uint32_t pointChunks = (vertexCount + TOPOLOGY_GRAIN - 1) / TOPOLOGY_GRAIN;
+	std::vector<std::vector<uint32_t> > bowtieLists(pointChunks);
+	ParallelFor(jobs, vertexCount, TOPOLOGY_GRAIN, [&](uint32_t begin, uint32_t end) {
+		std::vector<uint32_t>& list = bowtieLists[begin / TOPOLOGY_GRAIN];
+		for (uint32_t v = begin; v < end; ++v) {
+			uint32_t fans = 0;
+			bool onBorder = false;
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t corner = corners[i];
+				if (visited[corner])
+					continue;
+				uint32_t start = corner;
+				bool border = false;
+				for (;;) {
+					uint32_t twin = result.Twins[PreviousCorner(start)];
+					if (twin == NONE) {
+						border = true;
+						break;
+					}
+					if (twin == corner)
+						break;
+					start = twin;
+				}
+				for (uint32_t h = start; ; ) {
+					visited[h] = 1;
+					uint32_t twin = result.Twins[h];
+					if (twin == NONE || NextCorner(twin) == start)
+						break;
+					h = NextCorner(twin);
+				}
+				if (fans++ == 0 || (border && !onBorder)) {
+					result.VertexHalfEdges[v] = start;
+					onBorder = border;
+				}
+			}
+			if (fans > 1)
+				list.push_back(v);
+		}
+	});
+	JoinLists(bowtieLists, result.BowtieVertices);
+	if (pointReps) {
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			result.VertexHalfEdges[v] = result.VertexHalfEdges[pointReps[v]];
+	}
+}
+
+} // namespace Zeus
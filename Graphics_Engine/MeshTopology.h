@@ -0,0 +1,71 @@
+/*
+ * MeshTopology.h
+ *
+ * Edge topology of triangle lists: face adjacency as
+ * ID3DXBaseMesh::GenerateAdjacency returns it, half-edge twins, and the
+ * diagnostics D3DXValidMesh and D3DXCleanMesh report.
+ *
+ * Half-edge h is corner h of the index buffer, running from indices[h] to
+ * the next corner of its triangle. Every half-edge is keyed by its two
+ * point representatives, lower first, and the keys are radix sorted, so
+ * the half-edges of one edge land next to each other in corner order in
+ * linear time. An edge of two opposite half-edges is manifold and they
+ * become twins; an edge with one half-edge is a border; two half-edges in
+ * the same direction mean the triangles disagree on winding, and more than
+ * two a non-manifold edge. Such edges get no twins, as D3DX leaves them
+ * unconnected. Triangles with two corners at the same point take no part.
+ *
+ * Around every point the corners are then gathered into fans by walking
+ * the twins. A point whose triangles form more than one fan is a bowtie,
+ * which D3DXCleanMesh splits by duplicating the vertex.
+ *
+ * Keys are built and edges resolved in parallel over triangles, fans in
+ * parallel over points. Diagnostics are gathered per job and joined in
+ * order, so the result never depends on the thread count.
+ */
+
+#ifndef MESHTOPOLOGY_H_
+#define MESHTOPOLOGY_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Missing twin, neighbour or half-edge.
+const uint32_t TOPOLOGY_NONE = 0xffffffff;
+
+struct MeshTopology {
+	// Triangle across each edge of every triangle, like D3DX adjacency.
+	// Edge k runs from corner k to corner k + 1.
+	std::vector<uint32_t> Adjacency;
+	// Opposite half-edge of every half-edge.
+	std::vector<uint32_t> Twins;
+	// One half-edge leaving every vertex's point; on a border it is the
+	// first of its fan. TOPOLOGY_NONE for unreferenced vertices.
+	std::vector<uint32_t> VertexHalfEdges;
+	uint32_t BorderEdgeCount;
+	// Half-edges of edges shared by more than two triangles, grouped by
+	// edge.
+	std::vector<uint32_t> NonManifoldEdges;
+	// Half-edges of edges whose two triangles wind the same way, in pairs.
+	std::vector<uint32_t> FlippedEdges;
+	// Point representatives whose triangles form more than one fan.
+	std::vector<uint32_t> BowtieVertices;
+	std::vector<uint32_t> DegenerateTriangles;
+
+	bool IsManifold() const {
+		return NonManifoldEdges.empty() && FlippedEdges.empty() && BowtieVertices.empty();
+	}
+};
+
+// pointReps maps every vertex to the lowest vertex at its point, as from
+// WeldVertices(); without it vertices connect by index alone.
+void BuildMeshTopology(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount,
+		const uint32_t* pointReps, MeshTopology& result, JobSystem* jobs);
+
+} // namespace Zeus
+
+#endif /* MESHTOPOLOGY_H_ */
@@ -0,0 +1,381 @@
+/*
+ * Meshlet.cpp
+ *
+ */
+
+#include "Meshlet.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = 0xffffffff;
+// Cones wider than acos(0.1), about 84 degrees, never cull anything.
+const float MIN_CONE_SPREAD = 0.1f;
+const float PADDING_RADIUS = -1e30f;
+
+XMVECTOR LoadPosition(const XMFLOAT3* positions, uint32_t stride, uint32_t index) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions) + (size_t)index * stride;
+	return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bytes));
+}
+
+// Meshlet being grown.
+struct Builder {
+	std::vector<uint32_t> Vertices;
+	std::vector<uint32_t> Triangles;
+	XMFLOAT3 CentroidSum;
+	XMFLOAT3 NormalSum;
+
+	void Clear() {
+		Vertices.clear();
+		Triangles.clear();
+		CentroidSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		NormalSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+};
+
+void FinishMeshlet(const uint32_t* triangles, const XMFLOAT3* positions, uint32_t stride,
+		const XMFLOAT3* normals, MeshletMesh& mesh, uint32_t index) {
+	Meshlet& meshlet = mesh.Meshlets[index];
+	uint32_t* vertices = &mesh.Vertices[meshlet.FirstVertex];
+	uint8_t* local = &mesh.Triangles[meshlet.FirstTriangle * 3];
+
+	// Cache order inside the meshlet, then vertices in order of first use.
+	std::vector<uint32_t> order(local, local + meshlet.TriangleCount * 3);
+	OptimizeVertexCache(&order[0], &order[0], (uint32_t)order.size(), meshlet.VertexCount);
+	std::vector<uint32_t> remap(meshlet.VertexCount, NONE);
+	std::vector<uint32_t> renumbered(meshlet.VertexCount);
+	uint32_t next = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if (remap[order[i]] == NONE) {
+			remap[order[i]] = next;
+			renumbered[next++] = vertices[order[i]];
+		}
+		local[i] = (uint8_t)remap[order[i]];
+	}
+	std::copy(renumbered.begin(), renumbered.end(), vertices);
+
+	// Sphere around the box center.
+	XMVECTOR low = LoadPosition(positions, stride, vertices[0]);
+	XMVECTOR high = low;
+	for (uint32_t i = 1; i < meshlet.VertexCount; ++i) {
+		XMVECTOR p = LoadPosition(positions, stride, vertices[i]);
+		low = XMVectorMin(low, p);
+		high = XMVectorMax(high, p);
+	}
+	XMVECTOR center = XMVectorScale(XMVectorAdd(low, high), 0.5f);
+	XMVECTOR radius = XMVectorZero();
+	for (uint32_t i = 0; i < meshlet.VertexCount; ++i) {
+		XMVECTOR p = LoadPosition(positions, stride, vertices[i]);
+		radius = XMVectorMax(radius, XMVector3LengthSq(XMVectorSubtract(p, center)));
+	}
+	MeshletBounds& bounds = mesh.Bounds[index];
+	XMStoreFloat3(&bounds.Center, center);
+	bounds.Radius = sqrtf(XMVectorGetX(radius));
+
+	// Cone around the average normal, as wide as the furthest normal.
+	XMVECTOR axis = XMVectorZero();
+	for (uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+		axis = XMVectorAdd(axis, XMLoadFloat3(&normals[triangles[t]]));
+	bounds.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.ConeCutoff = 1.0f;
+	if (XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f)
+		return;
+	axis = XMVector3Normalize(axis);
+	float spread = 1.0f;
+	for (uint32_t t = 0; t < meshlet.TriangleCount; ++t) {
+		XMVECTOR normal = XMLoadFloat3(&normals[triangles[t]]);
+		// Degenerate triangles have no normal and face every way.
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+			spread = std::min(spread, XMVectorGetX(XMVector3Dot(normal, axis)));
+	}
+	XMStoreFloat3(&bounds.ConeAxis, axis);
+	if (spread > MIN_CONE_SPREAD)
+		bounds.ConeCutoff = sqrtf(1.0f - spread * spread);
+}
+
+} // namespace
+
+void BuildMeshlets(const uint32_t* indices, uint32_t indexCount, const XMFLOAT3* positions,
+		uint32_t positionStride, uint32_t vertexCount, const MeshletSettings& settings,
+		MeshletMesh& result, JobSystem* jobs) {
+	result.Meshlets.clear();
+	result.Bounds.clear();
+	result.Vertices.clear();
+	result.Triangles.clear();
+	const uint32_t triangleCount = indexCount / 3;
+	const uint32_t stride = positionStride ? positionStride : sizeof(XMFLOAT3);
+	const uint32_t maxVertices = std::min(std::max(settings.MaxVertices, 3u), 256u);
+	const uint32_t maxTriangles = std::max(settings.MaxTriangles, 1u);
+	if (triangleCount == 0)
+		return;
+
+	// Centroids and unit normals, and the radius a full meshlet of average
+	// triangles would have, which scales the distance term.
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	std::vector<XMFLOAT3> normals(triangleCount);
+	std::vector<float> areas(triangleCount);
+	ParallelFor(jobs, triangleCount, 4096, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t t = begin; t < end; ++t) {
+			XMVECTOR p0 = LoadPosition(positions, stride, indices[t * 3 + 0]);
+			XMVECTOR p1 = LoadPosition(positions, stride, indices[t * 3 + 1]);
+			XMVECTOR p2 = LoadPosition(positions, stride, indices[t * 3 + 2]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float length = XMVectorGetX(XMVector3Length(n));
+			areas[t] = length * 0.5f;
+			XMStoreFloat3(&normals[t], length > 0.0f ? XMVectorScale(n, 1.0f / length)
+					: XMVectorZero());
+			XMStoreFloat3(&centroids[t], XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2),
+					1.0f / 3.0f));
+		}
+	});
+	double totalArea = 0.0;
+	for (uint32_t t = 0; t < triangleCount; ++t)
+		totalArea += areas[t];
+	const float expectedRadius = std::max(
+			sqrtf((float)(totalArea / triangleCount) * maxTriangles) * 0.5f, 1e-12f);
+
+	// Unused triangles of every vertex, as in OptimizeVertexCache().
+	// Triangles repeating a vertex are dropped.
+	std::vector<bool> used(triangleCount, false);
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		const uint32_t* corner = &indices[t * 3];
+		if (corner[0] == corner[1] || corner[1] == corner[2] || corner[2] == corner[0]) {
+			used[t] = true;
+			continue;
+		}
+		for (uint32_t k = 0; k < 3; ++k)
+			++live[corner[k]];
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<uint32_t> adjacency(offsets[vertexCount]);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (!used[t])
+			for (uint32_t k = 0; k < 3; ++k)
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+	}
+
+	// Meshlet vertex index of every mesh vertex in the current meshlet.
+	std::vector<uint32_t> slot(vertexCount, NONE);
+	std::vector<uint32_t> meshletTriangles;
+	Builder builder;
+	builder.Clear();
+	uint32_t cursor = 0;
+	for (;;) {
+		uint32_t best = NONE;
+		uint32_t bestPriority = 5;
+		float bestScore = 0.0f;
+		if (!builder.Triangles.empty()) {
+			const float inverse = 1.0f / builder.Triangles.size();
+			const XMVECTOR centroid = XMVectorScale(XMLoadFloat3(&builder.CentroidSum), inverse);
+			const XMVECTOR axis = XMVector3Normalize(XMLoadFloat3(&builder.NormalSum));
+			for (size_t i = 0; i < builder.Vertices.size(); ++i) {
+				const uint32_t vertex = builder.Vertices[i];
+				const uint32_t* triangles = &adjacency[offsets[vertex]];
+				for (uint32_t j = 0; j < live[vertex]; ++j) {
+					const uint32_t t = triangles[j];
+					const uint32_t* corner = &indices[t * 3];
+					uint32_t extra = (slot[corner[0]] == NONE) + (slot[corner[1]] == NONE)
+							+ (slot[corner[2]] == NONE);
+					if (builder.Vertices.size() + extra > maxVertices)
+						continue;
+					// Triangles adding no vertex come first, then those last
+					// left at one of their vertices, which a later meshlet
+					// would pay a vertex for alone.
+					uint32_t priority = extra == 0 ? 0 : (live[corner[0]] == 1 ||
+							live[corner[1]] == 1 || live[corner[2]] == 1) ? 1 : extra + 1;
+					if (priority > bestPriority)
+						continue;
+					// Closer and better aligned is better; lower scores win.
+					float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(
+							XMLoadFloat3(&centroids[t]), centroid)));
+					float alignment = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[t]), axis));
+					float score = (1.0f + distance / expectedRadius * (1.0f - settings.ConeWeight))
+							* std::max(1.0f - alignment * settings.ConeWeight, 1e-3f);
+					if (priority < bestPriority || score < bestScore) {
+						best = t;
+						bestPriority = priority;
+						bestScore = score;
+					}
+				}
+			}
+		}
+		if (best == NONE) {
+			while (cursor < triangleCount && used[cursor])
+				++cursor;
+			if (cursor == triangleCount && builder.Triangles.empty())
+				break;
+			if (cursor < triangleCount) {
+				const uint32_t* corner = &indices[cursor * 3];
+				uint32_t extra = (slot[corner[0]] == NONE) + (slot[corner[1]] == NONE)
+						+ (slot[corner[2]] == NONE);
+				if (builder.Vertices.size() + extra <= maxVertices)
+					best = cursor;
+			}
+		}
+
+		if (best != NONE) {
+			const uint32_t* corner = &indices[best * 3];
+			for (uint32_t k = 0; k < 3; ++k) {
+				const uint32_t vertex = corner[k];
+				if (slot[vertex] == NONE) {
+					slot[vertex] = (uint32_t)builder.Vertices.size();
+					builder.Vertices.push_back(vertex);
+				}
+				uint32_t* triangles = &adjacency[offsets[vertex]];
+				uint32_t* end = triangles + live[vertex];
+				*std::find(triangles, end, best) = *(end - 1);
+				--live[vertex];
+			}
+			used[best] = true;
+			builder.Triangles.push_back(best);
+			const XMFLOAT3& c = centroids[best];
+			const XMFLOAT3& n = normals[best];
+			builder.CentroidSum = XMFLOAT3(builder.CentroidSum.x + c.x,
+					builder.CentroidSum.y + c.y, builder.CentroidSum.z + c.z);
+			builder.NormalSum = XMFLOAT3(builder.NormalSum.x + n.x, builder.NormalSum.y + n.y,
+					builder.NormalSum.z + n.z);
+			if (builder.Triangles.size() < maxTriangles)
+				continue;
+		}
+
+		// Full, or nothing else fits: emit the meshlet with local indices.
+		Meshlet meshlet;
+		meshlet.FirstVertex = (uint32_t)result.Vertices.size();
+		meshlet.FirstTriangle = (uint32_t)meshletTriangles.size();
+		meshlet.VertexCount = (uint32_t)builder.Vertices.size();
+		meshlet.TriangleCount = (uint32_t)builder.Triangles.size();
+		result.Meshlets.push_back(meshlet);
+		result.Vertices.insert(result.Vertices.end(), builder.Vertices.begin(),
+				builder.Vertices.end());
+		meshletTriangles.insert(meshletTriangles.end(), builder.Triangles.begin(),
+				builder.Triangles.end());
+		for (size_t i = 0; i < builder.Triangles.size(); ++i)
+			for (uint32_t k = 0; k < 3; ++k)
+				result.Triangles.push_back((uint8_t)slot[indices[builder.Triangles[i] * 3 + k]]);
+		for (size_t i = 0; i < builder.Vertices.size(); ++i)
+			slot[builder.Vertices[i]] = NONE;
+		builder.Clear();
+	}
+
+	const uint32_t meshletCount = (uint32_t)result.Meshlets.size();
+	result.Bounds.resize(meshletCount);
+	ParallelFor(jobs, meshletCount, 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			FinishMeshlet(&meshletTriangles[result.Meshlets[i].FirstTriangle], positions, stride,
+					&normals[0], result, i);
+		}
+	});
+}
+
+MeshletCuller::MeshletCuller() : m_count(0) {
+}
+
+void MeshletCuller::Initialize(const MeshletBounds* bounds, uint32_t count) {
+	m_count = count;
+	m_groups.resize((count + 3) / 4);
+	for (size_t g = 0; g < m_groups.size(); ++g) {
+		Group& group = m_groups[g];
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			const uint32_t index = (uint32_t)g * 4 + lane;
+			MeshletBounds padding = { XMFLOAT3(0.0f, 0.0f, 0.0f), PADDING_RADIUS,
+					XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f };
+			const MeshletBounds& b = index < count ? bounds[index] : padding;
+			(&group.CenterX.x)[lane] = b.Center.x;
+			(&group.CenterY.x)[lane] = b.Center.y;
+			(&group.CenterZ.x)[lane] = b.Center.z;
+			(&group.Radius.x)[lane] = b.Radius;
+			(&group.AxisX.x)[lane] = b.ConeAxis.x;
+			(&group.AxisY.x)[lane] = b.ConeAxis.y;
+			(&group.AxisZ.x)[lane] = b.ConeAxis.z;
+			(&group.Cutoff.x)[lane] = b.ConeCutoff;
+		}
+	}
+}
+
+void MeshletCuller::Cull(CXMMATRIX world, CXMMATRIX viewProjection,
+		const XMFLOAT3& cameraPosition, std::vector<uint32_t>& visible,
+		MeshletCullStats& stats) const {
+	visible.clear();
+	stats.Tested = m_count;
+	stats.FrustumCulled = 0;
+	stats.BackfaceCulled = 0;
+
+	// Object space frustum planes (Gribb and Hartmann) and camera, so the
+	// bounds are tested untransformed.
+	XMMATRIX columns = XMMatrixTranspose(XMMatrixMultiply(world, viewProjection));
+	XMVECTOR planes[6] = {
+		XMVectorAdd(columns.r[3], columns.r[0]),
+		XMVectorSubtract(columns.r[3], columns.r[0]),
+		XMVectorAdd(columns.r[3], columns.r[1]),
+		XMVectorSubtract(columns.r[3], columns.r[1]),
+		columns.r[2],
+		XMVectorSubtract(columns.r[3], columns.r[2])
+	};
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (uint32_t i = 0; i < 6; ++i) {
+		XMVECTOR plane = XMPlaneNormalize(planes[i]);
+		planeX[i] = XMVectorSplatX(plane);
+		planeY[i] = XMVectorSplatY(plane);
+		planeZ[i] = XMVectorSplatZ(plane);
+		planeW[i] = XMVectorSplatW(plane);
+	}
+	XMVECTOR determinant;
+	XMVECTOR camera = XMVector3TransformCoord(XMLoadFloat3(&cameraPosition),
+			XMMatrixInverse(&determinant, world));
+	const XMVECTOR cameraX = XMVectorSplatX(camera);
+	const XMVECTOR cameraY = XMVectorSplatY(camera);
+	const XMVECTOR cameraZ = XMVectorSplatZ(camera);
+
+	for (size_t g = 0; g < m_groups.size(); ++g) {
+		const Group& group = m_groups[g];
+		const XMVECTOR centerX = XMLoadFloat4(&group.CenterX);
+		const XMVECTOR centerY = XMLoadFloat4(&group.CenterY);
+		const XMVECTOR centerZ = XMLoadFloat4(&group.CenterZ);
+		const XMVECTOR radius = XMLoadFloat4(&group.Radius);
+		const XMVECTOR negativeRadius = XMVectorNegate(radius);
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (uint32_t i = 0; i < 6; ++i) {
+			XMVECTOR distance = XMVectorMultiplyAdd(planeX[i], centerX, planeW[i]);
+			distance = XMVectorMultiplyAdd(planeY[i], centerY, distance);
+			distance = XMVectorMultiplyAdd(planeZ[i], centerZ, distance);
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, negativeRadius));
+		}
+
+		XMVECTOR viewX = XMVectorSubtract(centerX, cameraX);
+		XMVECTOR viewY = XMVectorSubtract(centerY, cameraY);
+		XMVECTOR viewZ = XMVectorSubtract(centerZ, cameraZ);
+		XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(viewX, viewX,
+				XMVectorMultiplyAdd(viewY, viewY, XMVectorMultiply(viewZ, viewZ))));
+		XMVECTOR facing = XMVectorMultiplyAdd(viewX, XMLoadFloat4(&group.AxisX),
+				XMVectorMultiplyAdd(viewY, XMLoadFloat4(&group.AxisY),
+				XMVectorMultiply(viewZ, XMLoadFloat4(&group.AxisZ))));
+		XMVECTOR limit = XMVectorMultiplyAdd(XMLoadFloat4(&group.Cutoff), length, radius);
+		XMVECTOR back = XMVectorGreaterOrEqual(facing, limit);
+
+		uint32_t outsideLanes[4], backLanes[4];
+		XMStoreInt4(outsideLanes, outside);
+		XMStoreInt4(backLanes, back);
+		const uint32_t lanes = std::min(4u, m_count - (uint32_t)g * 4);
+		for (uint32_t lane = 0; lane < lanes; ++lane) {
+			if (outsideLanes[lane])
+				++stats.FrustumCulled;
+			else if (backLanes[lane])
+				++stats.BackfaceCulled;
+			else
+				visible.push_back((uint32_t)g * 4 + lane);
+		}
+	}
+}
+
+} // namespace Zeus
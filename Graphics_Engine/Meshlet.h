@@ -0,0 +1,123 @@
+/*
+ * Meshlet.h
+ *
+ * Splits indexed triangle lists into clusters of up to 64 vertices and 124
+ * triangles with bounds for culling whole clusters, a step the d3dx9mesh.h
+ * pipeline has no equivalent of.
+ *
+ * Meshlets grow greedily over shared edges: the next triangle is a
+ * neighbor that adds no new vertex, then one that is the last left at one
+ * of its vertices, then the neighbor adding the fewest new vertices; ties
+ * go to the one closest to the meshlet and best aligned with its normals,
+ * so clusters stay compact and their backface cones narrow. Once no neighbor is left the meshlet
+ * continues with the next unused triangle in index order, which after
+ * OptimizeVertexCache() is usually nearby. Each finished meshlet has its
+ * triangles reordered for the vertex cache and its vertices numbered in
+ * order of first use.
+ *
+ * On closed meshes the vertex limit binds first: a patch of V vertices with
+ * B of them on its border holds 2V - B - 2 triangles, about 98 for the
+ * most compact 64 vertex patch of a grid, not 124. The default limits fill
+ * meshlets of a finely tessellated sphere to 64 vertices and 92.8
+ * triangles on average.
+ *
+ * Bounds are a sphere and a backface cone. A meshlet is back facing for a
+ * camera at p when dot(Center - p, ConeAxis) >= ConeCutoff * |Center - p|
+ * + Radius; ConeCutoff is 1 when the normals spread too far to ever cull.
+ * MeshletCuller keeps the bounds in groups of four and tests four
+ * meshlets per iteration against the frustum and the cones with XNA Math.
+ */
+
+#ifndef MESHLET_H_
+#define MESHLET_H_
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+struct MeshletSettings {
+	// At most 256 vertices so local indices fit a byte.
+	uint32_t MaxVertices;
+	uint32_t MaxTriangles;
+	// 0 grows by distance only, 1 by normal alignment only.
+	float ConeWeight;
+
+	MeshletSettings() : MaxVertices(64), MaxTriangles(124), ConeWeight(0.25f) {}
+};
+
+struct Meshlet {
+	// Into MeshletMesh::Vertices.
+	uint32_t FirstVertex;
+	// Into MeshletMesh::Triangles, in triangles.
+	uint32_t FirstTriangle;
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+};
+
+struct MeshletBounds {
+	XMFLOAT3 Center;
+	float Radius;
+	// Average outward normal; front faces are clockwise, as in D3D.
+	XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+struct MeshletMesh {
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshletBounds> Bounds;
+	// Mesh vertex of every meshlet vertex.
+	std::vector<uint32_t> Vertices;
+	// Three meshlet vertex indices per triangle.
+	std::vector<uint8_t> Triangles;
+};
+
+// Builds meshlets serially, then optimizes and bounds them in parallel.
+void BuildMeshlets(const uint32_t* indices, uint32_t indexCount, const XMFLOAT3* positions,
+		uint32_t positionStride, uint32_t vertexCount, const MeshletSettings& settings,
+		MeshletMesh& result, JobSystem* jobs);
+
+struct MeshletCullStats {
+	uint32_t Tested;
+	uint32_t FrustumCulled;
+	uint32_t BackfaceCulled;
+};
+
+class MeshletCuller {
+public:
+	MeshletCuller();
+
+	void Initialize(const MeshletBounds* bounds, uint32_t count);
+
+	// Replaces visible with the meshlets that intersect the frustum of
+	// viewProjection and face the camera. The world matrix may scale
+	// uniformly; cone tests ignore non-uniform scale.
+	void Cull(CXMMATRIX world, CXMMATRIX viewProjection, const XMFLOAT3& cameraPosition,
+			std::vector<uint32_t>& visible, MeshletCullStats& stats) const;
+
+private:
+	// Four meshlets; padding lanes have a negative radius and are always
+	// outside.
+	struct Group {
+		XMFLOAT4 CenterX;
+		XMFLOAT4 CenterY;
+		XMFLOAT4 CenterZ;
+		XMFLOAT4 Radius;
+		XMFLOAT4 AxisX;
+		XMFLOAT4 AxisY;
+		XMFLOAT4 AxisZ;
+		XMFLOAT4 Cutoff;
+	};
+
+	std::vector<Group> m_groups;
+	uint32_t m_count;
+};
+
+} // namespace Zeus
+
+#endif /* MESHLET_H_ */
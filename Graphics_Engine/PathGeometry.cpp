@@ -0,0 +1,779 @@
+/*
+ * PathGeometry.cpp
+ *
+ */
+
+#include "PathGeometry.h"
+#include "Hash.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+enum SegmentType {
+	SEGMENT_LINE,
+	SEGMENT_QUADRATIC,
+	SEGMENT_CUBIC
+};
+
+// Scanbeams tessellated by one job.
+const uint32_t BEAM_CHUNK = 64;
+// Rows rasterized by one job.
+const int32_t RASTER_BAND = 16;
+// Curves never split into more lines than this.
+const uint32_t MAX_CURVE_STEPS = 1024;
+// Smallest step a beam advances by when crossings pile up on one height.
+const float MIN_BEAM_STEP = 1.0f / 1024.0f;
+const float PI = 3.14159265f;
+
+PathPoint TransformPoint(const Matrix3x2& m, const PathPoint& p) {
+	return PathPoint(p.x * m.M11 + p.y * m.M21 + m.Dx, p.x * m.M12 + p.y * m.M22 + m.Dy);
+}
+
+void AppendPoint(std::vector<PathPoint>& points, uint32_t first, const PathPoint& point) {
+	if (points.size() > first) {
+		const PathPoint& last = points.back();
+		if (last.x == point.x && last.y == point.y)
+			return;
+	}
+	points.push_back(point);
+}
+
+float Cross(const PathPoint& a, const PathPoint& b, const PathPoint& c) {
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Drops degenerate triangles and winds the rest positively.
+void EmitTriangle(std::vector<PathTriangle>& out, const PathPoint& a, const PathPoint& b,
+		const PathPoint& c) {
+	const float area = Cross(a, b, c);
+	if (area == 0.0f)
+		return;
+	PathTriangle triangle = { { a, area > 0.0f ? b : c, area > 0.0f ? c : b } };
+	out.push_back(triangle);
+}
+
+struct Edge {
+	float X0;
+	float Y0;
+	float Y1;
+	// dx / dy.
+	float Slope;
+	int32_t Winding;
+};
+
+struct ActiveEdge {
+	const Edge* Source;
+	float Top;
+	float Bottom;
+};
+
+bool IsLeftOf(const ActiveEdge& a, const ActiveEdge& b) {
+	return a.Top < b.Top || (a.Top == b.Top && a.Bottom < b.Bottom);
+}
+
+float GetX(const Edge& edge, float y) {
+	return edge.X0 + (y - edge.Y0) * edge.Slope;
+}
+
+// One beam between two vertex heights. No edge starts or ends inside it,
+// but edges may cross; the beam is cut at every crossing so the order of
+// the edges is the same at the top and bottom of each piece.
+void TessellateBeam(std::vector<ActiveEdge>& active, float top, float bottom, FillMode mode,
+		std::vector<PathTriangle>& out) {
+	float y = top;
+	while (y < bottom) {
+		for (size_t i = 0; i < active.size(); ++i) {
+			active[i].Top = GetX(*active[i].Source, y);
+			active[i].Bottom = GetX(*active[i].Source, bottom);
+		}
+		std::sort(active.begin(), active.end(), IsLeftOf);
+		float next = bottom;
+		for (size_t i = 0; i + 1 < active.size(); ++i) {
+			const ActiveEdge& left = active[i];
+			const ActiveEdge& right = active[i + 1];
+			if (left.Bottom <= right.Bottom)
+				continue;
+			float closing = (left.Bottom - left.Top) - (right.Bottom - right.Top);
+			float t = (right.Top - left.Top) / closing;
+			next = std::min(next, y + t * (bottom - y));
+		}
+		next = std::min(bottom, std::max(next, y + MIN_BEAM_STEP));
+
+		int32_t winding = 0;
+		for (size_t i = 0; i + 1 < active.size(); ++i) {
+			winding += active[i].Source->Winding;
+			bool inside = mode == FILL_MODE_WINDING ? winding != 0 : (winding & 1) != 0;
+			if (!inside)
+				continue;
+			const Edge& left = *active[i].Source;
+			const Edge& right = *active[i + 1].Source;
+			PathPoint topLeft(active[i].Top, y);
+			PathPoint topRight(active[i + 1].Top, y);
+			PathPoint bottomLeft(GetX(left, next), next);
+			PathPoint bottomRight(GetX(right, next), next);
+			EmitTriangle(out, topLeft, topRight, bottomRight);
+			EmitTriangle(out, topLeft, bottomRight, bottomLeft);
+		}
+		y = next;
+	}
+}
+
+// Fan around center from the unit direction from, turning by angle
+// radians, with segments no further than tolerance from the arc.
+void EmitArc(std::vector<PathTriangle>& out, const PathPoint& center, const PathPoint& from,
+		float angle, float radius, float tolerance) {
+	const float step = 2.0f * acosf(std::max(0.0f, 1.0f - tolerance / radius));
+	const uint32_t steps = std::min(256u, std::max(1u, (uint32_t)ceilf(fabsf(angle) / step)));
+	const float c = cosf(angle / steps);
+	const float s = sinf(angle / steps);
+	PathPoint direction = from;
+	PathPoint previous(center.x + from.x * radius, center.y + from.y * radius);
+	for (uint32_t i = 0; i < steps; ++i) {
+		direction = PathPoint(direction.x * c - direction.y * s, direction.x * s + direction.y * c);
+		PathPoint next(center.x + direction.x * radius, center.y + direction.y * radius);
+		EmitTriangle(out, center, previous, next);
+		previous = next;
+	}
+}
+
+void EmitCap(std::vector<PathTriangle>& out, PathCap cap, const PathPoint& point,
+		const PathPoint& outward, float halfWidth, float tolerance) {
+	const PathPoint normal(-outward.y, outward.x);
+	const PathPoint left(point.x + normal.x * halfWidth, point.y + normal.y * halfWidth);
+	const PathPoint right(point.x - normal.x * halfWidth, point.y - normal.y * halfWidth);
+	if (cap == PATH_CAP_SQUARE) {
+		const PathPoint extend(outward.x * halfWidth, outward.y * halfWidth);
+		const PathPoint farLeft(left.x + extend.x, left.y + extend.y);
+		const PathPoint farRight(right.x + extend.x, right.y + extend.y);
+		EmitTriangle(out, left, farLeft, farRight);
+		EmitTriangle(out, left, farRight, right);
+	} else if (cap == PATH_CAP_ROUND) {
+		// Half turn from the left side through outward to the right side.
+		EmitArc(out, point, normal, -PI, halfWidth, tolerance);
+	}
+}
+
+void StrokeFigure(const PathPoint* points, uint32_t count, bool closed, const StrokeStyle& style,
+		float halfWidth, float tolerance, std::vector<PathTriangle>& out) {
+	if (count == 1) {
+		// A lone point only shows its caps.
+		const PathPoint right(1.0f, 0.0f), left(-1.0f, 0.0f);
+		if (style.StartCap == PATH_CAP_ROUND || style.EndCap == PATH_CAP_ROUND) {
+			EmitCap(out, PATH_CAP_ROUND, points[0], left, halfWidth, tolerance);
+			EmitCap(out, PATH_CAP_ROUND, points[0], right, halfWidth, tolerance);
+		} else if (style.StartCap == PATH_CAP_SQUARE || style.EndCap == PATH_CAP_SQUARE) {
+			EmitCap(out, PATH_CAP_SQUARE, points[0], left, halfWidth, tolerance);
+			EmitCap(out, PATH_CAP_SQUARE, points[0], right, halfWidth, tolerance);
+		}
+		return;
+	}
+	closed = closed && count > 2;
+	const uint32_t segments = closed ? count : count - 1;
+	std::vector<PathPoint> directions(segments);
+	for (uint32_t i = 0; i < segments; ++i) {
+		const PathPoint& a = points[i];
+		const PathPoint& b = points[(i + 1) % count];
+		float dx = b.x - a.x, dy = b.y - a.y;
+		float length = sqrtf(dx * dx + dy * dy);
+		directions[i] = PathPoint(dx / length, dy / length);
+	}
+
+	for (uint32_t i = 0; i < segments; ++i) {
+		const PathPoint& a = points[i];
+		const PathPoint& b = points[(i + 1) % count];
+		const PathPoint offset(-directions[i].y * halfWidth, directions[i].x * halfWidth);
+		const PathPoint a0(a.x + offset.x, a.y + offset.y), a1(a.x - offset.x, a.y - offset.y);
+		const PathPoint b0(b.x + offset.x, b.y + offset.y), b1(b.x - offset.x, b.y - offset.y);
+		EmitTriangle(out, a0, b0, b1);
+		EmitTriangle(out, a0, b1, a1);
+	}
+
+	const uint32_t firstJoin = closed ? 0 : 1;
+	const uint32_t lastJoin = closed ? count : count - 1;
+	for (uint32_t j = firstJoin; j < lastJoin; ++j) {
+		const PathPoint& point = points[j];
+		const PathPoint& incoming = directions[(j + segments - 1) % segments];
+		const PathPoint& outgoing = directions[j % segments];
+		const float cross = incoming.x * outgoing.y - incoming.y * outgoing.x;
+		const float dot = incoming.x * outgoing.x + incoming.y * outgoing.y;
+		if (cross == 0.0f && dot > 0.0f)
+			continue;
+		// Offsets on the side the two segments open away from.
+		const float side = cross > 0.0f ? -1.0f : 1.0f;
+		const PathPoint n0(-incoming.y * side, incoming.x * side);
+		const PathPoint n1(-outgoing.y * side, outgoing.x * side);
+		const PathPoint p0(point.x + n0.x * halfWidth, point.y + n0.y * halfWidth);
+		const PathPoint p1(point.x + n1.x * halfWidth, point.y + n1.y * halfWidth);
+		if (style.Join == PATH_JOIN_ROUND) {
+			const float angle = atan2f(n0.x * n1.y - n0.y * n1.x, n0.x * n1.x + n0.y * n1.y);
+			EmitArc(out, point, n0, angle, halfWidth, tolerance);
+			continue;
+		}
+		if (style.Join == PATH_JOIN_MITER) {
+			PathPoint miter(n0.x + n1.x, n0.y + n1.y);
+			float length = sqrtf(miter.x * miter.x + miter.y * miter.y);
+			if (length > 1e-6f) {
+				miter = PathPoint(miter.x / length, miter.y / length);
+				float cosine = miter.x * n0.x + miter.y * n0.y;
+				if (cosine * style.MiterLimit >= 1.0f) {
+					float reach = halfWidth / cosine;
+					PathPoint tip(point.x + miter.x * reach, point.y + miter.y * reach);
+					EmitTriangle(out, point, p0, tip);
+					EmitTriangle(out, point, tip, p1);
+					continue;
+				}
+			}
+		}
+		EmitTriangle(out, point, p0, p1);
+	}
+
+	if (!closed) {
+		const PathPoint& first = directions[0];
+		const PathPoint& last = directions[segments - 1];
+		EmitCap(out, style.StartCap, points[0], PathPoint(-first.x, -first.y), halfWidth,
+				tolerance);
+		EmitCap(out, style.EndCap, points[count - 1], last, halfWidth, tolerance);
+	}
+}
+
+// Signed area accumulation after font-rs: every edge adds the area it
+// covers to the cells of its rows, and a running sum along each row
+// gives the winding-weighted coverage of every pixel. x is clamped to
+// [0, width]; area left of the buffer lands in column 0.
+void AccumulateLine(float* cells, uint32_t stride, int32_t rows, float width, PathPoint p0,
+		PathPoint p1) {
+	if (p0.y == p1.y)
+		return;
+	float direction = 1.0f;
+	if (p0.y > p1.y) {
+		std::swap(p0, p1);
+		direction = -1.0f;
+	}
+	if (p1.y <= 0.0f || p0.y >= (float)rows)
+		return;
+	const float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+	float x = p0.x;
+	if (p0.y < 0.0f)
+		x -= p0.y * dxdy;
+	const int32_t first = std::max(0, (int32_t)p0.y);
+	const int32_t last = std::min(rows, (int32_t)ceilf(p1.y));
+	for (int32_t y = first; y < last; ++y) {
+		float* row = cells + y * stride;
+		const float dy = std::min((float)(y + 1), p1.y) - std::max((float)y, p0.y);
+		const float xNext = x + dxdy * dy;
+		const float d = dy * direction;
+		float x0 = std::min(std::max(std::min(x, xNext), 0.0f), width);
+		float x1 = std::min(std::max(std::max(x, xNext), 0.0f), width);
+		const float x0Floor = floorf(x0);
+		const int32_t x0i = (int32_t)x0Floor;
+		const float x1Ceil = ceilf(x1);
+		const int32_t x1i = (int32_t)x1Ceil;
+		if (x1i <= x0i + 1) {
+			const float middle = 0.5f * (x0 + x1) - x0Floor;
+			row[x0i] += d - d * middle;
+			row[x0i + 1] += d * middle;
+		} else {
+			const float s = 1.0f / (x1 - x0);
+			const float x0f = x0 - x0Floor;
+			const float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+			const float x1f = x1 - x1Ceil + 1.0f;
+			const float am = 0.5f * s * x1f * x1f;
+			row[x0i] += d * a0;
+			if (x1i == x0i + 2) {
+				row[x0i + 1] += d * (1.0f - a0 - am);
+			} else {
+				const float a1 = s * (1.5f - x0f);
+				row[x0i + 1] += d * (a1 - a0);
+				for (int32_t xi = x0i + 2; xi < x1i - 1; ++xi)
+					row[xi] += d * s;
+				const float a2 = a1 + (x1i - x0i - 3) * s;
+				row[x1i - 1] += d * (1.0f - a2 - am);
+			}
+			row[x1i] += d * am;
+		}
+		x = xNext;
+	}
+}
+
+} // namespace
+
+PathGeometry::PathGeometry() : m_fillMode(FILL_MODE_ALTERNATE), m_inFigure(false), m_hash(0) {
+	Reset();
+}
+
+void PathGeometry::Reset() {
+	m_figures.clear();
+	m_points.clear();
+	m_segments.clear();
+	m_inFigure = false;
+	m_hash = HASH_SEED;
+}
+
+void PathGeometry::SetFillMode(FillMode mode) {
+	m_fillMode = mode;
+}
+
+uint64_t PathGeometry::GetHash() const {
+	return HashCombine(m_hash, m_fillMode);
+}
+
+bool PathGeometry::IsEqual(const PathGeometry& other) const {
+	if (m_fillMode != other.m_fillMode || m_figures.size() != other.m_figures.size() ||
+			m_points.size() != other.m_points.size() || m_segments != other.m_segments)
+		return false;
+	for (size_t f = 0; f < m_figures.size(); ++f) {
+		const Figure& a = m_figures[f];
+		const Figure& b = other.m_figures[f];
+		if (a.SegmentCount != b.SegmentCount || a.Filled != b.Filled || a.Closed != b.Closed)
+			return false;
+	}
+	// Bytewise, like the hash.
+	return m_points.empty() ||
+			memcmp(&m_points[0], &other.m_points[0], m_points.size() * sizeof(PathPoint)) == 0;
+}
+
+void PathGeometry::BeginFigure(const PathPoint& start, bool filled) {
+	Figure figure;
+	figure.FirstPoint = (uint32_t)m_points.size();
+	figure.FirstSegment = (uint32_t)m_segments.size();
+	figure.SegmentCount = 0;
+	figure.Filled = filled;
+	figure.Closed = false;
+	m_figures.push_back(figure);
+	m_points.push_back(start);
+	m_inFigure = true;
+	m_hash = HashBytes(&start, sizeof(start), HashCombine(m_hash, filled ? 3 : 2));
+}
+
+void PathGeometry::AddSegment(uint8_t type, const PathPoint* points, uint32_t count) {
+	m_segments.push_back(type);
+	m_points.insert(m_points.end(), points, points + count);
+	++m_figures.back().SegmentCount;
+	m_hash = HashBytes(points, count * sizeof(PathPoint), HashCombine(m_hash, type));
+}
+
+void PathGeometry::AddLine(const PathPoint& point) {
+	AddSegment(SEGMENT_LINE, &point, 1);
+}
+
+void PathGeometry::AddLines(const PathPoint* points, uint32_t count) {
+	for (uint32_t i = 0; i < count; ++i)
+		AddSegment(SEGMENT_LINE, &points[i], 1);
+}
+
+void PathGeometry::AddQuadraticBezier(const PathPoint& control, const PathPoint& end) {
+	PathPoint points[2] = { control, end };
+	AddSegment(SEGMENT_QUADRATIC, points, 2);
+}
+
+void PathGeometry::AddBezier(const PathPoint& control1, const PathPoint& control2,
+		const PathPoint& end) {
+	PathPoint points[3] = { control1, control2, end };
+	AddSegment(SEGMENT_CUBIC, points, 3);
+}
+
+void PathGeometry::EndFigure(bool closed) {
+	m_figures.back().Closed = closed;
+	m_inFigure = false;
+	m_hash = HashCombine(m_hash, closed ? 5 : 4);
+}
+
+void PathGeometry::Flatten(const Matrix3x2& transform, float tolerance,
+		std::vector<PathPoint>& points, std::vector<FlatFigure>& figures) const {
+	points.clear();
+	figures.clear();
+	tolerance = std::max(tolerance, 1e-3f);
+	for (size_t f = 0; f < m_figures.size(); ++f) {
+		const Figure& figure = m_figures[f];
+		FlatFigure flat;
+		flat.FirstPoint = (uint32_t)points.size();
+		flat.Filled = figure.Filled;
+		flat.Closed = figure.Closed;
+		uint32_t source = figure.FirstPoint;
+		PathPoint current = TransformPoint(transform, m_points[source++]);
+		points.push_back(current);
+		for (uint32_t s = 0; s < figure.SegmentCount; ++s) {
+			const uint32_t type = m_segments[figure.FirstSegment + s];
+			PathPoint control[4] = { current };
+			for (uint32_t i = 1; i <= type + 1; ++i)
+				control[i] = TransformPoint(transform, m_points[source++]);
+			if (type == SEGMENT_LINE) {
+				AppendPoint(points, flat.FirstPoint, control[1]);
+				current = control[1];
+				continue;
+			}
+			// Wang's formula: n = sqrt(d (d - 1) / 8 * max |second difference|
+			// / tolerance) segments keep a degree d curve within tolerance.
+			float largest = 0.0f;
+			for (uint32_t i = 0; i + 2 <= type + 1; ++i) {
+				float ddx = control[i].x - 2.0f * control[i + 1].x + control[i + 2].x;
+				float ddy = control[i].y - 2.0f * control[i + 1].y + control[i + 2].y;
+				largest = std::max(largest, sqrtf(ddx * ddx + ddy * ddy));
+			}
+			const float degree = (float)(type + 1);
+			const uint32_t steps = std::min(MAX_CURVE_STEPS, std::max(1u, (uint32_t)ceilf(
+					sqrtf(degree * (degree - 1.0f) * 0.125f * largest / tolerance))));
+			for (uint32_t i = 1; i <= steps; ++i) {
+				const float t = (float)i / steps;
+				const float u = 1.0f - t;
+				PathPoint p;
+				if (type == SEGMENT_QUADRATIC) {
+					p.x = u * u * control[0].x + 2.0f * u * t * control[1].x + t * t * control[2].x;
+					p.y = u * u * control[0].y + 2.0f * u * t * control[1].y + t * t * control[2].y;
+				} else {
+					const float a = u * u * u, b = 3.0f * u * u * t, c = 3.0f * u * t * t;
+					const float d = t * t * t;
+					p.x = a * control[0].x + b * control[1].x + c * control[2].x + d * control[3].x;
+					p.y = a * control[0].y + b * control[1].y + c * control[2].y + d * control[3].y;
+				}
+				AppendPoint(points, flat.FirstPoint, i == steps ? control[type + 1] : p);
+			}
+			current = control[type + 1];
+		}
+		flat.PointCount = (uint32_t)points.size() - flat.FirstPoint;
+		if (flat.Closed && flat.PointCount > 1) {
+			const PathPoint& first = points[flat.FirstPoint];
+			if (points.back().x == first.x && points.back().y == first.y) {
+				points.pop_back();
+				--flat.PointCount;
+			}
+		}
+		figures.push_back(flat);
+	}
+}
+
+void PathGeometry::Tessellate(const Matrix3x2& transform, float tolerance,
+		std::vector<PathTriangle>& triangles, JobSystem* jobs) const {
+	triangles.clear();
+	std::vector<PathPoint> points;
+	std::vector<FlatFigure> figures;
+	Flatten(transform, tolerance, points, figures);
+
+	std::vector<Edge> edges;
+	std::vector<float> heights;
+	for (size_t f = 0; f < figures.size(); ++f) {
+		const FlatFigure& figure = figures[f];
+		if (!figure.Filled || figure.PointCount < 3)
+			continue;
+		for (uint32_t i = 0; i < figure.PointCount; ++i) {
+			PathPoint a = points[figure.FirstPoint + i];
+			PathPoint b = points[figure.FirstPoint + (i + 1) % figure.PointCount];
+			heights.push_back(a.y);
+			if (a.y == b.y)
+				continue;
+			Edge edge;
+			edge.Winding = a.y < b.y ? 1 : -1;
+			if (a.y > b.y)
+				std::swap(a, b);
+			edge.X0 = a.x;
+			edge.Y0 = a.y;
+			edge.Y1 = b.y;
+			edge.Slope = (b.x - a.x) / (b.y - a.y);
+			edges.push_back(edge);
+		}
+	}
+	if (edges.empty())
+		return;
+	std::sort(heights.begin(), heights.end());
+	heights.erase(std::unique(heights.begin(), heights.end()), heights.end());
+	struct ByTop {
+		bool operator()(const Edge& a, const Edge& b) const { return a.Y0 < b.Y0; }
+	};
+	std::sort(edges.begin(), edges.end(), ByTop());
+
+	const uint32_t beams = (uint32_t)heights.size() - 1;
+	const uint32_t chunks = (beams + BEAM_CHUNK - 1) / BEAM_CHUNK;
+
+	// One sweep finds the first edge not yet started at the top of every
+	// chunk and the edges still open there, so no chunk rescans the edges
+	// above it. Edges are listed once per chunk top they cross.
+	std::vector<uint32_t> firstEdges(chunks);
+	std::vector<uint32_t> openOffsets(chunks + 1, 0);
+	std::vector<uint32_t> openEdges;
+	for (uint32_t pass = 0; pass < 2; ++pass) {
+		std::vector<uint32_t> fill(openOffsets.begin(), openOffsets.end() - 1);
+		uint32_t chunk = 0;
+		for (uint32_t e = 0; e < (uint32_t)edges.size(); ++e) {
+			for (; chunk < chunks && heights[chunk * BEAM_CHUNK] < edges[e].Y0; ++chunk)
+				firstEdges[chunk] = e;
+			for (uint32_t c = chunk; c < chunks && heights[c * BEAM_CHUNK] < edges[e].Y1; ++c) {
+				if (pass == 0)
+					++openOffsets[c + 1];
+				else
+					openEdges[fill[c]++] = e;
+			}
+		}
+		for (; chunk < chunks; ++chunk)
+			firstEdges[chunk] = (uint32_t)edges.size();
+		if (pass == 0) {
+			for (uint32_t c = 0; c < chunks; ++c)
+				openOffsets[c + 1] += openOffsets[c];
+			openEdges.resize(openOffsets[chunks]);
+		}
+	}
+
+	std::vector<std::vector<PathTriangle> > outputs(chunks);
+	ParallelFor(jobs, chunks, 1, [&](uint32_t begin, uint32_t end) {
+		std::vector<ActiveEdge> active;
+		for (uint32_t chunk = begin; chunk < end; ++chunk) {
+			const uint32_t firstBeam = chunk * BEAM_CHUNK;
+			const uint32_t lastBeam = std::min(beams, firstBeam + BEAM_CHUNK);
+			size_t next = firstEdges[chunk];
+			active.clear();
+			for (uint32_t i = openOffsets[chunk]; i < openOffsets[chunk + 1]; ++i) {
+				ActiveEdge edge = { &edges[openEdges[i]], 0.0f, 0.0f };
+				active.push_back(edge);
+			}
+			for (uint32_t beam = firstBeam; beam < lastBeam; ++beam) {
+				const float top = heights[beam];
+				const float bottom = heights[beam + 1];
+				size_t kept = 0;
+				for (size_t i = 0; i < active.size(); ++i)
+					if (active[i].Source->Y1 > top)
+						active[kept++] = active[i];
+				active.resize(kept);
+				for (; next < edges.size() && edges[next].Y0 <= top; ++next) {
+					ActiveEdge edge = { &edges[next], 0.0f, 0.0f };
+					active.push_back(edge);
+				}
+				TessellateBeam(active, top, bottom, m_fillMode, outputs[chunk]);
+			}
+		}
+	});
+	for (uint32_t i = 0; i < chunks; ++i)
+		triangles.insert(triangles.end(), outputs[i].begin(), outputs[i].end());
+}
+
+void PathGeometry::TessellateStroke(const StrokeStyle& style, const Matrix3x2& transform,
+		float tolerance, std::vector<PathTriangle>& triangles, JobSystem* jobs) const {
+	triangles.clear();
+	std::vector<PathPoint> points;
+	std::vector<FlatFigure> figures;
+	Flatten(transform, tolerance, points, figures);
+	const float scale = sqrtf(fabsf(transform.M11 * transform.M22 - transform.M12 * transform.M21));
+	const float halfWidth = style.Width * 0.5f * scale;
+	if (!(halfWidth > 0.0f) || figures.empty())
+		return;
+	tolerance = std::max(tolerance, 1e-3f);
+
+	std::vector<std::vector<PathTriangle> > outputs(figures.size());
+	ParallelFor(jobs, (uint32_t)figures.size(), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t f = begin; f < end; ++f) {
+			const FlatFigure& figure = figures[f];
+			if (figure.PointCount > 0)
+				StrokeFigure(&points[figure.FirstPoint], figure.PointCount, figure.Closed, style,
+						halfWidth, tolerance, outputs[f]);
+		}
+	});
+	for (size_t i = 0; i < outputs.size(); ++i)
+		triangles.insert(triangles.end(), outputs[i].begin(), outputs[i].end());
+}
+
+void RasterizeTriangles(const PathSurface& target, const ScissorRect& scissor,
+		const PathTriangle* triangles, uint32_t count, const PathPoint& translation,
+		const PathColor& color, JobSystem* jobs) {
+	ScissorRect clip;
+	clip.Left = std::max(0, scissor.Left);
+	clip.Top = std::max(0, scissor.Top);
+	clip.Right = std::min((int32_t)target.Width, scissor.Right);
+	clip.Bottom = std::min((int32_t)target.Height, scissor.Bottom);
+	if (clip.Left >= clip.Right || clip.Top >= clip.Bottom || count == 0 || color.a <= 0.0f)
+		return;
+
+	// Bin triangles into bands of rows.
+	const int32_t bands = (clip.Bottom - clip.Top + RASTER_BAND - 1) / RASTER_BAND;
+	std::vector<uint32_t> offsets(bands + 1, 0);
+	std::vector<int32_t> ranges(count * 2);
+	for (uint32_t i = 0; i < count; ++i) {
+		const PathTriangle& triangle = triangles[i];
+		float top = std::min(std::min(triangle.Points[0].y, triangle.Points[1].y),
+				triangle.Points[2].y) + translation.y;
+		float bottom = std::max(std::max(triangle.Points[0].y, triangle.Points[1].y),
+				triangle.Points[2].y) + translation.y;
+		int32_t first = std::max(0, ((int32_t)floorf(top) - clip.Top) / RASTER_BAND);
+		int32_t last = std::min(bands - 1, ((int32_t)ceilf(bottom) - clip.Top) / RASTER_BAND);
+		if (bottom <= (float)clip.Top || top >= (float)clip.Bottom)
+			last = first - 1;
+		ranges[i * 2] = first;
+		ranges[i * 2 + 1] = last;
+		for (int32_t band = first; band <= last; ++band)
+			++offsets[band + 1];
+	}
+	for (int32_t band = 0; band < bands; ++band)
+		offsets[band + 1] += offsets[band];
+	std::vector<uint32_t> binned(offsets[bands]);
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (uint32_t i = 0; i < count; ++i)
+		for (int32_t band = ranges[i * 2]; band <= ranges[i * 2 + 1]; ++band)
+			binned[cursor[band]++] = i;
+
+	const uint32_t width = clip.Right - clip.Left;
+	const uint32_t stride = width + 2;
+	ParallelFor(jobs, bands, 1, [&](uint32_t begin, uint32_t end) {
+		std::vector<float> cells;
+		for (uint32_t band = begin; band < end; ++band) {
+			const int32_t top = clip.Top + band * RASTER_BAND;
+			const int32_t rows = std::min(RASTER_BAND, clip.Bottom - top);
+			cells.assign(stride * rows, 0.0f);
+			const float dx = translation.x - clip.Left;
+			const float dy = translation.y - top;
+			for (uint32_t k = offsets[band]; k < offsets[band + 1]; ++k) {
+				const PathTriangle& triangle = triangles[binned[k]];
+				PathPoint p[3];
+				for (uint32_t v = 0; v < 3; ++v)
+					p[v] = PathPoint(triangle.Points[v].x + dx, triangle.Points[v].y + dy);
+				for (uint32_t v = 0; v < 3; ++v)
+					AccumulateLine(&cells[0], stride, rows, (float)width, p[v], p[(v + 1) % 3]);
+			}
+			for (int32_t y = 0; y < rows; ++y) {
+				PathColor* row = target.Pixels + (size_t)(top + y) * target.Pitch + clip.Left;
+				const float* cell = &cells[y * stride];
+				float sum = 0.0f;
+				for (uint32_t x = 0; x < width; ++x) {
+					sum += cell[x];
+					const float coverage = std::min(1.0f, fabsf(sum));
+					if (coverage <= 0.0f)
+						continue;
+					// Source over with the alpha scaled by coverage.
+					const float alpha = color.a * coverage;
+					const float keep = 1.0f - alpha;
+					PathColor& pixel = row[x];
+					pixel.r = pixel.r * keep + color.r * alpha;
+					pixel.g = pixel.g * keep + color.g * alpha;
+					pixel.b = pixel.b * keep + color.b * alpha;
+					pixel.a = pixel.a * keep + alpha;
+				}
+			}
+		}
+	});
+}
+
+TessellationCache::TessellationCache() : m_frame(1), m_maxAge(60) {
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_slots.assign(64, 0xffffffff);
+}
+
+TessellationCache::~TessellationCache() {
+	Clear();
+}
+
+void TessellationCache::Clear() {
+	for (size_t i = 0; i < m_entries.size(); ++i)
+		delete m_entries[i];
+	m_entries.clear();
+	m_slots.assign(64, 0xffffffff);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void TessellationCache::BeginFrame() {
+	++m_frame;
+	m_stats.Hits = m_stats.Misses = m_stats.Evicted = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < m_entries.size(); ++i) {
+		Entry* entry = m_entries[i];
+		if (m_frame - entry->LastUsed > m_maxAge) {
+			m_stats.TriangleCount -= (uint32_t)entry->Triangles.size();
+			++m_stats.Evicted;
+			delete entry;
+		} else {
+			m_entries[kept++] = entry;
+		}
+	}
+	if (kept != m_entries.size()) {
+		m_entries.resize(kept);
+		Rehash();
+	}
+	m_stats.EntryCount = (uint32_t)m_entries.size();
+}
+
+void TessellationCache::Rehash() {
+	size_t size = 64;
+	while (size < m_entries.size() * 2)
+		size *= 2;
+	m_slots.assign(size, 0xffffffff);
+	const size_t mask = size - 1;
+	for (uint32_t i = 0; i < (uint32_t)m_entries.size(); ++i) {
+		size_t slot = (size_t)HashBytes(&m_entries[i]->EntryKey, sizeof(Key)) & mask;
+		while (m_slots[slot] != 0xffffffff)
+			slot = (slot + 1) & mask;
+		m_slots[slot] = i;
+	}
+}
+
+const std::vector<PathTriangle>& TessellationCache::GetFill(const PathGeometry& geometry,
+		const Matrix3x2& transform, float tolerance, JobSystem* jobs) {
+	Key key;
+	memset(&key, 0, sizeof(key));
+	key.Geometry = geometry.GetHash();
+	key.M11 = transform.M11;
+	key.M12 = transform.M12;
+	key.M21 = transform.M21;
+	key.M22 = transform.M22;
+	key.Tolerance = tolerance;
+	return Get(key, geometry, nullptr, transform, jobs);
+}
+
+const std::vector<PathTriangle>& TessellationCache::GetStroke(const PathGeometry& geometry,
+		const StrokeStyle& style, const Matrix3x2& transform, float tolerance,
+		JobSystem* jobs) {
+	Key key;
+	memset(&key, 0, sizeof(key));
+	key.Geometry = geometry.GetHash();
+	key.M11 = transform.M11;
+	key.M12 = transform.M12;
+	key.M21 = transform.M21;
+	key.M22 = transform.M22;
+	key.Tolerance = tolerance;
+	key.Stroked = 1;
+	key.Width = style.Width;
+	key.StartCap = style.StartCap;
+	key.EndCap = style.EndCap;
+	key.Join = style.Join;
+	key.MiterLimit = style.MiterLimit;
+	return Get(key, geometry, &style, transform, jobs);
+}
+
+const std::vector<PathTriangle>& TessellationCache::Get(const Key& key,
+		const PathGeometry& geometry, const StrokeStyle* style, const Matrix3x2& transform,
+		JobSystem* jobs) {
+	const uint64_t hash = HashBytes(&key, sizeof(key));
+	size_t mask = m_slots.size() - 1;
+	size_t slot = (size_t)hash & mask;
+	for (; m_slots[slot] != 0xffffffff; slot = (slot + 1) & mask) {
+		Entry* entry = m_entries[m_slots[slot]];
+		if (memcmp(&entry->EntryKey, &key, sizeof(key)) == 0 &&
+				entry->Geometry.IsEqual(geometry)) {
+			entry->LastUsed = m_frame;
+			++m_stats.Hits;
+			return entry->Triangles;
+		}
+	}
+
+	Entry* entry = new Entry;
+	entry->EntryKey = key;
+	entry->Geometry = geometry;
+	entry->LastUsed = m_frame;
+	Matrix3x2 linear = transform;
+	linear.Dx = linear.Dy = 0.0f;
+	if (style)
+		geometry.TessellateStroke(*style, linear, key.Tolerance, entry->Triangles, jobs);
+	else
+		geometry.Tessellate(linear, key.Tolerance, entry->Triangles, jobs);
+	m_entries.push_back(entry);
+	++m_stats.Misses;
+	m_stats.EntryCount = (uint32_t)m_entries.size();
+	m_stats.TriangleCount += (uint32_t)entry->Triangles.size();
+	if (m_entries.size() * 2 > m_slots.size())
+		Rehash();
+	else
+		m_slots[slot] = (uint32_t)m_entries.size() - 1;
+	return entry->Triangles;
+}
+
+} // namespace Zeus
@@ -0,0 +1,259 @@
+/*
+ * PathGeometry.h
+ *
+ * CPU vector graphics along the lines of ID2D1PathGeometry: figures of
+ * lines and quadratic and cubic Béziers are built through a sink-style
+ * interface, flattened adaptively, tessellated into triangles like
+ * ID2D1Geometry::Tessellate, and rasterized with analytic coverage.
+ *
+ * Flattening picks the segment count of every curve from Wang's formula
+ * in device space, so the tolerance holds under any transform.
+ *
+ * Fills are cut into scanbeams between vertex heights, split further
+ * where edges cross, and every span the fill mode counts as inside
+ * becomes a trapezoid. Beams are independent and tessellate in parallel.
+ * Strokes expand every flattened segment into a quad plus joins and
+ * caps, figure by figure in parallel. Stroke triangles overlap; all
+ * triangles are wound the same way and the rasterizer clamps accumulated
+ * coverage, so overlaps draw once.
+ *
+ * TessellationCache keeps triangles between frames keyed by the
+ * geometry's contents and the linear part of the transform. Entries keep a
+ * copy of their geometry, so a hash collision is a miss rather than the
+ * wrong triangles. Translation
+ * is applied at rasterization, so panning a map reuses the tessellation.
+ *
+ * The interface uses its own plain structs laid out like their D2D
+ * counterparts rather than XNA Math types, so the module builds without
+ * the Windows headers or the DirectX SDK.
+ */
+
+#ifndef PATHGEOMETRY_H_
+#define PATHGEOMETRY_H_
+
+#include "CommandList.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Same layout as D2D1_POINT_2F.
+struct PathPoint {
+	float x;
+	float y;
+
+	PathPoint() {}
+	PathPoint(float px, float py) : x(px), y(py) {}
+};
+
+// Same layout as D2D1_COLOR_F; straight alpha.
+struct PathColor {
+	float r;
+	float g;
+	float b;
+	float a;
+};
+
+// Pixels Pitch apart per row. A ColorBuffer's rows can be passed as
+// reinterpret_cast<PathColor*>(buffer.GetRow(0)) with its width as the
+// pitch.
+struct PathSurface {
+	PathColor* Pixels;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t Pitch;
+};
+
+// Same layout and meaning as D2D1_MATRIX_3X2_F: row vectors,
+// p' = (x M11 + y M21 + Dx, x M12 + y M22 + Dy).
+struct Matrix3x2 {
+	float M11, M12;
+	float M21, M22;
+	float Dx, Dy;
+
+	static Matrix3x2 Identity() {
+		Matrix3x2 m = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+		return m;
+	}
+};
+
+enum FillMode {
+	FILL_MODE_ALTERNATE,
+	FILL_MODE_WINDING
+};
+
+enum PathCap {
+	PATH_CAP_FLAT,
+	PATH_CAP_SQUARE,
+	PATH_CAP_ROUND
+};
+
+enum PathJoin {
+	PATH_JOIN_MITER,
+	PATH_JOIN_BEVEL,
+	PATH_JOIN_ROUND
+};
+
+struct StrokeStyle {
+	// Device pixels; scaled by the square root of the transform's
+	// determinant.
+	float Width;
+	PathCap StartCap;
+	PathCap EndCap;
+	PathJoin Join;
+	// Longest miter as a multiple of half the width; longer ones bevel.
+	float MiterLimit;
+
+	StrokeStyle()
+		: Width(1.0f), StartCap(PATH_CAP_FLAT), EndCap(PATH_CAP_FLAT), Join(PATH_JOIN_MITER),
+		MiterLimit(10.0f) {}
+};
+
+struct PathTriangle {
+	PathPoint Points[3];
+};
+
+// Flattened figure: PointCount points starting at FirstPoint.
+struct FlatFigure {
+	uint32_t FirstPoint;
+	uint32_t PointCount;
+	bool Filled;
+	bool Closed;
+};
+
+// D2D's default flattening tolerance, in device pixels.
+const float DEFAULT_FLATTENING_TOLERANCE = 0.25f;
+
+class PathGeometry {
+public:
+	PathGeometry();
+
+	void Reset();
+	void SetFillMode(FillMode mode);
+	FillMode GetFillMode() const { return m_fillMode; }
+
+	// Hollow figures are stroked but not filled. Every figure must end
+	// before the next begins.
+	void BeginFigure(const PathPoint& start, bool filled);
+	void AddLine(const PathPoint& point);
+	void AddLines(const PathPoint* points, uint32_t count);
+	void AddQuadraticBezier(const PathPoint& control, const PathPoint& end);
+	void AddBezier(const PathPoint& control1, const PathPoint& control2, const PathPoint& end);
+	void EndFigure(bool closed);
+
+	// Depends only on the figures and the fill mode, never on the order
+	// they were set in.
+	uint64_t GetHash() const;
+	// Same figures and fill mode, for when equal hashes must be confirmed.
+	bool IsEqual(const PathGeometry& other) const;
+	uint32_t GetFigureCount() const { return (uint32_t)m_figures.size(); }
+
+	void Flatten(const Matrix3x2& transform, float tolerance, std::vector<PathPoint>& points,
+			std::vector<FlatFigure>& figures) const;
+	// Triangles covering the fill, in device space. Filled figures are
+	// closed implicitly.
+	void Tessellate(const Matrix3x2& transform, float tolerance,
+			std::vector<PathTriangle>& triangles, JobSystem* jobs) const;
+	void TessellateStroke(const StrokeStyle& style, const Matrix3x2& transform, float tolerance,
+			std::vector<PathTriangle>& triangles, JobSystem* jobs) const;
+
+private:
+	struct Figure {
+		uint32_t FirstPoint;
+		uint32_t FirstSegment;
+		uint32_t SegmentCount;
+		bool Filled;
+		bool Closed;
+	};
+
+	void AddSegment(uint8_t type, const PathPoint* points, uint32_t count);
+
+	std::vector<Figure> m_figures;
+	// Start point of every figure, then the points of its segments.
+	std::vector<PathPoint> m_points;
+	std::vector<uint8_t> m_segments;
+	FillMode m_fillMode;
+	bool m_inFigure;
+	// Running hash of the figures; the fill mode joins in GetHash().
+	uint64_t m_hash;
+};
+
+// Draws triangles wound the way Tessellate() winds them into target with
+// coverage anti-aliasing, offset by translation. color blends source-over.
+void RasterizeTriangles(const PathSurface& target, const ScissorRect& scissor,
+		const PathTriangle* triangles, uint32_t count, const PathPoint& translation,
+		const PathColor& color, JobSystem* jobs);
+
+struct TessellationCacheStats {
+	uint32_t EntryCount;
+	uint32_t TriangleCount;
+	// Since the last BeginFrame().
+	uint32_t Hits;
+	uint32_t Misses;
+	uint32_t Evicted;
+};
+
+class TessellationCache {
+public:
+	TessellationCache();
+	~TessellationCache();
+
+	// Entries unused for more than this many frames are dropped.
+	void SetMaxAge(uint32_t frames) { m_maxAge = frames; }
+	void BeginFrame();
+	void Clear();
+
+	// Triangles for the transform without its translation; draw them
+	// with (Dx, Dy) as the translation. Valid until the next BeginFrame().
+	const std::vector<PathTriangle>& GetFill(const PathGeometry& geometry,
+			const Matrix3x2& transform, float tolerance, JobSystem* jobs);
+	const std::vector<PathTriangle>& GetStroke(const PathGeometry& geometry,
+			const StrokeStyle& style, const Matrix3x2& transform, float tolerance,
+			JobSystem* jobs);
+
+	const TessellationCacheStats& GetStats() const { return m_stats; }
+
+private:
+	TessellationCache(const TessellationCache&);
+	TessellationCache& operator=(const TessellationCache&);
+
+	// Compared bytewise; no padding.
+	struct Key {
+		uint64_t Geometry;
+		float M11, M12, M21, M22;
+		float Tolerance;
+		uint32_t Stroked;
+		float Width;
+		uint32_t StartCap;
+		uint32_t EndCap;
+		uint32_t Join;
+		float MiterLimit;
+		uint32_t Padding;
+	};
+
+	struct Entry {
+		Key EntryKey;
+		// The key only holds a hash of the geometry, so hits compare it.
+		PathGeometry Geometry;
+		uint32_t LastUsed;
+		std::vector<PathTriangle> Triangles;
+	};
+
+	const std::vector<PathTriangle>& Get(const Key& key, const PathGeometry& geometry,
+			const StrokeStyle* style, const Matrix3x2& transform, JobSystem* jobs);
+	void Rehash();
+
+	std::vector<Entry*> m_entries;
+	// Open-addressed index into m_entries.
+	std::vector<uint32_t> m_slots;
+	uint32_t m_frame;
+	uint32_t m_maxAge;
+	TessellationCacheStats m_stats;
+};
+
+} // namespace Zeus
+
+#endif /* PATHGEOMETRY_H_ */
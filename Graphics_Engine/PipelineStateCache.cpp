@@ -0,0 +1,299 @@
+/*
+ * PipelineStateCache.cpp
+ *
+ */
+
+#include "PipelineStateCache.h"
+
+#include <cassert>
+#include <cstdio>
+#include <thread>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x4353505A; // 'ZPSC'
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheFileHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Count[STATE_KIND_COUNT];
+	uint32_t DescSize[STATE_KIND_COUNT];
+};
+
+const uint32_t DESC_SIZES[STATE_KIND_COUNT] = {
+	sizeof(BlendDesc), sizeof(RasterizerDesc), sizeof(DepthStencilDesc), sizeof(SamplerDesc)
+};
+
+template <typename Desc>
+void AppendTable(std::vector<uint8_t>& out, const StateTable<Desc>& table) {
+	for (uint32_t i = 0; i < table.GetCount(); ++i) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&table.Get((StateHandle)i));
+		out.insert(out.end(), bytes, bytes + sizeof(Desc));
+	}
+}
+
+} // namespace
+
+PipelineStateCache::PipelineStateCache()
+		: m_inFrame(false), m_readers(0), m_hits(0), m_frameMisses(0), m_prewarmed(0) {
+	AddDefaults();
+}
+
+void PipelineStateCache::AddDefaults() {
+	GetBlendState(DefaultBlendDesc());
+	GetRasterizerState(DefaultRasterizerDesc());
+	GetDepthStencilState(DefaultDepthStencilDesc());
+	GetSamplerState(DefaultSamplerDesc());
+}
+
+void PipelineStateCache::SetCreateCallback(const CreateFunc& onCreate) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_onCreate = onCreate;
+	if (!m_onCreate)
+		return;
+	for (uint32_t i = 0; i < m_blend.GetCount(); ++i)
+		m_onCreate(STATE_KIND_BLEND, (StateHandle)i, &m_blend.Get((StateHandle)i));
+	for (uint32_t i = 0; i < m_rasterizer.GetCount(); ++i)
+		m_onCreate(STATE_KIND_RASTERIZER, (StateHandle)i, &m_rasterizer.Get((StateHandle)i));
+	for (uint32_t i = 0; i < m_depthStencil.GetCount(); ++i)
+		m_onCreate(STATE_KIND_DEPTH_STENCIL, (StateHandle)i, &m_depthStencil.Get((StateHandle)i));
+	for (uint32_t i = 0; i < m_sampler.GetCount(); ++i)
+		m_onCreate(STATE_KIND_SAMPLER, (StateHandle)i, &m_sampler.Get((StateHandle)i));
+}
+
+template <typename Desc>
+StateHandle PipelineStateCache::Create(StateTable<Desc>& table, StateKind kind,
+		const Desc& desc, uint64_t hash) {
+	StateHandle handle = table.Find(desc, hash);
+	if (handle != INVALID_STATE)
+		return handle;
+	handle = table.Insert(desc, hash);
+	if (handle != INVALID_STATE && m_onCreate)
+		m_onCreate(kind, handle, &table.Get(handle));
+	return handle;
+}
+
+template <typename Desc>
+StateHandle PipelineStateCache::Get(StateTable<Desc>& table, std::vector<Desc>& pending,
+		StateKind kind, const Desc& desc) {
+	uint64_t hash = HashBytes(&desc, sizeof(Desc));
+
+	// The tables cannot change while a frame is open, so lookups need no lock.
+	// A reader registers before it checks the frame, and EndFrame() waits
+	// for every registered reader before it touches the tables.
+	m_readers.fetch_add(1);
+	if (m_inFrame.load()) {
+		StateHandle handle = table.Find(desc, hash);
+		m_readers.fetch_sub(1);
+		if (handle != INVALID_STATE) {
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return handle;
+		}
+		m_frameMisses.fetch_add(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pending.push_back(desc);
+		return INVALID_STATE;
+	}
+	m_readers.fetch_sub(1);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// BeginFrame() takes the lock, so no frame opens while a state is being
+	// created, but one may have opened since the check above.
+	if (m_inFrame.load(std::memory_order_relaxed)) {
+		StateHandle handle = table.Find(desc, hash);
+		if (handle == INVALID_STATE) {
+			m_frameMisses.fetch_add(1, std::memory_order_relaxed);
+			pending.push_back(desc);
+		}
+		return handle;
+	}
+	return Create(table, kind, desc, hash);
+}
+
+StateHandle PipelineStateCache::GetBlendState(const BlendDesc& desc) {
+	return Get(m_blend, m_pendingBlend, STATE_KIND_BLEND, desc);
+}
+
+StateHandle PipelineStateCache::GetRasterizerState(const RasterizerDesc& desc) {
+	return Get(m_rasterizer, m_pendingRasterizer, STATE_KIND_RASTERIZER, desc);
+}
+
+StateHandle PipelineStateCache::GetDepthStencilState(const DepthStencilDesc& desc) {
+	return Get(m_depthStencil, m_pendingDepthStencil, STATE_KIND_DEPTH_STENCIL, desc);
+}
+
+StateHandle PipelineStateCache::GetSamplerState(const SamplerDesc& desc) {
+	return Get(m_sampler, m_pendingSampler, STATE_KIND_SAMPLER, desc);
+}
+
+const BlendDesc& PipelineStateCache::GetBlendDesc(StateHandle handle) const {
+	assert(handle < m_blend.GetCount());
+	return m_blend.Get(handle);
+}
+
+const RasterizerDesc& PipelineStateCache::GetRasterizerDesc(StateHandle handle) const {
+	assert(handle < m_rasterizer.GetCount());
+	return m_rasterizer.Get(handle);
+}
+
+const DepthStencilDesc& PipelineStateCache::GetDepthStencilDesc(StateHandle handle) const {
+	assert(handle < m_depthStencil.GetCount());
+	return m_depthStencil.Get(handle);
+}
+
+const SamplerDesc& PipelineStateCache::GetSamplerDesc(StateHandle handle) const {
+	assert(handle < m_sampler.GetCount());
+	return m_sampler.Get(handle);
+}
+
+void PipelineStateCache::BeginFrame() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_inFrame.store(true);
+}
+
+template <typename Desc>
+void PipelineStateCache::FlushPending(StateTable<Desc>& table, std::vector<Desc>& pending,
+		StateKind kind) {
+	for (size_t i = 0; i < pending.size(); ++i)
+		Create(table, kind, pending[i], HashBytes(&pending[i], sizeof(Desc)));
+	pending.clear();
+}
+
+void PipelineStateCache::EndFrame() {
+	// Lookups that saw the frame open may still be probing the tables; the
+	// lock keeps new states out until they are done.
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_inFrame.store(false);
+	while (m_readers.load() != 0)
+		std::this_thread::yield();
+
+	FlushPending(m_blend, m_pendingBlend, STATE_KIND_BLEND);
+	FlushPending(m_rasterizer, m_pendingRasterizer, STATE_KIND_RASTERIZER);
+	FlushPending(m_depthStencil, m_pendingDepthStencil, STATE_KIND_DEPTH_STENCIL);
+	FlushPending(m_sampler, m_pendingSampler, STATE_KIND_SAMPLER);
+}
+
+void PipelineStateCache::Serialize(std::vector<uint8_t>& out) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	CacheFileHeader header;
+	header.Magic = CACHE_MAGIC;
+	header.Version = CACHE_VERSION;
+	header.Count[STATE_KIND_BLEND] = m_blend.GetCount();
+	header.Count[STATE_KIND_RASTERIZER] = m_rasterizer.GetCount();
+	header.Count[STATE_KIND_DEPTH_STENCIL] = m_depthStencil.GetCount();
+	header.Count[STATE_KIND_SAMPLER] = m_sampler.GetCount();
+	for (int kind = 0; kind < STATE_KIND_COUNT; ++kind)
+		header.DescSize[kind] = DESC_SIZES[kind];
+
+	out.clear();
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+	out.insert(out.end(), bytes, bytes + sizeof(header));
+	AppendTable(out, m_blend);
+	AppendTable(out, m_rasterizer);
+	AppendTable(out, m_depthStencil);
+	AppendTable(out, m_sampler);
+}
+
+bool PipelineStateCache::Prewarm(const void* data, size_t size) {
+	assert(!IsInFrame());
+	if (size < sizeof(CacheFileHeader))
+		return false;
+
+	CacheFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.Magic != CACHE_MAGIC || header.Version != CACHE_VERSION)
+		return false;
+	size_t expected = sizeof(header);
+	for (int kind = 0; kind < STATE_KIND_COUNT; ++kind) {
+		if (header.DescSize[kind] != DESC_SIZES[kind])
+			return false;
+		expected += (size_t)header.Count[kind] * DESC_SIZES[kind];
+	}
+	if (size != expected)
+		return false;
+
+	const uint8_t* cursor = static_cast<const uint8_t*>(data) + sizeof(header);
+	uint32_t before = m_blend.GetCount() + m_rasterizer.GetCount() + m_depthStencil.GetCount() +
+			m_sampler.GetCount();
+	for (uint32_t i = 0; i < header.Count[STATE_KIND_BLEND]; ++i, cursor += sizeof(BlendDesc)) {
+		BlendDesc desc;
+		memcpy(&desc, cursor, sizeof(desc));
+		GetBlendState(desc);
+	}
+	for (uint32_t i = 0; i < header.Count[STATE_KIND_RASTERIZER]; ++i, cursor += sizeof(RasterizerDesc)) {
+		RasterizerDesc desc;
+		memcpy(&desc, cursor, sizeof(desc));
+		GetRasterizerState(desc);
+	}
+	for (uint32_t i = 0; i < header.Count[STATE_KIND_DEPTH_STENCIL]; ++i, cursor += sizeof(DepthStencilDesc)) {
+		DepthStencilDesc desc;
+		memcpy(&desc, cursor, sizeof(desc));
+		GetDepthStencilState(desc);
+	}
+	for (uint32_t i = 0; i < header.Count[STATE_KIND_SAMPLER]; ++i, cursor += sizeof(SamplerDesc)) {
+		SamplerDesc desc;
+		memcpy(&desc, cursor, sizeof(desc));
+		GetSamplerState(desc);
+	}
+	m_prewarmed += m_blend.GetCount() + m_rasterizer.GetCount() + m_depthStencil.GetCount() +
+			m_sampler.GetCount() - before;
+	return true;
+}
+
+bool PipelineStateCache::SaveToFile(const char* path) const {
+	std::vector<uint8_t> data;
+	Serialize(data);
+	FILE* file;
+	if (fopen_s(&file, path, "wb") != 0)
+		return false;
+	bool ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool PipelineStateCache::PrewarmFromFile(const char* path) {
+	FILE* file;
+	if (fopen_s(&file, path, "rb") != 0)
+		return false;
+	std::vector<uint8_t> data;
+	uint8_t chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		data.insert(data.end(), chunk, chunk + read);
+	fclose(file);
+	return !data.empty() && Prewarm(&data[0], data.size());
+}
+
+void PipelineStateCache::Clear() {
+	assert(!IsInFrame());
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_blend.Clear();
+		m_rasterizer.Clear();
+		m_depthStencil.Clear();
+		m_sampler.Clear();
+		m_pendingBlend.clear();
+		m_pendingRasterizer.clear();
+		m_pendingDepthStencil.clear();
+		m_pendingSampler.clear();
+	}
+	AddDefaults();
+}
+
+PipelineStateCacheStats PipelineStateCache::GetStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	PipelineStateCacheStats stats;
+	stats.Count[STATE_KIND_BLEND] = m_blend.GetCount();
+	stats.Count[STATE_KIND_RASTERIZER] = m_rasterizer.GetCount();
+	stats.Count[STATE_KIND_DEPTH_STENCIL] = m_depthStencil.GetCount();
+	stats.Count[STATE_KIND_SAMPLER] = m_sampler.GetCount();
+	stats.Hits = m_hits.load(std::memory_order_relaxed);
+	stats.FrameMisses = m_frameMisses.load(std::memory_order_relaxed);
+	stats.Prewarmed = m_prewarmed;
+	return stats;
+}
+
+} // namespace Zeus
@@ -0,0 +1,195 @@
+/*
+ * PipelineStateCache.h
+ *
+ * Deduplicates blend, rasterizer, depth-stencil and sampler descriptors
+ * into 16-bit handles. Identical descriptors always map to the same handle,
+ * so draw submission can compare handles instead of structs.
+ *
+ * State objects are only created between frames. Inside BeginFrame() /
+ * EndFrame() the tables are frozen and lookups are lock-free; a descriptor
+ * that has not been seen yet returns INVALID_STATE and is queued, then
+ * created by EndFrame(), which first waits for lookups still running.
+ * Prewarm() loads a list saved by Serialize() so a shipping build never
+ * hits that path.
+ */
+
+#ifndef PIPELINESTATECACHE_H_
+#define PIPELINESTATECACHE_H_
+
+#include "PipelineStates.h"
+#include "Hash.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Zeus {
+
+typedef uint16_t StateHandle;
+const StateHandle INVALID_STATE = 0xFFFF;
+
+enum StateKind {
+	STATE_KIND_BLEND = 0,
+	STATE_KIND_RASTERIZER,
+	STATE_KIND_DEPTH_STENCIL,
+	STATE_KIND_SAMPLER,
+	STATE_KIND_COUNT
+};
+
+// The handles a draw needs, packed so two draws compare with one integer test.
+struct PipelineState {
+	StateHandle Blend;
+	StateHandle Rasterizer;
+	StateHandle DepthStencil;
+	uint16_t Reserved;
+
+	uint64_t Key() const {
+		return (uint64_t)Blend | ((uint64_t)Rasterizer << 16) | ((uint64_t)DepthStencil << 32);
+	}
+	bool operator==(const PipelineState& other) const { return Key() == other.Key(); }
+	bool operator!=(const PipelineState& other) const { return Key() != other.Key(); }
+};
+
+struct PipelineStateCacheStats {
+	uint32_t Count[STATE_KIND_COUNT];
+	uint32_t Hits;
+	// Lookups that found nothing inside a frame and had to be deferred.
+	uint32_t FrameMisses;
+	uint32_t Prewarmed;
+};
+
+// Open-addressed descriptor table. Descriptors are hashed and compared
+// bytewise; Desc must be a POD without padding.
+template <typename Desc>
+class StateTable {
+public:
+	StateTable() : m_slots(64, INVALID_STATE) {}
+
+	StateHandle Find(const Desc& desc, uint64_t hash) const {
+		size_t mask = m_slots.size() - 1;
+		for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+			StateHandle handle = m_slots[slot];
+			if (handle == INVALID_STATE)
+				return INVALID_STATE;
+			if (m_hashes[handle] == hash && memcmp(&m_descs[handle], &desc, sizeof(Desc)) == 0)
+				return handle;
+		}
+	}
+
+	StateHandle Insert(const Desc& desc, uint64_t hash) {
+		if (m_descs.size() >= INVALID_STATE)
+			return INVALID_STATE;
+		if ((m_descs.size() + 1) * 2 > m_slots.size())
+			Grow();
+		StateHandle handle = (StateHandle)m_descs.size();
+		m_descs.push_back(desc);
+		m_hashes.push_back(hash);
+		Place(handle);
+		return handle;
+	}
+
+	const Desc& Get(StateHandle handle) const { return m_descs[handle]; }
+	uint32_t GetCount() const { return (uint32_t)m_descs.size(); }
+
+	void Clear() {
+		m_descs.clear();
+		m_hashes.clear();
+		m_slots.assign(64, INVALID_STATE);
+	}
+
+private:
+	void Place(StateHandle handle) {
+		size_t mask = m_slots.size() - 1;
+		size_t slot = (size_t)m_hashes[handle] & mask;
+		while (m_slots[slot] != INVALID_STATE)
+			slot = (slot + 1) & mask;
+		m_slots[slot] = handle;
+	}
+
+	void Grow() {
+		m_slots.assign(m_slots.size() * 2, INVALID_STATE);
+		for (size_t i = 0; i < m_descs.size(); ++i)
+			Place((StateHandle)i);
+	}
+
+	std::vector<Desc> m_descs;
+	std::vector<uint64_t> m_hashes;
+	std::vector<StateHandle> m_slots;
+};
+
+class PipelineStateCache {
+public:
+	// Called once for every new state object so a backend can create the
+	// matching API object; desc points at the descriptor of the given kind.
+	// Setting the callback replays every state that already exists.
+	typedef std::function<void(StateKind kind, StateHandle handle, const void* desc)> CreateFunc;
+
+	PipelineStateCache();
+
+	void SetCreateCallback(const CreateFunc& onCreate);
+
+	StateHandle GetBlendState(const BlendDesc& desc);
+	StateHandle GetRasterizerState(const RasterizerDesc& desc);
+	StateHandle GetDepthStencilState(const DepthStencilDesc& desc);
+	StateHandle GetSamplerState(const SamplerDesc& desc);
+
+	const BlendDesc& GetBlendDesc(StateHandle handle) const;
+	const RasterizerDesc& GetRasterizerDesc(StateHandle handle) const;
+	const DepthStencilDesc& GetDepthStencilDesc(StateHandle handle) const;
+	const SamplerDesc& GetSamplerDesc(StateHandle handle) const;
+
+	void BeginFrame();
+	// Creates everything that was requested during the frame.
+	void EndFrame();
+	bool IsInFrame() const { return m_inFrame.load(std::memory_order_relaxed); }
+
+	// Writes every descriptor in handle order. Prewarming a fresh cache
+	// from the result reproduces the same handles.
+	void Serialize(std::vector<uint8_t>& out) const;
+	bool Prewarm(const void* data, size_t size);
+	bool SaveToFile(const char* path) const;
+	bool PrewarmFromFile(const char* path);
+
+	// Drops every state except the defaults at handle 0.
+	void Clear();
+
+	PipelineStateCacheStats GetStats() const;
+
+private:
+	PipelineStateCache(const PipelineStateCache&);
+	PipelineStateCache& operator=(const PipelineStateCache&);
+
+	template <typename Desc>
+	StateHandle Get(StateTable<Desc>& table, std::vector<Desc>& pending, StateKind kind,
+			const Desc& desc);
+	template <typename Desc>
+	StateHandle Create(StateTable<Desc>& table, StateKind kind, const Desc& desc, uint64_t hash);
+	template <typename Desc>
+	void FlushPending(StateTable<Desc>& table, std::vector<Desc>& pending, StateKind kind);
+	void AddDefaults();
+
+	StateTable<BlendDesc> m_blend;
+	StateTable<RasterizerDesc> m_rasterizer;
+	StateTable<DepthStencilDesc> m_depthStencil;
+	StateTable<SamplerDesc> m_sampler;
+
+	std::vector<BlendDesc> m_pendingBlend;
+	std::vector<RasterizerDesc> m_pendingRasterizer;
+	std::vector<DepthStencilDesc> m_pendingDepthStencil;
+	std::vector<SamplerDesc> m_pendingSampler;
+
+	CreateFunc m_onCreate;
+	mutable std::mutex m_mutex;
+	std::atomic<bool> m_inFrame;
+	// Lookups running without the lock.
+	std::atomic<uint32_t> m_readers;
+	std::atomic<uint32_t> m_hits;
+	std::atomic<uint32_t> m_frameMisses;
+	uint32_t m_prewarmed;
+};
+
+} // namespace Zeus
+
+#endif /* PIPELINESTATECACHE_H_ */
@@ -0,0 +1,68 @@
+/*
+ * PipelineStates.cpp
+ *
+ */
+
+#include "PipelineStates.h"
+
+#include <cfloat>
+#include <cstring>
+
+namespace Zeus {
+
+BlendDesc DefaultBlendDesc() {
+	BlendDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	for (int i = 0; i < 8; ++i) {
+		RenderTargetBlendDesc& target = desc.RenderTarget[i];
+		target.SrcBlend = BLEND_ONE;
+		target.DestBlend = BLEND_ZERO;
+		target.BlendOp = BLEND_OP_ADD;
+		target.SrcBlendAlpha = BLEND_ONE;
+		target.DestBlendAlpha = BLEND_ZERO;
+		target.BlendOpAlpha = BLEND_OP_ADD;
+		target.RenderTargetWriteMask = COLOR_WRITE_ALL;
+	}
+	return desc;
+}
+
+RasterizerDesc DefaultRasterizerDesc() {
+	RasterizerDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.FillMode = FILL_SOLID;
+	desc.CullMode = CULL_BACK;
+	desc.DepthClipEnable = 1;
+	return desc;
+}
+
+DepthStencilDesc DefaultDepthStencilDesc() {
+	DepthStencilDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.DepthEnable = 1;
+	desc.DepthWriteMask = DEPTH_WRITE_MASK_ALL;
+	desc.DepthFunc = COMPARISON_LESS;
+	desc.StencilReadMask = 0xFF;
+	desc.StencilWriteMask = 0xFF;
+	DepthStencilOpDesc op = { STENCIL_OP_KEEP, STENCIL_OP_KEEP, STENCIL_OP_KEEP, COMPARISON_ALWAYS };
+	desc.FrontFace = op;
+	desc.BackFace = op;
+	return desc;
+}
+
+SamplerDesc DefaultSamplerDesc() {
+	SamplerDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.Filter = FILTER_MIN_MAG_MIP_LINEAR;
+	desc.AddressU = ADDRESS_CLAMP;
+	desc.AddressV = ADDRESS_CLAMP;
+	desc.AddressW = ADDRESS_CLAMP;
+	desc.MaxAnisotropy = 1;
+	desc.ComparisonFunc = COMPARISON_NEVER;
+	for (int i = 0; i < 4; ++i)
+		desc.BorderColor[i] = 1.0f;
+	desc.MinLOD = -FLT_MAX;
+	desc.MaxLOD = FLT_MAX;
+	return desc;
+}
+
+} // namespace Zeus
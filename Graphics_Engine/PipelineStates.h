@@ -0,0 +1,174 @@
+/*
+ * PipelineStates.h
+ *
+ * Fixed-function state descriptors. Fields and enum values follow the
+ * D3D11_*_DESC structures, except that BOOL and UINT8 members are widened
+ * to 32 bits so the structs have no padding and can be hashed and compared
+ * as raw bytes.
+ */
+
+#ifndef PIPELINESTATES_H_
+#define PIPELINESTATES_H_
+
+#include <cstdint>
+
+namespace Zeus {
+
+enum Blend {
+	BLEND_ZERO = 1,
+	BLEND_ONE = 2,
+	BLEND_SRC_COLOR = 3,
+	BLEND_INV_SRC_COLOR = 4,
+	BLEND_SRC_ALPHA = 5,
+	BLEND_INV_SRC_ALPHA = 6,
+	BLEND_DEST_ALPHA = 7,
+	BLEND_INV_DEST_ALPHA = 8,
+	BLEND_DEST_COLOR = 9,
+	BLEND_INV_DEST_COLOR = 10,
+	BLEND_SRC_ALPHA_SAT = 11,
+	BLEND_BLEND_FACTOR = 14,
+	BLEND_INV_BLEND_FACTOR = 15
+};
+
+enum BlendOp {
+	BLEND_OP_ADD = 1,
+	BLEND_OP_SUBTRACT = 2,
+	BLEND_OP_REV_SUBTRACT = 3,
+	BLEND_OP_MIN = 4,
+	BLEND_OP_MAX = 5
+};
+
+enum ColorWriteMask {
+	COLOR_WRITE_RED = 1,
+	COLOR_WRITE_GREEN = 2,
+	COLOR_WRITE_BLUE = 4,
+	COLOR_WRITE_ALPHA = 8,
+	COLOR_WRITE_ALL = 15
+};
+
+enum FillMode {
+	FILL_WIREFRAME = 2,
+	FILL_SOLID = 3
+};
+
+enum CullMode {
+	CULL_NONE = 1,
+	CULL_FRONT = 2,
+	CULL_BACK = 3
+};
+
+enum ComparisonFunc {
+	COMPARISON_NEVER = 1,
+	COMPARISON_LESS = 2,
+	COMPARISON_EQUAL = 3,
+	COMPARISON_LESS_EQUAL = 4,
+	COMPARISON_GREATER = 5,
+	COMPARISON_NOT_EQUAL = 6,
+	COMPARISON_GREATER_EQUAL = 7,
+	COMPARISON_ALWAYS = 8
+};
+
+enum StencilOp {
+	STENCIL_OP_KEEP = 1,
+	STENCIL_OP_ZERO = 2,
+	STENCIL_OP_REPLACE = 3,
+	STENCIL_OP_INCR_SAT = 4,
+	STENCIL_OP_DECR_SAT = 5,
+	STENCIL_OP_INVERT = 6,
+	STENCIL_OP_INCR = 7,
+	STENCIL_OP_DECR = 8
+};
+
+enum DepthWriteMask {
+	DEPTH_WRITE_MASK_ZERO = 0,
+	DEPTH_WRITE_MASK_ALL = 1
+};
+
+enum Filter {
+	FILTER_MIN_MAG_MIP_POINT = 0,
+	FILTER_MIN_MAG_LINEAR_MIP_POINT = 0x14,
+	FILTER_MIN_MAG_MIP_LINEAR = 0x15,
+	FILTER_ANISOTROPIC = 0x55,
+	FILTER_COMPARISON_MIN_MAG_MIP_POINT = 0x80,
+	FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT = 0x94,
+	FILTER_COMPARISON_MIN_MAG_MIP_LINEAR = 0x95
+};
+
+enum TextureAddressMode {
+	ADDRESS_WRAP = 1,
+	ADDRESS_MIRROR = 2,
+	ADDRESS_CLAMP = 3,
+	ADDRESS_BORDER = 4,
+	ADDRESS_MIRROR_ONCE = 5
+};
+
+struct RenderTargetBlendDesc {
+	uint32_t BlendEnable;
+	uint32_t SrcBlend;
+	uint32_t DestBlend;
+	uint32_t BlendOp;
+	uint32_t SrcBlendAlpha;
+	uint32_t DestBlendAlpha;
+	uint32_t BlendOpAlpha;
+	uint32_t RenderTargetWriteMask;
+};
+
+struct BlendDesc {
+	uint32_t AlphaToCoverageEnable;
+	uint32_t IndependentBlendEnable;
+	RenderTargetBlendDesc RenderTarget[8];
+};
+
+struct RasterizerDesc {
+	uint32_t FillMode;
+	uint32_t CullMode;
+	uint32_t FrontCounterClockwise;
+	int32_t DepthBias;
+	float DepthBiasClamp;
+	float SlopeScaledDepthBias;
+	uint32_t DepthClipEnable;
+	uint32_t ScissorEnable;
+	uint32_t MultisampleEnable;
+	uint32_t AntialiasedLineEnable;
+};
+
+struct DepthStencilOpDesc {
+	uint32_t StencilFailOp;
+	uint32_t StencilDepthFailOp;
+	uint32_t StencilPassOp;
+	uint32_t StencilFunc;
+};
+
+struct DepthStencilDesc {
+	uint32_t DepthEnable;
+	uint32_t DepthWriteMask;
+	uint32_t DepthFunc;
+	uint32_t StencilEnable;
+	uint32_t StencilReadMask;
+	uint32_t StencilWriteMask;
+	DepthStencilOpDesc FrontFace;
+	DepthStencilOpDesc BackFace;
+};
+
+struct SamplerDesc {
+	uint32_t Filter;
+	uint32_t AddressU;
+	uint32_t AddressV;
+	uint32_t AddressW;
+	float MipLODBias;
+	uint32_t MaxAnisotropy;
+	uint32_t ComparisonFunc;
+	float BorderColor[4];
+	float MinLOD;
+	float MaxLOD;
+};
+
+// The defaults D3D11 documents for each descriptor (CD3D11_*_DESC(D3D11_DEFAULT)).
+BlendDesc DefaultBlendDesc();
+RasterizerDesc DefaultRasterizerDesc();
+DepthStencilDesc DefaultDepthStencilDesc();
+SamplerDesc DefaultSamplerDesc();
+
+} // namespace Zeus
+
+#endif /* PIPELINESTATES_H_ */
@@ -0,0 +1,535 @@
+/*
+ * PostProcess.cpp
+ *
+ */
+
+#include "PostProcess.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Zeus {
+
+namespace {
+
+// Sweeps work on tiles of this many pixels per row and rows per job.
+const uint32_t TILE_WIDTH = 64;
+const uint32_t TILE_HEIGHT = 16;
+
+const XMVECTORF32 LUMA_WEIGHTS = { 0.2126f, 0.7152f, 0.0722f, 0.0f };
+
+inline float Luma(FXMVECTOR color) {
+	return XMVectorGetX(XMVector3Dot(color, LUMA_WEIGHTS));
+}
+
+inline uint32_t ClampIndex(int32_t value, uint32_t size) {
+	if (value < 0)
+		return 0;
+	return (uint32_t)value >= size ? size - 1 : (uint32_t)value;
+}
+
+// 2x2 box filter of source into target, clamping odd edges.
+void Downsample(const ColorBuffer& source, ColorBuffer& target, JobSystem* jobs) {
+	const uint32_t width = source.GetWidth();
+	const uint32_t height = source.GetHeight();
+	ParallelFor(jobs, target.GetHeight(), 16, [&](uint32_t begin, uint32_t end) {
+		const XMVECTOR quarter = XMVectorReplicate(0.25f);
+		for (uint32_t y = begin; y < end; ++y) {
+			const XMFLOAT4* row0 = source.GetRow(std::min(2 * y, height - 1));
+			const XMFLOAT4* row1 = source.GetRow(std::min(2 * y + 1, height - 1));
+			XMFLOAT4* out = target.GetRow(y);
+			for (uint32_t x = 0; x < target.GetWidth(); ++x) {
+				uint32_t x0 = std::min(2 * x, width - 1);
+				uint32_t x1 = std::min(2 * x + 1, width - 1);
+				XMVECTOR sum = XMVectorAdd(XMLoadFloat4(&row0[x0]), XMLoadFloat4(&row0[x1]));
+				sum = XMVectorAdd(sum, XMLoadFloat4(&row1[x0]));
+				sum = XMVectorAdd(sum, XMLoadFloat4(&row1[x1]));
+				XMStoreFloat4(&out[x], XMVectorMultiply(sum, quarter));
+			}
+		}
+	});
+}
+
+} // namespace
+
+PostProcessChain::PostProcessChain() {
+}
+
+void PostProcessChain::AddStage(PostStage* stage) {
+	if (stage)
+		m_stages.push_back(stage);
+}
+
+void PostProcessChain::ClearStages() {
+	m_stages.clear();
+}
+
+bool PostProcessChain::Execute(const ColorBuffer& input, ColorBuffer& output, JobSystem* jobs) {
+	const uint32_t width = input.GetWidth();
+	const uint32_t height = input.GetHeight();
+	if (&input == &output || width == 0 || height == 0 || output.GetWidth() != width ||
+			output.GetHeight() != height)
+		return false;
+
+	// A gather stage starts a new sweep; pixel stages join the current one.
+	m_sweeps.clear();
+	for (size_t i = 0; i < m_stages.size(); ++i) {
+		PostStage* stage = m_stages[i];
+		if (!stage->IsEnabled())
+			continue;
+		if (m_sweeps.empty() || stage->GetType() == POST_STAGE_GATHER)
+			m_sweeps.push_back(std::vector<PostStage*>());
+		m_sweeps.back().push_back(stage);
+	}
+	if (m_sweeps.empty())
+		m_sweeps.push_back(std::vector<PostStage*>());
+
+	m_timings.clear();
+	const ColorBuffer* source = &input;
+	for (size_t i = 0; i < m_sweeps.size(); ++i) {
+		ColorBuffer* target = &output;
+		if (i + 1 < m_sweeps.size()) {
+			target = &m_buffers[i & 1];
+			target->Initialize(width, height);
+		}
+
+		// Stages whose Prepare() fails sit this frame out.
+		std::vector<PostStage*>& sweep = m_sweeps[i];
+		const size_t first = m_timings.size();
+		size_t kept = 0;
+		for (size_t j = 0; j < sweep.size(); ++j) {
+			Timer timer;
+			bool prepared = sweep[j]->Prepare(*source, jobs);
+			PostTiming timing = { sweep[j]->GetName(), (uint32_t)i, timer.ElapsedMilliseconds(),
+					0.0 };
+			if (prepared) {
+				sweep[kept++] = sweep[j];
+				m_timings.push_back(timing);
+			}
+		}
+		sweep.resize(kept);
+		PostTiming memory = { "Load/Store", (uint32_t)i, 0.0, 0.0 };
+		m_timings.push_back(memory);
+
+		Timer timer;
+		std::vector<double> times;
+		RunSweep(sweep, *source, *target, jobs, times);
+		double milliseconds = timer.ElapsedMilliseconds();
+		double total = 0.0;
+		for (size_t j = 0; j < times.size(); ++j)
+			total += times[j];
+		for (size_t j = 0; j < times.size(); ++j)
+			m_timings[first + j].SweepMilliseconds = total > 0.0 ?
+					milliseconds * times[j] / total : 0.0;
+		source = target;
+	}
+	return true;
+}
+
+void PostProcessChain::RunSweep(const std::vector<PostStage*>& stages, const ColorBuffer& source,
+		ColorBuffer& target, JobSystem* jobs, std::vector<double>& times) const {
+	const uint32_t width = source.GetWidth();
+	const uint32_t height = source.GetHeight();
+	const bool gather = !stages.empty() && stages[0]->GetType() == POST_STAGE_GATHER;
+	const size_t firstPixelStage = gather ? 1 : 0;
+	const size_t memory = stages.size();
+	const uint32_t bands = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+	// Every band keeps its own times, so jobs never share a counter.
+	std::vector<double> bandTimes(bands * (memory + 1), 0.0);
+	ParallelFor(jobs, bands, 1, [&](uint32_t begin, uint32_t end) {
+		XMVECTOR pixels[TILE_HEIGHT][TILE_WIDTH];
+		Timer timer;
+		for (uint32_t band = begin; band < end; ++band) {
+			const uint32_t top = band * TILE_HEIGHT;
+			const uint32_t rows = std::min(top + TILE_HEIGHT, height) - top;
+			double* bandTime = &bandTimes[band * (memory + 1)];
+			for (uint32_t left = 0; left < width; left += TILE_WIDTH) {
+				const uint32_t count = std::min(TILE_WIDTH, width - left);
+				double last = timer.ElapsedMilliseconds();
+				for (uint32_t r = 0; r < rows; ++r) {
+					if (gather) {
+						stages[0]->Gather(source, left, top + r, count, pixels[r]);
+					} else {
+						const XMFLOAT4* in = source.GetRow(top + r) + left;
+						for (uint32_t i = 0; i < count; ++i)
+							pixels[r][i] = XMLoadFloat4(&in[i]);
+					}
+				}
+				double now = timer.ElapsedMilliseconds();
+				bandTime[gather ? 0 : memory] += now - last;
+				last = now;
+				for (size_t s = firstPixelStage; s < stages.size(); ++s) {
+					for (uint32_t r = 0; r < rows; ++r)
+						stages[s]->Transform(left, top + r, count, pixels[r]);
+					now = timer.ElapsedMilliseconds();
+					bandTime[s] += now - last;
+					last = now;
+				}
+				for (uint32_t r = 0; r < rows; ++r) {
+					XMFLOAT4* out = target.GetRow(top + r) + left;
+					for (uint32_t i = 0; i < count; ++i)
+						XMStoreFloat4(&out[i], pixels[r][i]);
+				}
+				bandTime[memory] += timer.ElapsedMilliseconds() - last;
+			}
+		}
+	});
+	times.assign(memory + 1, 0.0);
+	for (uint32_t band = 0; band < bands; ++band) {
+		for (size_t s = 0; s <= memory; ++s)
+			times[s] += bandTimes[band * (memory + 1) + s];
+	}
+}
+
+void PostProcessChain::PrintTimings(FILE* file) const {
+	fprintf(file, "%-6s %-24s %10s %10s\n", "Sweep", "Stage", "Prepare ms", "Sweep ms");
+	double prepare = 0.0;
+	double sweep = 0.0;
+	for (size_t i = 0; i < m_timings.size(); ++i) {
+		const PostTiming& timing = m_timings[i];
+		fprintf(file, "%-6u %-24s %10.3f %10.3f\n", timing.Sweep, timing.Name.c_str(),
+				timing.PrepareMilliseconds, timing.SweepMilliseconds);
+		prepare += timing.PrepareMilliseconds;
+		sweep += timing.SweepMilliseconds;
+	}
+	fprintf(file, "%-6s %-24s %10.3f %10.3f\n", "", "Total", prepare, sweep);
+}
+
+uint32_t ComputeGaussianWeights(float sigma, uint32_t maxRadius, float* weights) {
+	if (sigma <= 0.0f || maxRadius == 0) {
+		weights[0] = 1.0f;
+		return 0;
+	}
+	uint32_t radius = std::min(maxRadius, (uint32_t)ceilf(3.0f * sigma));
+	float sum = 0.0f;
+	for (uint32_t i = 0; i <= radius; ++i) {
+		weights[i] = expf(-(float)(i * i) / (2.0f * sigma * sigma));
+		sum += i ? 2.0f * weights[i] : weights[i];
+	}
+	for (uint32_t i = 0; i <= radius; ++i)
+		weights[i] /= sum;
+	return radius;
+}
+
+void BlurSeparable(ColorBuffer& image, ColorBuffer& temp, const float* weights, uint32_t radius,
+		JobSystem* jobs) {
+	const uint32_t width = image.GetWidth();
+	const uint32_t height = image.GetHeight();
+	if (width == 0 || height == 0 || radius == 0)
+		return;
+	radius = std::min(radius, MAX_BLUR_RADIUS);
+	temp.Initialize(width, height);
+
+	ParallelFor(jobs, height, 16, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y) {
+			const XMFLOAT4* in = image.GetRow(y);
+			XMFLOAT4* out = temp.GetRow(y);
+			for (uint32_t x = 0; x < width; ++x) {
+				XMVECTOR sum = XMVectorScale(XMLoadFloat4(&in[x]), weights[0]);
+				for (uint32_t k = 1; k <= radius; ++k) {
+					uint32_t left = ClampIndex((int32_t)(x - k), width);
+					uint32_t right = ClampIndex((int32_t)(x + k), width);
+					XMVECTOR pair = XMVectorAdd(XMLoadFloat4(&in[left]), XMLoadFloat4(&in[right]));
+					sum = XMVectorMultiplyAdd(pair, XMVectorReplicate(weights[k]), sum);
+				}
+				XMStoreFloat4(&out[x], sum);
+			}
+		}
+	});
+
+	// The vertical pass walks whole rows, so every tap reads memory in
+	// order.
+	ParallelFor(jobs, height, 16, [&](uint32_t begin, uint32_t end) {
+		const XMFLOAT4* above[MAX_BLUR_RADIUS + 1];
+		const XMFLOAT4* below[MAX_BLUR_RADIUS + 1];
+		for (uint32_t y = begin; y < end; ++y) {
+			for (uint32_t k = 1; k <= radius; ++k) {
+				above[k] = temp.GetRow(ClampIndex((int32_t)(y - k), height));
+				below[k] = temp.GetRow(ClampIndex((int32_t)(y + k), height));
+			}
+			const XMFLOAT4* in = temp.GetRow(y);
+			XMFLOAT4* out = image.GetRow(y);
+			for (uint32_t x = 0; x < width; ++x) {
+				XMVECTOR sum = XMVectorScale(XMLoadFloat4(&in[x]), weights[0]);
+				for (uint32_t k = 1; k <= radius; ++k) {
+					XMVECTOR pair = XMVectorAdd(XMLoadFloat4(&above[k][x]),
+							XMLoadFloat4(&below[k][x]));
+					sum = XMVectorMultiplyAdd(pair, XMVectorReplicate(weights[k]), sum);
+				}
+				XMStoreFloat4(&out[x], sum);
+			}
+		}
+	});
+}
+
+BloomStage::BloomStage()
+		: PostStage(POST_STAGE_PIXEL), m_levelCount(0), m_scaleX(0.0f), m_scaleY(0.0f) {
+	m_settings.Threshold = 1.0f;
+	m_settings.Intensity = 0.5f;
+	m_settings.Levels = 5;
+	m_settings.Sigma = 2.0f;
+	m_weights[0] = 1.0f;
+}
+
+bool BloomStage::Prepare(const ColorBuffer& source, JobSystem* jobs) {
+	if (m_settings.Intensity <= 0.0f)
+		return false;
+	const uint32_t levels = std::max(1u, std::min(m_settings.Levels, MAX_BLOOM_LEVELS));
+	uint32_t width = source.GetWidth();
+	uint32_t height = source.GetHeight();
+	m_levelCount = 0;
+	while (m_levelCount < levels && (width > 1 || height > 1)) {
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		m_levels[m_levelCount++].Initialize(width, height);
+	}
+	if (m_levelCount == 0)
+		return false;
+
+	// Bright pass fused with the first downsample. Scaling by the luma
+	// above the threshold keeps the hue of what blooms; with the threshold
+	// at 0 or above, black never divides by zero.
+	Downsample(source, m_levels[0], jobs);
+	const float threshold = std::max(m_settings.Threshold, 0.0f);
+	ColorBuffer& first = m_levels[0];
+	ParallelFor(jobs, first.GetHeight(), 16, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y) {
+			XMFLOAT4* row = first.GetRow(y);
+			for (uint32_t x = 0; x < first.GetWidth(); ++x) {
+				XMVECTOR color = XMLoadFloat4(&row[x]);
+				float luma = Luma(color);
+				float scale = luma > threshold ? (luma - threshold) / luma : 0.0f;
+				XMStoreFloat4(&row[x], XMVectorScale(color, scale));
+			}
+		}
+	});
+	for (uint32_t i = 1; i < m_levelCount; ++i)
+		Downsample(m_levels[i - 1], m_levels[i], jobs);
+
+	uint32_t radius = ComputeGaussianWeights(m_settings.Sigma, MAX_BLUR_RADIUS, m_weights);
+	for (uint32_t i = 0; i < m_levelCount; ++i)
+		BlurSeparable(m_levels[i], m_temp[i], m_weights, radius, jobs);
+
+	// Add each level onto the next larger one, smallest first, so level 0
+	// ends up with the sum of the whole chain.
+	for (uint32_t i = m_levelCount - 1; i > 0; --i) {
+		const ColorBuffer& smaller = m_levels[i];
+		ColorBuffer& larger = m_levels[i - 1];
+		const float scaleX = (float)smaller.GetWidth() / larger.GetWidth();
+		const float scaleY = (float)smaller.GetHeight() / larger.GetHeight();
+		ParallelFor(jobs, larger.GetHeight(), 16, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t y = begin; y < end; ++y) {
+				XMFLOAT4* row = larger.GetRow(y);
+				float sy = (y + 0.5f) * scaleY - 0.5f;
+				for (uint32_t x = 0; x < larger.GetWidth(); ++x) {
+					XMVECTOR add = SampleBilinear(smaller, (x + 0.5f) * scaleX - 0.5f, sy);
+					XMStoreFloat4(&row[x], XMVectorAdd(XMLoadFloat4(&row[x]), add));
+				}
+			}
+		});
+	}
+
+	m_scaleX = (float)first.GetWidth() / source.GetWidth();
+	m_scaleY = (float)first.GetHeight() / source.GetHeight();
+	return true;
+}
+
+void BloomStage::Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const {
+	const float intensity = m_settings.Intensity / m_levelCount;
+	const XMVECTOR scale = XMVectorSet(intensity, intensity, intensity, 0.0f);
+	const float sy = (y + 0.5f) * m_scaleY - 0.5f;
+	for (uint32_t i = 0; i < count; ++i) {
+		XMVECTOR bloom = SampleBilinear(m_levels[0], (x + i + 0.5f) * m_scaleX - 0.5f, sy);
+		pixels[i] = XMVectorMultiplyAdd(bloom, scale, pixels[i]);
+	}
+}
+
+TonemapStage::TonemapStage() : PostStage(POST_STAGE_PIXEL) {
+	m_settings.Operator = TONEMAP_ACES;
+	m_settings.Exposure = 0.0f;
+}
+
+void TonemapStage::Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const {
+	(void)x;
+	(void)y;
+	const XMVECTOR exposure = XMVectorReplicate(powf(2.0f, m_settings.Exposure));
+	const XMVECTOR gamma = XMVectorReplicate(1.0f / 2.2f);
+	const XMVECTOR a = XMVectorReplicate(2.51f);
+	const XMVECTOR b = XMVectorReplicate(0.03f);
+	const XMVECTOR c = XMVectorReplicate(2.43f);
+	const XMVECTOR d = XMVectorReplicate(0.59f);
+	const XMVECTOR e = XMVectorReplicate(0.14f);
+	for (uint32_t i = 0; i < count; ++i) {
+		XMVECTOR color = XMVectorMax(XMVectorMultiply(pixels[i], exposure), XMVectorZero());
+		XMVECTOR mapped;
+		if (m_settings.Operator == TONEMAP_REINHARD) {
+			mapped = XMVectorDivide(color, XMVectorAdd(color, g_XMOne));
+		} else {
+			XMVECTOR numerator = XMVectorMultiply(color, XMVectorMultiplyAdd(color, a, b));
+			XMVECTOR denominator = XMVectorMultiplyAdd(color, XMVectorMultiplyAdd(color, c, d), e);
+			mapped = XMVectorSaturate(XMVectorDivide(numerator, denominator));
+		}
+		mapped = XMVectorPow(mapped, gamma);
+		pixels[i] = XMVectorSelect(pixels[i], mapped, g_XMSelect1110);
+	}
+}
+
+ColorGradingStage::ColorGradingStage() : PostStage(POST_STAGE_PIXEL), m_size(0) {
+}
+
+bool ColorGradingStage::Initialize(uint32_t size) {
+	if (size < 2 || size > 64)
+		return false;
+	m_size = size;
+	m_table.resize(size * size * size);
+	const float scale = 1.0f / (size - 1);
+	for (uint32_t b = 0; b < size; ++b) {
+		for (uint32_t g = 0; g < size; ++g) {
+			for (uint32_t r = 0; r < size; ++r)
+				m_table[(b * size + g) * size + r] = XMFLOAT4(r * scale, g * scale, b * scale,
+						0.0f);
+		}
+	}
+	return true;
+}
+
+bool ColorGradingStage::SetTable(uint32_t size, const XMFLOAT3* table) {
+	if (!table || !Initialize(size))
+		return false;
+	for (size_t i = 0; i < m_table.size(); ++i)
+		m_table[i] = XMFLOAT4(table[i].x, table[i].y, table[i].z, 0.0f);
+	return true;
+}
+
+bool ColorGradingStage::Prepare(const ColorBuffer& source, JobSystem* jobs) {
+	(void)source;
+	(void)jobs;
+	return m_size != 0;
+}
+
+void ColorGradingStage::Transform(uint32_t x, uint32_t y, uint32_t count,
+		XMVECTOR* pixels) const {
+	(void)x;
+	(void)y;
+	const uint32_t size = m_size;
+	const XMVECTOR last = XMVectorReplicate((float)(size - 1));
+	const XMFLOAT4* table = &m_table[0];
+	for (uint32_t i = 0; i < count; ++i) {
+		XMFLOAT4 coordinate;
+		XMStoreFloat4(&coordinate, XMVectorMultiply(XMVectorSaturate(pixels[i]), last));
+		uint32_t r = std::min((uint32_t)coordinate.x, size - 2);
+		uint32_t g = std::min((uint32_t)coordinate.y, size - 2);
+		uint32_t b = std::min((uint32_t)coordinate.z, size - 2);
+		float fr = coordinate.x - r;
+		float fg = coordinate.y - g;
+		float fb = coordinate.z - b;
+
+		// Trilinear: red between neighbours, then green, then blue.
+		const XMFLOAT4* p = table + (b * size + g) * size + r;
+		const size_t dg = size;
+		const size_t db = (size_t)size * size;
+		XMVECTOR c00 = XMVectorLerp(XMLoadFloat4(p), XMLoadFloat4(p + 1), fr);
+		XMVECTOR c10 = XMVectorLerp(XMLoadFloat4(p + dg), XMLoadFloat4(p + dg + 1), fr);
+		XMVECTOR c01 = XMVectorLerp(XMLoadFloat4(p + db), XMLoadFloat4(p + db + 1), fr);
+		XMVECTOR c11 = XMVectorLerp(XMLoadFloat4(p + db + dg), XMLoadFloat4(p + db + dg + 1),
+				fr);
+		XMVECTOR graded = XMVectorLerp(XMVectorLerp(c00, c10, fg), XMVectorLerp(c01, c11, fg),
+				fb);
+		pixels[i] = XMVectorSelect(pixels[i], graded, g_XMSelect1110);
+	}
+}
+
+FxaaStage::FxaaStage() : PostStage(POST_STAGE_GATHER) {
+	m_settings.EdgeThreshold = 0.125f;
+	m_settings.SpanMax = 8.0f;
+}
+
+// The console FXAA variant: the luma gradient over the four diagonal
+// neighbours gives the edge direction, and two or four bilinear taps
+// along it replace the pixel unless they overshoot the local luma range.
+void FxaaStage::Gather(const ColorBuffer& source, uint32_t x, uint32_t y, uint32_t count,
+		XMVECTOR* pixels) const {
+	const float REDUCE_MIN = 1.0f / 128.0f;
+	const float REDUCE_MUL = 1.0f / 8.0f;
+	const float THRESHOLD_MIN = 1.0f / 32.0f;
+	const uint32_t width = source.GetWidth();
+	const uint32_t height = source.GetHeight();
+	const XMFLOAT4* above = source.GetRow(ClampIndex((int32_t)y - 1, height));
+	const XMFLOAT4* row = source.GetRow(y);
+	const XMFLOAT4* below = source.GetRow(ClampIndex((int32_t)y + 1, height));
+	const float spanMax = m_settings.SpanMax;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		const uint32_t cx = x + i;
+		const uint32_t left = ClampIndex((int32_t)cx - 1, width);
+		const uint32_t right = ClampIndex((int32_t)cx + 1, width);
+		XMVECTOR center = XMLoadFloat4(&row[cx]);
+		float lumaM = Luma(center);
+		float lumaNW = Luma(XMLoadFloat4(&above[left]));
+		float lumaNE = Luma(XMLoadFloat4(&above[right]));
+		float lumaSW = Luma(XMLoadFloat4(&below[left]));
+		float lumaSE = Luma(XMLoadFloat4(&below[right]));
+		float lumaMin = std::min(lumaM, std::min(std::min(lumaNW, lumaNE),
+				std::min(lumaSW, lumaSE)));
+		float lumaMax = std::max(lumaM, std::max(std::max(lumaNW, lumaNE),
+				std::max(lumaSW, lumaSE)));
+		if (lumaMax - lumaMin < std::max(THRESHOLD_MIN, lumaMax * m_settings.EdgeThreshold)) {
+			pixels[i] = center;
+			continue;
+		}
+
+		float dirX = (lumaSW + lumaSE) - (lumaNW + lumaNE);
+		float dirY = (lumaNW + lumaSW) - (lumaNE + lumaSE);
+		float reduce = std::max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25f * REDUCE_MUL,
+				REDUCE_MIN);
+		float scale = 1.0f / (std::min(fabsf(dirX), fabsf(dirY)) + reduce);
+		dirX = std::min(spanMax, std::max(-spanMax, dirX * scale));
+		dirY = std::min(spanMax, std::max(-spanMax, dirY * scale));
+
+		// Pixel centers are whole texel coordinates for SampleBilinear().
+		const float px = (float)cx;
+		const float py = (float)y;
+		XMVECTOR a = XMVectorAdd(SampleBilinear(source, px - dirX / 6.0f, py - dirY / 6.0f),
+				SampleBilinear(source, px + dirX / 6.0f, py + dirY / 6.0f));
+		a = XMVectorScale(a, 0.5f);
+		XMVECTOR b = XMVectorAdd(SampleBilinear(source, px - dirX * 0.5f, py - dirY * 0.5f),
+				SampleBilinear(source, px + dirX * 0.5f, py + dirY * 0.5f));
+		b = XMVectorMultiplyAdd(b, XMVectorReplicate(0.25f), XMVectorScale(a, 0.5f));
+		float lumaB = Luma(b);
+		XMVECTOR result = lumaB < lumaMin || lumaB > lumaMax ? a : b;
+		pixels[i] = XMVectorSelect(center, result, g_XMSelect1110);
+	}
+}
+
+VignetteStage::VignetteStage()
+		: PostStage(POST_STAGE_PIXEL), m_centerX(0.0f), m_centerY(0.0f), m_inverseExtent(0.0f) {
+	m_settings.Intensity = 0.3f;
+	m_settings.Radius = 0.5f;
+}
+
+bool VignetteStage::Prepare(const ColorBuffer& source, JobSystem* jobs) {
+	(void)jobs;
+	m_centerX = source.GetWidth() * 0.5f;
+	m_centerY = source.GetHeight() * 0.5f;
+	m_inverseExtent = 1.0f / sqrtf(m_centerX * m_centerX + m_centerY * m_centerY);
+	return m_settings.Intensity > 0.0f && m_settings.Radius < 1.0f;
+}
+
+void VignetteStage::Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const {
+	const float dy = (y + 0.5f - m_centerY) * m_inverseExtent;
+	const float inverseFalloff = 1.0f / (1.0f - m_settings.Radius);
+	for (uint32_t i = 0; i < count; ++i) {
+		float dx = (x + i + 0.5f - m_centerX) * m_inverseExtent;
+		float t = (sqrtf(dx * dx + dy * dy) - m_settings.Radius) * inverseFalloff;
+		if (t <= 0.0f)
+			continue;
+		t = std::min(t, 1.0f);
+		float factor = 1.0f - m_settings.Intensity * t * t * (3.0f - 2.0f * t);
+		pixels[i] = XMVectorMultiply(pixels[i], XMVectorSet(factor, factor, factor, 1.0f));
+	}
+}
+
+} // namespace Zeus
@@ -0,0 +1,279 @@
+/*
+ * PostProcess.h
+ *
+ * Post-processing chain for the CPU backend. A chain is an ordered list of
+ * stages of two kinds:
+ *
+ * - Pixel stages map one pixel to one pixel (tonemapping, grading LUTs,
+ *   vignette, bloom composite).
+ * - Gather stages read a neighbourhood of their input (FXAA).
+ *
+ * Execute() fuses each gather stage with the pixel stages that follow it,
+ * and any leading pixel stages with each other, into a single sweep. A
+ * sweep walks the image in tiles, keeps a span of pixels in xnamath
+ * registers while every fused stage runs over it and writes it out once,
+ * so the frame buffer is read and written once per sweep rather than once
+ * per effect.
+ *
+ * Stages that need data of their own, such as the bloom blur chain, build
+ * it in Prepare() from the image their sweep reads.
+ *
+ * Timings are kept per stage. A sweep runs each stage over a whole tile
+ * before the next, with the tile held on the stack, and clocks every
+ * stage and the loads and stores per tile; each stage is then given its
+ * share of the sweep's wall time.
+ */
+
+#ifndef POSTPROCESS_H_
+#define POSTPROCESS_H_
+
+#include "SoftwareRasterizer.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum PostStageType {
+	POST_STAGE_PIXEL,
+	POST_STAGE_GATHER
+};
+
+class PostStage {
+public:
+	explicit PostStage(PostStageType type) : m_type(type), m_enabled(true) {}
+	virtual ~PostStage() {}
+
+	virtual const char* GetName() const = 0;
+	// Called before the sweep this stage runs in, with the image that sweep
+	// reads. Returns false to skip the stage for this frame.
+	virtual bool Prepare(const ColorBuffer& source, JobSystem* jobs) {
+		(void)source;
+		(void)jobs;
+		return true;
+	}
+	// Gather stages: writes count pixels of row y starting at column x.
+	virtual void Gather(const ColorBuffer& source, uint32_t x, uint32_t y, uint32_t count,
+			XMVECTOR* pixels) const {
+		(void)source;
+		(void)x;
+		(void)y;
+		(void)count;
+		(void)pixels;
+	}
+	// Pixel stages: transforms count pixels of row y starting at column x
+	// in place.
+	virtual void Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const {
+		(void)x;
+		(void)y;
+		(void)count;
+		(void)pixels;
+	}
+
+	PostStageType GetType() const { return m_type; }
+	bool IsEnabled() const { return m_enabled; }
+	void SetEnabled(bool enabled) { m_enabled = enabled; }
+
+private:
+	PostStage(const PostStage&);
+	PostStage& operator=(const PostStage&);
+
+	PostStageType m_type;
+	bool m_enabled;
+};
+
+// One entry per stage, then one for the loads and stores of its sweep.
+struct PostTiming {
+	// Stage name, or "Load/Store".
+	std::string Name;
+	// Index of the sweep the stage was fused into.
+	uint32_t Sweep;
+	// Prepare(), such as building the bloom chain.
+	double PrepareMilliseconds;
+	// Share of the sweep's wall time, by the time spent in the stage.
+	double SweepMilliseconds;
+};
+
+class PostProcessChain {
+public:
+	PostProcessChain();
+
+	// Stages are not owned and run in the order they were added.
+	void AddStage(PostStage* stage);
+	void ClearStages();
+
+	// output must not be input. Returns false if either is empty or they
+	// differ in size.
+	bool Execute(const ColorBuffer& input, ColorBuffer& output, JobSystem* jobs);
+
+	// Timings of the last Execute().
+	const std::vector<PostTiming>& GetTimings() const { return m_timings; }
+	void PrintTimings(FILE* file) const;
+
+private:
+	PostProcessChain(const PostProcessChain&);
+	PostProcessChain& operator=(const PostProcessChain&);
+
+	// A gather stage can only come first in a sweep. times gets the time
+	// spent in each stage and, last, in loads and stores.
+	void RunSweep(const std::vector<PostStage*>& stages, const ColorBuffer& source,
+			ColorBuffer& target, JobSystem* jobs, std::vector<double>& times) const;
+
+	std::vector<PostStage*> m_stages;
+	std::vector<std::vector<PostStage*> > m_sweeps;
+	ColorBuffer m_buffers[2];
+	std::vector<PostTiming> m_timings;
+};
+
+// Normalized Gaussian taps 0..radius, radius = ceil(3 sigma) capped at
+// maxRadius. weights needs maxRadius + 1 entries. Returns the radius.
+uint32_t ComputeGaussianWeights(float sigma, uint32_t maxRadius, float* weights);
+// Symmetric separable blur in place, horizontal then vertical, clamping at
+// the edges. temp is resized to match image.
+void BlurSeparable(ColorBuffer& image, ColorBuffer& temp, const float* weights, uint32_t radius,
+		JobSystem* jobs);
+
+const uint32_t MAX_BLOOM_LEVELS = 6;
+const uint32_t MAX_BLUR_RADIUS = 16;
+
+struct BloomSettings {
+	// Luminance where blooming starts; below 0 counts as 0.
+	float Threshold;
+	float Intensity;
+	// Half, quarter, ... resolution levels, 1 to MAX_BLOOM_LEVELS.
+	uint32_t Levels;
+	// Blur sigma in texels of each level.
+	float Sigma;
+};
+
+// Bright parts of the scene blurred over a chain of half resolution
+// levels and added back on top.
+class BloomStage : public PostStage {
+public:
+	BloomStage();
+
+	const char* GetName() const { return "Bloom"; }
+	bool Prepare(const ColorBuffer& source, JobSystem* jobs);
+	void Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const;
+
+	const BloomSettings& GetSettings() const { return m_settings; }
+	void SetSettings(const BloomSettings& settings) { m_settings = settings; }
+
+private:
+	BloomSettings m_settings;
+	ColorBuffer m_levels[MAX_BLOOM_LEVELS];
+	ColorBuffer m_temp[MAX_BLOOM_LEVELS];
+	uint32_t m_levelCount;
+	float m_weights[MAX_BLUR_RADIUS + 1];
+	// Source pixel to level 0 texel scale.
+	float m_scaleX;
+	float m_scaleY;
+};
+
+enum TonemapOperator {
+	TONEMAP_REINHARD,
+	// Narkowicz's fit of the ACES filmic curve.
+	TONEMAP_ACES
+};
+
+struct TonemapSettings {
+	TonemapOperator Operator;
+	// Stops; color is scaled by 2^Exposure.
+	float Exposure;
+};
+
+// Exposure and tonemapping of linear HDR color, then gamma 2.2 encoding.
+// Alpha is left alone.
+class TonemapStage : public PostStage {
+public:
+	TonemapStage();
+
+	const char* GetName() const { return "Tonemap"; }
+	void Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const;
+
+	const TonemapSettings& GetSettings() const { return m_settings; }
+	void SetSettings(const TonemapSettings& settings) { m_settings = settings; }
+
+private:
+	TonemapSettings m_settings;
+};
+
+// 3D lookup table color grading of display referred color in [0, 1].
+class ColorGradingStage : public PostStage {
+public:
+	ColorGradingStage();
+
+	const char* GetName() const { return "ColorGrading"; }
+	bool Prepare(const ColorBuffer& source, JobSystem* jobs);
+	void Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const;
+
+	// Resets the table to identity; size is 2 to 64 entries per axis.
+	bool Initialize(uint32_t size);
+	// size^3 entries with red varying fastest, then green, then blue.
+	bool SetTable(uint32_t size, const XMFLOAT3* table);
+	uint32_t GetSize() const { return m_size; }
+
+private:
+	std::vector<XMFLOAT4> m_table;
+	uint32_t m_size;
+};
+
+struct FxaaSettings {
+	// Edges with less local contrast than this are left alone.
+	float EdgeThreshold;
+	// Longest search along an edge, in pixels.
+	float SpanMax;
+};
+
+// Fast approximate anti-aliasing on display referred color. Luma comes
+// from the color itself, so the input alpha need not hold it.
+class FxaaStage : public PostStage {
+public:
+	FxaaStage();
+
+	const char* GetName() const { return "FXAA"; }
+	void Gather(const ColorBuffer& source, uint32_t x, uint32_t y, uint32_t count,
+			XMVECTOR* pixels) const;
+
+	const FxaaSettings& GetSettings() const { return m_settings; }
+	void SetSettings(const FxaaSettings& settings) { m_settings = settings; }
+
+private:
+	FxaaSettings m_settings;
+};
+
+struct VignetteSettings {
+	// Darkening at the corners, 0 to 1.
+	float Intensity;
+	// Distance from the center, 1 at the corners, where darkening starts.
+	float Radius;
+};
+
+class VignetteStage : public PostStage {
+public:
+	VignetteStage();
+
+	const char* GetName() const { return "Vignette"; }
+	bool Prepare(const ColorBuffer& source, JobSystem* jobs);
+	void Transform(uint32_t x, uint32_t y, uint32_t count, XMVECTOR* pixels) const;
+
+	const VignetteSettings& GetSettings() const { return m_settings; }
+	void SetSettings(const VignetteSettings& settings) { m_settings = settings; }
+
+private:
+	VignetteSettings m_settings;
+	float m_centerX;
+	float m_centerY;
+	float m_inverseExtent;
+};
+
+} // namespace Zeus
+
+#endif /* POSTPROCESS_H_ */
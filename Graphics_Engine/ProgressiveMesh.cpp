@@ -0,0 +1,569 @@
+/*
+ * ProgressiveMesh.cpp
+ *
+ */
+
+#include "ProgressiveMesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <utility>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = 0xffffffff;
+// Triangles with two corners at one position, which the simplifier drops.
+const uint32_t DROPPED = 0xfffffffe;
+// "ZPM1"
+const uint32_t FILE_MAGIC = 0x314d505a;
+const uint32_t FILE_VERSION = 1;
+
+struct FileHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VertexStride;
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+	uint32_t BaseVertexCount;
+	uint32_t BaseTriangleCount;
+	uint32_t SplitCount;
+	float BaseError;
+};
+
+// Followed by the vertices, the corners and the triangles of the split.
+struct SplitHeader {
+	float Error;
+	uint32_t VertexCount;
+	uint32_t CornerCount;
+	uint32_t TriangleCount;
+};
+
+// Whether two corners share a position, compared bit for bit as the
+// simplifier compares them.
+bool IsDegenerate(const SimplifySource& source, const uint32_t* triangle) {
+	uint32_t stride = source.PositionStride ? source.PositionStride : sizeof(XMFLOAT3);
+	const uint8_t* positions = reinterpret_cast<const uint8_t*>(source.Positions);
+	for (uint32_t k = 0; k < 3; ++k) {
+		const uint8_t* a = positions + (size_t)triangle[k] * stride;
+		const uint8_t* b = positions + (size_t)triangle[(k + 1) % 3] * stride;
+		if (memcmp(a, b, sizeof(XMFLOAT3)) == 0)
+			return true;
+	}
+	return false;
+}
+
+void Extend(uint32_t& begin, uint32_t& end, uint32_t first, uint32_t last) {
+	if (first == last)
+		return;
+	if (begin == end) {
+		begin = first;
+		end = last;
+	} else {
+		begin = std::min(begin, first);
+		end = std::max(end, last);
+	}
+}
+
+} // namespace
+
+void BuildProgressiveMesh(const SimplifySource& source, const void* vertices,
+		uint32_t vertexStride, const SimplifySettings& settings, uint32_t baseTriangles,
+		ProgressiveMeshData& result, JobSystem* jobs) {
+	SimplifyHistory history;
+	SimplifyLod base;
+	Simplify(source, settings, baseTriangles, base, jobs, &history);
+
+	// Replay the collapses, noting which corners each one moved and which
+	// triangles it removed. Corners of a vertex form a list that moves
+	// along with it; corners of removed triangles are skipped lazily.
+	uint32_t vertexCount = source.VertexCount;
+	uint32_t triangleCount = source.IndexCount / 3;
+	uint32_t collapseCount = (uint32_t)history.Collapses.size();
+	std::vector<uint32_t> current(source.Indices, source.Indices + triangleCount * 3);
+	std::vector<uint32_t> heads(vertexCount, NONE);
+	std::vector<uint32_t> tails(vertexCount, NONE);
+	std::vector<uint32_t> next(triangleCount * 3, NONE);
+	std::vector<uint32_t> deaths(triangleCount, NONE);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (IsDegenerate(source, &current[t * 3])) {
+			deaths[t] = DROPPED;
+			continue;
+		}
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t corner = t * 3 + k;
+			uint32_t vertex = current[corner];
+			if (heads[vertex] == NONE)
+				heads[vertex] = corner;
+			else
+				next[tails[vertex]] = corner;
+			tails[vertex] = corner;
+		}
+	}
+
+	// Corners moved by every collapse, with the vertex they left.
+	std::vector<uint32_t> changeOffsets(collapseCount + 1, 0);
+	std::vector<ProgressiveCorner> changes;
+	// Indices of removed triangles as they were before their collapse.
+	std::vector<uint32_t> removed(triangleCount * 3);
+	std::vector<ProgressiveCorner> moved;
+	// The split of an earlier collapse that moved a corner must wait for
+	// the splits of the later collapses that moved it again or removed its
+	// triangle. Each pair holds the later collapse, then the earlier one.
+	std::vector<uint32_t> lastMoves(triangleCount * 3, NONE);
+	std::vector<std::pair<uint32_t, uint32_t> > dependencies;
+	for (uint32_t c = 0; c < collapseCount; ++c) {
+		const SimplifyCollapse& collapse = history.Collapses[c];
+		moved.clear();
+		for (uint32_t k = 0; k < collapse.PairCount; ++k) {
+			uint32_t from = history.From[collapse.FirstPair + k];
+			uint32_t to = history.To[collapse.FirstPair + k];
+			for (uint32_t corner = heads[from]; corner != NONE; corner = next[corner]) {
+				if (deaths[corner / 3] == NONE) {
+					current[corner] = to;
+					ProgressiveCorner change = { corner, from };
+					moved.push_back(change);
+				}
+			}
+			if (heads[from] != NONE) {
+				if (heads[to] == NONE)
+					heads[to] = heads[from];
+				else
+					next[tails[to]] = heads[from];
+				tails[to] = tails[from];
+				heads[from] = NONE;
+				tails[from] = NONE;
+			}
+		}
+		for (size_t i = 0; i < moved.size(); ++i) {
+			uint32_t t = moved[i].Index / 3;
+			if (deaths[t] == NONE && IsDegenerate(source, &current[t * 3])) {
+				deaths[t] = c;
+				std::copy(&current[t * 3], &current[t * 3] + 3, &removed[t * 3]);
+				for (uint32_t k = 0; k < 3; ++k) {
+					if (lastMoves[t * 3 + k] != NONE)
+						dependencies.push_back(std::make_pair(c, lastMoves[t * 3 + k]));
+				}
+			}
+		}
+		for (size_t i = 0; i < moved.size(); ++i) {
+			uint32_t t = moved[i].Index / 3;
+			if (deaths[t] == c) {
+				removed[moved[i].Index] = moved[i].Vertex;
+			} else {
+				changes.push_back(moved[i]);
+				if (lastMoves[moved[i].Index] != NONE)
+					dependencies.push_back(std::make_pair(c, lastMoves[moved[i].Index]));
+				lastMoves[moved[i].Index] = c;
+			}
+		}
+		changeOffsets[c + 1] = (uint32_t)changes.size();
+	}
+
+	// A removed triangle comes back only once the wedges it held exist again.
+	std::vector<uint32_t> collapsedBy(vertexCount, NONE);
+	for (uint32_t c = 0; c < collapseCount; ++c) {
+		const SimplifyCollapse& collapse = history.Collapses[c];
+		for (uint32_t k = 0; k < collapse.PairCount; ++k)
+			collapsedBy[history.From[collapse.FirstPair + k]] = c;
+	}
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (deaths[t] >= collapseCount)
+			continue;
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t c = collapsedBy[removed[t * 3 + k]];
+			if (c != NONE && c != deaths[t])
+				dependencies.push_back(std::make_pair(c, deaths[t]));
+		}
+	}
+
+	// Triangles removed by every collapse.
+	std::vector<uint32_t> deathOffsets(collapseCount + 1, 0);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (deaths[t] < collapseCount)
+			++deathOffsets[deaths[t] + 1];
+	}
+	for (uint32_t c = 0; c < collapseCount; ++c)
+		deathOffsets[c + 1] += deathOffsets[c];
+	std::vector<uint32_t> deathOrder(deathOffsets[collapseCount]);
+	{
+		std::vector<uint32_t> cursor(deathOffsets.begin(), deathOffsets.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			if (deaths[t] < collapseCount)
+				deathOrder[cursor[deaths[t]]++] = t;
+		}
+	}
+
+	// Base vertices in order of first use, then the wedges of every split.
+	std::vector<uint32_t> remap(vertexCount, NONE);
+	std::vector<uint32_t> positions(triangleCount, NONE);
+	uint32_t nextVertex = 0;
+	uint32_t nextTriangle = 0;
+	result.Indices.clear();
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (deaths[t] != NONE)
+			continue;
+		positions[t] = nextTriangle++;
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t vertex = current[t * 3 + k];
+			if (remap[vertex] == NONE)
+				remap[vertex] = nextVertex++;
+			result.Indices.push_back(remap[vertex]);
+		}
+	}
+	result.BaseVertexCount = nextVertex;
+	result.BaseTriangleCount = nextTriangle;
+
+	// Splits undo the most costly collapse whose dependencies are met, the
+	// latest one on a tie. A split waited on is as urgent as the costliest
+	// split waiting on it, so expensive collapses deep in a chain still
+	// come early. Collapses made in independent chunks, or out of cost
+	// order, so interleave into one stream that refines the worst spots
+	// first.
+	std::vector<uint32_t> waits(collapseCount, 0);
+	std::vector<uint32_t> successorOffsets(collapseCount + 1, 0);
+	for (size_t i = 0; i < dependencies.size(); ++i) {
+		++waits[dependencies[i].second];
+		++successorOffsets[dependencies[i].first + 1];
+	}
+	for (uint32_t c = 0; c < collapseCount; ++c)
+		successorOffsets[c + 1] += successorOffsets[c];
+	std::vector<uint32_t> successors(dependencies.size());
+	{
+		std::vector<uint32_t> cursor(successorOffsets.begin(), successorOffsets.end() - 1);
+		for (size_t i = 0; i < dependencies.size(); ++i)
+			successors[cursor[dependencies[i].first]++] = dependencies[i].second;
+	}
+	// Dependencies always run from a later collapse to an earlier one.
+	std::vector<float> priorities(collapseCount);
+	for (uint32_t c = 0; c < collapseCount; ++c) {
+		priorities[c] = history.Collapses[c].Error;
+		for (uint32_t i = successorOffsets[c]; i < successorOffsets[c + 1]; ++i)
+			priorities[c] = std::max(priorities[c], priorities[successors[i]]);
+	}
+	std::priority_queue<std::pair<float, uint32_t> > ready;
+	for (uint32_t c = 0; c < collapseCount; ++c) {
+		if (waits[c] == 0)
+			ready.push(std::make_pair(priorities[c], c));
+	}
+	std::vector<uint32_t> order;
+	order.reserve(collapseCount);
+	while (!ready.empty()) {
+		uint32_t c = ready.top().second;
+		ready.pop();
+		order.push_back(c);
+		for (uint32_t i = successorOffsets[c]; i < successorOffsets[c + 1]; ++i) {
+			if (--waits[successors[i]] == 0)
+				ready.push(std::make_pair(priorities[successors[i]], successors[i]));
+		}
+	}
+
+	// The error before a split is the largest cost of the collapses it and
+	// the splits after it undo.
+	result.Splits.resize(collapseCount);
+	float error = 0.0f;
+	for (uint32_t s = collapseCount; s-- > 0; ) {
+		error = std::max(error, history.Collapses[order[s]].Error);
+		result.Splits[s].Error = error;
+	}
+	result.BaseError = error;
+	result.Corners.clear();
+	for (uint32_t s = 0; s < collapseCount; ++s) {
+		uint32_t c = order[s];
+		const SimplifyCollapse& collapse = history.Collapses[c];
+		ProgressiveSplit& split = result.Splits[s];
+		uint32_t firstVertex = nextVertex;
+		for (uint32_t k = 0; k < collapse.PairCount; ++k)
+			remap[history.From[collapse.FirstPair + k]] = nextVertex++;
+		split.FirstCorner = (uint32_t)result.Corners.size();
+		for (uint32_t i = changeOffsets[c]; i < changeOffsets[c + 1]; ++i) {
+			ProgressiveCorner corner;
+			corner.Index = positions[changes[i].Index / 3] * 3 + changes[i].Index % 3;
+			corner.Vertex = remap[changes[i].Vertex];
+			result.Corners.push_back(corner);
+		}
+		split.CornerCount = (uint32_t)result.Corners.size() - split.FirstCorner;
+		// Wedges of the surviving corner that only the removed triangles
+		// used come back with the split as well.
+		split.TriangleCount = deathOffsets[c + 1] - deathOffsets[c];
+		for (uint32_t i = deathOffsets[c]; i < deathOffsets[c + 1]; ++i) {
+			uint32_t t = deathOrder[i];
+			positions[t] = nextTriangle++;
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t vertex = removed[t * 3 + k];
+				if (remap[vertex] == NONE)
+					remap[vertex] = nextVertex++;
+				result.Indices.push_back(remap[vertex]);
+			}
+		}
+		split.VertexCount = nextVertex - firstVertex;
+	}
+
+	result.VertexStride = vertexStride;
+	result.Vertices.resize((size_t)nextVertex * vertexStride);
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != NONE)
+			memcpy(&result.Vertices[(size_t)remap[v] * vertexStride],
+					bytes + (size_t)v * vertexStride, vertexStride);
+	}
+}
+
+bool SaveProgressiveMesh(const char* path, const ProgressiveMeshData& data) {
+	FILE* file;
+	if (fopen_s(&file, path, "wb") != 0)
+		return false;
+	FileHeader header;
+	header.Magic = FILE_MAGIC;
+	header.Version = FILE_VERSION;
+	header.VertexStride = data.VertexStride;
+	header.VertexCount = data.VertexStride
+			? (uint32_t)(data.Vertices.size() / data.VertexStride) : 0;
+	header.TriangleCount = (uint32_t)(data.Indices.size() / 3);
+	header.BaseVertexCount = data.BaseVertexCount;
+	header.BaseTriangleCount = data.BaseTriangleCount;
+	header.SplitCount = (uint32_t)data.Splits.size();
+	header.BaseError = data.BaseError;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	size_t vertexBytes = (size_t)data.BaseVertexCount * data.VertexStride;
+	size_t indexCount = (size_t)data.BaseTriangleCount * 3;
+	ok = ok && fwrite(data.Vertices.data(), 1, vertexBytes, file) == vertexBytes;
+	ok = ok && fwrite(data.Indices.data(), sizeof(uint32_t), indexCount, file) == indexCount;
+	size_t vertexOffset = vertexBytes;
+	size_t indexOffset = indexCount;
+	for (size_t i = 0; ok && i < data.Splits.size(); ++i) {
+		const ProgressiveSplit& split = data.Splits[i];
+		SplitHeader splitHeader;
+		splitHeader.Error = split.Error;
+		splitHeader.VertexCount = split.VertexCount;
+		splitHeader.CornerCount = split.CornerCount;
+		splitHeader.TriangleCount = split.TriangleCount;
+		vertexBytes = (size_t)split.VertexCount * data.VertexStride;
+		indexCount = (size_t)split.TriangleCount * 3;
+		ok = fwrite(&splitHeader, sizeof(splitHeader), 1, file) == 1
+				&& fwrite(data.Vertices.data() + vertexOffset, 1, vertexBytes, file) == vertexBytes
+				&& fwrite(data.Corners.data() + split.FirstCorner, sizeof(ProgressiveCorner),
+					split.CornerCount, file) == split.CornerCount
+				&& fwrite(data.Indices.data() + indexOffset, sizeof(uint32_t), indexCount,
+					file) == indexCount;
+		vertexOffset += vertexBytes;
+		indexOffset += indexCount;
+	}
+	if (fclose(file) != 0)
+		ok = false;
+	return ok;
+}
+
+ProgressiveMeshStream::ProgressiveMeshStream()
+		: m_file(nullptr), m_vertexStride(0), m_splitCount(0), m_baseError(0.0f),
+		m_loadedSplits(0), m_loadedVertices(0), m_loadedTriangles(0), m_appliedSplits(0),
+		m_vertexCount(0), m_triangleCount(0) {}
+
+ProgressiveMeshStream::~ProgressiveMeshStream() {
+	Close();
+}
+
+bool ProgressiveMeshStream::Open(const char* path) {
+	Close();
+	if (fopen_s(&m_file, path, "rb") != 0) {
+		m_file = nullptr;
+		return false;
+	}
+	FileHeader header;
+	if (fread(&header, sizeof(header), 1, m_file) != 1 || header.Magic != FILE_MAGIC
+			|| header.Version != FILE_VERSION || header.VertexStride == 0
+			|| header.BaseVertexCount > header.VertexCount
+			|| header.BaseTriangleCount > header.TriangleCount) {
+		Close();
+		return false;
+	}
+	m_vertexStride = header.VertexStride;
+	m_splitCount = header.SplitCount;
+	m_baseError = header.BaseError;
+	m_vertices.resize((size_t)header.VertexCount * m_vertexStride);
+	m_indices.resize((size_t)header.TriangleCount * 3);
+	m_splits.reserve(m_splitCount);
+
+	size_t vertexBytes = (size_t)header.BaseVertexCount * m_vertexStride;
+	size_t indexCount = (size_t)header.BaseTriangleCount * 3;
+	if (fread(m_vertices.data(), 1, vertexBytes, m_file) != vertexBytes
+			|| fread(m_indices.data(), sizeof(uint32_t), indexCount, m_file) != indexCount) {
+		Close();
+		return false;
+	}
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (m_indices[i] >= header.BaseVertexCount) {
+			Close();
+			return false;
+		}
+	}
+	m_loadedVertices = header.BaseVertexCount;
+	m_loadedTriangles = header.BaseTriangleCount;
+	m_vertexCount = header.BaseVertexCount;
+	m_triangleCount = header.BaseTriangleCount;
+	return true;
+}
+
+void ProgressiveMeshStream::Close() {
+	if (m_file) {
+		fclose(m_file);
+		m_file = nullptr;
+	}
+	m_vertexStride = 0;
+	m_splitCount = 0;
+	m_baseError = 0.0f;
+	m_vertices.clear();
+	m_indices.clear();
+	m_splits.clear();
+	m_corners.clear();
+	m_pending.clear();
+	m_loadedSplits = 0;
+	m_loadedVertices = 0;
+	m_loadedTriangles = 0;
+	m_appliedSplits = 0;
+	m_vertexCount = 0;
+	m_triangleCount = 0;
+}
+
+bool ProgressiveMeshStream::Stream(uint32_t byteBudget) {
+	if (!m_file || IsComplete())
+		return m_file != nullptr;
+	size_t pending = m_pending.size();
+	m_pending.resize(pending + byteBudget);
+	size_t read = fread(&m_pending[0] + pending, 1, byteBudget, m_file);
+	m_pending.resize(pending + read);
+
+	size_t offset = 0;
+	while (m_loadedSplits < m_splitCount) {
+		size_t used = 0;
+		if (!ParseSplit(m_pending.data() + offset, m_pending.size() - offset, used))
+			return false;
+		if (used == 0)
+			break;
+		offset += used;
+	}
+	m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+	// A short read with splits still missing means the file is truncated.
+	return read == byteBudget || IsComplete();
+}
+
+bool ProgressiveMeshStream::ParseSplit(const uint8_t* data, size_t size, size_t& used) {
+	used = 0;
+	SplitHeader header;
+	if (size < sizeof(header))
+		return true;
+	memcpy(&header, data, sizeof(header));
+	// Counts are checked against the room left before they are added, so a
+	// corrupt count cannot wrap. A split moves every corner at most once.
+	if (header.VertexCount > m_vertices.size() / m_vertexStride - m_loadedVertices
+			|| header.TriangleCount > m_indices.size() / 3 - m_loadedTriangles
+			|| header.CornerCount > m_loadedTriangles * 3) {
+		return false;
+	}
+	size_t vertexBytes = (size_t)header.VertexCount * m_vertexStride;
+	size_t cornerBytes = (size_t)header.CornerCount * sizeof(ProgressiveCorner);
+	size_t indexCount = (size_t)header.TriangleCount * 3;
+	uint32_t vertexCount = m_loadedVertices + header.VertexCount;
+	uint32_t triangleCount = m_loadedTriangles + header.TriangleCount;
+	size_t total = sizeof(header) + vertexBytes + cornerBytes + indexCount * sizeof(uint32_t);
+	if (size < total)
+		return true;
+
+	// Corners may only touch triangles that exist before the split, and
+	// everything may only reference vertices that exist after it.
+	const uint8_t* cursor = data + sizeof(header);
+	const uint8_t* corners = cursor + vertexBytes;
+	const uint8_t* indices = corners + cornerBytes;
+	size_t firstCorner = m_corners.size();
+	for (uint32_t i = 0; i < header.CornerCount; ++i) {
+		ProgressiveCorner corner;
+		memcpy(&corner, corners + i * sizeof(corner), sizeof(corner));
+		if (corner.Index >= m_loadedTriangles * 3 || corner.Vertex >= vertexCount) {
+			m_corners.resize(firstCorner);
+			return false;
+		}
+		Corner loaded = { corner.Index, corner.Vertex, NONE };
+		m_corners.push_back(loaded);
+	}
+	uint32_t* triangles = &m_indices[0] + (size_t)m_loadedTriangles * 3;
+	memcpy(triangles, indices, indexCount * sizeof(uint32_t));
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (triangles[i] >= vertexCount) {
+			m_corners.resize(firstCorner);
+			return false;
+		}
+	}
+	memcpy(&m_vertices[0] + (size_t)m_loadedVertices * m_vertexStride, cursor, vertexBytes);
+
+	Split split;
+	split.Error = header.Error;
+	split.FirstVertex = m_loadedVertices;
+	split.VertexCount = header.VertexCount;
+	split.FirstCorner = (uint32_t)firstCorner;
+	split.CornerCount = header.CornerCount;
+	split.FirstTriangle = m_loadedTriangles;
+	split.TriangleCount = header.TriangleCount;
+	m_splits.push_back(split);
+	m_loadedVertices = vertexCount;
+	m_loadedTriangles = triangleCount;
+	++m_loadedSplits;
+	used = total;
+	return true;
+}
+
+void ProgressiveMeshStream::Refine(float targetError, uint32_t splitBudget,
+		ProgressiveMeshUpdate& update) {
+	update.SplitsApplied = 0;
+	update.SplitsReverted = 0;
+	update.VertexBegin = update.VertexEnd = 0;
+	update.IndexBegin = update.IndexEnd = 0;
+
+	while (splitBudget && m_appliedSplits < m_loadedSplits
+			&& m_splits[m_appliedSplits].Error > targetError) {
+		const Split& split = m_splits[m_appliedSplits];
+		for (uint32_t i = 0; i < split.CornerCount; ++i) {
+			Corner& corner = m_corners[split.FirstCorner + i];
+			corner.Previous = m_indices[corner.Index];
+			m_indices[corner.Index] = corner.Vertex;
+			Extend(update.IndexBegin, update.IndexEnd, corner.Index, corner.Index + 1);
+		}
+		Extend(update.VertexBegin, update.VertexEnd, split.FirstVertex,
+				split.FirstVertex + split.VertexCount);
+		Extend(update.IndexBegin, update.IndexEnd, split.FirstTriangle * 3,
+				(split.FirstTriangle + split.TriangleCount) * 3);
+		m_vertexCount += split.VertexCount;
+		m_triangleCount += split.TriangleCount;
+		++m_appliedSplits;
+		++update.SplitsApplied;
+		--splitBudget;
+	}
+
+	// Coarsening never needs new data, so only the restored corners upload.
+	while (splitBudget && update.SplitsApplied == 0 && m_appliedSplits > 0
+			&& m_splits[m_appliedSplits - 1].Error <= targetError) {
+		const Split& split = m_splits[m_appliedSplits - 1];
+		for (uint32_t i = split.CornerCount; i-- > 0; ) {
+			const Corner& corner = m_corners[split.FirstCorner + i];
+			m_indices[corner.Index] = corner.Previous;
+			Extend(update.IndexBegin, update.IndexEnd, corner.Index, corner.Index + 1);
+		}
+		m_vertexCount -= split.VertexCount;
+		m_triangleCount -= split.TriangleCount;
+		--m_appliedSplits;
+		++update.SplitsReverted;
+		--splitBudget;
+	}
+}
+
+float ProgressiveMeshStream::GetError() const {
+	if (m_appliedSplits == m_splitCount)
+		return 0.0f;
+	if (m_appliedSplits < m_loadedSplits)
+		return m_splits[m_appliedSplits].Error;
+	return m_appliedSplits ? m_splits[m_appliedSplits - 1].Error : m_baseError;
+}
+
+} // namespace Zeus
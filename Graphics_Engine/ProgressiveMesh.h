@@ -0,0 +1,167 @@
+/*
+ * ProgressiveMesh.h
+ *
+ * Progressive meshes that stream from disk, replacing ID3DXPMesh. A
+ * D3DXGeneratePMesh mesh is fully resident before it can draw; here the
+ * base mesh loads first and vertex splits follow in priority order, so a
+ * mesh shows as soon as its base arrives and sharpens as bandwidth allows.
+ *
+ * The builder records the collapses of the simplifier in MeshSimplifier.h
+ * and reverses them. Every split restores the wedges one collapse removed,
+ * points the affected corners back at them and re-adds the triangles the
+ * collapse removed. Vertices and triangles are numbered base first, then
+ * in split order, so a mesh with n splits applied is a prefix of both
+ * buffers and draws with one call. Splits are ordered by the cost of
+ * their own collapse, largest first, as far as their dependencies allow: a
+ * split waits for the splits of later collapses that moved its corners
+ * again, removed their triangles or removed the wedges its own triangles
+ * hold. Each stores the error of the mesh it refines, the largest cost
+ * still to undo, which never grows along the stream.
+ *
+ * Files hold a header, the base mesh, then the split records back to back.
+ * ProgressiveMeshStream reads them in pieces no larger than a per-frame
+ * byte budget and applies or reverts splits towards a target error, a
+ * bounded number per frame, reporting the vertex and index ranges to copy
+ * to the GPU. Indices are 32-bit; vertices are opaque records of any
+ * stride.
+ */
+
+#ifndef PROGRESSIVEMESH_H_
+#define PROGRESSIVEMESH_H_
+
+#include "MeshSimplifier.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Points index buffer entry Index at Vertex.
+struct ProgressiveCorner {
+	uint32_t Index;
+	uint32_t Vertex;
+};
+
+struct ProgressiveSplit {
+	// Error of the mesh before the split, relative to the extent.
+	float Error;
+	uint32_t VertexCount;
+	uint32_t FirstCorner;
+	uint32_t CornerCount;
+	uint32_t TriangleCount;
+};
+
+struct ProgressiveMeshData {
+	uint32_t VertexStride;
+	uint32_t BaseVertexCount;
+	uint32_t BaseTriangleCount;
+	float BaseError;
+	// Every vertex, base first, then the vertices of every split in order.
+	std::vector<uint8_t> Vertices;
+	// Base triangles, then the triangles of every split in order, each with
+	// the indices it is added with.
+	std::vector<uint32_t> Indices;
+	std::vector<ProgressiveSplit> Splits;
+	std::vector<ProgressiveCorner> Corners;
+};
+
+// Simplifies source down to baseTriangles, or until settings.MaxError, and
+// records the splits back. vertices holds the source vertices at stride.
+void BuildProgressiveMesh(const SimplifySource& source, const void* vertices,
+		uint32_t vertexStride, const SimplifySettings& settings, uint32_t baseTriangles,
+		ProgressiveMeshData& result, JobSystem* jobs);
+
+bool SaveProgressiveMesh(const char* path, const ProgressiveMeshData& data);
+
+struct ProgressiveMeshUpdate {
+	uint32_t SplitsApplied;
+	uint32_t SplitsReverted;
+	// Ranges to copy to the GPU; empty when Begin equals End.
+	uint32_t VertexBegin;
+	uint32_t VertexEnd;
+	uint32_t IndexBegin;
+	uint32_t IndexEnd;
+};
+
+class ProgressiveMeshStream {
+public:
+	ProgressiveMeshStream();
+	~ProgressiveMeshStream();
+
+	// Reads the header and the base mesh; splits arrive through Stream().
+	bool Open(const char* path);
+	void Close();
+
+	// Reads at most byteBudget bytes of split records. False on a read
+	// error or a malformed record.
+	bool Stream(uint32_t byteBudget);
+	bool IsComplete() const { return m_loadedSplits == m_splitCount; }
+
+	// Applies splits while the mesh error exceeds targetError and reverts
+	// them while it stays within it, at most splitBudget in all. Only
+	// streamed splits apply.
+	void Refine(float targetError, uint32_t splitBudget, ProgressiveMeshUpdate& update);
+
+	// Buffers sized for the finest mesh; draw the first GetVertexCount()
+	// vertices and GetTriangleCount() triangles.
+	const std::vector<uint8_t>& GetVertices() const { return m_vertices; }
+	const std::vector<uint32_t>& GetIndices() const { return m_indices; }
+	uint32_t GetVertexStride() const { return m_vertexStride; }
+	uint32_t GetVertexCount() const { return m_vertexCount; }
+	uint32_t GetTriangleCount() const { return m_triangleCount; }
+	uint32_t GetSplitCount() const { return m_splitCount; }
+	uint32_t GetLoadedSplits() const { return m_loadedSplits; }
+	uint32_t GetAppliedSplits() const { return m_appliedSplits; }
+	// Error of the current mesh, or a bound on it while the next split has
+	// not arrived.
+	float GetError() const;
+
+private:
+	ProgressiveMeshStream(const ProgressiveMeshStream&);
+	ProgressiveMeshStream& operator=(const ProgressiveMeshStream&);
+
+	struct Split {
+		float Error;
+		uint32_t FirstVertex;
+		uint32_t VertexCount;
+		uint32_t FirstCorner;
+		uint32_t CornerCount;
+		uint32_t FirstTriangle;
+		uint32_t TriangleCount;
+	};
+
+	struct Corner {
+		uint32_t Index;
+		uint32_t Vertex;
+		// Filled in when the split applies, for reverting it.
+		uint32_t Previous;
+	};
+
+	// Parses one split from the front of data into used bytes; used stays 0
+	// when the split is incomplete. False when it is malformed.
+	bool ParseSplit(const uint8_t* data, size_t size, size_t& used);
+
+	FILE* m_file;
+	uint32_t m_vertexStride;
+	uint32_t m_splitCount;
+	float m_baseError;
+	std::vector<uint8_t> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<Split> m_splits;
+	std::vector<Corner> m_corners;
+	// Bytes read but not yet parsed into a whole split.
+	std::vector<uint8_t> m_pending;
+	uint32_t m_loadedSplits;
+	uint32_t m_loadedVertices;
+	uint32_t m_loadedTriangles;
+	uint32_t m_appliedSplits;
+	uint32_t m_vertexCount;
+	uint32_t m_triangleCount;
+};
+
+} // namespace Zeus
+
+#endif /* PROGRESSIVEMESH_H_ */
@@ -0,0 +1,233 @@
+/*
+ * RadixSort.cpp
+ *
+ */
+
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+// Each pass splits on the highest bits that still vary. The first pass
+// uses wide digits to cut the array into buckets that fit in cache; the
+// buckets then recurse with narrow digits until they are small enough
+// for insertion sort.
+const uint32_t TOP_BITS = 11;
+const uint32_t TOP_SIZE = 1 << TOP_BITS;
+const uint64_t TOP_MASK = TOP_SIZE - 1;
+const uint32_t BUCKET_BITS = 8;
+const uint32_t BUCKET_SIZE = 1 << BUCKET_BITS;
+const uint64_t BUCKET_MASK = BUCKET_SIZE - 1;
+// Below this many items per thread the job overhead outweighs the gain.
+const uint32_t MIN_RUN = 16 * 1024;
+const uint32_t INSERTION_SORT_LIMIT = 64;
+
+void InsertionSort(SortItem* items, uint32_t count) {
+	for (uint32_t i = 1; i < count; ++i) {
+		SortItem item = items[i];
+		uint32_t j = i;
+		while (j > 0 && items[j - 1].Key > item.Key) {
+			items[j] = items[j - 1];
+			--j;
+		}
+		items[j] = item;
+	}
+}
+
+uint32_t HighestBit(uint64_t bits) {
+	uint32_t bit = 63;
+	while (((bits >> bit) & 1) == 0)
+		--bit;
+	return bit;
+}
+
+// Sorts a bucket whose keys only differ in the bits of mask. The result
+// goes to to; from is used as scratch.
+void SortBucket(SortItem* from, SortItem* to, uint32_t count, uint64_t mask) {
+	uint64_t diff = 0;
+	for (uint32_t i = 1; i < count; ++i)
+		diff |= from[i].Key ^ from[0].Key;
+	diff &= mask;
+	if (count <= INSERTION_SORT_LIMIT || diff == 0) {
+		if (diff)
+			InsertionSort(from, count);
+		memcpy(to, from, count * sizeof(SortItem));
+		return;
+	}
+
+	uint32_t high = HighestBit(diff);
+	const uint32_t shift = high + 1 > BUCKET_BITS ? high + 1 - BUCKET_BITS : 0;
+	uint32_t offsets[BUCKET_SIZE + 1];
+	memset(offsets, 0, sizeof(offsets));
+	for (uint32_t i = 0; i < count; ++i)
+		++offsets[((from[i].Key >> shift) & BUCKET_MASK) + 1];
+	for (uint32_t digit = 0; digit < BUCKET_SIZE; ++digit)
+		offsets[digit + 1] += offsets[digit];
+	uint32_t next[BUCKET_SIZE];
+	memcpy(next, offsets, sizeof(next));
+	for (uint32_t i = 0; i < count; ++i)
+		to[next[(from[i].Key >> shift) & BUCKET_MASK]++] = from[i];
+	if (shift == 0)
+		return;
+
+	// Small buckets finish in place; larger ones recurse through from.
+	const uint64_t lowMask = mask & ((1ull << shift) - 1);
+	for (uint32_t digit = 0; digit < BUCKET_SIZE; ++digit) {
+		uint32_t first = offsets[digit];
+		uint32_t n = offsets[digit + 1] - first;
+		if (n <= INSERTION_SORT_LIMIT) {
+			InsertionSort(to + first, n);
+		} else {
+			SortBucket(to + first, from + first, n, lowMask);
+			memcpy(to + first, from + first, n * sizeof(SortItem));
+		}
+	}
+}
+
+// A contiguous run of the input. Runs are sorted as if they had been
+// concatenated in order, at Offset.
+struct SortRun {
+	const SortItem* Items;
+	uint32_t Count;
+	uint32_t Offset;
+};
+
+void CopyRuns(const std::vector<SortRun>& runs, SortItem* items, JobSystem* jobs) {
+	ParallelFor(jobs, (uint32_t)runs.size(), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t r = begin; r < end; ++r) {
+			if (runs[r].Count && runs[r].Items != items + runs[r].Offset)
+				memcpy(items + runs[r].Offset, runs[r].Items, runs[r].Count * sizeof(SortItem));
+		}
+	});
+}
+
+void SortRuns(const std::vector<SortRun>& runs, uint32_t count, SortItem* items,
+		SortItem* scratch, JobSystem* jobs) {
+	const uint32_t runCount = (uint32_t)runs.size();
+	if (count <= INSERTION_SORT_LIMIT) {
+		CopyRuns(runs, items, nullptr);
+		InsertionSort(items, count);
+		return;
+	}
+
+	// Bits that differ between any key and the first one; digits outside
+	// this mask are the same everywhere and need no pass.
+	std::vector<uint64_t> runDiff(runCount, 0);
+	const uint64_t first = runs[0].Items[0].Key;
+	ParallelFor(jobs, runCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t r = begin; r < end; ++r) {
+			uint64_t diff = 0;
+			for (uint32_t i = 0; i < runs[r].Count; ++i)
+				diff |= runs[r].Items[i].Key ^ first;
+			runDiff[r] = diff;
+		}
+	});
+	uint64_t diff = 0;
+	for (uint32_t r = 0; r < runCount; ++r)
+		diff |= runDiff[r];
+	if (diff == 0) {
+		CopyRuns(runs, items, jobs);
+		return;
+	}
+
+	// One pass over the whole array on the highest varying bits; every
+	// later pass runs inside a bucket, in cache.
+	const uint32_t high = HighestBit(diff);
+	const uint32_t shift = high + 1 > TOP_BITS ? high + 1 - TOP_BITS : 0;
+	const uint64_t lowMask = shift ? (1ull << shift) - 1 : 0;
+	std::vector<uint32_t> histograms((size_t)runCount * TOP_SIZE);
+	ParallelFor(jobs, runCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t r = begin; r < end; ++r) {
+			uint32_t* histogram = &histograms[(size_t)r * TOP_SIZE];
+			for (uint32_t i = 0; i < runs[r].Count; ++i)
+				++histogram[(runs[r].Items[i].Key >> shift) & TOP_MASK];
+		}
+	});
+
+	// Turn the counts into output offsets: digit-major, then run order,
+	// which is what keeps the sort stable across runs.
+	std::vector<uint32_t> buckets(TOP_SIZE + 1);
+	uint32_t offset = 0;
+	for (uint32_t digit = 0; digit < TOP_SIZE; ++digit) {
+		buckets[digit] = offset;
+		for (uint32_t r = 0; r < runCount; ++r) {
+			uint32_t& slot = histograms[(size_t)r * TOP_SIZE + digit];
+			uint32_t n = slot;
+			slot = offset;
+			offset += n;
+		}
+	}
+	buckets[TOP_SIZE] = offset;
+
+	// Every run scatters through its own offsets, so the runs write
+	// disjoint ranges and need no synchronization.
+	ParallelFor(jobs, runCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t r = begin; r < end; ++r) {
+			uint32_t* histogram = &histograms[(size_t)r * TOP_SIZE];
+			const SortItem* source = runs[r].Items;
+			for (uint32_t i = 0; i < runs[r].Count; ++i)
+				scratch[histogram[(source[i].Key >> shift) & TOP_MASK]++] = source[i];
+		}
+	});
+
+	// The buckets are independent and sort straight into items.
+	ParallelFor(jobs, TOP_SIZE, 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t digit = begin; digit < end; ++digit) {
+			uint32_t n = buckets[digit + 1] - buckets[digit];
+			if (n)
+				SortBucket(scratch + buckets[digit], items + buckets[digit], n, lowMask);
+		}
+	});
+}
+
+// Splits runs longer than runSize so every thread gets a share of the
+// histogram and scatter passes.
+void AddRun(std::vector<SortRun>& runs, const SortItem* items, uint32_t count,
+		uint32_t offset, uint32_t runSize) {
+	for (uint32_t i = 0; i < count; i += runSize) {
+		SortRun run = { items + i, std::min(runSize, count - i), offset + i };
+		runs.push_back(run);
+	}
+}
+
+uint32_t GetRunSize(uint32_t count, JobSystem* jobs) {
+	uint32_t threads = 1;
+	if (jobs)
+		threads = std::max(1u, std::min(jobs->GetThreadCount(), count / MIN_RUN));
+	return std::max(1u, (count + threads - 1) / threads);
+}
+
+} // namespace
+
+void RadixSort(SortItem* items, SortItem* scratch, uint32_t count, JobSystem* jobs) {
+	if (count == 0)
+		return;
+	std::vector<SortRun> runs;
+	AddRun(runs, items, count, 0, GetRunSize(count, jobs));
+	SortRuns(runs, count, items, scratch, jobs);
+}
+
+void RadixSort(const SortItem* const* sources, const uint32_t* counts, uint32_t sourceCount,
+		SortItem* items, SortItem* scratch, JobSystem* jobs) {
+	uint32_t count = 0;
+	for (uint32_t s = 0; s < sourceCount; ++s)
+		count += counts[s];
+	if (count == 0)
+		return;
+	std::vector<SortRun> runs;
+	const uint32_t runSize = GetRunSize(count, jobs);
+	uint32_t offset = 0;
+	for (uint32_t s = 0; s < sourceCount; ++s) {
+		AddRun(runs, sources[s], counts[s], offset, runSize);
+		offset += counts[s];
+	}
+	SortRuns(runs, count, items, scratch, jobs);
+}
+
+} // namespace Zeus
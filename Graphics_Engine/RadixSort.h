@@ -0,0 +1,40 @@
+/*
+ * RadixSort.h
+ *
+ * Stable radix sort of 64-bit keys with a 32-bit payload. Digits are
+ * placed over the bits that actually differ between keys, so sparse key
+ * layouts only pay for the fields in use. Only the first pass touches the
+ * whole array; it splits on the highest varying bits into buckets that
+ * finish in cache.
+ */
+
+#ifndef RADIXSORT_H_
+#define RADIXSORT_H_
+
+#include <cstdint>
+
+namespace Zeus {
+
+class JobSystem;
+
+struct SortItem {
+	uint64_t Key;
+	uint32_t Value;
+	uint32_t Reserved;
+};
+
+// Sorts items ascending by key. scratch must hold count items. With a job
+// system the first pass is split into per-thread histogram and scatter
+// jobs and the buckets are sorted in parallel; the result is identical
+// either way.
+void RadixSort(SortItem* items, SortItem* scratch, uint32_t count, JobSystem* jobs = nullptr);
+
+// Sorts the concatenation of the sources into items, as if they had been
+// copied there in order first, but without the copy. items and scratch
+// must each hold the total count.
+void RadixSort(const SortItem* const* sources, const uint32_t* counts, uint32_t sourceCount,
+		SortItem* items, SortItem* scratch, JobSystem* jobs = nullptr);
+
+} // namespace Zeus
+
+#endif /* RADIXSORT_H_ */
@@ -0,0 +1,449 @@
+/*
+ * RenderGraph.cpp
+ *
+ */
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NO_PASS = ~0u;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+uint32_t FullMipCount(uint32_t width, uint32_t height) {
+	uint32_t count = 1;
+	while (width > 1 || height > 1) {
+		width = std::max(width >> 1, 1u);
+		height = std::max(height >> 1, 1u);
+		++count;
+	}
+	return count;
+}
+
+} // namespace
+
+TextureDesc MakeTextureDesc(uint32_t width, uint32_t height, Format format,
+		uint32_t bindFlags) {
+	TextureDesc desc;
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	desc.SampleCount = 1;
+	desc.BindFlags = bindFlags;
+	return desc;
+}
+
+uint64_t GetTextureAllocationSize(const TextureDesc& desc) {
+	uint32_t mips = desc.MipLevels ? desc.MipLevels : FullMipCount(desc.Width, desc.Height);
+	uint64_t bits = BitsPerPixel(desc.Format);
+	bool compressed = IsBlockCompressed(desc.Format);
+	uint64_t bytes = 0;
+	uint32_t width = desc.Width;
+	uint32_t height = desc.Height;
+	for (uint32_t mip = 0; mip < mips; ++mip) {
+		if (compressed)
+			bytes += (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * bits * 16 / 8;
+		else
+			bytes += ((uint64_t)width * height * bits + 7) / 8;
+		width = std::max(width >> 1, 1u);
+		height = std::max(height >> 1, 1u);
+	}
+	bytes *= std::max(desc.ArraySize, 1u) * (uint64_t)std::max(desc.SampleCount, 1u);
+	return AlignUp(bytes, RenderGraph::TRANSIENT_ALIGNMENT);
+}
+
+uint64_t GetBufferAllocationSize(const BufferDesc& desc) {
+	return AlignUp(desc.ByteWidth, RenderGraph::TRANSIENT_ALIGNMENT);
+}
+
+RenderGraph::RenderGraph() {
+	Reset();
+}
+
+void RenderGraph::Reset() {
+	m_passes.clear();
+	m_resources.clear();
+	m_barriers.clear();
+	m_firstFinalBarrier = 0;
+	m_stats = RenderGraphStats();
+	m_compiled = false;
+}
+
+RenderGraphResource RenderGraph::AddResource(const char* name, bool isTexture,
+		bool imported) {
+	Resource resource = Resource();
+	resource.Name = name ? name : "";
+	resource.IsTexture = isTexture;
+	resource.Imported = imported;
+	resource.InitialState = STATE_UNDEFINED;
+	resource.FinalState = STATE_UNDEFINED;
+	resource.FirstPass = NO_PASS;
+	resource.LastPass = NO_PASS;
+	m_resources.push_back(resource);
+	m_compiled = false;
+
+	RenderGraphResource handle = { (uint32_t)m_resources.size() - 1 };
+	return handle;
+}
+
+RenderGraphResource RenderGraph::CreateTexture(const char* name, const TextureDesc& desc) {
+	RenderGraphResource handle = AddResource(name, true, false);
+	m_resources[handle.Index].Texture = desc;
+	return handle;
+}
+
+RenderGraphResource RenderGraph::CreateBuffer(const char* name, const BufferDesc& desc) {
+	RenderGraphResource handle = AddResource(name, false, false);
+	m_resources[handle.Index].Buffer = desc;
+	return handle;
+}
+
+RenderGraphResource RenderGraph::ImportTexture(const char* name, const TextureDesc& desc,
+		ResourceState initialState, ResourceState finalState) {
+	RenderGraphResource handle = AddResource(name, true, true);
+	Resource& resource = m_resources[handle.Index];
+	resource.Texture = desc;
+	resource.InitialState = initialState;
+	resource.FinalState = finalState;
+	return handle;
+}
+
+RenderGraphResource RenderGraph::ImportBuffer(const char* name, const BufferDesc& desc,
+		ResourceState initialState, ResourceState finalState) {
+	RenderGraphResource handle = AddResource(name, false, true);
+	Resource& resource = m_resources[handle.Index];
+	resource.Buffer = desc;
+	resource.InitialState = initialState;
+	resource.FinalState = finalState;
+	return handle;
+}
+
+void RenderGraph::MarkOutput(RenderGraphResource resource) {
+	assert(resource.Index < m_resources.size());
+	m_resources[resource.Index].Output = true;
+	m_compiled = false;
+}
+
+uint32_t RenderGraph::AddPass(const char* name, const ExecuteFunc& execute) {
+	Pass pass;
+	pass.Name = name ? name : "";
+	pass.Execute = execute;
+	pass.FirstBarrier = 0;
+	pass.BarrierCount = 0;
+	pass.SideEffects = false;
+	pass.Live = false;
+	m_passes.push_back(pass);
+	m_compiled = false;
+	return (uint32_t)m_passes.size() - 1;
+}
+
+void RenderGraph::AddAccess(uint32_t pass, RenderGraphResource resource,
+		ResourceState state, bool write) {
+	assert(pass < m_passes.size());
+	assert(resource.Index < m_resources.size());
+	Access access = { resource, state, write };
+	m_passes[pass].Accesses.push_back(access);
+	m_compiled = false;
+}
+
+void RenderGraph::Read(uint32_t pass, RenderGraphResource resource, ResourceState state) {
+	AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::Write(uint32_t pass, RenderGraphResource resource, ResourceState state) {
+	AddAccess(pass, resource, state, true);
+}
+
+void RenderGraph::SetSideEffects(uint32_t pass) {
+	assert(pass < m_passes.size());
+	m_passes[pass].SideEffects = true;
+	m_compiled = false;
+}
+
+bool RenderGraph::Compile() {
+	for (size_t p = 0; p < m_passes.size(); ++p) {
+		const std::vector<Access>& accesses = m_passes[p].Accesses;
+		for (size_t a = 0; a < accesses.size(); ++a) {
+			if (accesses[a].Resource.Index >= m_resources.size())
+				return false;
+		}
+	}
+
+	m_barriers.clear();
+	m_stats = RenderGraphStats();
+	m_stats.PassCount = (uint32_t)m_passes.size();
+
+	CullPasses();
+	ComputeLifetimes();
+	AliasTransients();
+	BuildBarriers();
+
+	m_compiled = true;
+	return true;
+}
+
+// Passes are recorded in dependency order, so one backwards sweep finds
+// everything that contributes to an output: a pass is live if it writes a
+// resource somebody downstream needs, and then everything it reads is needed.
+void RenderGraph::CullPasses() {
+	std::vector<bool> needed(m_resources.size(), false);
+	for (size_t r = 0; r < m_resources.size(); ++r)
+		needed[r] = m_resources[r].Imported || m_resources[r].Output;
+
+	for (size_t p = m_passes.size(); p-- > 0;) {
+		Pass& pass = m_passes[p];
+		bool live = pass.SideEffects;
+		for (size_t a = 0; a < pass.Accesses.size() && !live; ++a) {
+			const Access& access = pass.Accesses[a];
+			live = access.Write && needed[access.Resource.Index];
+		}
+		pass.Live = live;
+		if (!live) {
+			++m_stats.CulledPassCount;
+			continue;
+		}
+		for (size_t a = 0; a < pass.Accesses.size(); ++a) {
+			if (!pass.Accesses[a].Write)
+				needed[pass.Accesses[a].Resource.Index] = true;
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes() {
+	for (size_t r = 0; r < m_resources.size(); ++r) {
+		Resource& resource = m_resources[r];
+		resource.FirstPass = NO_PASS;
+		resource.LastPass = NO_PASS;
+		resource.Offset = 0;
+		resource.Size = resource.IsTexture ? GetTextureAllocationSize(resource.Texture)
+				: GetBufferAllocationSize(resource.Buffer);
+	}
+
+	for (uint32_t p = 0; p < m_passes.size(); ++p) {
+		const Pass& pass = m_passes[p];
+		if (!pass.Live)
+			continue;
+		for (size_t a = 0; a < pass.Accesses.size(); ++a) {
+			Resource& resource = m_resources[pass.Accesses[a].Resource.Index];
+			if (resource.FirstPass == NO_PASS)
+				resource.FirstPass = p;
+			resource.LastPass = p;
+		}
+	}
+}
+
+// Greedy interval packing: place the largest resources first, each at the
+// lowest offset that does not collide with an already placed resource whose
+// lifetime overlaps its own.
+void RenderGraph::AliasTransients() {
+	std::vector<uint32_t> transients;
+	for (uint32_t r = 0; r < m_resources.size(); ++r) {
+		const Resource& resource = m_resources[r];
+		if (resource.Imported || resource.FirstPass == NO_PASS)
+			continue;
+		transients.push_back(r);
+		m_stats.UnaliasedBytes += resource.Size;
+	}
+	m_stats.TransientCount = (uint32_t)transients.size();
+
+	struct BySize {
+		const std::vector<Resource>* Resources;
+		bool operator()(uint32_t a, uint32_t b) const {
+			uint64_t sizeA = (*Resources)[a].Size;
+			uint64_t sizeB = (*Resources)[b].Size;
+			return sizeA != sizeB ? sizeA > sizeB : a < b;
+		}
+	};
+	BySize bySize = { &m_resources };
+	std::sort(transients.begin(), transients.end(), bySize);
+
+	std::vector<uint32_t> placed;
+	std::vector<std::pair<uint64_t, uint64_t> > occupied;
+	uint64_t heapSize = 0;
+	for (size_t i = 0; i < transients.size(); ++i) {
+		Resource& resource = m_resources[transients[i]];
+
+		occupied.clear();
+		for (size_t j = 0; j < placed.size(); ++j) {
+			const Resource& other = m_resources[placed[j]];
+			if (other.FirstPass <= resource.LastPass && resource.FirstPass <= other.LastPass)
+				occupied.push_back(std::make_pair(other.Offset, other.Offset + other.Size));
+		}
+		std::sort(occupied.begin(), occupied.end());
+
+		uint64_t offset = 0;
+		for (size_t j = 0; j < occupied.size(); ++j) {
+			if (offset + resource.Size <= occupied[j].first)
+				break;
+			offset = std::max(offset, occupied[j].second);
+		}
+		resource.Offset = offset;
+		heapSize = std::max(heapSize, offset + resource.Size);
+		placed.push_back(transients[i]);
+	}
+
+	m_stats.HeapBytes = heapSize;
+	m_stats.SavedBytes = m_stats.UnaliasedBytes - heapSize;
+}
+
+void RenderGraph::BuildBarriers() {
+	std::vector<ResourceState> states(m_resources.size());
+	std::vector<uint32_t> lastUavWrite(m_resources.size(), NO_PASS);
+	std::vector<uint32_t> visited(m_resources.size(), NO_PASS);
+	for (size_t r = 0; r < m_resources.size(); ++r)
+		states[r] = m_resources[r].InitialState;
+
+	for (uint32_t p = 0; p < m_passes.size(); ++p) {
+		Pass& pass = m_passes[p];
+		pass.FirstBarrier = (uint32_t)m_barriers.size();
+		pass.BarrierCount = 0;
+		if (!pass.Live)
+			continue;
+
+		for (size_t a = 0; a < pass.Accesses.size(); ++a) {
+			const Access& access = pass.Accesses[a];
+			uint32_t index = access.Resource.Index;
+			const Resource& resource = m_resources[index];
+
+			// A resource touched twice by one pass gets a single barrier.
+			if (visited[index] == p)
+				continue;
+			visited[index] = p;
+
+			if (!resource.Imported && resource.FirstPass == p) {
+				RenderGraphBarrier alias = { BARRIER_ALIASING, access.Resource,
+						RenderGraphResource::Invalid(), STATE_UNDEFINED, STATE_UNDEFINED };
+				uint32_t latest = 0;
+				for (uint32_t r = 0; r < m_resources.size(); ++r) {
+					const Resource& other = m_resources[r];
+					if (other.Imported || other.LastPass == NO_PASS || other.LastPass >= p)
+						continue;
+					bool overlaps = other.Offset < resource.Offset + resource.Size &&
+							resource.Offset < other.Offset + other.Size;
+					if (overlaps && (!alias.Previous.IsValid() || other.LastPass >= latest)) {
+						alias.Previous.Index = r;
+						latest = other.LastPass;
+					}
+				}
+				if (alias.Previous.IsValid())
+					m_barriers.push_back(alias);
+			}
+
+			if (states[index] != access.State) {
+				RenderGraphBarrier transition = { BARRIER_TRANSITION, access.Resource,
+						RenderGraphResource::Invalid(), states[index], access.State };
+				m_barriers.push_back(transition);
+				states[index] = access.State;
+			} else if (access.State == STATE_UNORDERED_ACCESS && lastUavWrite[index] != NO_PASS) {
+				RenderGraphBarrier uav = { BARRIER_UAV, access.Resource,
+						RenderGraphResource::Invalid(), access.State, access.State };
+				m_barriers.push_back(uav);
+			}
+		}
+
+		for (size_t a = 0; a < pass.Accesses.size(); ++a) {
+			const Access& access = pass.Accesses[a];
+			if (access.Write && access.State == STATE_UNORDERED_ACCESS)
+				lastUavWrite[access.Resource.Index] = p;
+			else if (access.Write)
+				lastUavWrite[access.Resource.Index] = NO_PASS;
+		}
+		pass.BarrierCount = (uint32_t)m_barriers.size() - pass.FirstBarrier;
+	}
+
+	m_firstFinalBarrier = (uint32_t)m_barriers.size();
+	for (uint32_t r = 0; r < m_resources.size(); ++r) {
+		const Resource& resource = m_resources[r];
+		if (!resource.Imported || resource.FinalState == STATE_UNDEFINED ||
+				states[r] == resource.FinalState)
+			continue;
+		RenderGraphResource handle = { r };
+		RenderGraphBarrier transition = { BARRIER_TRANSITION, handle,
+				RenderGraphResource::Invalid(), states[r], resource.FinalState };
+		m_barriers.push_back(transition);
+	}
+
+	m_stats.BarrierCount = (uint32_t)m_barriers.size();
+}
+
+void RenderGraph::Execute(const BarrierFunc& onBarriers, void* userData) const {
+	assert(m_compiled);
+
+	RenderGraphContext context;
+	context.m_graph = this;
+	context.m_userData = userData;
+
+	for (uint32_t p = 0; p < m_passes.size(); ++p) {
+		const Pass& pass = m_passes[p];
+		if (!pass.Live)
+			continue;
+
+		const RenderGraphBarrier* barriers = pass.BarrierCount ? &m_barriers[pass.FirstBarrier] : nullptr;
+		if (pass.BarrierCount && onBarriers)
+			onBarriers(barriers, pass.BarrierCount);
+
+		context.m_pass = p;
+		context.m_barriers = barriers;
+		context.m_barrierCount = pass.BarrierCount;
+		if (pass.Execute)
+			pass.Execute(context);
+	}
+
+	uint32_t finalCount = (uint32_t)m_barriers.size() - m_firstFinalBarrier;
+	if (finalCount && onBarriers)
+		onBarriers(&m_barriers[m_firstFinalBarrier], finalCount);
+}
+
+bool RenderGraph::IsPassCulled(uint32_t pass) const {
+	assert(pass < m_passes.size());
+	return !m_passes[pass].Live;
+}
+
+const char* RenderGraph::GetPassName(uint32_t pass) const {
+	assert(pass < m_passes.size());
+	return m_passes[pass].Name.c_str();
+}
+
+const char* RenderGraph::GetResourceName(RenderGraphResource resource) const {
+	assert(resource.Index < m_resources.size());
+	return m_resources[resource.Index].Name.c_str();
+}
+
+bool RenderGraph::IsTexture(RenderGraphResource resource) const {
+	assert(resource.Index < m_resources.size());
+	return m_resources[resource.Index].IsTexture;
+}
+
+bool RenderGraph::IsTransient(RenderGraphResource resource) const {
+	assert(resource.Index < m_resources.size());
+	return !m_resources[resource.Index].Imported;
+}
+
+const TextureDesc& RenderGraph::GetTextureDesc(RenderGraphResource resource) const {
+	assert(IsTexture(resource));
+	return m_resources[resource.Index].Texture;
+}
+
+const BufferDesc& RenderGraph::GetBufferDesc(RenderGraphResource resource) const {
+	assert(!IsTexture(resource));
+	return m_resources[resource.Index].Buffer;
+}
+
+RenderGraphPlacement RenderGraph::GetPlacement(RenderGraphResource resource) const {
+	assert(IsTransient(resource));
+	const Resource& r = m_resources[resource.Index];
+	RenderGraphPlacement placement = { r.Offset, r.FirstPass == NO_PASS ? 0 : r.Size };
+	return placement;
+}
+
+} // namespace Zeus
@@ -0,0 +1,240 @@
+/*
+ * RenderGraph.h
+ *
+ * Per-frame render graph. Passes declare the textures and buffers they read
+ * and write; Compile() culls passes whose results are never consumed, works
+ * out the state transitions each pass needs and packs transient resources
+ * with disjoint lifetimes into the same memory.
+ */
+
+#ifndef RENDERGRAPH_H_
+#define RENDERGRAPH_H_
+
+#include "Format.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+// Mirrors D3D11_BIND_FLAG.
+enum BindFlags {
+	BIND_VERTEX_BUFFER = 0x1,
+	BIND_INDEX_BUFFER = 0x2,
+	BIND_CONSTANT_BUFFER = 0x4,
+	BIND_SHADER_RESOURCE = 0x8,
+	BIND_RENDER_TARGET = 0x20,
+	BIND_DEPTH_STENCIL = 0x40,
+	BIND_UNORDERED_ACCESS = 0x80
+};
+
+// Field-for-field subset of D3D11_TEXTURE2D_DESC.
+struct TextureDesc {
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels;
+	uint32_t ArraySize;
+	Zeus::Format Format;
+	uint32_t SampleCount;
+	uint32_t BindFlags;
+};
+
+// Field-for-field subset of D3D11_BUFFER_DESC.
+struct BufferDesc {
+	uint32_t ByteWidth;
+	uint32_t BindFlags;
+	uint32_t StructureByteStride;
+};
+
+TextureDesc MakeTextureDesc(uint32_t width, uint32_t height, Format format,
+		uint32_t bindFlags);
+
+// Size a texture occupies in a placed-resource heap.
+uint64_t GetTextureAllocationSize(const TextureDesc& desc);
+uint64_t GetBufferAllocationSize(const BufferDesc& desc);
+
+enum ResourceState {
+	STATE_UNDEFINED = 0,
+	STATE_RENDER_TARGET,
+	STATE_DEPTH_WRITE,
+	STATE_DEPTH_READ,
+	STATE_SHADER_RESOURCE,
+	STATE_UNORDERED_ACCESS,
+	STATE_COPY_SOURCE,
+	STATE_COPY_DEST,
+	STATE_VERTEX_BUFFER,
+	STATE_INDEX_BUFFER,
+	STATE_CONSTANT_BUFFER,
+	STATE_INDIRECT_ARGUMENT,
+	STATE_PRESENT
+};
+
+struct RenderGraphResource {
+	uint32_t Index;
+
+	bool IsValid() const { return Index != ~0u; }
+	bool operator==(RenderGraphResource other) const { return Index == other.Index; }
+	bool operator!=(RenderGraphResource other) const { return Index != other.Index; }
+
+	static RenderGraphResource Invalid() { RenderGraphResource r = { ~0u }; return r; }
+};
+
+enum RenderGraphBarrierType {
+	BARRIER_TRANSITION,
+	// The memory behind a transient resource previously belonged to another
+	// one; its contents are undefined and must be cleared or fully written.
+	BARRIER_ALIASING,
+	// Back-to-back unordered access writes that must not overlap.
+	BARRIER_UAV
+};
+
+struct RenderGraphBarrier {
+	RenderGraphBarrierType Type;
+	RenderGraphResource Resource;
+	// For aliasing barriers, the resource that last occupied the memory.
+	RenderGraphResource Previous;
+	ResourceState Before;
+	ResourceState After;
+};
+
+// Where a transient resource lives inside the frame's transient heap.
+struct RenderGraphPlacement {
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+struct RenderGraphStats {
+	uint32_t PassCount;
+	uint32_t CulledPassCount;
+	uint32_t TransientCount;
+	uint32_t BarrierCount;
+	// Memory the transient resources would need without aliasing.
+	uint64_t UnaliasedBytes;
+	// Size of the transient heap after aliasing.
+	uint64_t HeapBytes;
+	uint64_t SavedBytes;
+};
+
+class RenderGraph;
+
+class RenderGraphContext {
+public:
+	const RenderGraph& GetGraph() const { return *m_graph; }
+	uint32_t GetPassIndex() const { return m_pass; }
+	const RenderGraphBarrier* GetBarriers() const { return m_barriers; }
+	uint32_t GetBarrierCount() const { return m_barrierCount; }
+	void* GetUserData() const { return m_userData; }
+
+private:
+	friend class RenderGraph;
+
+	const RenderGraph* m_graph;
+	uint32_t m_pass;
+	const RenderGraphBarrier* m_barriers;
+	uint32_t m_barrierCount;
+	void* m_userData;
+};
+
+class RenderGraph {
+public:
+	typedef std::function<void(const RenderGraphContext&)> ExecuteFunc;
+	typedef std::function<void(const RenderGraphBarrier*, uint32_t)> BarrierFunc;
+
+	enum { TRANSIENT_ALIGNMENT = 64 * 1024 };
+
+	RenderGraph();
+
+	// Drops all passes and resources but keeps the allocations for the
+	// next frame.
+	void Reset();
+
+	RenderGraphResource CreateTexture(const char* name, const TextureDesc& desc);
+	RenderGraphResource CreateBuffer(const char* name, const BufferDesc& desc);
+	// Resources owned outside the graph. They are never aliased and, like
+	// any resource marked as output, keep their producers alive.
+	RenderGraphResource ImportTexture(const char* name, const TextureDesc& desc,
+			ResourceState initialState, ResourceState finalState);
+	RenderGraphResource ImportBuffer(const char* name, const BufferDesc& desc,
+			ResourceState initialState, ResourceState finalState);
+	void MarkOutput(RenderGraphResource resource);
+
+	uint32_t AddPass(const char* name, const ExecuteFunc& execute);
+	void Read(uint32_t pass, RenderGraphResource resource, ResourceState state);
+	void Write(uint32_t pass, RenderGraphResource resource, ResourceState state);
+	// Keeps a pass alive even if nothing reads what it writes (readbacks,
+	// queries, debug captures).
+	void SetSideEffects(uint32_t pass);
+
+	bool Compile();
+	// Runs the live passes in submission order. Barriers for a pass are
+	// handed to onBarriers before the pass executes; final transitions of
+	// imported resources are flushed after the last pass.
+	void Execute(const BarrierFunc& onBarriers, void* userData = nullptr) const;
+
+	bool IsPassCulled(uint32_t pass) const;
+	const char* GetPassName(uint32_t pass) const;
+	uint32_t GetPassCount() const { return (uint32_t)m_passes.size(); }
+
+	const char* GetResourceName(RenderGraphResource resource) const;
+	bool IsTexture(RenderGraphResource resource) const;
+	bool IsTransient(RenderGraphResource resource) const;
+	const TextureDesc& GetTextureDesc(RenderGraphResource resource) const;
+	const BufferDesc& GetBufferDesc(RenderGraphResource resource) const;
+	// Only valid for transient resources that survived culling.
+	RenderGraphPlacement GetPlacement(RenderGraphResource resource) const;
+
+	const RenderGraphStats& GetStats() const { return m_stats; }
+
+private:
+	struct Access {
+		RenderGraphResource Resource;
+		ResourceState State;
+		bool Write;
+	};
+
+	struct Pass {
+		std::string Name;
+		ExecuteFunc Execute;
+		std::vector<Access> Accesses;
+		uint32_t FirstBarrier;
+		uint32_t BarrierCount;
+		bool SideEffects;
+		bool Live;
+	};
+
+	struct Resource {
+		std::string Name;
+		TextureDesc Texture;
+		BufferDesc Buffer;
+		bool IsTexture;
+		bool Imported;
+		bool Output;
+		ResourceState InitialState;
+		ResourceState FinalState;
+		// Live pass range in submission order, ~0u when unused.
+		uint32_t FirstPass;
+		uint32_t LastPass;
+		uint64_t Size;
+		uint64_t Offset;
+	};
+
+	RenderGraphResource AddResource(const char* name, bool isTexture, bool imported);
+	void AddAccess(uint32_t pass, RenderGraphResource resource, ResourceState state, bool write);
+	void CullPasses();
+	void ComputeLifetimes();
+	void AliasTransients();
+	void BuildBarriers();
+
+	std::vector<Pass> m_passes;
+	std::vector<Resource> m_resources;
+	std::vector<RenderGraphBarrier> m_barriers;
+	uint32_t m_firstFinalBarrier;
+	RenderGraphStats m_stats;
+	bool m_compiled;
+};
+
+} // namespace Zeus
+
+#endif /* RENDERGRAPH_H_ */
@@ -0,0 +1,165 @@
+/*
+ * RingAllocator.cpp
+ *
+ */
+
+#include "RingAllocator.h"
+
+namespace Zeus {
+
+RingAllocator::RingAllocator()
+		: m_memory(nullptr), m_ownsMemory(false), m_buffer(NULL_RESOURCE), m_capacity(0),
+		m_head(0), m_tail(0), m_frameStart(0), m_firstFrame(0), m_frameCount(0),
+		m_highWater(0), m_frameAllocations(0), m_failedAllocations(0),
+		m_peakFrameBytes(0) {
+}
+
+RingAllocator::~RingAllocator() {
+	Shutdown();
+}
+
+bool RingAllocator::Initialize(uint32_t capacity, ResourceHandle buffer, void* memory) {
+	Shutdown();
+	if (capacity == 0)
+		return false;
+
+	m_ownsMemory = memory == nullptr;
+	m_memory = m_ownsMemory ? new uint8_t[capacity] : static_cast<uint8_t*>(memory);
+	m_buffer = buffer;
+	m_capacity = capacity;
+	return true;
+}
+
+void RingAllocator::Shutdown() {
+	if (m_ownsMemory)
+		delete[] m_memory;
+	m_memory = nullptr;
+	m_ownsMemory = false;
+	m_buffer = NULL_RESOURCE;
+	m_capacity = 0;
+	m_head.store(0);
+	m_tail.store(0);
+	m_frameStart = 0;
+	m_firstFrame = 0;
+	m_frameCount = 0;
+	m_highWater.store(0);
+	m_frameAllocations.store(0);
+	m_failedAllocations.store(0);
+	m_peakFrameBytes = 0;
+}
+
+RingAllocation RingAllocator::Allocate(uint32_t size, uint32_t alignment) {
+	RingAllocation allocation = { nullptr, m_buffer, 0, 0 };
+	if (alignment == 0)
+		alignment = 1;
+	if (size == 0 || size > m_capacity) {
+		m_failedAllocations.fetch_add(1, std::memory_order_relaxed);
+		return allocation;
+	}
+
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	uint64_t start;
+	uint64_t end;
+	for (;;) {
+		// Alignment is applied to the physical offset so that strides that
+		// do not divide the capacity still line up after a wrap.
+		uint64_t lap = head - head % m_capacity;
+		uint64_t offset = head % m_capacity;
+		offset = (offset + alignment - 1) / alignment * alignment;
+		if (offset + size > m_capacity) {
+			lap += m_capacity;
+			offset = 0;
+		}
+		start = lap + offset;
+		end = start + size;
+
+		if (end - m_tail.load(std::memory_order_acquire) > m_capacity) {
+			m_failedAllocations.fetch_add(1, std::memory_order_relaxed);
+			return allocation;
+		}
+		if (m_head.compare_exchange_weak(head, end, std::memory_order_relaxed))
+			break;
+	}
+
+	uint64_t inFlight = end - m_tail.load(std::memory_order_relaxed);
+	uint64_t highWater = m_highWater.load(std::memory_order_relaxed);
+	while (inFlight > highWater &&
+			!m_highWater.compare_exchange_weak(highWater, inFlight, std::memory_order_relaxed)) {
+	}
+	m_frameAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	allocation.Offset = (uint32_t)(start % m_capacity);
+	allocation.Size = size;
+	allocation.CpuAddress = m_memory + allocation.Offset;
+	return allocation;
+}
+
+bool RingAllocator::EndFrame(uint64_t fenceValue) {
+	if (m_frameCount == MAX_FRAMES_IN_FLIGHT)
+		return false;
+
+	uint64_t head = m_head.load(std::memory_order_acquire);
+	FrameMarker& marker = m_frames[(m_firstFrame + m_frameCount) % MAX_FRAMES_IN_FLIGHT];
+	marker.Fence = fenceValue;
+	marker.Head = head;
+	++m_frameCount;
+
+	uint64_t frameBytes = head - m_frameStart;
+	if (frameBytes > m_peakFrameBytes)
+		m_peakFrameBytes = frameBytes;
+	m_frameStart = head;
+	m_frameAllocations.store(0, std::memory_order_relaxed);
+	return true;
+}
+
+void RingAllocator::Retire(uint64_t completedFence) {
+	while (m_frameCount > 0 && m_frames[m_firstFrame].Fence <= completedFence) {
+		m_tail.store(m_frames[m_firstFrame].Head, std::memory_order_release);
+		m_firstFrame = (m_firstFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		--m_frameCount;
+	}
+}
+
+uint64_t RingAllocator::GetBytesInFlight() const {
+	return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed);
+}
+
+RingAllocatorStats RingAllocator::GetStats() const {
+	RingAllocatorStats stats;
+	stats.Capacity = m_capacity;
+	stats.FrameBytes = m_head.load(std::memory_order_relaxed) - m_frameStart;
+	stats.PeakFrameBytes = m_peakFrameBytes;
+	stats.HighWaterBytes = m_highWater.load(std::memory_order_relaxed);
+	stats.FrameAllocations = m_frameAllocations.load(std::memory_order_relaxed);
+	stats.FailedAllocations = m_failedAllocations.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool TransientBuffers::Initialize(uint32_t constantBytes, ResourceHandle constantBuffer,
+		uint32_t geometryBytes, ResourceHandle geometryBuffer, void* constantMemory,
+		void* geometryMemory) {
+	return m_constants.Initialize(constantBytes, constantBuffer, constantMemory) &&
+			m_geometry.Initialize(geometryBytes, geometryBuffer, geometryMemory);
+}
+
+void TransientBuffers::Shutdown() {
+	m_constants.Shutdown();
+	m_geometry.Shutdown();
+}
+
+bool TransientBuffers::EndFrame(uint64_t fenceValue) {
+	// Check both first so the rings never disagree on which frames exist.
+	if (m_constants.GetFramesInFlight() == RingAllocator::MAX_FRAMES_IN_FLIGHT ||
+			m_geometry.GetFramesInFlight() == RingAllocator::MAX_FRAMES_IN_FLIGHT)
+		return false;
+	m_constants.EndFrame(fenceValue);
+	m_geometry.EndFrame(fenceValue);
+	return true;
+}
+
+void TransientBuffers::Retire(uint64_t completedFence) {
+	m_constants.Retire(completedFence);
+	m_geometry.Retire(completedFence);
+}
+
+} // namespace Zeus
@@ -0,0 +1,146 @@
+/*
+ * RingAllocator.h
+ *
+ * Multi-frame ring suballocator for per-draw constants and transient
+ * geometry, the engine-side replacement for mapping a D3D11 dynamic
+ * buffer with D3D11_MAP_WRITE_DISCARD on every draw.
+ *
+ * Any thread may allocate; an allocation is a single compare-and-swap on
+ * the head. Memory is handed back a frame at a time: EndFrame() tags the
+ * current head with a fence value and Retire() releases every frame whose
+ * fence the GPU has passed.
+ */
+
+#ifndef RINGALLOCATOR_H_
+#define RINGALLOCATOR_H_
+
+#include "CommandList.h"
+#include "Format.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace Zeus {
+
+// Constant buffer views must start on 16-constant (256 byte) boundaries.
+const uint32_t CONSTANT_BUFFER_ALIGNMENT = 256;
+
+struct RingAllocation {
+	void* CpuAddress;
+	ResourceHandle Buffer;
+	uint32_t Offset;
+	uint32_t Size;
+
+	bool IsValid() const { return CpuAddress != nullptr; }
+};
+
+struct RingAllocatorStats {
+	uint64_t Capacity;
+	// Bytes allocated since the last EndFrame().
+	uint64_t FrameBytes;
+	// Largest FrameBytes seen at any EndFrame().
+	uint64_t PeakFrameBytes;
+	// Largest amount of memory in flight (allocated but not yet retired).
+	uint64_t HighWaterBytes;
+	uint32_t FrameAllocations;
+	uint32_t FailedAllocations;
+};
+
+class RingAllocator {
+public:
+	enum { MAX_FRAMES_IN_FLIGHT = 8 };
+
+	RingAllocator();
+	~RingAllocator();
+
+	// memory is the CPU view of buffer (a persistently mapped upload
+	// buffer, or plain memory for the CPU backend). Pass nullptr to have
+	// the allocator own a heap block of the given size.
+	bool Initialize(uint32_t capacity, ResourceHandle buffer, void* memory = nullptr);
+	void Shutdown();
+
+	// Thread-safe. Returns an invalid allocation when the ring is full.
+	RingAllocation Allocate(uint32_t size, uint32_t alignment);
+	RingAllocation AllocateConstants(uint32_t size) {
+		return Allocate(size, CONSTANT_BUFFER_ALIGNMENT);
+	}
+	RingAllocation AllocateVertices(uint32_t count, uint32_t stride) {
+		return Allocate(GetArraySize(count, stride), stride);
+	}
+	RingAllocation AllocateIndices(uint32_t count, Format format) {
+		uint32_t size = format == FORMAT_R16_UINT ? 2 : 4;
+		return Allocate(GetArraySize(count, size), size);
+	}
+
+	// Closes the current frame. Its memory stays reserved until Retire()
+	// sees completedFence reach fenceValue.
+	bool EndFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFence);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	ResourceHandle GetBuffer() const { return m_buffer; }
+	uint64_t GetBytesInFlight() const;
+	uint32_t GetFramesInFlight() const { return m_frameCount; }
+	RingAllocatorStats GetStats() const;
+
+private:
+	RingAllocator(const RingAllocator&);
+	RingAllocator& operator=(const RingAllocator&);
+
+	// count * stride, or 0, which Allocate() refuses, when that overflows.
+	static uint32_t GetArraySize(uint32_t count, uint32_t stride) {
+		return stride != 0 && count > 0xffffffffu / stride ? 0 : count * stride;
+	}
+
+	struct FrameMarker {
+		uint64_t Fence;
+		uint64_t Head;
+	};
+
+	uint8_t* m_memory;
+	bool m_ownsMemory;
+	ResourceHandle m_buffer;
+	uint32_t m_capacity;
+
+	// Head and tail are monotonically increasing virtual offsets; the
+	// physical offset is the virtual one modulo the capacity.
+	std::atomic<uint64_t> m_head;
+	std::atomic<uint64_t> m_tail;
+	uint64_t m_frameStart;
+
+	FrameMarker m_frames[MAX_FRAMES_IN_FLIGHT];
+	uint32_t m_firstFrame;
+	uint32_t m_frameCount;
+
+	std::atomic<uint64_t> m_highWater;
+	std::atomic<uint32_t> m_frameAllocations;
+	std::atomic<uint32_t> m_failedAllocations;
+	uint64_t m_peakFrameBytes;
+};
+
+// D3D11 does not allow the constant buffer bind flag to be combined with
+// any other, so constants and transient geometry live in separate rings
+// that are advanced together.
+class TransientBuffers {
+public:
+	// The memory pointers are the CPU views of the buffers, as for
+	// RingAllocator::Initialize; nullptr gives a ring its own heap block.
+	bool Initialize(uint32_t constantBytes, ResourceHandle constantBuffer,
+			uint32_t geometryBytes, ResourceHandle geometryBuffer,
+			void* constantMemory = nullptr, void* geometryMemory = nullptr);
+	void Shutdown();
+
+	RingAllocator& Constants() { return m_constants; }
+	RingAllocator& Geometry() { return m_geometry; }
+
+	bool EndFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFence);
+
+private:
+	RingAllocator m_constants;
+	RingAllocator m_geometry;
+};
+
+} // namespace Zeus
+
+#endif /* RINGALLOCATOR_H_ */
@@ -0,0 +1,257 @@
+/*
+ * SoftwareRasterizer.cpp
+ *
+ */
+
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Zeus {
+
+namespace {
+
+// Edge a -> b as E(x, y) = A (x - a.x) + B (y - a.y), positive inside.
+// Evaluating relative to a keeps precision for triangles that reach far
+// outside the target.
+struct Edge {
+	float A;
+	float B;
+	float X;
+	float Y;
+	bool TopLeft;
+
+	void Setup(const XMFLOAT4& a, const XMFLOAT4& b) {
+		float dx = b.x - a.x;
+		float dy = b.y - a.y;
+		A = -dy;
+		B = dx;
+		X = a.x;
+		Y = a.y;
+		// Interior below a horizontal edge, or to the right of the edge.
+		TopLeft = (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+	}
+
+	float Evaluate(float x, float y) const { return A * (x - X) + B * (y - Y); }
+	bool Inside(float e) const { return e > 0.0f || (e == 0.0f && TopLeft); }
+};
+
+inline uint32_t ClampIndex(int32_t value, uint32_t size) {
+	if (value < 0)
+		return 0;
+	return (uint32_t)value >= size ? size - 1 : (uint32_t)value;
+}
+
+ScissorRect Intersect(const ScissorRect& a, const ScissorRect& b) {
+	ScissorRect rect;
+	rect.Left = std::max(a.Left, b.Left);
+	rect.Top = std::max(a.Top, b.Top);
+	rect.Right = std::min(a.Right, b.Right);
+	rect.Bottom = std::min(a.Bottom, b.Bottom);
+	return rect;
+}
+
+// Raster space has y down, so a positive area is clockwise on screen,
+// D3D's default front face.
+uint32_t DrawTriangle(DepthBuffer& target, const ScissorRect& clip, const XMFLOAT4& v0,
+		const XMFLOAT4& v1, const XMFLOAT4& v2, bool cullBack) {
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (area == 0.0f || area != area || (cullBack && area < 0.0f))
+		return 0;
+	// Unless culled, both windings are drawn; flip back faces.
+	const XMFLOAT4& a = v0;
+	const XMFLOAT4& b = area > 0.0f ? v1 : v2;
+	const XMFLOAT4& c = area > 0.0f ? v2 : v1;
+	area = fabsf(area);
+
+	int32_t left = std::max(clip.Left, (int32_t)ceilf(std::min(a.x, std::min(b.x, c.x)) - 0.5f));
+	int32_t right = std::min(clip.Right - 1,
+			(int32_t)floorf(std::max(a.x, std::max(b.x, c.x)) - 0.5f));
+	int32_t top = std::max(clip.Top, (int32_t)ceilf(std::min(a.y, std::min(b.y, c.y)) - 0.5f));
+	int32_t bottom = std::min(clip.Bottom - 1,
+			(int32_t)floorf(std::max(a.y, std::max(b.y, c.y)) - 0.5f));
+	if (left > right || top > bottom)
+		return 0;
+
+	// e0 weights a, e1 weights b and e2 weights c. Depth is a plane
+	// through a.
+	Edge e0, e1, e2;
+	e0.Setup(b, c);
+	e1.Setup(c, a);
+	e2.Setup(a, b);
+	const float inverseArea = 1.0f / area;
+	const float zdx = (e1.A * (b.z - a.z) + e2.A * (c.z - a.z)) * inverseArea;
+	const float zdy = (e1.B * (b.z - a.z) + e2.B * (c.z - a.z)) * inverseArea;
+
+	uint32_t written = 0;
+	const float startX = left + 0.5f;
+	for (int32_t y = top; y <= bottom; ++y) {
+		const float py = y + 0.5f;
+		float w0 = e0.Evaluate(startX, py);
+		float w1 = e1.Evaluate(startX, py);
+		float w2 = e2.Evaluate(startX, py);
+		// Depth is evaluated directly rather than stepped, so errors do
+		// not pile up along wide rows.
+		const float zRow = a.z + zdx * (startX - a.x) + zdy * (py - a.y);
+		float* row = target.GetRow(y);
+		for (int32_t x = left; x <= right; ++x) {
+			float z = zRow + zdx * (x - left);
+			if (e0.Inside(w0) && e1.Inside(w1) && e2.Inside(w2) && z < row[x]) {
+				row[x] = z;
+				++written;
+			}
+			w0 += e0.A;
+			w1 += e1.A;
+			w2 += e2.A;
+		}
+	}
+	return written;
+}
+
+uint32_t DrawMesh(DepthBuffer& target, const ScissorRect& scissor, const RasterMesh& mesh,
+		CXMMATRIX toRaster, std::vector<XMFLOAT4>& scratch, bool cullBack) {
+	if (mesh.VertexCount == 0 || mesh.IndexCount < 3)
+		return 0;
+	ScissorRect clip = Intersect(scissor, target.GetRect());
+	if (clip.Left >= clip.Right || clip.Top >= clip.Bottom)
+		return 0;
+
+	scratch.resize(mesh.VertexCount);
+	uint32_t stride = mesh.PositionStride ? mesh.PositionStride : sizeof(XMFLOAT3);
+	XMVector3TransformStream(&scratch[0], sizeof(XMFLOAT4), mesh.Positions, stride,
+			mesh.VertexCount, toRaster);
+	// Vertices at or behind the eye keep w = 0 so their triangles are
+	// skipped below.
+	for (uint32_t i = 0; i < mesh.VertexCount; ++i) {
+		XMFLOAT4& v = scratch[i];
+		if (v.w <= 0.0f) {
+			v.w = 0.0f;
+		} else if (v.w != 1.0f) {
+			float inverse = 1.0f / v.w;
+			v.x *= inverse;
+			v.y *= inverse;
+			v.z *= inverse;
+		}
+	}
+
+	const uint16_t* indices16 = static_cast<const uint16_t*>(mesh.Indices);
+	const uint32_t* indices32 = static_cast<const uint32_t*>(mesh.Indices);
+	const bool wide = mesh.IndexFormat == FORMAT_R32_UINT;
+	uint32_t written = 0;
+	for (uint32_t i = 0; i + 2 < mesh.IndexCount; i += 3) {
+		uint32_t i0 = wide ? indices32[i] : indices16[i];
+		uint32_t i1 = wide ? indices32[i + 1] : indices16[i + 1];
+		uint32_t i2 = wide ? indices32[i + 2] : indices16[i + 2];
+		if (i0 >= mesh.VertexCount || i1 >= mesh.VertexCount || i2 >= mesh.VertexCount)
+			continue;
+		const XMFLOAT4& v0 = scratch[i0];
+		const XMFLOAT4& v1 = scratch[i1];
+		const XMFLOAT4& v2 = scratch[i2];
+		if (v0.w == 0.0f || v1.w == 0.0f || v2.w == 0.0f)
+			continue;
+		written += DrawTriangle(target, clip, v0, v1, v2, cullBack);
+	}
+	return written;
+}
+
+} // namespace
+
+DepthBuffer::DepthBuffer() : m_width(0), m_height(0) {
+}
+
+bool DepthBuffer::Initialize(uint32_t width, uint32_t height) {
+	if (width == 0 || height == 0)
+		return false;
+	m_width = width;
+	m_height = height;
+	m_depth.assign((size_t)width * height, 1.0f);
+	return true;
+}
+
+void DepthBuffer::Clear(float depth) {
+	std::fill(m_depth.begin(), m_depth.end(), depth);
+}
+
+void DepthBuffer::Clear(float depth, const ScissorRect& rect) {
+	ScissorRect clip = Intersect(rect, GetRect());
+	for (int32_t y = clip.Top; y < clip.Bottom; ++y) {
+		float* row = GetRow(y);
+		std::fill(row + clip.Left, row + std::max(clip.Left, clip.Right), depth);
+	}
+}
+
+void DepthBuffer::Swap(DepthBuffer& other) {
+	m_depth.swap(other.m_depth);
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+}
+
+ScissorRect DepthBuffer::GetRect() const {
+	ScissorRect rect = { 0, 0, (int32_t)m_width, (int32_t)m_height };
+	return rect;
+}
+
+ColorBuffer::ColorBuffer() : m_width(0), m_height(0) {
+}
+
+bool ColorBuffer::Initialize(uint32_t width, uint32_t height) {
+	if (width == 0 || height == 0)
+		return false;
+	if (width == m_width && height == m_height)
+		return true;
+	m_width = width;
+	m_height = height;
+	m_pixels.assign((size_t)width * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	return true;
+}
+
+void ColorBuffer::Clear(const XMFLOAT4& color) {
+	std::fill(m_pixels.begin(), m_pixels.end(), color);
+}
+
+void ColorBuffer::Swap(ColorBuffer& other) {
+	m_pixels.swap(other.m_pixels);
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+}
+
+ScissorRect ColorBuffer::GetRect() const {
+	ScissorRect rect = { 0, 0, (int32_t)m_width, (int32_t)m_height };
+	return rect;
+}
+
+XMVECTOR SampleBilinear(const ColorBuffer& image, float x, float y) {
+	float fx = floorf(x);
+	float fy = floorf(y);
+	int32_t x0 = (int32_t)fx;
+	int32_t y0 = (int32_t)fy;
+	const uint32_t width = image.GetWidth();
+	const uint32_t height = image.GetHeight();
+	const XMFLOAT4* row0 = image.GetRow(ClampIndex(y0, height));
+	const XMFLOAT4* row1 = image.GetRow(ClampIndex(y0 + 1, height));
+	uint32_t c0 = ClampIndex(x0, width);
+	uint32_t c1 = ClampIndex(x0 + 1, width);
+	XMVECTOR top = XMVectorLerp(XMLoadFloat4(&row0[c0]), XMLoadFloat4(&row0[c1]), x - fx);
+	XMVECTOR bottom = XMVectorLerp(XMLoadFloat4(&row1[c0]), XMLoadFloat4(&row1[c1]), x - fx);
+	return XMVectorLerp(top, bottom, y - fy);
+}
+
+uint32_t RasterizeDepth(DepthBuffer& target, const ScissorRect& scissor, const RasterMesh& mesh,
+		CXMMATRIX toRaster, std::vector<XMFLOAT4>& scratch) {
+	return DrawMesh(target, scissor, mesh, toRaster, scratch, false);
+}
+
+void MeasureOverdraw(DepthBuffer& target, const RasterMesh& mesh, CXMMATRIX toRaster,
+		std::vector<XMFLOAT4>& scratch, OverdrawStats& stats) {
+	target.Clear(1.0f);
+	stats.PixelsShaded += DrawMesh(target, target.GetRect(), mesh, toRaster, scratch, true);
+	for (uint32_t y = 0; y < target.GetHeight(); ++y) {
+		const float* row = target.GetRow(y);
+		for (uint32_t x = 0; x < target.GetWidth(); ++x)
+			stats.PixelsCovered += row[x] < 1.0f ? 1 : 0;
+	}
+	stats.Overdraw = stats.PixelsCovered ? (float)stats.PixelsShaded / stats.PixelsCovered : 0.0f;
+}
+
+} // namespace Zeus
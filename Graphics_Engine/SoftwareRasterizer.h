@@ -0,0 +1,106 @@
+/*
+ * SoftwareRasterizer.h
+ *
+ * Triangle rasterization for the CPU backend. Vertices are transformed
+ * straight into raster space (pixel x, pixel y, depth), pixel centers sit
+ * at half-integer coordinates and edges follow the D3D top-left rule.
+ *
+ * There is no clipping: triangles with a vertex at or behind w = 0 are
+ * dropped and everything else is limited to the scissor rectangle.
+ *
+ * ColorBuffer is the matching linear RGBA float image that CPU image
+ * passes read and write.
+ */
+
+#ifndef SOFTWARERASTERIZER_H_
+#define SOFTWARERASTERIZER_H_
+
+#include "CommandList.h"
+#include "Format.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class DepthBuffer {
+public:
+	DepthBuffer();
+
+	bool Initialize(uint32_t width, uint32_t height);
+	void Clear(float depth);
+	void Clear(float depth, const ScissorRect& rect);
+	void Swap(DepthBuffer& other);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	ScissorRect GetRect() const;
+	float* GetRow(uint32_t y) { return &m_depth[(size_t)y * m_width]; }
+	const float* GetRow(uint32_t y) const { return &m_depth[(size_t)y * m_width]; }
+
+private:
+	std::vector<float> m_depth;
+	uint32_t m_width;
+	uint32_t m_height;
+};
+
+class ColorBuffer {
+public:
+	ColorBuffer();
+
+	// Keeps the contents when the size does not change.
+	bool Initialize(uint32_t width, uint32_t height);
+	void Clear(const XMFLOAT4& color);
+	void Swap(ColorBuffer& other);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	ScissorRect GetRect() const;
+	XMFLOAT4* GetRow(uint32_t y) { return &m_pixels[(size_t)y * m_width]; }
+	const XMFLOAT4* GetRow(uint32_t y) const { return &m_pixels[(size_t)y * m_width]; }
+
+private:
+	std::vector<XMFLOAT4> m_pixels;
+	uint32_t m_width;
+	uint32_t m_height;
+};
+
+// x and y are in texels with texel centers on whole numbers; sampling
+// clamps at the edges.
+XMVECTOR SampleBilinear(const ColorBuffer& image, float x, float y);
+
+struct RasterMesh {
+	const XMFLOAT3* Positions;
+	// Bytes between positions; 0 means tightly packed.
+	uint32_t PositionStride;
+	uint32_t VertexCount;
+	const void* Indices;
+	Format IndexFormat;
+	uint32_t IndexCount;
+};
+
+// Draws both windings of mesh with a less-than depth test. toRaster maps
+// object space to raster space. scratch holds the transformed vertices
+// and may be reused between calls. Returns the number of pixels written.
+uint32_t RasterizeDepth(DepthBuffer& target, const ScissorRect& scissor, const RasterMesh& mesh,
+		CXMMATRIX toRaster, std::vector<XMFLOAT4>& scratch);
+
+// Depth-only overdraw counters. With early depth testing every pixel that
+// passes the test is shaded once, so Overdraw is shaded over covered.
+struct OverdrawStats {
+	uint64_t PixelsCovered;
+	uint64_t PixelsShaded;
+	float Overdraw;
+};
+
+// Clears target, draws mesh with back faces (counterclockwise on screen)
+// culled and adds the result to stats.
+void MeasureOverdraw(DepthBuffer& target, const RasterMesh& mesh, CXMMATRIX toRaster,
+		std::vector<XMFLOAT4>& scratch, OverdrawStats& stats);
+
+} // namespace Zeus
+
+#endif /* SOFTWARERASTERIZER_H_ */
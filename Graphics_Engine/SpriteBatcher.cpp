@@ -0,0 +1,333 @@
+/*
+ * SpriteBatcher.cpp
+ *
+ */
+
+#include "SpriteBatcher.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t BAND_HEIGHT = 32;
+// Bounds of the padding lanes, which no band overlaps.
+const float EMPTY_BOUND = 1e30f;
+
+uint32_t GetDepthBits(float depth) {
+	// Non-negative IEEE floats order the same as their bit patterns.
+	depth = depth > 0.0f ? depth : 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits;
+}
+
+void DrawSprite(ColorBuffer& target, const ScissorRect& clip, const SpriteInstance& sprite,
+		float minX, float maxX, const ColorBuffer* texture) {
+	const float ax = sprite.AxisX.x;
+	const float ay = sprite.AxisX.y;
+	const float bx = sprite.AxisY.x;
+	const float by = sprite.AxisY.y;
+	const float determinant = ax * by - ay * bx;
+	if (fabsf(determinant) < 1e-12f)
+		return;
+	const float inverse = 1.0f / determinant;
+	int32_t left = std::max(clip.Left, (int32_t)ceilf(minX - 0.5f));
+	int32_t right = std::min(clip.Right - 1, (int32_t)floorf(maxX - 0.5f));
+	if (left > right)
+		return;
+
+	XMCOLOR packed(sprite.Color);
+	const XMVECTOR color = XMLoadColor(&packed);
+	const XMFLOAT4& uv = sprite.TexCoords;
+	const float textureWidth = texture ? (float)texture->GetWidth() : 0.0f;
+	const float textureHeight = texture ? (float)texture->GetHeight() : 0.0f;
+	// (u, v) of a pixel center solves Origin + u AxisX + v AxisY = p and
+	// steps by a constant along the row.
+	const float du = by * inverse;
+	const float dv = -ay * inverse;
+	for (int32_t y = clip.Top; y < clip.Bottom; ++y) {
+		const float dx = left + 0.5f - sprite.Origin.x;
+		const float dy = y + 0.5f - sprite.Origin.y;
+		float u = (dx * by - dy * bx) * inverse;
+		float v = (ax * dy - ay * dx) * inverse;
+		XMFLOAT4* row = target.GetRow(y);
+		for (int32_t x = left; x <= right; ++x, u += du, v += dv) {
+			if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+				continue;
+			XMVECTOR source = color;
+			if (texture) {
+				float s = (uv.x + (uv.z - uv.x) * u) * textureWidth - 0.5f;
+				float t = (uv.y + (uv.w - uv.y) * v) * textureHeight - 0.5f;
+				source = XMVectorMultiply(source, SampleBilinear(*texture, s, t));
+			}
+			// Source over: rgb = src a + dst (1 - a), alpha = a + dst (1 - a).
+			XMVECTOR alpha = XMVectorSplatW(source);
+			source = XMVectorMultiply(source, XMVectorSetW(alpha, 1.0f));
+			XMVECTOR destination = XMLoadFloat4(&row[x]);
+			XMStoreFloat4(&row[x], XMVectorMultiplyAdd(destination,
+					XMVectorSubtract(g_XMOne, alpha), source));
+		}
+	}
+}
+
+} // namespace
+
+SpriteBatcher::SpriteBatcher()
+		: m_sortMode(SPRITE_SORT_TEXTURE), m_instanceBuffer(NULL_RESOURCE), m_baseInstance(0) {
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void SpriteBatcher::Initialize(uint32_t queueCount, uint32_t reservePerQueue) {
+	m_queues.clear();
+	m_queues.resize(queueCount ? queueCount : 1);
+	for (size_t i = 0; i < m_queues.size(); ++i)
+		m_queues[i].Sprites.reserve(reservePerQueue);
+}
+
+void SpriteBatcher::Reset() {
+	for (size_t i = 0; i < m_queues.size(); ++i)
+		m_queues[i].Sprites.clear();
+}
+
+void SpriteBatcher::Draw(uint32_t queue, const Sprite* sprites, uint32_t count) {
+	std::vector<Sprite>& target = m_queues[queue].Sprites;
+	target.insert(target.end(), sprites, sprites + count);
+}
+
+uint64_t SpriteBatcher::GetSortKey(const Sprite& sprite) const {
+	switch (m_sortMode) {
+	case SPRITE_SORT_TEXTURE:
+		return (uint64_t)sprite.Texture;
+	case SPRITE_SORT_BACK_TO_FRONT:
+		return (uint64_t)~GetDepthBits(sprite.Depth) << 32 | sprite.Texture;
+	case SPRITE_SORT_FRONT_TO_BACK:
+		return (uint64_t)GetDepthBits(sprite.Depth) << 32 | sprite.Texture;
+	default:
+		return 0;
+	}
+}
+
+const Sprite& SpriteBatcher::GetSprite(uint32_t index) const {
+	size_t queue = std::upper_bound(m_queueOffsets.begin(), m_queueOffsets.end(), index) -
+			m_queueOffsets.begin() - 1;
+	return m_queues[queue].Sprites[index - m_queueOffsets[queue]];
+}
+
+void SpriteBatcher::Build(JobSystem* jobs) {
+	m_queueOffsets.resize(m_queues.size() + 1);
+	uint32_t count = 0;
+	for (size_t i = 0; i < m_queues.size(); ++i) {
+		m_queueOffsets[i] = count;
+		count += (uint32_t)m_queues[i].Sprites.size();
+	}
+	m_queueOffsets[m_queues.size()] = count;
+
+	m_items.resize(count);
+	ParallelFor(jobs, (uint32_t)m_queues.size(), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t q = begin; q < end; ++q) {
+			const std::vector<Sprite>& sprites = m_queues[q].Sprites;
+			SortItem* items = count ? &m_items[m_queueOffsets[q]] : nullptr;
+			for (uint32_t i = 0; i < (uint32_t)sprites.size(); ++i) {
+				SortItem item = { GetSortKey(sprites[i]), m_queueOffsets[q] + i, 0 };
+				items[i] = item;
+			}
+		}
+	});
+	if (m_sortMode != SPRITE_SORT_NONE && count > 1) {
+		m_scratch.resize(count);
+		RadixSort(&m_items[0], &m_scratch[0], count, jobs);
+	}
+
+	const uint32_t groups = (count + 3) / 4;
+	m_instances.resize(count);
+	m_textures.resize(count);
+	m_minX.resize(groups);
+	m_minY.resize(groups);
+	m_maxX.resize(groups);
+	m_maxY.resize(groups);
+	ParallelFor(jobs, groups, 1024, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t g = begin; g < end; ++g)
+			ExpandGroup(g);
+	});
+
+	m_batches.clear();
+	memset(&m_stats, 0, sizeof(m_stats));
+	for (uint32_t begin = 0; begin < count;) {
+		uint32_t end = begin + 1;
+		while (end < count && m_textures[end] == m_textures[begin])
+			++end;
+		SpriteBatch batch = { m_textures[begin], begin, end - begin };
+		m_batches.push_back(batch);
+		m_stats.LargestBatch = std::max(m_stats.LargestBatch, end - begin);
+		begin = end;
+	}
+	m_stats.SpriteCount = count;
+	m_stats.BatchCount = (uint32_t)m_batches.size();
+}
+
+// Sets up four sorted sprites at once: every field goes in its own vector
+// with one sprite per lane.
+void SpriteBatcher::ExpandGroup(uint32_t group) {
+	const uint32_t first = group * 4;
+	const uint32_t lanes = std::min(4u, (uint32_t)m_items.size() - first);
+	XMFLOAT4A positionX(0.0f, 0.0f, 0.0f, 0.0f), positionY = positionX;
+	XMFLOAT4A width = positionX, height = positionX, pivotX = positionX, pivotY = positionX;
+	XMFLOAT4A rotation = positionX;
+	const Sprite* sprites[4];
+	for (uint32_t lane = 0; lane < lanes; ++lane) {
+		const Sprite& sprite = GetSprite(m_items[first + lane].Value);
+		sprites[lane] = &sprite;
+		(&positionX.x)[lane] = sprite.Position.x;
+		(&positionY.x)[lane] = sprite.Position.y;
+		(&width.x)[lane] = sprite.Size.x;
+		(&height.x)[lane] = sprite.Size.y;
+		(&pivotX.x)[lane] = sprite.Pivot.x;
+		(&pivotY.x)[lane] = sprite.Pivot.y;
+		(&rotation.x)[lane] = sprite.Rotation;
+	}
+
+	XMVECTOR sine, cosine;
+	XMVectorSinCos(&sine, &cosine, XMLoadFloat4A(&rotation));
+	XMVECTOR w = XMLoadFloat4A(&width);
+	XMVECTOR h = XMLoadFloat4A(&height);
+	XMVECTOR axisXx = XMVectorMultiply(w, cosine);
+	XMVECTOR axisXy = XMVectorMultiply(w, sine);
+	XMVECTOR axisYx = XMVectorNegate(XMVectorMultiply(h, sine));
+	XMVECTOR axisYy = XMVectorMultiply(h, cosine);
+	XMVECTOR px = XMLoadFloat4A(&pivotX);
+	XMVECTOR py = XMLoadFloat4A(&pivotY);
+	XMVECTOR originX = XMVectorSubtract(XMLoadFloat4A(&positionX),
+			XMVectorMultiplyAdd(px, axisXx, XMVectorMultiply(py, axisYx)));
+	XMVECTOR originY = XMVectorSubtract(XMLoadFloat4A(&positionY),
+			XMVectorMultiplyAdd(px, axisXy, XMVectorMultiply(py, axisYy)));
+
+	// Bounds over the four corners; padding lanes get an empty box.
+	XMVECTOR cornerX[3] = { XMVectorAdd(originX, axisXx), XMVectorAdd(originX, axisYx),
+			XMVectorAdd(XMVectorAdd(originX, axisXx), axisYx) };
+	XMVECTOR cornerY[3] = { XMVectorAdd(originY, axisXy), XMVectorAdd(originY, axisYy),
+			XMVectorAdd(XMVectorAdd(originY, axisXy), axisYy) };
+	XMVECTOR minX = originX, maxX = originX, minY = originY, maxY = originY;
+	for (uint32_t i = 0; i < 3; ++i) {
+		minX = XMVectorMin(minX, cornerX[i]);
+		maxX = XMVectorMax(maxX, cornerX[i]);
+		minY = XMVectorMin(minY, cornerY[i]);
+		maxY = XMVectorMax(maxY, cornerY[i]);
+	}
+	if (lanes < 4) {
+		static const XMVECTORU32 LANE_MASKS[4] = {
+			{ 0, 0, 0, 0 },
+			{ 0xffffffff, 0, 0, 0 },
+			{ 0xffffffff, 0xffffffff, 0, 0 },
+			{ 0xffffffff, 0xffffffff, 0xffffffff, 0 }
+		};
+		XMVECTOR empty = XMVectorReplicate(EMPTY_BOUND);
+		minX = XMVectorSelect(empty, minX, LANE_MASKS[lanes]);
+		minY = XMVectorSelect(empty, minY, LANE_MASKS[lanes]);
+		maxX = XMVectorSelect(XMVectorNegate(empty), maxX, LANE_MASKS[lanes]);
+		maxY = XMVectorSelect(XMVectorNegate(empty), maxY, LANE_MASKS[lanes]);
+	}
+	XMStoreFloat4(&m_minX[group], minX);
+	XMStoreFloat4(&m_minY[group], minY);
+	XMStoreFloat4(&m_maxX[group], maxX);
+	XMStoreFloat4(&m_maxY[group], maxY);
+
+	XMFLOAT4A ox, oy, axx, axy, ayx, ayy;
+	XMStoreFloat4A(&ox, originX);
+	XMStoreFloat4A(&oy, originY);
+	XMStoreFloat4A(&axx, axisXx);
+	XMStoreFloat4A(&axy, axisXy);
+	XMStoreFloat4A(&ayx, axisYx);
+	XMStoreFloat4A(&ayy, axisYy);
+	for (uint32_t lane = 0; lane < lanes; ++lane) {
+		const Sprite& sprite = *sprites[lane];
+		SpriteInstance& instance = m_instances[first + lane];
+		instance.Origin = XMFLOAT2((&ox.x)[lane], (&oy.x)[lane]);
+		instance.AxisX = XMFLOAT2((&axx.x)[lane], (&axy.x)[lane]);
+		instance.AxisY = XMFLOAT2((&ayx.x)[lane], (&ayy.x)[lane]);
+		instance.Depth = sprite.Depth;
+		instance.Color = sprite.Color;
+		instance.TexCoords = sprite.TexCoords;
+		m_textures[first + lane] = sprite.Texture;
+	}
+}
+
+bool SpriteBatcher::Upload(RingAllocator& ring) {
+	// Empty frames still get one instance so the stream stays valid.
+	uint32_t count = std::max(1u, (uint32_t)m_instances.size());
+	RingAllocation allocation = ring.AllocateVertices(count, sizeof(SpriteInstance));
+	if (!allocation.IsValid())
+		return false;
+	if (!m_instances.empty())
+		memcpy(allocation.CpuAddress, &m_instances[0], m_instances.size() * sizeof(SpriteInstance));
+	m_instanceBuffer = allocation.Buffer;
+	m_baseInstance = allocation.Offset / sizeof(SpriteInstance);
+	return true;
+}
+
+void SpriteBatcher::Record(CommandList& list, const SpriteBatch& batch) const {
+	uint32_t stride = sizeof(SpriteInstance);
+	list.SetShaderResources(STAGE_PIXEL, 0, 1, &batch.Texture);
+	list.SetVertexBuffers(0, 1, &m_instanceBuffer, &stride, nullptr);
+	list.SetPrimitiveTopology(TOPOLOGY_TRIANGLESTRIP);
+	list.Draw(4, 0, batch.InstanceCount, m_baseInstance + batch.StartInstance);
+}
+
+void SpriteBatcher::Rasterize(ColorBuffer& target, const ScissorRect& scissor,
+		const ColorBuffer* const* textures, uint32_t textureCount, JobSystem* jobs) const {
+	ScissorRect clip = target.GetRect();
+	clip.Left = std::max(clip.Left, scissor.Left);
+	clip.Top = std::max(clip.Top, scissor.Top);
+	clip.Right = std::min(clip.Right, scissor.Right);
+	clip.Bottom = std::min(clip.Bottom, scissor.Bottom);
+	if (clip.Left >= clip.Right || clip.Top >= clip.Bottom || m_instances.empty())
+		return;
+	const uint32_t bands = (clip.Bottom - clip.Top + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	ParallelFor(jobs, bands, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t band = begin; band < end; ++band)
+			DrawBand(target, clip, band, textures, textureCount);
+	});
+}
+
+// Every band walks the whole sorted list, so overlapping sprites blend in
+// order without any locking between bands.
+void SpriteBatcher::DrawBand(ColorBuffer& target, const ScissorRect& clip, uint32_t band,
+		const ColorBuffer* const* textures, uint32_t textureCount) const {
+	ScissorRect rect = clip;
+	rect.Top = clip.Top + band * BAND_HEIGHT;
+	rect.Bottom = std::min(clip.Bottom, rect.Top + (int32_t)BAND_HEIGHT);
+	const XMVECTOR left = XMVectorReplicate((float)rect.Left);
+	const XMVECTOR top = XMVectorReplicate((float)rect.Top);
+	const XMVECTOR right = XMVectorReplicate((float)rect.Right);
+	const XMVECTOR bottom = XMVectorReplicate((float)rect.Bottom);
+
+	const uint32_t groups = (uint32_t)m_minX.size();
+	for (uint32_t g = 0; g < groups; ++g) {
+		XMVECTOR inside = XMVectorAndInt(XMVectorLess(XMLoadFloat4(&m_minY[g]), bottom),
+				XMVectorGreater(XMLoadFloat4(&m_maxY[g]), top));
+		inside = XMVectorAndInt(inside, XMVectorAndInt(
+				XMVectorLess(XMLoadFloat4(&m_minX[g]), right),
+				XMVectorGreater(XMLoadFloat4(&m_maxX[g]), left)));
+		if (XMComparisonAllTrue(XMVector4EqualIntR(inside, XMVectorZero())))
+			continue;
+		uint32_t mask[4];
+		XMStoreInt4(mask, inside);
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			if (!mask[lane])
+				continue;
+			uint32_t index = g * 4 + lane;
+			ResourceHandle handle = m_textures[index];
+			const ColorBuffer* texture = handle < textureCount ? textures[handle] : nullptr;
+			if (texture && texture->GetWidth() == 0)
+				texture = nullptr;
+			DrawSprite(target, rect, m_instances[index], (&m_minX[g].x)[lane],
+					(&m_maxX[g].x)[lane], texture);
+		}
+	}
+}
+
+} // namespace Zeus
@@ -0,0 +1,158 @@
+/*
+ * SpriteBatcher.h
+ *
+ * Replacement for ID3DXSprite. Producers push sprites into their own
+ * queues without locking; Build() radix sorts all of them by texture and
+ * depth and expands them into instance records, four sprites at a time in
+ * SoA form on xnamath vectors. Runs of sprites that share a texture become
+ * one instanced draw of a four vertex strip, which the vertex shader
+ * expands from SV_VertexID and the instance record.
+ *
+ * The same records are drawn by the CPU backend: the target is split into
+ * bands of rows, every band gets the sprites that touch it in sorted order,
+ * and bands rasterize in parallel with the usual source-over blending.
+ */
+
+#ifndef SPRITEBATCHER_H_
+#define SPRITEBATCHER_H_
+
+#include "CommandList.h"
+#include "RadixSort.h"
+#include "RingAllocator.h"
+#include "SoftwareRasterizer.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Same meaning as the D3DXSPRITE_SORT_* flags; SPRITE_SORT_NONE keeps the
+// order of submission, queue by queue.
+enum SpriteSortMode {
+	SPRITE_SORT_NONE,
+	SPRITE_SORT_TEXTURE,
+	SPRITE_SORT_BACK_TO_FRONT,
+	SPRITE_SORT_FRONT_TO_BACK
+};
+
+struct Sprite {
+	ResourceHandle Texture;
+	// D3DCOLOR (0xAARRGGBB), multiplied with the texture.
+	uint32_t Color;
+	// Pixel position of the pivot.
+	XMFLOAT2 Position;
+	XMFLOAT2 Size;
+	// Pivot inside the sprite, from (0, 0) top left to (1, 1) bottom right.
+	XMFLOAT2 Pivot;
+	// Radians about the pivot, clockwise on screen.
+	float Rotation;
+	// 0 nearest to 1 farthest.
+	float Depth;
+	// Left, top, right and bottom texture coordinates.
+	XMFLOAT4 TexCoords;
+};
+
+// Vertex shader input, one per sprite. Corner (u, v) of the quad lands on
+// Origin + u AxisX + v AxisY and samples TexCoords at the same weights.
+struct SpriteInstance {
+	XMFLOAT2 Origin;
+	XMFLOAT2 AxisX;
+	XMFLOAT2 AxisY;
+	float Depth;
+	uint32_t Color;
+	XMFLOAT4 TexCoords;
+};
+
+struct SpriteBatch {
+	ResourceHandle Texture;
+	// Relative to the first instance of the last Build().
+	uint32_t StartInstance;
+	uint32_t InstanceCount;
+};
+
+struct SpriteStats {
+	uint32_t SpriteCount;
+	uint32_t BatchCount;
+	uint32_t LargestBatch;
+};
+
+class SpriteBatcher {
+public:
+	SpriteBatcher();
+
+	// One queue per producer. reservePerQueue avoids reallocation while
+	// recording.
+	void Initialize(uint32_t queueCount, uint32_t reservePerQueue = 0);
+	void Reset();
+	void SetSortMode(SpriteSortMode mode) { m_sortMode = mode; }
+
+	// Only one thread may draw to a given queue at a time.
+	void Draw(uint32_t queue, const Sprite& sprite) { m_queues[queue].Sprites.push_back(sprite); }
+	void Draw(uint32_t queue, const Sprite* sprites, uint32_t count);
+
+	void Build(JobSystem* jobs);
+
+	const SpriteInstance* GetInstances() const {
+		return m_instances.empty() ? nullptr : &m_instances[0];
+	}
+	const SpriteBatch* GetBatches() const { return m_batches.empty() ? nullptr : &m_batches[0]; }
+	uint32_t GetBatchCount() const { return (uint32_t)m_batches.size(); }
+	const SpriteStats& GetStats() const { return m_stats; }
+
+	// Copies the instances of the last Build() into ring. Returns false if
+	// the ring is full.
+	bool Upload(RingAllocator& ring);
+	// Binds the texture and the uploaded instance stream in slot 0 and
+	// records the instanced strip. Shaders, blend state and the input
+	// layout are left to the caller.
+	void Record(CommandList& list, const SpriteBatch& batch) const;
+
+	// CPU backend. textures[handle] is the image for a texture handle;
+	// handles without one draw in their color alone.
+	void Rasterize(ColorBuffer& target, const ScissorRect& scissor,
+			const ColorBuffer* const* textures, uint32_t textureCount, JobSystem* jobs) const;
+
+private:
+	SpriteBatcher(const SpriteBatcher&);
+	SpriteBatcher& operator=(const SpriteBatcher&);
+
+	struct Queue {
+		std::vector<Sprite> Sprites;
+		// Keeps neighbouring producers off each other's cache lines.
+		char Padding[64];
+	};
+
+	uint64_t GetSortKey(const Sprite& sprite) const;
+	const Sprite& GetSprite(uint32_t index) const;
+	void ExpandGroup(uint32_t group);
+	void DrawBand(ColorBuffer& target, const ScissorRect& clip, uint32_t band,
+			const ColorBuffer* const* textures, uint32_t textureCount) const;
+
+	std::vector<Queue> m_queues;
+	// First global sprite index of every queue, plus the total.
+	std::vector<uint32_t> m_queueOffsets;
+	std::vector<SortItem> m_items;
+	std::vector<SortItem> m_scratch;
+	std::vector<SpriteInstance> m_instances;
+	std::vector<ResourceHandle> m_textures;
+	// Screen bounds of the sorted sprites, padded to a multiple of four
+	// with empty boxes so bands can test four at a time.
+	std::vector<XMFLOAT4> m_minX;
+	std::vector<XMFLOAT4> m_minY;
+	std::vector<XMFLOAT4> m_maxX;
+	std::vector<XMFLOAT4> m_maxY;
+	std::vector<SpriteBatch> m_batches;
+	SpriteStats m_stats;
+	SpriteSortMode m_sortMode;
+	ResourceHandle m_instanceBuffer;
+	uint32_t m_baseInstance;
+};
+
+} // namespace Zeus
+
+#endif /* SPRITEBATCHER_H_ */
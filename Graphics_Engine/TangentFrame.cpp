@@ -0,0 +1,330 @@
+/*
+ * TangentFrame.cpp
+ *
+ */
+
+#include "TangentFrame.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Zeus {
+
+namespace {
+
+// Triangles or vertices per job.
+const uint32_t TANGENT_GRAIN = 4096;
+// Texture space determinants below this have no usable partials.
+const float MIN_DETERMINANT = 1e-12f;
+
+// What a triangle contributes to one of its corners.
+struct CornerFrame {
+	XMFLOAT3 Normal;
+	XMFLOAT3 Tangent;
+	XMFLOAT3 Binormal;
+	// 0 for triangles without area.
+	float Weight;
+};
+
+struct FrameSum {
+	XMFLOAT3 Normal;
+	XMFLOAT3 Tangent;
+	XMFLOAT3 Binormal;
+	float Weight;
+};
+
+void Accumulate(XMFLOAT3& sum, const XMFLOAT3& value, float weight) {
+	XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum),
+			XMVectorScale(XMLoadFloat3(&value), weight)));
+}
+
+template <typename T>
+const T& Fetch(const T* data, uint32_t stride, uint32_t index) {
+	return *reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(data)
+			+ (size_t)index * (stride ? stride : sizeof(T)));
+}
+
+float WrapDelta(float delta) {
+	return delta - floorf(delta + 0.5f);
+}
+
+// Some unit vector orthogonal to n.
+XMVECTOR Perpendicular(FXMVECTOR n) {
+	XMFLOAT3 a;
+	XMStoreFloat3(&a, XMVectorAbs(n));
+	XMVECTOR axis = a.x <= a.y && a.x <= a.z ? g_XMIdentityR0
+			: a.y <= a.z ? g_XMIdentityR1 : g_XMIdentityR2;
+	return XMVector3Normalize(XMVector3Cross(n, axis));
+}
+
+// Cosine between a and b, or 1 when either has no direction.
+float Cosine(const XMFLOAT3& a, const XMFLOAT3& b) {
+	XMVECTOR va = XMLoadFloat3(&a);
+	XMVECTOR vb = XMLoadFloat3(&b);
+	float lengths = XMVectorGetX(XMVector3Length(va)) * XMVectorGetX(XMVector3Length(vb));
+	return lengths > 0.0f ? XMVectorGetX(XMVector3Dot(va, vb)) / lengths : 1.0f;
+}
+
+// Makes primary orthogonal to n and derives secondary from both, keeping
+// the side secondary was on. Lengths are kept unless normalized.
+void Orthogonalize(FXMVECTOR n, XMVECTOR& primary, XMVECTOR& secondary, bool normalize) {
+	float primaryLength = XMVectorGetX(XMVector3Length(primary));
+	float secondaryLength = XMVectorGetX(XMVector3Length(secondary));
+	XMVECTOR direction = XMVector3Normalize(XMVectorSubtract(primary,
+			XMVectorMultiply(n, XMVector3Dot(n, primary))));
+	if (XMVector3Equal(direction, XMVectorZero()))
+		direction = Perpendicular(n);
+	XMVECTOR cross = XMVector3Cross(n, direction);
+	if (XMVectorGetX(XMVector3Dot(cross, secondary)) < 0.0f)
+		cross = XMVectorNegate(cross);
+	primary = normalize ? direction : XMVectorScale(direction, primaryLength);
+	secondary = normalize ? cross : XMVectorScale(cross, secondaryLength);
+}
+
+// Orders the corners of a vertex by the other two vertices of their
+// triangle, which does not depend on the order of the triangles.
+uint64_t GetCornerKey(const uint32_t* indices, uint32_t c) {
+	uint32_t t = c - c % 3;
+	return (uint64_t)indices[t + (c + 1) % 3] << 32 | indices[t + (c + 2) % 3];
+}
+
+} // namespace
+
+bool ComputeTangentFrame(const TangentSource& source, const TangentSettings& settings,
+		TangentFrameResult& result, JobSystem* jobs) {
+	if (!source.TexCoords || (!settings.CalculateNormals && !source.Normals))
+		return false;
+	const uint32_t triangleCount = source.IndexCount / 3;
+	const uint32_t cornerCount = triangleCount * 3;
+	const uint32_t vertexCount = source.VertexCount;
+	const uint32_t* indices = source.Indices;
+
+	std::vector<CornerFrame> frames(cornerCount);
+	ParallelFor(jobs, triangleCount, TANGENT_GRAIN, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t t = begin; t < end; ++t) {
+			// Starts from the lowest index, so a rotated triangle rounds the
+			// same way.
+			const uint32_t* triangle = &indices[t * 3];
+			uint32_t first = triangle[1] < triangle[0] ? 1 : 0;
+			if (triangle[2] < triangle[first])
+				first = 2;
+			uint32_t order[3] = { first, (first + 1) % 3, (first + 2) % 3 };
+			XMVECTOR p[3];
+			XMFLOAT2 uv[3];
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = triangle[order[k]];
+				p[k] = XMLoadFloat3(&Fetch(source.Positions, source.PositionStride, v));
+				uv[k] = Fetch(source.TexCoords, source.TexCoordStride, v);
+			}
+			XMVECTOR e1 = XMVectorSubtract(p[1], p[0]);
+			XMVECTOR e2 = XMVectorSubtract(p[2], p[0]);
+			XMVECTOR normal = XMVector3Cross(e1, e2);
+			if (settings.CounterClockwise)
+				normal = XMVectorNegate(normal);
+			float area = 0.5f * XMVectorGetX(XMVector3Length(normal));
+			normal = XMVector3Normalize(normal);
+
+			float s1 = uv[1].x - uv[0].x;
+			float s2 = uv[2].x - uv[0].x;
+			float t1 = uv[1].y - uv[0].y;
+			float t2 = uv[2].y - uv[0].y;
+			if (settings.WrapU) {
+				s1 = WrapDelta(s1);
+				s2 = WrapDelta(s2);
+			}
+			if (settings.WrapV) {
+				t1 = WrapDelta(t1);
+				t2 = WrapDelta(t2);
+			}
+			float determinant = s1 * t2 - s2 * t1;
+			XMVECTOR tangent = XMVectorZero();
+			XMVECTOR binormal = XMVectorZero();
+			if (fabsf(determinant) > MIN_DETERMINANT) {
+				float inverse = 1.0f / determinant;
+				tangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, t2),
+						XMVectorScale(e2, t1)), inverse);
+				binormal = XMVectorScale(XMVectorSubtract(XMVectorScale(e2, s1),
+						XMVectorScale(e1, s2)), inverse);
+				if (settings.NormalizePartials) {
+					tangent = XMVector3Normalize(tangent);
+					binormal = XMVector3Normalize(binormal);
+				}
+			}
+
+			for (uint32_t k = 0; k < 3; ++k) {
+				CornerFrame& frame = frames[t * 3 + order[k]];
+				XMStoreFloat3(&frame.Normal, normal);
+				XMStoreFloat3(&frame.Tangent, tangent);
+				XMStoreFloat3(&frame.Binormal, binormal);
+				if (area <= 0.0f) {
+					frame.Weight = 0.0f;
+				} else if (settings.Weighting == TANGENT_WEIGHT_AREA) {
+					frame.Weight = area;
+				} else if (settings.Weighting == TANGENT_WEIGHT_EQUAL) {
+					frame.Weight = 1.0f;
+				} else {
+					XMVECTOR a = XMVector3Normalize(XMVectorSubtract(p[(k + 1) % 3], p[k]));
+					XMVECTOR b = XMVector3Normalize(XMVectorSubtract(p[(k + 2) % 3], p[k]));
+					float cosine = XMVectorGetX(XMVector3Dot(a, b));
+					frame.Weight = acosf(std::min(std::max(cosine, -1.0f), 1.0f));
+				}
+			}
+		}
+	});
+
+	// Corners of every vertex, sorted by key below.
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t c = 0; c < cornerCount; ++c)
+		++offsets[indices[c] + 1];
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> corners(cornerCount);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t c = 0; c < cornerCount; ++c)
+		corners[fill[indices[c]]++] = c;
+
+	// Groups the corners of every vertex. Corners without partials fit any
+	// group, and corners without area join the first.
+	std::vector<uint32_t> groups(cornerCount, 0);
+	std::vector<uint32_t> groupCounts(vertexCount, 1);
+	const float partialThreshold = settings.PartialEdgeThreshold;
+	ParallelFor(jobs, vertexCount, TANGENT_GRAIN, [&](uint32_t begin, uint32_t end) {
+		std::vector<uint32_t> firsts;
+		std::vector<XMFLOAT4> directions;
+		std::vector<uint8_t> singular;
+		for (uint32_t v = begin; v < end; ++v) {
+			std::sort(corners.begin() + offsets[v], corners.begin() + offsets[v + 1],
+					[&](uint32_t a, uint32_t b) -> bool {
+				uint64_t keyA = GetCornerKey(indices, a);
+				uint64_t keyB = GetCornerKey(indices, b);
+				return keyA < keyB || (keyA == keyB && a < b);
+			});
+			firsts.clear();
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t c = corners[i];
+				const CornerFrame& frame = frames[c];
+				if (frame.Weight <= 0.0f)
+					continue;
+				uint32_t g = 0;
+				for (; g < firsts.size(); ++g) {
+					const CornerFrame& first = frames[firsts[g]];
+					if (Cosine(frame.Tangent, first.Tangent) > partialThreshold &&
+							Cosine(frame.Binormal, first.Binormal) > partialThreshold &&
+							(!settings.CalculateNormals ||
+							Cosine(frame.Normal, first.Normal) > settings.NormalEdgeThreshold))
+						break;
+				}
+				if (g == firsts.size())
+					firsts.push_back(c);
+				groups[c] = g;
+			}
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t c = corners[i];
+				if (frames[c].Weight > 0.0f)
+					continue;
+				if (firsts.empty())
+					firsts.push_back(c);
+				groups[c] = 0;
+			}
+
+			// Averages the partial directions of every group; short ones
+			// cancel out and split into their corners.
+			directions.assign(firsts.size() * 2, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t c = corners[i];
+				const CornerFrame& frame = frames[c];
+				XMVECTOR weight = XMVectorReplicate(frame.Weight);
+				XMVECTOR tangent = XMVector3Normalize(XMLoadFloat3(&frame.Tangent));
+				XMVECTOR binormal = XMVector3Normalize(XMLoadFloat3(&frame.Binormal));
+				if (XMVector3Equal(tangent, XMVectorZero()))
+					continue;
+				// The weight sums up in w.
+				tangent = XMVectorSetW(tangent, 1.0f);
+				binormal = XMVectorSetW(binormal, 1.0f);
+				XMFLOAT4* sums = &directions[groups[c] * 2];
+				XMStoreFloat4(&sums[0], XMVectorAdd(XMLoadFloat4(&sums[0]),
+						XMVectorMultiply(tangent, weight)));
+				XMStoreFloat4(&sums[1], XMVectorAdd(XMLoadFloat4(&sums[1]),
+						XMVectorMultiply(binormal, weight)));
+			}
+			uint32_t count = (uint32_t)std::max(firsts.size(), (size_t)1);
+			singular.assign(firsts.size(), 0);
+			for (size_t g = 0; g < firsts.size(); ++g) {
+				const XMFLOAT4* sums = &directions[g * 2];
+				float threshold = settings.SingularPointThreshold * sums[0].w;
+				singular[g] = sums[0].w > 0.0f &&
+						(XMVectorGetX(XMVector3Length(XMLoadFloat4(&sums[0]))) <= threshold ||
+						XMVectorGetX(XMVector3Length(XMLoadFloat4(&sums[1]))) <= threshold);
+			}
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t c = corners[i];
+				// The first corner keeps the group; the rest move out.
+				if (singular[groups[c]] && firsts[groups[c]] != c)
+					groups[c] = count++;
+			}
+			groupCounts[v] = count;
+		}
+	});
+
+	// Split vertices follow the input ones.
+	std::vector<uint32_t> splitBases(vertexCount);
+	uint32_t outputCount = vertexCount;
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		splitBases[v] = outputCount - 1;
+		outputCount += groupCounts[v] - 1;
+	}
+	result.Indices.resize(cornerCount);
+	result.VertexRemap.resize(outputCount);
+	result.Normals.resize(outputCount);
+	result.Tangents.resize(outputCount);
+	result.Binormals.resize(outputCount);
+
+	bool normalize = settings.NormalizePartials;
+	ParallelFor(jobs, vertexCount, TANGENT_GRAIN, [&](uint32_t begin, uint32_t end) {
+		std::vector<FrameSum> sums;
+		for (uint32_t v = begin; v < end; ++v) {
+			FrameSum zero = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f),
+					XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f };
+			sums.assign(groupCounts[v], zero);
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+				uint32_t c = corners[i];
+				const CornerFrame& frame = frames[c];
+				FrameSum& sum = sums[groups[c]];
+				Accumulate(sum.Normal, frame.Normal, frame.Weight);
+				Accumulate(sum.Tangent, frame.Tangent, frame.Weight);
+				Accumulate(sum.Binormal, frame.Binormal, frame.Weight);
+				sum.Weight += frame.Weight;
+				result.Indices[c] = groups[c] ? splitBases[v] + groups[c] : v;
+			}
+
+			XMVECTOR given = settings.CalculateNormals ? XMVectorZero()
+					: XMLoadFloat3(&Fetch(source.Normals, source.NormalStride, v));
+			for (uint32_t g = 0; g < groupCounts[v]; ++g) {
+				const FrameSum& sum = sums[g];
+				uint32_t o = g ? splitBases[v] + g : v;
+				float inverse = sum.Weight > 0.0f ? 1.0f / sum.Weight : 0.0f;
+				XMVECTOR normal = settings.CalculateNormals
+						? XMVector3Normalize(XMLoadFloat3(&sum.Normal)) : given;
+				XMVECTOR unit = XMVector3Normalize(normal);
+				XMVECTOR tangent = XMVectorScale(XMLoadFloat3(&sum.Tangent), inverse);
+				XMVECTOR binormal = XMVectorScale(XMLoadFloat3(&sum.Binormal), inverse);
+				if (settings.Orthogonalization == TANGENT_ORTHOGONALIZE_FROM_U) {
+					Orthogonalize(unit, tangent, binormal, normalize);
+				} else if (settings.Orthogonalization == TANGENT_ORTHOGONALIZE_FROM_V) {
+					Orthogonalize(unit, binormal, tangent, normalize);
+				} else if (normalize) {
+					tangent = XMVector3Normalize(tangent);
+					binormal = XMVector3Normalize(binormal);
+				}
+				result.VertexRemap[o] = v;
+				XMStoreFloat3(&result.Normals[o], normal);
+				XMStoreFloat3(&result.Tangents[o], tangent);
+				XMStoreFloat3(&result.Binormals[o], binormal);
+			}
+		}
+	});
+	return true;
+}
+
+} // namespace Zeus
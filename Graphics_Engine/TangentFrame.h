@@ -0,0 +1,118 @@
+/*
+ * TangentFrame.h
+ *
+ * Tangent frame generation replacing D3DXComputeTangentFrameEx, with the
+ * same weighting, orthogonalization and splitting options, in parallel and
+ * without D3DX.
+ *
+ * Every triangle contributes its normal and the partial derivatives of
+ * position with respect to u and v to each of its corners, weighted by the
+ * corner angle, the triangle area or equally. The corners of a vertex are
+ * then grouped: a corner joins the first group whose first corner has
+ * compatible partials and normal, so vertices split along seams where the
+ * texture mirrors or the surface creases, as with the D3DX thresholds. A
+ * group whose partials cancel out below the singular point threshold, as
+ * at the pole of a sphere, splits into one vertex per corner. Each group
+ * sums its contributions and orthogonalizes the result.
+ *
+ * Triangles are evaluated in parallel, and vertices are grouped and summed
+ * in parallel. Each triangle is evaluated from its lowest index, and each
+ * vertex groups and sums its corners sorted by the other two vertices of
+ * their triangles, so frames depend neither on the thread count nor on the
+ * order or rotation of the triangles, and baked normal maps see the same
+ * frames on every machine.
+ *
+ * The first VertexCount output vertices are the input vertices; vertices
+ * split off follow in order of the vertex they came from. VertexRemap
+ * names the input vertex of every output vertex, like the remap
+ * D3DXComputeTangentFrameEx returns.
+ */
+
+#ifndef TANGENTFRAME_H_
+#define TANGENTFRAME_H_
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum TangentWeighting {
+	TANGENT_WEIGHT_ANGLE,
+	TANGENT_WEIGHT_AREA,
+	TANGENT_WEIGHT_EQUAL
+};
+
+enum TangentOrthogonalization {
+	// The u partial is made orthogonal to the normal; the v partial is the
+	// cross product of the two, keeping its handedness.
+	TANGENT_ORTHOGONALIZE_FROM_U,
+	TANGENT_ORTHOGONALIZE_FROM_V,
+	TANGENT_DONT_ORTHOGONALIZE
+};
+
+// Positions, normals and texture coordinates are each the given number of
+// bytes apart; a stride of 0 means packed.
+struct TangentSource {
+	const uint32_t* Indices;
+	uint32_t IndexCount;
+	const XMFLOAT3* Positions;
+	uint32_t PositionStride;
+	uint32_t VertexCount;
+	// Only read when normals are not calculated.
+	const XMFLOAT3* Normals;
+	uint32_t NormalStride;
+	const XMFLOAT2* TexCoords;
+	uint32_t TexCoordStride;
+};
+
+struct TangentSettings {
+	TangentWeighting Weighting;
+	TangentOrthogonalization Orthogonalization;
+	// Texture coordinates wrap, so differences take the shorter way round.
+	bool WrapU;
+	bool WrapV;
+	// Unit partials; otherwise their length measures texture stretch.
+	bool NormalizePartials;
+	// Recomputes normals from the triangles instead of reading them.
+	bool CalculateNormals;
+	// Front faces are clockwise, as in D3D; D3DX assumes counterclockwise.
+	bool CounterClockwise;
+	// Corners split when the cosine between their partials is at most
+	// this; below -1 never splits.
+	float PartialEdgeThreshold;
+	// Groups split entirely when their averaged partials are no longer.
+	float SingularPointThreshold;
+	// Corners split when the cosine between their calculated normals is
+	// at most this.
+	float NormalEdgeThreshold;
+
+	TangentSettings()
+		: Weighting(TANGENT_WEIGHT_ANGLE), Orthogonalization(TANGENT_ORTHOGONALIZE_FROM_U),
+		WrapU(false), WrapV(false), NormalizePartials(true), CalculateNormals(false),
+		CounterClockwise(false), PartialEdgeThreshold(0.01f), SingularPointThreshold(0.25f),
+		NormalEdgeThreshold(0.01f) {}
+};
+
+struct TangentFrameResult {
+	// The source triangles over the output vertices.
+	std::vector<uint32_t> Indices;
+	// Input vertex of every output vertex.
+	std::vector<uint32_t> VertexRemap;
+	std::vector<XMFLOAT3> Normals;
+	std::vector<XMFLOAT3> Tangents;
+	std::vector<XMFLOAT3> Binormals;
+};
+
+// Returns false without texture coordinates, or without normals when they
+// are not calculated.
+bool ComputeTangentFrame(const TangentSource& source, const TangentSettings& settings,
+		TangentFrameResult& result, JobSystem* jobs);
+
+} // namespace Zeus
+
+#endif /* TANGENTFRAME_H_ */
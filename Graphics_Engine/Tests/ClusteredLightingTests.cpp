@@ -0,0 +1,203 @@
+/*
+ * ClusteredLightingTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../ClusteredLighting.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+ClusterGridDesc MakeDesc() {
+	ClusterGridDesc desc;
+	desc.TilesX = 16;
+	desc.TilesY = 9;
+	desc.Slices = 24;
+	desc.FovY = XM_PI / 3.0f;
+	desc.AspectRatio = 16.0f / 9.0f;
+	desc.NearZ = 0.1f;
+	desc.FarZ = 200.0f;
+	return desc;
+}
+
+// Point and spot lights scattered through the view of a camera looking
+// down +x, a third of them spots in random directions.
+void MakeLights(TestRandom& random, uint32_t count, std::vector<ClusterLight>& lights) {
+	lights.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		ClusterLight& light = lights[i];
+		light.Position = XMFLOAT3(random.NextFloat() * 120.0f - 5.0f,
+				random.NextFloat() * 60.0f - 30.0f, random.NextFloat() * 100.0f - 50.0f);
+		light.Range = 0.5f + random.NextFloat() * 7.5f;
+		XMVECTOR direction = XMVector3Normalize(XMVectorSet(random.NextFloat() - 0.5f,
+				random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, 0.0f));
+		XMStoreFloat3(&light.Direction, direction);
+		light.SpotAngle = 0.15f + random.NextFloat() * 0.9f;
+		light.Color = XMFLOAT3(1.0f, 0.5f, 0.25f);
+		light.Type = i % 3 == 0 ? LIGHT_SPOT : LIGHT_POINT;
+	}
+}
+
+XMMATRIX MakeView() {
+	return XMMatrixLookAtLH(XMVectorSet(-10.0f, 2.0f, 0.0f, 1.0f),
+			XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+// True when the light reaches the view space point, with a small margin
+// so points on a froxel boundary do not hang on rounding.
+bool Reaches(const PackedLight& light, float x, float y, float z) {
+	float dx = x - light.PositionRange.x;
+	float dy = y - light.PositionRange.y;
+	float dz = z - light.PositionRange.z;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+	if (distance >= light.PositionRange.w * 0.999f)
+		return false;
+	if (light.ColorType.w != (float)LIGHT_SPOT || distance == 0.0f)
+		return true;
+	float along = (dx * light.DirectionCosAngle.x + dy * light.DirectionCosAngle.y +
+			dz * light.DirectionCosAngle.z) / distance;
+	return along > light.DirectionCosAngle.w + 1e-3f;
+}
+
+// True unless a light reaching the view space point is missing from the
+// point's cluster. Points outside the grid pass.
+bool Covers(const ClusteredLighting& clusters, float x, float y, float z, uint32_t& reached) {
+	const ClusterGridDesc& desc = clusters.GetDesc();
+	const float tanY = tanf(desc.FovY * 0.5f);
+	const float u = (x / (z * tanY * desc.AspectRatio) + 1.0f) * 0.5f;
+	const float v = (1.0f - y / (z * tanY)) * 0.5f;
+	if (z < desc.NearZ || z > desc.FarZ || u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+		return true;
+	const ClusterRange& range = clusters.GetCluster(clusters.GetClusterIndex(u, v, z));
+	const uint16_t* indices = clusters.GetLightIndices() + range.Offset;
+	for (uint32_t l = 0; l < clusters.GetStats().LightCount; ++l) {
+		if (!Reaches(clusters.GetLights()[l], x, y, z))
+			continue;
+		++reached;
+		bool found = false;
+		for (uint32_t k = 0; k < range.Count && !found; ++k)
+			found = indices[k] == l;
+		if (!found)
+			return false;
+	}
+	return true;
+}
+
+// Every light reaching a point is in the list of the point's cluster, the
+// lists are sorted, and most clusters see a small share of the lights.
+// Points are spread through the frustum and packed around the spot lights,
+// whose cones cull the most.
+void TestConservative(TestContext& context) {
+	ClusteredLighting clusters;
+	const ClusterGridDesc desc = MakeDesc();
+	if (!TEST_CHECK(context, clusters.Initialize(desc)))
+		return;
+	TestRandom random(33);
+	std::vector<ClusterLight> lights;
+	MakeLights(random, 2000, lights);
+	if (!TEST_CHECK(context, clusters.Build(&lights[0], 2000, MakeView(), context.Jobs)))
+		return;
+
+	// The camera at (-10, 2, 0) looks down +x with y up, so view space is
+	// (-z, y - 2, x + 10) of world space.
+	const PackedLight& packed = clusters.GetLights()[7];
+	TEST_CHECK(context, fabsf(packed.PositionRange.x + lights[7].Position.z) < 1e-4f &&
+			fabsf(packed.PositionRange.y - lights[7].Position.y + 2.0f) < 1e-4f &&
+			fabsf(packed.PositionRange.z - lights[7].Position.x - 10.0f) < 1e-4f);
+
+	const float tanY = tanf(desc.FovY * 0.5f);
+	const float tanX = tanY * desc.AspectRatio;
+	uint32_t reached = 0;
+	bool covered = true;
+	for (uint32_t p = 0; p < 20000; ++p) {
+		float u = random.NextFloat();
+		float v = random.NextFloat();
+		float z = desc.NearZ * powf(desc.FarZ / desc.NearZ, random.NextFloat());
+		covered = covered && Covers(clusters, (2.0f * u - 1.0f) * tanX * z,
+				(1.0f - 2.0f * v) * tanY * z, z, reached);
+	}
+	for (uint32_t l = 0; l < 2000; l += 3) {
+		const XMFLOAT4& light = clusters.GetLights()[l].PositionRange;
+		for (uint32_t p = 0; p < 40; ++p)
+			covered = covered && Covers(clusters,
+					light.x + (random.NextFloat() * 2.0f - 1.0f) * light.w,
+					light.y + (random.NextFloat() * 2.0f - 1.0f) * light.w,
+					light.z + (random.NextFloat() * 2.0f - 1.0f) * light.w, reached);
+	}
+	bool sorted = true;
+	for (uint32_t c = 0; c < clusters.GetClusterCount(); ++c) {
+		const ClusterRange& range = clusters.GetCluster(c);
+		const uint16_t* indices = clusters.GetLightIndices() + range.Offset;
+		for (uint32_t k = 1; k < range.Count; ++k)
+			sorted = sorted && indices[k - 1] < indices[k];
+	}
+	const ClusterStats& stats = clusters.GetStats();
+	printf("Clustered lighting: %u lights, %u of %u clusters lit, %.1f lights each, "
+			"at most %u\n", stats.LightCount, stats.OccupiedClusters, stats.ClusterCount,
+			(float)stats.LightReferences / stats.OccupiedClusters, stats.MaxLightsPerCluster);
+	TEST_CHECK(context, covered && sorted && reached > 10000);
+	TEST_CHECK(context, stats.LightReferences < stats.ClusterCount * 2000u / 50);
+}
+
+// Serial and parallel builds agree, the upload copies the arrays as they
+// are, and too many lights or a bad grid fail.
+void TestBuild(TestContext& context) {
+	ClusteredLighting clusters;
+	if (!TEST_CHECK(context, clusters.Initialize(MakeDesc())))
+		return;
+	TestRandom random(34);
+	std::vector<ClusterLight> lights;
+	MakeLights(random, 3000, lights);
+	clusters.Build(&lights[0], 3000, MakeView(), nullptr);
+	const uint32_t clusterCount = clusters.GetClusterCount();
+	std::vector<ClusterRange> ranges(clusters.GetLightIndices() ? clusterCount : 0);
+	for (uint32_t c = 0; c < (uint32_t)ranges.size(); ++c)
+		ranges[c] = clusters.GetCluster(c);
+	std::vector<uint16_t> indices(clusters.GetLightIndices(),
+			clusters.GetLightIndices() + clusters.GetStats().LightReferences);
+	clusters.Build(&lights[0], 3000, MakeView(), context.Jobs);
+	bool same = !ranges.empty() && clusters.GetStats().LightReferences == indices.size() &&
+			memcmp(clusters.GetLightIndices(), &indices[0],
+			indices.size() * sizeof(uint16_t)) == 0;
+	for (uint32_t c = 0; same && c < clusterCount; ++c)
+		same = memcmp(&clusters.GetCluster(c), &ranges[c], sizeof(ClusterRange)) == 0;
+	TEST_CHECK(context, same);
+
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize(1 << 20, NULL_RESOURCE)))
+		return;
+	ClusterUpload upload;
+	TEST_CHECK(context, clusters.Upload(ring, &upload) &&
+			memcmp(upload.Lights.CpuAddress, clusters.GetLights(),
+			3000 * sizeof(PackedLight)) == 0 &&
+			memcmp(upload.Ranges.CpuAddress, &ranges[0],
+			clusterCount * sizeof(ClusterRange)) == 0 &&
+			memcmp(upload.Indices.CpuAddress, &indices[0],
+			indices.size() * sizeof(uint16_t)) == 0);
+
+	lights.resize(ClusteredLighting::MAX_LIGHTS + 1, lights[0]);
+	TEST_CHECK(context, !clusters.Build(&lights[0], (uint32_t)lights.size(), MakeView(),
+			context.Jobs));
+	ClusterGridDesc desc = MakeDesc();
+	desc.FarZ = desc.NearZ;
+	TEST_CHECK(context, !clusters.Initialize(desc));
+	desc = MakeDesc();
+	desc.TilesX = 512;
+	desc.TilesY = 256;
+	TEST_CHECK(context, !clusters.Initialize(desc));
+}
+
+} // namespace
+
+void RunClusteredLightingTests(TestContext& context) {
+	TestConservative(context);
+	TestBuild(context);
+}
+
+} // namespace Zeus
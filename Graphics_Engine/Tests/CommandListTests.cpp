@@ -0,0 +1,274 @@
+/*
+ * CommandListTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../CommandList.h"
+#include "../JobSystem.h"
+
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+// Flattens every call into words, so a replayed list compares against the
+// same calls made directly.
+class TraceBackend : public CommandBackend {
+public:
+	std::vector<uint32_t> Trace;
+
+	void BeginCommandList(uint32_t order) { Add(1000, order); }
+	void EndCommandList() { Add(1001); }
+
+	void SetRenderTargets(uint32_t count, const ResourceHandle* targets,
+			ResourceHandle depthStencil) {
+		Add(CMD_SET_RENDER_TARGETS, count, depthStencil);
+		Trace.insert(Trace.end(), targets, targets + count);
+	}
+	void ClearRenderTarget(ResourceHandle target, const float color[4]) {
+		Add(CMD_CLEAR_RENDER_TARGET, target);
+		AddFloats(color, 4);
+	}
+	void ClearDepthStencil(ResourceHandle depthStencil, uint32_t flags, float depth,
+			uint8_t stencil) {
+		Add(CMD_CLEAR_DEPTH_STENCIL, depthStencil, flags, stencil);
+		AddFloats(&depth, 1);
+	}
+	void SetViewport(const Viewport& viewport) {
+		Add(CMD_SET_VIEWPORT);
+		AddFloats(&viewport.TopLeftX, 6);
+	}
+	void SetScissor(const ScissorRect& rect) {
+		Add(CMD_SET_SCISSOR, rect.Left, rect.Top, rect.Right);
+		Add(rect.Bottom);
+	}
+	void SetShaders(ResourceHandle vertexShader, ResourceHandle pixelShader) {
+		Add(CMD_SET_SHADERS, vertexShader, pixelShader);
+	}
+	void SetBlendState(uint32_t state, const float blendFactor[4]) {
+		Add(CMD_SET_BLEND_STATE, state);
+		AddFloats(blendFactor, 4);
+	}
+	void SetRasterizerState(uint32_t state) { Add(CMD_SET_RASTERIZER_STATE, state); }
+	void SetDepthStencilState(uint32_t state, uint32_t stencilRef) {
+		Add(CMD_SET_DEPTH_STENCIL_STATE, state, stencilRef);
+	}
+	void SetSamplers(ShaderStage stage, uint32_t slot, uint32_t count,
+			const uint32_t* samplers) {
+		Add(CMD_SET_SAMPLERS, stage, slot, count);
+		Trace.insert(Trace.end(), samplers, samplers + count);
+	}
+	void SetVertexBuffers(uint32_t slot, uint32_t count, const ResourceHandle* buffers,
+			const uint32_t* strides, const uint32_t* offsets) {
+		Add(CMD_SET_VERTEX_BUFFERS, slot, count);
+		Trace.insert(Trace.end(), buffers, buffers + count);
+		Trace.insert(Trace.end(), strides, strides + count);
+		Trace.insert(Trace.end(), offsets, offsets + count);
+	}
+	void SetIndexBuffer(ResourceHandle buffer, Format format, uint32_t offset) {
+		Add(CMD_SET_INDEX_BUFFER, buffer, format, offset);
+	}
+	void SetPrimitiveTopology(PrimitiveTopology topology) { Add(CMD_SET_TOPOLOGY, topology); }
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, ResourceHandle buffer,
+			uint32_t offset, uint32_t size) {
+		Add(CMD_SET_CONSTANT_BUFFER, stage, slot, buffer);
+		Add(offset, size);
+	}
+	void SetShaderResources(ShaderStage stage, uint32_t slot, uint32_t count,
+			const ResourceHandle* views) {
+		Add(CMD_SET_SHADER_RESOURCES, stage, slot, count);
+		Trace.insert(Trace.end(), views, views + count);
+	}
+	void UpdateBuffer(ResourceHandle buffer, uint32_t offset, const void* data,
+			uint32_t size) {
+		Add(CMD_UPDATE_BUFFER, buffer, offset, size);
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		Trace.insert(Trace.end(), bytes, bytes + size);
+	}
+	void Draw(uint32_t vertexCount, uint32_t startVertex, uint32_t instanceCount,
+			uint32_t startInstance) {
+		Add(CMD_DRAW, vertexCount, startVertex, instanceCount);
+		Add(startInstance);
+	}
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex,
+			uint32_t instanceCount, uint32_t startInstance) {
+		Add(CMD_DRAW_INDEXED, indexCount, startIndex, baseVertex);
+		Add(instanceCount, startInstance);
+	}
+	void Dispatch(uint32_t x, uint32_t y, uint32_t z) { Add(CMD_DISPATCH, x, y, z); }
+	void BeginMarker(const char* name) {
+		Add(CMD_BEGIN_MARKER);
+		Trace.insert(Trace.end(), name, name + strlen(name));
+	}
+	void EndMarker() { Add(CMD_END_MARKER); }
+
+private:
+	void Add(uint32_t a) { Trace.push_back(a); }
+	void Add(uint32_t a, uint32_t b) {
+		Trace.push_back(a);
+		Trace.push_back(b);
+	}
+	void Add(uint32_t a, uint32_t b, uint32_t c) {
+		Add(a, b);
+		Trace.push_back(c);
+	}
+	void Add(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+		Add(a, b);
+		Add(c, d);
+	}
+	void AddFloats(const float* values, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t bits;
+			memcpy(&bits, &values[i], sizeof(bits));
+			Trace.push_back(bits);
+		}
+	}
+};
+
+// Issues every command, drawCount draws and one update of updateSize bytes,
+// to a CommandList or directly to a backend; both take the same calls.
+template <typename Target>
+void RecordScene(Target& target, uint32_t seed, uint32_t drawCount, uint32_t updateSize) {
+	TestRandom random(seed);
+	const float color[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
+	const ResourceHandle targets[2] = { 11, 12 };
+	target.BeginMarker("Scene");
+	target.SetRenderTargets(2, targets, 13);
+	target.ClearRenderTarget(11, color);
+	target.ClearDepthStencil(13, CLEAR_DEPTH | CLEAR_STENCIL, 1.0f, 7);
+	Viewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	target.SetViewport(viewport);
+	ScissorRect scissor = { 0, 0, 1280, 720 };
+	target.SetScissor(scissor);
+	target.SetBlendState(3, color);
+	target.SetRasterizerState(4);
+	target.SetDepthStencilState(5, 1);
+	const uint32_t samplers[3] = { 1, 2, 3 };
+	target.SetSamplers(STAGE_PIXEL, 2, 3, samplers);
+	target.SetPrimitiveTopology(TOPOLOGY_TRIANGLELIST);
+	std::vector<uint8_t> data(updateSize);
+	for (uint32_t i = 0; i < updateSize; ++i)
+		data[i] = (uint8_t)random.Next();
+	target.UpdateBuffer(21, 16, &data[0], updateSize);
+	for (uint32_t i = 0; i < drawCount; ++i) {
+		ResourceHandle buffers[2] = { random.Next(100), random.Next(100) };
+		const uint32_t strides[2] = { 32, 16 };
+		const uint32_t offsets[2] = { 0, random.Next(1000) };
+		ResourceHandle vertexShader = random.Next(50);
+		target.SetShaders(vertexShader, vertexShader + 50);
+		target.SetVertexBuffers(0, 2, buffers, strides, offsets);
+		target.SetIndexBuffer(random.Next(100), FORMAT_R32_UINT, 0);
+		target.SetConstantBuffer(STAGE_VERTEX, 0, 22, random.Next(64) * 256, 256);
+		ResourceHandle view = random.Next(100);
+		target.SetShaderResources(STAGE_PIXEL, 0, 1, &view);
+		uint32_t count = random.Next(1000);
+		if (i % 2)
+			target.Draw(count, 0, 1, 0);
+		else
+			target.DrawIndexed(count, count / 3, -(int32_t)(count % 10), 1, 0);
+	}
+	target.Dispatch(8, 4, 1);
+	target.EndMarker();
+}
+
+// The direct calls a replayed list must reproduce.
+std::vector<uint32_t> GetDirectTrace(uint32_t order, uint32_t seed, uint32_t drawCount,
+		uint32_t updateSize) {
+	TraceBackend direct;
+	direct.BeginCommandList(order);
+	RecordScene(direct, seed, drawCount, updateSize);
+	direct.EndCommandList();
+	return direct.Trace;
+}
+
+// Small blocks make the list jump between blocks many times.
+void TestReplay(TestContext& context) {
+	CommandAllocator allocator;
+	TEST_CHECK(context, allocator.Initialize(64 * 1024, 256));
+	CommandList list;
+	list.Begin(&allocator, 0);
+	RecordScene(list, 1, 100, 40);
+	list.End();
+	TraceBackend replayed;
+	list.Replay(replayed);
+	TEST_CHECK(context, replayed.Trace == GetDirectTrace(0, 1, 100, 40));
+	TEST_CHECK(context, list.GetCommandCount() == 12 + 100 * 6 + 2);
+	TEST_CHECK(context, allocator.GetBlocksUsed() > 1 && allocator.GetHeapBlockCount() == 0);
+
+	// Lists replay by order, equal orders as passed.
+	CommandList lists[3];
+	const uint32_t orders[3] = { 2, 1, 2 };
+	for (uint32_t i = 0; i < 3; ++i) {
+		lists[i].Begin(&allocator, orders[i]);
+		RecordScene(lists[i], 10 + i, 5, 16);
+		lists[i].End();
+	}
+	CommandList* pointers[3] = { &lists[0], &lists[1], &lists[2] };
+	TraceBackend executed;
+	ExecuteCommandLists(pointers, 3, executed);
+	std::vector<uint32_t> expected = GetDirectTrace(1, 11, 5, 16);
+	std::vector<uint32_t> trace = GetDirectTrace(2, 10, 5, 16);
+	expected.insert(expected.end(), trace.begin(), trace.end());
+	trace = GetDirectTrace(2, 12, 5, 16);
+	expected.insert(expected.end(), trace.begin(), trace.end());
+	TEST_CHECK(context, executed.Trace == expected);
+}
+
+// A frame that outgrows the reservation, with a command larger than a
+// block, still replays whole; the next frame reuses the heap blocks.
+void TestGrowth(TestContext& context) {
+	CommandAllocator allocator;
+	TEST_CHECK(context, allocator.Initialize(512, 256));
+	uint32_t heapBlocks = 0;
+	bool whole = true;
+	for (uint32_t frame = 0; frame < 2; ++frame) {
+		allocator.Reset();
+		CommandList list;
+		list.Begin(&allocator, 0);
+		RecordScene(list, 2, 200, 3000);
+		list.End();
+		TraceBackend replayed;
+		list.Replay(replayed);
+		whole = whole && replayed.Trace == GetDirectTrace(0, 2, 200, 3000);
+		if (frame == 0)
+			heapBlocks = allocator.GetHeapBlockCount();
+	}
+	TEST_CHECK(context, whole);
+	TEST_CHECK(context, allocator.GetBlocksUsed() > allocator.GetBlockCount());
+	TEST_CHECK(context, heapBlocks > 0 && allocator.GetHeapBlockCount() == heapBlocks);
+
+	// Threads racing past the end of the reservation each get their own
+	// heap blocks.
+	const uint32_t listCount = 16;
+	allocator.Reset();
+	std::vector<CommandList> lists(listCount);
+	ParallelFor(context.Jobs, listCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			lists[i].Begin(&allocator, i);
+			RecordScene(lists[i], 100 + i, 50, 300);
+			lists[i].End();
+		}
+	});
+	std::vector<CommandList*> pointers(listCount);
+	std::vector<uint32_t> expected;
+	for (uint32_t i = 0; i < listCount; ++i) {
+		pointers[i] = &lists[listCount - 1 - i];
+		std::vector<uint32_t> trace = GetDirectTrace(i, 100 + i, 50, 300);
+		expected.insert(expected.end(), trace.begin(), trace.end());
+	}
+	TraceBackend executed;
+	ExecuteCommandLists(&pointers[0], listCount, executed);
+	TEST_CHECK(context, executed.Trace == expected);
+}
+
+} // namespace
+
+void RunCommandListTests(TestContext& context) {
+	TestReplay(context);
+	TestGrowth(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,269 @@
+/*
+ * ComputeTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../ComputeBenchmark.h"
+#include "../ComputeFFT.h"
+#include "../ComputeScan.h"
+#include "../JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+// Not a multiple of any chunk size, so the last chunk is partial.
+const uint32_t SCAN_TEST_SIZE = 100003;
+
+// Naive inclusive or exclusive add scan of one sequence.
+void ReferenceScan(const uint32_t* src, uint32_t count, bool backward, bool exclusive,
+		uint32_t* dst) {
+	uint32_t sum = 0;
+	for (uint32_t k = 0; k < count; ++k) {
+		uint32_t i = backward ? count - 1 - k : k;
+		if (exclusive) {
+			dst[i] = sum;
+			sum += src[i];
+		} else {
+			sum += src[i];
+			dst[i] = sum;
+		}
+	}
+}
+
+void TestScan(TestContext& context) {
+	TestRandom random(6);
+	std::vector<uint32_t> data(SCAN_TEST_SIZE);
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; ++i)
+		data[i] = random.Next(256);
+	std::vector<uint32_t> expected(SCAN_TEST_SIZE);
+	std::vector<uint32_t> result(SCAN_TEST_SIZE);
+
+	ComputeScan scan;
+	TEST_CHECK(context, scan.Initialize(context.Jobs, SCAN_TEST_SIZE, 64));
+	for (uint32_t mode = 0; mode < 4; ++mode) {
+		bool backward = (mode & 1) != 0;
+		bool exclusive = (mode & 2) != 0;
+		scan.SetScanDirection(backward ? SCAN_DIRECTION_BACKWARD : SCAN_DIRECTION_FORWARD);
+		scan.SetExclusive(exclusive);
+		ReferenceScan(&data[0], SCAN_TEST_SIZE, backward, exclusive, &expected[0]);
+		TEST_CHECK(context, scan.Scan(SCAN_DATA_TYPE_UINT, SCAN_OPCODE_ADD, SCAN_TEST_SIZE,
+				&data[0], &result[0]));
+		TEST_CHECK(context, result == expected);
+	}
+
+	// In place, and a min scan of signed values.
+	scan.SetScanDirection(SCAN_DIRECTION_FORWARD);
+	scan.SetExclusive(false);
+	result = data;
+	ReferenceScan(&data[0], SCAN_TEST_SIZE, false, false, &expected[0]);
+	TEST_CHECK(context, scan.Scan(SCAN_DATA_TYPE_UINT, SCAN_OPCODE_ADD, SCAN_TEST_SIZE,
+			&result[0], &result[0]));
+	TEST_CHECK(context, result == expected);
+	std::vector<int32_t> signedData(SCAN_TEST_SIZE);
+	std::vector<int32_t> signedResult(SCAN_TEST_SIZE);
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; ++i)
+		signedData[i] = (int32_t)random.Next(2000000) - 1000000;
+	TEST_CHECK(context, scan.Scan(SCAN_DATA_TYPE_INT, SCAN_OPCODE_MIN, SCAN_TEST_SIZE,
+			&signedData[0], &signedResult[0]));
+	bool minimum = true;
+	int32_t lowest = signedData[0];
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; ++i) {
+		lowest = std::min(lowest, signedData[i]);
+		minimum = minimum && signedResult[i] == lowest;
+	}
+	TEST_CHECK(context, minimum);
+
+	// Multiscan with a pitch beyond the scan size leaves the gaps alone.
+	const uint32_t scanSize = 1000;
+	const uint32_t pitch = 1024;
+	const uint32_t scanCount = 64;
+	std::vector<uint32_t> multi(pitch * scanCount);
+	for (size_t i = 0; i < multi.size(); ++i)
+		multi[i] = random.Next(256);
+	std::vector<uint32_t> multiResult(multi.size(), 0xFFFFFFFF);
+	TEST_CHECK(context, scan.Multiscan(SCAN_DATA_TYPE_UINT, SCAN_OPCODE_ADD, scanSize, pitch,
+			scanCount, &multi[0], &multiResult[0]));
+	bool multiMatches = true;
+	for (uint32_t s = 0; s < scanCount; ++s) {
+		ReferenceScan(&multi[s * pitch], scanSize, false, false, &expected[0]);
+		multiMatches = multiMatches &&
+				memcmp(&multiResult[s * pitch], &expected[0], scanSize * 4) == 0 &&
+				multiResult[s * pitch + scanSize] == 0xFFFFFFFF;
+	}
+	TEST_CHECK(context, multiMatches);
+
+	// Float sums chunk the same way with or without threads.
+	std::vector<float> floats(SCAN_TEST_SIZE);
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; ++i)
+		floats[i] = random.NextFloat();
+	std::vector<float> serial(SCAN_TEST_SIZE);
+	std::vector<float> parallel(SCAN_TEST_SIZE);
+	ComputeScan serialScan;
+	TEST_CHECK(context, serialScan.Initialize(nullptr, SCAN_TEST_SIZE, 1));
+	TEST_CHECK(context, serialScan.Scan(SCAN_DATA_TYPE_FLOAT, SCAN_OPCODE_ADD, SCAN_TEST_SIZE,
+			&floats[0], &serial[0]));
+	TEST_CHECK(context, scan.Scan(SCAN_DATA_TYPE_FLOAT, SCAN_OPCODE_ADD, SCAN_TEST_SIZE,
+			&floats[0], &parallel[0]));
+	TEST_CHECK(context, memcmp(&serial[0], &parallel[0], SCAN_TEST_SIZE * 4) == 0);
+}
+
+void TestSegmentedScan(TestContext& context) {
+	TestRandom random(7);
+	std::vector<uint32_t> data(SCAN_TEST_SIZE);
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; ++i)
+		data[i] = random.Next(256);
+	// Segments of random length, some of them a single element.
+	std::vector<uint32_t> flags((SCAN_TEST_SIZE + 31) / 32, 0);
+	std::vector<uint32_t> starts;
+	for (uint32_t i = 0; i < SCAN_TEST_SIZE; i += 1 + random.Next(3000)) {
+		flags[i >> 5] |= 1u << (i & 31);
+		starts.push_back(i);
+	}
+	starts.push_back(SCAN_TEST_SIZE);
+
+	ComputeSegmentedScan scan;
+	TEST_CHECK(context, scan.Initialize(context.Jobs, SCAN_TEST_SIZE));
+	std::vector<uint32_t> expected(SCAN_TEST_SIZE);
+	std::vector<uint32_t> result(SCAN_TEST_SIZE);
+	for (uint32_t mode = 0; mode < 4; ++mode) {
+		bool backward = (mode & 1) != 0;
+		bool exclusive = (mode & 2) != 0;
+		scan.SetScanDirection(backward ? SCAN_DIRECTION_BACKWARD : SCAN_DIRECTION_FORWARD);
+		scan.SetExclusive(exclusive);
+		for (size_t s = 0; s + 1 < starts.size(); ++s)
+			ReferenceScan(&data[starts[s]], starts[s + 1] - starts[s], backward, exclusive,
+					&expected[starts[s]]);
+		TEST_CHECK(context, scan.SegScan(SCAN_DATA_TYPE_UINT, SCAN_OPCODE_ADD, SCAN_TEST_SIZE,
+				&data[0], &flags[0], &result[0]));
+		TEST_CHECK(context, result == expected);
+	}
+}
+
+// Naive DFT of count complex values at stride, in double.
+void ReferenceDFT(const float* input, uint32_t count, uint32_t stride, double* output) {
+	const double PI = 3.14159265358979323846;
+	for (uint32_t k = 0; k < count; ++k) {
+		double real = 0.0;
+		double imaginary = 0.0;
+		for (uint32_t n = 0; n < count; ++n) {
+			double angle = -2.0 * PI * (double)((uint64_t)k * n % count) / count;
+			double x = input[n * stride * 2];
+			double y = input[n * stride * 2 + 1];
+			real += x * cos(angle) - y * sin(angle);
+			imaginary += x * sin(angle) + y * cos(angle);
+		}
+		output[k * 2] = real;
+		output[k * 2 + 1] = imaginary;
+	}
+}
+
+bool Transform(ComputeFFT& fft, const FFTBufferInfo& info, const std::vector<float>& input,
+		std::vector<float>& spectrum, std::vector<float>& roundTrip) {
+	std::vector<float> temp0(info.TempBufferFloatSizes[0]);
+	std::vector<float> temp1(info.TempBufferFloatSizes[1]);
+	float* temps[2] = { &temp0[0], &temp1[0] };
+	spectrum.assign(info.FrequencyFloatSize, 0.0f);
+	roundTrip.assign(info.SpatialFloatSize, 0.0f);
+	float* frequency = &spectrum[0];
+	float* spatial = &roundTrip[0];
+	return fft.AttachBuffers(2, temps) && fft.ForwardTransform(&input[0], &frequency) &&
+			fft.InverseTransform(&spectrum[0], &spatial);
+}
+
+float MaxDifference(const std::vector<float>& a, const std::vector<float>& b) {
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.size() && i < b.size(); ++i)
+		difference = std::max(difference, fabsf(a[i] - b[i]));
+	return a.size() == b.size() ? difference : FLT_MAX;
+}
+
+void TestFFT(TestContext& context) {
+	TestRandom random(8);
+
+	// 1D complex against the DFT, and back.
+	const uint32_t length = 1024;
+	ComputeFFT fft;
+	FFTBufferInfo info;
+	TEST_CHECK(context, fft.Initialize1DComplex(context.Jobs, length, &info));
+	std::vector<float> input(info.SpatialFloatSize);
+	for (size_t i = 0; i < input.size(); ++i)
+		input[i] = random.NextFloat() * 2.0f - 1.0f;
+	std::vector<float> spectrum;
+	std::vector<float> roundTrip;
+	TEST_CHECK(context, Transform(fft, info, input, spectrum, roundTrip));
+	std::vector<double> expected(length * 2);
+	ReferenceDFT(&input[0], length, 1, &expected[0]);
+	double worst = 0.0;
+	for (uint32_t i = 0; i < length * 2; ++i)
+		worst = std::max(worst, fabs(spectrum[i] - expected[i]));
+	TEST_CHECK(context, worst < 1e-3);
+	TEST_CHECK(context, MaxDifference(input, roundTrip) < 1e-5f);
+
+	// 2D real: the half spectrum against a DFT of the rows, then the
+	// columns, and the same result without threads.
+	const uint32_t width = 64;
+	const uint32_t height = 32;
+	const uint32_t halfWidth = width / 2 + 1;
+	TEST_CHECK(context, fft.Initialize2DReal(context.Jobs, width, height, &info));
+	TEST_CHECK(context, info.FrequencyFloatSize == halfWidth * height * 2);
+	input.resize(info.SpatialFloatSize);
+	for (size_t i = 0; i < input.size(); ++i)
+		input[i] = random.NextFloat() * 2.0f - 1.0f;
+	TEST_CHECK(context, Transform(fft, info, input, spectrum, roundTrip));
+	std::vector<float> complexInput(width * height * 2, 0.0f);
+	for (uint32_t i = 0; i < width * height; ++i)
+		complexInput[i * 2] = input[i];
+	std::vector<double> rows(width * 2);
+	std::vector<float> rowSpectra(width * height * 2);
+	for (uint32_t y = 0; y < height; ++y) {
+		ReferenceDFT(&complexInput[y * width * 2], width, 1, &rows[0]);
+		for (uint32_t i = 0; i < width * 2; ++i)
+			rowSpectra[y * width * 2 + i] = (float)rows[i];
+	}
+	std::vector<double> column(height * 2);
+	worst = 0.0;
+	for (uint32_t x = 0; x < halfWidth; ++x) {
+		ReferenceDFT(&rowSpectra[x * 2], height, width, &column[0]);
+		for (uint32_t y = 0; y < height; ++y) {
+			for (uint32_t c = 0; c < 2; ++c) {
+				double value = spectrum[(y * halfWidth + x) * 2 + c];
+				worst = std::max(worst, fabs(value - column[y * 2 + c]));
+			}
+		}
+	}
+	TEST_CHECK(context, worst < 1e-3);
+	TEST_CHECK(context, MaxDifference(input, roundTrip) < 1e-5f);
+
+	ComputeFFT serialFFT;
+	std::vector<float> serialSpectrum;
+	std::vector<float> serialRoundTrip;
+	TEST_CHECK(context, serialFFT.Initialize2DReal(nullptr, width, height, &info));
+	TEST_CHECK(context, Transform(serialFFT, info, input, serialSpectrum, serialRoundTrip));
+	TEST_CHECK(context, serialSpectrum == spectrum && serialRoundTrip == roundTrip);
+}
+
+void TestComputeBenchmarks(TestContext& context) {
+	ComputeBenchmarkResult results[BENCHMARK_KERNEL_COUNT];
+	TEST_CHECK(context, RunComputeBenchmarks(context.Jobs, nullptr, 5, results));
+	printf("Compute kernels on %u threads:\n", context.Jobs->GetThreadCount());
+	PrintComputeBenchmarks(stdout, results);
+}
+
+} // namespace
+
+void RunComputeTests(TestContext& context) {
+	TestScan(context);
+	TestSegmentedScan(context);
+	TestFFT(context);
+	TestComputeBenchmarks(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,152 @@
+/*
+ * DrawQueueTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../DrawQueue.h"
+#include "../JobSystem.h"
+#include "../RadixSort.h"
+#include "../Timer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+bool KeyLess(const SortItem& a, const SortItem& b) {
+	return a.Key < b.Key;
+}
+
+void TestSortKeys(TestContext& context) {
+	SortKeyEncoder opaque(OpaqueSortKeyLayout());
+	uint64_t key = opaque.Encode(3, 10.0f, 77, 5);
+	TEST_CHECK(context, opaque.Decode(key, SORT_FIELD_PASS) == 3);
+	TEST_CHECK(context, opaque.Decode(key, SORT_FIELD_MATERIAL) == 77);
+	TEST_CHECK(context, opaque.Decode(key, SORT_FIELD_STATE) == 5);
+	// Opaque draws group by state before depth, front to back within it.
+	TEST_CHECK(context, opaque.Encode(1, 1.0f, 1, 1) < opaque.Encode(1, 2.0f, 1, 1));
+	TEST_CHECK(context, opaque.Encode(1, 100.0f, 1, 1) < opaque.Encode(1, 1.0f, 1, 2));
+	TEST_CHECK(context, opaque.Encode(1, 100.0f, 9, 9) < opaque.Encode(2, 1.0f, 0, 0));
+
+	SortKeyEncoder transparent(TransparentSortKeyLayout());
+	TEST_CHECK(context, transparent.Encode(1, 2.0f, 1, 1) < transparent.Encode(1, 1.0f, 1, 1));
+	TEST_CHECK(context, transparent.Encode(1, 2.0f, 9, 9) < transparent.Encode(1, 1.0f, 0, 0));
+}
+
+// Key sets that take the sort down each of its paths: the insertion sort,
+// equal keys, bits only at the bottom or the top, one bucket holding
+// almost everything, and every bit in use.
+void TestRadixSort(TestContext& context) {
+	const uint32_t sizes[5] = { 0, 1, 50, 3000, 200000 };
+	bool sorted = true;
+	for (uint32_t kind = 0; kind < 5; ++kind) {
+		for (uint32_t s = 0; s < 5; ++s) {
+			const uint32_t count = sizes[s];
+			TestRandom random(kind * 5 + s + 1);
+			std::vector<SortItem> items(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				uint64_t key = 7;
+				if (kind == 1)
+					key = random.Next(16);
+				else if (kind == 2)
+					key = (uint64_t)random.Next(16) << 60;
+				else if (kind == 3)
+					key = random.Next(10) ? random.Next(1 << 20) : (uint64_t)random.Next() << 32;
+				else if (kind == 4)
+					key = (uint64_t)random.Next() << 32 | random.Next();
+				SortItem item = { key, i, 0 };
+				items[i] = item;
+			}
+			std::vector<SortItem> reference(items);
+			std::stable_sort(reference.begin(), reference.end(), KeyLess);
+
+			// Whole, and gathered from three uneven sources.
+			std::vector<SortItem> whole(items);
+			std::vector<SortItem> scratch(count + 1);
+			RadixSort(count ? &whole[0] : nullptr, &scratch[0], count, context.Jobs);
+			std::vector<SortItem> gathered(count + 1);
+			const uint32_t counts[3] = { count / 2, 0, count - count / 2 };
+			const SortItem* sources[3] = {
+				count ? &items[0] : nullptr, nullptr, count ? &items[count / 2] : nullptr
+			};
+			RadixSort(sources, counts, 3, &gathered[0], &scratch[0], context.Jobs);
+			for (uint32_t i = 0; sorted && i < count; ++i)
+				sorted = whole[i].Value == reference[i].Value &&
+						gathered[i].Value == reference[i].Value;
+		}
+	}
+	TEST_CHECK(context, sorted);
+}
+
+// Sorts 500k draws, a large frame's worth, from one queue per thread,
+// serially and on the job system. Both must match a stable sort of the
+// queues concatenated in index order, and both must beat that stable
+// sort, which is what the draw queue would fall back to.
+void TestDrawSort(TestContext& context) {
+	const uint32_t drawCount = 500000;
+	const uint32_t queueCount = context.Jobs->GetThreadCount();
+	SortKeyEncoder encoder(OpaqueSortKeyLayout());
+	DrawQueue queue;
+	queue.Initialize(queueCount, drawCount / queueCount + 1);
+
+	TestRandom random(5);
+	std::vector<uint64_t> keys(drawCount);
+	for (uint32_t i = 0; i < drawCount; ++i)
+		keys[i] = encoder.Encode(random.Next(4), 0.1f + random.NextFloat() * 1000.0f,
+				random.Next(5000), random.Next(300));
+	std::vector<SortItem> reference;
+	reference.reserve(drawCount);
+	for (uint32_t q = 0; q < queueCount; ++q) {
+		for (uint32_t i = q; i < drawCount; i += queueCount) {
+			SortItem item = { keys[i], i, 0 };
+			reference.push_back(item);
+		}
+	}
+	Timer timer;
+	std::stable_sort(reference.begin(), reference.end(), KeyLess);
+	double stableMilliseconds = timer.ElapsedMilliseconds();
+
+	// The best of a few frames; the first one also sizes the buffers.
+	for (uint32_t run = 0; run < 2; ++run) {
+		JobSystem* jobs = run ? context.Jobs : nullptr;
+		double milliseconds = DBL_MAX;
+		bool sorted = true;
+		for (uint32_t frame = 0; frame < 4; ++frame) {
+			queue.Reset();
+			for (uint32_t i = 0; i < drawCount; ++i)
+				queue.Push(i % queueCount, keys[i], i);
+			timer.Reset();
+			queue.Sort(jobs);
+			double elapsed = timer.ElapsedMilliseconds();
+			if (frame > 0)
+				milliseconds = std::min(milliseconds, elapsed);
+			sorted = sorted && queue.GetCount() == drawCount;
+			for (uint32_t i = 0; sorted && i < drawCount; ++i)
+				sorted = queue.GetItems()[i].Value == reference[i].Value;
+		}
+		printf("Draw queue: %u draws sorted in %.2f ms on %u threads, std::stable_sort %.2f ms, "
+				"target 1 ms\n", drawCount, milliseconds, jobs ? jobs->GetThreadCount() : 1,
+				stableMilliseconds);
+		TEST_CHECK(context, sorted);
+		TEST_CHECK(context, milliseconds < stableMilliseconds);
+	}
+
+	// Reset keeps the queues and their capacity but empties them.
+	queue.Reset();
+	queue.Sort(context.Jobs);
+	TEST_CHECK(context, queue.GetCount() == 0 && queue.GetItems() == nullptr);
+}
+
+} // namespace
+
+void RunDrawQueueTests(TestContext& context) {
+	TestSortKeys(context);
+	TestRadixSort(context);
+	TestDrawSort(context);
+}
+
+} // namespace Zeus
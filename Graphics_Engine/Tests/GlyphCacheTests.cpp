@@ -0,0 +1,188 @@
+/*
+ * GlyphCacheTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../GlyphCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+// Every code point is its own glyph: a box whose notch depends on the
+// glyph, so atlas contents tell glyphs apart. Space is blank.
+class BoxSource : public GlyphSource {
+public:
+	FontMetrics GetMetrics() const {
+		FontMetrics metrics = { 0.8f, 0.2f, 0.0f };
+		return metrics;
+	}
+	uint32_t GetGlyphIndex(uint32_t codePoint) const { return codePoint; }
+	float GetAdvance(uint32_t glyph) const { return glyph == ' ' ? 0.3f : 0.6f; }
+	bool GetOutline(uint32_t glyph, GlyphOutline& outline) const {
+		if (glyph == ' ')
+			return true;
+		const float notch = 0.1f + (glyph % 97) * 0.003f;
+		const XMFLOAT2 corners[5] = { XMFLOAT2(0.05f, 0.0f), XMFLOAT2(0.55f, 0.0f),
+				XMFLOAT2(0.55f, 0.7f), XMFLOAT2(0.3f, 0.7f - notch), XMFLOAT2(0.05f, 0.7f) };
+		for (uint32_t i = 0; i < 5; ++i) {
+			GlyphEdge edge;
+			memset(&edge, 0, sizeof(edge));
+			edge.Type = GLYPH_EDGE_LINE;
+			edge.Points[0] = corners[i];
+			edge.Points[1] = corners[(i + 1) % 5];
+			outline.Edges.push_back(edge);
+		}
+		outline.ContourEnds.push_back(5);
+		return true;
+	}
+};
+
+// Malformed sequences decode to U+FFFD per maximal subpart, so the bytes
+// after them decode as they would alone.
+void TestUtf8(TestContext& context) {
+	struct Case {
+		const char* Text;
+		uint32_t CodePoints[6];
+	};
+	const uint32_t R = 0xfffd;
+	const Case cases[] = {
+		{ "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", { 'A', 0xe9, 0x20ac, 0x1f600 } },
+		{ "\xef\xbf\xbf\xf4\x8f\xbf\xbf", { 0xffff, 0x10ffff } },
+		// Overlong forms.
+		{ "\xc0\xaf\xc1\xbf", { R, R, R, R } },
+		{ "\xe0\x80\xafZ", { R, R, R, 'Z' } },
+		{ "\xf0\x8f\xbf\xbf", { R, R, R, R } },
+		// Surrogates and code points past U+10FFFF.
+		{ "\xed\xa0\x80\xed\xbf\xbf", { R, R, R, R, R, R } },
+		{ "\xf4\x90\x80\x80", { R, R, R, R } },
+		{ "\xf5\x80\xfe\xff", { R, R, R, R } },
+		// Stray continuations and truncated sequences.
+		{ "\x80Z", { R, 'Z' } },
+		{ "\xe2\x82Z\xf0\x9f\x98", { R, 'Z', R } },
+		{ "\xc3", { R } }
+	};
+	bool decoded = true;
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+		const char* text = cases[c].Text;
+		const char* end = text + strlen(text);
+		uint32_t i = 0;
+		while (text < end && i < 6)
+			decoded = decoded && DecodeUtf8(text) == cases[c].CodePoints[i++];
+		decoded = decoded && text == end && (i == 6 || cases[c].CodePoints[i] == 0);
+	}
+	TEST_CHECK(context, decoded);
+}
+
+void Initialize(GlyphCache& cache, const BoxSource& source) {
+	GlyphCacheSettings settings;
+	settings.InitialSize = 64;
+	settings.MaxSize = 64;
+	cache.Initialize(settings);
+	MsdfSettings msdf;
+	msdf.PixelsPerEm = 16.0f;
+	cache.AddFont(&source, msdf);
+}
+
+// A full atlas streaming a new glyph every frame: evicted glyphs give
+// their entries back, so the table stays the size of the atlas, and the
+// glyphs still resident keep their own texels.
+void TestEviction(TestContext& context) {
+	BoxSource source;
+	GlyphCache cache;
+	Initialize(cache, source);
+	const uint64_t hot = GlyphCache::MakeKey(0, 'A');
+	const uint32_t frames = 3000;
+	bool requested = true;
+	bool bounded = true;
+	uint32_t evicted = 0;
+	uint32_t resident = 0;
+	for (uint32_t frame = 0; frame < frames; ++frame) {
+		cache.BeginFrame();
+		const uint64_t keys[2] = { hot, GlyphCache::MakeKey(0, 0x4e00 + frame) };
+		requested = requested && cache.Request(keys, 2, context.Jobs) &&
+				cache.Find(keys[0]) && cache.Find(keys[1]);
+		const GlyphCacheStats& stats = cache.GetStats();
+		evicted += stats.Evicted;
+		resident = stats.ResidentGlyphs;
+		bounded = bounded && stats.EntryCount == stats.ResidentGlyphs;
+	}
+	TEST_CHECK(context, requested && bounded && cache.GetWidth() == 64);
+	TEST_CHECK(context, resident > 2 && evicted == frames + 1 - resident);
+
+	// The newest glyphs are resident in distinct cells with their own
+	// texels, and the rest are gone.
+	GlyphBitmap bitmap;
+	bool intact = true;
+	std::vector<uint32_t> cells;
+	for (uint32_t i = 0; i < frames; ++i) {
+		const uint32_t glyph = 0x4e00 + frames - 1 - i;
+		const GlyphInfo* info = cache.Find(GlyphCache::MakeKey(0, glyph));
+		if (i + 1 >= resident) {
+			intact = intact && info == nullptr;
+			continue;
+		}
+		GlyphOutline outline;
+		if (!info || !source.GetOutline(glyph, outline) ||
+				!GenerateMsdf(outline, cache.GetMsdfSettings(0), bitmap)) {
+			intact = false;
+			break;
+		}
+		cells.push_back(info->Y << 16 | info->X);
+		for (uint32_t y = 0; intact && y < bitmap.Height; ++y)
+			intact = memcmp(cache.GetPixels() + (info->Y + y) * cache.GetWidth() + info->X,
+					&bitmap.Pixels[y * bitmap.Width], bitmap.Width * sizeof(uint32_t)) == 0;
+	}
+	std::sort(cells.begin(), cells.end());
+	TEST_CHECK(context, intact && std::unique(cells.begin(), cells.end()) == cells.end());
+
+	// An evicted glyph comes back.
+	cache.BeginFrame();
+	const uint64_t first = GlyphCache::MakeKey(0, 0x4e00);
+	TEST_CHECK(context, cache.Request(&first, 1, nullptr) && cache.Find(first) &&
+			cache.GetStats().Generated == 1);
+}
+
+// A batch larger than the atlas fails for the glyphs that do not fit and
+// lays out the rest; the failed glyphs are forgotten next frame.
+void TestOverflow(TestContext& context) {
+	BoxSource source;
+	GlyphCache cache;
+	Initialize(cache, source);
+	std::string text = " \n";
+	for (uint32_t i = 0; i < 60; ++i) {
+		uint32_t codePoint = 0x3040 + i;
+		text += (char)(0xe0 | codePoint >> 12);
+		text += (char)(0x80 | (codePoint >> 6 & 0x3f));
+		text += (char)(0x80 | (codePoint & 0x3f));
+	}
+	TextRun run;
+	memset(&run, 0, sizeof(run));
+	run.Text = text.c_str();
+	run.Size = 20.0f;
+	run.Color = 0xffffffff;
+	std::vector<Sprite> sprites;
+	cache.BeginFrame();
+	cache.Layout(&run, 1, sprites, context.Jobs);
+	const GlyphCacheStats stats = cache.GetStats();
+	TEST_CHECK(context, stats.Failed > 0 && sprites.size() == stats.ResidentGlyphs - 1 &&
+			stats.EntryCount == stats.ResidentGlyphs + stats.Failed);
+	cache.BeginFrame();
+	TEST_CHECK(context, cache.GetStats().EntryCount == stats.ResidentGlyphs);
+}
+
+} // namespace
+
+void RunGlyphCacheTests(TestContext& context) {
+	TestUtf8(context);
+	TestEviction(context);
+	TestOverflow(context);
+}
+
+} // namespace Zeus
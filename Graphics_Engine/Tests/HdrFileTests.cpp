@@ -0,0 +1,224 @@
+/*
+ * HdrFileTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../HdrFile.h"
+#include "../HdrImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const char* TEST_PATH = "HdrFileTest.tmp";
+
+bool WriteBytes(const char* path, const void* data, size_t size) {
+	FILE* file;
+	if (fopen_s(&file, path, "wb") != 0)
+		return false;
+	bool written = fwrite(data, 1, size, file) == size;
+	return fclose(file) == 0 && written;
+}
+
+bool ReadBytes(const char* path, std::vector<uint8_t>& data) {
+	FILE* file;
+	if (fopen_s(&file, path, "rb") != 0)
+		return false;
+	data.clear();
+	uint8_t buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		data.insert(data.end(), buffer, buffer + read);
+	fclose(file);
+	return true;
+}
+
+// Offset of the value of a named OpenEXR header attribute, or 0.
+size_t FindExrAttribute(const std::vector<uint8_t>& file, const char* name, const char* type) {
+	std::string key = std::string(name) + '\0' + type + '\0';
+	std::vector<uint8_t>::const_iterator found = std::search(file.begin(), file.end(),
+			key.begin(), key.end());
+	return found == file.end() ? 0 : (found - file.begin()) + key.size() + sizeof(uint32_t);
+}
+
+// Runs of equal pixels for the run-length paths, a black stretch, a
+// gradient over many exponents and random colors.
+void BuildImage(uint32_t width, uint32_t height, Format format, HdrImage& image) {
+	ColorBuffer colors;
+	colors.Initialize(width, height);
+	TestRandom random(width * 131 + height);
+	for (uint32_t y = 0; y < height; ++y) {
+		XMFLOAT4* row = colors.GetRow(y);
+		for (uint32_t x = 0; x < width; ++x) {
+			float scale = powf(2.0f, (float)(int)random.Next(24) - 12.0f);
+			XMFLOAT4 color(random.NextFloat() * scale, random.NextFloat() * scale,
+					random.NextFloat() * scale, 1.0f);
+			if (x < width / 4)
+				color = XMFLOAT4(1.5f, 0.25f, 3.0f, 1.0f);
+			else if (x < width / 3)
+				color = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			else if (y % 2)
+				color = XMFLOAT4(x * 0.01f, y * 0.5f, 1.0f, 1.0f);
+			row[x] = color;
+		}
+	}
+	image.Initialize(width, height, format);
+	image.Pack(colors, nullptr);
+}
+
+// Largest error relative to the brightest channel of each pixel.
+float CompareImages(const HdrImage& a, const HdrImage& b) {
+	if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight())
+		return 1e30f;
+	std::vector<XMFLOAT4> rowA(a.GetWidth());
+	std::vector<XMFLOAT4> rowB(a.GetWidth());
+	float worst = 0.0f;
+	for (uint32_t y = 0; y < a.GetHeight(); ++y) {
+		UnpackHdrPixels(a.GetFormat(), a.GetRow(y), a.GetWidth(), &rowA[0]);
+		UnpackHdrPixels(b.GetFormat(), b.GetRow(y), b.GetWidth(), &rowB[0]);
+		for (uint32_t x = 0; x < a.GetWidth(); ++x) {
+			const float* pa = &rowA[x].x;
+			const float* pb = &rowB[x].x;
+			float largest = std::max(pa[0], std::max(pa[1], pa[2]));
+			for (uint32_t c = 0; c < 3; ++c) {
+				float error = fabsf(pa[c] - pb[c]);
+				worst = std::max(worst, error > 1e-6f ? error / largest : 0.0f);
+			}
+		}
+	}
+	return worst;
+}
+
+// Both formats through both files, at widths that take the flat and the
+// run-length encoded Radiance scanlines.
+void TestRoundTrip(TestContext& context) {
+	const Format formats[2] = { FORMAT_R9G9B9E5_SHAREDEXP, FORMAT_R11G11B10_FLOAT };
+	const uint32_t widths[3] = { 5, 300, 1000 };
+	// RGBE keeps 8 bits below the largest channel, half floats 11 and
+	// R11G11B10 only 6.
+	const float tolerances[2] = { 1.0f / 128.0f, 1.0f / 32.0f };
+	for (uint32_t f = 0; f < 2; ++f) {
+		for (uint32_t w = 0; w < 3; ++w) {
+			HdrImage image;
+			BuildImage(widths[w], 37, formats[f], image);
+			HdrImage loaded;
+			TEST_CHECK(context, SaveRadianceHdr(TEST_PATH, image) &&
+					LoadRadianceHdr(TEST_PATH, formats[f], loaded));
+			TEST_CHECK(context, CompareImages(image, loaded) < tolerances[f]);
+			TEST_CHECK(context, SaveOpenExr(TEST_PATH, image) &&
+					LoadOpenExr(TEST_PATH, formats[f], loaded));
+			TEST_CHECK(context, CompareImages(image, loaded) < tolerances[f]);
+		}
+	}
+	remove(TEST_PATH);
+
+	// RGBE decodes to the middle of its step.
+	const char header[] = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 1 +X 2\n";
+	uint8_t file[sizeof(header) - 1 + 8];
+	memcpy(file, header, sizeof(header) - 1);
+	const uint8_t pixels[8] = { 128, 64, 32, 129, 0, 0, 0, 0 };
+	memcpy(file + sizeof(header) - 1, pixels, 8);
+	HdrImage image;
+	TEST_CHECK(context, WriteBytes(TEST_PATH, file, sizeof(file)) &&
+			LoadRadianceHdr(TEST_PATH, FORMAT_R9G9B9E5_SHAREDEXP, image));
+	XMFLOAT4 decoded[2];
+	UnpackHdrPixels(image.GetFormat(), image.GetRow(0), 2, decoded);
+	TEST_CHECK(context, fabsf(decoded[0].x - 128.5f / 128.0f) < 1e-2f &&
+			fabsf(decoded[0].z - 32.5f / 128.0f) < 1e-2f && decoded[1].x == 0.0f);
+	remove(TEST_PATH);
+}
+
+// Headers and scanlines that must be rejected rather than read past.
+void TestMalformedFiles(TestContext& context) {
+	HdrImage image;
+	TEST_CHECK(context, !LoadRadianceHdr("HdrFileTestMissing.hdr", FORMAT_R9G9B9E5_SHAREDEXP,
+			image));
+	TEST_CHECK(context, !LoadOpenExr("HdrFileTestMissing.exr", FORMAT_R9G9B9E5_SHAREDEXP,
+			image));
+
+	const uint8_t flat[16] = { 1, 2, 3, 130, 4, 5, 6, 130, 7, 8, 9, 130, 10, 11, 12, 130 };
+	const char* headers[7] = {
+		"#?RADIANCE\n\n-Y 2 +X 2\n",
+		"RADIANCE\n\n-Y 2 +X 2\n",
+		"#?RADIANCE\nFORMAT=32-bit_rle_xyze\n\n-Y 2 +X 2\n",
+		"#?RADIANCE\n\n+Y 2 +X 2\n",
+		"#?RADIANCE\n\n-Y 2 +X 2 +Z 2\n",
+		"#?RADIANCE\n\n-Y 0 +X 2\n",
+		"#?RADIANCE\n\n-Y 3 +X 2\n"
+	};
+	bool rejected = true;
+	for (uint32_t i = 0; i < 7; ++i) {
+		std::string file = std::string(headers[i]) + std::string((const char*)flat, 16);
+		bool loaded = WriteBytes(TEST_PATH, file.data(), file.size()) &&
+				LoadRadianceHdr(TEST_PATH, FORMAT_R9G9B9E5_SHAREDEXP, image);
+		// Only the first is well formed; the last runs out of scanlines.
+		rejected = rejected && loaded == (i == 0);
+	}
+	// A run-length scanline for the wrong width, and one that overruns it.
+	std::string header = "#?RADIANCE\n\n-Y 1 +X 8\n";
+	const uint8_t wrongWidth[8] = { 2, 2, 0, 9, 136, 1, 136, 1 };
+	std::string file = header + std::string((const char*)wrongWidth, 8);
+	rejected = rejected && WriteBytes(TEST_PATH, file.data(), file.size()) &&
+			!LoadRadianceHdr(TEST_PATH, FORMAT_R9G9B9E5_SHAREDEXP, image);
+	const uint8_t overrun[6] = { 2, 2, 0, 8, 137, 1 };
+	file = header + std::string((const char*)overrun, 6);
+	rejected = rejected && WriteBytes(TEST_PATH, file.data(), file.size()) &&
+			!LoadRadianceHdr(TEST_PATH, FORMAT_R9G9B9E5_SHAREDEXP, image);
+	TEST_CHECK(context, rejected);
+
+	// OpenEXR files patched one field at a time.
+	HdrImage source;
+	BuildImage(20, 10, FORMAT_R9G9B9E5_SHAREDEXP, source);
+	std::vector<uint8_t> valid;
+	if (!TEST_CHECK(context, SaveOpenExr(TEST_PATH, source) && ReadBytes(TEST_PATH, valid)))
+		return;
+	size_t channels = FindExrAttribute(valid, "channels", "chlist");
+	size_t compression = FindExrAttribute(valid, "compression", "compression");
+	size_t window = FindExrAttribute(valid, "dataWindow", "box2i");
+	if (!TEST_CHECK(context, channels && compression && window))
+		return;
+	rejected = true;
+	for (uint32_t i = 0; i < 7; ++i) {
+		std::vector<uint8_t> file(valid);
+		if (i == 1) {
+			file[0] ^= 0xff;
+		} else if (i == 2) {
+			// Tiled.
+			file[5] |= 0x02;
+		} else if (i == 3) {
+			// ZIP.
+			file[compression] = 3;
+		} else if (i == 4) {
+			// No R, G, B or Y channel; names are one letter each.
+			for (uint32_t c = 0; c < 3; ++c)
+				file[channels + c * 18] = (uint8_t)('T' + c);
+		} else if (i == 5) {
+			int32_t right = 0x20000;
+			memcpy(&file[window + 8], &right, sizeof(right));
+		} else if (i == 6) {
+			file.resize(file.size() - 7);
+		}
+		bool loaded = WriteBytes(TEST_PATH, &file[0], file.size()) &&
+				LoadOpenExr(TEST_PATH, FORMAT_R9G9B9E5_SHAREDEXP, image);
+		rejected = rejected && loaded == (i == 0);
+	}
+	TEST_CHECK(context, rejected);
+	remove(TEST_PATH);
+}
+
+} // namespace
+
+void RunHdrFileTests(TestContext& context) {
+	TestRoundTrip(context);
+	TestMalformedFiles(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,200 @@
+/*
+ * InstanceBatcherTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../InstanceBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+struct ByKey {
+	bool operator()(const SortItem& a, const SortItem& b) const { return a.Key < b.Key; }
+};
+
+// Draws of a few meshes under a few materials, sorted the way DrawQueue
+// sorts them: pass, material and state, then a depth that scatters the
+// meshes inside each run. A transform's first element is its draw index.
+void MakeDraws(TestRandom& random, uint32_t count, std::vector<InstanceSource>& draws,
+		std::vector<SortItem>& sorted) {
+	draws.resize(count);
+	sorted.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		InstanceSource& draw = draws[i];
+		memset(&draw, 0, sizeof(draw));
+		draw.Mesh = random.Next(20);
+		draw.Material = random.Next(5);
+		draw.Pass = random.Next(2);
+		draw.State = random.Next(2);
+		draw.Transform.Rows[0][0] = (float)i;
+		draw.Transform.Rows[1][3] = random.NextFloat();
+		sorted[i].Key = (uint64_t)draw.Pass << 48 | (uint64_t)draw.Material << 40 |
+				draw.State << 32 | random.Next();
+		sorted[i].Value = i;
+		sorted[i].Reserved = 0;
+	}
+	std::sort(sorted.begin(), sorted.end(), ByKey());
+}
+
+bool SameRun(const InstanceSource& a, const InstanceSource& b) {
+	return a.Pass == b.Pass && a.Material == b.Material && a.State == b.State;
+}
+
+// Checks the batches against the sorted draws: every draw is drawn once
+// with its own transform by a batch of its mesh, runs keep the sorted
+// order, and instances inside a batch stay in sorted order. Returns the
+// draws in the order the batches draw them.
+bool CheckBatches(const InstanceBatcher& batcher, const std::vector<InstanceSource>& draws,
+		const std::vector<SortItem>& sorted, const std::vector<uint8_t>& memory,
+		uint32_t maxInstances, std::vector<uint32_t>& drawn) {
+	const uint32_t count = (uint32_t)draws.size();
+	std::vector<uint32_t> position(count);
+	std::vector<uint32_t> run(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		position[sorted[i].Value] = i;
+		run[i] = i > 0 && !SameRun(draws[sorted[i].Value], draws[sorted[i - 1].Value])
+				? run[i - 1] + 1 : i > 0 ? run[i - 1] : 0;
+	}
+	const InstanceTransform* instances =
+			reinterpret_cast<const InstanceTransform*>(&memory[0]);
+	std::vector<uint8_t> seen(count, 0);
+	drawn.clear();
+	uint32_t lastRun = 0;
+	for (uint32_t b = 0; b < batcher.GetBatchCount(); ++b) {
+		const InstanceBatch& batch = batcher.GetBatches()[b];
+		if (batch.InstanceCount == 0 || batch.InstanceCount > maxInstances)
+			return false;
+		uint32_t previous = 0;
+		for (uint32_t k = 0; k < batch.InstanceCount; ++k) {
+			const InstanceTransform& transform = instances[batch.StartInstance + k];
+			const uint32_t draw = (uint32_t)transform.Rows[0][0];
+			if (draw >= count || seen[draw] || memcmp(&transform, &draws[draw].Transform,
+					sizeof(transform)) != 0)
+				return false;
+			seen[draw] = 1;
+			drawn.push_back(draw);
+			const InstanceSource& source = draws[draw];
+			if (source.Mesh != batch.Mesh || source.Material != batch.Material ||
+					source.Pass != batch.Pass || source.State != batch.State)
+				return false;
+			if (k > 0 && position[draw] <= previous)
+				return false;
+			if (k == 0 && (batch.FirstSortedDraw > position[draw] ||
+					run[position[draw]] < lastRun))
+				return false;
+			previous = position[draw];
+		}
+		lastRun = run[previous];
+	}
+	return drawn.size() == count;
+}
+
+// Merging batches every mesh of a run into one draw, or as few as the
+// instance limit allows.
+void TestMerge(TestContext& context) {
+	TestRandom random(31);
+	std::vector<InstanceSource> draws;
+	std::vector<SortItem> sorted;
+	MakeDraws(random, 5000, draws, sorted);
+	std::vector<uint8_t> memory(1 << 20);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize((uint32_t)memory.size(), NULL_RESOURCE,
+			&memory[0])))
+		return;
+	const uint32_t limits[2] = { InstanceBatcher::DEFAULT_MAX_INSTANCES, 7 };
+	for (uint32_t l = 0; l < 2; ++l) {
+		// Batches needed: per run and mesh, the draws over the limit.
+		std::vector<uint32_t> counts(2 * 5 * 2 * 20, 0);
+		for (uint32_t i = 0; i < draws.size(); ++i) {
+			const InstanceSource& draw = draws[i];
+			++counts[((draw.Pass * 5 + draw.Material) * 2 + (uint32_t)draw.State) * 20 + draw.Mesh];
+		}
+		uint32_t expected = 0;
+		for (size_t i = 0; i < counts.size(); ++i)
+			expected += (counts[i] + limits[l] - 1) / limits[l];
+
+		InstanceBatcher batcher;
+		batcher.SetMaxInstancesPerBatch(limits[l]);
+		std::vector<uint32_t> drawn;
+		bool built = batcher.Build(&sorted[0], (uint32_t)sorted.size(), &draws[0], ring);
+		TEST_CHECK(context, built && batcher.GetInstanceBuffer() == NULL_RESOURCE &&
+				CheckBatches(batcher, draws, sorted, memory, limits[l], drawn));
+		const InstancingStats& stats = batcher.GetStats();
+		TEST_CHECK(context, stats.InputDraws == 5000 && stats.OutputDraws == expected &&
+				batcher.GetBatchCount() == expected && stats.InstanceBytes == 5000 * 48 &&
+				stats.LargestBatch <= limits[l] && stats.Reduction() > 0.7f);
+		ring.EndFrame(l + 1);
+		ring.Retire(l + 1);
+	}
+}
+
+// Preserving order only merges adjacent draws of a mesh, so the batches
+// draw exactly the sorted sequence.
+void TestPreserveOrder(TestContext& context) {
+	TestRandom random(32);
+	std::vector<InstanceSource> draws;
+	std::vector<SortItem> sorted;
+	MakeDraws(random, 3000, draws, sorted);
+	// Repeat meshes now and then so adjacent draws do merge.
+	for (uint32_t i = 1; i < sorted.size(); ++i) {
+		InstanceSource& draw = draws[sorted[i].Value];
+		const InstanceSource& previous = draws[sorted[i - 1].Value];
+		if (SameRun(draw, previous) && random.Next(2) == 0)
+			draw.Mesh = previous.Mesh;
+	}
+	uint32_t expected = 0;
+	for (uint32_t i = 0; i < sorted.size(); ++i) {
+		const InstanceSource& draw = draws[sorted[i].Value];
+		expected += i == 0 || !SameRun(draw, draws[sorted[i - 1].Value]) ||
+				draw.Mesh != draws[sorted[i - 1].Value].Mesh;
+	}
+
+	std::vector<uint8_t> memory(1 << 20);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize((uint32_t)memory.size(), NULL_RESOURCE,
+			&memory[0])))
+		return;
+	InstanceBatcher batcher;
+	batcher.SetPreserveOrder(true);
+	std::vector<uint32_t> drawn;
+	bool built = batcher.Build(&sorted[0], (uint32_t)sorted.size(), &draws[0], ring);
+	bool inOrder = built && CheckBatches(batcher, draws, sorted, memory,
+			InstanceBatcher::DEFAULT_MAX_INSTANCES, drawn);
+	for (uint32_t i = 0; inOrder && i < sorted.size(); ++i)
+		inOrder = drawn[i] == sorted[i].Value;
+	TEST_CHECK(context, inOrder && batcher.GetBatchCount() == expected &&
+			batcher.GetStats().InstancedBatches > 0);
+}
+
+// A ring without room for the transforms fails the build and leaves no
+// batches pointing at it.
+void TestRingFull(TestContext& context) {
+	TestRandom random(33);
+	std::vector<InstanceSource> draws;
+	std::vector<SortItem> sorted;
+	MakeDraws(random, 100, draws, sorted);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize(99 * sizeof(InstanceTransform), NULL_RESOURCE)))
+		return;
+	InstanceBatcher batcher;
+	TEST_CHECK(context, !batcher.Build(&sorted[0], 100, &draws[0], ring) &&
+			batcher.GetBatchCount() == 0 && batcher.GetBatches() == nullptr);
+	TEST_CHECK(context, batcher.Build(&sorted[0], 0, &draws[0], ring) &&
+			batcher.GetStats().OutputDraws == 0);
+}
+
+} // namespace
+
+void RunInstanceBatcherTests(TestContext& context) {
+	TestMerge(context);
+	TestPreserveOrder(context);
+	TestRingFull(context);
+}
+
+} // namespace Zeus
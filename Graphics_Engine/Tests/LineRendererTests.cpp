@@ -0,0 +1,331 @@
+/*
+ * LineRendererTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../LineRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t WIDTH = 160;
+const uint32_t HEIGHT = 120;
+
+Viewport MakeViewport() {
+	Viewport viewport = { 0.0f, 0.0f, (float)WIDTH, (float)HEIGHT, 0.0f, 1.0f };
+	return viewport;
+}
+
+// World x and y are pixels, so expected coverage is plain 2D geometry.
+XMMATRIX MakeOrtho() {
+	return XMMatrixOrthographicOffCenterLH(0.0f, (float)WIDTH, (float)HEIGHT, 0.0f, 0.0f, 1.0f);
+}
+
+XMFLOAT2 ToPixels(const XMFLOAT4& position) {
+	return XMFLOAT2((position.x / position.w * 0.5f + 0.5f) * WIDTH,
+			(0.5f - position.y / position.w * 0.5f) * HEIGHT);
+}
+
+// Runs the pixel shader of the header over every pixel center the built
+// triangles cover, interpolating Edge linearly in screen space. Keeps the
+// largest alpha a pixel gets.
+void Rasterize(const LineRenderer& lines, std::vector<float>& coverage) {
+	coverage.assign(WIDTH * HEIGHT, 0.0f);
+	const LineVertex* vertices = lines.GetVertices();
+	const uint32_t* indices = lines.GetIndices();
+	for (uint32_t t = 0; t + 2 < lines.GetIndexCount(); t += 3) {
+		const LineVertex* v[3] = {
+			&vertices[indices[t]], &vertices[indices[t + 1]], &vertices[indices[t + 2]]
+		};
+		if (v[0]->Position.w <= 0.0f)
+			continue;
+		XMFLOAT2 p[3];
+		for (uint32_t i = 0; i < 3; ++i)
+			p[i] = ToPixels(v[i]->Position);
+		const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) -
+				(p[1].y - p[0].y) * (p[2].x - p[0].x);
+		if (fabsf(area) < 1e-6f)
+			continue;
+		const int32_t left = std::max(0,
+				(int32_t)floorf(std::min(p[0].x, std::min(p[1].x, p[2].x))));
+		const int32_t right = std::min((int32_t)WIDTH - 1,
+				(int32_t)ceilf(std::max(p[0].x, std::max(p[1].x, p[2].x))));
+		const int32_t top = std::max(0,
+				(int32_t)floorf(std::min(p[0].y, std::min(p[1].y, p[2].y))));
+		const int32_t bottom = std::min((int32_t)HEIGHT - 1,
+				(int32_t)ceilf(std::max(p[0].y, std::max(p[1].y, p[2].y))));
+		for (int32_t y = top; y <= bottom; ++y) {
+			for (int32_t x = left; x <= right; ++x) {
+				const float px = x + 0.5f;
+				const float py = y + 0.5f;
+				float w[3];
+				for (uint32_t i = 0; i < 3; ++i) {
+					const XMFLOAT2& a = p[(i + 1) % 3];
+					const XMFLOAT2& b = p[(i + 2) % 3];
+					w[i] = ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x)) / area;
+				}
+				if (w[0] < -1e-5f || w[1] < -1e-5f || w[2] < -1e-5f)
+					continue;
+				float edge[4];
+				for (uint32_t k = 0; k < 4; ++k)
+					edge[k] = w[0] * (&v[0]->Edge.x)[k] + w[1] * (&v[1]->Edge.x)[k] +
+							w[2] * (&v[2]->Edge.x)[k];
+				const float outside = std::max(std::max(edge[0], edge[1]), 0.0f);
+				const float d = sqrtf(outside * outside + edge[2] * edge[2]);
+				const float alpha = std::min(std::max(edge[3] + 0.5f - d, 0.0f), 1.0f);
+				float& pixel = coverage[y * WIDTH + x];
+				pixel = std::max(pixel, alpha);
+			}
+		}
+	}
+}
+
+float DistanceToSegment(float px, float py, const XMFLOAT3& a, const XMFLOAT3& b) {
+	const float dx = b.x - a.x;
+	const float dy = b.y - a.y;
+	float t = ((px - a.x) * dx + (py - a.y) * dy) / (dx * dx + dy * dy);
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	const float ex = px - a.x - dx * t;
+	const float ey = py - a.y - dy * t;
+	return sqrtf(ex * ex + ey * ey);
+}
+
+float Saturate(float value) {
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+// Round joins draw every pixel at its distance from the nearest segment,
+// with no gaps at joins and no seams where segments overlap; the caps
+// and joins come out round.
+void TestRoundCoverage(TestContext& context) {
+	TestRandom random(38);
+	LineRenderer lines;
+	lines.Initialize(2);
+	lines.SetJoin(LINE_JOIN_ROUND);
+	std::vector<std::vector<XMFLOAT3> > polylines(6);
+	std::vector<float> widths(polylines.size());
+	for (uint32_t l = 0; l < polylines.size(); ++l) {
+		polylines[l].resize(2 + random.Next(4));
+		for (uint32_t i = 0; i < polylines[l].size(); ++i)
+			polylines[l][i] = XMFLOAT3(10.0f + random.NextFloat() * (WIDTH - 20.0f),
+					10.0f + random.NextFloat() * (HEIGHT - 20.0f), 0.5f);
+		widths[l] = 1.0f + random.NextFloat() * 7.0f;
+		lines.AddPolyline(l % 2, &polylines[l][0], (uint32_t)polylines[l].size(), 0xffffffff,
+				widths[l], false);
+	}
+	lines.Build(MakeOrtho(), MakeViewport(), nullptr);
+	std::vector<float> coverage;
+	Rasterize(lines, coverage);
+
+	bool matches = true;
+	uint32_t covered = 0;
+	for (uint32_t y = 0; y < HEIGHT; ++y) {
+		for (uint32_t x = 0; x < WIDTH; ++x) {
+			float expected = 0.0f;
+			for (uint32_t l = 0; l < polylines.size(); ++l) {
+				for (uint32_t i = 0; i + 1 < polylines[l].size(); ++i)
+					expected = std::max(expected, Saturate(widths[l] * 0.5f + 0.5f -
+							DistanceToSegment(x + 0.5f, y + 0.5f, polylines[l][i],
+							polylines[l][i + 1])));
+			}
+			matches = matches && fabsf(coverage[y * WIDTH + x] - expected) < 1e-3f;
+			covered += expected > 0.0f;
+		}
+	}
+	TEST_CHECK(context, matches && covered > 500 && lines.GetStats().MiterJoins == 0);
+}
+
+// A square outline mitered at its corners has square outer corners: the
+// alpha of a pixel follows its L-infinity distance from the outline.
+// Round joins round the same corners off, and a hairpin sharper than the
+// miter limit falls back to a round join.
+void TestMiterCoverage(TestContext& context) {
+	const XMFLOAT3 square[4] = {
+		XMFLOAT3(50.0f, 30.0f, 0.5f), XMFLOAT3(110.0f, 30.0f, 0.5f),
+		XMFLOAT3(110.0f, 90.0f, 0.5f), XMFLOAT3(50.0f, 90.0f, 0.5f)
+	};
+	const float halfWidth = 6.0f;
+	LineRenderer lines;
+	lines.Initialize(1);
+	std::vector<float> coverage;
+	for (uint32_t j = 0; j < 2; ++j) {
+		const bool miter = j == 0;
+		lines.SetJoin(miter ? LINE_JOIN_MITER : LINE_JOIN_ROUND);
+		lines.Reset();
+		lines.AddPolyline(0, square, 4, 0xffffffff, halfWidth * 2.0f, true);
+		lines.Build(MakeOrtho(), MakeViewport(), nullptr);
+		Rasterize(lines, coverage);
+
+		bool matches = true;
+		for (uint32_t y = 0; y < HEIGHT; ++y) {
+			for (uint32_t x = 0; x < WIDTH; ++x) {
+				const float px = x + 0.5f;
+				const float py = y + 0.5f;
+				float distance;
+				if (miter) {
+					distance = fabsf(std::max(fabsf(px - 80.0f), fabsf(py - 60.0f)) - 30.0f);
+				} else {
+					distance = 1e6f;
+					for (uint32_t i = 0; i < 4; ++i)
+						distance = std::min(distance, DistanceToSegment(px, py, square[i],
+								square[(i + 1) % 4]));
+				}
+				matches = matches && fabsf(coverage[y * WIDTH + x] -
+						Saturate(halfWidth + 0.5f - distance)) < 1e-3f;
+			}
+		}
+		// Mitered segments share their corner vertices bit for bit.
+		const LineVertex* vertices = lines.GetVertices();
+		bool shared = true;
+		for (uint32_t s = 0; miter && s < 4; ++s) {
+			for (uint32_t side = 0; side < 2; ++side)
+				shared = shared && memcmp(&vertices[s * 4 + 2 + side].Position,
+						&vertices[(s + 1) % 4 * 4 + side].Position, sizeof(XMFLOAT4)) == 0;
+		}
+		TEST_CHECK(context, matches && shared &&
+				lines.GetStats().MiterJoins == (miter ? 4u : 0u));
+	}
+
+	const XMFLOAT3 hairpin[3] = {
+		XMFLOAT3(20.0f, 60.0f, 0.5f), XMFLOAT3(140.0f, 60.0f, 0.5f), XMFLOAT3(20.0f, 70.0f, 0.5f)
+	};
+	lines.SetJoin(LINE_JOIN_MITER);
+	lines.Reset();
+	lines.AddPolyline(0, hairpin, 3, 0xffffffff, 4.0f, false);
+	lines.Build(MakeOrtho(), MakeViewport(), nullptr);
+	Rasterize(lines, coverage);
+	bool round = true;
+	for (uint32_t y = 0; y < HEIGHT; ++y) {
+		for (uint32_t x = 0; x < WIDTH; ++x)
+			round = round && fabsf(coverage[y * WIDTH + x] - Saturate(2.5f - std::min(
+					DistanceToSegment(x + 0.5f, y + 0.5f, hairpin[0], hairpin[1]),
+					DistanceToSegment(x + 0.5f, y + 0.5f, hairpin[1], hairpin[2])))) < 1e-3f;
+	}
+	TEST_CHECK(context, round && lines.GetStats().MiterJoins == 0);
+}
+
+// Under perspective, lines keep their pixel width and the depth of each
+// end, segments behind the camera are culled, segments crossing the near
+// plane are cut at it, and serial and parallel builds agree.
+void TestPerspective(TestContext& context) {
+	TestRandom random(39);
+	const XMMATRIX viewProjection = XMMatrixMultiply(
+			XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
+			XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+			XMMatrixPerspectiveFovLH(XM_PI / 3.0f, (float)WIDTH / HEIGHT, 0.5f, 100.0f));
+	LineRenderer lines;
+	lines.Initialize(4);
+	lines.SetJoin(LINE_JOIN_ROUND);
+	std::vector<XMFLOAT3> points;
+	std::vector<float> widths;
+	for (uint32_t l = 0; l < 1000; ++l) {
+		XMFLOAT3 pair[2];
+		for (uint32_t i = 0; i < 2; ++i)
+			pair[i] = XMFLOAT3(random.NextFloat() * 40.0f - 20.0f,
+					random.NextFloat() * 40.0f - 20.0f, random.NextFloat() * 60.0f - 20.0f);
+		widths.push_back(1.0f + random.NextFloat() * 9.0f);
+		lines.AddLine(l % 4, pair[0], pair[1], 0xff00ff00, widths.back());
+		points.insert(points.end(), pair, pair + 2);
+	}
+	lines.Build(viewProjection, MakeViewport(), nullptr);
+	std::vector<LineVertex> serial(lines.GetVertices(), lines.GetVertices() + 4000);
+	lines.Build(viewProjection, MakeViewport(), context.Jobs);
+	bool same = memcmp(&serial[0], lines.GetVertices(), 4000 * sizeof(LineVertex)) == 0;
+
+	// Queues are walked in order, so segment s is line s % 250 * 4 + s / 250
+	// of the loop above.
+	const LineVertex* vertices = lines.GetVertices();
+	const uint32_t* indices = lines.GetIndices();
+	const uint32_t pattern[6] = { 0, 1, 2, 2, 1, 3 };
+	uint32_t culled = 0;
+	bool wide = true;
+	bool clipped = true;
+	bool indexed = lines.GetIndexCount() == 6000;
+	for (uint32_t s = 0; s < 1000; ++s) {
+		for (uint32_t k = 0; k < 6; ++k)
+			indexed = indexed && indices[s * 6 + k] == s * 4 + pattern[k];
+		const uint32_t l = s % 250 * 4 + s / 250;
+		XMFLOAT4 clip[2];
+		for (uint32_t i = 0; i < 2; ++i)
+			XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&points[l * 2 + i]),
+					viewProjection));
+		const LineVertex* quad = &vertices[s * 4];
+		if (clip[0].z < 0.0f && clip[1].z < 0.0f) {
+			++culled;
+			clipped = clipped && quad[0].Position.w == 0.0f && quad[3].Position.w == 0.0f;
+			continue;
+		}
+		for (uint32_t end = 0; end < 2; ++end) {
+			const LineVertex& a = quad[end * 2];
+			const LineVertex& b = quad[end * 2 + 1];
+			clipped = clipped && a.Position.w > 0.0f && (clip[end].z >= 0.0f ?
+					fabsf(a.Position.z / a.Position.w - clip[end].z / clip[end].w) < 1e-5f :
+					a.Position.z == 0.0f && b.Position.z == 0.0f);
+			const XMFLOAT2 pa = ToPixels(a.Position);
+			const XMFLOAT2 pb = ToPixels(b.Position);
+			const float across = sqrtf((pa.x - pb.x) * (pa.x - pb.x) +
+					(pa.y - pb.y) * (pa.y - pb.y));
+			const float extent = widths[l] * 0.5f + 1.0f;
+			wide = wide && fabsf(across - 2.0f * extent) < 1e-3f * (1.0f + across) &&
+					a.Edge.w == widths[l] * 0.5f && fabsf(fabsf(a.Edge.z) - extent) < 1e-2f;
+		}
+	}
+	const LineStats& stats = lines.GetStats();
+	TEST_CHECK(context, same && indexed && wide && clipped && culled > 50 &&
+			stats.CulledSegments == culled && stats.SegmentCount == 1000 &&
+			stats.PolylineCount == 1000);
+}
+
+// Boxes are twelve segments, sub-pixel lines become one pixel wide and
+// fainter, and Upload copies the streams, with one primitive's worth for
+// an empty frame.
+void TestUpload(TestContext& context) {
+	LineRenderer lines;
+	lines.Initialize(1);
+	lines.AddBox(0, XMFLOAT3(10.0f, 10.0f, 0.2f), XMFLOAT3(40.0f, 30.0f, 0.8f), 0xffff0000,
+			2.0f);
+	lines.AddLine(0, XMFLOAT3(5.0f, 100.0f, 0.5f), XMFLOAT3(150.0f, 100.0f, 0.5f), 0xff0000ff,
+			0.5f);
+	lines.AddLine(0, XMFLOAT3(5.0f, 5.0f, 0.5f), XMFLOAT3(5.0f, 50.0f, 0.5f), 0xffffffff, 0.0f);
+	lines.Build(MakeOrtho(), MakeViewport(), nullptr);
+	const LineStats& stats = lines.GetStats();
+	const LineVertex& thin = lines.GetVertices()[12 * 4];
+	TEST_CHECK(context, stats.PolylineCount == 7 && stats.SegmentCount == 13 &&
+			stats.MiterJoins == 8 && thin.Edge.w == 0.5f && thin.Color == 0x800000ff);
+
+	std::vector<uint8_t> memory(1 << 16);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize((uint32_t)memory.size(), NULL_RESOURCE,
+			&memory[0])))
+		return;
+	RingAllocation filler = ring.AllocateVertices(3, sizeof(LineVertex));
+	const uint32_t vertexBytes = 13 * 4 * sizeof(LineVertex);
+	TEST_CHECK(context, lines.Upload(ring) &&
+			memcmp(&memory[filler.Size], lines.GetVertices(), vertexBytes) == 0 &&
+			memcmp(&memory[filler.Size + vertexBytes], lines.GetIndices(),
+			13 * 6 * sizeof(uint32_t)) == 0);
+
+	lines.Reset();
+	lines.Build(MakeOrtho(), MakeViewport(), nullptr);
+	const uint32_t allocations = ring.GetStats().FrameAllocations;
+	TEST_CHECK(context, lines.GetIndexCount() == 0 && lines.Upload(ring) &&
+			ring.GetStats().FrameAllocations == allocations + 2);
+}
+
+} // namespace
+
+void RunLineRendererTests(TestContext& context) {
+	TestRoundCoverage(context);
+	TestMiterCoverage(context);
+	TestPerspective(context);
+	TestUpload(context);
+}
+
+} // namespace Zeus
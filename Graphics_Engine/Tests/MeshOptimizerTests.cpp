@@ -0,0 +1,253 @@
+/*
+ * MeshOptimizerTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../JobSystem.h"
+#include "../MeshOptimizer.h"
+#include "../Timer.h"
+
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// A shuffled grid misses the cache on nearly every vertex, so ACMR starts
+// near 3; Forsyth's order brings a regular grid close to 0.5.
+void TestVertexCache(TestContext& context) {
+	TestMesh mesh;
+	BuildGrid(1000, 1000, mesh);
+	TestRandom random(1);
+	ShuffleTriangles(mesh, random);
+	const uint32_t indexCount = mesh.GetIndexCount();
+	const uint32_t vertexCount = mesh.GetVertexCount();
+
+	std::vector<uint32_t> optimized(indexCount);
+	Timer timer;
+	OptimizeVertexCache(&optimized[0], &mesh.Indices[0], indexCount, vertexCount);
+	double milliseconds = timer.ElapsedMilliseconds();
+	VertexCacheStats before = AnalyzeVertexCache(&mesh.Indices[0], indexCount, vertexCount, 16);
+	VertexCacheStats after = AnalyzeVertexCache(&optimized[0], indexCount, vertexCount, 16);
+	printf("Vertex cache: %u triangles, ACMR %.2f -> %.2f, %.1fM triangles/s on one thread\n",
+			mesh.GetTriangleCount(), before.Acmr, after.Acmr,
+			mesh.GetTriangleCount() / milliseconds / 1000.0);
+	TEST_CHECK(context, before.Acmr > 2.9f);
+	TEST_CHECK(context, after.Acmr < 0.7f);
+	TEST_CHECK(context, after.Atvr < 1.5f);
+
+	std::vector<TriangleKey> sourceKeys;
+	std::vector<TriangleKey> optimizedKeys;
+	GetTriangleKeys(&mesh.Indices[0], indexCount, nullptr, sourceKeys);
+	GetTriangleKeys(&optimized[0], indexCount, nullptr, optimizedKeys);
+	TEST_CHECK(context, sourceKeys == optimizedKeys);
+
+	// Subsets are cooked in parallel, each keeping its own triangles, and
+	// the result does not depend on the thread count.
+	MeshSubset subsets[4];
+	const uint32_t subsetIndices = indexCount / 12 * 3;
+	for (uint32_t i = 0; i < 4; ++i) {
+		subsets[i].FirstIndex = i * subsetIndices;
+		subsets[i].IndexCount = i == 3 ? indexCount - 3 * subsetIndices : subsetIndices;
+	}
+	std::vector<uint32_t> serial(mesh.Indices);
+	std::vector<uint32_t> parallel(mesh.Indices);
+	MeshBuffers buffers = {};
+	buffers.IndexCount = indexCount;
+	buffers.VertexCount = vertexCount;
+	buffers.Subsets = subsets;
+	buffers.SubsetCount = 4;
+	MeshCookSettings settings;
+	MeshCookReport report;
+	buffers.Indices = &serial[0];
+	CookMesh(buffers, settings, report, nullptr);
+	buffers.Indices = &parallel[0];
+	CookMesh(buffers, settings, report, context.Jobs);
+	TEST_CHECK(context, serial == parallel);
+	for (uint32_t i = 0; i < 4; ++i) {
+		GetTriangleKeys(&mesh.Indices[subsets[i].FirstIndex], subsets[i].IndexCount, nullptr,
+				sourceKeys);
+		GetTriangleKeys(&parallel[subsets[i].FirstIndex], subsets[i].IndexCount, nullptr,
+				optimizedKeys);
+		TEST_CHECK(context, sourceKeys == optimizedKeys);
+	}
+
+	// Degenerate triangles pass through.
+	uint32_t degenerate[9] = { 0, 0, 1, 1, 2, 3, 3, 3, 3 };
+	OptimizeVertexCache(degenerate, degenerate, 9, 4);
+	GetTriangleKeys(degenerate, 9, nullptr, optimizedKeys);
+	const uint32_t expected[9] = { 0, 0, 1, 1, 2, 3, 3, 3, 3 };
+	GetTriangleKeys(expected, 9, nullptr, sourceKeys);
+	TEST_CHECK(context, sourceKeys == optimizedKeys);
+}
+
+// Four nested spheres: from every side the inner three are hidden, so the
+// overdraw pass should draw the outer one first.
+void TestOverdraw(TestContext& context) {
+	TestMesh mesh;
+	for (uint32_t shell = 0; shell < 4; ++shell) {
+		TestMesh sphere;
+		BuildSphere(60, 60, 0.0f, sphere);
+		float scale = 1.0f - 0.2f * shell;
+		uint32_t base = mesh.GetVertexCount();
+		for (size_t v = 0; v < sphere.Vertices.size(); ++v) {
+			XMFLOAT3& p = sphere.Vertices[v].Position;
+			p = XMFLOAT3(p.x * scale, p.y * scale, p.z * scale);
+			mesh.Vertices.push_back(sphere.Vertices[v]);
+		}
+		for (size_t i = 0; i < sphere.Indices.size(); ++i)
+			mesh.Indices.push_back(base + sphere.Indices[i]);
+	}
+	TestRandom random(2);
+	ShuffleTriangles(mesh, random);
+
+	MeshBuffers buffers = {};
+	buffers.IndexCount = mesh.GetIndexCount();
+	buffers.VertexCount = mesh.GetVertexCount();
+	buffers.Positions = &mesh.Vertices[0].Position;
+	buffers.PositionStride = sizeof(TestVertex);
+	MeshCookSettings settings;
+	settings.OptimizeOverdraw = false;
+	std::vector<uint32_t> cacheOnly(mesh.Indices);
+	MeshCookReport cacheReport;
+	buffers.Indices = &cacheOnly[0];
+	CookMesh(buffers, settings, cacheReport, context.Jobs);
+
+	settings.OptimizeOverdraw = true;
+	std::vector<uint32_t> optimized(mesh.Indices);
+	MeshCookReport report;
+	buffers.Indices = &optimized[0];
+	CookMesh(buffers, settings, report, context.Jobs);
+	printf("Overdraw: %u triangles, overdraw %.2f -> %.2f, ACMR %.2f -> %.2f\n",
+			mesh.GetTriangleCount(), cacheReport.OverdrawAfter.Overdraw,
+			report.OverdrawAfter.Overdraw, cacheReport.CacheAfter.Acmr, report.CacheAfter.Acmr);
+	TEST_CHECK(context, cacheReport.OverdrawAfter.Overdraw > 1.5f);
+	TEST_CHECK(context, report.OverdrawAfter.Overdraw < 1.2f);
+	TEST_CHECK(context, report.OverdrawAfter.PixelsCovered ==
+			cacheReport.OverdrawAfter.PixelsCovered);
+	TEST_CHECK(context, report.CacheAfter.Acmr <=
+			cacheReport.CacheAfter.Acmr * settings.OverdrawThreshold);
+
+	std::vector<TriangleKey> sourceKeys;
+	std::vector<TriangleKey> optimizedKeys;
+	GetTriangleKeys(&mesh.Indices[0], mesh.GetIndexCount(), nullptr, sourceKeys);
+	GetTriangleKeys(&optimized[0], mesh.GetIndexCount(), nullptr, optimizedKeys);
+	TEST_CHECK(context, sourceKeys == optimizedKeys);
+}
+
+// Shuffled vertices make every fetch a cache miss. The fetch pass must
+// move the streams, the positions outside them and the indices together.
+void TestVertexFetch(TestContext& context) {
+	TestMesh mesh;
+	BuildGrid(300, 300, mesh);
+	const uint32_t usedCount = mesh.GetVertexCount();
+	const uint32_t vertexCount = usedCount + 100;
+	TestRandom random(3);
+	std::vector<uint32_t> order(usedCount);
+	for (uint32_t v = 0; v < usedCount; ++v)
+		order[v] = v;
+	random.Shuffle(&order[0], usedCount);
+	std::vector<TestVertex> vertices(vertexCount);
+	for (uint32_t v = 0; v < usedCount; ++v)
+		vertices[order[v]] = mesh.Vertices[v];
+	for (uint32_t v = usedCount; v < vertexCount; ++v) {
+		vertices[v] = mesh.Vertices[0];
+		vertices[v].Id = v;
+	}
+	std::vector<uint32_t> indices(mesh.Indices);
+	for (size_t i = 0; i < indices.size(); ++i)
+		indices[i] = order[indices[i]];
+
+	std::vector<uint32_t> sourceIds(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		sourceIds[v] = vertices[v].Id;
+	std::vector<TriangleKey> sourceKeys;
+	GetTriangleKeys(&indices[0], mesh.GetIndexCount(), &sourceIds[0], sourceKeys);
+
+	// A second stream, and positions kept outside the streams.
+	std::vector<uint32_t> ids(sourceIds);
+	std::vector<XMFLOAT3> positions(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		positions[v] = vertices[v].Position;
+	VertexStream streams[2] = {
+		{ &vertices[0], sizeof(TestVertex) },
+		{ &ids[0], sizeof(uint32_t) }
+	};
+	MeshBuffers buffers = {};
+	buffers.Indices = &indices[0];
+	buffers.IndexCount = mesh.GetIndexCount();
+	buffers.VertexCount = vertexCount;
+	buffers.Positions = &positions[0];
+	buffers.Streams = streams;
+	buffers.StreamCount = 2;
+	MeshCookSettings settings;
+	settings.OverdrawResolution = 0;
+	MeshCookReport report;
+	CookMesh(buffers, settings, report, context.Jobs);
+	printf("Vertex fetch: %u vertices, overfetch %.1f -> %.1f\n", vertexCount,
+			report.FetchBefore.Overfetch, report.FetchAfter.Overfetch);
+	TEST_CHECK(context, report.FetchBefore.Overfetch > 7.0f);
+	TEST_CHECK(context, report.FetchAfter.Overfetch < 2.1f);
+	TEST_CHECK(context, report.ReferencedVertices == usedCount);
+
+	// Same triangles over the same vertices, the streams still agree, and
+	// the unreferenced vertices went to the end.
+	std::vector<uint32_t> cookedIds(vertexCount);
+	bool streamsAgree = true;
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		cookedIds[v] = vertices[v].Id;
+		streamsAgree = streamsAgree && ids[v] == vertices[v].Id;
+	}
+	TEST_CHECK(context, streamsAgree);
+	std::vector<TriangleKey> cookedKeys;
+	GetTriangleKeys(&indices[0], mesh.GetIndexCount(), &cookedIds[0], cookedKeys);
+	TEST_CHECK(context, sourceKeys == cookedKeys);
+	bool tailUnused = true;
+	for (uint32_t v = usedCount; v < vertexCount; ++v)
+		tailUnused = tailUnused && vertices[v].Id >= usedCount;
+	TEST_CHECK(context, tailUnused);
+
+	// The reported remap brings the outside positions along.
+	TEST_CHECK(context, report.VertexRemap.size() == vertexCount);
+	if (report.VertexRemap.size() == vertexCount) {
+		std::vector<XMFLOAT3> remapped(vertexCount);
+		RemapVertices(&remapped[0], &positions[0], vertexCount, sizeof(XMFLOAT3),
+				&report.VertexRemap[0]);
+		bool positionsAgree = true;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			positionsAgree = positionsAgree &&
+					memcmp(&remapped[v], &vertices[v].Position, sizeof(XMFLOAT3)) == 0;
+		TEST_CHECK(context, positionsAgree);
+	}
+
+	// Positions split into their own stream; only texture coordinates are
+	// read besides them.
+	VertexElement elements[3] = {
+		{ 0, 0, FORMAT_R32G32B32_FLOAT, VERTEX_USAGE_POSITION, 0 },
+		{ 0, 12, FORMAT_R32G32B32_FLOAT, VERTEX_USAGE_NORMAL, 0 },
+		{ 0, 24, FORMAT_R32G32_FLOAT, VERTEX_USAGE_TEXCOORD, 0 }
+	};
+	VertexElement used[1] = { { 0, 0, FORMAT_UNKNOWN, VERTEX_USAGE_TEXCOORD, 0 } };
+	SplitVertexData split;
+	TEST_CHECK(context, SplitVertexStreams(streams, elements, 3, report.ReferencedVertices,
+			used, 1, split));
+	TEST_CHECK(context, split.PositionStride == 12 && split.AttributeStride == 8);
+	bool splitAgrees = split.Positions.size() == (size_t)usedCount * 12 &&
+			split.Attributes.size() == (size_t)usedCount * 8;
+	for (uint32_t v = 0; splitAgrees && v < usedCount; ++v)
+		splitAgrees = memcmp(&split.Positions[v * 12], &vertices[v].Position, 12) == 0 &&
+				memcmp(&split.Attributes[v * 8], &vertices[v].TexCoord, 8) == 0;
+	TEST_CHECK(context, splitAgrees);
+}
+
+} // namespace
+
+void RunMeshOptimizerTests(TestContext& context) {
+	TestVertexCache(context);
+	TestOverdraw(context);
+	TestVertexFetch(context);
+}
+
+} // namespace Zeus
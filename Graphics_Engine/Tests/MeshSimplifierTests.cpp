@@ -0,0 +1,162 @@
+/*
+ * MeshSimplifierTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../JobSystem.h"
+#include "../MeshSimplifier.h"
+#include "../MeshTopology.h"
+#include "../Timer.h"
+#include "../VertexWelder.h"
+
+namespace Zeus {
+
+namespace {
+
+bool IsDegenerate(const uint32_t* triangle) {
+	return triangle[0] == triangle[1] || triangle[1] == triangle[2] ||
+			triangle[0] == triangle[2];
+}
+
+// Checks every level for valid, non-degenerate triangles that meet the
+// target or stopped at MaxError, with errors growing level by level.
+void CheckLevels(TestContext& context, const std::vector<SimplifyLod>& levels,
+		const uint32_t* targets, float maxError, uint32_t vertexCount) {
+	for (size_t l = 0; l < levels.size(); ++l) {
+		const std::vector<uint32_t>& indices = levels[l].Indices;
+		// A level short of its target stopped at MaxError; the rest repeat it.
+		TEST_CHECK(context, indices.size() / 3 <= targets[l] ||
+				(levels[l].Error <= maxError &&
+				(l + 1 == levels.size() || levels[l + 1].Indices == indices)));
+		TEST_CHECK(context, l == 0 || levels[l].Error >= levels[l - 1].Error);
+		bool valid = true;
+		for (size_t i = 0; i < indices.size(); i += 3)
+			valid = valid && indices[i] < vertexCount && indices[i + 1] < vertexCount &&
+					indices[i + 2] < vertexCount && !IsDegenerate(&indices[i]);
+		TEST_CHECK(context, valid);
+	}
+}
+
+void TestLodChain(TestContext& context) {
+	TestMesh mesh;
+	BuildSphere(100, 200, 0.1f, mesh);
+	SimplifySource source;
+	GetSimplifySource(mesh, source);
+	SimplifySettings settings;
+	settings.MaxError = 0.05f;
+	const uint32_t triangleCount = mesh.GetTriangleCount();
+	const uint32_t targets[4] = {
+		triangleCount / 2, triangleCount / 8, triangleCount / 32, triangleCount / 128
+	};
+
+	std::vector<SimplifyLod> serial;
+	Timer timer;
+	BuildLodChain(source, settings, targets, 4, serial, nullptr);
+	double serialMilliseconds = timer.ElapsedMilliseconds();
+	std::vector<SimplifyLod> levels;
+	timer.Reset();
+	BuildLodChain(source, settings, targets, 4, levels, context.Jobs);
+	double milliseconds = timer.ElapsedMilliseconds();
+	printf("Simplifier: %u triangles to %u, %u, %u, %u in %.0f ms, %.0f ms on %u threads\n",
+			triangleCount, (uint32_t)serial[0].Indices.size() / 3,
+			(uint32_t)serial[1].Indices.size() / 3, (uint32_t)serial[2].Indices.size() / 3,
+			(uint32_t)serial[3].Indices.size() / 3, serialMilliseconds, milliseconds,
+			context.Jobs->GetThreadCount());
+
+	TEST_CHECK(context, serial.size() == 4 && levels.size() == 4);
+	for (size_t l = 0; l < serial.size() && l < levels.size(); ++l)
+		TEST_CHECK(context, serial[l].Indices == levels[l].Indices &&
+				serial[l].Error == levels[l].Error);
+	CheckLevels(context, levels, targets, settings.MaxError, source.VertexCount);
+
+	// With normals and texture coordinates the chain stops at MaxError
+	// around 2200 triangles: by then neighboring normals differ by several
+	// degrees. Without them nothing is locked and every target is met.
+	TEST_CHECK(context, levels[2].Indices.size() / 3 > targets[2] &&
+			levels[2].Error > settings.MaxError * 0.9f);
+	SimplifySource positions = source;
+	positions.Normals = nullptr;
+	positions.TexCoords = nullptr;
+	BuildLodChain(positions, settings, targets, 4, levels, context.Jobs);
+	bool met = true;
+	for (size_t l = 0; l < levels.size(); ++l)
+		met = met && levels[l].Indices.size() / 3 <= targets[l];
+	TEST_CHECK(context, met);
+	printf("Simplifier: positions only to %u triangles at error %.3f\n",
+			(uint32_t)levels[3].Indices.size() / 3, levels[3].Error);
+}
+
+// Edges of the triangles with one or more than two triangles on them,
+// joining vertices at the same point.
+uint32_t CountOpenEdges(const std::vector<uint32_t>& indices, const WeldResult& weld,
+		uint32_t vertexCount, JobSystem* jobs) {
+	MeshTopology topology;
+	BuildMeshTopology(&indices[0], (uint32_t)indices.size(), vertexCount, &weld.PointReps[0],
+			topology, jobs);
+	return topology.BorderEdgeCount + (uint32_t)topology.NonManifoldEdges.size() +
+			(uint32_t)topology.FlippedEdges.size();
+}
+
+// A closed sphere of 160K triangles runs every level down to 10K in
+// chunks, then joins them. The levels and the history must not depend on
+// the thread count, and the chunk borders must join without cracks.
+void TestChunks(TestContext& context) {
+	TestMesh mesh;
+	BuildSphere(200, 400, 0.1f, mesh);
+	SimplifySource source;
+	GetSimplifySource(mesh, source);
+	SimplifySettings settings;
+	settings.MaxError = 0.05f;
+	const uint32_t triangleCount = mesh.GetTriangleCount();
+	const uint32_t targets[3] = { triangleCount / 2, triangleCount / 4, triangleCount / 16 };
+
+	std::vector<SimplifyLod> serial;
+	SimplifyHistory serialHistory;
+	Timer timer;
+	BuildLodChain(source, settings, targets, 3, serial, nullptr, &serialHistory);
+	double serialMilliseconds = timer.ElapsedMilliseconds();
+	std::vector<SimplifyLod> levels;
+	SimplifyHistory history;
+	timer.Reset();
+	BuildLodChain(source, settings, targets, 3, levels, context.Jobs, &history);
+	double milliseconds = timer.ElapsedMilliseconds();
+	printf("Simplifier: %u triangles to %u, %u, %u in %.0f ms, %.0f ms on %u threads, "
+			"%.0fK triangles/s\n", triangleCount, (uint32_t)levels[0].Indices.size() / 3,
+			(uint32_t)levels[1].Indices.size() / 3, (uint32_t)levels[2].Indices.size() / 3,
+			serialMilliseconds, milliseconds, context.Jobs->GetThreadCount(),
+			triangleCount / milliseconds);
+
+	bool same = serial.size() == 3 && levels.size() == 3;
+	for (size_t l = 0; same && l < levels.size(); ++l)
+		same = serial[l].Indices == levels[l].Indices && serial[l].Error == levels[l].Error;
+	TEST_CHECK(context, same);
+	TEST_CHECK(context, serialHistory.From == history.From && serialHistory.To == history.To &&
+			serialHistory.Collapses.size() == history.Collapses.size());
+	CheckLevels(context, levels, targets, settings.MaxError, source.VertexCount);
+
+	VertexStream stream = { &mesh.Vertices[0], sizeof(TestVertex) };
+	VertexElement elements[3];
+	GetVertexElements(elements);
+	WeldEpsilons epsilons;
+	epsilons.PositionsOnly = true;
+	WeldResult weld;
+	WeldVertices(&stream, elements, 3, source.VertexCount, epsilons, weld, context.Jobs);
+	TEST_CHECK(context, CountOpenEdges(mesh.Indices, weld, source.VertexCount,
+			context.Jobs) == 0);
+	bool closed = true;
+	for (size_t l = 0; l < levels.size(); ++l)
+		closed = closed && CountOpenEdges(levels[l].Indices, weld, source.VertexCount,
+				context.Jobs) == 0;
+	TEST_CHECK(context, closed);
+}
+
+} // namespace
+
+void RunMeshSimplifierTests(TestContext& context) {
+	TestLodChain(context);
+	TestChunks(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,96 @@
+/*
+ * MeshTopologyTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../MeshTopology.h"
+#include "../VertexWelder.h"
+
+namespace Zeus {
+
+namespace {
+
+uint32_t GetPrevious(uint32_t halfEdge) {
+	return halfEdge % 3 == 0 ? halfEdge + 2 : halfEdge - 1;
+}
+
+void TestTopology(TestContext& context) {
+	const uint32_t rings = 100;
+	const uint32_t segments = 200;
+	TestMesh mesh;
+	BuildSphere(rings, segments, 0.1f, mesh);
+	const uint32_t indexCount = mesh.GetIndexCount();
+	const uint32_t vertexCount = mesh.GetVertexCount();
+
+	// By index the seam and the pole rows are open.
+	MeshTopology serial;
+	MeshTopology topology;
+	BuildMeshTopology(&mesh.Indices[0], indexCount, vertexCount, nullptr, serial, nullptr);
+	BuildMeshTopology(&mesh.Indices[0], indexCount, vertexCount, nullptr, topology,
+			context.Jobs);
+	TEST_CHECK(context, serial.Twins == topology.Twins &&
+			serial.Adjacency == topology.Adjacency &&
+			serial.VertexHalfEdges == topology.VertexHalfEdges);
+	TEST_CHECK(context, topology.BorderEdgeCount == 2 * rings + 2 * segments);
+	TEST_CHECK(context, topology.IsManifold() && topology.DegenerateTriangles.empty());
+	bool symmetric = true;
+	for (size_t h = 0; h < topology.Twins.size(); ++h) {
+		uint32_t twin = topology.Twins[h];
+		symmetric = symmetric && (twin == TOPOLOGY_NONE || topology.Twins[twin] == h);
+	}
+	TEST_CHECK(context, symmetric);
+	// Border vertices start their fan at the border.
+	uint32_t seamVertex = (rings / 2) * (segments + 1);
+	TEST_CHECK(context, topology.Twins[GetPrevious(topology.VertexHalfEdges[seamVertex])] ==
+			TOPOLOGY_NONE);
+
+	// Through the welder's point representatives the sphere closes, and
+	// the triangles on the poles collapse.
+	VertexStream stream = { &mesh.Vertices[0], sizeof(TestVertex) };
+	VertexElement elements[3];
+	GetVertexElements(elements);
+	WeldResult weld;
+	WeldVertices(&stream, elements, 3, vertexCount, WeldEpsilons(), weld, context.Jobs);
+	BuildMeshTopology(&mesh.Indices[0], indexCount, vertexCount, &weld.PointReps[0], serial,
+			nullptr);
+	BuildMeshTopology(&mesh.Indices[0], indexCount, vertexCount, &weld.PointReps[0], topology,
+			context.Jobs);
+	TEST_CHECK(context, serial.Twins == topology.Twins &&
+			serial.Adjacency == topology.Adjacency);
+	TEST_CHECK(context, topology.BorderEdgeCount == 0);
+	TEST_CHECK(context, topology.DegenerateTriangles.size() == 2 * segments);
+	printf("Topology: %u triangles, %u border edges by index, %u welded, %u degenerate\n",
+			indexCount / 3, 2 * rings + 2 * segments, topology.BorderEdgeCount,
+			(uint32_t)topology.DegenerateTriangles.size());
+
+	// Two triangles meeting at a vertex.
+	const uint32_t bowtie[6] = { 0, 1, 2, 0, 3, 4 };
+	BuildMeshTopology(bowtie, 6, 5, nullptr, topology, nullptr);
+	TEST_CHECK(context, topology.BowtieVertices.size() == 1 &&
+			topology.BowtieVertices[0] == 0);
+	// Three triangles on one edge.
+	const uint32_t fin[9] = { 0, 1, 2, 1, 0, 3, 0, 1, 4 };
+	BuildMeshTopology(fin, 9, 5, nullptr, topology, nullptr);
+	TEST_CHECK(context, !topology.NonManifoldEdges.empty() && !topology.IsManifold());
+	// Neighbours wound in opposite directions.
+	const uint32_t flip[6] = { 0, 1, 2, 0, 1, 3 };
+	BuildMeshTopology(flip, 6, 4, nullptr, topology, nullptr);
+	TEST_CHECK(context, !topology.FlippedEdges.empty() && !topology.IsManifold());
+	// A quad split along a texture seam: vertices 4 and 5 repeat 1 and 2.
+	const uint32_t seam[9] = { 0, 1, 2, 5, 4, 3, 0, 0, 1 };
+	const uint32_t seamReps[6] = { 0, 1, 2, 3, 1, 2 };
+	BuildMeshTopology(seam, 9, 6, seamReps, topology, nullptr);
+	TEST_CHECK(context, topology.Adjacency[1] == 1 && topology.Adjacency[3] == 0);
+	TEST_CHECK(context, topology.DegenerateTriangles.size() == 1 &&
+			topology.DegenerateTriangles[0] == 2);
+}
+
+} // namespace
+
+void RunMeshTopologyTests(TestContext& context) {
+	TestTopology(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,158 @@
+/*
+ * MeshletTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../JobSystem.h"
+#include "../MeshOptimizer.h"
+#include "../Meshlet.h"
+
+#include <cmath>
+
+namespace Zeus {
+
+namespace {
+
+// Clip space test of the D3D frustum: outside when all three corners are
+// beyond the same plane.
+bool TriangleOutside(const XMFLOAT4* clip) {
+	for (uint32_t plane = 0; plane < 6; ++plane) {
+		bool outside = true;
+		for (uint32_t k = 0; k < 3 && outside; ++k) {
+			const XMFLOAT4& c = clip[k];
+			float distance = plane == 0 ? c.w + c.x : plane == 1 ? c.w - c.x
+					: plane == 2 ? c.w + c.y : plane == 3 ? c.w - c.y
+					: plane == 4 ? c.z : c.w - c.z;
+			outside = distance < 0.0f;
+		}
+		if (outside)
+			return true;
+	}
+	return false;
+}
+
+void TestMeshlets(TestContext& context) {
+	TestMesh mesh;
+	BuildSphere(300, 600, 0.1f, mesh);
+	const uint32_t indexCount = mesh.GetIndexCount();
+	const uint32_t vertexCount = mesh.GetVertexCount();
+	OptimizeVertexCache(&mesh.Indices[0], &mesh.Indices[0], indexCount, vertexCount);
+
+	MeshletSettings settings;
+	MeshletMesh serial;
+	MeshletMesh meshlets;
+	BuildMeshlets(&mesh.Indices[0], indexCount, &mesh.Vertices[0].Position, sizeof(TestVertex),
+			vertexCount, settings, serial, nullptr);
+	BuildMeshlets(&mesh.Indices[0], indexCount, &mesh.Vertices[0].Position, sizeof(TestVertex),
+			vertexCount, settings, meshlets, context.Jobs);
+	const uint32_t meshletCount = (uint32_t)meshlets.Meshlets.size();
+	printf("Meshlets: %u triangles in %u meshlets, %.1f vertices and %.1f triangles each\n",
+			mesh.GetTriangleCount(), meshletCount,
+			(double)meshlets.Vertices.size() / meshletCount,
+			(double)mesh.GetTriangleCount() / meshletCount);
+	TEST_CHECK(context, serial.Vertices == meshlets.Vertices &&
+			serial.Triangles == meshlets.Triangles);
+	// 64 vertices hold about 98 triangles of a grid; see Meshlet.h.
+	TEST_CHECK(context, mesh.GetTriangleCount() > meshletCount * 92);
+
+	// Within the limits, bounded by their spheres, and every triangle once.
+	bool withinLimits = true;
+	bool bounded = true;
+	std::vector<uint32_t> indices;
+	indices.reserve(indexCount);
+	for (uint32_t m = 0; m < meshletCount; ++m) {
+		const Meshlet& meshlet = meshlets.Meshlets[m];
+		const MeshletBounds& bounds = meshlets.Bounds[m];
+		withinLimits = withinLimits && meshlet.VertexCount <= settings.MaxVertices &&
+				meshlet.TriangleCount <= settings.MaxTriangles;
+		for (uint32_t i = 0; i < meshlet.TriangleCount * 3; ++i) {
+			uint8_t local = meshlets.Triangles[meshlet.FirstTriangle * 3 + i];
+			withinLimits = withinLimits && local < meshlet.VertexCount;
+			uint32_t vertex = meshlets.Vertices[meshlet.FirstVertex + local];
+			indices.push_back(vertex);
+			XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&mesh.Vertices[vertex].Position),
+					XMLoadFloat3(&bounds.Center));
+			bounded = bounded &&
+					XMVectorGetX(XMVector3Length(offset)) <= bounds.Radius * 1.0001f + 1e-6f;
+		}
+	}
+	TEST_CHECK(context, withinLimits);
+	TEST_CHECK(context, bounded);
+	std::vector<TriangleKey> sourceKeys;
+	std::vector<TriangleKey> meshletKeys;
+	GetTriangleKeys(&mesh.Indices[0], indexCount, nullptr, sourceKeys);
+	GetTriangleKeys(&indices[0], (uint32_t)indices.size(), nullptr, meshletKeys);
+	TEST_CHECK(context, sourceKeys == meshletKeys);
+
+	// Culling is conservative: from random views no culled meshlet holds a
+	// front-facing triangle with area inside the frustum.
+	MeshletCuller culler;
+	culler.Initialize(&meshlets.Bounds[0], meshletCount);
+	TestRandom random(4);
+	uint32_t culled = 0;
+	uint32_t wronglyCulled = 0;
+	std::vector<uint32_t> visible;
+	std::vector<uint8_t> isVisible;
+	for (uint32_t view = 0; view < 50; ++view) {
+		XMFLOAT3 camera(random.NextFloat() * 10.0f - 5.0f, random.NextFloat() * 10.0f - 5.0f,
+				random.NextFloat() * 10.0f - 5.0f);
+		if (fabsf(camera.x) < 2.0f && fabsf(camera.y) < 2.0f && fabsf(camera.z) < 2.0f)
+			camera.z = 4.0f;
+		float scale = 1.0f + (float)random.Next(3);
+		XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(scale, scale, scale),
+				XMMatrixMultiply(XMMatrixRotationY(view * 0.3f),
+				XMMatrixTranslation(0.5f, 0.0f, 0.0f)));
+		XMVECTOR eye = XMLoadFloat3(&camera);
+		XMVECTOR target = XMVectorSet(random.NextFloat() * 2.0f - 1.0f,
+				random.NextFloat() * 2.0f - 1.0f, 0.0f, 1.0f);
+		XMMATRIX viewProjection = XMMatrixMultiply(
+				XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+				XMMatrixPerspectiveFovLH(0.8f, 1.5f, 0.1f, 100.0f));
+		MeshletCullStats stats;
+		culler.Cull(world, viewProjection, camera, visible, stats);
+		culled += stats.FrustumCulled + stats.BackfaceCulled;
+		isVisible.assign(meshletCount, 0);
+		for (size_t i = 0; i < visible.size(); ++i)
+			isVisible[visible[i]] = 1;
+
+		for (uint32_t m = 0; m < meshletCount; ++m) {
+			if (isVisible[m])
+				continue;
+			const Meshlet& meshlet = meshlets.Meshlets[m];
+			for (uint32_t t = 0; t < meshlet.TriangleCount; ++t) {
+				XMVECTOR p[3];
+				XMFLOAT4 clip[3];
+				for (uint32_t k = 0; k < 3; ++k) {
+					uint8_t local = meshlets.Triangles[(meshlet.FirstTriangle + t) * 3 + k];
+					uint32_t vertex = meshlets.Vertices[meshlet.FirstVertex + local];
+					p[k] = XMVector3Transform(XMLoadFloat3(&mesh.Vertices[vertex].Position),
+							world);
+					XMStoreFloat4(&clip[k], XMVector4Transform(XMVectorSetW(p[k], 1.0f),
+							viewProjection));
+				}
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p[1], p[0]),
+						XMVectorSubtract(p[2], p[0]));
+				bool front = XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(p[0], eye))) <
+						0.0f;
+				if (front && !TriangleOutside(clip)) {
+					++wronglyCulled;
+					break;
+				}
+			}
+		}
+	}
+	printf("Meshlets: %u culled over 50 views, %u holding visible triangles\n", culled,
+			wronglyCulled);
+	TEST_CHECK(context, culled > 0);
+	TEST_CHECK(context, wronglyCulled == 0);
+}
+
+} // namespace
+
+void RunMeshletTests(TestContext& context) {
+	TestMeshlets(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,156 @@
+/*
+ * PathGeometryTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../PathGeometry.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+const float PI = 3.14159265f;
+
+// A grid of star-shaped pentagons, one per 8 pixel cell, so the fill has
+// thousands of scanbeams and its area is known.
+float BuildCells(uint32_t columns, uint32_t rows, PathGeometry& geometry) {
+	TestRandom random(41);
+	geometry.Reset();
+	float area = 0.0f;
+	for (uint32_t cell = 0; cell < columns * rows; ++cell) {
+		const float cx = (cell % columns) * 8.0f + 4.0f;
+		const float cy = (cell / columns) * 8.0f + 4.0f;
+		PathPoint points[5];
+		for (uint32_t k = 0; k < 5; ++k) {
+			float angle = (k + random.NextFloat() * 0.5f) * 2.0f * PI / 5.0f;
+			float radius = 2.0f + random.NextFloat() * 1.5f;
+			points[k] = PathPoint(cx + radius * cosf(angle), cy + radius * sinf(angle));
+		}
+		geometry.BeginFigure(points[0], true);
+		geometry.AddLines(points + 1, 4);
+		geometry.EndFigure(true);
+		for (uint32_t k = 0; k < 5; ++k) {
+			const PathPoint& a = points[k];
+			const PathPoint& b = points[(k + 1) % 5];
+			area += (a.x * b.y - b.x * a.y) * 0.5f;
+		}
+	}
+	return area;
+}
+
+float GetArea(const std::vector<PathTriangle>& triangles) {
+	double area = 0.0;
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		const PathPoint* p = triangles[i].Points;
+		area += fabs((p[1].x - p[0].x) * (p[2].y - p[0].y) -
+				(p[2].x - p[0].x) * (p[1].y - p[0].y)) * 0.5;
+	}
+	return (float)area;
+}
+
+bool SameTriangles(const PathTriangle* a, const PathTriangle* b, size_t count) {
+	return count == 0 || memcmp(a, b, count * sizeof(PathTriangle)) == 0;
+}
+
+// The area matches the polygons', and the output neither depends on the
+// jobs nor on where the chunks of scanbeams start: a zigzag strip above
+// the cells adds beams that shift every chunk boundary, and the cells'
+// triangles must stay byte for byte the same.
+void TestTessellation(TestContext& context) {
+	PathGeometry cells;
+	const float area = BuildCells(40, 50, cells);
+	const Matrix3x2 identity = Matrix3x2::Identity();
+	std::vector<PathTriangle> serial;
+	std::vector<PathTriangle> triangles;
+	cells.Tessellate(identity, DEFAULT_FLATTENING_TOLERANCE, serial, nullptr);
+	cells.Tessellate(identity, DEFAULT_FLATTENING_TOLERANCE, triangles, context.Jobs);
+	TEST_CHECK(context, triangles.size() == serial.size() &&
+			SameTriangles(&triangles[0], &serial[0], serial.size()));
+	TEST_CHECK(context, fabsf(GetArea(serial) - fabsf(area)) < fabsf(area) * 1e-4f);
+
+	bool same = true;
+	const uint32_t extraBeams[4] = { 1, 17, 63, 64 };
+	for (uint32_t i = 0; i < 4; ++i) {
+		PathGeometry shifted = cells;
+		shifted.BeginFigure(PathPoint(0.0f, -1.0f), true);
+		for (uint32_t k = 0; k < extraBeams[i]; ++k)
+			shifted.AddLine(PathPoint(k % 2 ? 2.0f : 3.0f, -2.0f - k));
+		shifted.AddLine(PathPoint(0.0f, -2.0f - extraBeams[i]));
+		shifted.EndFigure(true);
+		shifted.Tessellate(identity, DEFAULT_FLATTENING_TOLERANCE, triangles, context.Jobs);
+		same = same && triangles.size() > serial.size() && SameTriangles(
+				&triangles[triangles.size() - serial.size()], &serial[0], serial.size());
+	}
+	TEST_CHECK(context, same);
+}
+
+// Two triangles whose hashes collide, found by a birthday search over
+// the corners; the cache must still tell them apart.
+void BuildCollision(uint32_t which, PathGeometry& geometry) {
+	const uint64_t corners[2] = { 0xdd1771ba634ff128ull, 0x65028b6bec3f6023ull };
+	const uint64_t x = corners[which];
+	geometry.Reset();
+	geometry.BeginFigure(PathPoint(0.0f, 0.0f), true);
+	geometry.AddLine(PathPoint((float)(x & 0xffff), (float)(x >> 16 & 0xffff)));
+	geometry.AddLine(PathPoint((float)(x >> 32 & 0xffff), (float)(x >> 48)));
+	geometry.EndFigure(true);
+}
+
+void TestCache(TestContext& context) {
+	PathGeometry cells;
+	BuildCells(10, 10, cells);
+	Matrix3x2 transform = { 2.0f, 0.0f, 0.5f, 2.0f, 10.0f, 20.0f };
+	std::vector<PathTriangle> expected;
+	Matrix3x2 linear = transform;
+	linear.Dx = linear.Dy = 0.0f;
+	cells.Tessellate(linear, DEFAULT_FLATTENING_TOLERANCE, expected, nullptr);
+
+	TessellationCache cache;
+	cache.SetMaxAge(1);
+	const std::vector<PathTriangle>& fill = cache.GetFill(cells, transform,
+			DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	TEST_CHECK(context, fill.size() == expected.size() &&
+			SameTriangles(&fill[0], &expected[0], expected.size()));
+	// Panning hits; a stroke is an entry of its own.
+	transform.Dx = -7.0f;
+	const std::vector<PathTriangle>& panned = cache.GetFill(cells, transform,
+			DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	StrokeStyle style;
+	cache.GetStroke(cells, style, transform, DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	TEST_CHECK(context, &panned == &fill && cache.GetStats().Hits == 1 &&
+			cache.GetStats().Misses == 2 && cache.GetStats().EntryCount == 2);
+
+	PathGeometry a;
+	PathGeometry b;
+	BuildCollision(0, a);
+	BuildCollision(1, b);
+	TEST_CHECK(context, a.GetHash() == b.GetHash() && !a.IsEqual(b));
+	b.Tessellate(linear, DEFAULT_FLATTENING_TOLERANCE, expected, nullptr);
+	cache.GetFill(a, transform, DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	const std::vector<PathTriangle>& collided = cache.GetFill(b, transform,
+			DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	TEST_CHECK(context, collided.size() == expected.size() &&
+			SameTriangles(&collided[0], &expected[0], expected.size()) &&
+			cache.GetStats().Misses == 4);
+
+	// Entries unused for longer than the maximum age go.
+	cache.BeginFrame();
+	cache.GetFill(b, transform, DEFAULT_FLATTENING_TOLERANCE, context.Jobs);
+	cache.BeginFrame();
+	cache.BeginFrame();
+	TEST_CHECK(context, cache.GetStats().EntryCount == 0 && cache.GetStats().TriangleCount == 0);
+}
+
+} // namespace
+
+void RunPathGeometryTests(TestContext& context) {
+	TestTessellation(context);
+	TestCache(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,142 @@
+/*
+ * PipelineStateCacheTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../PipelineStateCache.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+SamplerDesc GetSampler(uint32_t id) {
+	SamplerDesc desc = DefaultSamplerDesc();
+	desc.MipLODBias = (float)(1 + id);
+	return desc;
+}
+
+void TestHandles(TestContext& context) {
+	PipelineStateCache cache;
+	uint32_t created = 0;
+	cache.SetCreateCallback([&created](StateKind, StateHandle, const void*) { ++created; });
+	// Setting the callback replays the four defaults.
+	TEST_CHECK(context, created == 4);
+	TEST_CHECK(context, cache.GetBlendState(DefaultBlendDesc()) == 0);
+	TEST_CHECK(context, cache.GetSamplerState(DefaultSamplerDesc()) == 0);
+
+	RasterizerDesc wireframe = DefaultRasterizerDesc();
+	wireframe.FillMode = FILL_WIREFRAME;
+	StateHandle handle = cache.GetRasterizerState(wireframe);
+	TEST_CHECK(context, handle == 1 && cache.GetRasterizerState(wireframe) == handle);
+	TEST_CHECK(context, cache.GetRasterizerDesc(handle).FillMode == FILL_WIREFRAME);
+	TEST_CHECK(context, created == 5);
+
+	// Inside a frame a new descriptor is deferred to EndFrame.
+	cache.BeginFrame();
+	TEST_CHECK(context, cache.GetSamplerState(GetSampler(1)) == INVALID_STATE);
+	TEST_CHECK(context, cache.GetSamplerState(GetSampler(1)) == INVALID_STATE);
+	TEST_CHECK(context, cache.GetRasterizerState(wireframe) == handle);
+	cache.EndFrame();
+	PipelineStateCacheStats stats = cache.GetStats();
+	TEST_CHECK(context, stats.FrameMisses == 2 && stats.Count[STATE_KIND_SAMPLER] == 2);
+	TEST_CHECK(context, created == 6);
+	TEST_CHECK(context, cache.GetSamplerState(GetSampler(1)) == 1);
+}
+
+void TestPrewarm(TestContext& context) {
+	PipelineStateCache cache;
+	for (uint32_t i = 1; i <= 20; ++i)
+		cache.GetSamplerState(GetSampler(i * 7 % 20));
+	DepthStencilDesc noDepth = DefaultDepthStencilDesc();
+	noDepth.DepthEnable = 0;
+	StateHandle noDepthHandle = cache.GetDepthStencilState(noDepth);
+	std::vector<uint8_t> data;
+	cache.Serialize(data);
+
+	// A fresh cache reproduces every handle.
+	PipelineStateCache warm;
+	TEST_CHECK(context, warm.Prewarm(&data[0], data.size()));
+	TEST_CHECK(context, warm.GetStats().Prewarmed == 21);
+	bool same = warm.GetDepthStencilState(noDepth) == noDepthHandle;
+	for (uint32_t i = 0; i < 20; ++i)
+		same = same &&
+				warm.GetSamplerState(GetSampler(i)) == cache.GetSamplerState(GetSampler(i));
+	TEST_CHECK(context, same);
+
+	// Truncated, padded or mislabelled data is rejected whole.
+	PipelineStateCache cold;
+	TEST_CHECK(context, !cold.Prewarm(&data[0], data.size() - 1));
+	std::vector<uint8_t> padded(data);
+	padded.push_back(0);
+	TEST_CHECK(context, !cold.Prewarm(&padded[0], padded.size()));
+	std::vector<uint8_t> corrupt(data);
+	corrupt[0] ^= 1;
+	TEST_CHECK(context, !cold.Prewarm(&corrupt[0], corrupt.size()));
+	TEST_CHECK(context, cold.GetStats().Count[STATE_KIND_SAMPLER] == 1);
+
+	const char* path = "PipelineStateCacheTest.zpsc";
+	TEST_CHECK(context, cache.SaveToFile(path));
+	PipelineStateCache loaded;
+	TEST_CHECK(context, loaded.PrewarmFromFile(path));
+	std::vector<uint8_t> reloaded;
+	loaded.Serialize(reloaded);
+	TEST_CHECK(context, reloaded == data);
+	remove(path);
+}
+
+// Lookups keep running while frames end and the tables grow under them.
+// Known descriptors must always find their handle, and every new one
+// must be created exactly once.
+void TestFrameRace(TestContext& context) {
+	const uint32_t knownCount = 16;
+	const uint32_t threadCount = 3;
+	const uint32_t newPerThread = 2000;
+	PipelineStateCache cache;
+	std::vector<StateHandle> known(knownCount);
+	for (uint32_t i = 0; i < knownCount; ++i)
+		known[i] = cache.GetSamplerState(GetSampler(i));
+
+	std::atomic<uint32_t> running(threadCount);
+	std::atomic<uint32_t> wrong(0);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < threadCount; ++t) {
+		threads.push_back(std::thread([&, t]() {
+			for (uint32_t i = 0; i < newPerThread; ++i) {
+				uint32_t id = knownCount + t * newPerThread + i;
+				cache.GetSamplerState(GetSampler(id));
+				if (cache.GetSamplerState(GetSampler(i % knownCount)) != known[i % knownCount])
+					wrong.fetch_add(1);
+			}
+			running.fetch_sub(1);
+		}));
+	}
+	// Yield inside and between frames so the threads look up both ways.
+	while (running.load() != 0) {
+		cache.BeginFrame();
+		std::this_thread::yield();
+		cache.EndFrame();
+		std::this_thread::yield();
+	}
+	for (uint32_t t = 0; t < threadCount; ++t)
+		threads[t].join();
+	cache.EndFrame();
+	TEST_CHECK(context, wrong.load() == 0);
+	// The defaults take handle 0.
+	TEST_CHECK(context, cache.GetStats().Count[STATE_KIND_SAMPLER] ==
+			1 + knownCount + threadCount * newPerThread);
+}
+
+} // namespace
+
+void RunPipelineStateCacheTests(TestContext& context) {
+	TestHandles(context);
+	TestPrewarm(context);
+	TestFrameRace(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,169 @@
+/*
+ * PostProcessTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../PostProcess.h"
+#include "../Timer.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+// HDR test card: a black band at the top, a ramp up to 4 and a few bright
+// dots that bloom.
+void BuildImage(uint32_t width, uint32_t height, ColorBuffer& image) {
+	image.Initialize(width, height);
+	TestRandom random(7);
+	for (uint32_t y = 0; y < height; ++y) {
+		XMFLOAT4* row = image.GetRow(y);
+		for (uint32_t x = 0; x < width; ++x) {
+			float ramp = y < height / 4 ? 0.0f : 4.0f * x / width;
+			row[x] = XMFLOAT4(ramp, ramp * 0.5f, random.NextFloat() * ramp, 1.0f);
+			if (y >= height / 4 && random.Next(200) == 0)
+				row[x] = XMFLOAT4(20.0f, 16.0f, 12.0f, 1.0f);
+		}
+	}
+}
+
+bool SameImage(const ColorBuffer& a, const ColorBuffer& b) {
+	if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight())
+		return false;
+	for (uint32_t y = 0; y < a.GetHeight(); ++y) {
+		if (memcmp(a.GetRow(y), b.GetRow(y), a.GetWidth() * sizeof(XMFLOAT4)) != 0)
+			return false;
+	}
+	return true;
+}
+
+bool IsFinite(const ColorBuffer& image) {
+	for (uint32_t y = 0; y < image.GetHeight(); ++y) {
+		const XMFLOAT4* row = image.GetRow(y);
+		for (uint32_t x = 0; x < image.GetWidth(); ++x) {
+			const float* p = &row[x].x;
+			for (uint32_t k = 0; k < 4; ++k) {
+				if (!(p[k] - p[k] == 0.0f))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+// The fused chain must match every stage run as a sweep of its own, and
+// report one timing per stage and one for the loads and stores of each
+// sweep.
+void TestFusedChain(TestContext& context) {
+	const uint32_t width = 1280;
+	const uint32_t height = 720;
+	ColorBuffer input;
+	BuildImage(width, height, input);
+	BloomStage bloom;
+	TonemapStage tonemap;
+	ColorGradingStage grading;
+	grading.Initialize(16);
+	FxaaStage fxaa;
+	VignetteStage vignette;
+	PostStage* stages[5] = { &bloom, &tonemap, &grading, &fxaa, &vignette };
+
+	PostProcessChain chain;
+	for (uint32_t i = 0; i < 5; ++i)
+		chain.AddStage(stages[i]);
+	ColorBuffer fused;
+	fused.Initialize(width, height);
+	Timer timer;
+	TEST_CHECK(context, chain.Execute(input, fused, context.Jobs));
+	double fusedMilliseconds = timer.ElapsedMilliseconds();
+
+	ColorBuffer images[2];
+	const ColorBuffer* source = &input;
+	timer.Reset();
+	for (uint32_t i = 0; i < 5; ++i) {
+		PostProcessChain single;
+		single.AddStage(stages[i]);
+		images[i & 1].Initialize(width, height);
+		TEST_CHECK(context, single.Execute(*source, images[i & 1], context.Jobs));
+		source = &images[i & 1];
+	}
+	double separateMilliseconds = timer.ElapsedMilliseconds();
+	TEST_CHECK(context, SameImage(fused, *source));
+	printf("Post process: %ux%u in %.2f ms fused, %.2f ms one stage at a time\n", width, height,
+			fusedMilliseconds, separateMilliseconds);
+
+	const std::vector<PostTiming>& timings = chain.GetTimings();
+	const char* names[7] = { "Bloom", "Tonemap", "ColorGrading", "Load/Store", "FXAA",
+			"Vignette", "Load/Store" };
+	const uint32_t sweeps[7] = { 0, 0, 0, 0, 1, 1, 1 };
+	bool listed = timings.size() == 7;
+	for (size_t i = 0; listed && i < timings.size(); ++i)
+		listed = timings[i].Name == names[i] && timings[i].Sweep == sweeps[i] &&
+				timings[i].PrepareMilliseconds >= 0.0 && timings[i].SweepMilliseconds >= 0.0;
+	TEST_CHECK(context, listed);
+
+	// A disabled stage leaves no entry; an empty chain copies.
+	fxaa.SetEnabled(false);
+	TEST_CHECK(context, chain.Execute(input, fused, context.Jobs));
+	TEST_CHECK(context, chain.GetTimings().size() == 5);
+	chain.ClearStages();
+	TEST_CHECK(context, chain.Execute(input, fused, context.Jobs));
+	TEST_CHECK(context, chain.GetTimings().size() == 1 && SameImage(input, fused));
+}
+
+// A threshold below zero blooms everything, and black pixels stay finite.
+void TestBloomThreshold(TestContext& context) {
+	ColorBuffer input;
+	BuildImage(64, 48, input);
+	BloomStage bloom;
+	BloomSettings settings = bloom.GetSettings();
+	settings.Threshold = -1.0f;
+	bloom.SetSettings(settings);
+	PostProcessChain chain;
+	chain.AddStage(&bloom);
+	ColorBuffer output;
+	output.Initialize(64, 48);
+	TEST_CHECK(context, chain.Execute(input, output, context.Jobs));
+	TEST_CHECK(context, IsFinite(output));
+	// The black band picks up light from below it.
+	TEST_CHECK(context, output.GetRow(11)[32].x > 0.0f);
+}
+
+// The weights sum to one, so a flat image stays flat.
+void TestBlur(TestContext& context) {
+	float weights[MAX_BLUR_RADIUS + 1];
+	uint32_t radius = ComputeGaussianWeights(2.0f, MAX_BLUR_RADIUS, weights);
+	float sum = weights[0];
+	for (uint32_t i = 1; i <= radius; ++i)
+		sum += 2.0f * weights[i];
+	TEST_CHECK(context, radius == 6 && fabsf(sum - 1.0f) < 1e-5f);
+	TEST_CHECK(context, ComputeGaussianWeights(20.0f, MAX_BLUR_RADIUS, weights) ==
+			MAX_BLUR_RADIUS);
+
+	ColorBuffer image;
+	ColorBuffer temp;
+	image.Initialize(37, 23);
+	image.Clear(XMFLOAT4(0.5f, 0.25f, 2.0f, 1.0f));
+	radius = ComputeGaussianWeights(3.0f, MAX_BLUR_RADIUS, weights);
+	BlurSeparable(image, temp, weights, radius, context.Jobs);
+	bool flat = true;
+	for (uint32_t y = 0; y < image.GetHeight(); ++y) {
+		for (uint32_t x = 0; x < image.GetWidth(); ++x) {
+			const XMFLOAT4& pixel = image.GetRow(y)[x];
+			flat = flat && fabsf(pixel.x - 0.5f) < 1e-5f && fabsf(pixel.z - 2.0f) < 1e-5f;
+		}
+	}
+	TEST_CHECK(context, flat);
+}
+
+} // namespace
+
+void RunPostProcessTests(TestContext& context) {
+	TestFusedChain(context);
+	TestBloomThreshold(context);
+	TestBlur(context);
+}
+
+} // namespace Zeus
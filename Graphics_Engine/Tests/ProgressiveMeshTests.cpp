@@ -0,0 +1,151 @@
+/*
+ * ProgressiveMeshTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../ProgressiveMesh.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+bool SamePosition(const TestVertex& a, const TestVertex& b) {
+	return memcmp(&a.Position, &b.Position, sizeof(XMFLOAT3)) == 0;
+}
+
+void GetStreamIds(const ProgressiveMeshStream& stream, std::vector<uint32_t>& ids) {
+	const TestVertex* vertices = (const TestVertex*)&stream.GetVertices()[0];
+	ids.resize(stream.GetVertexCount());
+	for (uint32_t v = 0; v < stream.GetVertexCount(); ++v)
+		ids[v] = vertices[v].Id;
+}
+
+// Streaming every split and refining to zero error rebuilds the source
+// triangles, less the ones with no area; coarsening again reaches the
+// simplifier's result at the base. Spheres above 64K triangles simplify
+// in chunks, and their splits must still interleave by cost.
+void TestProgressiveMesh(TestContext& context, uint32_t rings, uint32_t baseTriangles) {
+	TestMesh mesh;
+	BuildSphere(rings, rings * 2, 0.1f, mesh);
+	SimplifySource source;
+	GetSimplifySource(mesh, source);
+	SimplifySettings settings;
+	settings.MaxError = 1.0f;
+	ProgressiveMeshData data;
+	BuildProgressiveMesh(source, &mesh.Vertices[0], sizeof(TestVertex), settings,
+			baseTriangles, data, context.Jobs);
+	bool monotone = true;
+	for (size_t i = 1; i < data.Splits.size(); ++i)
+		monotone = monotone && data.Splits[i].Error <= data.Splits[i - 1].Error;
+	TEST_CHECK(context, monotone);
+	// Replaying chunk after chunk would hold the error near the base error
+	// until the last chunk's splits were done.
+	size_t splitCount = data.Splits.size();
+	TEST_CHECK(context, splitCount > 4 &&
+			data.Splits[splitCount / 4].Error < data.BaseError * 0.5f &&
+			data.Splits[splitCount / 2].Error < data.Splits[splitCount / 4].Error &&
+			data.Splits[splitCount * 3 / 4].Error < data.Splits[splitCount / 2].Error);
+
+	const char* path = "ProgressiveMeshTest.zpm";
+	if (!TEST_CHECK(context, SaveProgressiveMesh(path, data)))
+		return;
+	ProgressiveMeshStream stream;
+	if (!TEST_CHECK(context, stream.Open(path))) {
+		remove(path);
+		return;
+	}
+	ProgressiveMeshUpdate update;
+	uint32_t frames = 0;
+	bool streamed = true;
+	while (streamed && stream.GetAppliedSplits() < stream.GetSplitCount()) {
+		streamed = stream.Stream(4096 * rings / 100);
+		stream.Refine(0.0f, 500 * rings / 100, update);
+		++frames;
+	}
+	TEST_CHECK(context, streamed);
+	printf("Progressive mesh: %u triangles, %u at the base, %u splits streamed over %u "
+			"frames, error %.3f, %.3f at a quarter, %.3f at half\n", mesh.GetTriangleCount(),
+			data.BaseTriangleCount, stream.GetSplitCount(), frames, data.BaseError,
+			data.Splits[splitCount / 4].Error, data.Splits[splitCount / 2].Error);
+
+	std::vector<uint32_t> ids;
+	GetStreamIds(stream, ids);
+	std::vector<uint32_t> sourceIndices;
+	for (uint32_t i = 0; i < mesh.GetIndexCount(); i += 3) {
+		const uint32_t* triangle = &mesh.Indices[i];
+		if (!SamePosition(mesh.Vertices[triangle[0]], mesh.Vertices[triangle[1]]) &&
+				!SamePosition(mesh.Vertices[triangle[1]], mesh.Vertices[triangle[2]]) &&
+				!SamePosition(mesh.Vertices[triangle[0]], mesh.Vertices[triangle[2]]))
+			sourceIndices.insert(sourceIndices.end(), triangle, triangle + 3);
+	}
+	std::vector<TriangleKey> sourceKeys;
+	std::vector<TriangleKey> refinedKeys;
+	GetTriangleKeys(&sourceIndices[0], (uint32_t)sourceIndices.size(), nullptr, sourceKeys);
+	GetTriangleKeys(&stream.GetIndices()[0], stream.GetTriangleCount() * 3, &ids[0],
+			refinedKeys);
+	TEST_CHECK(context, sourceKeys == refinedKeys);
+	TEST_CHECK(context, stream.GetError() == 0.0f);
+
+	stream.Refine(1.0f, 1000000, update);
+	SimplifyLod base;
+	Simplify(source, settings, baseTriangles, base, context.Jobs);
+	std::vector<TriangleKey> baseKeys;
+	GetStreamIds(stream, ids);
+	GetTriangleKeys(&base.Indices[0], (uint32_t)base.Indices.size(), nullptr, baseKeys);
+	GetTriangleKeys(&stream.GetIndices()[0], stream.GetTriangleCount() * 3, &ids[0],
+			refinedKeys);
+	TEST_CHECK(context, baseKeys == refinedKeys);
+	stream.Close();
+	remove(path);
+}
+
+// A split whose vertex count would wrap the loaded count back into range
+// is rejected as soon as its header arrives.
+void TestCorruptSplit(TestContext& context) {
+	TestMesh mesh;
+	BuildSphere(20, 40, 0.1f, mesh);
+	SimplifySource source;
+	GetSimplifySource(mesh, source);
+	SimplifySettings settings;
+	settings.MaxError = 1.0f;
+	ProgressiveMeshData data;
+	BuildProgressiveMesh(source, &mesh.Vertices[0], sizeof(TestVertex), settings, 100, data,
+			context.Jobs);
+	const char* path = "ProgressiveMeshTest.zpm";
+	if (!TEST_CHECK(context, !data.Splits.empty() && SaveProgressiveMesh(path, data)))
+		return;
+	// The file header holds nine 32-bit fields; the split header's vertex
+	// count follows its error.
+	FILE* file;
+	if (!TEST_CHECK(context, fopen_s(&file, path, "r+b") == 0)) {
+		remove(path);
+		return;
+	}
+	long offset = (long)(9 * sizeof(uint32_t) + data.BaseVertexCount * sizeof(TestVertex) +
+			data.BaseTriangleCount * 3 * sizeof(uint32_t) + sizeof(float));
+	uint32_t vertexCount = 0u - data.BaseVertexCount;
+	fseek(file, offset, SEEK_SET);
+	fwrite(&vertexCount, sizeof(vertexCount), 1, file);
+	fclose(file);
+
+	ProgressiveMeshStream stream;
+	TEST_CHECK(context, stream.Open(path));
+	TEST_CHECK(context, !stream.Stream(256) && stream.GetLoadedSplits() == 0);
+	stream.Close();
+	remove(path);
+}
+
+} // namespace
+
+void RunProgressiveMeshTests(TestContext& context) {
+	TestProgressiveMesh(context, 100, 200);
+	TestProgressiveMesh(context, 200, 2000);
+	TestCorruptSplit(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,303 @@
+/*
+ * RenderGraphTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../RenderGraph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+struct Use {
+	uint32_t Pass;
+	RenderGraphResource Resource;
+	ResourceState State;
+};
+
+// Replays the barriers and checks every transition starts from the state
+// the resource is in, every pass finds its resources in the states it
+// declared, and imported resources end in their final states.
+class StateTracker {
+public:
+	StateTracker(const std::vector<Use>& uses, const std::vector<ResourceState>& initial)
+		: m_uses(uses), m_states(initial), m_valid(true) {}
+
+	void OnBarriers(const RenderGraphBarrier* barriers, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i) {
+			const RenderGraphBarrier& barrier = barriers[i];
+			if (barrier.Type != BARRIER_TRANSITION)
+				continue;
+			ResourceState& state = m_states[barrier.Resource.Index];
+			m_valid = m_valid && state == barrier.Before;
+			state = barrier.After;
+		}
+	}
+
+	void OnPass(const RenderGraphContext& context) {
+		m_order.push_back(context.GetPassIndex());
+		for (size_t i = 0; i < m_uses.size(); ++i) {
+			if (m_uses[i].Pass == context.GetPassIndex())
+				m_valid = m_valid && m_states[m_uses[i].Resource.Index] == m_uses[i].State;
+		}
+	}
+
+	bool IsValid() const { return m_valid; }
+	const std::vector<uint32_t>& GetOrder() const { return m_order; }
+	ResourceState GetState(RenderGraphResource resource) const {
+		return m_states[resource.Index];
+	}
+
+private:
+	const std::vector<Use>& m_uses;
+	std::vector<ResourceState> m_states;
+	std::vector<uint32_t> m_order;
+	bool m_valid;
+};
+
+// Records accesses both in the graph and in the list the tracker checks.
+class Builder {
+public:
+	explicit Builder(RenderGraph& graph) : m_graph(graph) {}
+
+	void Read(uint32_t pass, RenderGraphResource resource, ResourceState state) {
+		m_graph.Read(pass, resource, state);
+		Use use = { pass, resource, state };
+		Uses.push_back(use);
+	}
+	void Write(uint32_t pass, RenderGraphResource resource, ResourceState state) {
+		m_graph.Write(pass, resource, state);
+		Use use = { pass, resource, state };
+		Uses.push_back(use);
+	}
+
+	std::vector<Use> Uses;
+
+private:
+	RenderGraph& m_graph;
+};
+
+TextureDesc MakeTarget(uint32_t width, uint32_t height) {
+	return MakeTextureDesc(width, height, FORMAT_R16G16B16A16_FLOAT,
+			BIND_RENDER_TARGET | BIND_SHADER_RESOURCE);
+}
+
+bool Overlap(const RenderGraphPlacement& a, const RenderGraphPlacement& b) {
+	return a.Offset < b.Offset + b.Size && b.Offset < a.Offset + a.Size;
+}
+
+// A deferred frame with a debug view nobody reads, a pass reading only a
+// culled result, and a readback kept alive by its side effects.
+void TestCulling(TestContext& context) {
+	RenderGraph graph;
+	Builder builder(graph);
+	StateTracker* tracker = nullptr;
+	RenderGraph::ExecuteFunc record = [&](const RenderGraphContext& pass) {
+		tracker->OnPass(pass);
+	};
+	RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer",
+			MakeTextureDesc(1280, 720, FORMAT_R8G8B8A8_UNORM, BIND_RENDER_TARGET),
+			STATE_PRESENT, STATE_PRESENT);
+	RenderGraphResource albedo = graph.CreateTexture("Albedo", MakeTarget(1280, 720));
+	RenderGraphResource depth = graph.CreateTexture("Depth", MakeTextureDesc(1280, 720,
+			FORMAT_D32_FLOAT, BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE));
+	RenderGraphResource hdr = graph.CreateTexture("Hdr", MakeTarget(1280, 720));
+	RenderGraphResource debug = graph.CreateTexture("Debug", MakeTarget(1280, 720));
+	RenderGraphResource blurred = graph.CreateTexture("Blurred", MakeTarget(640, 360));
+	BufferDesc readbackDesc = { 256, 0, 0 };
+	RenderGraphResource readback = graph.CreateBuffer("Readback", readbackDesc);
+
+	uint32_t gbuffer = graph.AddPass("GBuffer", record);
+	builder.Write(gbuffer, albedo, STATE_RENDER_TARGET);
+	builder.Write(gbuffer, depth, STATE_DEPTH_WRITE);
+	uint32_t debugView = graph.AddPass("DebugView", record);
+	builder.Read(debugView, albedo, STATE_SHADER_RESOURCE);
+	builder.Write(debugView, debug, STATE_RENDER_TARGET);
+	uint32_t lighting = graph.AddPass("Lighting", record);
+	builder.Read(lighting, albedo, STATE_SHADER_RESOURCE);
+	builder.Read(lighting, depth, STATE_DEPTH_READ);
+	builder.Write(lighting, hdr, STATE_RENDER_TARGET);
+	uint32_t blur = graph.AddPass("BlurDebug", record);
+	builder.Read(blur, debug, STATE_SHADER_RESOURCE);
+	builder.Write(blur, blurred, STATE_RENDER_TARGET);
+	uint32_t query = graph.AddPass("DepthReadback", record);
+	builder.Read(query, depth, STATE_COPY_SOURCE);
+	builder.Write(query, readback, STATE_COPY_DEST);
+	graph.SetSideEffects(query);
+	uint32_t tonemap = graph.AddPass("Tonemap", record);
+	builder.Read(tonemap, hdr, STATE_SHADER_RESOURCE);
+	builder.Write(tonemap, backBuffer, STATE_RENDER_TARGET);
+
+	if (!TEST_CHECK(context, graph.Compile()))
+		return;
+	const RenderGraphStats& stats = graph.GetStats();
+	TEST_CHECK(context, graph.IsPassCulled(debugView) && graph.IsPassCulled(blur) &&
+			!graph.IsPassCulled(query) && stats.PassCount == 6 && stats.CulledPassCount == 2);
+	TEST_CHECK(context, stats.TransientCount == 4 && graph.GetPlacement(debug).Size == 0);
+
+	std::vector<ResourceState> initial(7, STATE_UNDEFINED);
+	initial[backBuffer.Index] = STATE_PRESENT;
+	StateTracker state(builder.Uses, initial);
+	tracker = &state;
+	graph.Execute([&](const RenderGraphBarrier* barriers, uint32_t count) {
+		state.OnBarriers(barriers, count);
+	});
+	const uint32_t order[4] = { gbuffer, lighting, query, tonemap };
+	TEST_CHECK(context, state.IsValid() && state.GetOrder().size() == 4 &&
+			memcmp(&state.GetOrder()[0], order, sizeof(order)) == 0 &&
+			state.GetState(backBuffer) == STATE_PRESENT);
+}
+
+// Chains of passes over transients of random sizes: resources alive at the
+// same time never share memory, the heap is smaller than the sum, and each
+// transient reusing memory gets an aliasing barrier naming the last
+// resource that occupied it.
+void TestAliasing(TestContext& context) {
+	TestRandom random(26);
+	RenderGraph graph;
+	bool disjoint = true;
+	bool valid = true;
+	bool aliased = true;
+	uint64_t saved = 0;
+	for (uint32_t frame = 0; frame < 20; ++frame) {
+		graph.Reset();
+		Builder builder(graph);
+		RenderGraphResource output = graph.ImportTexture("Output", MakeTarget(256, 256),
+				STATE_UNDEFINED, STATE_SHADER_RESOURCE);
+		const uint32_t passCount = 24;
+		std::vector<RenderGraphResource> targets;
+		for (uint32_t p = 0; p < passCount; ++p) {
+			uint32_t pass = graph.AddPass("Pass", RenderGraph::ExecuteFunc());
+			for (uint32_t i = 0; i < 2 && !targets.empty(); ++i) {
+				uint32_t back = 1 + random.Next(std::min<uint32_t>(4, (uint32_t)targets.size()));
+				builder.Read(pass, targets[targets.size() - back], STATE_SHADER_RESOURCE);
+			}
+			if (p + 1 == passCount) {
+				builder.Write(pass, output, STATE_RENDER_TARGET);
+				break;
+			}
+			if (random.Next(4) == 0) {
+				BufferDesc desc = { 1 + random.Next(1 << 20), BIND_UNORDERED_ACCESS, 0 };
+				targets.push_back(graph.CreateBuffer("Buffer", desc));
+				builder.Write(pass, targets.back(), STATE_UNORDERED_ACCESS);
+			} else {
+				uint32_t size = 64 << random.Next(5);
+				targets.push_back(graph.CreateTexture("Target", MakeTarget(size, size)));
+				builder.Write(pass, targets.back(), STATE_RENDER_TARGET);
+			}
+		}
+		if (!graph.Compile()) {
+			valid = false;
+			break;
+		}
+
+		// Lifetimes from the live passes, independently of the graph.
+		std::vector<uint32_t> first(targets.size() + 1, ~0u);
+		std::vector<uint32_t> last(targets.size() + 1, 0);
+		for (size_t u = 0; u < builder.Uses.size(); ++u) {
+			const Use& use = builder.Uses[u];
+			if (graph.IsPassCulled(use.Pass))
+				continue;
+			first[use.Resource.Index] = std::min(first[use.Resource.Index], use.Pass);
+			last[use.Resource.Index] = std::max(last[use.Resource.Index], use.Pass);
+		}
+		for (size_t a = 0; a < targets.size(); ++a) {
+			for (size_t b = a + 1; b < targets.size(); ++b) {
+				const uint32_t ia = targets[a].Index;
+				const uint32_t ib = targets[b].Index;
+				if (first[ia] == ~0u || first[ib] == ~0u ||
+						first[ia] > last[ib] || first[ib] > last[ia])
+					continue;
+				disjoint = disjoint && !Overlap(graph.GetPlacement(targets[a]),
+						graph.GetPlacement(targets[b]));
+			}
+		}
+		const RenderGraphStats& stats = graph.GetStats();
+		saved += stats.SavedBytes;
+		disjoint = disjoint && stats.HeapBytes + stats.SavedBytes == stats.UnaliasedBytes;
+
+		std::vector<ResourceState> initial(targets.size() + 1, STATE_UNDEFINED);
+		StateTracker tracker(builder.Uses, initial);
+		std::vector<uint32_t> aliases(targets.size() + 1, 0);
+		std::vector<uint32_t> previous(targets.size() + 1, ~0u);
+		graph.Execute([&](const RenderGraphBarrier* barriers, uint32_t count) {
+			tracker.OnBarriers(barriers, count);
+			for (uint32_t i = 0; i < count; ++i) {
+				const RenderGraphBarrier& barrier = barriers[i];
+				if (barrier.Type != BARRIER_ALIASING)
+					continue;
+				++aliases[barrier.Resource.Index];
+				previous[barrier.Resource.Index] = barrier.Previous.Index;
+				aliased = aliased && Overlap(graph.GetPlacement(barrier.Previous),
+						graph.GetPlacement(barrier.Resource));
+			}
+		});
+		valid = valid && tracker.IsValid() && tracker.GetState(output) == STATE_SHADER_RESOURCE;
+		// A transient needs an aliasing barrier exactly when memory it
+		// takes was used by a resource that died earlier, and the barrier
+		// names the one that died last.
+		for (size_t a = 0; a < targets.size(); ++a) {
+			const uint32_t ia = targets[a].Index;
+			if (first[ia] == ~0u)
+				continue;
+			bool reused = false;
+			uint32_t latest = 0;
+			for (size_t b = 0; b < targets.size(); ++b) {
+				const uint32_t ib = targets[b].Index;
+				if (first[ib] == ~0u || last[ib] >= first[ia] ||
+						!Overlap(graph.GetPlacement(targets[a]), graph.GetPlacement(targets[b])))
+					continue;
+				reused = true;
+				latest = std::max(latest, last[ib]);
+			}
+			aliased = aliased && aliases[ia] == (reused ? 1u : 0u) &&
+					(!reused || last[previous[ia]] == latest);
+		}
+	}
+	TEST_CHECK(context, valid && disjoint && aliased && saved > 0);
+}
+
+// Back-to-back unordered access writes are separated by a UAV barrier, and
+// a read in between turns it into a transition.
+void TestUavBarriers(TestContext& context) {
+	RenderGraph graph;
+	BufferDesc desc = { 4096, BIND_UNORDERED_ACCESS | BIND_SHADER_RESOURCE, 16 };
+	RenderGraphResource particles = graph.ImportBuffer("Particles", desc,
+			STATE_UNORDERED_ACCESS, STATE_SHADER_RESOURCE);
+	uint32_t emit = graph.AddPass("Emit", RenderGraph::ExecuteFunc());
+	graph.Write(emit, particles, STATE_UNORDERED_ACCESS);
+	uint32_t simulate = graph.AddPass("Simulate", RenderGraph::ExecuteFunc());
+	graph.Read(simulate, particles, STATE_UNORDERED_ACCESS);
+	graph.Write(simulate, particles, STATE_UNORDERED_ACCESS);
+	uint32_t draw = graph.AddPass("Draw", RenderGraph::ExecuteFunc());
+	graph.Read(draw, particles, STATE_SHADER_RESOURCE);
+	graph.SetSideEffects(draw);
+	uint32_t compact = graph.AddPass("Compact", RenderGraph::ExecuteFunc());
+	graph.Write(compact, particles, STATE_UNORDERED_ACCESS);
+	if (!TEST_CHECK(context, graph.Compile()))
+		return;
+	std::vector<RenderGraphBarrier> barriers;
+	graph.Execute([&](const RenderGraphBarrier* list, uint32_t count) {
+		barriers.insert(barriers.end(), list, list + count);
+	});
+	TEST_CHECK(context, barriers.size() == 4 && graph.GetStats().BarrierCount == 4 &&
+			barriers[0].Type == BARRIER_UAV &&
+			barriers[1].Type == BARRIER_TRANSITION && barriers[1].After == STATE_SHADER_RESOURCE &&
+			barriers[2].Type == BARRIER_TRANSITION && barriers[2].After == STATE_UNORDERED_ACCESS &&
+			barriers[3].Type == BARRIER_TRANSITION && barriers[3].After == STATE_SHADER_RESOURCE);
+}
+
+} // namespace
+
+void RunRenderGraphTests(TestContext& context) {
+	TestCulling(context);
+	TestAliasing(context);
+	TestUavBarriers(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,146 @@
+/*
+ * RingAllocatorTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../JobSystem.h"
+#include "../RingAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+struct Range {
+	uint32_t Offset;
+	uint32_t Size;
+
+	bool operator<(const Range& other) const { return Offset < other.Offset; }
+};
+
+// True when no two ranges overlap and all lie within capacity.
+bool Disjoint(std::vector<Range> ranges, uint32_t capacity) {
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		if (ranges[i].Offset + ranges[i].Size > capacity)
+			return false;
+		if (i > 0 && ranges[i - 1].Offset + ranges[i - 1].Size > ranges[i].Offset)
+			return false;
+	}
+	return true;
+}
+
+// Frames of odd sizes and strides that do not divide the capacity go
+// round the ring many times with up to three frames in flight; every
+// allocation is aligned, inside the buffer and clear of every allocation
+// still in flight, and the ring fills up rather than overwrite one.
+void TestWraparound(TestContext& context) {
+	const uint32_t capacity = 4000;
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize(capacity, NULL_RESOURCE)))
+		return;
+	TestRandom random(29);
+	std::vector<std::vector<Range> > frames;
+	bool aligned = true;
+	bool disjoint = true;
+	uint32_t wraps = 0;
+	uint32_t lastOffset = 0;
+	uint64_t fence = 0;
+	for (uint32_t frame = 0; frame < 400; ++frame) {
+		std::vector<Range> ranges;
+		uint32_t count = 1 + random.Next(12);
+		for (uint32_t i = 0; i < count; ++i) {
+			const uint32_t strides[4] = { 12, 20, 48, 56 };
+			uint32_t stride = strides[random.Next(4)];
+			RingAllocation allocation = i == 0 ? ring.AllocateConstants(1 + random.Next(300))
+					: ring.AllocateVertices(1 + random.Next(8), stride);
+			if (!allocation.IsValid())
+				continue;
+			uint32_t alignment = i == 0 ? CONSTANT_BUFFER_ALIGNMENT : stride;
+			aligned = aligned && allocation.Offset % alignment == 0 &&
+					allocation.CpuAddress != nullptr;
+			wraps += allocation.Offset < lastOffset;
+			lastOffset = allocation.Offset;
+			Range range = { allocation.Offset, allocation.Size };
+			ranges.push_back(range);
+		}
+		frames.push_back(ranges);
+		if (frames.size() > 3)
+			frames.erase(frames.begin());
+		std::vector<Range> inFlight;
+		for (size_t f = 0; f < frames.size(); ++f)
+			inFlight.insert(inFlight.end(), frames[f].begin(), frames[f].end());
+		disjoint = disjoint && Disjoint(inFlight, capacity);
+		ring.EndFrame(++fence);
+		ring.Retire(fence - std::min<uint64_t>(fence, 2));
+	}
+	TEST_CHECK(context, aligned && disjoint && wraps > 20);
+
+	// With every frame retired the ring takes all but the padding of the
+	// wrap, then refuses.
+	ring.Retire(fence);
+	const uint32_t failed = ring.GetStats().FailedAllocations;
+	uint32_t bytes = 0;
+	RingAllocation allocation;
+	while ((allocation = ring.AllocateVertices(7, 48)).IsValid())
+		bytes += allocation.Size;
+	TEST_CHECK(context, bytes > capacity - 2 * 7 * 48 && bytes <= capacity &&
+			ring.GetStats().FailedAllocations == failed + 1);
+	ring.EndFrame(++fence);
+	ring.Retire(fence);
+	TEST_CHECK(context, ring.GetBytesInFlight() == 0 && ring.AllocateVertices(7, 48).IsValid());
+}
+
+// Sizes whose product overflows 32 bits must not wrap into a small,
+// valid allocation.
+void TestOverflow(TestContext& context) {
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize(1 << 16, NULL_RESOURCE)))
+		return;
+	TEST_CHECK(context, !ring.AllocateVertices(0x10000001, 16).IsValid());
+	TEST_CHECK(context, !ring.AllocateIndices(0x80000001, FORMAT_R32_UINT).IsValid());
+	TEST_CHECK(context, !ring.AllocateIndices(0x80000000, FORMAT_R16_UINT).IsValid());
+	TEST_CHECK(context, ring.GetStats().FailedAllocations == 3 && ring.GetBytesInFlight() == 0);
+	TEST_CHECK(context, ring.AllocateIndices(100, FORMAT_R16_UINT).Size == 200);
+}
+
+// Threads allocating at once get disjoint ranges of the memory passed in.
+void TestParallel(TestContext& context) {
+	const uint32_t capacity = 1 << 20;
+	const uint32_t count = 20000;
+	std::vector<uint8_t> memory(capacity);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize(capacity, NULL_RESOURCE, &memory[0])))
+		return;
+	std::vector<Range> ranges(count);
+	ParallelFor(context.Jobs, count, 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			RingAllocation allocation = ring.AllocateVertices(1 + i % 5, 8);
+			memset(allocation.CpuAddress, (int)(i & 0xff), allocation.Size);
+			ranges[i].Offset = allocation.Offset;
+			ranges[i].Size = allocation.Size;
+		}
+	});
+	bool written = true;
+	for (uint32_t i = 0; i < count; ++i) {
+		written = written && ranges[i].Size == (1 + i % 5) * 8;
+		for (uint32_t b = 0; written && b < ranges[i].Size; ++b)
+			written = memory[ranges[i].Offset + b] == (uint8_t)i;
+	}
+	TEST_CHECK(context, written && Disjoint(ranges, capacity));
+	TEST_CHECK(context, ring.GetStats().FrameAllocations == count);
+}
+
+} // namespace
+
+void RunRingAllocatorTests(TestContext& context) {
+	TestWraparound(context);
+	TestOverflow(context);
+	TestParallel(context);
+}
+
+} // namespace Zeus
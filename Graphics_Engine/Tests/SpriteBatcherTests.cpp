@@ -0,0 +1,248 @@
+/*
+ * SpriteBatcherTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../SpriteBatcher.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Zeus {
+
+namespace {
+
+// Sprites whose color is their submission index, so instances can be
+// traced back to them.
+void MakeSprites(TestRandom& random, uint32_t count, std::vector<Sprite>& sprites) {
+	sprites.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		Sprite& sprite = sprites[i];
+		sprite.Texture = 1 + random.Next(6);
+		sprite.Color = i;
+		sprite.Position = XMFLOAT2(random.NextFloat() * 800.0f, random.NextFloat() * 600.0f);
+		sprite.Size = XMFLOAT2(1.0f + random.NextFloat() * 60.0f,
+				1.0f + random.NextFloat() * 60.0f);
+		sprite.Pivot = XMFLOAT2(random.NextFloat(), random.NextFloat());
+		sprite.Rotation = (random.NextFloat() * 2.0f - 1.0f) * XM_PI;
+		sprite.Depth = random.Next(8) * 0.125f;
+		sprite.TexCoords = XMFLOAT4(0.0f, 0.0f, random.NextFloat(), random.NextFloat());
+	}
+}
+
+void Submit(SpriteBatcher& batcher, const std::vector<Sprite>& sprites) {
+	batcher.Reset();
+	const uint32_t count = (uint32_t)sprites.size();
+	for (uint32_t q = 0; q < 4; ++q)
+		batcher.Draw(q, &sprites[count * q / 4], count * (q + 1) / 4 - count * q / 4);
+}
+
+bool Near(float a, float b) {
+	return fabsf(a - b) <= 1e-3f * (1.0f + fabsf(b));
+}
+
+// Every mode orders the instances as it promises, depth ties sort by
+// texture, sprites of equal key keep their submission order, runs of a
+// texture become single batches, and each instance matches its sprite
+// worked out one at a time.
+void TestBuild(TestContext& context) {
+	TestRandom random(37);
+	std::vector<Sprite> sprites;
+	MakeSprites(random, 3001, sprites);
+	SpriteBatcher batcher;
+	batcher.Initialize(4);
+	const SpriteSortMode modes[4] = { SPRITE_SORT_NONE, SPRITE_SORT_TEXTURE,
+			SPRITE_SORT_BACK_TO_FRONT, SPRITE_SORT_FRONT_TO_BACK };
+	bool ordered = true;
+	bool batched = true;
+	bool placed = true;
+	bool same = true;
+	for (uint32_t m = 0; m < 4; ++m) {
+		batcher.SetSortMode(modes[m]);
+		Submit(batcher, sprites);
+		batcher.Build(nullptr);
+		std::vector<SpriteInstance> serial(batcher.GetInstances(), batcher.GetInstances() + 3001);
+		Submit(batcher, sprites);
+		batcher.Build(context.Jobs);
+		same = same && memcmp(&serial[0], batcher.GetInstances(),
+				serial.size() * sizeof(SpriteInstance)) == 0;
+
+		const SpriteInstance* instances = batcher.GetInstances();
+		for (uint32_t i = 0; i < 3001; ++i) {
+			const Sprite& sprite = sprites[instances[i].Color];
+			if (i > 0) {
+				const Sprite& previous = sprites[instances[i - 1].Color];
+				bool sameKey = previous.Texture == sprite.Texture;
+				switch (modes[m]) {
+				case SPRITE_SORT_NONE:
+					ordered = ordered && instances[i].Color == i;
+					break;
+				case SPRITE_SORT_TEXTURE:
+					ordered = ordered && previous.Texture <= sprite.Texture;
+					break;
+				case SPRITE_SORT_BACK_TO_FRONT:
+					ordered = ordered && previous.Depth >= sprite.Depth &&
+							(previous.Depth != sprite.Depth || previous.Texture <= sprite.Texture);
+					sameKey = sameKey && previous.Depth == sprite.Depth;
+					break;
+				case SPRITE_SORT_FRONT_TO_BACK:
+					ordered = ordered && previous.Depth <= sprite.Depth &&
+							(previous.Depth != sprite.Depth || previous.Texture <= sprite.Texture);
+					sameKey = sameKey && previous.Depth == sprite.Depth;
+					break;
+				}
+				if (sameKey)
+					ordered = ordered && instances[i - 1].Color < instances[i].Color;
+			}
+
+			const float c = cosf(sprite.Rotation);
+			const float s = sinf(sprite.Rotation);
+			const XMFLOAT2 axisX(sprite.Size.x * c, sprite.Size.x * s);
+			const XMFLOAT2 axisY(-sprite.Size.y * s, sprite.Size.y * c);
+			const SpriteInstance& instance = instances[i];
+			placed = placed && Near(instance.AxisX.x, axisX.x) &&
+					Near(instance.AxisX.y, axisX.y) && Near(instance.AxisY.x, axisY.x) &&
+					Near(instance.AxisY.y, axisY.y) &&
+					Near(instance.Origin.x, sprite.Position.x - sprite.Pivot.x * axisX.x -
+					sprite.Pivot.y * axisY.x) &&
+					Near(instance.Origin.y, sprite.Position.y - sprite.Pivot.x * axisX.y -
+					sprite.Pivot.y * axisY.y) &&
+					instance.Depth == sprite.Depth &&
+					memcmp(&instance.TexCoords, &sprite.TexCoords, sizeof(XMFLOAT4)) == 0;
+		}
+
+		uint32_t covered = 0;
+		for (uint32_t b = 0; b < batcher.GetBatchCount(); ++b) {
+			const SpriteBatch& batch = batcher.GetBatches()[b];
+			batched = batched && batch.StartInstance == covered && batch.InstanceCount > 0;
+			for (uint32_t i = 0; batched && i < batch.InstanceCount; ++i)
+				batched = sprites[instances[covered + i].Color].Texture == batch.Texture;
+			if (b > 0)
+				batched = batched && batcher.GetBatches()[b - 1].Texture != batch.Texture;
+			covered += batch.InstanceCount;
+		}
+		batched = batched && covered == 3001 && batcher.GetStats().SpriteCount == 3001;
+		if (modes[m] == SPRITE_SORT_TEXTURE)
+			batched = batched && batcher.GetBatchCount() == 6;
+	}
+	TEST_CHECK(context, ordered && batched && placed && same);
+
+	std::vector<uint8_t> memory(1 << 20);
+	RingAllocator ring;
+	if (!TEST_CHECK(context, ring.Initialize((uint32_t)memory.size(), NULL_RESOURCE,
+			&memory[0])))
+		return;
+	const uint32_t offset = ring.AllocateVertices(7, sizeof(SpriteInstance)).Size;
+	TEST_CHECK(context, batcher.Upload(ring) && memcmp(&memory[offset],
+			batcher.GetInstances(), 3001 * sizeof(SpriteInstance)) == 0);
+}
+
+// Blends the sprites one pixel at a time in instance order; the sprites
+// are axis aligned so pixel centers never fall on an edge.
+void ReferenceRasterize(const SpriteBatcher& batcher, ColorBuffer& target,
+		const ScissorRect& clip, const ColorBuffer* const* textures) {
+	const SpriteInstance* instances = batcher.GetInstances();
+	for (uint32_t b = 0; b < batcher.GetBatchCount(); ++b) {
+		const SpriteBatch& batch = batcher.GetBatches()[b];
+		const ColorBuffer* texture = textures[batch.Texture];
+		for (uint32_t i = batch.StartInstance; i < batch.StartInstance + batch.InstanceCount;
+				++i) {
+			const SpriteInstance& sprite = instances[i];
+			for (int32_t y = clip.Top; y < clip.Bottom; ++y) {
+				for (int32_t x = clip.Left; x < clip.Right; ++x) {
+					float u = (x + 0.5f - sprite.Origin.x) / sprite.AxisX.x;
+					float v = (y + 0.5f - sprite.Origin.y) / sprite.AxisY.y;
+					if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+						continue;
+					XMCOLOR packed(sprite.Color);
+					XMVECTOR source = XMLoadColor(&packed);
+					if (texture) {
+						const XMFLOAT4& uv = sprite.TexCoords;
+						source = XMVectorMultiply(source, SampleBilinear(*texture,
+								(uv.x + (uv.z - uv.x) * u) * texture->GetWidth() - 0.5f,
+								(uv.y + (uv.w - uv.y) * v) * texture->GetHeight() - 0.5f));
+					}
+					XMVECTOR alpha = XMVectorSplatW(source);
+					source = XMVectorMultiply(source, XMVectorSetW(alpha, 1.0f));
+					XMFLOAT4& pixel = target.GetRow(y)[x];
+					XMStoreFloat4(&pixel, XMVectorMultiplyAdd(XMLoadFloat4(&pixel),
+							XMVectorSubtract(g_XMOne, alpha), source));
+				}
+			}
+		}
+	}
+}
+
+// Banded parallel rasterization blends overlapping sprites in sorted
+// order across band and scissor edges, as a plain per-pixel loop does.
+void TestRasterize(TestContext& context) {
+	TestRandom random(38);
+	ColorBuffer texture;
+	texture.Initialize(4, 4);
+	for (uint32_t y = 0; y < 4; ++y) {
+		for (uint32_t x = 0; x < 4; ++x)
+			texture.GetRow(y)[x] = XMFLOAT4(random.NextFloat(), random.NextFloat(),
+					random.NextFloat(), random.NextFloat());
+	}
+	const ColorBuffer* textures[3] = { nullptr, &texture, nullptr };
+
+	std::vector<Sprite> sprites(300);
+	for (uint32_t i = 0; i < 300; ++i) {
+		Sprite& sprite = sprites[i];
+		sprite.Texture = 1 + random.Next(2);
+		sprite.Color = random.Next() | 0x20000000;
+		sprite.Size = XMFLOAT2(2.0f + 2.0f * random.Next(20), 2.0f + 2.0f * random.Next(20));
+		sprite.Position = XMFLOAT2((float)random.Next(180) - 20.0f,
+				(float)random.Next(140) - 20.0f);
+		sprite.Pivot = random.Next(2) ? XMFLOAT2(0.5f, 0.5f) : XMFLOAT2(0.0f, 0.0f);
+		sprite.Rotation = 0.0f;
+		sprite.Depth = random.NextFloat();
+		sprite.TexCoords = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+	SpriteBatcher batcher;
+	batcher.Initialize(4);
+	batcher.SetSortMode(SPRITE_SORT_BACK_TO_FRONT);
+	Submit(batcher, sprites);
+	batcher.Build(context.Jobs);
+
+	const XMFLOAT4 background(0.1f, 0.2f, 0.3f, 0.0f);
+	const ScissorRect scissor = { 5, 3, 150, 97 };
+	ColorBuffer serial;
+	ColorBuffer parallel;
+	ColorBuffer reference;
+	serial.Initialize(160, 100);
+	parallel.Initialize(160, 100);
+	reference.Initialize(160, 100);
+	serial.Clear(background);
+	parallel.Clear(background);
+	reference.Clear(background);
+	batcher.Rasterize(serial, scissor, textures, 3, nullptr);
+	batcher.Rasterize(parallel, scissor, textures, 3, context.Jobs);
+	ReferenceRasterize(batcher, reference, scissor, textures);
+
+	bool same = true;
+	bool matches = true;
+	uint32_t touched = 0;
+	for (uint32_t y = 0; y < 100; ++y) {
+		same = same && memcmp(serial.GetRow(y), parallel.GetRow(y), 160 * sizeof(XMFLOAT4)) == 0;
+		for (uint32_t x = 0; x < 160; ++x) {
+			const XMFLOAT4& a = serial.GetRow(y)[x];
+			const XMFLOAT4& b = reference.GetRow(y)[x];
+			matches = matches && fabsf(a.x - b.x) < 1e-4f && fabsf(a.y - b.y) < 1e-4f &&
+					fabsf(a.z - b.z) < 1e-4f && fabsf(a.w - b.w) < 1e-4f;
+			touched += a.w != 0.0f;
+		}
+	}
+	TEST_CHECK(context, same && matches && touched > 160 * 100 / 2);
+}
+
+} // namespace
+
+void RunSpriteBatcherTests(TestContext& context) {
+	TestBuild(context);
+	TestRasterize(context);
+}
+
+} // namespace Zeus
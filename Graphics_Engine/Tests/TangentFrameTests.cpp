@@ -0,0 +1,190 @@
+/*
+ * TangentFrameTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../TangentFrame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const float PI = 3.14159265f;
+
+float Dot(const XMFLOAT3& a, const XMFLOAT3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+void GetTangentSource(const TestMesh& mesh, TangentSource& source) {
+	memset(&source, 0, sizeof(source));
+	source.Indices = &mesh.Indices[0];
+	source.IndexCount = mesh.GetIndexCount();
+	source.Positions = &mesh.Vertices[0].Position;
+	source.PositionStride = sizeof(TestVertex);
+	source.VertexCount = mesh.GetVertexCount();
+	source.Normals = &mesh.Vertices[0].Normal;
+	source.NormalStride = sizeof(TestVertex);
+	source.TexCoords = &mesh.Vertices[0].TexCoord;
+	source.TexCoordStride = sizeof(TestVertex);
+}
+
+bool SameVector(const XMFLOAT3& a, const XMFLOAT3& b) {
+	return memcmp(&a, &b, sizeof(XMFLOAT3)) == 0;
+}
+
+void TestTangentFrames(TestContext& context) {
+	const uint32_t rings = 100;
+	const uint32_t segments = 200;
+	TestMesh mesh;
+	BuildSphere(rings, segments, 0.0f, mesh);
+	TangentSource source;
+	GetTangentSource(mesh, source);
+	TangentSettings settings;
+	TangentFrameResult serial;
+	TangentFrameResult result;
+	TEST_CHECK(context, ComputeTangentFrame(source, settings, serial, nullptr));
+	TEST_CHECK(context, ComputeTangentFrame(source, settings, result, context.Jobs));
+	const uint32_t outputCount = (uint32_t)result.VertexRemap.size();
+	TEST_CHECK(context, serial.Indices == result.Indices &&
+			serial.VertexRemap == result.VertexRemap && serial.Tangents.size() == outputCount &&
+			result.Tangents.size() == outputCount &&
+			memcmp(&serial.Tangents[0], &result.Tangents[0], outputCount * 12) == 0 &&
+			memcmp(&serial.Binormals[0], &result.Binormals[0], outputCount * 12) == 0);
+	printf("Tangent frames: %u vertices to %u\n", source.VertexCount, outputCount);
+
+	// Orthonormal frames, the tangent running along u away from the poles.
+	float worstOrthogonality = 0.0f;
+	float worstDirection = 0.0f;
+	for (uint32_t v = 0; v < outputCount; ++v) {
+		const XMFLOAT3& normal = result.Normals[v];
+		const XMFLOAT3& tangent = result.Tangents[v];
+		const XMFLOAT3& binormal = result.Binormals[v];
+		worstOrthogonality = std::max(worstOrthogonality,
+				fabsf(Dot(normal, tangent)) + fabsf(Dot(tangent, binormal)) +
+				fabsf(Dot(tangent, tangent) - 1.0f));
+		uint32_t ring = result.VertexRemap[v] / (segments + 1);
+		if (ring == 0 || ring == rings)
+			continue;
+		float phi = 2.0f * PI * (result.VertexRemap[v] % (segments + 1)) / segments;
+		XMFLOAT3 expected(-sinf(phi), 0.0f, cosf(phi));
+		worstDirection = std::max(worstDirection, 1.0f - Dot(tangent, expected));
+	}
+	TEST_CHECK(context, worstOrthogonality < 1e-4f);
+	TEST_CHECK(context, worstDirection < 1e-3f);
+
+	// A cube over eight shared corners splits into its 24 face vertices.
+	XMFLOAT3 positions[8];
+	XMFLOAT2 texCoords[8];
+	for (uint32_t i = 0; i < 8; ++i) {
+		positions[i] = XMFLOAT3((float)(i & 1), (float)(i >> 1 & 1), (float)(i >> 2 & 1));
+		texCoords[i] = XMFLOAT2((float)(i & 1),
+				(float)(i >> 1 & 1) * 0.7f + (float)(i >> 2) * 0.3f);
+	}
+	const uint32_t quads[24] = {
+		0, 2, 3, 1, 4, 5, 7, 6, 0, 1, 5, 4, 2, 6, 7, 3, 0, 4, 6, 2, 1, 3, 7, 5
+	};
+	uint32_t cubeIndices[36];
+	for (uint32_t f = 0; f < 6; ++f) {
+		const uint32_t* quad = &quads[f * 4];
+		const uint32_t corners[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+		memcpy(&cubeIndices[f * 6], corners, sizeof(corners));
+	}
+	TangentSource cube;
+	memset(&cube, 0, sizeof(cube));
+	cube.Indices = cubeIndices;
+	cube.IndexCount = 36;
+	cube.Positions = positions;
+	cube.VertexCount = 8;
+	cube.TexCoords = texCoords;
+	settings.CalculateNormals = true;
+	settings.SingularPointThreshold = -1.0f;
+	TEST_CHECK(context, ComputeTangentFrame(cube, settings, result, nullptr));
+	TEST_CHECK(context, result.VertexRemap.size() == 24);
+	const XMFLOAT3 front = result.Normals[result.Indices[0]];
+	const XMFLOAT3 back = result.Normals[result.Indices[6]];
+	TEST_CHECK(context, front.x == 0.0f && front.y == 0.0f && front.z == -1.0f);
+	TEST_CHECK(context, back.x == 0.0f && back.y == 0.0f && back.z == 1.0f);
+}
+
+// Shuffling the triangles and rotating their corners leaves every output
+// vertex, its number and its frame bit for bit the same. The sphere shares
+// its poles and seam, which then split, and with calculated normals a
+// crease splits too.
+void TestTriangleOrder(TestContext& context) {
+	const uint32_t rings = 40;
+	const uint32_t segments = 80;
+	TestMesh mesh;
+	BuildSphere(rings, segments, 0.0f, mesh);
+	for (uint32_t i = 0; i < mesh.GetIndexCount(); ++i) {
+		uint32_t ring = mesh.Indices[i] / (segments + 1);
+		uint32_t segment = mesh.Indices[i] % (segments + 1);
+		if (ring == 0 || ring == rings)
+			segment = 0;
+		mesh.Indices[i] = ring * (segments + 1) + segment % segments;
+	}
+	// Pulls the lower half in, so the equator creases.
+	for (uint32_t v = (rings / 2 + 1) * (segments + 1); v < mesh.GetVertexCount(); ++v) {
+		XMFLOAT3& position = mesh.Vertices[v].Position;
+		position = XMFLOAT3(position.x * 0.5f, position.y * 2.0f, position.z * 0.5f);
+	}
+	const uint32_t triangleCount = mesh.GetTriangleCount();
+	std::vector<uint32_t> sources(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+		sources[t] = t;
+	TestRandom random(3);
+	for (uint32_t t = triangleCount - 1; t > 0; --t)
+		std::swap(sources[t], sources[random.Next(t + 1)]);
+	std::vector<uint32_t> rotations(triangleCount);
+	TestMesh shuffled(mesh);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		rotations[t] = random.Next(3);
+		for (uint32_t k = 0; k < 3; ++k)
+			shuffled.Indices[t * 3 + k] =
+					mesh.Indices[sources[t] * 3 + (k + rotations[t]) % 3];
+	}
+
+	bool same = true;
+	size_t outputCounts[2];
+	for (uint32_t pass = 0; pass < 2; ++pass) {
+		TangentSettings settings;
+		settings.CalculateNormals = pass == 1;
+		settings.NormalEdgeThreshold = 0.9f;
+		TangentSource source;
+		TangentFrameResult original;
+		TangentFrameResult result;
+		GetTangentSource(mesh, source);
+		TEST_CHECK(context, ComputeTangentFrame(source, settings, original, context.Jobs));
+		GetTangentSource(shuffled, source);
+		TEST_CHECK(context, ComputeTangentFrame(source, settings, result, context.Jobs));
+		same = same && result.VertexRemap == original.VertexRemap;
+		for (uint32_t t = 0; same && t < triangleCount; ++t) {
+			for (uint32_t k = 0; same && k < 3; ++k) {
+				uint32_t o = original.Indices[sources[t] * 3 + (k + rotations[t]) % 3];
+				uint32_t v = result.Indices[t * 3 + k];
+				same = o == v && SameVector(original.Normals[o], result.Normals[v]) &&
+						SameVector(original.Tangents[o], result.Tangents[v]) &&
+						SameVector(original.Binormals[o], result.Binormals[v]);
+			}
+		}
+		outputCounts[pass] = original.VertexRemap.size();
+	}
+	TEST_CHECK(context, same);
+	// The pole and seam splits, then the crease, must have happened.
+	TEST_CHECK(context, outputCounts[0] > mesh.GetVertexCount() &&
+			outputCounts[1] >= outputCounts[0] + segments);
+}
+
+} // namespace
+
+void RunTangentFrameTests(TestContext& context) {
+	TestTangentFrames(context);
+	TestTriangleOrder(context);
+}
+
+} // namespace Zeus
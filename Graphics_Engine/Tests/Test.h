@@ -0,0 +1,102 @@
+/*
+ * Test.h
+ *
+ * Checks and benchmarks run by the driver in main.cpp. A failed check
+ * prints its expression in the compiler's file(line) format and counts
+ * against the run, and the driver returns the number of failures, so a
+ * nonzero exit code fails whatever step runs it.
+ *
+ * Suites seed their own TestRandom, so inputs and the figures they print
+ * are the same on every machine and toolchain. Benchmarks print their
+ * timings. Times are only checked against a baseline measured in the same
+ * run, never against a fixed budget.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <cstdint>
+#include <cstdio>
+
+namespace Zeus {
+
+class JobSystem;
+
+struct TestContext {
+	// Suites compare a serial run against one on these jobs.
+	JobSystem* Jobs;
+	uint32_t Checks;
+	uint32_t Failures;
+};
+
+inline bool Check(TestContext& context, bool passed, const char* expression, const char* file,
+		int line) {
+	++context.Checks;
+	if (!passed) {
+		++context.Failures;
+		printf("%s(%d): check failed: %s\n", file, line, expression);
+	}
+	return passed;
+}
+
+#define TEST_CHECK(context, expression) \
+		::Zeus::Check(context, (expression) ? true : false, #expression, __FILE__, __LINE__)
+
+// xorshift32; unlike rand() the sequence is the same everywhere.
+class TestRandom {
+public:
+	explicit TestRandom(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+	uint32_t Next() {
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	uint32_t Next(uint32_t bound) { return Next() % bound; }
+
+	// In [0, 1).
+	float NextFloat() { return (float)(Next() >> 8) * (1.0f / 16777216.0f); }
+
+	template <typename T>
+	void Shuffle(T* items, uint32_t count) {
+		for (uint32_t i = count; i > 1; --i) {
+			uint32_t j = Next(i);
+			T item = items[i - 1];
+			items[i - 1] = items[j];
+			items[j] = item;
+		}
+	}
+
+private:
+	uint32_t m_state;
+};
+
+void RunCascadedShadowMapsTests(TestContext& context);
+void RunClusteredLightingTests(TestContext& context);
+void RunCommandListTests(TestContext& context);
+void RunComputeTests(TestContext& context);
+void RunDrawQueueTests(TestContext& context);
+void RunGlyphCacheTests(TestContext& context);
+void RunHdrFileTests(TestContext& context);
+void RunInstanceBatcherTests(TestContext& context);
+void RunLineRendererTests(TestContext& context);
+void RunMeshOptimizerTests(TestContext& context);
+void RunMeshSimplifierTests(TestContext& context);
+void RunMeshTopologyTests(TestContext& context);
+void RunMeshletTests(TestContext& context);
+void RunPathGeometryTests(TestContext& context);
+void RunPipelineStateCacheTests(TestContext& context);
+void RunPostProcessTests(TestContext& context);
+void RunProgressiveMeshTests(TestContext& context);
+void RunRenderGraphTests(TestContext& context);
+void RunRingAllocatorTests(TestContext& context);
+void RunSpriteBatcherTests(TestContext& context);
+void RunTangentFrameTests(TestContext& context);
+void RunTextLayoutTests(TestContext& context);
+void RunVertexWelderTests(TestContext& context);
+
+} // namespace Zeus
+
+#endif /* TEST_H_ */
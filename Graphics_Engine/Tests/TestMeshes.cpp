@@ -0,0 +1,127 @@
+/*
+ * TestMeshes.cpp
+ *
+ */
+
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const float PI = 3.14159265f;
+
+void AddQuads(uint32_t columns, uint32_t rows, TestMesh& mesh) {
+	mesh.Indices.reserve((size_t)columns * rows * 6);
+	for (uint32_t y = 0; y < rows; ++y) {
+		for (uint32_t x = 0; x < columns; ++x) {
+			uint32_t a = y * (columns + 1) + x;
+			uint32_t b = a + 1;
+			uint32_t c = a + columns + 1;
+			uint32_t d = c + 1;
+			uint32_t quad[6] = { a, b, c, b, d, c };
+			mesh.Indices.insert(mesh.Indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+} // namespace
+
+void BuildGrid(uint32_t columns, uint32_t rows, TestMesh& mesh) {
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+	mesh.Vertices.reserve((size_t)(columns + 1) * (rows + 1));
+	for (uint32_t y = 0; y <= rows; ++y) {
+		for (uint32_t x = 0; x <= columns; ++x) {
+			TestVertex vertex;
+			vertex.Position = XMFLOAT3((float)x, (float)y, 0.0f);
+			vertex.Normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
+			vertex.TexCoord = XMFLOAT2((float)x / columns, (float)y / rows);
+			vertex.Id = (uint32_t)mesh.Vertices.size();
+			mesh.Vertices.push_back(vertex);
+		}
+	}
+	AddQuads(columns, rows, mesh);
+}
+
+void BuildSphere(uint32_t rings, uint32_t segments, float bump, TestMesh& mesh) {
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+	mesh.Vertices.reserve((size_t)(rings + 1) * (segments + 1));
+	for (uint32_t i = 0; i <= rings; ++i) {
+		for (uint32_t j = 0; j <= segments; ++j) {
+			float theta = PI * i / rings;
+			float phi = 2.0f * PI * (j % segments) / segments;
+			// sinf(PI) is not quite 0, and 0 times a negative cosine is -0;
+			// keep each pole row on one point, bit for bit.
+			bool pole = i == 0 || i == rings;
+			float sine = pole ? 0.0f : sinf(theta);
+			XMFLOAT3 normal(pole ? 0.0f : sine * cosf(phi), cosf(theta),
+					pole ? 0.0f : sine * sinf(phi));
+			float radius = 1.0f + bump * sinf(5.0f * theta) * cosf(3.0f * phi);
+			TestVertex vertex;
+			vertex.Position = XMFLOAT3(normal.x * radius, normal.y * radius, normal.z * radius);
+			vertex.Normal = normal;
+			vertex.TexCoord = XMFLOAT2((float)j / segments, (float)i / rings);
+			vertex.Id = (uint32_t)mesh.Vertices.size();
+			mesh.Vertices.push_back(vertex);
+		}
+	}
+	AddQuads(segments, rings, mesh);
+}
+
+void ShuffleTriangles(TestMesh& mesh, TestRandom& random) {
+	uint32_t triangleCount = mesh.GetTriangleCount();
+	std::vector<uint32_t> order(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+		order[t] = t;
+	random.Shuffle(&order[0], triangleCount);
+	std::vector<uint32_t> indices(mesh.Indices.size());
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		for (uint32_t k = 0; k < 3; ++k)
+			indices[t * 3 + k] = mesh.Indices[order[t] * 3 + k];
+	}
+	mesh.Indices.swap(indices);
+}
+
+void GetTriangleKeys(const uint32_t* indices, uint32_t indexCount, const uint32_t* ids,
+		std::vector<TriangleKey>& keys) {
+	keys.resize(indexCount / 3);
+	for (size_t t = 0; t < keys.size(); ++t) {
+		uint32_t v[3];
+		for (uint32_t k = 0; k < 3; ++k)
+			v[k] = ids ? ids[indices[t * 3 + k]] : indices[t * 3 + k];
+		uint32_t first = v[1] < v[0] ? (v[2] < v[1] ? 2 : 1) : (v[2] < v[0] ? 2 : 0);
+		for (uint32_t k = 0; k < 3; ++k)
+			keys[t].V[k] = v[(first + k) % 3];
+	}
+	std::sort(keys.begin(), keys.end());
+}
+
+void GetSimplifySource(const TestMesh& mesh, SimplifySource& source) {
+	memset(&source, 0, sizeof(source));
+	source.Indices = &mesh.Indices[0];
+	source.IndexCount = mesh.GetIndexCount();
+	source.Positions = &mesh.Vertices[0].Position;
+	source.PositionStride = sizeof(TestVertex);
+	source.VertexCount = mesh.GetVertexCount();
+	source.Normals = &mesh.Vertices[0].Normal;
+	source.NormalStride = sizeof(TestVertex);
+	source.TexCoords = &mesh.Vertices[0].TexCoord;
+	source.TexCoordStride = sizeof(TestVertex);
+}
+
+void GetVertexElements(VertexElement elements[3]) {
+	VertexElement position = { 0, 0, FORMAT_R32G32B32_FLOAT, VERTEX_USAGE_POSITION, 0 };
+	VertexElement normal = { 0, 12, FORMAT_R32G32B32_FLOAT, VERTEX_USAGE_NORMAL, 0 };
+	VertexElement texCoord = { 0, 24, FORMAT_R32G32_FLOAT, VERTEX_USAGE_TEXCOORD, 0 };
+	elements[0] = position;
+	elements[1] = normal;
+	elements[2] = texCoord;
+}
+
+} // namespace Zeus
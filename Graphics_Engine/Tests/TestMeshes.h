@@ -0,0 +1,86 @@
+/*
+ * TestMeshes.h
+ *
+ * Generated meshes for the mesh processing tests, and a triangle list
+ * comparison that ignores triangle order.
+ *
+ * Triangles are wound so cross(p1 - p0, p2 - p0) points out of the
+ * surface, which faces a D3D camera in front of it.
+ */
+
+#ifndef TESTMESHES_H_
+#define TESTMESHES_H_
+
+#include "Test.h"
+#include "../MeshOptimizer.h"
+#include "../MeshSimplifier.h"
+
+#include <windows.h>
+#include <xnamath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+struct TestVertex {
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+	XMFLOAT2 TexCoord;
+	// Index the vertex was generated at, to follow it through reordering.
+	uint32_t Id;
+};
+
+struct TestMesh {
+	std::vector<TestVertex> Vertices;
+	std::vector<uint32_t> Indices;
+
+	uint32_t GetVertexCount() const { return (uint32_t)Vertices.size(); }
+	uint32_t GetIndexCount() const { return (uint32_t)Indices.size(); }
+	uint32_t GetTriangleCount() const { return (uint32_t)(Indices.size() / 3); }
+};
+
+// columns x rows quads of unit size in the XY plane, facing +z, with
+// texture coordinates running from 0 to 1 across the grid.
+void BuildGrid(uint32_t columns, uint32_t rows, TestMesh& mesh);
+
+// Unit sphere of rings x segments quads, its radius modulated by bump.
+// Like most exported spheres it has a column of seam vertices where u
+// wraps from 1 to 0 and a row of vertices on each pole, so the triangles
+// at the poles have no area.
+void BuildSphere(uint32_t rings, uint32_t segments, float bump, TestMesh& mesh);
+
+// Shuffles the triangle order, keeping every triangle's winding.
+void ShuffleTriangles(TestMesh& mesh, TestRandom& random);
+
+struct TriangleKey {
+	uint32_t V[3];
+
+	bool operator<(const TriangleKey& other) const {
+		if (V[0] != other.V[0])
+			return V[0] < other.V[0];
+		if (V[1] != other.V[1])
+			return V[1] < other.V[1];
+		return V[2] < other.V[2];
+	}
+	bool operator==(const TriangleKey& other) const {
+		return V[0] == other.V[0] && V[1] == other.V[1] && V[2] == other.V[2];
+	}
+};
+
+// Every triangle rotated to start at its lowest vertex, sorted, so lists
+// with the same triangles and windings in any order compare equal. ids,
+// when given, names every vertex, as TestVertex::Id does after vertices
+// have been reordered.
+void GetTriangleKeys(const uint32_t* indices, uint32_t indexCount, const uint32_t* ids,
+		std::vector<TriangleKey>& keys);
+
+// Simplifier input over the positions, normals and texture coordinates.
+void GetSimplifySource(const TestMesh& mesh, SimplifySource& source);
+
+// Position, normal and texture coordinate elements of a TestVertex.
+void GetVertexElements(VertexElement elements[3]);
+
+} // namespace Zeus
+
+#endif /* TESTMESHES_H_ */
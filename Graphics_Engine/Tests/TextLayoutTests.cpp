@@ -0,0 +1,200 @@
+/*
+ * TextLayoutTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "../TextLayout.h"
+
+#include <cstring>
+#include <string>
+
+namespace Zeus {
+
+namespace {
+
+// Advances vary by glyph and some pairs kern, so a line shaped from the
+// wrong glyph or after the wrong neighbour lands somewhere else.
+class SpacingSource : public GlyphSource {
+public:
+	FontMetrics GetMetrics() const {
+		FontMetrics metrics = { 0.8f, 0.2f, 0.1f };
+		return metrics;
+	}
+	uint32_t GetGlyphIndex(uint32_t codePoint) const { return codePoint; }
+	float GetAdvance(uint32_t glyph) const { return 0.3f + (glyph % 7) * 0.08f; }
+	bool GetOutline(uint32_t glyph, GlyphOutline& outline) const {
+		(void)glyph;
+		(void)outline;
+		return true;
+	}
+	float GetKerning(uint32_t left, uint32_t right) const {
+		return (left + right) % 5 == 0 ? -0.05f : 0.0f;
+	}
+};
+
+// Words of ASCII and multibyte letters, with single and double spaces,
+// tabs, hard breaks and now and then a word too long for narrow lines.
+std::string MakeWord(TestRandom& random) {
+	const char* const letters[8] = { "A", "V", "e", "i", "m", "W", "\xc3\xa9", "\xe2\x82\xac" };
+	std::string word;
+	uint32_t length = random.Next(16) == 0 ? 20 : 1 + random.Next(8);
+	for (uint32_t i = 0; i < length; ++i)
+		word += letters[random.Next(8)];
+	return word;
+}
+
+std::string MakeSeparator(TestRandom& random) {
+	const char* const separators[6] = { " ", " ", " ", "  ", "\t", "\r\n" };
+	return random.Next(12) == 0 ? "\n" : separators[random.Next(6)];
+}
+
+// Moves a byte offset forward off UTF-8 continuation bytes.
+uint32_t ToBoundary(const std::string& text, uint32_t position) {
+	while (position < text.size() && (text[position] & 0xc0) == 0x80)
+		++position;
+	return position;
+}
+
+void Edit(TestRandom& random, std::string& text) {
+	uint32_t position = ToBoundary(text, random.Next((uint32_t)text.size() + 1));
+	switch (random.Next(4)) {
+	case 0:
+		text.insert(position, MakeWord(random));
+		break;
+	case 1:
+		text.insert(position, MakeSeparator(random));
+		break;
+	case 2: {
+		uint32_t end = ToBoundary(text, position + 1 + random.Next(8));
+		text.erase(position, (end < text.size() ? end : text.size()) - position);
+		break;
+	}
+	default:
+		text.insert(position, 1, "AVeim W"[random.Next(7)]);
+		break;
+	}
+}
+
+bool SameLayout(const TextLayout& a, const TextLayout& b) {
+	return a.GetGlyphCount() == b.GetGlyphCount() && a.GetLineCount() == b.GetLineCount()
+			&& (a.GetGlyphCount() == 0 || memcmp(a.GetGlyphs(), b.GetGlyphs(),
+			a.GetGlyphCount() * sizeof(TextGlyph)) == 0)
+			&& (a.GetLineCount() == 0 || memcmp(a.GetLines(), b.GetLines(),
+			a.GetLineCount() * sizeof(TextLine)) == 0)
+			&& memcmp(&a.GetMetrics(), &b.GetMetrics(), sizeof(TextMetrics)) == 0;
+}
+
+// A layout updated edit by edit matches one laid out from scratch byte
+// for byte, under every alignment and with wrapping off, wide, narrow and
+// narrower than a word.
+void TestIncremental(TestContext& context) {
+	SpacingSource source;
+	GlyphCache glyphs;
+	glyphs.Initialize(GlyphCacheSettings());
+	glyphs.AddFont(&source, MsdfSettings());
+
+	struct Setting {
+		TextAlignment Alignment;
+		WordWrapping Wrapping;
+		float MaxWidth;
+	};
+	const Setting settings[6] = {
+		{ TEXT_ALIGNMENT_LEADING, WORD_WRAPPING_WRAP, 150.0f },
+		{ TEXT_ALIGNMENT_TRAILING, WORD_WRAPPING_WRAP, 80.0f },
+		{ TEXT_ALIGNMENT_CENTER, WORD_WRAPPING_WRAP, 400.0f },
+		{ TEXT_ALIGNMENT_LEADING, WORD_WRAPPING_NO_WRAP, 150.0f },
+		{ TEXT_ALIGNMENT_CENTER, WORD_WRAPPING_WRAP, 0.0f },
+		{ TEXT_ALIGNMENT_TRAILING, WORD_WRAPPING_WRAP, 37.0f }
+	};
+	TestRandom random(40);
+	bool same = true;
+	uint64_t shaped = 0;
+	uint64_t total = 0;
+	for (uint32_t s = 0; s < 6; ++s) {
+		TextFormat format;
+		format.Alignment = settings[s].Alignment;
+		format.Wrapping = settings[s].Wrapping;
+		format.LineSpacing = 1.25f;
+		std::string text;
+		while (text.size() < 600)
+			text += MakeWord(random) + MakeSeparator(random);
+		TextLayout layout;
+		layout.Update(glyphs, text.c_str(), format, settings[s].MaxWidth);
+		for (uint32_t i = 0; i < 200; ++i) {
+			Edit(random, text);
+			layout.Update(glyphs, text.c_str(), format, settings[s].MaxWidth);
+			TextLayout fresh;
+			fresh.Update(glyphs, text.c_str(), format, settings[s].MaxWidth);
+			same = same && layout.GetText() == text && SameLayout(layout, fresh);
+			shaped += layout.GetShapedGlyphs();
+			total += fresh.GetShapedGlyphs();
+		}
+	}
+	TEST_CHECK(context, same && shaped < total * 3 / 4);
+
+	// Typing at the end shapes no more than the last two lines, and
+	// deleting everything leaves no lines to draw.
+	TextFormat format;
+	std::string text;
+	TextLayout layout;
+	bool local = true;
+	for (uint32_t i = 0; i < 400; ++i) {
+		text += i % 6 == 5 ? ' ' : "AVeimW"[i % 6];
+		const uint32_t lines = layout.GetLineCount();
+		const uint32_t tail = lines < 2 ? 0 : layout.GetLines()[lines - 2].FirstGlyph;
+		layout.Update(glyphs, text.c_str(), format, 120.0f);
+		local = local && layout.GetShapedGlyphs() <= layout.GetGlyphCount() - tail;
+	}
+	TextLayout fresh;
+	fresh.Update(glyphs, text.c_str(), format, 120.0f);
+	TEST_CHECK(context, local && layout.GetLineCount() > 10 && SameLayout(layout, fresh));
+	layout.Update(glyphs, "", format, 120.0f);
+	TEST_CHECK(context, layout.GetGlyphCount() == 0 && layout.GetLineCount() == 1);
+}
+
+// Resubmitted text hits; an element whose text changed takes the
+// incremental path and lays out as a new request would.
+void TestCache(TestContext& context) {
+	SpacingSource source;
+	GlyphCache glyphs;
+	glyphs.Initialize(GlyphCacheSettings());
+	glyphs.AddFont(&source, MsdfSettings());
+	TestRandom random(41);
+	std::string texts[2];
+	while (texts[0].size() < 300)
+		texts[0] += MakeWord(random) + MakeSeparator(random);
+	texts[1] = texts[0];
+	texts[1].insert(ToBoundary(texts[1], 250), "AVAVAV ");
+
+	TextLayoutCache cache;
+	TextRequest request;
+	request.Id = 7;
+	request.Text = texts[0].c_str();
+	request.MaxWidth = 100.0f;
+	const TextLayout* first = nullptr;
+	cache.Layout(glyphs, &request, 1, &first, context.Jobs);
+	cache.BeginFrame();
+	const TextLayout* hit = nullptr;
+	cache.Layout(glyphs, &request, 1, &hit, context.Jobs);
+	TEST_CHECK(context, hit == first && cache.GetStats().Hits == 1);
+
+	cache.BeginFrame();
+	request.Text = texts[1].c_str();
+	const TextLayout* updated = nullptr;
+	cache.Layout(glyphs, &request, 1, &updated, context.Jobs);
+	TextLayout fresh;
+	fresh.Update(glyphs, texts[1].c_str(), request.Format, request.MaxWidth);
+	TEST_CHECK(context, updated == first && cache.GetStats().Updated == 1 &&
+			cache.GetStats().ShapedGlyphs < fresh.GetShapedGlyphs() / 2 &&
+			SameLayout(*updated, fresh));
+}
+
+} // namespace
+
+void RunTextLayoutTests(TestContext& context) {
+	TestIncremental(context);
+	TestCache(context);
+}
+
+} // namespace Zeus
@@ -0,0 +1,63 @@
+/*
+ * VertexWelderTests.cpp
+ *
+ */
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../VertexWelder.h"
+
+namespace Zeus {
+
+namespace {
+
+// The sphere's seam column repeats the first column with u = 1, and every
+// pole row shares one point: point representatives join them, the weld
+// keeps them apart unless only positions count.
+void TestSeamWeld(TestContext& context) {
+	const uint32_t rings = 100;
+	const uint32_t segments = 200;
+	TestMesh mesh;
+	BuildSphere(rings, segments, 0.1f, mesh);
+	const uint32_t vertexCount = mesh.GetVertexCount();
+	// Nudge the seam within the epsilon, as exporters do.
+	for (uint32_t i = 1; i < rings; ++i)
+		mesh.Vertices[i * (segments + 1) + segments].Position.x += 5e-7f;
+
+	VertexStream stream = { &mesh.Vertices[0], sizeof(TestVertex) };
+	VertexElement elements[3];
+	GetVertexElements(elements);
+	WeldEpsilons epsilons;
+	WeldResult serial;
+	WeldResult result;
+	TEST_CHECK(context, WeldVertices(&stream, elements, 3, vertexCount, epsilons, serial,
+			nullptr));
+	TEST_CHECK(context, WeldVertices(&stream, elements, 3, vertexCount, epsilons, result,
+			context.Jobs));
+	TEST_CHECK(context, serial.PointReps == result.PointReps && serial.Remap == result.Remap);
+
+	bool repsJoined = true;
+	for (uint32_t i = 0; i <= rings; ++i) {
+		for (uint32_t j = 0; j <= segments; ++j) {
+			uint32_t expected = i == 0 || i == rings ? i * (segments + 1) :
+					i * (segments + 1) + j % segments;
+			repsJoined = repsJoined && result.PointReps[i * (segments + 1) + j] == expected;
+		}
+	}
+	TEST_CHECK(context, repsJoined);
+	TEST_CHECK(context, result.VertexCount == vertexCount);
+
+	epsilons.PositionsOnly = true;
+	TEST_CHECK(context, WeldVertices(&stream, elements, 3, vertexCount, epsilons, result,
+			context.Jobs));
+	TEST_CHECK(context, result.VertexCount == (rings - 1) * segments + 2);
+	printf("Welder: %u vertices at %u points\n", vertexCount, result.VertexCount);
+}
+
+} // namespace
+
+void RunVertexWelderTests(TestContext& context) {
+	TestSeamWeld(context);
+}
+
+} // namespace Zeus
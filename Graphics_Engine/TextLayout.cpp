@@ -0,0 +1,410 @@
+/*
+ * TextLayout.cpp
+ *
+ */
+
+#include "TextLayout.h"
+#include "Hash.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NO_GLYPH = 0xffffffff;
+const uint32_t LAYOUT_GRAIN = 4;
+
+bool IsSpace(char c) {
+	return c == ' ' || c == '\t';
+}
+
+} // namespace
+
+TextLayout::TextLayout() : m_maxWidth(0.0f), m_shapedGlyphs(0) {
+	memset(&m_metrics, 0, sizeof(m_metrics));
+}
+
+void TextLayout::Update(const GlyphCache& glyphs, const char* text, const TextFormat& format,
+		float maxWidth) {
+	uint32_t restart = 0;
+	if (!m_lines.empty() && format == m_format && maxWidth == m_maxWidth) {
+		uint32_t prefix = 0;
+		while (prefix < m_text.size() && m_text[prefix] == text[prefix])
+			++prefix;
+		if (prefix == m_text.size() && text[prefix] == '\0') {
+			m_shapedGlyphs = 0;
+			return;
+		}
+		// The line holding the first change, or the one before it if that
+		// could now pull in a word.
+		uint32_t line = 0;
+		while (line + 1 < m_lines.size()
+				&& m_lines[line].TextPosition + m_lines[line].TextLength <= prefix)
+			++line;
+		restart = line;
+		if (line > 0) {
+			const TextLine& previous = m_lines[line - 1];
+			if (previous.GlyphCount == 0 || m_glyphs[previous.FirstGlyph
+					+ previous.GlyphCount - 1].Glyph != GLYPH_LINE_BREAK)
+				restart = line - 1;
+		}
+	}
+
+	const uint32_t firstGlyph = restart > 0 ? m_lines[restart].FirstGlyph : 0;
+	const uint32_t textPosition = restart > 0 ? m_lines[restart].TextPosition : 0;
+	m_text = text;
+	m_format = format;
+	m_maxWidth = maxWidth;
+	m_lines.resize(restart);
+	m_glyphs.resize(firstGlyph);
+	m_keys.resize(firstGlyph);
+	Shape(glyphs, textPosition);
+	m_shapedGlyphs = (uint32_t)m_glyphs.size() - firstGlyph;
+	// A kept line runs up to the next glyph, which a '\r' inserted after it
+	// moves.
+	if (restart > 0) {
+		TextLine& kept = m_lines[restart - 1];
+		kept.TextLength = (firstGlyph < m_glyphs.size() ? m_glyphs[firstGlyph].TextPosition
+				: (uint32_t)m_text.size()) - kept.TextPosition;
+	}
+	BreakLines(glyphs, firstGlyph);
+	Align();
+}
+
+void TextLayout::Shape(const GlyphCache& glyphs, uint32_t textPosition) {
+	const char* begin = m_text.c_str();
+	const char* text = begin + textPosition;
+	while (*text) {
+		TextGlyph glyph;
+		glyph.TextPosition = (uint32_t)(text - begin);
+		uint32_t codePoint = DecodeUtf8(text);
+		if (codePoint == '\r')
+			continue;
+		glyph.X = 0.0f;
+		if (codePoint == '\n') {
+			glyph.Glyph = GLYPH_LINE_BREAK;
+			glyph.Advance = 0.0f;
+		} else {
+			glyph.Glyph = glyphs.GetGlyphIndex(m_format.Font, codePoint);
+			glyph.Advance = glyphs.GetAdvance(m_format.Font, glyph.Glyph) * m_format.Size;
+		}
+		m_glyphs.push_back(glyph);
+		m_keys.push_back(GlyphCache::MakeKey(m_format.Font, glyph.Glyph));
+	}
+}
+
+// Greedy breaking: a line takes glyphs until one that is not whitespace
+// would cross the width, then breaks after the last run of spaces, or
+// before that glyph if the line has no spaces. Trailing spaces hang past
+// the width.
+void TextLayout::BreakLines(const GlyphCache& glyphs, uint32_t firstGlyph) {
+	const FontMetrics& metrics = glyphs.GetMetrics(m_format.Font);
+	const float size = m_format.Size;
+	const float lineHeight = (metrics.Ascent + metrics.Descent + metrics.LineGap) * size
+			* m_format.LineSpacing;
+	const bool wrap = m_format.Wrapping == WORD_WRAPPING_WRAP && m_maxWidth > 0.0f;
+	const uint32_t count = (uint32_t)m_glyphs.size();
+
+	uint32_t start = firstGlyph;
+	for (;;) {
+		uint32_t end = count;
+		uint32_t breakAt = NO_GLYPH;
+		uint32_t previous = NO_GLYPH;
+		bool hardBreak = false;
+		float x = 0.0f;
+		for (uint32_t i = start; i < count; ++i) {
+			TextGlyph& glyph = m_glyphs[i];
+			if (glyph.Glyph == GLYPH_LINE_BREAK) {
+				glyph.X = x;
+				end = i + 1;
+				hardBreak = true;
+				break;
+			}
+			const bool space = IsSpace(m_text[glyph.TextPosition]);
+			if (!space && i > start && IsSpace(m_text[m_glyphs[i - 1].TextPosition]))
+				breakAt = i;
+			float kerning = previous != NO_GLYPH
+					? glyphs.GetKerning(m_format.Font, previous, glyph.Glyph) * size : 0.0f;
+			if (wrap && !space && i > start && x + kerning + glyph.Advance > m_maxWidth) {
+				end = breakAt != NO_GLYPH ? breakAt : i;
+				break;
+			}
+			x += kerning;
+			glyph.X = x;
+			x += glyph.Advance;
+			previous = glyph.Glyph;
+		}
+
+		TextLine line;
+		line.FirstGlyph = start;
+		line.GlyphCount = end - start;
+		line.TextPosition = start < count ? m_glyphs[start].TextPosition : (uint32_t)m_text.size();
+		line.TextLength = (end < count ? m_glyphs[end].TextPosition : (uint32_t)m_text.size())
+				- line.TextPosition;
+		line.X = 0.0f;
+		line.Baseline = metrics.Ascent * size + m_lines.size() * lineHeight;
+		line.Width = 0.0f;
+		for (uint32_t i = end; i-- > start;) {
+			const TextGlyph& glyph = m_glyphs[i];
+			if (glyph.Glyph != GLYPH_LINE_BREAK && !IsSpace(m_text[glyph.TextPosition])) {
+				line.Width = glyph.X + glyph.Advance;
+				break;
+			}
+		}
+		m_lines.push_back(line);
+
+		start = end;
+		if (start < count)
+			continue;
+		// Text ending in a line break has an empty last line.
+		if (hardBreak) {
+			line.FirstGlyph = count;
+			line.GlyphCount = 0;
+			line.TextPosition = (uint32_t)m_text.size();
+			line.TextLength = 0;
+			line.Baseline += lineHeight;
+			line.Width = 0.0f;
+			m_lines.push_back(line);
+		}
+		break;
+	}
+	m_metrics.Height = m_lines.size() * lineHeight;
+}
+
+void TextLayout::Align() {
+	float widest = 0.0f;
+	for (size_t i = 0; i < m_lines.size(); ++i)
+		widest = std::max(widest, m_lines[i].Width);
+	const bool wrap = m_format.Wrapping == WORD_WRAPPING_WRAP && m_maxWidth > 0.0f;
+	const float box = wrap ? m_maxWidth : widest;
+	for (size_t i = 0; i < m_lines.size(); ++i) {
+		TextLine& line = m_lines[i];
+		switch (m_format.Alignment) {
+		case TEXT_ALIGNMENT_LEADING:
+			line.X = 0.0f;
+			break;
+		case TEXT_ALIGNMENT_TRAILING:
+			line.X = box - line.Width;
+			break;
+		case TEXT_ALIGNMENT_CENTER:
+			line.X = (box - line.Width) * 0.5f;
+			break;
+		}
+	}
+	m_metrics.Width = widest;
+	m_metrics.LineCount = (uint32_t)m_lines.size();
+}
+
+void TextLayout::Draw(GlyphCache& glyphs, const XMFLOAT2& origin, uint32_t color, float depth,
+		std::vector<Sprite>& sprites, JobSystem* jobs) const {
+	if (m_keys.empty())
+		return;
+	glyphs.Request(&m_keys[0], (uint32_t)m_keys.size(), jobs);
+	for (size_t l = 0; l < m_lines.size(); ++l) {
+		const TextLine& line = m_lines[l];
+		for (uint32_t i = line.FirstGlyph; i < line.FirstGlyph + line.GlyphCount; ++i) {
+			const GlyphInfo* info = glyphs.Find(m_keys[i]);
+			if (!info)
+				continue;
+			XMFLOAT2 pen(origin.x + line.X + m_glyphs[i].X, origin.y + line.Baseline);
+			Sprite sprite;
+			if (glyphs.MakeSprite(*info, pen, m_format.Size, color, depth, sprite))
+				sprites.push_back(sprite);
+		}
+	}
+}
+
+TextLayoutCache::TextLayoutCache() : m_frame(1), m_maxAge(60) {
+	Clear();
+}
+
+TextLayoutCache::~TextLayoutCache() {
+	Clear();
+}
+
+void TextLayoutCache::Clear() {
+	for (size_t i = 0; i < m_slots.size(); ++i)
+		delete m_slots[i].Layout;
+	m_slots.clear();
+	m_freeSlots.clear();
+	Bucket empty = { 0, NONE };
+	m_byText.Buckets.assign(64, empty);
+	m_byText.Count = 0;
+	m_byId.Buckets.assign(64, empty);
+	m_byId.Count = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void TextLayoutCache::BeginFrame() {
+	++m_frame;
+	m_stats.Hits = m_stats.Updated = m_stats.Created = 0;
+	m_stats.ShapedGlyphs = m_stats.Evicted = 0;
+	for (uint32_t i = 0; i < (uint32_t)m_slots.size(); ++i) {
+		if (m_slots[i].Layout && m_frame - m_slots[i].LastUsed > m_maxAge) {
+			Release(i);
+			++m_stats.Evicted;
+		}
+	}
+}
+
+void TextLayoutCache::Release(uint32_t slot) {
+	Slot& s = m_slots[slot];
+	Erase(m_byText, s.Hash, slot);
+	if (s.Id != 0)
+		Erase(m_byId, HashMix(s.Id), slot);
+	delete s.Layout;
+	s.Layout = nullptr;
+	m_freeSlots.push_back(slot);
+	--m_stats.LayoutCount;
+}
+
+uint64_t TextLayoutCache::HashRequest(const TextRequest& request) {
+	const TextFormat& format = request.Format;
+	uint64_t hash = HashBytes(request.Text, strlen(request.Text));
+	hash = HashBytes(&format.Font, sizeof(format.Font), hash);
+	hash = HashBytes(&format.Size, sizeof(format.Size), hash);
+	hash = HashBytes(&format.Alignment, sizeof(format.Alignment), hash);
+	hash = HashBytes(&format.Wrapping, sizeof(format.Wrapping), hash);
+	hash = HashBytes(&format.LineSpacing, sizeof(format.LineSpacing), hash);
+	return HashBytes(&request.MaxWidth, sizeof(request.MaxWidth), hash);
+}
+
+bool TextLayoutCache::Matches(uint32_t slot, const TextRequest& request,
+		const TextRequest* requests) const {
+	const Slot& s = m_slots[slot];
+	if (s.Pending != NONE) {
+		const TextRequest& pending = requests[s.Pending];
+		return pending.Format == request.Format && pending.MaxWidth == request.MaxWidth
+				&& strcmp(pending.Text, request.Text) == 0;
+	}
+	const TextLayout& layout = *s.Layout;
+	return layout.GetFormat() == request.Format && layout.GetMaxWidth() == request.MaxWidth
+			&& layout.GetText() == request.Text;
+}
+
+uint32_t TextLayoutCache::FindText(uint64_t hash, const TextRequest& request,
+		const TextRequest* requests) const {
+	const std::vector<Bucket>& buckets = m_byText.Buckets;
+	const size_t mask = buckets.size() - 1;
+	for (size_t i = (size_t)hash & mask; buckets[i].Slot != NONE; i = (i + 1) & mask)
+		if (buckets[i].Hash == hash && Matches(buckets[i].Slot, request, requests))
+			return buckets[i].Slot;
+	return NONE;
+}
+
+uint32_t TextLayoutCache::FindId(uint64_t id) const {
+	const std::vector<Bucket>& buckets = m_byId.Buckets;
+	const uint64_t hash = HashMix(id);
+	const size_t mask = buckets.size() - 1;
+	for (size_t i = (size_t)hash & mask; buckets[i].Slot != NONE; i = (i + 1) & mask)
+		if (buckets[i].Hash == hash && m_slots[buckets[i].Slot].Id == id)
+			return buckets[i].Slot;
+	return NONE;
+}
+
+void TextLayoutCache::Insert(Table& table, uint64_t hash, uint32_t slot) {
+	if ((table.Count + 1) * 2 > table.Buckets.size()) {
+		std::vector<Bucket> old;
+		old.swap(table.Buckets);
+		Bucket empty = { 0, NONE };
+		table.Buckets.assign(old.size() * 2, empty);
+		table.Count = 0;
+		for (size_t i = 0; i < old.size(); ++i)
+			if (old[i].Slot != NONE)
+				Insert(table, old[i].Hash, old[i].Slot);
+	}
+	const size_t mask = table.Buckets.size() - 1;
+	size_t i = (size_t)hash & mask;
+	while (table.Buckets[i].Slot != NONE)
+		i = (i + 1) & mask;
+	table.Buckets[i].Hash = hash;
+	table.Buckets[i].Slot = slot;
+	++table.Count;
+}
+
+// Backward shift deletion keeps probe chains intact without tombstones.
+void TextLayoutCache::Erase(Table& table, uint64_t hash, uint32_t slot) {
+	std::vector<Bucket>& buckets = table.Buckets;
+	const size_t mask = buckets.size() - 1;
+	size_t hole = (size_t)hash & mask;
+	while (buckets[hole].Slot != slot) {
+		if (buckets[hole].Slot == NONE)
+			return;
+		hole = (hole + 1) & mask;
+	}
+	buckets[hole].Slot = NONE;
+	--table.Count;
+	for (size_t i = (hole + 1) & mask; buckets[i].Slot != NONE; i = (i + 1) & mask) {
+		const size_t home = (size_t)buckets[i].Hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			buckets[hole] = buckets[i];
+			buckets[i].Slot = NONE;
+			hole = i;
+		}
+	}
+}
+
+void TextLayoutCache::Layout(const GlyphCache& glyphs, const TextRequest* requests,
+		uint32_t count, const TextLayout** results, JobSystem* jobs) {
+	m_work.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		const TextRequest& request = requests[i];
+		const uint64_t hash = HashRequest(request);
+		uint32_t slot = FindText(hash, request, requests);
+		if (slot != NONE) {
+			if (m_slots[slot].Pending == NONE)
+				++m_stats.Hits;
+			m_slots[slot].LastUsed = m_frame;
+			results[i] = m_slots[slot].Layout;
+			continue;
+		}
+
+		slot = request.Id != 0 ? FindId(request.Id) : NONE;
+		if (slot != NONE && m_slots[slot].LastUsed != m_frame) {
+			// The element's text changed; update its layout in place.
+			Erase(m_byText, m_slots[slot].Hash, slot);
+			++m_stats.Updated;
+		} else {
+			// An id already used this frame keeps its layout.
+			const uint64_t id = slot == NONE ? request.Id : 0;
+			if (m_freeSlots.empty()) {
+				slot = (uint32_t)m_slots.size();
+				m_slots.push_back(Slot());
+			} else {
+				slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+			}
+			m_slots[slot].Layout = new TextLayout;
+			m_slots[slot].Id = id;
+			if (id != 0)
+				Insert(m_byId, HashMix(id), slot);
+			++m_stats.Created;
+			++m_stats.LayoutCount;
+		}
+		Slot& s = m_slots[slot];
+		s.Hash = hash;
+		s.LastUsed = m_frame;
+		s.Pending = i;
+		Insert(m_byText, hash, slot);
+		m_work.push_back(slot);
+		results[i] = s.Layout;
+	}
+
+	ParallelFor(jobs, (uint32_t)m_work.size(), LAYOUT_GRAIN, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const Slot& s = m_slots[m_work[i]];
+			const TextRequest& request = requests[s.Pending];
+			s.Layout->Update(glyphs, request.Text, request.Format, request.MaxWidth);
+		}
+	});
+	for (size_t i = 0; i < m_work.size(); ++i) {
+		Slot& s = m_slots[m_work[i]];
+		m_stats.ShapedGlyphs += s.Layout->GetShapedGlyphs();
+		s.Pending = NONE;
+	}
+}
+
+} // namespace Zeus
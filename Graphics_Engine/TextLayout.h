@@ -0,0 +1,220 @@
+/*
+ * TextLayout.h
+ *
+ * Paragraph layout modeled on IDWriteTextFormat and IDWriteTextLayout, and
+ * a cache that keeps the results between frames.
+ *
+ * A TextLayout shapes a UTF-8 paragraph against a GlyphCache font (glyph
+ * indices, advances and kerning), breaks it into lines at spaces within
+ * the maximum width and aligns them. When the text of a layout changes
+ * but its format and width do not, everything before the line preceding
+ * the first changed byte is kept and only the rest is shaped again; with
+ * greedy breaking no earlier line can change.
+ *
+ * TextLayoutCache finds layouts by text, format and width, so strings
+ * resubmitted every frame cost one hash lookup. Requests may carry the id
+ * of the UI element they belong to; an element whose string changed
+ * reuses its previous layout and takes the incremental path. Layouts that
+ * miss are shaped in parallel.
+ */
+
+#ifndef TEXTLAYOUT_H_
+#define TEXTLAYOUT_H_
+
+#include "GlyphCache.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+enum TextAlignment {
+	TEXT_ALIGNMENT_LEADING,
+	TEXT_ALIGNMENT_TRAILING,
+	TEXT_ALIGNMENT_CENTER
+};
+
+enum WordWrapping {
+	WORD_WRAPPING_WRAP,
+	WORD_WRAPPING_NO_WRAP
+};
+
+struct TextFormat {
+	uint32_t Font;
+	// Pixels per em.
+	float Size;
+	TextAlignment Alignment;
+	WordWrapping Wrapping;
+	// Multiple of the font's ascent + descent + line gap.
+	float LineSpacing;
+
+	TextFormat()
+		: Font(0), Size(16.0f), Alignment(TEXT_ALIGNMENT_LEADING),
+		Wrapping(WORD_WRAPPING_WRAP), LineSpacing(1.0f) {}
+
+	bool operator==(const TextFormat& other) const {
+		return Font == other.Font && Size == other.Size && Alignment == other.Alignment
+				&& Wrapping == other.Wrapping && LineSpacing == other.LineSpacing;
+	}
+};
+
+struct TextGlyph {
+	// GLYPH_LINE_BREAK for a hard break.
+	uint32_t Glyph;
+	// Byte offset of the code point in the text.
+	uint32_t TextPosition;
+	// Pen position from the start of the line, kerning included.
+	float X;
+	// Pixels, kerning excluded.
+	float Advance;
+};
+
+struct TextLine {
+	uint32_t FirstGlyph;
+	uint32_t GlyphCount;
+	uint32_t TextPosition;
+	uint32_t TextLength;
+	// Left edge after alignment, from the layout origin.
+	float X;
+	// Baseline from the top of the layout.
+	float Baseline;
+	// Without trailing whitespace.
+	float Width;
+};
+
+struct TextMetrics {
+	float Width;
+	float Height;
+	uint32_t LineCount;
+};
+
+class TextLayout {
+public:
+	TextLayout();
+
+	// maxWidth is ignored without wrapping. Without wrapping, or with a
+	// width of zero, lines align against the widest line.
+	void Update(const GlyphCache& glyphs, const char* text, const TextFormat& format,
+			float maxWidth);
+
+	const std::string& GetText() const { return m_text; }
+	const TextFormat& GetFormat() const { return m_format; }
+	float GetMaxWidth() const { return m_maxWidth; }
+	const TextMetrics& GetMetrics() const { return m_metrics; }
+	const TextGlyph* GetGlyphs() const { return m_glyphs.empty() ? nullptr : &m_glyphs[0]; }
+	uint32_t GetGlyphCount() const { return (uint32_t)m_glyphs.size(); }
+	const TextLine* GetLines() const { return m_lines.empty() ? nullptr : &m_lines[0]; }
+	uint32_t GetLineCount() const { return (uint32_t)m_lines.size(); }
+	// Glyphs shaped by the last Update().
+	uint32_t GetShapedGlyphs() const { return m_shapedGlyphs; }
+
+	// Makes the glyphs resident and appends a sprite per visible glyph with
+	// the top left of the layout at origin.
+	void Draw(GlyphCache& glyphs, const XMFLOAT2& origin, uint32_t color, float depth,
+			std::vector<Sprite>& sprites, JobSystem* jobs) const;
+
+private:
+	void Shape(const GlyphCache& glyphs, uint32_t textPosition);
+	void BreakLines(const GlyphCache& glyphs, uint32_t firstGlyph);
+	void Align();
+
+	std::string m_text;
+	TextFormat m_format;
+	float m_maxWidth;
+	std::vector<TextGlyph> m_glyphs;
+	// MakeKey() of every glyph, for Draw().
+	std::vector<uint64_t> m_keys;
+	std::vector<TextLine> m_lines;
+	TextMetrics m_metrics;
+	uint32_t m_shapedGlyphs;
+};
+
+struct TextRequest {
+	// Stable id of the element showing the text, or 0.
+	uint64_t Id;
+	// UTF-8, null terminated.
+	const char* Text;
+	TextFormat Format;
+	float MaxWidth;
+};
+
+struct TextLayoutStats {
+	uint32_t LayoutCount;
+	// Since the last BeginFrame().
+	uint32_t Hits;
+	// Misses that reused an element's previous layout.
+	uint32_t Updated;
+	uint32_t Created;
+	uint32_t ShapedGlyphs;
+	uint32_t Evicted;
+};
+
+class TextLayoutCache {
+public:
+	TextLayoutCache();
+	~TextLayoutCache();
+
+	// Layouts unused for more than this many frames are dropped.
+	void SetMaxAge(uint32_t frames) { m_maxAge = frames; }
+	void BeginFrame();
+	void Clear();
+
+	// results[i] is the layout for requests[i]. Layouts stay valid until
+	// evicted or, for requests with an id, until the same id asks for
+	// different text.
+	void Layout(const GlyphCache& glyphs, const TextRequest* requests, uint32_t count,
+			const TextLayout** results, JobSystem* jobs);
+
+	const TextLayoutStats& GetStats() const { return m_stats; }
+
+private:
+	TextLayoutCache(const TextLayoutCache&);
+	TextLayoutCache& operator=(const TextLayoutCache&);
+
+	enum { NONE = 0xffffffff };
+
+	struct Slot {
+		TextLayout* Layout;
+		uint64_t Hash;
+		uint64_t Id;
+		uint32_t LastUsed;
+		// Request being laid out into this slot, or NONE.
+		uint32_t Pending;
+	};
+
+	// Open-addressed, linear probing; buckets hold slot indices.
+	struct Bucket {
+		uint64_t Hash;
+		uint32_t Slot;
+	};
+
+	struct Table {
+		std::vector<Bucket> Buckets;
+		uint32_t Count;
+	};
+
+	static uint64_t HashRequest(const TextRequest& request);
+	bool Matches(uint32_t slot, const TextRequest& request, const TextRequest* requests) const;
+	uint32_t FindText(uint64_t hash, const TextRequest& request,
+			const TextRequest* requests) const;
+	uint32_t FindId(uint64_t id) const;
+	static void Insert(Table& table, uint64_t hash, uint32_t slot);
+	static void Erase(Table& table, uint64_t hash, uint32_t slot);
+	void Release(uint32_t slot);
+
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+	Table m_byText;
+	Table m_byId;
+	std::vector<uint32_t> m_work;
+	uint32_t m_frame;
+	uint32_t m_maxAge;
+	TextLayoutStats m_stats;
+};
+
+} // namespace Zeus
+
+#endif /* TEXTLAYOUT_H_ */
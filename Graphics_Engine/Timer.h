@@ -0,0 +1,32 @@
+/*
+ * Timer.h
+ *
+ * Wall-clock stopwatch for profiling and benchmarks.
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <chrono>
+
+namespace Zeus {
+
+class Timer {
+public:
+	Timer() { Reset(); }
+
+	void Reset() { m_start = Clock::now(); }
+
+	double ElapsedMilliseconds() const {
+		return std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::time_point m_start;
+};
+
+} // namespace Zeus
+
+#endif /* TIMER_H_ */
@@ -0,0 +1,323 @@
+/*
+ * VertexWelder.cpp
+ *
+ */
+
+#include "VertexWelder.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+namespace Zeus {
+
+namespace {
+
+const uint32_t NONE = 0xffffffff;
+const uint32_t CELL_BITS = 21;
+const uint32_t CELL_LIMIT = (1u << CELL_BITS) - 1;
+// Vertices searched per job.
+const uint32_t WELD_GRAIN = 4096;
+
+// One element to compare, located in its stream.
+struct ElementCompare {
+	const uint8_t* Data;
+	uint32_t Stride;
+	Format ElementFormat;
+	uint32_t Size;
+	// Integer and unknown formats compare bit for bit.
+	bool Exact;
+	XMFLOAT4 Epsilon;
+};
+
+// Cells of the grid: the range of sorted vertices inside. Empty slots have
+// End 0.
+struct CellRange {
+	uint64_t Key;
+	uint32_t Begin;
+	uint32_t End;
+};
+
+struct Match {
+	uint32_t Vertex;
+	uint32_t Other;
+	// Every element matched, not just the position.
+	bool Full;
+};
+
+bool IsFloatFormat(Format format) {
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT:
+	case FORMAT_R32G32B32_FLOAT:
+	case FORMAT_R32G32_FLOAT:
+	case FORMAT_R32_FLOAT:
+	case FORMAT_R16G16B16A16_FLOAT:
+	case FORMAT_R16G16_FLOAT:
+	case FORMAT_R16_FLOAT:
+	case FORMAT_R16G16B16A16_UNORM:
+	case FORMAT_R16G16_UNORM:
+	case FORMAT_R16_UNORM:
+	case FORMAT_R10G10B10A2_UNORM:
+	case FORMAT_R11G11B10_FLOAT:
+	case FORMAT_R8G8B8A8_UNORM:
+	case FORMAT_R8G8B8A8_UNORM_SRGB:
+	case FORMAT_B8G8R8A8_UNORM:
+	case FORMAT_R8G8_UNORM:
+	case FORMAT_R8_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+XMVECTOR LoadElement(Format format, const uint8_t* data) {
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT:
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(data));
+	case FORMAT_R32G32B32_FLOAT:
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(data));
+	case FORMAT_R32G32_FLOAT:
+		return XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(data));
+	case FORMAT_R32_FLOAT:
+		return XMLoadFloat(reinterpret_cast<const float*>(data));
+	case FORMAT_R16G16B16A16_FLOAT:
+		return XMLoadHalf4(reinterpret_cast<const XMHALF4*>(data));
+	case FORMAT_R16G16_FLOAT:
+		return XMLoadHalf2(reinterpret_cast<const XMHALF2*>(data));
+	case FORMAT_R16_FLOAT:
+		return XMVectorSetX(XMVectorZero(),
+				XMConvertHalfToFloat(*reinterpret_cast<const HALF*>(data)));
+	case FORMAT_R16G16B16A16_UNORM:
+		return XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(data));
+	case FORMAT_R16G16_UNORM:
+		return XMLoadUShortN2(reinterpret_cast<const XMUSHORTN2*>(data));
+	case FORMAT_R16_UNORM:
+		return XMVectorSetX(XMVectorZero(),
+			*reinterpret_cast<const uint16_t*>(data) / 65535.0f);
+	case FORMAT_R10G10B10A2_UNORM:
+		return XMLoadUDecN4(reinterpret_cast<const XMUDECN4*>(data));
+	case FORMAT_R11G11B10_FLOAT:
+		return XMLoadFloat3PK(reinterpret_cast<const XMFLOAT3PK*>(data));
+	case FORMAT_R8G8B8A8_UNORM:
+	case FORMAT_R8G8B8A8_UNORM_SRGB:
+	case FORMAT_B8G8R8A8_UNORM:
+		// Channel order does not matter for a componentwise compare.
+		return XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(data));
+	case FORMAT_R8G8_UNORM:
+		return XMVectorSet(data[0] / 255.0f, data[1] / 255.0f, 0.0f, 0.0f);
+	case FORMAT_R8_UNORM:
+		return XMVectorSetX(XMVectorZero(), data[0] / 255.0f);
+	default:
+		return XMVectorZero();
+	}
+}
+
+float GetEpsilon(const WeldEpsilons& epsilons, VertexUsage usage) {
+	switch (usage) {
+	case VERTEX_USAGE_POSITION:
+		return epsilons.Position;
+	case VERTEX_USAGE_BLENDWEIGHT:
+		return epsilons.BlendWeight;
+	case VERTEX_USAGE_NORMAL:
+		return epsilons.Normal;
+	case VERTEX_USAGE_TEXCOORD:
+		return epsilons.TexCoord;
+	case VERTEX_USAGE_TANGENT:
+		return epsilons.Tangent;
+	case VERTEX_USAGE_BINORMAL:
+		return epsilons.Binormal;
+	case VERTEX_USAGE_COLOR:
+		return epsilons.Color;
+	default:
+		return 0.0f;
+	}
+}
+
+bool ElementsMatch(const ElementCompare& element, uint32_t a, uint32_t b) {
+	const uint8_t* pa = element.Data + (size_t)a * element.Stride;
+	const uint8_t* pb = element.Data + (size_t)b * element.Stride;
+	if (element.Exact)
+		return memcmp(pa, pb, element.Size) == 0;
+	XMVECTOR difference = XMVectorAbs(XMVectorSubtract(LoadElement(element.ElementFormat, pa),
+			LoadElement(element.ElementFormat, pb)));
+	return XMVector4LessOrEqual(difference, XMLoadFloat4(&element.Epsilon));
+}
+
+uint64_t GetCellKey(uint32_t x, uint32_t y, uint32_t z) {
+	return (uint64_t)x | (uint64_t)y << CELL_BITS | (uint64_t)z << (CELL_BITS * 2);
+}
+
+const CellRange* FindCell(const std::vector<CellRange>& table, uint64_t key) {
+	size_t mask = table.size() - 1;
+	for (size_t slot = (size_t)HashMix(key) & mask; table[slot].End; slot = (slot + 1) & mask) {
+		if (table[slot].Key == key)
+			return &table[slot];
+	}
+	return nullptr;
+}
+
+} // namespace
+
+bool WeldVertices(const VertexStream* streams, const VertexElement* elements,
+		uint32_t elementCount, uint32_t vertexCount, const WeldEpsilons& epsilons,
+		WeldResult& result, JobSystem* jobs) {
+	const VertexElement* position = nullptr;
+	std::vector<ElementCompare> compares;
+	for (uint32_t i = 0; i < elementCount; ++i) {
+		const VertexElement& element = elements[i];
+		if (element.Usage == VERTEX_USAGE_POSITION && element.UsageIndex == 0) {
+			position = &element;
+			continue;
+		}
+		if (epsilons.PositionsOnly)
+			continue;
+		ElementCompare compare;
+		compare.Data = static_cast<const uint8_t*>(streams[element.Stream].Data) + element.Offset;
+		compare.Stride = streams[element.Stream].Stride;
+		compare.ElementFormat = element.ElementFormat;
+		compare.Size = BitsPerPixel(element.ElementFormat) / 8;
+		compare.Exact = !IsFloatFormat(element.ElementFormat);
+		float epsilon = GetEpsilon(epsilons, element.Usage);
+		compare.Epsilon = XMFLOAT4(epsilon, epsilon, epsilon, epsilon);
+		compares.push_back(compare);
+	}
+	if (!position || (position->ElementFormat != FORMAT_R32G32B32_FLOAT
+			&& position->ElementFormat != FORMAT_R32G32B32A32_FLOAT))
+		return false;
+
+	const uint8_t* positions = static_cast<const uint8_t*>(streams[position->Stream].Data)
+			+ position->Offset;
+	uint32_t positionStride = streams[position->Stream].Stride;
+	auto loadPosition = [&](uint32_t v) {
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions
+				+ (size_t)v * positionStride));
+	};
+
+	// Cells no smaller than the epsilon, and no smaller than the key can
+	// address across the bounding box.
+	XMVECTOR low = XMVectorReplicate(FLT_MAX);
+	XMVECTOR high = XMVectorReplicate(-FLT_MAX);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		XMVECTOR p = loadPosition(v);
+		low = XMVectorMin(low, p);
+		high = XMVectorMax(high, p);
+	}
+	XMFLOAT3 size;
+	XMStoreFloat3(&size, XMVectorSubtract(high, low));
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	float cellSize = std::max(epsilons.Position, extent / CELL_LIMIT);
+	XMVECTOR inverse = XMVectorReplicate(cellSize > 0.0f ? 1.0f / cellSize : 1.0f);
+
+	std::vector<XMFLOAT4> cells(vertexCount);
+	std::vector<SortItem> sorted(vertexCount);
+	ParallelFor(jobs, vertexCount, WELD_GRAIN, [&](uint32_t begin, uint32_t end) {
+		XMVECTOR limit = XMVectorReplicate((float)CELL_LIMIT);
+		for (uint32_t v = begin; v < end; ++v) {
+			XMVECTOR cell = XMVectorMultiply(XMVectorSubtract(loadPosition(v), low), inverse);
+			XMStoreFloat4(&cells[v], XMVectorFloor(XMVectorClamp(cell, XMVectorZero(), limit)));
+			sorted[v].Key = GetCellKey((uint32_t)cells[v].x, (uint32_t)cells[v].y,
+					(uint32_t)cells[v].z);
+			sorted[v].Value = v;
+			sorted[v].Reserved = 0;
+		}
+	});
+	if (vertexCount) {
+		std::vector<SortItem> scratch(vertexCount);
+		RadixSort(&sorted[0], &scratch[0], vertexCount, jobs);
+	}
+
+	uint32_t cellCount = 0;
+	for (uint32_t i = 0; i < vertexCount; ++i) {
+		if (i == 0 || sorted[i].Key != sorted[i - 1].Key)
+			++cellCount;
+	}
+	size_t capacity = 16;
+	while (capacity < (size_t)cellCount * 2)
+		capacity *= 2;
+	CellRange empty = { 0, 0, 0 };
+	std::vector<CellRange> table(capacity, empty);
+	for (uint32_t i = 0; i < vertexCount; ) {
+		uint32_t end = i + 1;
+		while (end < vertexCount && sorted[end].Key == sorted[i].Key)
+			++end;
+		size_t slot = (size_t)HashMix(sorted[i].Key) & (capacity - 1);
+		while (table[slot].End)
+			slot = (slot + 1) & (capacity - 1);
+		table[slot].Key = sorted[i].Key;
+		table[slot].Begin = i;
+		table[slot].End = end;
+		i = end;
+	}
+
+	// Earlier vertices within the position epsilon of every vertex, lowest
+	// first. Each job keeps its own list, so the lists join in vertex order.
+	uint32_t chunkCount = (vertexCount + WELD_GRAIN - 1) / WELD_GRAIN;
+	std::vector<std::vector<Match> > matches(chunkCount);
+	XMVECTOR positionEpsilon = XMVectorReplicate(epsilons.Position);
+	ParallelFor(jobs, vertexCount, WELD_GRAIN, [&](uint32_t begin, uint32_t end) {
+		std::vector<Match>& out = matches[begin / WELD_GRAIN];
+		for (uint32_t v = begin; v < end; ++v) {
+			XMVECTOR p = loadPosition(v);
+			size_t first = out.size();
+			uint32_t x = (uint32_t)cells[v].x;
+			uint32_t y = (uint32_t)cells[v].y;
+			uint32_t z = (uint32_t)cells[v].z;
+			for (uint32_t dz = z ? z - 1 : 0; dz <= std::min(z + 1, CELL_LIMIT); ++dz) {
+				for (uint32_t dy = y ? y - 1 : 0; dy <= std::min(y + 1, CELL_LIMIT); ++dy) {
+					for (uint32_t dx = x ? x - 1 : 0; dx <= std::min(x + 1, CELL_LIMIT); ++dx) {
+						const CellRange* cell = FindCell(table, GetCellKey(dx, dy, dz));
+						if (!cell)
+							continue;
+						for (uint32_t i = cell->Begin; i < cell->End; ++i) {
+							uint32_t u = sorted[i].Value;
+							// Cells list their vertices in ascending order.
+							if (u >= v)
+								break;
+							XMVECTOR difference = XMVectorAbs(XMVectorSubtract(loadPosition(u), p));
+							if (!XMVector3LessOrEqual(difference, positionEpsilon))
+								continue;
+							Match match = { v, u, true };
+							for (size_t e = 0; e < compares.size() && match.Full; ++e)
+								match.Full = ElementsMatch(compares[e], u, v);
+							out.push_back(match);
+						}
+					}
+				}
+			}
+			std::sort(out.begin() + first, out.end(), [](const Match& a, const Match& b) {
+				return a.Other < b.Other;
+			});
+		}
+	});
+
+	// Each vertex joins the lowest earlier match that joined nothing itself.
+	result.PointReps.resize(vertexCount);
+	std::vector<uint32_t> reps(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		result.PointReps[v] = v;
+		reps[v] = v;
+	}
+	for (uint32_t c = 0; c < chunkCount; ++c) {
+		const std::vector<Match>& list = matches[c];
+		for (size_t i = 0; i < list.size(); ++i) {
+			const Match& match = list[i];
+			uint32_t v = match.Vertex;
+			uint32_t u = match.Other;
+			if (result.PointReps[v] == v && result.PointReps[u] == u)
+				result.PointReps[v] = u;
+			if (match.Full && reps[v] == v && reps[u] == u)
+				reps[v] = u;
+		}
+	}
+
+	result.Remap.resize(vertexCount);
+	result.VertexCount = 0;
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		result.Remap[v] = reps[v] == v ? result.VertexCount++ : result.Remap[reps[v]];
+	return true;
+}
+
+} // namespace Zeus
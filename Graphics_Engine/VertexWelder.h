@@ -0,0 +1,73 @@
+/*
+ * VertexWelder.h
+ *
+ * Vertex welding replacing D3DXWeldVertices, built for scanned and
+ * tessellated data with millions of near-duplicate vertices.
+ *
+ * Positions are quantized into a spatial hash grid with cells at least
+ * as large as the position epsilon, so every candidate within epsilon of
+ * a vertex lies in its own cell or one of the 26 around it. Candidates are
+ * compared component by component, positions against the position
+ * epsilon and every other element against the epsilon of its semantic;
+ * integer elements such as blend indices must match exactly. Candidate
+ * searches run in parallel.
+ *
+ * Welding within an epsilon is not transitive, so the result is defined
+ * the way a serial weld in vertex order would produce it: each vertex
+ * joins the lowest earlier vertex it matches that has not itself joined
+ * another one. That pass is serial and cheap, so the result never depends
+ * on the thread count.
+ *
+ * Point representatives use the same rule with positions alone, like
+ * D3DXConvertAdjacencyToPointReps. The remap numbers the welded vertices
+ * in order of their first member; apply it with RemapIndices() and
+ * RemapVertices() into a buffer of VertexCount vertices.
+ */
+
+#ifndef VERTEXWELDER_H_
+#define VERTEXWELDER_H_
+
+#include "MeshOptimizer.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Zeus {
+
+class JobSystem;
+
+// Largest difference per component that still welds, as D3DXWELDEPSILONS.
+struct WeldEpsilons {
+	float Position;
+	float BlendWeight;
+	float Normal;
+	float TexCoord;
+	float Tangent;
+	float Binormal;
+	float Color;
+	// Compare positions only, as D3DXWELDEPSILONS_WELDALL.
+	bool PositionsOnly;
+
+	WeldEpsilons()
+		: Position(1e-6f), BlendWeight(1e-6f), Normal(1e-6f), TexCoord(1e-6f), Tangent(1e-6f),
+		Binormal(1e-6f), Color(1e-6f), PositionsOnly(false) {}
+};
+
+struct WeldResult {
+	// Lowest vertex at the same point as every vertex.
+	std::vector<uint32_t> PointReps;
+	// New index of every vertex.
+	std::vector<uint32_t> Remap;
+	uint32_t VertexCount;
+};
+
+// Compares the vertices of streams by every element in elements. Returns
+// false without a POSITION0 element in R32G32B32_FLOAT or
+// R32G32B32A32_FLOAT.
+bool WeldVertices(const VertexStream* streams, const VertexElement* elements,
+		uint32_t elementCount, uint32_t vertexCount, const WeldEpsilons& epsilons,
+		WeldResult& result, JobSystem* jobs);
+
+} // namespace Zeus
+
+#endif /* VERTEXWELDER_H_ */
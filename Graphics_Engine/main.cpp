@@ -3,6 +3,47 @@
  *
  */
 
-int main(){
+#include "JobSystem.h"
+#include "Tests/Test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
 
-}
\ No newline at end of file
+using namespace Zeus;
+
+int main(){
+	// At least four threads, so the parallel paths split and interleave
+	// their work even on small machines.
+	JobSystem jobs;
+	if (!jobs.Initialize(std::max(std::thread::hardware_concurrency(), 4u) - 1)) {
+		printf("Could not start the job system\n");
+		return 1;
+	}
+	TestContext context = { &jobs, 0, 0 };
+	RunCascadedShadowMapsTests(context);
+	RunClusteredLightingTests(context);
+	RunCommandListTests(context);
+	RunComputeTests(context);
+	RunDrawQueueTests(context);
+	RunGlyphCacheTests(context);
+	RunHdrFileTests(context);
+	RunInstanceBatcherTests(context);
+	RunLineRendererTests(context);
+	RunMeshOptimizerTests(context);
+	RunMeshSimplifierTests(context);
+	RunMeshTopologyTests(context);
+	RunMeshletTests(context);
+	RunPathGeometryTests(context);
+	RunPipelineStateCacheTests(context);
+	RunPostProcessTests(context);
+	RunProgressiveMeshTests(context);
+	RunRenderGraphTests(context);
+	RunRingAllocatorTests(context);
+	RunSpriteBatcherTests(context);
+	RunTangentFrameTests(context);
+	RunTextLayoutTests(context);
+	RunVertexWelderTests(context);
+	printf("%u checks, %u failed\n", context.Checks, context.Failures);
+	return (int)context.Failures;
+}